@@ -16,6 +16,7 @@ LOCAL_SRC_FILES := \
 	src/citizen_aqualand_parser.c \
 	src/cochran_commander.c \
 	src/cochran_commander_parser.c \
+	src/column.c \
 	src/common.c \
 	src/context.c \
 	src/cressi_edy.c \
@@ -26,6 +27,7 @@ LOCAL_SRC_FILES := \
 	src/cressi_leonardo_parser.c \
 	src/custom.c \
 	src/datetime.c \
+	src/deco.c \
 	src/deepblu_cosmiq.c \
 	src/deepblu_cosmiq_parser.c \
 	src/deepsix_excursion.c \
@@ -38,17 +40,20 @@ LOCAL_SRC_FILES := \
 	src/divesoft_freedom_parser.c \
 	src/divesystem_idive.c \
 	src/divesystem_idive_parser.c \
+	src/fingerprint.c \
 	src/hdlc.c \
 	src/hw_frog.c \
 	src/hw_ostc3.c \
 	src/hw_ostc.c \
 	src/hw_ostc_parser.c \
 	src/ihex.c \
+	src/interrupt.c \
 	src/iostream.c \
 	src/irda.c \
 	src/iterator.c \
 	src/liquivision_lynx.c \
 	src/liquivision_lynx_parser.c \
+	src/loop.c \
 	src/mares_common.c \
 	src/mares_darwin.c \
 	src/mares_darwin_parser.c \
@@ -70,23 +75,29 @@ LOCAL_SRC_FILES := \
 	src/oceans_s1_common.c \
 	src/oceans_s1_parser.c \
 	src/packet.c \
+	src/parsecache.c \
 	src/parser.c \
 	src/platform.c \
 	src/rbstream.c \
+	src/recordstore.c \
 	src/reefnet_sensus.c \
 	src/reefnet_sensus_parser.c \
 	src/reefnet_sensuspro.c \
 	src/reefnet_sensuspro_parser.c \
 	src/reefnet_sensusultra.c \
 	src/reefnet_sensusultra_parser.c \
+	src/relay.c \
+	src/replay.c \
 	src/ringbuffer.c \
 	src/seac_screen.c \
 	src/seac_screen_parser.c \
+	src/serial.c \
 	src/serial_posix.c \
 	src/shearwater_common.c \
 	src/shearwater_petrel.c \
 	src/shearwater_predator.c \
 	src/shearwater_predator_parser.c \
+	src/simulator.c \
 	src/socket.c \
 	src/sporasub_sp2.c \
 	src/sporasub_sp2_parser.c \
@@ -105,9 +116,11 @@ LOCAL_SRC_FILES := \
 	src/suunto_vyper_parser.c \
 	src/tecdiving_divecomputereu.c \
 	src/tecdiving_divecomputereu_parser.c \
+	src/thread.c \
 	src/timer.c \
 	src/usb.c \
 	src/usbhid.c \
+	src/usbserial.c \
 	src/uwatec_aladin.c \
 	src/uwatec_memomouse.c \
 	src/uwatec_memomouse_parser.c \
@@ -124,11 +137,13 @@ include $(BUILD_SHARED_LIBRARY)
 include $(CLEAR_VARS)
 LOCAL_MODULE := dctool
 LOCAL_SHARED_LIBRARIES := libdivecomputer
-LOCAL_CFLAGS := -DHAVE_UNISTD_H -DHAVE_GETOPT_H -DHAVE_GETOPT_LONG -DHAVE_DECL_OPTRESET=1
+LOCAL_CFLAGS := -DHAVE_UNISTD_H -DHAVE_GETOPT_H -DHAVE_GETOPT_LONG -DHAVE_DECL_OPTRESET=1 -DHAVE_SYS_RESOURCE_H -DHAVE_GETRUSAGE
 LOCAL_C_INCLUDES := $(LOCAL_PATH)/include
 LOCAL_SRC_FILES := \
+	examples/archive.c \
 	examples/common.c \
 	examples/dctool.c \
+	examples/dctool_benchmark.c \
 	examples/dctool_download.c \
 	examples/dctool_dump.c \
 	examples/dctool_fwupdate.c \
@@ -140,8 +155,12 @@ LOCAL_SRC_FILES := \
 	examples/dctool_timesync.c \
 	examples/dctool_version.c \
 	examples/dctool_write.c \
+	examples/dumpfile.c \
 	examples/output.c \
+	examples/output_archive.c \
+	examples/output_binary.c \
 	examples/output_raw.c \
 	examples/output_xml.c \
+	examples/synthetic.c \
 	examples/utils.c
 include $(BUILD_EXECUTABLE)
@@ -0,0 +1,238 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2026 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "archive.h"
+#include "common.h"
+#include "utils.h"
+
+struct dctool_archive_t {
+	dctool_file_t file;
+	dctool_archive_entry_t *entries;
+	unsigned int count;
+	// Hash table with the entry number plus one, or zero if empty.
+	unsigned int *table;
+	unsigned int mask;
+};
+
+static unsigned int
+archive_uint32 (const unsigned char data[])
+{
+	return data[0] | (data[1] << 8) | (data[2] << 16) | ((unsigned int) data[3] << 24);
+}
+
+static unsigned long long
+archive_uint64 (const unsigned char data[])
+{
+	return archive_uint32 (data) | ((unsigned long long) archive_uint32 (data + 4) << 32);
+}
+
+static unsigned int
+archive_hash (const unsigned char fingerprint[], unsigned int fsize)
+{
+	// FNV-1a
+	unsigned int hash = 2166136261U;
+	for (unsigned int i = 0; i < fsize; ++i) {
+		hash ^= fingerprint[i];
+		hash *= 16777619U;
+	}
+
+	return hash;
+}
+
+dc_status_t
+dctool_archive_open (dctool_archive_t **out, const char *filename)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	dctool_archive_t *archive = NULL;
+
+	if (out == NULL || filename == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	// Allocate memory.
+	archive = (dctool_archive_t *) calloc (1, sizeof (dctool_archive_t));
+	if (archive == NULL) {
+		ERROR ("Failed to allocate memory.");
+		return DC_STATUS_NOMEMORY;
+	}
+
+	// Open the archive file.
+	if (!dctool_file_map (&archive->file, filename)) {
+		ERROR ("Failed to open the archive.");
+		status = DC_STATUS_IO;
+		goto error_free;
+	}
+
+	const unsigned char *data = dc_buffer_get_data (archive->file.buffer);
+	size_t size = dc_buffer_get_size (archive->file.buffer);
+
+	// Check the file header.
+	if (size < DCTOOL_ARCHIVE_HEADER ||
+		memcmp (data, DCTOOL_ARCHIVE_MAGIC, 4) != 0 ||
+		archive_uint32 (data + 4) != DCTOOL_ARCHIVE_VERSION) {
+		ERROR ("Unsupported archive format.");
+		status = DC_STATUS_DATAFORMAT;
+		goto error_unmap;
+	}
+
+	unsigned long long offset = archive_uint64 (data + 8);
+	if (offset == 0) {
+		ERROR ("Incomplete archive.");
+		status = DC_STATUS_DATAFORMAT;
+		goto error_unmap;
+	}
+
+	if (offset < DCTOOL_ARCHIVE_HEADER || offset > size - 8) {
+		ERROR ("Invalid index offset.");
+		status = DC_STATUS_DATAFORMAT;
+		goto error_unmap;
+	}
+
+	unsigned int count = archive_uint32 (data + offset);
+	unsigned int length = archive_uint32 (data + offset + 4);
+	if (length < DCTOOL_ARCHIVE_ENTRY ||
+		(size - offset - 8) / length < count) {
+		ERROR ("Invalid index.");
+		status = DC_STATUS_DATAFORMAT;
+		goto error_unmap;
+	}
+
+	// Allocate the entries and the hash table. The table is kept at
+	// most half full.
+	unsigned int nbuckets = 1;
+	while (nbuckets < 2 * count)
+		nbuckets *= 2;
+
+	archive->entries = (dctool_archive_entry_t *) calloc (count ? count : 1, sizeof (dctool_archive_entry_t));
+	archive->table = (unsigned int *) calloc (nbuckets, sizeof (unsigned int));
+	if (archive->entries == NULL || archive->table == NULL) {
+		ERROR ("Failed to allocate memory.");
+		status = DC_STATUS_NOMEMORY;
+		goto error_unmap;
+	}
+	archive->mask = nbuckets - 1;
+
+	const unsigned char *p = data + offset + 8;
+	for (unsigned int i = 0; i < count; ++i, p += length) {
+		dctool_archive_entry_t *entry = archive->entries + i;
+
+		unsigned long long begin = archive_uint64 (p + 0);
+		unsigned int dsize = archive_uint32 (p + 8);
+		unsigned int fsize = archive_uint32 (p + 40);
+		if (begin < DCTOOL_ARCHIVE_HEADER || begin > offset ||
+			dsize > offset - begin || fsize > DCTOOL_ARCHIVE_FINGERPRINT) {
+			ERROR ("Invalid index entry.");
+			status = DC_STATUS_DATAFORMAT;
+			goto error_unmap;
+		}
+
+		entry->data = data + begin;
+		entry->size = dsize;
+		entry->number = archive_uint32 (p + 12);
+		entry->devinfo.model = archive_uint32 (p + 16);
+		entry->devinfo.firmware = archive_uint32 (p + 20);
+		entry->devinfo.serial = archive_uint32 (p + 24);
+		entry->clock.devtime = archive_uint32 (p + 28);
+		entry->clock.systime = (dc_ticks_t) archive_uint64 (p + 32);
+		entry->fsize = fsize;
+		memcpy (entry->fingerprint, p + 48, fsize);
+
+		// Insert into the hash table, unless the fingerprint is
+		// already present.
+		if (fsize == 0)
+			continue;
+
+		unsigned int n = archive_hash (entry->fingerprint, fsize) & archive->mask;
+		while (archive->table[n]) {
+			const dctool_archive_entry_t *other = archive->entries + archive->table[n] - 1;
+			if (other->fsize == fsize && memcmp (other->fingerprint, entry->fingerprint, fsize) == 0)
+				break;
+			n = (n + 1) & archive->mask;
+		}
+		if (archive->table[n] == 0)
+			archive->table[n] = i + 1;
+	}
+
+	archive->count = count;
+
+	*out = archive;
+
+	return DC_STATUS_SUCCESS;
+
+error_unmap:
+	free (archive->table);
+	free (archive->entries);
+	dctool_file_unmap (&archive->file);
+error_free:
+	free (archive);
+	return status;
+}
+
+unsigned int
+dctool_archive_count (dctool_archive_t *archive)
+{
+	if (archive == NULL)
+		return 0;
+
+	return archive->count;
+}
+
+const dctool_archive_entry_t *
+dctool_archive_get (dctool_archive_t *archive, unsigned int index)
+{
+	if (archive == NULL || index >= archive->count)
+		return NULL;
+
+	return archive->entries + index;
+}
+
+const dctool_archive_entry_t *
+dctool_archive_find (dctool_archive_t *archive, const unsigned char fingerprint[], unsigned int fsize)
+{
+	if (archive == NULL || fsize == 0 || fsize > DCTOOL_ARCHIVE_FINGERPRINT)
+		return NULL;
+
+	unsigned int n = archive_hash (fingerprint, fsize) & archive->mask;
+	while (archive->table[n]) {
+		const dctool_archive_entry_t *entry = archive->entries + archive->table[n] - 1;
+		if (entry->fsize == fsize && memcmp (entry->fingerprint, fingerprint, fsize) == 0)
+			return entry;
+		n = (n + 1) & archive->mask;
+	}
+
+	return NULL;
+}
+
+dc_status_t
+dctool_archive_close (dctool_archive_t *archive)
+{
+	if (archive == NULL)
+		return DC_STATUS_SUCCESS;
+
+	free (archive->table);
+	free (archive->entries);
+	dctool_file_unmap (&archive->file);
+	free (archive);
+
+	return DC_STATUS_SUCCESS;
+}
@@ -0,0 +1,110 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2026 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+#ifndef DCTOOL_ARCHIVE_H
+#define DCTOOL_ARCHIVE_H
+
+#include <libdivecomputer/common.h>
+#include <libdivecomputer/device.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/*
+ * Archive format
+ *
+ * The raw dive data of many dives, stored back to back in a single
+ * file, followed by an index. All values are stored in little endian
+ * byte order.
+ *
+ * File header (16 bytes):
+ *
+ *   0   char[4]  Magic "DCTA"
+ *   4   uint32   Format version (1)
+ *   8   uint64   Offset of the index (0 if the file is incomplete)
+ *
+ * Index (at the end of the file):
+ *
+ *   0   uint32   Number of dives (D)
+ *   4   uint32   Size of an index entry (80)
+ *   8   entry[]  Index entries (D entries)
+ *
+ * Index entry (80 bytes):
+ *
+ *   0   uint64   Offset of the raw dive data
+ *   8   uint32   Size of the raw dive data
+ *   12  uint32   Dive number
+ *   16  uint32   Model (devinfo event)
+ *   20  uint32   Firmware (devinfo event)
+ *   24  uint32   Serial number (devinfo event)
+ *   28  uint32   Device time (clock event)
+ *   32  int64    System time (clock event)
+ *   40  uint32   Size of the fingerprint (F)
+ *   44  uint32   Reserved (0)
+ *   48  uint8[]  Fingerprint (F bytes, padded with zeros to 32 bytes)
+ *
+ * Readers should use the entry size from the index, such that fields
+ * can be appended to the entries later.
+ */
+
+#define DCTOOL_ARCHIVE_MAGIC       "DCTA"
+#define DCTOOL_ARCHIVE_VERSION     1
+#define DCTOOL_ARCHIVE_HEADER      16
+#define DCTOOL_ARCHIVE_ENTRY       80
+#define DCTOOL_ARCHIVE_FINGERPRINT 32
+
+typedef struct dctool_archive_t dctool_archive_t;
+
+typedef struct dctool_archive_entry_t {
+	const unsigned char *data;
+	unsigned int size;
+	unsigned int number;
+	dc_event_devinfo_t devinfo;
+	dc_event_clock_t clock;
+	unsigned char fingerprint[DCTOOL_ARCHIVE_FINGERPRINT];
+	unsigned int fsize;
+} dctool_archive_entry_t;
+
+dc_status_t
+dctool_archive_open (dctool_archive_t **archive, const char *filename);
+
+unsigned int
+dctool_archive_count (dctool_archive_t *archive);
+
+const dctool_archive_entry_t *
+dctool_archive_get (dctool_archive_t *archive, unsigned int index);
+
+/*
+ * Look up a dive by its fingerprint, with a hash table built when the
+ * archive is opened. If several dives share the same fingerprint, the
+ * first one is returned. Returns NULL if there is no such dive.
+ */
+const dctool_archive_entry_t *
+dctool_archive_find (dctool_archive_t *archive, const unsigned char fingerprint[], unsigned int fsize);
+
+dc_status_t
+dctool_archive_close (dctool_archive_t *archive);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+#endif /* DCTOOL_ARCHIVE_H */
@@ -19,6 +19,10 @@
  * MA 02110-1301 USA
  */
 
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
@@ -26,6 +30,21 @@
 #ifdef _WIN32
 #include <io.h>
 #include <fcntl.h>
+#define WIN32_LEAN_AND_MEAN
+#define NOGDI
+#include <windows.h>
+#include <process.h>
+#elif defined(HAVE_PTHREAD_H)
+#include <pthread.h>
+#endif
+
+#if defined(HAVE_MMAP) && defined(HAVE_SYS_MMAN_H)
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#define USE_MMAP
 #endif
 
 #include <libdivecomputer/serial.h>
@@ -411,6 +430,61 @@ dctool_file_read (const char *filename)
 	return buffer;
 }
 
+int
+dctool_file_map (dctool_file_t *file, const char *filename)
+{
+	file->buffer = NULL;
+	file->mapping = NULL;
+	file->size = 0;
+
+#ifdef USE_MMAP
+	if (filename) {
+		int fd = open (filename, O_RDONLY);
+		if (fd < 0)
+			return 0;
+
+		struct stat st;
+		if (fstat (fd, &st) == 0 && S_ISREG (st.st_mode) && st.st_size > 0) {
+			void *mapping = mmap (NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (mapping != MAP_FAILED) {
+				file->buffer = dc_buffer_new_view ((const unsigned char *) mapping, st.st_size);
+				if (file->buffer == NULL) {
+					munmap (mapping, st.st_size);
+					close (fd);
+					return 0;
+				}
+				file->mapping = mapping;
+				file->size = st.st_size;
+			}
+		}
+
+		close (fd);
+
+		if (file->buffer)
+			return 1;
+	}
+#endif
+
+	// Fallback to reading the file into memory.
+	file->buffer = dctool_file_read (filename);
+
+	return file->buffer != NULL;
+}
+
+void
+dctool_file_unmap (dctool_file_t *file)
+{
+	dc_buffer_free (file->buffer);
+	file->buffer = NULL;
+
+#ifdef USE_MMAP
+	if (file->mapping)
+		munmap (file->mapping, file->size);
+#endif
+	file->mapping = NULL;
+	file->size = 0;
+}
+
 static dc_status_t
 dctool_usb_open (dc_iostream_t **out, dc_context_t *context, dc_descriptor_t *descriptor)
 {
@@ -595,3 +669,230 @@ dctool_iostream_open (dc_iostream_t **iostream, dc_context_t *context, dc_descri
 		return dc_usb_storage_open (iostream, context, devname);
 	}
 }
+
+struct dctool_thread_t {
+	dctool_thread_func_t func;
+	void *userdata;
+#if defined(_WIN32)
+	HANDLE handle;
+#elif defined(HAVE_PTHREAD_H)
+	pthread_t handle;
+#endif
+};
+
+#if defined(_WIN32)
+static unsigned int __stdcall
+dctool_thread_main (void *userdata)
+{
+	dctool_thread_t *thread = (dctool_thread_t *) userdata;
+	thread->func (thread->userdata);
+	return 0;
+}
+#elif defined(HAVE_PTHREAD_H)
+static void *
+dctool_thread_main (void *userdata)
+{
+	dctool_thread_t *thread = (dctool_thread_t *) userdata;
+	thread->func (thread->userdata);
+	return NULL;
+}
+#endif
+
+dc_status_t
+dctool_thread_new (dctool_thread_t **out, dctool_thread_func_t func, void *userdata)
+{
+#if defined(_WIN32) || defined(HAVE_PTHREAD_H)
+	dctool_thread_t *thread = NULL;
+
+	if (out == NULL || func == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	thread = (dctool_thread_t *) malloc (sizeof (dctool_thread_t));
+	if (thread == NULL)
+		return DC_STATUS_NOMEMORY;
+
+	thread->func = func;
+	thread->userdata = userdata;
+
+#if defined(_WIN32)
+	thread->handle = (HANDLE) _beginthreadex (NULL, 0, dctool_thread_main, thread, 0, NULL);
+	if (thread->handle == NULL) {
+		free (thread);
+		return DC_STATUS_IO;
+	}
+#else
+	if (pthread_create (&thread->handle, NULL, dctool_thread_main, thread) != 0) {
+		free (thread);
+		return DC_STATUS_IO;
+	}
+#endif
+
+	*out = thread;
+
+	return DC_STATUS_SUCCESS;
+#else
+	return DC_STATUS_UNSUPPORTED;
+#endif
+}
+
+void
+dctool_thread_join (dctool_thread_t *thread)
+{
+	if (thread == NULL)
+		return;
+
+#if defined(_WIN32)
+	WaitForSingleObject (thread->handle, INFINITE);
+	CloseHandle (thread->handle);
+#elif defined(HAVE_PTHREAD_H)
+	pthread_join (thread->handle, NULL);
+#endif
+
+	free (thread);
+}
+
+struct dctool_mutex_t {
+#if defined(_WIN32)
+	CRITICAL_SECTION handle;
+#elif defined(HAVE_PTHREAD_H)
+	pthread_mutex_t handle;
+#endif
+};
+
+dc_status_t
+dctool_mutex_new (dctool_mutex_t **out)
+{
+#if defined(_WIN32) || defined(HAVE_PTHREAD_H)
+	dctool_mutex_t *mutex = NULL;
+
+	if (out == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	mutex = (dctool_mutex_t *) malloc (sizeof (dctool_mutex_t));
+	if (mutex == NULL)
+		return DC_STATUS_NOMEMORY;
+
+#if defined(_WIN32)
+	InitializeCriticalSection (&mutex->handle);
+#else
+	if (pthread_mutex_init (&mutex->handle, NULL) != 0) {
+		free (mutex);
+		return DC_STATUS_IO;
+	}
+#endif
+
+	*out = mutex;
+
+	return DC_STATUS_SUCCESS;
+#else
+	return DC_STATUS_UNSUPPORTED;
+#endif
+}
+
+void
+dctool_mutex_lock (dctool_mutex_t *mutex)
+{
+#if defined(_WIN32)
+	EnterCriticalSection (&mutex->handle);
+#elif defined(HAVE_PTHREAD_H)
+	pthread_mutex_lock (&mutex->handle);
+#endif
+}
+
+void
+dctool_mutex_unlock (dctool_mutex_t *mutex)
+{
+#if defined(_WIN32)
+	LeaveCriticalSection (&mutex->handle);
+#elif defined(HAVE_PTHREAD_H)
+	pthread_mutex_unlock (&mutex->handle);
+#endif
+}
+
+void
+dctool_mutex_free (dctool_mutex_t *mutex)
+{
+	if (mutex == NULL)
+		return;
+
+#if defined(_WIN32)
+	DeleteCriticalSection (&mutex->handle);
+#elif defined(HAVE_PTHREAD_H)
+	pthread_mutex_destroy (&mutex->handle);
+#endif
+
+	free (mutex);
+}
+
+struct dctool_cond_t {
+#if defined(_WIN32)
+	CONDITION_VARIABLE handle;
+#elif defined(HAVE_PTHREAD_H)
+	pthread_cond_t handle;
+#endif
+};
+
+dc_status_t
+dctool_cond_new (dctool_cond_t **out)
+{
+#if defined(_WIN32) || defined(HAVE_PTHREAD_H)
+	dctool_cond_t *cond = NULL;
+
+	if (out == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	cond = (dctool_cond_t *) malloc (sizeof (dctool_cond_t));
+	if (cond == NULL)
+		return DC_STATUS_NOMEMORY;
+
+#if defined(_WIN32)
+	InitializeConditionVariable (&cond->handle);
+#else
+	if (pthread_cond_init (&cond->handle, NULL) != 0) {
+		free (cond);
+		return DC_STATUS_IO;
+	}
+#endif
+
+	*out = cond;
+
+	return DC_STATUS_SUCCESS;
+#else
+	return DC_STATUS_UNSUPPORTED;
+#endif
+}
+
+void
+dctool_cond_wait (dctool_cond_t *cond, dctool_mutex_t *mutex)
+{
+#if defined(_WIN32)
+	SleepConditionVariableCS (&cond->handle, &mutex->handle, INFINITE);
+#elif defined(HAVE_PTHREAD_H)
+	pthread_cond_wait (&cond->handle, &mutex->handle);
+#endif
+}
+
+void
+dctool_cond_broadcast (dctool_cond_t *cond)
+{
+#if defined(_WIN32)
+	WakeAllConditionVariable (&cond->handle);
+#elif defined(HAVE_PTHREAD_H)
+	pthread_cond_broadcast (&cond->handle);
+#endif
+}
+
+void
+dctool_cond_free (dctool_cond_t *cond)
+{
+	if (cond == NULL)
+		return;
+
+#if defined(_WIN32)
+	// Windows condition variables don't need to be destroyed.
+#elif defined(HAVE_PTHREAD_H)
+	pthread_cond_destroy (&cond->handle);
+#endif
+
+	free (cond);
+}
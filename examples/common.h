@@ -67,9 +67,74 @@ dctool_file_write (const char *filename, dc_buffer_t *buffer);
 dc_buffer_t *
 dctool_file_read (const char *filename);
 
+/*
+ * A memory mapped input file, exposed as a read-only buffer. If the
+ * file can't be mapped (e.g. standard input, or no mmap support), it
+ * is read into memory instead.
+ */
+typedef struct dctool_file_t {
+	dc_buffer_t *buffer;
+	void *mapping;
+	size_t size;
+} dctool_file_t;
+
+int
+dctool_file_map (dctool_file_t *file, const char *filename);
+
+void
+dctool_file_unmap (dctool_file_t *file);
+
 dc_status_t
 dctool_iostream_open (dc_iostream_t **iostream, dc_context_t *context, dc_descriptor_t *descriptor, dc_transport_t transport, const char *devname);
 
+/*
+ * A minimal thread wrapper. The library keeps its own threading
+ * primitives private, so the few commands that need a thread per
+ * device use this instead. Returns DC_STATUS_UNSUPPORTED on platforms
+ * without thread support.
+ */
+typedef struct dctool_thread_t dctool_thread_t;
+
+typedef void (*dctool_thread_func_t) (void *userdata);
+
+dc_status_t
+dctool_thread_new (dctool_thread_t **thread, dctool_thread_func_t func, void *userdata);
+
+void
+dctool_thread_join (dctool_thread_t *thread);
+
+/*
+ * A minimal mutex and condition variable wrapper, for the threads
+ * above.
+ */
+typedef struct dctool_mutex_t dctool_mutex_t;
+
+dc_status_t
+dctool_mutex_new (dctool_mutex_t **mutex);
+
+void
+dctool_mutex_lock (dctool_mutex_t *mutex);
+
+void
+dctool_mutex_unlock (dctool_mutex_t *mutex);
+
+void
+dctool_mutex_free (dctool_mutex_t *mutex);
+
+typedef struct dctool_cond_t dctool_cond_t;
+
+dc_status_t
+dctool_cond_new (dctool_cond_t **cond);
+
+void
+dctool_cond_wait (dctool_cond_t *cond, dctool_mutex_t *mutex);
+
+void
+dctool_cond_broadcast (dctool_cond_t *cond);
+
+void
+dctool_cond_free (dctool_cond_t *cond);
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
@@ -64,6 +64,7 @@ static const dctool_command_t *g_commands[] = {
 	&dctool_download,
 	&dctool_dump,
 	&dctool_parse,
+	&dctool_benchmark,
 	&dctool_read,
 	&dctool_write,
 	&dctool_timesync,
@@ -0,0 +1,338 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2026 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#ifdef HAVE_GETOPT_H
+#include <getopt.h>
+#endif
+#ifdef HAVE_SYS_RESOURCE_H
+#include <sys/resource.h>
+#endif
+
+#include <libdivecomputer/context.h>
+#include <libdivecomputer/descriptor.h>
+#include <libdivecomputer/parser.h>
+
+#include "dctool.h"
+#include "common.h"
+#include "utils.h"
+#include "synthetic.h"
+
+typedef struct benchmark_t {
+	unsigned long long bytes;
+	unsigned long long dives;
+	unsigned long long samples;
+	double seconds;
+} benchmark_t;
+
+static void
+sample_cb (dc_sample_type_t type, const dc_sample_value_t *value, void *userdata)
+{
+	benchmark_t *benchmark = (benchmark_t *) userdata;
+
+	if (type == DC_SAMPLE_TIME)
+		benchmark->samples++;
+}
+
+static dc_status_t
+benchmark_parse (dc_context_t *context, dc_descriptor_t *descriptor, const unsigned char *data, unsigned int size, unsigned int devtime, dc_ticks_t systime, benchmark_t *benchmark)
+{
+	dc_status_t rc = DC_STATUS_SUCCESS;
+	dc_parser_t *parser = NULL;
+
+	rc = dc_parser_new_borrowed (&parser, context, descriptor, data, size);
+	if (rc != DC_STATUS_SUCCESS) {
+		ERROR ("Error creating the parser.");
+		goto cleanup;
+	}
+
+	rc = dc_parser_set_clock (parser, devtime, systime);
+	if (rc != DC_STATUS_SUCCESS && rc != DC_STATUS_UNSUPPORTED) {
+		ERROR ("Error setting the clock.");
+		goto cleanup;
+	}
+
+	// Retrieve the same information as the regular output, but ignore
+	// the values. Unsupported fields are not an error.
+	dc_datetime_t datetime = {0};
+	dc_parser_get_datetime (parser, &datetime);
+
+	unsigned int divetime = 0;
+	dc_parser_get_field (parser, DC_FIELD_DIVETIME, 0, &divetime);
+
+	double depth = 0.0;
+	dc_parser_get_field (parser, DC_FIELD_MAXDEPTH, 0, &depth);
+	dc_parser_get_field (parser, DC_FIELD_AVGDEPTH, 0, &depth);
+
+	unsigned int ngasmixes = 0;
+	dc_parser_get_field (parser, DC_FIELD_GASMIX_COUNT, 0, &ngasmixes);
+	for (unsigned int i = 0; i < ngasmixes; ++i) {
+		dc_gasmix_t gasmix = {0};
+		dc_parser_get_field (parser, DC_FIELD_GASMIX, i, &gasmix);
+	}
+
+	unsigned int ntanks = 0;
+	dc_parser_get_field (parser, DC_FIELD_TANK_COUNT, 0, &ntanks);
+	for (unsigned int i = 0; i < ntanks; ++i) {
+		dc_tank_t tank = {0};
+		dc_parser_get_field (parser, DC_FIELD_TANK, i, &tank);
+	}
+
+	double temperature = 0.0;
+	dc_parser_get_field (parser, DC_FIELD_TEMPERATURE_SURFACE, 0, &temperature);
+	dc_parser_get_field (parser, DC_FIELD_TEMPERATURE_MINIMUM, 0, &temperature);
+	dc_parser_get_field (parser, DC_FIELD_TEMPERATURE_MAXIMUM, 0, &temperature);
+
+	rc = dc_parser_samples_foreach (parser, sample_cb, benchmark);
+	if (rc != DC_STATUS_SUCCESS) {
+		ERROR ("Error parsing the sample data.");
+		goto cleanup;
+	}
+
+	benchmark->dives++;
+	benchmark->bytes += size;
+
+cleanup:
+	dc_parser_destroy (parser);
+	return rc;
+}
+
+static void
+benchmark_print (FILE *fp, const char *name, const benchmark_t *benchmark)
+{
+	double seconds = benchmark->seconds > 0.0 ? benchmark->seconds : 1e-9;
+
+	fprintf (fp, "name=%s bytes=%llu dives=%llu samples=%llu seconds=%.6f dives_per_sec=%.1f samples_per_sec=%.1f bytes_per_sec=%.1f\n",
+		name, benchmark->bytes, benchmark->dives, benchmark->samples, benchmark->seconds,
+		benchmark->dives / seconds, benchmark->samples / seconds, benchmark->bytes / seconds);
+}
+
+static int
+dctool_benchmark_run (int argc, char *argv[], dc_context_t *context, dc_descriptor_t *descriptor)
+{
+	// Default values.
+	int exitcode = EXIT_SUCCESS;
+	dc_status_t status = DC_STATUS_SUCCESS;
+	dc_buffer_t *buffer = NULL;
+	FILE *fp = stdout;
+	benchmark_t total = {0};
+
+	// Default option values.
+	unsigned int help = 0;
+	const char *filename = NULL;
+	unsigned int iterations = 10;
+	unsigned int devtime = 0;
+	dc_ticks_t systime = 0;
+	dctool_synthetic_t synthetic = {0, 10, 40, 0, 0, 1};
+
+	// Parse the command-line options.
+	int opt = 0;
+	const char *optstring = "ho:n:d:s:g:i:x:e:";
+#ifdef HAVE_GETOPT_LONG
+	struct option options[] = {
+		{"help",        no_argument,       0, 'h'},
+		{"output",      required_argument, 0, 'o'},
+		{"iterations",  required_argument, 0, 'n'},
+		{"devtime",     required_argument, 0, 'd'},
+		{"systime",     required_argument, 0, 's'},
+		{"generate",    required_argument, 0, 'g'},
+		{"interval",    required_argument, 0, 'i'},
+		{"gasswitches", required_argument, 0, 'x'},
+		{"events",      required_argument, 0, 'e'},
+		{0,             0,                 0,  0 }
+	};
+	while ((opt = getopt_long (argc, argv, optstring, options, NULL)) != -1) {
+#else
+	while ((opt = getopt (argc, argv, optstring)) != -1) {
+#endif
+		switch (opt) {
+		case 'h':
+			help = 1;
+			break;
+		case 'o':
+			filename = optarg;
+			break;
+		case 'n':
+			iterations = strtoul (optarg, NULL, 0);
+			break;
+		case 'd':
+			devtime = strtoul (optarg, NULL, 0);
+			break;
+		case 's':
+			systime = strtoll (optarg, NULL, 0);
+			break;
+		case 'g':
+			synthetic.duration = strtoul (optarg, NULL, 0);
+			break;
+		case 'i':
+			synthetic.interval = strtoul (optarg, NULL, 0);
+			break;
+		case 'x':
+			synthetic.gasswitches = strtoul (optarg, NULL, 0);
+			break;
+		case 'e':
+			synthetic.events = strtoul (optarg, NULL, 0);
+			break;
+		default:
+			return EXIT_FAILURE;
+		}
+	}
+
+	argc -= optind;
+	argv += optind;
+
+	// Show help message.
+	if (help) {
+		dctool_command_showhelp (&dctool_benchmark);
+		return EXIT_SUCCESS;
+	}
+
+	if (iterations == 0) {
+		message ("Invalid number of iterations.\n");
+		return EXIT_FAILURE;
+	}
+
+	// Open the output file.
+	if (filename) {
+		fp = fopen (filename, "w");
+		if (fp == NULL) {
+			message ("Failed to open the output file.\n");
+			return EXIT_FAILURE;
+		}
+	}
+
+	// A synthetic dive replaces the input files.
+	if (synthetic.duration) {
+		argc = 1;
+	}
+
+	for (int i = 0; i < argc; ++i) {
+		benchmark_t benchmark = {0};
+		const char *name = synthetic.duration ? "synthetic" : argv[i];
+
+		// Read the input file, or generate the synthetic dive.
+		if (synthetic.duration) {
+			buffer = dctool_synthetic_generate (descriptor, &synthetic);
+			if (buffer == NULL) {
+				message ("Failed to generate the synthetic dive.\n");
+				exitcode = EXIT_FAILURE;
+				goto cleanup;
+			}
+		} else {
+			buffer = dctool_file_read (argv[i]);
+			if (buffer == NULL) {
+				message ("Failed to open the input file.\n");
+				exitcode = EXIT_FAILURE;
+				goto cleanup;
+			}
+		}
+
+		// Parse the dive repeatedly. The processor time is used, such
+		// that the results are not affected by other processes.
+		clock_t start = clock ();
+		for (unsigned int n = 0; n < iterations; ++n) {
+			status = benchmark_parse (context, descriptor,
+				dc_buffer_get_data (buffer), dc_buffer_get_size (buffer),
+				devtime, systime, &benchmark);
+			if (status != DC_STATUS_SUCCESS) {
+				message ("ERROR: %s\n", dctool_errmsg (status));
+				exitcode = EXIT_FAILURE;
+				goto cleanup;
+			}
+		}
+		benchmark.seconds = (double) (clock () - start) / CLOCKS_PER_SEC;
+
+		benchmark_print (fp, name, &benchmark);
+
+		total.bytes += benchmark.bytes;
+		total.dives += benchmark.dives;
+		total.samples += benchmark.samples;
+		total.seconds += benchmark.seconds;
+
+		// Cleanup.
+		dc_buffer_free (buffer);
+		buffer = NULL;
+	}
+
+	benchmark_print (fp, "total", &total);
+
+#if defined(HAVE_SYS_RESOURCE_H) && defined(HAVE_GETRUSAGE)
+	struct rusage usage;
+	if (getrusage (RUSAGE_SELF, &usage) == 0) {
+		// The maximum resident set size is reported in bytes on Mac OS X,
+		// and in kilobytes on the other systems.
+#ifdef __APPLE__
+		fprintf (fp, "maxrss_kb=%ld\n", (long) (usage.ru_maxrss / 1024));
+#else
+		fprintf (fp, "maxrss_kb=%ld\n", (long) usage.ru_maxrss);
+#endif
+	}
+#endif
+
+cleanup:
+	dc_buffer_free (buffer);
+	if (fp != stdout)
+		fclose (fp);
+	return exitcode;
+}
+
+const dctool_command_t dctool_benchmark = {
+	dctool_benchmark_run,
+	DCTOOL_CONFIG_DESCRIPTOR,
+	"benchmark",
+	"Measure the parser throughput",
+	"Usage:\n"
+	"   dctool benchmark [options] <filename>...\n"
+	"   dctool benchmark [options] --generate <seconds>\n"
+	"\n"
+	"Options:\n"
+#ifdef HAVE_GETOPT_LONG
+	"   -h, --help                 Show help message\n"
+	"   -o, --output <filename>    Output filename\n"
+	"   -n, --iterations <count>   Number of iterations\n"
+	"   -d, --devtime <timestamp>  Device time\n"
+	"   -s, --systime <timestamp>  System time\n"
+	"   -g, --generate <seconds>   Generate a synthetic dive\n"
+	"   -i, --interval <seconds>   Synthetic sample interval\n"
+	"   -x, --gasswitches <count>  Synthetic gas switches\n"
+	"   -e, --events <count>       Synthetic events per 1000 samples\n"
+#else
+	"   -h              Show help message\n"
+	"   -o <filename>   Output filename\n"
+	"   -n <count>      Number of iterations\n"
+	"   -d <devtime>    Device time\n"
+	"   -s <systime>    System time\n"
+	"   -g <seconds>    Generate a synthetic dive\n"
+	"   -i <seconds>    Synthetic sample interval\n"
+	"   -x <count>      Synthetic gas switches\n"
+	"   -e <count>      Synthetic events per 1000 samples\n"
+#endif
+};
@@ -32,11 +32,22 @@
 #ifdef HAVE_GETOPT_H
 #include <getopt.h>
 #endif
+#if defined(HAVE_SYS_UN_H) && defined(HAVE_POLL_H)
+#define HAVE_SERVE
+#include <errno.h>
+#include <stdarg.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#endif
 
 #include <libdivecomputer/context.h>
 #include <libdivecomputer/descriptor.h>
 #include <libdivecomputer/device.h>
 #include <libdivecomputer/parser.h>
+#include <libdivecomputer/fingerprint.h>
 
 #include "dctool.h"
 #include "common.h"
@@ -45,16 +56,72 @@
 
 typedef struct event_data_t {
 	const char *cachedir;
+	dc_fingerprint_store_t *store;
 	dc_event_devinfo_t devinfo;
+	dc_event_clock_t clock;
+	unsigned int events;
+	dctool_output_t *output;
 } event_data_t;
 
+/*
+ * The devices that share a radio (e.g. all bluetooth connections over
+ * the same adapter) take turns transferring data, with at most a fixed
+ * number of them active at the same time. The turns are handed out in
+ * order of arrival, and the active devices give up their turn at every
+ * dive boundary if anyone else is waiting.
+ */
+typedef struct download_radio_t {
+	dctool_mutex_t *mutex;
+	dctool_cond_t *cond;
+	unsigned int capacity;
+	unsigned int active;
+	unsigned int next;
+	unsigned int head;
+} download_radio_t;
+
 typedef struct dive_data_t {
 	dc_device_t *device;
 	dc_buffer_t **fingerprint;
 	unsigned int number;
 	dctool_output_t *output;
+	download_radio_t *radio;
 } dive_data_t;
 
+static void
+radio_acquire (download_radio_t *radio)
+{
+	dctool_mutex_lock (radio->mutex);
+	unsigned int ticket = radio->next++;
+	while (ticket != radio->head || radio->active >= radio->capacity)
+		dctool_cond_wait (radio->cond, radio->mutex);
+	radio->head++;
+	radio->active++;
+	dctool_cond_broadcast (radio->cond);
+	dctool_mutex_unlock (radio->mutex);
+}
+
+static void
+radio_release (download_radio_t *radio)
+{
+	dctool_mutex_lock (radio->mutex);
+	radio->active--;
+	dctool_cond_broadcast (radio->cond);
+	dctool_mutex_unlock (radio->mutex);
+}
+
+static void
+radio_yield (download_radio_t *radio)
+{
+	dctool_mutex_lock (radio->mutex);
+	unsigned int waiting = radio->next != radio->head;
+	dctool_mutex_unlock (radio->mutex);
+
+	if (waiting) {
+		radio_release (radio);
+		radio_acquire (radio);
+	}
+}
+
 static int
 dive_cb (const unsigned char *data, unsigned int size, const unsigned char *fingerprint, unsigned int fsize, void *userdata)
 {
@@ -64,6 +131,10 @@ dive_cb (const unsigned char *data, unsigned int size, const unsigned char *fing
 
 	divedata->number++;
 
+	// Let the other devices on the radio take a turn.
+	if (divedata->radio)
+		radio_yield (divedata->radio);
+
 	message ("Dive: number=%u, size=%u, fingerprint=", divedata->number, size);
 	for (unsigned int i = 0; i < fsize; ++i)
 		message ("%02X", fingerprint[i]);
@@ -103,29 +174,37 @@ static void
 event_cb (dc_device_t *device, dc_event_type_t event, const void *data, void *userdata)
 {
 	const dc_event_devinfo_t *devinfo = (const dc_event_devinfo_t *) data;
+	const dc_event_clock_t *clock = (const dc_event_clock_t *) data;
 
 	event_data_t *eventdata = (event_data_t *) userdata;
 
 	// Forward to the default event handler.
 	dctool_event_cb (device, event, data, userdata);
 
+	// Forward to the output.
+	if (event == DC_EVENT_DEVINFO || event == DC_EVENT_CLOCK)
+		dctool_output_event (eventdata->output, event, data);
+
 	switch (event) {
 	case DC_EVENT_DEVINFO:
 		// Load the fingerprint from the cache. If there is no
-		// fingerprint present in the cache, a NULL buffer is returned,
+		// fingerprint present in the cache, an empty buffer is used,
 		// and the registered fingerprint will be cleared.
-		if (eventdata->cachedir) {
-			char filename[1024] = {0};
-			dc_family_t family = DC_FAMILY_NULL;
-			dc_buffer_t *fingerprint = NULL;
-
-			// Generate the fingerprint filename.
-			family = dc_device_get_type (device);
-			snprintf (filename, sizeof (filename), "%s/%s-%08X.bin",
-				eventdata->cachedir, dctool_family_name (family), devinfo->serial);
+		if (eventdata->store) {
+			dc_family_t family = dc_device_get_type (device);
+			dc_buffer_t *fingerprint = dc_buffer_new (0);
 
-			// Read the fingerprint file.
-			fingerprint = dctool_file_read (filename);
+			// Look up the fingerprint in the store.
+			dc_status_t rc = dc_fingerprint_store_get (eventdata->store,
+				family, devinfo->model, devinfo->serial, fingerprint);
+			if (rc == DC_STATUS_UNSUPPORTED) {
+				// Fall back to the fingerprint file of older versions.
+				char filename[1024] = {0};
+				snprintf (filename, sizeof (filename), "%s/%s-%08X.bin",
+					eventdata->cachedir, dctool_family_name (family), devinfo->serial);
+				dc_buffer_free (fingerprint);
+				fingerprint = dctool_file_read (filename);
+			}
 
 			// Register the fingerprint data.
 			dc_device_set_fingerprint (device,
@@ -139,6 +218,11 @@ event_cb (dc_device_t *device, dc_event_type_t event, const void *data, void *us
 		// Keep a copy of the event data. It will be used for generating
 		// the fingerprint filename again after a (successful) download.
 		eventdata->devinfo = *devinfo;
+		eventdata->events |= DC_EVENT_DEVINFO;
+		break;
+	case DC_EVENT_CLOCK:
+		eventdata->clock = *clock;
+		eventdata->events |= DC_EVENT_CLOCK;
 		break;
 	default:
 		break;
@@ -146,48 +230,38 @@ event_cb (dc_device_t *device, dc_event_type_t event, const void *data, void *us
 }
 
 static dc_status_t
-download (dc_context_t *context, dc_descriptor_t *descriptor, dc_transport_t transport, const char *devname, const char *cachedir, dc_buffer_t *fingerprint, dctool_output_t *output)
+download_open (dc_device_t **out, dc_iostream_t **iostream, dc_context_t *context, dc_descriptor_t *descriptor, dc_transport_t transport, const char *devname, event_data_t *eventdata)
 {
 	dc_status_t rc = DC_STATUS_SUCCESS;
-	dc_iostream_t *iostream = NULL;
 	dc_device_t *device = NULL;
-	dc_buffer_t *ofingerprint = NULL;
 
 	// Open the I/O stream.
 	message ("Opening the I/O stream (%s, %s).\n",
 		dctool_transport_name (transport),
 		devname ? devname : "null");
-	rc = dctool_iostream_open (&iostream, context, descriptor, transport, devname);
+	rc = dctool_iostream_open (iostream, context, descriptor, transport, devname);
 	if (rc != DC_STATUS_SUCCESS) {
 		ERROR ("Error opening the I/O stream.");
-		goto cleanup;
+		return rc;
 	}
 
 	// Open the device.
 	message ("Opening the device (%s %s).\n",
 		dc_descriptor_get_vendor (descriptor),
 		dc_descriptor_get_product (descriptor));
-	rc = dc_device_open (&device, context, descriptor, iostream);
+	rc = dc_device_open (&device, context, descriptor, *iostream);
 	if (rc != DC_STATUS_SUCCESS) {
 		ERROR ("Error opening the device.");
-		goto cleanup;
-	}
-
-	// Initialize the event data.
-	event_data_t eventdata = {0};
-	if (fingerprint) {
-		eventdata.cachedir = NULL;
-	} else {
-		eventdata.cachedir = cachedir;
+		goto error;
 	}
 
 	// Register the event handler.
 	message ("Registering the event handler.\n");
 	int events = DC_EVENT_WAITING | DC_EVENT_PROGRESS | DC_EVENT_DEVINFO | DC_EVENT_CLOCK | DC_EVENT_VENDOR;
-	rc = dc_device_set_events (device, events, event_cb, &eventdata);
+	rc = dc_device_set_events (device, events, event_cb, eventdata);
 	if (rc != DC_STATUS_SUCCESS) {
 		ERROR ("Error registering the event handler.");
-		goto cleanup;
+		goto error;
 	}
 
 	// Register the cancellation handler.
@@ -195,48 +269,102 @@ download (dc_context_t *context, dc_descriptor_t *descriptor, dc_transport_t tra
 	rc = dc_device_set_cancel (device, dctool_cancel_cb, NULL);
 	if (rc != DC_STATUS_SUCCESS) {
 		ERROR ("Error registering the cancellation handler.");
-		goto cleanup;
+		goto error;
 	}
 
-	// Register the fingerprint data.
-	if (fingerprint) {
-		message ("Registering the fingerprint data.\n");
-		rc = dc_device_set_fingerprint (device, dc_buffer_get_data (fingerprint), dc_buffer_get_size (fingerprint));
-		if (rc != DC_STATUS_SUCCESS) {
-			ERROR ("Error registering the fingerprint data.");
-			goto cleanup;
-		}
-	}
+	*out = device;
+
+	return DC_STATUS_SUCCESS;
+
+error:
+	dc_device_close (device);
+	dc_iostream_close (*iostream);
+	*iostream = NULL;
+	return rc;
+}
+
+static dc_status_t
+download_dives (dc_device_t *device, event_data_t *eventdata, dc_fingerprint_store_t *store, dctool_output_t *output, download_radio_t *radio, dc_buffer_t **fingerprint, unsigned int *ndives)
+{
+	dc_status_t rc = DC_STATUS_SUCCESS;
 
 	// Initialize the dive data.
 	dive_data_t divedata = {0};
 	divedata.device = device;
-	divedata.fingerprint = &ofingerprint;
+	divedata.fingerprint = fingerprint;
 	divedata.number = 0;
 	divedata.output = output;
+	divedata.radio = radio;
+
+	// Pass the device events to the output. Events emitted before this
+	// download (e.g. while opening the device, or during a previous
+	// download on the same connection) are replayed first.
+	eventdata->output = output;
+	if (eventdata->events & DC_EVENT_DEVINFO)
+		dctool_output_event (output, DC_EVENT_DEVINFO, &eventdata->devinfo);
+	if (eventdata->events & DC_EVENT_CLOCK)
+		dctool_output_event (output, DC_EVENT_CLOCK, &eventdata->clock);
 
 	// Download the dives.
 	message ("Downloading the dives.\n");
 	rc = dc_device_foreach (device, dive_cb, &divedata);
+	eventdata->output = NULL;
 	if (rc != DC_STATUS_SUCCESS) {
 		ERROR ("Error downloading the dives.");
-		goto cleanup;
+		return rc;
 	}
 
 	// Store the fingerprint data.
-	if (cachedir && ofingerprint) {
-		char filename[1024] = {0};
-		dc_family_t family = DC_FAMILY_NULL;
+	if (store && *fingerprint) {
+		rc = dc_fingerprint_store_set (store, dc_device_get_type (device),
+			eventdata->devinfo.model, eventdata->devinfo.serial,
+			dc_buffer_get_data (*fingerprint), dc_buffer_get_size (*fingerprint));
+		if (rc != DC_STATUS_SUCCESS) {
+			ERROR ("Error storing the fingerprint data.");
+			return rc;
+		}
+	}
 
-		// Generate the fingerprint filename.
-		family = dc_device_get_type (device);
-		snprintf (filename, sizeof (filename), "%s/%s-%08X.bin",
-			cachedir, dctool_family_name (family), eventdata.devinfo.serial);
+	if (ndives)
+		*ndives = divedata.number;
+
+	return DC_STATUS_SUCCESS;
+}
 
-		// Write the fingerprint file.
-		dctool_file_write (filename, ofingerprint);
+static dc_status_t
+download (dc_context_t *context, dc_descriptor_t *descriptor, dc_transport_t transport, const char *devname, const char *cachedir, dc_fingerprint_store_t *store, dc_buffer_t *fingerprint, dctool_output_t *output, download_radio_t *radio)
+{
+	dc_status_t rc = DC_STATUS_SUCCESS;
+	dc_iostream_t *iostream = NULL;
+	dc_device_t *device = NULL;
+	dc_buffer_t *ofingerprint = NULL;
+
+	// Initialize the event data.
+	event_data_t eventdata = {0};
+	eventdata.cachedir = cachedir;
+	if (fingerprint) {
+		eventdata.store = NULL;
+	} else {
+		eventdata.store = store;
+	}
+
+	rc = download_open (&device, &iostream, context, descriptor, transport, devname, &eventdata);
+	if (rc != DC_STATUS_SUCCESS) {
+		goto cleanup;
 	}
 
+	// Register the fingerprint data.
+	if (fingerprint) {
+		message ("Registering the fingerprint data.\n");
+		rc = dc_device_set_fingerprint (device, dc_buffer_get_data (fingerprint), dc_buffer_get_size (fingerprint));
+		if (rc != DC_STATUS_SUCCESS) {
+			ERROR ("Error registering the fingerprint data.");
+			goto cleanup;
+		}
+	}
+
+	rc = download_dives (device, &eventdata, store, output, radio, &ofingerprint, NULL);
+
 cleanup:
 	dc_buffer_free (ofingerprint);
 	dc_device_close (device);
@@ -244,12 +372,552 @@ cleanup:
 	return rc;
 }
 
+typedef struct download_job_t {
+	dc_context_t *context;
+	dc_descriptor_t *descriptor;
+	dc_transport_t transport;
+	const char *devname;
+	const char *cachedir;
+	dc_fingerprint_store_t *store;
+	dc_buffer_t *fingerprint;
+	dctool_output_t *output;
+	download_radio_t *radio;
+	dctool_thread_t *thread;
+	dc_status_t status;
+} download_job_t;
+
+static void
+download_thread (void *userdata)
+{
+	download_job_t *job = (download_job_t *) userdata;
+
+	if (job->radio)
+		radio_acquire (job->radio);
+
+	job->status = download (job->context, job->descriptor, job->transport, job->devname, job->cachedir, job->store, job->fingerprint, job->output, job->radio);
+
+	if (job->radio)
+		radio_release (job->radio);
+}
+
+static dctool_output_t *
+output_new (const char *format, const char *filename, dctool_units_t units)
+{
+	if (strcasecmp(format, "raw") == 0) {
+		return dctool_raw_output_new (filename);
+	} else if (strcasecmp(format, "xml") == 0) {
+		return dctool_xml_output_new (filename, units);
+	} else if (strcasecmp(format, "binary") == 0) {
+		return dctool_binary_output_new (filename);
+	} else if (strcasecmp(format, "archive") == 0) {
+		return dctool_archive_output_new (filename);
+	} else {
+		return NULL;
+	}
+}
+
+static int
+output_filename (char *buffer, size_t size, const char *filename, unsigned int number)
+{
+	// Insert the device number in front of the file extension, or
+	// append it if there is none.
+	const char *ext = strrchr (filename, '.');
+	if (ext == NULL || strpbrk (ext, "/\\") != NULL)
+		ext = filename + strlen (filename);
+
+	int n = snprintf (buffer, size, "%.*s-%u%s", (int) (ext - filename), filename, number, ext);
+	if (n < 0 || (size_t) n >= size)
+		return -1;
+
+	return n;
+}
+
+static dc_status_t
+download_multiple (dc_context_t *context, dc_descriptor_t *descriptor, dc_transport_t transport, int ndevices, char *devnames[], const char *cachedir, dc_fingerprint_store_t *store, dc_buffer_t *fingerprint, const char *format, const char *filename, dctool_units_t units, unsigned int nradio)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	download_job_t *jobs = NULL;
+	download_radio_t radio = {0};
+	download_radio_t *shared = NULL;
+
+	jobs = (download_job_t *) calloc (ndevices, sizeof (download_job_t));
+	if (jobs == NULL) {
+		ERROR ("Error allocating memory.");
+		return DC_STATUS_NOMEMORY;
+	}
+
+	// The bluetooth connections all go over the same (default) adapter,
+	// and interfere with each other. Limit the number of devices that
+	// transfer data at the same time.
+	if ((transport == DC_TRANSPORT_BLUETOOTH || transport == DC_TRANSPORT_BLE) &&
+		nradio && nradio < (unsigned int) ndevices) {
+		if (dctool_mutex_new (&radio.mutex) != DC_STATUS_SUCCESS ||
+			dctool_cond_new (&radio.cond) != DC_STATUS_SUCCESS) {
+			ERROR ("Error creating the radio scheduler.");
+			status = DC_STATUS_NOMEMORY;
+			goto cleanup;
+		}
+		radio.capacity = nradio;
+		shared = &radio;
+	}
+
+	// Create a separate output for each device.
+	for (int i = 0; i < ndevices; ++i) {
+		char name[1024] = {0};
+		if (output_filename (name, sizeof (name), filename, i + 1) < 0) {
+			ERROR ("Failed to generate the output filename.");
+			status = DC_STATUS_INVALIDARGS;
+			goto cleanup;
+		}
+
+		jobs[i].context = context;
+		jobs[i].descriptor = descriptor;
+		jobs[i].transport = transport;
+		jobs[i].devname = devnames[i];
+		jobs[i].cachedir = cachedir;
+		jobs[i].store = store;
+		jobs[i].fingerprint = fingerprint;
+		jobs[i].radio = shared;
+		jobs[i].output = output_new (format, name, units);
+		if (jobs[i].output == NULL) {
+			message ("Failed to create the output (%s).\n", name);
+			status = DC_STATUS_IO;
+			goto cleanup;
+		}
+
+		message ("Device %u: %s -> %s\n", i + 1, devnames[i], name);
+	}
+
+	// Start one download thread per device.
+	for (int i = 0; i < ndevices; ++i) {
+		dc_status_t rc = dctool_thread_new (&jobs[i].thread, download_thread, jobs + i);
+		if (rc != DC_STATUS_SUCCESS) {
+			ERROR ("Error starting the download thread.");
+			status = rc;
+			break;
+		}
+	}
+
+	// Wait for all downloads to finish.
+	for (int i = 0; i < ndevices; ++i) {
+		if (jobs[i].thread == NULL)
+			continue;
+
+		dctool_thread_join (jobs[i].thread);
+
+		if (jobs[i].status != DC_STATUS_SUCCESS) {
+			message ("Device %u (%s): %s\n", i + 1, jobs[i].devname, dctool_errmsg (jobs[i].status));
+			if (status == DC_STATUS_SUCCESS)
+				status = jobs[i].status;
+		}
+	}
+
+cleanup:
+	for (int i = 0; i < ndevices; ++i) {
+		dctool_output_free (jobs[i].output);
+	}
+	dctool_cond_free (radio.cond);
+	dctool_mutex_free (radio.mutex);
+	free (jobs);
+	return status;
+}
+
+#ifdef HAVE_SERVE
+#define MAXSESSIONS 32
+#define MAXREQUEST  1024
+#define REQUEST_TIMEOUT 30 // seconds
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+/*
+ * A device that stays connected between the jobs. The connection is
+ * only closed again after an error, and is re-opened by the next job.
+ */
+typedef struct download_session_t {
+	char devname[256];
+	dc_iostream_t *iostream;
+	dc_device_t *device;
+	event_data_t eventdata;
+	dctool_mutex_t *mutex;
+} download_session_t;
+
+typedef struct download_server_t {
+	dc_context_t *context;
+	dc_descriptor_t *descriptor;
+	dc_transport_t transport;
+	const char *cachedir;
+	dc_fingerprint_store_t *store;
+	const char *format;
+	dctool_units_t units;
+	dctool_mutex_t *mutex;
+	download_session_t *sessions[MAXSESSIONS];
+	unsigned int nsessions;
+	unsigned int quit;
+} download_server_t;
+
+typedef struct download_request_t {
+	download_server_t *server;
+	int fd;
+	unsigned int done;
+	dctool_thread_t *thread;
+	struct download_request_t *next;
+} download_request_t;
+
+static download_session_t *
+session_find (download_server_t *server, const char *devname)
+{
+	download_session_t *session = NULL;
+
+	dctool_mutex_lock (server->mutex);
+
+	for (unsigned int i = 0; i < server->nsessions; ++i) {
+		if (strcmp (server->sessions[i]->devname, devname) == 0) {
+			session = server->sessions[i];
+			goto cleanup;
+		}
+	}
+
+	if (server->nsessions >= MAXSESSIONS ||
+		strlen (devname) >= sizeof (session->devname))
+		goto cleanup;
+
+	session = (download_session_t *) calloc (1, sizeof (download_session_t));
+	if (session == NULL)
+		goto cleanup;
+
+	if (dctool_mutex_new (&session->mutex) != DC_STATUS_SUCCESS) {
+		free (session);
+		session = NULL;
+		goto cleanup;
+	}
+
+	strcpy (session->devname, devname);
+	session->eventdata.cachedir = server->cachedir;
+	session->eventdata.store = server->store;
+	server->sessions[server->nsessions++] = session;
+
+cleanup:
+	dctool_mutex_unlock (server->mutex);
+	return session;
+}
+
+static void
+session_close (download_session_t *session)
+{
+	dc_device_close (session->device);
+	dc_iostream_close (session->iostream);
+	session->device = NULL;
+	session->iostream = NULL;
+}
+
+static dc_status_t
+session_download (download_server_t *server, download_session_t *session, const char *filename, unsigned int *ndives)
+{
+	dc_status_t rc = DC_STATUS_SUCCESS;
+
+	dctool_output_t *output = output_new (server->format, filename, server->units);
+	if (output == NULL) {
+		return DC_STATUS_IO;
+	}
+
+	dctool_mutex_lock (session->mutex);
+
+	// A connection that was kept open can be lost in the meantime, so
+	// a failed job on a warm session gets one retry on a fresh one.
+	for (unsigned int attempt = 0; attempt < 2; ++attempt) {
+		unsigned int warm = session->device != NULL;
+		dc_buffer_t *fingerprint = NULL;
+
+		if (!warm) {
+			rc = download_open (&session->device, &session->iostream,
+				server->context, server->descriptor, server->transport,
+				session->devname, &session->eventdata);
+			if (rc != DC_STATUS_SUCCESS)
+				break;
+		}
+
+		rc = download_dives (session->device, &session->eventdata, server->store, output, NULL, &fingerprint, ndives);
+		if (rc == DC_STATUS_SUCCESS) {
+			// Continue from the most recent dive next time, for the
+			// backends that only report the device info once.
+			if (fingerprint) {
+				dc_device_set_fingerprint (session->device,
+					dc_buffer_get_data (fingerprint),
+					dc_buffer_get_size (fingerprint));
+			}
+			dc_buffer_free (fingerprint);
+			break;
+		}
+
+		dc_buffer_free (fingerprint);
+		session_close (session);
+		if (!warm || rc == DC_STATUS_CANCELLED)
+			break;
+	}
+
+	dctool_mutex_unlock (session->mutex);
+
+	dctool_output_free (output);
+
+	return rc;
+}
+
+static void
+request_reply (int fd, const char *fmt, ...)
+{
+	char reply[MAXREQUEST] = {0};
+
+	va_list ap;
+	va_start (ap, fmt);
+	int n = vsnprintf (reply, sizeof (reply), fmt, ap);
+	va_end (ap);
+
+	if (n > 0 && (size_t) n < sizeof (reply)) {
+		send (fd, reply, n, MSG_NOSIGNAL);
+	}
+}
+
+/*
+ * A request is a single line, with the device name and the output
+ * filename separated by a space, or the word "quit" to stop the
+ * server. The reply is "OK <number of dives>" or "ERROR <message>".
+ */
+static void
+request_thread (void *userdata)
+{
+	download_request_t *request = (download_request_t *) userdata;
+	download_server_t *server = request->server;
+	char line[MAXREQUEST] = {0};
+	size_t length = 0;
+
+	// Poll with a short timeout, so a client that never completes its
+	// request can't keep the server from shutting down.
+	unsigned int elapsed = 0;
+	while (length + 1 < sizeof (line)) {
+		dctool_mutex_lock (server->mutex);
+		unsigned int quit = server->quit;
+		dctool_mutex_unlock (server->mutex);
+		if (quit || dctool_cancel_cb (NULL) || elapsed >= REQUEST_TIMEOUT)
+			break;
+
+		struct pollfd pfd = {request->fd, POLLIN, 0};
+		int rc = poll (&pfd, 1, 1000);
+		if (rc < 0 && errno != EINTR)
+			break;
+		if (rc <= 0) {
+			elapsed++;
+			continue;
+		}
+
+		ssize_t n = recv (request->fd, line + length, sizeof (line) - length - 1, 0);
+		if (n <= 0)
+			break;
+		length += n;
+		if (memchr (line, '\n', length))
+			break;
+	}
+	line[length] = 0;
+	line[strcspn (line, "\r\n")] = 0;
+
+	char *filename = strchr (line, ' ');
+	if (strcmp (line, "quit") == 0) {
+		dctool_mutex_lock (server->mutex);
+		server->quit = 1;
+		dctool_mutex_unlock (server->mutex);
+		request_reply (request->fd, "OK\n");
+	} else if (filename == NULL || filename == line || filename[1] == 0) {
+		request_reply (request->fd, "ERROR Invalid request\n");
+	} else {
+		*filename++ = 0;
+
+		download_session_t *session = session_find (server, line);
+		if (session == NULL) {
+			request_reply (request->fd, "ERROR Too many devices\n");
+		} else {
+			unsigned int ndives = 0;
+			dc_status_t rc = session_download (server, session, filename, &ndives);
+			if (rc == DC_STATUS_SUCCESS) {
+				request_reply (request->fd, "OK %u\n", ndives);
+			} else {
+				request_reply (request->fd, "ERROR %s\n", dctool_errmsg (rc));
+			}
+		}
+	}
+
+	close (request->fd);
+
+	dctool_mutex_lock (server->mutex);
+	request->done = 1;
+	dctool_mutex_unlock (server->mutex);
+}
+
+/*
+ * Join the requests that are done, or all of them.
+ */
+static download_request_t *
+request_cleanup (download_server_t *server, download_request_t *requests, unsigned int all)
+{
+	download_request_t **link = &requests;
+	while (*link) {
+		download_request_t *request = *link;
+
+		dctool_mutex_lock (server->mutex);
+		unsigned int done = request->done;
+		dctool_mutex_unlock (server->mutex);
+
+		if (done || all) {
+			dctool_thread_join (request->thread);
+			*link = request->next;
+			free (request);
+		} else {
+			link = &request->next;
+		}
+	}
+
+	return requests;
+}
+
+static dc_status_t
+download_serve (dc_context_t *context, dc_descriptor_t *descriptor, dc_transport_t transport, const char *path, const char *cachedir, dc_fingerprint_store_t *store, const char *format, dctool_units_t units)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	download_request_t *requests = NULL;
+	unsigned int bound = 0;
+	int fd = -1;
+
+	download_server_t server = {0};
+	server.context = context;
+	server.descriptor = descriptor;
+	server.transport = transport;
+	server.cachedir = cachedir;
+	server.store = store;
+	server.format = format;
+	server.units = units;
+
+	status = dctool_mutex_new (&server.mutex);
+	if (status != DC_STATUS_SUCCESS) {
+		ERROR ("Error creating the mutex.");
+		return status;
+	}
+
+	struct sockaddr_un addr;
+	memset (&addr, 0, sizeof (addr));
+	addr.sun_family = AF_UNIX;
+	if (strlen (path) >= sizeof (addr.sun_path)) {
+		ERROR ("Socket path too long.");
+		status = DC_STATUS_INVALIDARGS;
+		goto cleanup;
+	}
+	strcpy (addr.sun_path, path);
+
+	fd = socket (AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0) {
+		ERROR ("Error creating the socket.");
+		status = DC_STATUS_IO;
+		goto cleanup;
+	}
+
+	// Only replace a stale socket from a previous run, never any
+	// other kind of file.
+	struct stat st;
+	if (lstat (path, &st) == 0) {
+		if (!S_ISSOCK (st.st_mode)) {
+			ERROR ("The path exists and is not a socket.");
+			status = DC_STATUS_INVALIDARGS;
+			goto cleanup;
+		}
+		unlink (path);
+	}
+
+	if (bind (fd, (struct sockaddr *) &addr, sizeof (addr)) != 0) {
+		ERROR ("Error binding the socket.");
+		status = DC_STATUS_IO;
+		goto cleanup;
+	}
+	bound = 1;
+
+	if (listen (fd, 8) != 0) {
+		ERROR ("Error listening on the socket.");
+		status = DC_STATUS_IO;
+		goto cleanup;
+	}
+
+	// Without MSG_NOSIGNAL, a client that disconnects before reading
+	// its reply would otherwise kill the server.
+	if (MSG_NOSIGNAL == 0)
+		signal (SIGPIPE, SIG_IGN);
+
+	message ("Waiting for requests (%s).\n", path);
+
+	while (!dctool_cancel_cb (NULL)) {
+		dctool_mutex_lock (server.mutex);
+		unsigned int quit = server.quit;
+		dctool_mutex_unlock (server.mutex);
+		if (quit)
+			break;
+
+		requests = request_cleanup (&server, requests, 0);
+
+		// Wake up regularly to check for the quit request and the
+		// cancellation.
+		struct pollfd pfd = {fd, POLLIN, 0};
+		int n = poll (&pfd, 1, 1000);
+		if (n < 0 && errno != EINTR) {
+			ERROR ("Error waiting for requests.");
+			status = DC_STATUS_IO;
+			break;
+		}
+		if (n <= 0)
+			continue;
+
+		int client = accept (fd, NULL, NULL);
+		if (client < 0)
+			continue;
+
+		download_request_t *request = (download_request_t *) calloc (1, sizeof (download_request_t));
+		if (request == NULL) {
+			close (client);
+			continue;
+		}
+
+		request->server = &server;
+		request->fd = client;
+		if (dctool_thread_new (&request->thread, request_thread, request) != DC_STATUS_SUCCESS) {
+			ERROR ("Error starting the request thread.");
+			close (client);
+			free (request);
+			continue;
+		}
+
+		request->next = requests;
+		requests = request;
+	}
+
+cleanup:
+	request_cleanup (&server, requests, 1);
+	for (unsigned int i = 0; i < server.nsessions; ++i) {
+		session_close (server.sessions[i]);
+		dctool_mutex_free (server.sessions[i]->mutex);
+		free (server.sessions[i]);
+	}
+	if (fd >= 0)
+		close (fd);
+	if (bound)
+		unlink (path);
+	dctool_mutex_free (server.mutex);
+	return status;
+}
+#endif
+
 static int
 dctool_download_run (int argc, char *argv[], dc_context_t *context, dc_descriptor_t *descriptor)
 {
 	int exitcode = EXIT_SUCCESS;
 	dc_status_t status = DC_STATUS_SUCCESS;
 	dc_buffer_t *fingerprint = NULL;
+	dc_fingerprint_store_t *store = NULL;
 	dctool_output_t *output = NULL;
 	dctool_units_t units = DCTOOL_UNITS_METRIC;
 	dc_transport_t transport = dctool_transport_default (descriptor);
@@ -260,10 +928,12 @@ dctool_download_run (int argc, char *argv[], dc_context_t *context, dc_descripto
 	const char *filename = NULL;
 	const char *cachedir = NULL;
 	const char *format = "xml";
+	const char *serve = NULL;
+	unsigned int nradio = 2;
 
 	// Parse the command-line options.
 	int opt = 0;
-	const char *optstring = "ht:o:p:c:f:u:";
+	const char *optstring = "ht:o:p:c:f:u:s:r:";
 #ifdef HAVE_GETOPT_LONG
 	struct option options[] = {
 		{"help",        no_argument,       0, 'h'},
@@ -273,6 +943,8 @@ dctool_download_run (int argc, char *argv[], dc_context_t *context, dc_descripto
 		{"cache",       required_argument, 0, 'c'},
 		{"format",      required_argument, 0, 'f'},
 		{"units",       required_argument, 0, 'u'},
+		{"serve",       required_argument, 0, 's'},
+		{"radio",       required_argument, 0, 'r'},
 		{0,             0,                 0,  0 }
 	};
 	while ((opt = getopt_long (argc, argv, optstring, options, NULL)) != -1) {
@@ -304,6 +976,12 @@ dctool_download_run (int argc, char *argv[], dc_context_t *context, dc_descripto
 			if (strcmp (optarg, "imperial") == 0)
 				units = DCTOOL_UNITS_IMPERIAL;
 			break;
+		case 's':
+			serve = optarg;
+			break;
+		case 'r':
+			nradio = strtoul (optarg, NULL, 0);
+			break;
 		default:
 			return EXIT_FAILURE;
 		}
@@ -328,16 +1006,60 @@ dctool_download_run (int argc, char *argv[], dc_context_t *context, dc_descripto
 	// Convert the fingerprint to binary.
 	fingerprint = dctool_convert_hex2bin (fphex);
 
-	// Create the output.
-	if (strcasecmp(format, "raw") == 0) {
-		output = dctool_raw_output_new (filename);
-	} else if (strcasecmp(format, "xml") == 0) {
-		output = dctool_xml_output_new (filename, units);
-	} else {
+	// Check the output format.
+	if (strcasecmp(format, "raw") != 0 &&
+		strcasecmp(format, "xml") != 0 &&
+		strcasecmp(format, "binary") != 0 &&
+		strcasecmp(format, "archive") != 0) {
 		message ("Unknown output format: %s\n", format);
 		exitcode = EXIT_FAILURE;
 		goto cleanup;
 	}
+
+	// Open the fingerprint store.
+	if (cachedir) {
+		char name[1024] = {0};
+		snprintf (name, sizeof (name), "%s/fingerprints.db", cachedir);
+		status = dc_fingerprint_store_open (&store, context, name);
+		if (status != DC_STATUS_SUCCESS) {
+			message ("ERROR: %s\n", dctool_errmsg (status));
+			exitcode = EXIT_FAILURE;
+			goto cleanup;
+		}
+	}
+
+	// Run as a service, with the jobs coming in over the socket.
+	if (serve) {
+#ifdef HAVE_SERVE
+		status = download_serve (context, descriptor, transport, serve, cachedir, store, format, units);
+#else
+		status = DC_STATUS_UNSUPPORTED;
+#endif
+		if (status != DC_STATUS_SUCCESS) {
+			message ("ERROR: %s\n", dctool_errmsg (status));
+			exitcode = EXIT_FAILURE;
+		}
+		goto cleanup;
+	}
+
+	// Download from several devices at once.
+	if (argc > 1) {
+		if (filename == NULL) {
+			message ("No output filename specified.\n");
+			exitcode = EXIT_FAILURE;
+			goto cleanup;
+		}
+
+		status = download_multiple (context, descriptor, transport, argc, argv, cachedir, store, fingerprint, format, filename, units, nradio);
+		if (status != DC_STATUS_SUCCESS) {
+			message ("ERROR: %s\n", dctool_errmsg (status));
+			exitcode = EXIT_FAILURE;
+		}
+		goto cleanup;
+	}
+
+	// Create the output.
+	output = output_new (format, filename, units);
 	if (output == NULL) {
 		message ("Failed to create the output.\n");
 		exitcode = EXIT_FAILURE;
@@ -345,7 +1067,7 @@ dctool_download_run (int argc, char *argv[], dc_context_t *context, dc_descripto
 	}
 
 	// Download the dives.
-	status = download (context, descriptor, transport, argv[0], cachedir, fingerprint, output);
+	status = download (context, descriptor, transport, argv[0], cachedir, store, fingerprint, output, NULL);
 	if (status != DC_STATUS_SUCCESS) {
 		message ("ERROR: %s\n", dctool_errmsg (status));
 		exitcode = EXIT_FAILURE;
@@ -354,6 +1076,7 @@ dctool_download_run (int argc, char *argv[], dc_context_t *context, dc_descripto
 
 cleanup:
 	dctool_output_free (output);
+	dc_fingerprint_store_close (store);
 	dc_buffer_free (fingerprint);
 	return exitcode;
 }
@@ -364,7 +1087,8 @@ const dctool_command_t dctool_download = {
 	"download",
 	"Download the dives",
 	"Usage:\n"
-	"   dctool download [options] <devname>\n"
+	"   dctool download [options] <devname> [<devname> ...]\n"
+	"   dctool download [options] --serve <socket>\n"
 	"\n"
 	"Options:\n"
 #ifdef HAVE_GETOPT_LONG
@@ -375,6 +1099,8 @@ const dctool_command_t dctool_download = {
 	"   -c, --cache <directory>    Cache directory\n"
 	"   -f, --format <format>      Output format\n"
 	"   -u, --units <units>        Set units (metric or imperial)\n"
+	"   -s, --serve <socket>       Serve download requests\n"
+	"   -r, --radio <count>        Active bluetooth devices (default 2)\n"
 #else
 	"   -h                 Show help message\n"
 	"   -t <transport>     Transport type\n"
@@ -383,7 +1109,31 @@ const dctool_command_t dctool_download = {
 	"   -c <directory>     Cache directory\n"
 	"   -f <format>        Output format\n"
 	"   -u <units>         Set units (metric or imperial)\n"
+	"   -s <socket>        Serve download requests\n"
+	"   -r <count>         Active bluetooth devices (default 2)\n"
 #endif
+	"\n"
+	"When more than one device name is given, all devices are downloaded\n"
+	"at the same time, each on its own thread. Every device gets its own\n"
+	"output, with the device number (1, 2, ...) inserted in front of the\n"
+	"extension of the output filename (e.g. dives-1.xml, dives-2.xml).\n"
+	"\n"
+	"Over bluetooth, the devices share the radio, and only a limited\n"
+	"number of them transfer data at the same time. The others wait for\n"
+	"their turn, and the active devices hand over their turn between the\n"
+	"dives. A count of zero removes the limit.\n"
+	"\n"
+	"In service mode, download requests are accepted over a local socket,\n"
+	"one per connection, with a line containing the device name and the\n"
+	"output filename. Requests for different devices run concurrently.\n"
+	"The devices stay connected between the requests, and the reply is\n"
+	"\"OK <number of dives>\" or \"ERROR <message>\". A \"quit\" request\n"
+	"stops the service.\n"
+	"\n"
+	"The fingerprint of the most recent dive of each device is stored in\n"
+	"the fingerprints.db file in the cache directory, and only newer\n"
+	"dives are downloaded the next time. Fingerprint files of older\n"
+	"versions are still read if the device is not in the store yet.\n"
 	"\n"
 	"Supported output formats:\n"
 	"\n"
@@ -397,6 +1147,19 @@ const dctool_command_t dctool_download = {
 	"      files, the filename is interpreted as a template and should\n"
 	"      contain one or more placeholders.\n"
 	"\n"
+	"   BINARY\n"
+	"\n"
+	"      All dives are exported to a single binary file, with the\n"
+	"      samples stored in fixed width columns (metric units only) and\n"
+	"      an index to locate each dive. See output_binary.c for the\n"
+	"      layout.\n"
+	"\n"
+	"   ARCHIVE\n"
+	"\n"
+	"      All dives are exported to a single raw (binary) file, with an\n"
+	"      index containing the fingerprint, devinfo and clock of each\n"
+	"      dive. See archive.h for the layout.\n"
+	"\n"
 	"Supported template placeholders:\n"
 	"\n"
 	"   %f   Fingerprint (hexadecimal format)\n"
@@ -39,10 +39,48 @@
 
 #include "dctool.h"
 #include "common.h"
+#include "dumpfile.h"
 #include "utils.h"
 
+static int
+dump_cb (unsigned int offset, const unsigned char *data, unsigned int size, void *userdata)
+{
+	FILE *fp = (FILE *) userdata;
+
+	if (fseek (fp, offset, SEEK_SET) != 0 ||
+		fwrite (data, 1, size, fp) != size) {
+		ERROR ("Error writing the memory dump.");
+		return 0;
+	}
+
+	return 1;
+}
+
+static void
+event_cb (dc_device_t *device, dc_event_type_t event, const void *data, void *userdata)
+{
+	dctool_dumpfile_t *dumpfile = (dctool_dumpfile_t *) userdata;
+
+	// Forward to the default event handler.
+	dctool_event_cb (device, event, data, userdata);
+
+	// Keep a copy of the event data for the dump container.
+	if (dumpfile) {
+		switch (event) {
+		case DC_EVENT_DEVINFO:
+			dumpfile->devinfo = *(const dc_event_devinfo_t *) data;
+			break;
+		case DC_EVENT_CLOCK:
+			dumpfile->clock = *(const dc_event_clock_t *) data;
+			break;
+		default:
+			break;
+		}
+	}
+}
+
 static dc_status_t
-dump (dc_context_t *context, dc_descriptor_t *descriptor, dc_transport_t transport, const char *devname, dc_buffer_t *fingerprint, dc_buffer_t *buffer)
+dump (dc_context_t *context, dc_descriptor_t *descriptor, dc_transport_t transport, const char *devname, dc_buffer_t *fingerprint, dc_buffer_t *buffer, FILE *fp, dctool_dumpfile_t *dumpfile)
 {
 	dc_status_t rc = DC_STATUS_SUCCESS;
 	dc_iostream_t *iostream = NULL;
@@ -71,7 +109,7 @@ dump (dc_context_t *context, dc_descriptor_t *descriptor, dc_transport_t transpo
 	// Register the event handler.
 	message ("Registering the event handler.\n");
 	int events = DC_EVENT_WAITING | DC_EVENT_PROGRESS | DC_EVENT_DEVINFO | DC_EVENT_CLOCK | DC_EVENT_VENDOR;
-	rc = dc_device_set_events (device, events, dctool_event_cb, NULL);
+	rc = dc_device_set_events (device, events, event_cb, dumpfile);
 	if (rc != DC_STATUS_SUCCESS) {
 		ERROR ("Error registering the event handler.");
 		goto cleanup;
@@ -95,9 +133,14 @@ dump (dc_context_t *context, dc_descriptor_t *descriptor, dc_transport_t transpo
 		}
 	}
 
-	// Download the memory dump.
+	// Download the memory dump. With an output file, the data is
+	// written as it arrives.
 	message ("Downloading the memory dump.\n");
-	rc = dc_device_dump (device, buffer);
+	if (fp) {
+		rc = dc_device_dump_stream (device, dump_cb, fp);
+	} else {
+		rc = dc_device_dump (device, buffer);
+	}
 	if (rc != DC_STATUS_SUCCESS) {
 		ERROR ("Error downloading the memory dump.");
 		goto cleanup;
@@ -116,22 +159,28 @@ dctool_dump_run (int argc, char *argv[], dc_context_t *context, dc_descriptor_t
 	dc_status_t status = DC_STATUS_SUCCESS;
 	dc_buffer_t *fingerprint = NULL;
 	dc_buffer_t *buffer = NULL;
+	dctool_dumpfile_t *dumpfile = NULL;
+	FILE *fp = NULL;
 	dc_transport_t transport = dctool_transport_default (descriptor);
 
 	// Default option values.
 	unsigned int help = 0;
 	const char *fphex = NULL;
 	const char *filename = NULL;
+	unsigned int container = 0;
+	unsigned int index = 0;
 
 	// Parse the command-line options.
 	int opt = 0;
-	const char *optstring = "ht:o:p:";
+	const char *optstring = "ht:o:p:ci";
 #ifdef HAVE_GETOPT_LONG
 	struct option options[] = {
 		{"help",        no_argument,       0, 'h'},
 		{"transport",   required_argument, 0, 't'},
 		{"output",      required_argument, 0, 'o'},
 		{"fingerprint", required_argument, 0, 'p'},
+		{"container",   no_argument,       0, 'c'},
+		{"index",       no_argument,       0, 'i'},
 		{0,             0,                 0,  0 }
 	};
 	while ((opt = getopt_long (argc, argv, optstring, options, NULL)) != -1) {
@@ -151,6 +200,13 @@ dctool_dump_run (int argc, char *argv[], dc_context_t *context, dc_descriptor_t
 		case 'p':
 			fphex = optarg;
 			break;
+		case 'c':
+			container = 1;
+			break;
+		case 'i':
+			container = 1;
+			index = 1;
+			break;
 		default:
 			return EXIT_FAILURE;
 		}
@@ -175,21 +231,61 @@ dctool_dump_run (int argc, char *argv[], dc_context_t *context, dc_descriptor_t
 	// Convert the fingerprint to binary.
 	fingerprint = dctool_convert_hex2bin (fphex);
 
-	// Allocate a memory buffer.
-	buffer = dc_buffer_new (0);
+	// Open the output file, or allocate a memory buffer for the
+	// standard output. The dump container is written at the end, from
+	// a memory buffer.
+	if (container) {
+		if (filename == NULL) {
+			message ("No output filename specified.\n");
+			exitcode = EXIT_FAILURE;
+			goto cleanup;
+		}
+		dumpfile = dctool_dumpfile_new (descriptor);
+		buffer = dc_buffer_new (0);
+		if (dumpfile == NULL || buffer == NULL) {
+			message ("Failed to allocate memory.\n");
+			exitcode = EXIT_FAILURE;
+			goto cleanup;
+		}
+	} else if (filename) {
+		fp = fopen (filename, "wb");
+		if (fp == NULL) {
+			message ("Failed to open the output file.\n");
+			exitcode = EXIT_FAILURE;
+			goto cleanup;
+		}
+	} else {
+		buffer = dc_buffer_new (0);
+	}
 
 	// Download the memory dump.
-	status = dump (context, descriptor, transport, argv[0], fingerprint, buffer);
+	status = dump (context, descriptor, transport, argv[0], fingerprint, buffer, fp, dumpfile);
 	if (status != DC_STATUS_SUCCESS) {
 		message ("ERROR: %s\n", dctool_errmsg (status));
 		exitcode = EXIT_FAILURE;
 		goto cleanup;
 	}
 
-	// Write the memory dump to disk.
-	dctool_file_write (filename, buffer);
+	if (dumpfile) {
+		// Write the dump container.
+		status = dctool_dumpfile_set_image (dumpfile, descriptor,
+			dc_buffer_get_data (buffer), dc_buffer_get_size (buffer), index);
+		if (status == DC_STATUS_SUCCESS)
+			status = dctool_dumpfile_save (dumpfile, filename);
+		if (status != DC_STATUS_SUCCESS) {
+			message ("ERROR: %s\n", dctool_errmsg (status));
+			exitcode = EXIT_FAILURE;
+			goto cleanup;
+		}
+	} else if (buffer) {
+		// Write the memory dump to the standard output.
+		dctool_file_write (NULL, buffer);
+	}
 
 cleanup:
+	if (fp)
+		fclose (fp);
+	dctool_dumpfile_free (dumpfile);
 	dc_buffer_free (buffer);
 	dc_buffer_free (fingerprint);
 	return exitcode;
@@ -209,10 +305,19 @@ const dctool_command_t dctool_dump = {
 	"   -t, --transport <name>     Transport type\n"
 	"   -o, --output <filename>    Output filename\n"
 	"   -p, --fingerprint <data>   Fingerprint data (hexadecimal)\n"
+	"   -c, --container            Write a dump container\n"
+	"   -i, --index                Add the dive index to the container\n"
 #else
 	"   -h                 Show help message\n"
 	"   -t <transport>     Transport type\n"
 	"   -o <filename>      Output filename\n"
 	"   -p <fingerprint>   Fingerprint data (hexadecimal)\n"
+	"   -c                 Write a dump container\n"
+	"   -i                 Add the dive index to the container\n"
 #endif
+	"\n"
+	"A dump container stores the memory dump together with the device\n"
+	"descriptor, devinfo and clock. With the dive index, it also stores\n"
+	"the location of each dive, such that the dives can be parsed again\n"
+	"without splitting the memory dump. See dumpfile.h for the layout.\n"
 };
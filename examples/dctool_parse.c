@@ -39,22 +39,36 @@
 
 #include "dctool.h"
 #include "output.h"
+#include "archive.h"
+#include "dumpfile.h"
 #include "common.h"
 #include "utils.h"
 
 #define REACTPROWHITE 0x4354
 
+#define NFILES 256
+
+typedef struct parse_batch_t {
+	dctool_output_t *output;
+	unsigned int devtime;
+	dc_ticks_t systime;
+	unsigned int number;
+	const unsigned char **data;
+	const size_t *size;
+	const unsigned char **fingerprint;
+	const unsigned int *fsize;
+	dc_buffer_t **buffers;
+} parse_batch_t;
+
 static dc_status_t
-parse (dc_buffer_t *buffer, dc_context_t *context, dc_descriptor_t *descriptor, unsigned int devtime, dc_ticks_t systime, dctool_output_t *output)
+parse (const unsigned char data[], unsigned int size, const unsigned char fingerprint[], unsigned int fsize, dc_context_t *context, dc_descriptor_t *descriptor, unsigned int devtime, dc_ticks_t systime, dctool_output_t *output)
 {
 	dc_status_t rc = DC_STATUS_SUCCESS;
 	dc_parser_t *parser = NULL;
-	unsigned char *data = dc_buffer_get_data (buffer);
-	unsigned int size = dc_buffer_get_size (buffer);
 
 	// Create the parser.
 	message ("Creating the parser.\n");
-	rc = dc_parser_new2 (&parser, context, descriptor, data, size);
+	rc = dc_parser_new_borrowed (&parser, context, descriptor, data, size);
 	if (rc != DC_STATUS_SUCCESS) {
 		ERROR ("Error creating the parser.");
 		goto cleanup;
@@ -70,7 +84,7 @@ parse (dc_buffer_t *buffer, dc_context_t *context, dc_descriptor_t *descriptor,
 
 	// Parse the dive data.
 	message ("Parsing the dive data.\n");
-	rc = dctool_output_write (output, parser, data, size, NULL, 0);
+	rc = dctool_output_write (output, parser, data, size, fingerprint, fsize);
 	if (rc != DC_STATUS_SUCCESS) {
 		ERROR ("Error parsing the dive data.");
 		goto cleanup;
@@ -81,13 +95,287 @@ cleanup:
 	return rc;
 }
 
+static dc_status_t
+parse_archive (const char *filename, dc_context_t *context, dc_descriptor_t *descriptor, unsigned int devtime, dc_ticks_t systime, dctool_output_t *output)
+{
+	dc_status_t rc = DC_STATUS_SUCCESS;
+	dctool_archive_t *archive = NULL;
+
+	rc = dctool_archive_open (&archive, filename);
+	if (rc != DC_STATUS_SUCCESS) {
+		ERROR ("Error opening the archive.");
+		return rc;
+	}
+
+	unsigned int count = dctool_archive_count (archive);
+	for (unsigned int i = 0; i < count; ++i) {
+		const dctool_archive_entry_t *entry = dctool_archive_get (archive, i);
+
+		// Use the clock of the download, if there is one.
+		dc_event_clock_t clock = entry->clock;
+		if (clock.devtime == 0 && clock.systime == 0) {
+			clock.devtime = devtime;
+			clock.systime = systime;
+		}
+
+		dctool_output_event (output, DC_EVENT_DEVINFO, &entry->devinfo);
+		dctool_output_event (output, DC_EVENT_CLOCK, &clock);
+
+		rc = parse (entry->data, entry->size, entry->fsize ? entry->fingerprint : NULL, entry->fsize,
+			context, descriptor, clock.devtime, clock.systime, output);
+		if (rc != DC_STATUS_SUCCESS)
+			break;
+	}
+
+	dctool_archive_close (archive);
+
+	return rc;
+}
+
+static dc_status_t
+parse_batch_cb (dc_parser_t *parser, unsigned int index, void *userdata)
+{
+	parse_batch_t *batch = (parse_batch_t *) userdata;
+	dc_status_t rc = DC_STATUS_SUCCESS;
+
+	rc = dc_parser_set_clock (parser, batch->devtime, batch->systime);
+	if (rc != DC_STATUS_SUCCESS && rc != DC_STATUS_UNSUPPORTED) {
+		ERROR ("Error setting the clock.");
+		return rc;
+	}
+
+	const unsigned char *fingerprint = batch->fingerprint ? batch->fingerprint[index] : NULL;
+	unsigned int fsize = batch->fsize ? batch->fsize[index] : 0;
+
+	rc = dctool_output_render (batch->output, batch->number + index + 1, parser,
+		batch->data[index], batch->size[index], fingerprint, fsize, batch->buffers[index]);
+	if (rc != DC_STATUS_SUCCESS) {
+		ERROR ("Error parsing the dive data.");
+		return rc;
+	}
+
+	return DC_STATUS_SUCCESS;
+}
+
+static dc_status_t
+parse_container (const char *filename, dc_context_t *context, dc_descriptor_t *descriptor, unsigned int jobs, dctool_output_t *output, unsigned int *number)
+{
+	dc_status_t rc = DC_STATUS_SUCCESS;
+	dctool_dumpfile_t *dumpfile = NULL;
+	unsigned int count = 0;
+	const unsigned char **data = NULL;
+	size_t *size = NULL;
+	const unsigned char **fingerprint = NULL;
+	unsigned int *fsize = NULL;
+	dc_buffer_t **buffers = NULL;
+	dc_status_t *status = NULL;
+
+	rc = dctool_dumpfile_open (&dumpfile, filename);
+	if (rc != DC_STATUS_SUCCESS) {
+		ERROR ("Error opening the dump container.");
+		return rc;
+	}
+
+	if (!dctool_dumpfile_match (dumpfile, descriptor)) {
+		message ("Warning: the dump container is from a %s %s.\n",
+			dumpfile->vendor, dumpfile->product);
+	}
+
+	// Split the memory dump, unless the boundaries of the dives are
+	// already known.
+	if (!dumpfile->indexed) {
+		rc = dctool_dumpfile_set_image (dumpfile, descriptor, dumpfile->image, dumpfile->isize, 1);
+		if (rc != DC_STATUS_SUCCESS)
+			goto cleanup;
+	}
+
+	dctool_output_event (output, DC_EVENT_DEVINFO, &dumpfile->devinfo);
+	dctool_output_event (output, DC_EVENT_CLOCK, &dumpfile->clock);
+
+	count = dumpfile->ndives;
+	unsigned int n = count ? count : 1;
+	data = (const unsigned char **) calloc (n, sizeof (unsigned char *));
+	size = (size_t *) calloc (n, sizeof (size_t));
+	fingerprint = (const unsigned char **) calloc (n, sizeof (unsigned char *));
+	fsize = (unsigned int *) calloc (n, sizeof (unsigned int));
+	if (data == NULL || size == NULL || fingerprint == NULL || fsize == NULL) {
+		ERROR ("Failed to allocate memory.");
+		rc = DC_STATUS_NOMEMORY;
+		goto cleanup;
+	}
+
+	for (unsigned int i = 0; i < count; ++i) {
+		unsigned int length = 0;
+		data[i] = dctool_dumpfile_get_dive (dumpfile, i, &length);
+		size[i] = length;
+		fsize[i] = dumpfile->dives[i].fsize;
+		fingerprint[i] = fsize[i] ? dumpfile->dives[i].fingerprint : NULL;
+	}
+
+	if (jobs == 1) {
+		for (unsigned int i = 0; i < count; ++i) {
+			rc = parse (data[i], size[i], fingerprint[i], fsize[i], context, descriptor,
+				dumpfile->clock.devtime, dumpfile->clock.systime, output);
+			if (rc != DC_STATUS_SUCCESS)
+				goto cleanup;
+			(*number)++;
+		}
+		goto cleanup;
+	}
+
+	// Parse the dives on a pool of worker threads, and write the
+	// results in the original order afterwards.
+	buffers = (dc_buffer_t **) calloc (n, sizeof (dc_buffer_t *));
+	status = (dc_status_t *) calloc (n, sizeof (dc_status_t));
+	if (buffers == NULL || status == NULL) {
+		ERROR ("Failed to allocate memory.");
+		rc = DC_STATUS_NOMEMORY;
+		goto cleanup;
+	}
+
+	for (unsigned int i = 0; i < count; ++i) {
+		buffers[i] = dc_buffer_new (0);
+		if (buffers[i] == NULL) {
+			ERROR ("Failed to allocate memory.");
+			rc = DC_STATUS_NOMEMORY;
+			goto cleanup;
+		}
+	}
+
+	parse_batch_t batch = {output, dumpfile->clock.devtime, dumpfile->clock.systime,
+		*number, data, size, fingerprint, fsize, buffers};
+	dc_parse_batch (context, descriptor, data, size, count, jobs, parse_batch_cb, &batch, status);
+
+	for (unsigned int i = 0; i < count && rc == DC_STATUS_SUCCESS; ++i) {
+		if (status[i] == DC_STATUS_SUCCESS) {
+			rc = dctool_output_commit (output, buffers[i]);
+			(*number)++;
+		} else {
+			rc = status[i];
+		}
+	}
+
+cleanup:
+	if (buffers) {
+		for (unsigned int i = 0; i < count; ++i) {
+			dc_buffer_free (buffers[i]);
+		}
+	}
+	free (status);
+	free (buffers);
+	free (fsize);
+	free (fingerprint);
+	free (size);
+	free (data);
+	dctool_dumpfile_free (dumpfile);
+	return rc;
+}
+
+static dc_status_t
+parse_parallel (int argc, char *argv[], dc_context_t *context, dc_descriptor_t *descriptor, unsigned int devtime, dc_ticks_t systime, unsigned int map, unsigned int jobs, dctool_output_t *output)
+{
+	dc_status_t rc = DC_STATUS_SUCCESS;
+	unsigned int capacity = NFILES;
+	if (capacity < jobs * 4)
+		capacity = jobs * 4;
+
+	// The files are processed in chunks, to limit the amount of memory
+	// used for the input data and the formatted output. Each chunk is
+	// parsed on the worker threads, and the results are written in the
+	// original order afterwards.
+	dctool_file_t *files = (dctool_file_t *) calloc (capacity, sizeof (dctool_file_t));
+	const unsigned char **data = (const unsigned char **) calloc (capacity, sizeof (unsigned char *));
+	size_t *size = (size_t *) calloc (capacity, sizeof (size_t));
+	dc_buffer_t **buffers = (dc_buffer_t **) calloc (capacity, sizeof (dc_buffer_t *));
+	dc_status_t *status = (dc_status_t *) calloc (capacity, sizeof (dc_status_t));
+	if (files == NULL || data == NULL || size == NULL || buffers == NULL || status == NULL) {
+		ERROR ("Failed to allocate memory.");
+		rc = DC_STATUS_NOMEMORY;
+		goto cleanup;
+	}
+
+	for (unsigned int i = 0; i < capacity; ++i) {
+		buffers[i] = dc_buffer_new (0);
+		if (buffers[i] == NULL) {
+			ERROR ("Failed to allocate memory.");
+			rc = DC_STATUS_NOMEMORY;
+			goto cleanup;
+		}
+	}
+
+	parse_batch_t batch = {output, devtime, systime, 0, data, size, NULL, NULL, buffers};
+
+	for (int offset = 0; offset < argc; offset += capacity) {
+		unsigned int count = argc - offset;
+		if (count > capacity)
+			count = capacity;
+
+		// Read the input files.
+		dc_status_t error = DC_STATUS_SUCCESS;
+		for (unsigned int i = 0; i < count; ++i) {
+			if (map) {
+				dctool_file_map (&files[i], argv[offset + i]);
+			} else {
+				files[i].buffer = dctool_file_read (argv[offset + i]);
+			}
+			if (files[i].buffer == NULL) {
+				message ("Failed to open the input file.\n");
+				error = DC_STATUS_IO;
+				count = i;
+				break;
+			}
+
+			data[i] = dc_buffer_get_data (files[i].buffer);
+			size[i] = dc_buffer_get_size (files[i].buffer);
+
+			// Only reached if the batch fails before parsing the dive.
+			status[i] = DC_STATUS_NOMEMORY;
+		}
+
+		// Parse the dives.
+		batch.number = offset;
+		dc_parse_batch (context, descriptor, data, size, count, jobs, parse_batch_cb, &batch, status);
+
+		// Write the results in input order, up to the first error.
+		for (unsigned int i = 0; i < count; ++i) {
+			if (rc == DC_STATUS_SUCCESS) {
+				if (status[i] == DC_STATUS_SUCCESS) {
+					rc = dctool_output_commit (output, buffers[i]);
+				} else {
+					rc = status[i];
+				}
+			}
+
+			dctool_file_unmap (&files[i]);
+		}
+
+		if (rc == DC_STATUS_SUCCESS)
+			rc = error;
+		if (rc != DC_STATUS_SUCCESS)
+			break;
+	}
+
+cleanup:
+	if (buffers) {
+		for (unsigned int i = 0; i < capacity; ++i) {
+			dc_buffer_free (buffers[i]);
+		}
+	}
+	free (status);
+	free (buffers);
+	free (size);
+	free (data);
+	free (files);
+	return rc;
+}
+
 static int
 dctool_parse_run (int argc, char *argv[], dc_context_t *context, dc_descriptor_t *descriptor)
 {
 	// Default values.
 	int exitcode = EXIT_SUCCESS;
 	dc_status_t status = DC_STATUS_SUCCESS;
-	dc_buffer_t *buffer = NULL;
+	dctool_file_t file = {NULL, NULL, 0};
 	dctool_output_t *output = NULL;
 	dctool_units_t units = DCTOOL_UNITS_METRIC;
 
@@ -96,10 +384,15 @@ dctool_parse_run (int argc, char *argv[], dc_context_t *context, dc_descriptor_t
 	const char *filename = NULL;
 	unsigned int devtime = 0;
 	dc_ticks_t systime = 0;
+	unsigned int map = 0;
+	const char *format = "xml";
+	unsigned int jobs = 1;
+	unsigned int archive = 0;
+	unsigned int container = 0;
 
 	// Parse the command-line options.
 	int opt = 0;
-	const char *optstring = "ho:d:s:u:";
+	const char *optstring = "ho:d:s:u:mf:j:ac";
 #ifdef HAVE_GETOPT_LONG
 	struct option options[] = {
 		{"help",        no_argument,       0, 'h'},
@@ -107,6 +400,11 @@ dctool_parse_run (int argc, char *argv[], dc_context_t *context, dc_descriptor_t
 		{"devtime",     required_argument, 0, 'd'},
 		{"systime",     required_argument, 0, 's'},
 		{"units",       required_argument, 0, 'u'},
+		{"mmap",        no_argument,       0, 'm'},
+		{"format",      required_argument, 0, 'f'},
+		{"jobs",        required_argument, 0, 'j'},
+		{"archive",     no_argument,       0, 'a'},
+		{"container",   no_argument,       0, 'c'},
 		{0,             0,                 0,  0 }
 	};
 	while ((opt = getopt_long (argc, argv, optstring, options, NULL)) != -1) {
@@ -132,6 +430,21 @@ dctool_parse_run (int argc, char *argv[], dc_context_t *context, dc_descriptor_t
 			if (strcmp (optarg, "imperial") == 0)
 				units = DCTOOL_UNITS_IMPERIAL;
 			break;
+		case 'm':
+			map = 1;
+			break;
+		case 'f':
+			format = optarg;
+			break;
+		case 'j':
+			jobs = strtoul (optarg, NULL, 0);
+			break;
+		case 'a':
+			archive = 1;
+			break;
+		case 'c':
+			container = 1;
+			break;
 		default:
 			return EXIT_FAILURE;
 		}
@@ -147,37 +460,87 @@ dctool_parse_run (int argc, char *argv[], dc_context_t *context, dc_descriptor_t
 	}
 
 	// Create the output.
-	output = dctool_xml_output_new (filename, units);
+	if (strcasecmp(format, "xml") == 0) {
+		output = dctool_xml_output_new (filename, units);
+	} else if (strcasecmp(format, "binary") == 0) {
+		output = dctool_binary_output_new (filename);
+	} else if (strcasecmp(format, "archive") == 0) {
+		output = dctool_archive_output_new (filename);
+	} else {
+		message ("Unknown output format: %s\n", format);
+		exitcode = EXIT_FAILURE;
+		goto cleanup;
+	}
 	if (output == NULL) {
 		message ("Failed to create the output.\n");
 		exitcode = EXIT_FAILURE;
 		goto cleanup;
 	}
 
-	for (int i = 0; i < argc; ++i) {
-		// Read the input file.
-		buffer = dctool_file_read (argv[i]);
-		if (buffer == NULL) {
-			message ("Failed to open the input file.\n");
-			exitcode = EXIT_FAILURE;
-			goto cleanup;
-		}
+	if (!archive && !container) {
+		dc_event_clock_t clock = {devtime, systime};
+		dctool_output_event (output, DC_EVENT_CLOCK, &clock);
+	}
 
-		// Parse the dive.
-		status = parse (buffer, context, descriptor, devtime, systime, output);
+	if (container) {
+		// Parse the dives in the dump containers.
+		unsigned int number = 0;
+		for (int i = 0; i < argc; ++i) {
+			status = parse_container (argv[i], context, descriptor, jobs, output, &number);
+			if (status != DC_STATUS_SUCCESS) {
+				message ("ERROR: %s\n", dctool_errmsg (status));
+				exitcode = EXIT_FAILURE;
+				goto cleanup;
+			}
+		}
+	} else if (archive) {
+		// Parse the dives in the archives.
+		for (int i = 0; i < argc; ++i) {
+			status = parse_archive (argv[i], context, descriptor, devtime, systime, output);
+			if (status != DC_STATUS_SUCCESS) {
+				message ("ERROR: %s\n", dctool_errmsg (status));
+				exitcode = EXIT_FAILURE;
+				goto cleanup;
+			}
+		}
+	} else if (jobs != 1) {
+		// Parse the dives on a pool of worker threads.
+		status = parse_parallel (argc, argv, context, descriptor, devtime, systime, map, jobs, output);
 		if (status != DC_STATUS_SUCCESS) {
 			message ("ERROR: %s\n", dctool_errmsg (status));
 			exitcode = EXIT_FAILURE;
 			goto cleanup;
 		}
+	} else {
+		for (int i = 0; i < argc; ++i) {
+			// Read the input file.
+			if (map) {
+				dctool_file_map (&file, argv[i]);
+			} else {
+				file.buffer = dctool_file_read (argv[i]);
+			}
+			if (file.buffer == NULL) {
+				message ("Failed to open the input file.\n");
+				exitcode = EXIT_FAILURE;
+				goto cleanup;
+			}
+
+			// Parse the dive.
+			status = parse (dc_buffer_get_data (file.buffer), dc_buffer_get_size (file.buffer),
+				NULL, 0, context, descriptor, devtime, systime, output);
+			if (status != DC_STATUS_SUCCESS) {
+				message ("ERROR: %s\n", dctool_errmsg (status));
+				exitcode = EXIT_FAILURE;
+				goto cleanup;
+			}
 
-		// Cleanup.
-		dc_buffer_free (buffer);
-		buffer = NULL;
+			// Cleanup.
+			dctool_file_unmap (&file);
+		}
 	}
 
 cleanup:
-	dc_buffer_free (buffer);
+	dctool_file_unmap (&file);
 	dctool_output_free (output);
 	return exitcode;
 }
@@ -197,11 +560,29 @@ const dctool_command_t dctool_parse = {
 	"   -d, --devtime <timestamp>  Device time\n"
 	"   -s, --systime <timestamp>  System time\n"
 	"   -u, --units <units>        Set units (metric or imperial)\n"
+	"   -m, --mmap                 Memory map the input files\n"
+	"   -f, --format <format>      Output format (xml, binary or archive)\n"
+	"   -j, --jobs <count>         Number of parallel jobs (0 for all processors)\n"
+	"   -a, --archive              Read the dives from archives\n"
+	"   -c, --container            Read the dives from dump containers\n"
 #else
 	"   -h              Show help message\n"
 	"   -o <filename>   Output filename\n"
 	"   -d <devtime>    Device time\n"
 	"   -s <systime>    System time\n"
 	"   -u <units>      Set units (metric or imperial)\n"
+	"   -m              Memory map the input files\n"
+	"   -f <format>     Output format (xml, binary or archive)\n"
+	"   -j <count>      Number of parallel jobs (0 for all processors)\n"
+	"   -a              Read the dives from archives\n"
+	"   -c              Read the dives from dump containers\n"
 #endif
+	"\n"
+	"Archives are parsed on a single thread, with the devinfo and clock\n"
+	"stored for each dive. The device and system time options only apply\n"
+	"to dives without a clock.\n"
+	"\n"
+	"Dump containers are split into dives with their dive index, and only\n"
+	"if there is none with the backend for the device. The clock stored\n"
+	"in the container is used for all its dives.\n"
 };
@@ -45,6 +45,48 @@
 #include "common.h"
 #include "utils.h"
 
+static void
+print (dc_transport_t transport, void *device)
+{
+	char buffer[DC_BLUETOOTH_SIZE];
+	switch (transport) {
+	case DC_TRANSPORT_SERIAL:
+		printf ("%s\n", dc_serial_device_get_name (device));
+		dc_serial_device_free (device);
+		break;
+	case DC_TRANSPORT_IRDA:
+		printf ("%08x\t%s\n", dc_irda_device_get_address (device), dc_irda_device_get_name (device));
+		dc_irda_device_free (device);
+		break;
+	case DC_TRANSPORT_BLUETOOTH:
+		printf ("%s\t%s\n",
+			dc_bluetooth_addr2str(dc_bluetooth_device_get_address (device), buffer, sizeof(buffer)),
+			dc_bluetooth_device_get_name (device));
+		dc_bluetooth_device_free (device);
+		break;
+	case DC_TRANSPORT_USB:
+		printf ("%04x:%04x\n", dc_usb_device_get_vid (device), dc_usb_device_get_pid (device));
+		dc_usb_device_free (device);
+		break;
+	case DC_TRANSPORT_USBHID:
+		printf ("%04x:%04x\n", dc_usbhid_device_get_vid (device), dc_usbhid_device_get_pid (device));
+		dc_usbhid_device_free (device);
+		break;
+	default:
+		break;
+	}
+}
+
+static int
+scan_cb (dc_transport_t transport, void *device, void *userdata)
+{
+	printf ("%s\t", dctool_transport_name (transport));
+	print (transport, device);
+	fflush (stdout);
+
+	return 1;
+}
+
 static dc_status_t
 scan (dc_context_t *context, dc_descriptor_t *descriptor, dc_transport_t transport)
 {
@@ -80,33 +122,7 @@ scan (dc_context_t *context, dc_descriptor_t *descriptor, dc_transport_t transpo
 	// Enumerate the devices.
 	void *device = NULL;
 	while ((status = dc_iterator_next (iterator, &device)) == DC_STATUS_SUCCESS) {
-		char buffer[DC_BLUETOOTH_SIZE];
-		switch (transport) {
-		case DC_TRANSPORT_SERIAL:
-			printf ("%s\n", dc_serial_device_get_name (device));
-			dc_serial_device_free (device);
-			break;
-		case DC_TRANSPORT_IRDA:
-			printf ("%08x\t%s\n", dc_irda_device_get_address (device), dc_irda_device_get_name (device));
-			dc_irda_device_free (device);
-			break;
-		case DC_TRANSPORT_BLUETOOTH:
-			printf ("%s\t%s\n",
-				dc_bluetooth_addr2str(dc_bluetooth_device_get_address (device), buffer, sizeof(buffer)),
-				dc_bluetooth_device_get_name (device));
-			dc_bluetooth_device_free (device);
-			break;
-		case DC_TRANSPORT_USB:
-			printf ("%04x:%04x\n", dc_usb_device_get_vid (device), dc_usb_device_get_pid (device));
-			dc_usb_device_free (device);
-			break;
-		case DC_TRANSPORT_USBHID:
-			printf ("%04x:%04x\n", dc_usbhid_device_get_vid (device), dc_usbhid_device_get_pid (device));
-			dc_usbhid_device_free (device);
-			break;
-		default:
-			break;
-		}
+		print (transport, device);
 	}
 	if (status != DC_STATUS_SUCCESS && status != DC_STATUS_DONE) {
 		ERROR ("Failed to enumerate the devices.");
@@ -128,14 +144,16 @@ dctool_scan_run (int argc, char *argv[], dc_context_t *context, dc_descriptor_t
 
 	// Default option values.
 	unsigned int help = 0;
+	unsigned int all = 0;
 	dc_transport_t transport = dctool_transport_default (descriptor);
 
 	// Parse the command-line options.
 	int opt = 0;
-	const char *optstring = "ht:";
+	const char *optstring = "hat:";
 #ifdef HAVE_GETOPT_LONG
 	struct option options[] = {
 		{"help",        no_argument,       0, 'h'},
+		{"all",         no_argument,       0, 'a'},
 		{"transport",   required_argument, 0, 't'},
 		{0,             0,                 0,  0 }
 	};
@@ -147,6 +165,9 @@ dctool_scan_run (int argc, char *argv[], dc_context_t *context, dc_descriptor_t
 		case 'h':
 			help = 1;
 			break;
+		case 'a':
+			all = 1;
+			break;
 		case 't':
 			transport = dctool_transport_type (optarg);
 			break;
@@ -164,6 +185,18 @@ dctool_scan_run (int argc, char *argv[], dc_context_t *context, dc_descriptor_t
 		return EXIT_SUCCESS;
 	}
 
+	// Scan all transports in parallel.
+	if (all) {
+		status = dc_descriptor_scan (context, descriptor,
+			descriptor ? dc_descriptor_get_transports (descriptor) : ~0u,
+			scan_cb, NULL);
+		if (status != DC_STATUS_SUCCESS) {
+			message ("ERROR: %s\n", dctool_errmsg (status));
+			exitcode = EXIT_FAILURE;
+		}
+		goto cleanup;
+	}
+
 	// Check the transport type.
 	if (transport == DC_TRANSPORT_NONE) {
 		message ("No valid transport type specified.\n");
@@ -194,9 +227,11 @@ const dctool_command_t dctool_scan = {
 	"Options:\n"
 #ifdef HAVE_GETOPT_LONG
 	"   -h, --help               Show help message\n"
+	"   -a, --all                Scan all transports in parallel\n"
 	"   -t, --transport <name>   Transport type\n"
 #else
 	"   -h               Show help message\n"
+	"   -a               Scan all transports in parallel\n"
 	"   -t <transport>   Transport type\n"
 #endif
 };
@@ -0,0 +1,356 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2026 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#include "dumpfile.h"
+#include "utils.h"
+
+#define MAGIC    "DCTD"
+#define VERSION  1
+
+#define SZ_HEADER 128
+#define SZ_ENTRY  48
+#define NOINDEX   0xFFFFFFFF
+
+static void
+dumpfile_set_uint32 (unsigned char buffer[], unsigned int value)
+{
+	buffer[0] = (value      ) & 0xFF;
+	buffer[1] = (value >>  8) & 0xFF;
+	buffer[2] = (value >> 16) & 0xFF;
+	buffer[3] = (value >> 24) & 0xFF;
+}
+
+static unsigned int
+dumpfile_get_uint32 (const unsigned char data[])
+{
+	return data[0] | (data[1] << 8) | (data[2] << 16) | ((unsigned int) data[3] << 24);
+}
+
+static void
+dumpfile_name (char buffer[32], const char *name)
+{
+	memset (buffer, 0, 32);
+	if (name)
+		strncpy (buffer, name, 31);
+}
+
+dctool_dumpfile_t *
+dctool_dumpfile_new (dc_descriptor_t *descriptor)
+{
+	dctool_dumpfile_t *dumpfile = (dctool_dumpfile_t *) calloc (1, sizeof (dctool_dumpfile_t));
+	if (dumpfile == NULL) {
+		ERROR ("Failed to allocate memory.");
+		return NULL;
+	}
+
+	if (descriptor) {
+		dumpfile->family = dc_descriptor_get_type (descriptor);
+		dumpfile->model = dc_descriptor_get_model (descriptor);
+		dumpfile_name (dumpfile->vendor, dc_descriptor_get_vendor (descriptor));
+		dumpfile_name (dumpfile->product, dc_descriptor_get_product (descriptor));
+	}
+
+	return dumpfile;
+}
+
+static int
+dumpfile_dive_cb (const unsigned char *data, unsigned int size, const unsigned char *fingerprint, unsigned int fsize, void *userdata)
+{
+	dctool_dumpfile_t *dumpfile = (dctool_dumpfile_t *) userdata;
+
+	if (fsize > DCTOOL_DUMPFILE_FINGERPRINT)
+		fsize = 0;
+
+	if (dumpfile->ndives == dumpfile->nalloc) {
+		unsigned int nalloc = dumpfile->nalloc ? dumpfile->nalloc * 2 : 64;
+		dctool_dumpfile_dive_t *dives = (dctool_dumpfile_dive_t *) realloc (dumpfile->dives, nalloc * sizeof (dctool_dumpfile_dive_t));
+		if (dives == NULL)
+			return 0;
+		dumpfile->dives = dives;
+		dumpfile->nalloc = nalloc;
+	}
+
+	dctool_dumpfile_dive_t *dive = dumpfile->dives + dumpfile->ndives;
+	memset (dive, 0, sizeof (*dive));
+
+	// Dives that are not stored in place in the memory image are
+	// copied to the extra dive data.
+	if (data >= dumpfile->image && size <= dumpfile->isize &&
+		(size_t) (data - dumpfile->image) <= dumpfile->isize - size) {
+		dive->offset = data - dumpfile->image;
+	} else {
+		dive->offset = dumpfile->isize + dc_buffer_get_size (dumpfile->ebuffer);
+		if (!dc_buffer_append (dumpfile->ebuffer, data, size))
+			return 0;
+	}
+	dive->size = size;
+	dive->fsize = fsize;
+	if (fsize)
+		memcpy (dive->fingerprint, fingerprint, fsize);
+
+	dumpfile->ndives++;
+
+	return 1;
+}
+
+dc_status_t
+dctool_dumpfile_set_image (dctool_dumpfile_t *dumpfile, dc_descriptor_t *descriptor, const unsigned char image[], unsigned int size, unsigned int index)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+
+	if (dumpfile == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	dumpfile->image = image;
+	dumpfile->isize = size;
+	dumpfile->extra = NULL;
+	dumpfile->esize = 0;
+	dumpfile->ndives = 0;
+	dumpfile->indexed = 0;
+
+	if (!index)
+		return DC_STATUS_SUCCESS;
+
+	if (dumpfile->ebuffer == NULL) {
+		dumpfile->ebuffer = dc_buffer_new (0);
+		if (dumpfile->ebuffer == NULL) {
+			ERROR ("Failed to allocate memory.");
+			return DC_STATUS_NOMEMORY;
+		}
+	}
+	dc_buffer_clear (dumpfile->ebuffer);
+
+	dc_buffer_t *buffer = dc_buffer_new_view (image, size);
+	if (buffer == NULL) {
+		ERROR ("Failed to allocate memory.");
+		return DC_STATUS_NOMEMORY;
+	}
+
+	status = dc_device_extract_dives (descriptor, buffer, dumpfile_dive_cb, dumpfile);
+	dc_buffer_free (buffer);
+	if (status != DC_STATUS_SUCCESS) {
+		ERROR ("Error extracting the dives.");
+		dumpfile->ndives = 0;
+		return status;
+	}
+
+	dumpfile->extra = dc_buffer_get_data (dumpfile->ebuffer);
+	dumpfile->esize = dc_buffer_get_size (dumpfile->ebuffer);
+	dumpfile->indexed = 1;
+
+	return DC_STATUS_SUCCESS;
+}
+
+dc_status_t
+dctool_dumpfile_save (dctool_dumpfile_t *dumpfile, const char *filename)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+
+	if (dumpfile == NULL || filename == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	unsigned char header[SZ_HEADER] = {0};
+	memcpy (header, MAGIC, 4);
+	dumpfile_set_uint32 (header +   4, VERSION);
+	dumpfile_set_uint32 (header +   8, dumpfile->family);
+	dumpfile_set_uint32 (header +  12, dumpfile->model);
+	memcpy (header + 16, dumpfile->vendor, 31);
+	memcpy (header + 48, dumpfile->product, 31);
+	dumpfile_set_uint32 (header +  80, dumpfile->devinfo.model);
+	dumpfile_set_uint32 (header +  84, dumpfile->devinfo.firmware);
+	dumpfile_set_uint32 (header +  88, dumpfile->devinfo.serial);
+	dumpfile_set_uint32 (header +  92, dumpfile->clock.devtime);
+	dumpfile_set_uint32 (header +  96, (unsigned long long) dumpfile->clock.systime & 0xFFFFFFFF);
+	dumpfile_set_uint32 (header + 100, (unsigned long long) dumpfile->clock.systime >> 32);
+	dumpfile_set_uint32 (header + 104, dumpfile->isize);
+	dumpfile_set_uint32 (header + 108, dumpfile->esize);
+	dumpfile_set_uint32 (header + 112, dumpfile->indexed ? dumpfile->ndives : NOINDEX);
+
+	FILE *fp = fopen (filename, "wb");
+	if (fp == NULL) {
+		ERROR ("Failed to open the output file.");
+		return DC_STATUS_IO;
+	}
+
+	if (fwrite (header, 1, sizeof (header), fp) != sizeof (header) ||
+		fwrite (dumpfile->image, 1, dumpfile->isize, fp) != dumpfile->isize ||
+		fwrite (dumpfile->extra, 1, dumpfile->esize, fp) != dumpfile->esize) {
+		status = DC_STATUS_IO;
+	}
+
+	for (unsigned int i = 0; i < dumpfile->ndives && dumpfile->indexed && status == DC_STATUS_SUCCESS; ++i) {
+		const dctool_dumpfile_dive_t *dive = dumpfile->dives + i;
+		unsigned char entry[SZ_ENTRY] = {0};
+		dumpfile_set_uint32 (entry + 0, dive->offset);
+		dumpfile_set_uint32 (entry + 4, dive->size);
+		dumpfile_set_uint32 (entry + 8, dive->fsize);
+		memcpy (entry + 16, dive->fingerprint, dive->fsize);
+		if (fwrite (entry, 1, sizeof (entry), fp) != sizeof (entry))
+			status = DC_STATUS_IO;
+	}
+
+	if (fclose (fp) != 0)
+		status = DC_STATUS_IO;
+
+	if (status != DC_STATUS_SUCCESS) {
+		ERROR ("Failed to write the dump container.");
+	}
+
+	return status;
+}
+
+dc_status_t
+dctool_dumpfile_open (dctool_dumpfile_t **out, const char *filename)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+
+	if (out == NULL || filename == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	dctool_dumpfile_t *dumpfile = dctool_dumpfile_new (NULL);
+	if (dumpfile == NULL)
+		return DC_STATUS_NOMEMORY;
+
+	if (!dctool_file_map (&dumpfile->file, filename)) {
+		ERROR ("Failed to open the dump container.");
+		status = DC_STATUS_IO;
+		goto error_free;
+	}
+
+	const unsigned char *data = dc_buffer_get_data (dumpfile->file.buffer);
+	size_t size = dc_buffer_get_size (dumpfile->file.buffer);
+
+	// Check the file header.
+	if (size < SZ_HEADER ||
+		memcmp (data, MAGIC, 4) != 0 ||
+		dumpfile_get_uint32 (data + 4) != VERSION) {
+		ERROR ("Unsupported dump container format.");
+		status = DC_STATUS_DATAFORMAT;
+		goto error_free;
+	}
+
+	dumpfile->family = dumpfile_get_uint32 (data + 8);
+	dumpfile->model = dumpfile_get_uint32 (data + 12);
+	memcpy (dumpfile->vendor, data + 16, 31);
+	memcpy (dumpfile->product, data + 48, 31);
+	dumpfile->devinfo.model = dumpfile_get_uint32 (data + 80);
+	dumpfile->devinfo.firmware = dumpfile_get_uint32 (data + 84);
+	dumpfile->devinfo.serial = dumpfile_get_uint32 (data + 88);
+	dumpfile->clock.devtime = dumpfile_get_uint32 (data + 92);
+	dumpfile->clock.systime = (dc_ticks_t) (dumpfile_get_uint32 (data + 96) |
+		((unsigned long long) dumpfile_get_uint32 (data + 100) << 32));
+	dumpfile->isize = dumpfile_get_uint32 (data + 104);
+	dumpfile->esize = dumpfile_get_uint32 (data + 108);
+
+	unsigned int ndives = dumpfile_get_uint32 (data + 112);
+	unsigned long long length = dumpfile->isize + (unsigned long long) dumpfile->esize;
+	unsigned long long total = SZ_HEADER + length;
+	if (ndives != NOINDEX)
+		total += ndives * (unsigned long long) SZ_ENTRY;
+	if (total > size) {
+		ERROR ("Unexpected end of the dump container.");
+		status = DC_STATUS_DATAFORMAT;
+		goto error_free;
+	}
+
+	dumpfile->image = data + SZ_HEADER;
+	dumpfile->extra = dumpfile->image + dumpfile->isize;
+
+	// Read the dive index.
+	if (ndives != NOINDEX) {
+		dumpfile->dives = (dctool_dumpfile_dive_t *) calloc (ndives ? ndives : 1, sizeof (dctool_dumpfile_dive_t));
+		if (dumpfile->dives == NULL) {
+			ERROR ("Failed to allocate memory.");
+			status = DC_STATUS_NOMEMORY;
+			goto error_free;
+		}
+
+		const unsigned char *p = dumpfile->extra + dumpfile->esize;
+		for (unsigned int i = 0; i < ndives; ++i, p += SZ_ENTRY) {
+			dctool_dumpfile_dive_t *dive = dumpfile->dives + i;
+			dive->offset = dumpfile_get_uint32 (p + 0);
+			dive->size = dumpfile_get_uint32 (p + 4);
+			dive->fsize = dumpfile_get_uint32 (p + 8);
+			if (dive->offset > length || dive->size > length - dive->offset ||
+				dive->fsize > DCTOOL_DUMPFILE_FINGERPRINT) {
+				ERROR ("Invalid dive index.");
+				status = DC_STATUS_DATAFORMAT;
+				goto error_free;
+			}
+			memcpy (dive->fingerprint, p + 16, dive->fsize);
+		}
+
+		dumpfile->ndives = ndives;
+		dumpfile->nalloc = ndives;
+		dumpfile->indexed = 1;
+	}
+
+	*out = dumpfile;
+
+	return DC_STATUS_SUCCESS;
+
+error_free:
+	dctool_dumpfile_free (dumpfile);
+	return status;
+}
+
+int
+dctool_dumpfile_match (dctool_dumpfile_t *dumpfile, dc_descriptor_t *descriptor)
+{
+	if (dumpfile == NULL || descriptor == NULL)
+		return 0;
+
+	return dumpfile->family == dc_descriptor_get_type (descriptor) &&
+		dumpfile->model == dc_descriptor_get_model (descriptor);
+}
+
+const unsigned char *
+dctool_dumpfile_get_dive (dctool_dumpfile_t *dumpfile, unsigned int index, unsigned int *size)
+{
+	if (dumpfile == NULL || !dumpfile->indexed || index >= dumpfile->ndives)
+		return NULL;
+
+	const dctool_dumpfile_dive_t *dive = dumpfile->dives + index;
+
+	if (size)
+		*size = dive->size;
+
+	if (dive->offset < dumpfile->isize)
+		return dumpfile->image + dive->offset;
+	else
+		return dumpfile->extra + (dive->offset - dumpfile->isize);
+}
+
+void
+dctool_dumpfile_free (dctool_dumpfile_t *dumpfile)
+{
+	if (dumpfile == NULL)
+		return;
+
+	free (dumpfile->dives);
+	dc_buffer_free (dumpfile->ebuffer);
+	dctool_file_unmap (&dumpfile->file);
+	free (dumpfile);
+}
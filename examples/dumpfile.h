@@ -0,0 +1,137 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2026 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+#ifndef DCTOOL_DUMPFILE_H
+#define DCTOOL_DUMPFILE_H
+
+#include <libdivecomputer/common.h>
+#include <libdivecomputer/buffer.h>
+#include <libdivecomputer/descriptor.h>
+#include <libdivecomputer/device.h>
+
+#include "common.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/*
+ * Dump container format
+ *
+ * A memory dump together with the information needed to parse it
+ * again later. All values are stored in little endian byte order.
+ *
+ * File header (128 bytes):
+ *
+ *   0   char[4]  Magic "DCTD"
+ *   4   uint32   Format version (1)
+ *   8   uint32   Family (descriptor)
+ *   12  uint32   Model (descriptor)
+ *   16  char[32] Vendor name (descriptor, padded with zeros)
+ *   48  char[32] Product name (descriptor, padded with zeros)
+ *   80  uint32   Model (devinfo event)
+ *   84  uint32   Firmware (devinfo event)
+ *   88  uint32   Serial number (devinfo event)
+ *   92  uint32   Device time (clock event)
+ *   96  int64    System time (clock event)
+ *   104 uint32   Size of the memory image (M)
+ *   108 uint32   Size of the extra dive data (E)
+ *   112 uint32   Number of dives in the index (D, 0xFFFFFFFF if none)
+ *   116 uint8[]  Reserved (0)
+ *
+ * The memory image (M bytes) and the extra dive data (E bytes) follow
+ * the header. Dives that are not stored contiguously in the memory
+ * image (e.g. when they wrap around the end of a ringbuffer) are
+ * stored once more in the extra dive data.
+ *
+ * Dive index entry (48 bytes, D entries after the extra dive data):
+ *
+ *   0   uint32   Offset of the dive (from the start of the image)
+ *   4   uint32   Size of the dive
+ *   8   uint32   Size of the fingerprint (F)
+ *   12  uint32   Reserved (0)
+ *   16  uint8[]  Fingerprint (F bytes, padded with zeros to 32 bytes)
+ */
+
+#define DCTOOL_DUMPFILE_FINGERPRINT 32
+
+typedef struct dctool_dumpfile_dive_t {
+	unsigned int offset;
+	unsigned int size;
+	unsigned char fingerprint[DCTOOL_DUMPFILE_FINGERPRINT];
+	unsigned int fsize;
+} dctool_dumpfile_dive_t;
+
+typedef struct dctool_dumpfile_t {
+	dc_family_t family;
+	unsigned int model;
+	char vendor[32];
+	char product[32];
+	dc_event_devinfo_t devinfo;
+	dc_event_clock_t clock;
+	const unsigned char *image;
+	unsigned int isize;
+	const unsigned char *extra;
+	unsigned int esize;
+	// Dive boundaries, only valid if indexed is set.
+	dctool_dumpfile_dive_t *dives;
+	unsigned int ndives;
+	unsigned int indexed;
+	// Storage owned by the container.
+	dctool_file_t file;
+	dc_buffer_t *ebuffer;
+	unsigned int nalloc;
+} dctool_dumpfile_t;
+
+dctool_dumpfile_t *
+dctool_dumpfile_new (dc_descriptor_t *descriptor);
+
+/*
+ * Attach a memory image, and optionally build the dive index by
+ * splitting it with dc_device_extract_dives(). The image must remain
+ * valid until the container is freed.
+ */
+dc_status_t
+dctool_dumpfile_set_image (dctool_dumpfile_t *dumpfile, dc_descriptor_t *descriptor, const unsigned char image[], unsigned int size, unsigned int index);
+
+dc_status_t
+dctool_dumpfile_save (dctool_dumpfile_t *dumpfile, const char *filename);
+
+dc_status_t
+dctool_dumpfile_open (dctool_dumpfile_t **dumpfile, const char *filename);
+
+/*
+ * Check whether the container matches the descriptor (family and
+ * model).
+ */
+int
+dctool_dumpfile_match (dctool_dumpfile_t *dumpfile, dc_descriptor_t *descriptor);
+
+const unsigned char *
+dctool_dumpfile_get_dive (dctool_dumpfile_t *dumpfile, unsigned int index, unsigned int *size);
+
+void
+dctool_dumpfile_free (dctool_dumpfile_t *dumpfile);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+#endif /* DCTOOL_DUMPFILE_H */
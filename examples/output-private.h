@@ -24,6 +24,7 @@
 
 #include <libdivecomputer/common.h>
 #include <libdivecomputer/parser.h>
+#include <libdivecomputer/device.h>
 
 #include "output.h"
 
@@ -44,6 +45,12 @@ struct dctool_output_vtable_t {
 	dc_status_t (*write) (dctool_output_t *output, dc_parser_t *parser, const unsigned char data[], unsigned int size, const unsigned char fingerprint[], unsigned int fsize);
 
 	dc_status_t (*free) (dctool_output_t *output);
+
+	dc_status_t (*render) (dctool_output_t *output, unsigned int number, dc_parser_t *parser, const unsigned char data[], unsigned int size, const unsigned char fingerprint[], unsigned int fsize, dc_buffer_t *buffer);
+
+	dc_status_t (*commit) (dctool_output_t *output, const unsigned char data[], unsigned int size);
+
+	dc_status_t (*event) (dctool_output_t *output, dc_event_type_t event, const void *data);
 };
 
 dctool_output_t *
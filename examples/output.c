@@ -61,6 +61,40 @@ dctool_output_write (dctool_output_t *output, dc_parser_t *parser, const unsigne
 	return output->vtable->write (output, parser, data, size, fingerprint, fsize);
 }
 
+dc_status_t
+dctool_output_render (dctool_output_t *output, unsigned int number, dc_parser_t *parser, const unsigned char data[], unsigned int size, const unsigned char fingerprint[], unsigned int fsize, dc_buffer_t *buffer)
+{
+	if (output == NULL || buffer == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	if (output->vtable->render == NULL || output->vtable->commit == NULL)
+		return DC_STATUS_UNSUPPORTED;
+
+	dc_buffer_clear (buffer);
+
+	return output->vtable->render (output, number, parser, data, size, fingerprint, fsize, buffer);
+}
+
+dc_status_t
+dctool_output_commit (dctool_output_t *output, dc_buffer_t *buffer)
+{
+	if (output == NULL || output->vtable->commit == NULL)
+		return DC_STATUS_SUCCESS;
+
+	output->number++;
+
+	return output->vtable->commit (output, dc_buffer_get_data (buffer), dc_buffer_get_size (buffer));
+}
+
+dc_status_t
+dctool_output_event (dctool_output_t *output, dc_event_type_t event, const void *data)
+{
+	if (output == NULL || output->vtable->event == NULL)
+		return DC_STATUS_SUCCESS;
+
+	return output->vtable->event (output, event, data);
+}
+
 dc_status_t
 dctool_output_free (dctool_output_t *output)
 {
@@ -24,6 +24,8 @@
 
 #include <libdivecomputer/common.h>
 #include <libdivecomputer/parser.h>
+#include <libdivecomputer/buffer.h>
+#include <libdivecomputer/device.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -42,9 +44,38 @@ dctool_xml_output_new (const char *filename, dctool_units_t units);
 dctool_output_t *
 dctool_raw_output_new (const char *template);
 
+dctool_output_t *
+dctool_binary_output_new (const char *filename);
+
+dctool_output_t *
+dctool_archive_output_new (const char *filename);
+
 dc_status_t
 dctool_output_write (dctool_output_t *output, dc_parser_t *parser, const unsigned char data[], unsigned int size, const unsigned char fingerprint[], unsigned int fsize);
 
+/*
+ * Format a dive into a memory buffer, without writing it to the
+ * output. Unlike dctool_output_write(), this doesn't modify the output
+ * and can be called from several threads at the same time. The dive
+ * number is passed explicitly. Returns DC_STATUS_UNSUPPORTED if the
+ * output format doesn't support rendering.
+ */
+dc_status_t
+dctool_output_render (dctool_output_t *output, unsigned int number, dc_parser_t *parser, const unsigned char data[], unsigned int size, const unsigned char fingerprint[], unsigned int fsize, dc_buffer_t *buffer);
+
+/*
+ * Write a dive previously formatted with dctool_output_render().
+ */
+dc_status_t
+dctool_output_commit (dctool_output_t *output, dc_buffer_t *buffer);
+
+/*
+ * Pass a device event (e.g. the devinfo and clock events) to the
+ * output. It applies to all the dives written afterwards.
+ */
+dc_status_t
+dctool_output_event (dctool_output_t *output, dc_event_type_t event, const void *data);
+
 dc_status_t
 dctool_output_free (dctool_output_t *output);
 
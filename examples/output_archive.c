@@ -0,0 +1,291 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2026 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#include "output-private.h"
+#include "archive.h"
+#include "utils.h"
+
+/*
+ * Archive output format
+ *
+ * The raw dive data is appended to a single file, and the index with
+ * the fingerprint, devinfo and clock of each dive is written when the
+ * output is closed. See archive.h for the layout of the file.
+ */
+
+static dc_status_t dctool_archive_output_write (dctool_output_t *output, dc_parser_t *parser, const unsigned char data[], unsigned int size, const unsigned char fingerprint[], unsigned int fsize);
+static dc_status_t dctool_archive_output_free (dctool_output_t *output);
+static dc_status_t dctool_archive_output_render (dctool_output_t *output, unsigned int number, dc_parser_t *parser, const unsigned char data[], unsigned int size, const unsigned char fingerprint[], unsigned int fsize, dc_buffer_t *buffer);
+static dc_status_t dctool_archive_output_commit (dctool_output_t *output, const unsigned char data[], unsigned int size);
+static dc_status_t dctool_archive_output_event (dctool_output_t *output, dc_event_type_t event, const void *data);
+
+typedef struct dctool_archive_output_t {
+	dctool_output_t base;
+	FILE *ostream;
+	unsigned long long offset;
+	// Index entries, in the on-disk format.
+	unsigned char *index;
+	unsigned int ndives, nalloc;
+	// Most recent device events.
+	dc_event_devinfo_t devinfo;
+	dc_event_clock_t clock;
+	// Index entry and dive data, reused for every dive.
+	dc_buffer_t *record;
+} dctool_archive_output_t;
+
+static const dctool_output_vtable_t archive_vtable = {
+	sizeof(dctool_archive_output_t), /* size */
+	dctool_archive_output_write, /* write */
+	dctool_archive_output_free, /* free */
+	dctool_archive_output_render, /* render */
+	dctool_archive_output_commit, /* commit */
+	dctool_archive_output_event, /* event */
+};
+
+static void
+archive_uint32 (unsigned char buffer[], unsigned int value)
+{
+	buffer[0] = (value      ) & 0xFF;
+	buffer[1] = (value >>  8) & 0xFF;
+	buffer[2] = (value >> 16) & 0xFF;
+	buffer[3] = (value >> 24) & 0xFF;
+}
+
+static void
+archive_uint64 (unsigned char buffer[], unsigned long long value)
+{
+	archive_uint32 (buffer + 0, value & 0xFFFFFFFF);
+	archive_uint32 (buffer + 4, value >> 32);
+}
+
+static int
+archive_write (dctool_archive_output_t *output, const unsigned char data[], size_t size)
+{
+	if (size && fwrite (data, 1, size, output->ostream) != size)
+		return -1;
+
+	output->offset += size;
+
+	return 0;
+}
+
+/*
+ * A rendered dive is the index entry, without the offset, followed by
+ * the raw dive data.
+ */
+static dc_status_t
+archive_render (dctool_archive_output_t *output, unsigned int number, const unsigned char data[], unsigned int size, const unsigned char fingerprint[], unsigned int fsize, dc_buffer_t *record)
+{
+	if (fsize > DCTOOL_ARCHIVE_FINGERPRINT) {
+		ERROR ("Fingerprint too large.");
+		return DC_STATUS_INVALIDARGS;
+	}
+
+	if (!dc_buffer_resize (record, DCTOOL_ARCHIVE_ENTRY) ||
+		!dc_buffer_append (record, data, size)) {
+		ERROR ("Failed to allocate memory.");
+		return DC_STATUS_NOMEMORY;
+	}
+
+	unsigned char *p = dc_buffer_get_data (record);
+	memset (p, 0, DCTOOL_ARCHIVE_ENTRY);
+	archive_uint32 (p +  8, size);
+	archive_uint32 (p + 12, number);
+	archive_uint32 (p + 16, output->devinfo.model);
+	archive_uint32 (p + 20, output->devinfo.firmware);
+	archive_uint32 (p + 24, output->devinfo.serial);
+	archive_uint32 (p + 28, output->clock.devtime);
+	archive_uint64 (p + 32, output->clock.systime);
+	archive_uint32 (p + 40, fsize);
+	if (fsize)
+		memcpy (p + 48, fingerprint, fsize);
+
+	return DC_STATUS_SUCCESS;
+}
+
+dctool_output_t *
+dctool_archive_output_new (const char *filename)
+{
+	dctool_archive_output_t *output = NULL;
+
+	if (filename == NULL)
+		goto error_exit;
+
+	// Allocate memory.
+	output = (dctool_archive_output_t *) dctool_output_allocate (&archive_vtable);
+	if (output == NULL) {
+		goto error_exit;
+	}
+
+	output->offset = 0;
+	output->index = NULL;
+	output->ndives = 0;
+	output->nalloc = 0;
+	memset (&output->devinfo, 0, sizeof (output->devinfo));
+	memset (&output->clock, 0, sizeof (output->clock));
+
+	output->record = dc_buffer_new (0);
+	if (output->record == NULL) {
+		goto error_free;
+	}
+
+	// Open the output file.
+	output->ostream = fopen (filename, "wb");
+	if (output->ostream == NULL) {
+		goto error_free_record;
+	}
+
+	// Write the file header. The offset of the index is filled in
+	// when the output is closed.
+	unsigned char header[DCTOOL_ARCHIVE_HEADER] = {0};
+	memcpy (header, DCTOOL_ARCHIVE_MAGIC, 4);
+	archive_uint32 (header + 4, DCTOOL_ARCHIVE_VERSION);
+	if (archive_write (output, header, sizeof(header)) != 0) {
+		goto error_close;
+	}
+
+	return (dctool_output_t *) output;
+
+error_close:
+	fclose (output->ostream);
+error_free_record:
+	dc_buffer_free (output->record);
+error_free:
+	dctool_output_deallocate ((dctool_output_t *) output);
+error_exit:
+	return NULL;
+}
+
+static dc_status_t
+dctool_archive_output_write (dctool_output_t *abstract, dc_parser_t *parser, const unsigned char data[], unsigned int size, const unsigned char fingerprint[], unsigned int fsize)
+{
+	dctool_archive_output_t *output = (dctool_archive_output_t *) abstract;
+	dc_status_t status = DC_STATUS_SUCCESS;
+
+	dc_buffer_clear (output->record);
+
+	status = archive_render (output, abstract->number, data, size, fingerprint, fsize, output->record);
+	if (status != DC_STATUS_SUCCESS)
+		return status;
+
+	return dctool_archive_output_commit (abstract, dc_buffer_get_data (output->record), dc_buffer_get_size (output->record));
+}
+
+static dc_status_t
+dctool_archive_output_render (dctool_output_t *abstract, unsigned int number, dc_parser_t *parser, const unsigned char data[], unsigned int size, const unsigned char fingerprint[], unsigned int fsize, dc_buffer_t *buffer)
+{
+	dctool_archive_output_t *output = (dctool_archive_output_t *) abstract;
+
+	return archive_render (output, number, data, size, fingerprint, fsize, buffer);
+}
+
+static dc_status_t
+dctool_archive_output_commit (dctool_output_t *abstract, const unsigned char data[], unsigned int size)
+{
+	dctool_archive_output_t *output = (dctool_archive_output_t *) abstract;
+
+	if (size < DCTOOL_ARCHIVE_ENTRY)
+		return DC_STATUS_INVALIDARGS;
+
+	// Add the dive to the index.
+	if (output->ndives == output->nalloc) {
+		unsigned int nalloc = output->nalloc ? output->nalloc * 2 : 64;
+		unsigned char *index = (unsigned char *) realloc (output->index, (size_t) nalloc * DCTOOL_ARCHIVE_ENTRY);
+		if (index == NULL)
+			return DC_STATUS_NOMEMORY;
+		output->index = index;
+		output->nalloc = nalloc;
+	}
+
+	unsigned char *entry = output->index + (size_t) output->ndives * DCTOOL_ARCHIVE_ENTRY;
+	memcpy (entry, data, DCTOOL_ARCHIVE_ENTRY);
+	archive_uint64 (entry, output->offset);
+
+	if (archive_write (output, data + DCTOOL_ARCHIVE_ENTRY, size - DCTOOL_ARCHIVE_ENTRY) != 0) {
+		ERROR ("Failed to write the dive data.");
+		return DC_STATUS_IO;
+	}
+
+	output->ndives++;
+
+	return DC_STATUS_SUCCESS;
+}
+
+static dc_status_t
+dctool_archive_output_event (dctool_output_t *abstract, dc_event_type_t event, const void *data)
+{
+	dctool_archive_output_t *output = (dctool_archive_output_t *) abstract;
+
+	switch (event) {
+	case DC_EVENT_DEVINFO:
+		output->devinfo = *(const dc_event_devinfo_t *) data;
+		break;
+	case DC_EVENT_CLOCK:
+		output->clock = *(const dc_event_clock_t *) data;
+		break;
+	default:
+		break;
+	}
+
+	return DC_STATUS_SUCCESS;
+}
+
+static dc_status_t
+dctool_archive_output_free (dctool_output_t *abstract)
+{
+	dctool_archive_output_t *output = (dctool_archive_output_t *) abstract;
+	dc_status_t status = DC_STATUS_SUCCESS;
+
+	// Write the index.
+	unsigned long long offset = output->offset;
+	unsigned char header[8] = {0};
+	archive_uint32 (header + 0, output->ndives);
+	archive_uint32 (header + 4, DCTOOL_ARCHIVE_ENTRY);
+	if (archive_write (output, header, sizeof(header)) != 0 ||
+		archive_write (output, output->index, (size_t) output->ndives * DCTOOL_ARCHIVE_ENTRY) != 0) {
+		status = DC_STATUS_IO;
+	}
+
+	// Store the offset of the index in the file header.
+	if (status == DC_STATUS_SUCCESS) {
+		unsigned char value[8];
+		archive_uint64 (value, offset);
+		if (fseek (output->ostream, 8, SEEK_SET) != 0 ||
+			fwrite (value, 1, sizeof(value), output->ostream) != sizeof(value)) {
+			status = DC_STATUS_IO;
+		}
+	}
+
+	if (status != DC_STATUS_SUCCESS) {
+		ERROR ("Failed to write the index.");
+	}
+
+	fclose (output->ostream);
+
+	free (output->index);
+	dc_buffer_free (output->record);
+
+	return status;
+}
@@ -0,0 +1,453 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2026 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#include "output-private.h"
+#include "utils.h"
+
+/*
+ * Binary output format
+ *
+ * All values are stored in little endian byte order. Signed values
+ * use two's complement, and missing values are stored as 0x80000000
+ * (or 0x8000000000000000 for 64 bit values).
+ *
+ * File header (16 bytes):
+ *
+ *   0   char[4]  Magic "DCTB"
+ *   4   uint32   Format version (1)
+ *   8   uint64   Offset of the index (0 if the file is incomplete)
+ *
+ * Dive record (48 bytes, followed by the variable length data):
+ *
+ *   0   uint32   Size of the record, including this header
+ *   4   uint32   Dive number
+ *   8   int64    Date and time (seconds since the epoch, local time)
+ *   16  int32    Timezone offset (seconds)
+ *   20  uint32   Dive time (seconds)
+ *   24  int32    Maximum depth (millimeters)
+ *   28  int32    Average depth (millimeters)
+ *   32  uint32   Number of samples (N)
+ *   36  uint32   Number of sample columns (C)
+ *   40  uint32   Size of the fingerprint (F)
+ *   44  uint32   Size of the raw dive data
+ *   48  uint8[]  Fingerprint (F bytes, padded to a multiple of 4 bytes)
+ *   ..  int32[]  C columns of N samples each
+ *
+ * Sample columns (in this order):
+ *
+ *   Time (milliseconds), depth (millimeters), temperature (millidegrees
+ *   Celsius) and tank pressure (millibar, first tank reported in the
+ *   sample).
+ *
+ * Index (at the end of the file):
+ *
+ *   0   uint32   Number of dives (D)
+ *   4   uint32   Reserved (0)
+ *   8   uint64[] Offset of each dive record (D entries)
+ */
+
+#define MAGIC    "DCTB"
+#define VERSION  1
+
+#define SZ_FILEHEADER 16
+#define SZ_DIVEHEADER 48
+
+#define NCOLUMNS 4
+#define NONE     0x80000000
+
+static dc_status_t dctool_binary_output_write (dctool_output_t *output, dc_parser_t *parser, const unsigned char data[], unsigned int size, const unsigned char fingerprint[], unsigned int fsize);
+static dc_status_t dctool_binary_output_free (dctool_output_t *output);
+static dc_status_t dctool_binary_output_render (dctool_output_t *output, unsigned int number, dc_parser_t *parser, const unsigned char data[], unsigned int size, const unsigned char fingerprint[], unsigned int fsize, dc_buffer_t *buffer);
+static dc_status_t dctool_binary_output_commit (dctool_output_t *output, const unsigned char data[], unsigned int size);
+
+typedef struct binary_samples_t {
+	unsigned int *columns[NCOLUMNS];
+	unsigned int nsamples, capacity;
+	int nomemory;
+} binary_samples_t;
+
+typedef struct dctool_binary_output_t {
+	dctool_output_t base;
+	FILE *ostream;
+	unsigned long long offset;
+	// Offsets of the dive records.
+	unsigned long long *index;
+	unsigned int ndives, nalloc;
+	// Sample columns and dive record, reused for every dive.
+	binary_samples_t samples;
+	dc_buffer_t *record;
+} dctool_binary_output_t;
+
+static const dctool_output_vtable_t binary_vtable = {
+	sizeof(dctool_binary_output_t), /* size */
+	dctool_binary_output_write, /* write */
+	dctool_binary_output_free, /* free */
+	dctool_binary_output_render, /* render */
+	dctool_binary_output_commit, /* commit */
+	NULL, /* event */
+};
+
+static void
+binary_uint32 (unsigned char buffer[], unsigned int value)
+{
+	buffer[0] = (value      ) & 0xFF;
+	buffer[1] = (value >>  8) & 0xFF;
+	buffer[2] = (value >> 16) & 0xFF;
+	buffer[3] = (value >> 24) & 0xFF;
+}
+
+static void
+binary_uint64 (unsigned char buffer[], unsigned long long value)
+{
+	binary_uint32 (buffer + 0, value & 0xFFFFFFFF);
+	binary_uint32 (buffer + 4, value >> 32);
+}
+
+static unsigned int
+binary_fixed (double value, double scale)
+{
+	double x = value * scale;
+	if (!(x > -2147483647.0 && x < 2147483647.0))
+		return NONE;
+
+	return (unsigned int) (int) (x < 0.0 ? x - 0.5 : x + 0.5);
+}
+
+static int
+binary_write (dctool_binary_output_t *output, const unsigned char data[], size_t size)
+{
+	if (size && fwrite (data, 1, size, output->ostream) != size)
+		return -1;
+
+	output->offset += size;
+
+	return 0;
+}
+
+static void
+binary_samples_free (binary_samples_t *samples)
+{
+	for (unsigned int i = 0; i < NCOLUMNS; ++i) {
+		free (samples->columns[i]);
+		samples->columns[i] = NULL;
+	}
+	samples->nsamples = 0;
+	samples->capacity = 0;
+}
+
+static void
+sample_cb (dc_sample_type_t type, const dc_sample_value_t *value, void *userdata)
+{
+	binary_samples_t *samples = (binary_samples_t *) userdata;
+
+	if (samples->nomemory)
+		return;
+
+	if (type == DC_SAMPLE_TIME) {
+		if (samples->nsamples == samples->capacity) {
+			unsigned int capacity = samples->capacity ? samples->capacity * 2 : 1024;
+			for (unsigned int i = 0; i < NCOLUMNS; ++i) {
+				unsigned int *column = (unsigned int *) realloc (samples->columns[i], capacity * sizeof (unsigned int));
+				if (column == NULL) {
+					samples->nomemory = 1;
+					return;
+				}
+				samples->columns[i] = column;
+			}
+			samples->capacity = capacity;
+		}
+
+		unsigned int n = samples->nsamples++;
+		samples->columns[0][n] = value->time;
+		for (unsigned int i = 1; i < NCOLUMNS; ++i) {
+			samples->columns[i][n] = NONE;
+		}
+		return;
+	}
+
+	// Ignore everything before the first time sample.
+	if (samples->nsamples == 0)
+		return;
+
+	unsigned int n = samples->nsamples - 1;
+	switch (type) {
+	case DC_SAMPLE_DEPTH:
+		samples->columns[1][n] = binary_fixed (value->depth, 1000.0);
+		break;
+	case DC_SAMPLE_TEMPERATURE:
+		samples->columns[2][n] = binary_fixed (value->temperature, 1000.0);
+		break;
+	case DC_SAMPLE_PRESSURE:
+		if (samples->columns[3][n] == NONE)
+			samples->columns[3][n] = binary_fixed (value->pressure.value, 1000.0);
+		break;
+	default:
+		break;
+	}
+}
+
+static dc_status_t
+binary_render (binary_samples_t *samples, unsigned int number, dc_parser_t *parser, unsigned int size, const unsigned char fingerprint[], unsigned int fsize, dc_buffer_t *record)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+
+	// Parse the summary fields.
+	unsigned long long datetime = 0x8000000000000000ULL;
+	unsigned int timezone = NONE;
+	dc_datetime_t dt = {0};
+	status = dc_parser_get_datetime (parser, &dt);
+	if (status != DC_STATUS_SUCCESS && status != DC_STATUS_UNSUPPORTED) {
+		ERROR ("Error parsing the datetime.");
+		return status;
+	}
+
+	if (status == DC_STATUS_SUCCESS) {
+		if (dt.timezone != DC_TIMEZONE_NONE)
+			timezone = dt.timezone;
+		dt.timezone = DC_TIMEZONE_NONE;
+		datetime = dc_datetime_mktime (&dt);
+	}
+
+	unsigned int divetime = 0;
+	status = dc_parser_get_field (parser, DC_FIELD_DIVETIME, 0, &divetime);
+	if (status != DC_STATUS_SUCCESS && status != DC_STATUS_UNSUPPORTED) {
+		ERROR ("Error parsing the divetime.");
+		return status;
+	}
+
+	double maxdepth = 0.0;
+	status = dc_parser_get_field (parser, DC_FIELD_MAXDEPTH, 0, &maxdepth);
+	if (status != DC_STATUS_SUCCESS && status != DC_STATUS_UNSUPPORTED) {
+		ERROR ("Error parsing the maxdepth.");
+		return status;
+	}
+	unsigned int maxdepth_mm = status == DC_STATUS_SUCCESS ? binary_fixed (maxdepth, 1000.0) : NONE;
+
+	double avgdepth = 0.0;
+	status = dc_parser_get_field (parser, DC_FIELD_AVGDEPTH, 0, &avgdepth);
+	if (status != DC_STATUS_SUCCESS && status != DC_STATUS_UNSUPPORTED) {
+		ERROR ("Error parsing the avgdepth.");
+		return status;
+	}
+	unsigned int avgdepth_mm = status == DC_STATUS_SUCCESS ? binary_fixed (avgdepth, 1000.0) : NONE;
+
+	// Collect the sample columns.
+	samples->nsamples = 0;
+	samples->nomemory = 0;
+	status = dc_parser_samples_foreach (parser, sample_cb, samples);
+	if (status != DC_STATUS_SUCCESS) {
+		ERROR ("Error parsing the sample data.");
+		return status;
+	}
+
+	if (samples->nomemory) {
+		ERROR ("Failed to allocate memory.");
+		return DC_STATUS_NOMEMORY;
+	}
+
+	unsigned int fpadded = (fsize + 3) & ~3U;
+	unsigned long long length = SZ_DIVEHEADER + fpadded + 4ULL * NCOLUMNS * samples->nsamples;
+	if (length > 0xFFFFFFFF || !dc_buffer_resize (record, length)) {
+		ERROR ("Failed to allocate memory.");
+		return DC_STATUS_NOMEMORY;
+	}
+
+	unsigned char *p = dc_buffer_get_data (record);
+	binary_uint32 (p +  0, length);
+	binary_uint32 (p +  4, number);
+	binary_uint64 (p +  8, datetime);
+	binary_uint32 (p + 16, timezone);
+	binary_uint32 (p + 20, divetime);
+	binary_uint32 (p + 24, maxdepth_mm);
+	binary_uint32 (p + 28, avgdepth_mm);
+	binary_uint32 (p + 32, samples->nsamples);
+	binary_uint32 (p + 36, NCOLUMNS);
+	binary_uint32 (p + 40, fsize);
+	binary_uint32 (p + 44, size);
+	p += SZ_DIVEHEADER;
+
+	// The padding is already zeroed by the resize.
+	if (fsize)
+		memcpy (p, fingerprint, fsize);
+	p += fpadded;
+
+	for (unsigned int i = 0; i < NCOLUMNS; ++i) {
+		const unsigned int *column = samples->columns[i];
+		for (unsigned int j = 0; j < samples->nsamples; ++j) {
+			binary_uint32 (p, column[j]);
+			p += 4;
+		}
+	}
+
+	return DC_STATUS_SUCCESS;
+}
+
+dctool_output_t *
+dctool_binary_output_new (const char *filename)
+{
+	dctool_binary_output_t *output = NULL;
+
+	if (filename == NULL)
+		goto error_exit;
+
+	// Allocate memory.
+	output = (dctool_binary_output_t *) dctool_output_allocate (&binary_vtable);
+	if (output == NULL) {
+		goto error_exit;
+	}
+
+	output->offset = 0;
+	output->index = NULL;
+	output->ndives = 0;
+	output->nalloc = 0;
+	memset (&output->samples, 0, sizeof (output->samples));
+
+	output->record = dc_buffer_new (0);
+	if (output->record == NULL) {
+		goto error_free;
+	}
+
+	// Open the output file.
+	output->ostream = fopen (filename, "wb");
+	if (output->ostream == NULL) {
+		goto error_free_record;
+	}
+
+	// Write the file header. The offset of the index is filled in
+	// when the output is closed.
+	unsigned char header[SZ_FILEHEADER] = {0};
+	memcpy (header, MAGIC, 4);
+	binary_uint32 (header + 4, VERSION);
+	if (binary_write (output, header, sizeof(header)) != 0) {
+		goto error_close;
+	}
+
+	return (dctool_output_t *) output;
+
+error_close:
+	fclose (output->ostream);
+error_free_record:
+	dc_buffer_free (output->record);
+error_free:
+	dctool_output_deallocate ((dctool_output_t *) output);
+error_exit:
+	return NULL;
+}
+
+static dc_status_t
+dctool_binary_output_write (dctool_output_t *abstract, dc_parser_t *parser, const unsigned char data[], unsigned int size, const unsigned char fingerprint[], unsigned int fsize)
+{
+	dctool_binary_output_t *output = (dctool_binary_output_t *) abstract;
+	dc_status_t status = DC_STATUS_SUCCESS;
+
+	dc_buffer_clear (output->record);
+
+	status = binary_render (&output->samples, abstract->number, parser, size, fingerprint, fsize, output->record);
+	if (status != DC_STATUS_SUCCESS)
+		return status;
+
+	return dctool_binary_output_commit (abstract, dc_buffer_get_data (output->record), dc_buffer_get_size (output->record));
+}
+
+static dc_status_t
+dctool_binary_output_render (dctool_output_t *abstract, unsigned int number, dc_parser_t *parser, const unsigned char data[], unsigned int size, const unsigned char fingerprint[], unsigned int fsize, dc_buffer_t *buffer)
+{
+	binary_samples_t samples = {{NULL}, 0, 0, 0};
+
+	dc_status_t status = binary_render (&samples, number, parser, size, fingerprint, fsize, buffer);
+
+	binary_samples_free (&samples);
+
+	return status;
+}
+
+static dc_status_t
+dctool_binary_output_commit (dctool_output_t *abstract, const unsigned char data[], unsigned int size)
+{
+	dctool_binary_output_t *output = (dctool_binary_output_t *) abstract;
+
+	// Add the dive to the index.
+	if (output->ndives == output->nalloc) {
+		unsigned int nalloc = output->nalloc ? output->nalloc * 2 : 64;
+		unsigned long long *index = (unsigned long long *) realloc (output->index, nalloc * sizeof (unsigned long long));
+		if (index == NULL)
+			return DC_STATUS_NOMEMORY;
+		output->index = index;
+		output->nalloc = nalloc;
+	}
+	output->index[output->ndives++] = output->offset;
+
+	if (binary_write (output, data, size) != 0) {
+		ERROR ("Failed to write the dive record.");
+		return DC_STATUS_IO;
+	}
+
+	return DC_STATUS_SUCCESS;
+}
+
+static dc_status_t
+dctool_binary_output_free (dctool_output_t *abstract)
+{
+	dctool_binary_output_t *output = (dctool_binary_output_t *) abstract;
+	dc_status_t status = DC_STATUS_SUCCESS;
+
+	// Write the index.
+	unsigned long long offset = output->offset;
+	unsigned char header[8] = {0};
+	binary_uint32 (header + 0, output->ndives);
+	if (binary_write (output, header, sizeof(header)) != 0) {
+		status = DC_STATUS_IO;
+	}
+
+	for (unsigned int i = 0; i < output->ndives && status == DC_STATUS_SUCCESS; ++i) {
+		unsigned char value[8];
+		binary_uint64 (value, output->index[i]);
+		if (binary_write (output, value, sizeof(value)) != 0) {
+			status = DC_STATUS_IO;
+		}
+	}
+
+	// Store the offset of the index in the file header.
+	if (status == DC_STATUS_SUCCESS) {
+		unsigned char value[8];
+		binary_uint64 (value, offset);
+		if (fseek (output->ostream, 8, SEEK_SET) != 0 ||
+			fwrite (value, 1, sizeof(value), output->ostream) != sizeof(value)) {
+			status = DC_STATUS_IO;
+		}
+	}
+
+	if (status != DC_STATUS_SUCCESS) {
+		ERROR ("Failed to write the index.");
+	}
+
+	fclose (output->ostream);
+
+	free (output->index);
+	binary_samples_free (&output->samples);
+	dc_buffer_free (output->record);
+
+	return status;
+}
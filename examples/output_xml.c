@@ -22,6 +22,8 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <stdarg.h>
+#include <math.h>
 
 #include <libdivecomputer/units.h>
 
@@ -30,10 +32,27 @@
 
 static dc_status_t dctool_xml_output_write (dctool_output_t *output, dc_parser_t *parser, const unsigned char data[], unsigned int size, const unsigned char fingerprint[], unsigned int fsize);
 static dc_status_t dctool_xml_output_free (dctool_output_t *output);
+static dc_status_t dctool_xml_output_render (dctool_output_t *output, unsigned int number, dc_parser_t *parser, const unsigned char data[], unsigned int size, const unsigned char fingerprint[], unsigned int fsize, dc_buffer_t *buffer);
+static dc_status_t dctool_xml_output_commit (dctool_output_t *output, const unsigned char data[], unsigned int size);
+
+#define SZ_WRITER 65536
+
+/*
+ * Output buffer, flushed to the file (or the target buffer when
+ * rendering into memory) in large blocks. The hot paths (the samples)
+ * are formatted directly into this buffer, without going through the
+ * stdio formatting functions.
+ */
+typedef struct xml_writer_t {
+	FILE *ostream;
+	dc_buffer_t *target;
+	size_t size;
+	char buffer[SZ_WRITER];
+} xml_writer_t;
 
 typedef struct dctool_xml_output_t {
 	dctool_output_t base;
-	FILE *ostream;
+	xml_writer_t writer;
 	dctool_units_t units;
 } dctool_xml_output_t;
 
@@ -41,10 +60,13 @@ static const dctool_output_vtable_t xml_vtable = {
 	sizeof(dctool_xml_output_t), /* size */
 	dctool_xml_output_write, /* write */
 	dctool_xml_output_free, /* free */
+	dctool_xml_output_render, /* render */
+	dctool_xml_output_commit, /* commit */
+	NULL, /* event */
 };
 
 typedef struct sample_data_t {
-	FILE *ostream;
+	xml_writer_t *writer;
 	dctool_units_t units;
 	unsigned int nsamples;
 } sample_data_t;
@@ -89,6 +111,156 @@ convert_volume (double value, dctool_units_t units)
 	}
 }
 
+static void
+xml_flush (xml_writer_t *writer)
+{
+	if (writer->size) {
+		if (writer->target)
+			dc_buffer_append (writer->target, (const unsigned char *) writer->buffer, writer->size);
+		else
+			fwrite (writer->buffer, 1, writer->size, writer->ostream);
+		writer->size = 0;
+	}
+}
+
+static void
+xml_write (xml_writer_t *writer, const char *data, size_t size)
+{
+	if (size > sizeof(writer->buffer) - writer->size) {
+		xml_flush (writer);
+		if (size > sizeof(writer->buffer)) {
+			if (writer->target)
+				dc_buffer_append (writer->target, (const unsigned char *) data, size);
+			else
+				fwrite (data, 1, size, writer->ostream);
+			return;
+		}
+	}
+
+	memcpy (writer->buffer + writer->size, data, size);
+	writer->size += size;
+}
+
+static void
+xml_puts (xml_writer_t *writer, const char *str)
+{
+	xml_write (writer, str, strlen (str));
+}
+
+static void
+xml_printf (xml_writer_t *writer, const char *format, ...)
+{
+	va_list ap, copy;
+
+	va_start (ap, format);
+	va_copy (copy, ap);
+
+	size_t available = sizeof(writer->buffer) - writer->size;
+	int n = vsnprintf (writer->buffer + writer->size, available, format, ap);
+	if (n >= 0 && (size_t) n < available) {
+		writer->size += n;
+	} else if (n >= 0) {
+		// Not enough space available. Flush the buffer, and format
+		// directly into an empty buffer, or a temporary one if the
+		// string is too large.
+		xml_flush (writer);
+		if ((size_t) n < sizeof(writer->buffer)) {
+			writer->size = vsnprintf (writer->buffer, sizeof(writer->buffer), format, copy);
+		} else {
+			char *tmp = (char *) malloc (n + 1);
+			if (tmp) {
+				vsnprintf (tmp, n + 1, format, copy);
+				xml_write (writer, tmp, n);
+				free (tmp);
+			}
+		}
+	}
+
+	va_end (copy);
+	va_end (ap);
+}
+
+static void
+xml_uint (xml_writer_t *writer, unsigned long long value, unsigned int width)
+{
+	char str[24];
+	unsigned int n = 0;
+
+	do {
+		str[sizeof(str) - ++n] = '0' + value % 10;
+		value /= 10;
+	} while (value || n < width);
+
+	xml_write (writer, str + sizeof(str) - n, n);
+}
+
+/*
+ * Write a floating point value with a fixed number of decimals. The
+ * result is identical to the "%.*f" printf format: the exact binary
+ * value is rounded to the nearest decimal, with ties to even.
+ */
+static void
+xml_fixed (xml_writer_t *writer, double value, unsigned int decimals)
+{
+	static const double scales[] = {1.0, 10.0, 100.0, 1000.0, 10000.0, 100000.0, 1000000.0};
+	static const unsigned long long powers[] = {1, 10, 100, 1000, 10000, 100000, 1000000};
+
+	double x = fabs (value);
+	double t = (decimals < sizeof (scales) / sizeof (scales[0]) && isfinite (x)) ? x * scales[decimals] : INFINITY;
+	if (t >= 4503599627370496.0) {
+		xml_printf (writer, "%.*f", decimals, value);
+		return;
+	}
+
+	// The exact product is t + e. Both the fractional part and the
+	// error term are exact for values below 2^52.
+	double e = fma (x, scales[decimals], -t);
+	double n = floor (t);
+	double frac = t - n;
+	if (frac >= 0.25) {
+		double diff = (frac - 0.5) + e;
+		if (diff > 0.0 || (diff == 0.0 && fmod (n, 2.0) != 0.0))
+			n += 1.0;
+	}
+
+	unsigned long long number = (unsigned long long) n;
+
+	if (signbit (value))
+		xml_write (writer, "-", 1);
+	xml_uint (writer, number / powers[decimals], 1);
+	if (decimals) {
+		xml_write (writer, ".", 1);
+		xml_uint (writer, number % powers[decimals], decimals);
+	}
+}
+
+static void
+xml_element_fixed (xml_writer_t *writer, const char *name, size_t length, double value, unsigned int decimals)
+{
+	xml_write (writer, "   <", 4);
+	xml_write (writer, name, length);
+	xml_write (writer, ">", 1);
+	xml_fixed (writer, value, decimals);
+	xml_write (writer, "</", 2);
+	xml_write (writer, name, length);
+	xml_write (writer, ">\n", 2);
+}
+
+static void
+xml_element_uint (xml_writer_t *writer, const char *name, size_t length, unsigned int value)
+{
+	xml_write (writer, "   <", 4);
+	xml_write (writer, name, length);
+	xml_write (writer, ">", 1);
+	xml_uint (writer, value, 1);
+	xml_write (writer, "</", 2);
+	xml_write (writer, name, length);
+	xml_write (writer, ">\n", 2);
+}
+
+#define XML_FIXED(w,name,value,decimals) xml_element_fixed (w, name, sizeof(name) - 1, value, decimals)
+#define XML_UINT(w,name,value) xml_element_uint (w, name, sizeof(name) - 1, value)
+
 static void
 sample_cb (dc_sample_type_t type, const dc_sample_value_t *value, void *userdata)
 {
@@ -103,6 +275,7 @@ sample_cb (dc_sample_type_t type, const dc_sample_value_t *value, void *userdata
 		"ndl", "safety", "deco", "deep"};
 
 	sample_data_t *sampledata = (sample_data_t *) userdata;
+	xml_writer_t *writer = sampledata->writer;
 
 	unsigned int seconds = 0, milliseconds = 0;
 
@@ -111,73 +284,93 @@ sample_cb (dc_sample_type_t type, const dc_sample_value_t *value, void *userdata
 		seconds = value->time / 1000;
 		milliseconds = value->time % 1000;
 		if (sampledata->nsamples++)
-			fprintf (sampledata->ostream, "</sample>\n");
-		fprintf (sampledata->ostream, "<sample>\n");
+			xml_puts (writer, "</sample>\n");
+		xml_puts (writer, "<sample>\n   <time>");
+		xml_uint (writer, seconds / 60, 2);
+		xml_write (writer, ":", 1);
+		xml_uint (writer, seconds % 60, 2);
 		if (milliseconds) {
-			fprintf (sampledata->ostream, "   <time>%02u:%02u.%03u</time>\n", seconds / 60, seconds % 60, milliseconds);
-		} else {
-			fprintf (sampledata->ostream, "   <time>%02u:%02u</time>\n", seconds / 60, seconds % 60);
+			xml_write (writer, ".", 1);
+			xml_uint (writer, milliseconds, 3);
 		}
+		xml_puts (writer, "</time>\n");
 		break;
 	case DC_SAMPLE_DEPTH:
-		fprintf (sampledata->ostream, "   <depth>%.2f</depth>\n",
-			convert_depth(value->depth, sampledata->units));
+		XML_FIXED (writer, "depth", convert_depth(value->depth, sampledata->units), 2);
 		break;
 	case DC_SAMPLE_PRESSURE:
-		fprintf (sampledata->ostream, "   <pressure tank=\"%u\">%.2f</pressure>\n",
-			value->pressure.tank,
-			convert_pressure(value->pressure.value, sampledata->units));
+		xml_puts (writer, "   <pressure tank=\"");
+		xml_uint (writer, value->pressure.tank, 1);
+		xml_puts (writer, "\">");
+		xml_fixed (writer, convert_pressure(value->pressure.value, sampledata->units), 2);
+		xml_puts (writer, "</pressure>\n");
 		break;
 	case DC_SAMPLE_TEMPERATURE:
-		fprintf (sampledata->ostream, "   <temperature>%.2f</temperature>\n",
-			convert_temperature(value->temperature, sampledata->units));
+		XML_FIXED (writer, "temperature", convert_temperature(value->temperature, sampledata->units), 2);
 		break;
 	case DC_SAMPLE_EVENT:
 		if (value->event.type != SAMPLE_EVENT_GASCHANGE && value->event.type != SAMPLE_EVENT_GASCHANGE2) {
-			fprintf (sampledata->ostream, "   <event type=\"%u\" time=\"%u\" flags=\"%u\" value=\"%u\">%s</event>\n",
+			xml_printf (writer, "   <event type=\"%u\" time=\"%u\" flags=\"%u\" value=\"%u\">%s</event>\n",
 				value->event.type, value->event.time, value->event.flags, value->event.value, events[value->event.type]);
 		}
 		break;
 	case DC_SAMPLE_RBT:
-		fprintf (sampledata->ostream, "   <rbt>%u</rbt>\n", value->rbt);
+		XML_UINT (writer, "rbt", value->rbt);
 		break;
 	case DC_SAMPLE_HEARTBEAT:
-		fprintf (sampledata->ostream, "   <heartbeat>%u</heartbeat>\n", value->heartbeat);
+		XML_UINT (writer, "heartbeat", value->heartbeat);
 		break;
 	case DC_SAMPLE_BEARING:
-		fprintf (sampledata->ostream, "   <bearing>%u</bearing>\n", value->bearing);
+		XML_UINT (writer, "bearing", value->bearing);
 		break;
 	case DC_SAMPLE_VENDOR:
-		fprintf (sampledata->ostream, "   <vendor type=\"%u\" size=\"%u\">", value->vendor.type, value->vendor.size);
-		for (unsigned int i = 0; i < value->vendor.size; ++i)
-			fprintf (sampledata->ostream, "%02X", ((const unsigned char *) value->vendor.data)[i]);
-		fprintf (sampledata->ostream, "</vendor>\n");
+		xml_printf (writer, "   <vendor type=\"%u\" size=\"%u\">", value->vendor.type, value->vendor.size);
+		for (unsigned int i = 0; i < value->vendor.size; ++i) {
+			static const char hex[] = "0123456789ABCDEF";
+			unsigned char byte = ((const unsigned char *) value->vendor.data)[i];
+			char str[2] = {hex[byte >> 4], hex[byte & 0x0F]};
+			xml_write (writer, str, sizeof(str));
+		}
+		xml_puts (writer, "</vendor>\n");
 		break;
 	case DC_SAMPLE_SETPOINT:
-		fprintf (sampledata->ostream, "   <setpoint>%.2f</setpoint>\n", value->setpoint);
+		XML_FIXED (writer, "setpoint", value->setpoint, 2);
 		break;
 	case DC_SAMPLE_PPO2:
 		if (value->ppo2.sensor != DC_SENSOR_NONE) {
-			fprintf (sampledata->ostream, "   <ppo2 sensor=\"%u\">%.2f</ppo2>\n", value->ppo2.sensor, value->ppo2.value);
+			xml_puts (writer, "   <ppo2 sensor=\"");
+			xml_uint (writer, value->ppo2.sensor, 1);
+			xml_puts (writer, "\">");
+			xml_fixed (writer, value->ppo2.value, 2);
+			xml_puts (writer, "</ppo2>\n");
 		} else {
-			fprintf (sampledata->ostream, "   <ppo2>%.2f</ppo2>\n", value->ppo2.value);
+			XML_FIXED (writer, "ppo2", value->ppo2.value, 2);
 		}
 		break;
 	case DC_SAMPLE_CNS:
-		fprintf (sampledata->ostream, "   <cns>%.1f</cns>\n", value->cns * 100.0);
+		XML_FIXED (writer, "cns", value->cns * 100.0, 1);
 		break;
 	case DC_SAMPLE_DECO:
-		fprintf (sampledata->ostream, "   <deco time=\"%u\" depth=\"%.2f\">%s</deco>\n",
-			value->deco.time,
-			convert_depth(value->deco.depth, sampledata->units),
-			decostop[value->deco.type]);
+		xml_puts (writer, "   <deco time=\"");
+		xml_uint (writer, value->deco.time, 1);
+		xml_puts (writer, "\" depth=\"");
+		xml_fixed (writer, convert_depth(value->deco.depth, sampledata->units), 2);
+		xml_puts (writer, "\">");
+		xml_puts (writer, decostop[value->deco.type]);
+		xml_puts (writer, "</deco>\n");
 		if (value->deco.tts) {
-			fprintf (sampledata->ostream, "   <tts>%u</tts>\n",
-				value->deco.tts);
+			XML_UINT (writer, "tts", value->deco.tts);
 		}
 		break;
 	case DC_SAMPLE_GASMIX:
-		fprintf (sampledata->ostream, "   <gasmix>%u</gasmix>\n", value->gasmix);
+		XML_UINT (writer, "gasmix", value->gasmix);
+		break;
+	case DC_SAMPLE_POSITION:
+		xml_puts (writer, "   <position lat=\"");
+		xml_fixed (writer, value->position.latitude, 6);
+		xml_puts (writer, "\" lon=\"");
+		xml_fixed (writer, value->position.longitude, 6);
+		xml_puts (writer, "\" />\n");
 		break;
 	default:
 		break;
@@ -199,14 +392,16 @@ dctool_xml_output_new (const char *filename, dctool_units_t units)
 	}
 
 	// Open the output file.
-	output->ostream = fopen (filename, "w");
-	if (output->ostream == NULL) {
+	output->writer.ostream = fopen (filename, "w");
+	output->writer.target = NULL;
+	output->writer.size = 0;
+	if (output->writer.ostream == NULL) {
 		goto error_free;
 	}
 
 	output->units = units;
 
-	fprintf (output->ostream, "<device>\n");
+	xml_printf (&output->writer, "<device>\n");
 
 	return (dctool_output_t *) output;
 
@@ -217,24 +412,23 @@ error_exit:
 }
 
 static dc_status_t
-dctool_xml_output_write (dctool_output_t *abstract, dc_parser_t *parser, const unsigned char data[], unsigned int size, const unsigned char fingerprint[], unsigned int fsize)
+xml_render (xml_writer_t *writer, dctool_units_t units, unsigned int number, dc_parser_t *parser, const unsigned char data[], unsigned int size, const unsigned char fingerprint[], unsigned int fsize)
 {
-	dctool_xml_output_t *output = (dctool_xml_output_t *) abstract;
 	dc_status_t status = DC_STATUS_SUCCESS;
 
 	// Initialize the sample data.
 	sample_data_t sampledata = {0};
 	sampledata.nsamples = 0;
-	sampledata.ostream = output->ostream;
-	sampledata.units = output->units;
+	sampledata.writer = writer;
+	sampledata.units = units;
 
-	fprintf (output->ostream, "<dive>\n<number>%u</number>\n<size>%u</size>\n", abstract->number, size);
+	xml_printf (writer, "<dive>\n<number>%u</number>\n<size>%u</size>\n", number, size);
 
 	if (fingerprint) {
-		fprintf (output->ostream, "<fingerprint>");
+		xml_printf (writer, "<fingerprint>");
 		for (unsigned int i = 0; i < fsize; ++i)
-			fprintf (output->ostream, "%02X", fingerprint[i]);
-		fprintf (output->ostream, "</fingerprint>\n");
+			xml_printf (writer, "%02X", fingerprint[i]);
+		xml_printf (writer, "</fingerprint>\n");
 	}
 
 	// Parse the datetime.
@@ -247,11 +441,11 @@ dctool_xml_output_write (dctool_output_t *abstract, dc_parser_t *parser, const u
 	}
 
 	if (dt.timezone == DC_TIMEZONE_NONE) {
-		fprintf (output->ostream, "<datetime>%04i-%02i-%02i %02i:%02i:%02i</datetime>\n",
+		xml_printf (writer, "<datetime>%04i-%02i-%02i %02i:%02i:%02i</datetime>\n",
 			dt.year, dt.month, dt.day,
 			dt.hour, dt.minute, dt.second);
 	} else {
-		fprintf (output->ostream, "<datetime>%04i-%02i-%02i %02i:%02i:%02i %+03i:%02i</datetime>\n",
+		xml_printf (writer, "<datetime>%04i-%02i-%02i %02i:%02i:%02i %+03i:%02i</datetime>\n",
 			dt.year, dt.month, dt.day,
 			dt.hour, dt.minute, dt.second,
 			dt.timezone / 3600, (abs(dt.timezone) % 3600) / 60);
@@ -266,7 +460,7 @@ dctool_xml_output_write (dctool_output_t *abstract, dc_parser_t *parser, const u
 		goto cleanup;
 	}
 
-	fprintf (output->ostream, "<divetime>%02u:%02u</divetime>\n",
+	xml_printf (writer, "<divetime>%02u:%02u</divetime>\n",
 		divetime / 60, divetime % 60);
 
 	// Parse the maxdepth.
@@ -278,8 +472,8 @@ dctool_xml_output_write (dctool_output_t *abstract, dc_parser_t *parser, const u
 		goto cleanup;
 	}
 
-	fprintf (output->ostream, "<maxdepth>%.2f</maxdepth>\n",
-		convert_depth(maxdepth, output->units));
+	xml_printf (writer, "<maxdepth>%.2f</maxdepth>\n",
+		convert_depth(maxdepth, units));
 
 	// Parse the avgdepth.
 	message ("Parsing the avgdepth.\n");
@@ -291,8 +485,8 @@ dctool_xml_output_write (dctool_output_t *abstract, dc_parser_t *parser, const u
 	}
 
 	if (status != DC_STATUS_UNSUPPORTED) {
-		fprintf (output->ostream, "<avgdepth>%.2f</avgdepth>\n",
-			convert_depth(avgdepth, output->units));
+		xml_printf (writer, "<avgdepth>%.2f</avgdepth>\n",
+			convert_depth(avgdepth, units));
 	}
 
 	// Parse the temperature.
@@ -311,9 +505,9 @@ dctool_xml_output_write (dctool_output_t *abstract, dc_parser_t *parser, const u
 		}
 
 		if (status != DC_STATUS_UNSUPPORTED) {
-			fprintf (output->ostream, "<temperature type=\"%s\">%.1f</temperature>\n",
+			xml_printf (writer, "<temperature type=\"%s\">%.1f</temperature>\n",
 				names[i],
-				convert_temperature(temperature, output->units));
+				convert_temperature(temperature, units));
 		}
 	}
 
@@ -334,7 +528,7 @@ dctool_xml_output_write (dctool_output_t *abstract, dc_parser_t *parser, const u
 			goto cleanup;
 		}
 
-		fprintf (output->ostream,
+		xml_printf (writer,
 			"<gasmix>\n"
 			"   <he>%.1f</he>\n"
 			"   <o2>%.1f</o2>\n"
@@ -344,11 +538,11 @@ dctool_xml_output_write (dctool_output_t *abstract, dc_parser_t *parser, const u
 			gasmix.nitrogen * 100.0);
 		if (gasmix.usage) {
 			const char *usage[] = {"none", "oxygen", "diluent", "sidemount"};
-			fprintf (output->ostream,
+			xml_printf (writer,
 				"   <usage>%s</usage>\n",
 				usage[gasmix.usage]);
 		}
-		fprintf (output->ostream,
+		xml_printf (writer,
 			"</gasmix>\n");
 
 	}
@@ -372,33 +566,33 @@ dctool_xml_output_write (dctool_output_t *abstract, dc_parser_t *parser, const u
 			goto cleanup;
 		}
 
-		fprintf (output->ostream, "<tank>\n");
+		xml_printf (writer, "<tank>\n");
 		if (tank.gasmix != DC_GASMIX_UNKNOWN) {
-			fprintf (output->ostream,
+			xml_printf (writer,
 				"   <gasmix>%u</gasmix>\n",
 				tank.gasmix);
 		}
 		if (tank.usage) {
 			const char *usage[] = {"none", "oxygen", "diluent", "sidemount"};
-			fprintf (output->ostream,
+			xml_printf (writer,
 				"   <usage>%s</usage>\n",
 				usage[tank.usage]);
 		}
 		if (tank.type != DC_TANKVOLUME_NONE) {
-			fprintf (output->ostream,
+			xml_printf (writer,
 				"   <type>%s</type>\n"
 				"   <volume>%.1f</volume>\n"
 				"   <workpressure>%.2f</workpressure>\n",
 				names[tank.type],
-				convert_volume(tank.volume, output->units),
-				convert_pressure(tank.workpressure, output->units));
+				convert_volume(tank.volume, units),
+				convert_pressure(tank.workpressure, units));
 		}
-		fprintf (output->ostream,
+		xml_printf (writer,
 			"   <beginpressure>%.2f</beginpressure>\n"
 			"   <endpressure>%.2f</endpressure>\n"
 			"</tank>\n",
-			convert_pressure(tank.beginpressure, output->units),
-			convert_pressure(tank.endpressure, output->units));
+			convert_pressure(tank.beginpressure, units),
+			convert_pressure(tank.endpressure, units));
 	}
 
 	// Parse the dive mode.
@@ -412,7 +606,7 @@ dctool_xml_output_write (dctool_output_t *abstract, dc_parser_t *parser, const u
 
 	if (status != DC_STATUS_UNSUPPORTED) {
 		const char *names[] = {"freedive", "gauge", "oc", "ccr", "scr"};
-		fprintf (output->ostream, "<divemode>%s</divemode>\n",
+		xml_printf (writer, "<divemode>%s</divemode>\n",
 			names[divemode]);
 	}
 
@@ -427,15 +621,15 @@ dctool_xml_output_write (dctool_output_t *abstract, dc_parser_t *parser, const u
 
 	if (status != DC_STATUS_UNSUPPORTED) {
 		const char *names[] = {"none", "buhlmann", "vpm", "rgbm", "dciem"};
-		fprintf (output->ostream, "<decomodel>%s</decomodel>\n",
+		xml_printf (writer, "<decomodel>%s</decomodel>\n",
 			names[decomodel.type]);
 		if (decomodel.type == DC_DECOMODEL_BUHLMANN &&
 			(decomodel.params.gf.low != 0 || decomodel.params.gf.high != 0)) {
-			fprintf (output->ostream, "<gf>%u/%u</gf>\n",
+			xml_printf (writer, "<gf>%u/%u</gf>\n",
 				decomodel.params.gf.low, decomodel.params.gf.high);
 		}
 		if (decomodel.conservatism) {
-			fprintf (output->ostream, "<conservatism>%d</conservatism>\n",
+			xml_printf (writer, "<conservatism>%d</conservatism>\n",
 				decomodel.conservatism);
 		}
 	}
@@ -452,10 +646,10 @@ dctool_xml_output_write (dctool_output_t *abstract, dc_parser_t *parser, const u
 	if (status != DC_STATUS_UNSUPPORTED) {
 		const char *names[] = {"fresh", "salt"};
 		if (salinity.density) {
-			fprintf (output->ostream, "<salinity density=\"%.1f\">%s</salinity>\n",
+			xml_printf (writer, "<salinity density=\"%.1f\">%s</salinity>\n",
 				salinity.density, names[salinity.type]);
 		} else {
-			fprintf (output->ostream, "<salinity>%s</salinity>\n",
+			xml_printf (writer, "<salinity>%s</salinity>\n",
 				names[salinity.type]);
 		}
 	}
@@ -470,8 +664,28 @@ dctool_xml_output_write (dctool_output_t *abstract, dc_parser_t *parser, const u
 	}
 
 	if (status != DC_STATUS_UNSUPPORTED) {
-		fprintf (output->ostream, "<atmospheric>%.5f</atmospheric>\n",
-			convert_pressure(atmospheric, output->units));
+		xml_printf (writer, "<atmospheric>%.5f</atmospheric>\n",
+			convert_pressure(atmospheric, units));
+	}
+
+	// Parse the entry and exit locations.
+	message ("Parsing the location.\n");
+	for (unsigned int i = DC_LOCATION_ENTRY; i <= DC_LOCATION_EXIT; ++i) {
+		const char *names[] = {"entry", "exit"};
+		dc_location_t location = {0};
+		status = dc_parser_get_field (parser, DC_FIELD_LOCATION, i, &location);
+		if (status != DC_STATUS_SUCCESS && status != DC_STATUS_UNSUPPORTED) {
+			ERROR ("Error parsing the location.");
+			goto cleanup;
+		}
+
+		if (status != DC_STATUS_UNSUPPORTED) {
+			xml_printf (writer, "<location type=\"%s\" lat=\"", names[i]);
+			xml_fixed (writer, location.latitude, 6);
+			xml_puts (writer, "\" lon=\"");
+			xml_fixed (writer, location.longitude, 6);
+			xml_puts (writer, "\" />\n");
+		}
 	}
 
 	message ("Parsing strings.\n");
@@ -487,7 +701,7 @@ dctool_xml_output_write (dctool_output_t *abstract, dc_parser_t *parser, const u
 			break;
 		if (!str.desc || !str.value)
 			break;
-		fprintf (output->ostream, "<extradata key='%s' value='%s' />\n",
+		xml_printf (writer, "<extradata key='%s' value='%s' />\n",
 			str.desc, str.value);
 
 	}
@@ -503,20 +717,60 @@ dctool_xml_output_write (dctool_output_t *abstract, dc_parser_t *parser, const u
 cleanup:
 
 	if (sampledata.nsamples)
-		fprintf (output->ostream, "</sample>\n");
-	fprintf (output->ostream, "</dive>\n");
+		xml_printf (writer, "</sample>\n");
+	xml_printf (writer, "</dive>\n");
+
+	return status;
+}
+
+static dc_status_t
+dctool_xml_output_write (dctool_output_t *abstract, dc_parser_t *parser, const unsigned char data[], unsigned int size, const unsigned char fingerprint[], unsigned int fsize)
+{
+	dctool_xml_output_t *output = (dctool_xml_output_t *) abstract;
+
+	return xml_render (&output->writer, output->units, abstract->number, parser, data, size, fingerprint, fsize);
+}
+
+static dc_status_t
+dctool_xml_output_render (dctool_output_t *abstract, unsigned int number, dc_parser_t *parser, const unsigned char data[], unsigned int size, const unsigned char fingerprint[], unsigned int fsize, dc_buffer_t *buffer)
+{
+	dctool_xml_output_t *output = (dctool_xml_output_t *) abstract;
+
+	xml_writer_t *writer = (xml_writer_t *) malloc (sizeof (xml_writer_t));
+	if (writer == NULL)
+		return DC_STATUS_NOMEMORY;
+
+	writer->ostream = NULL;
+	writer->target = buffer;
+	writer->size = 0;
+
+	dc_status_t status = xml_render (writer, output->units, number, parser, data, size, fingerprint, fsize);
+
+	xml_flush (writer);
+	free (writer);
 
 	return status;
 }
 
+static dc_status_t
+dctool_xml_output_commit (dctool_output_t *abstract, const unsigned char data[], unsigned int size)
+{
+	dctool_xml_output_t *output = (dctool_xml_output_t *) abstract;
+
+	xml_write (&output->writer, (const char *) data, size);
+
+	return DC_STATUS_SUCCESS;
+}
+
 static dc_status_t
 dctool_xml_output_free (dctool_output_t *abstract)
 {
 	dctool_xml_output_t *output = (dctool_xml_output_t *) abstract;
 
-	fprintf (output->ostream, "</device>\n");
+	xml_puts (&output->writer, "</device>\n");
+	xml_flush (&output->writer);
 
-	fclose (output->ostream);
+	fclose (output->writer.ostream);
 
 	return DC_STATUS_SUCCESS;
 }
@@ -0,0 +1,370 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2026 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "synthetic.h"
+
+#define NGASMIXES 5
+
+#define DESCENT 30 /* cm/s */
+#define ASCENT  15 /* cm/s */
+
+// Shearwater Petrel Native Format (PNF)
+#define PNF_SIZE          32
+#define PNF_DIVE_SAMPLE   0x01
+#define PNF_OPENING       0x10
+#define PNF_CLOSING       0x20
+#define PNF_INFO_EVENT    0x30
+#define PNF_FINAL         0xFF
+#define PNF_TAG_LOG       38
+#define PNF_LOGVERSION    10
+#define PNF_OC            0x10
+
+typedef struct synthetic_state_t {
+	const dctool_synthetic_t *params;
+	unsigned int nsamples;
+	unsigned int random;
+	unsigned int maxdepth;
+	unsigned long long avgdepth;
+} synthetic_state_t;
+
+static const unsigned char g_gasmixes[NGASMIXES][2] = {
+	{21, 0},
+	{32, 0},
+	{50, 0},
+	{100, 0},
+	{18, 45},
+};
+
+static void
+put_uint16_le (unsigned char data[], unsigned int value)
+{
+	data[0] = value & 0xFF;
+	data[1] = (value >> 8) & 0xFF;
+}
+
+static void
+put_uint24_le (unsigned char data[], unsigned int value)
+{
+	data[0] = value & 0xFF;
+	data[1] = (value >> 8) & 0xFF;
+	data[2] = (value >> 16) & 0xFF;
+}
+
+static void
+put_uint16_be (unsigned char data[], unsigned int value)
+{
+	data[0] = (value >> 8) & 0xFF;
+	data[1] = value & 0xFF;
+}
+
+static void
+put_uint24_be (unsigned char data[], unsigned int value)
+{
+	data[0] = (value >> 16) & 0xFF;
+	data[1] = (value >> 8) & 0xFF;
+	data[2] = value & 0xFF;
+}
+
+static void
+put_uint32_be (unsigned char data[], unsigned int value)
+{
+	data[0] = (value >> 24) & 0xFF;
+	data[1] = (value >> 16) & 0xFF;
+	data[2] = (value >> 8) & 0xFF;
+	data[3] = value & 0xFF;
+}
+
+static unsigned int
+synthetic_random (synthetic_state_t *state)
+{
+	// The generator is deterministic, such that the same parameters
+	// always produce the same dive.
+	state->random = state->random * 1103515245 + 12345;
+	return (state->random >> 16) & 0x7FFF;
+}
+
+static void
+synthetic_init (synthetic_state_t *state, const dctool_synthetic_t *params)
+{
+	state->params = params;
+	state->nsamples = params->duration / params->interval;
+	state->random = params->seed;
+	state->maxdepth = 0;
+	state->avgdepth = 0;
+}
+
+/*
+ * Get the depth (cm) of a square profile, with a descent and ascent at a
+ * fixed rate, and some noise on the bottom part.
+ */
+static unsigned int
+synthetic_depth (synthetic_state_t *state, unsigned int n)
+{
+	const dctool_synthetic_t *params = state->params;
+	unsigned int time = (n + 1) * params->interval;
+	unsigned int duration = state->nsamples * params->interval;
+	unsigned int maxdepth = params->maxdepth * 100;
+
+	unsigned int depth = maxdepth;
+	if (time * DESCENT < depth)
+		depth = time * DESCENT;
+	if ((duration - time) * ASCENT < depth)
+		depth = (duration - time) * ASCENT;
+	if (depth == maxdepth)
+		depth -= synthetic_random (state) % 50;
+
+	if (depth > state->maxdepth)
+		state->maxdepth = depth;
+	state->avgdepth += depth;
+
+	return depth;
+}
+
+/*
+ * Get the one based index of the gas mix to switch to at the sample, or
+ * zero if there is no gas switch. The switches are spread evenly over
+ * the dive, and cycle through all the gas mixes.
+ */
+static unsigned int
+synthetic_gasswitch (synthetic_state_t *state, unsigned int n)
+{
+	unsigned int count = state->params->gasswitches;
+	for (unsigned int i = 0; i < count; ++i) {
+		if (n == (unsigned long long) (i + 1) * state->nsamples / (count + 1))
+			return (i + 1) % NGASMIXES + 1;
+	}
+
+	return 0;
+}
+
+static unsigned int
+synthetic_event (synthetic_state_t *state)
+{
+	return synthetic_random (state) % 1000 < state->params->events;
+}
+
+static dc_status_t
+synthetic_ostc3 (dc_buffer_t *buffer, const dctool_synthetic_t *params)
+{
+	synthetic_state_t state;
+	synthetic_init (&state, params);
+
+	// Sample configuration: temperature every sample, and the deco
+	// information every sixth sample.
+	const unsigned char config[][3] = {
+		{0, 2, 1},
+		{1, 2, 6},
+	};
+	const unsigned int nconfig = sizeof (config) / sizeof (config[0]);
+
+	unsigned char header[256] = {0};
+	unsigned char profile[5 + sizeof (config)] = {0};
+	profile[3] = params->interval;
+	profile[4] = nconfig;
+	memcpy (profile + 5, config, sizeof (config));
+
+	if (!dc_buffer_append (buffer, header, sizeof (header)) ||
+		!dc_buffer_append (buffer, profile, sizeof (profile)))
+		return DC_STATUS_NOMEMORY;
+
+	for (unsigned int n = 0; n < state.nsamples; ++n) {
+		unsigned char sample[16] = {0};
+		unsigned int depth = synthetic_depth (&state, n);
+		unsigned int gasmix = synthetic_gasswitch (&state, n);
+		unsigned int event = synthetic_event (&state);
+
+		unsigned int length = 3;
+		put_uint16_le (sample, depth);
+		if (gasmix || event) {
+			sample[2] |= 0x80;
+			sample[length++] = (event ? 0x06 : 0x00) | (gasmix ? 0x20 : 0x00);
+			if (gasmix)
+				sample[length++] = gasmix;
+		}
+		put_uint16_le (sample + length, 200 - depth / 200);
+		length += 2;
+		if ((n + 1) % 6 == 0) {
+			sample[length++] = 0;
+			sample[length++] = 99;
+		}
+		sample[2] |= length - 3;
+
+		if (!dc_buffer_append (buffer, sample, length))
+			return DC_STATUS_NOMEMORY;
+	}
+
+	const unsigned char end[] = {0xFD, 0xFD};
+	if (!dc_buffer_append (buffer, end, sizeof (end)))
+		return DC_STATUS_NOMEMORY;
+
+	unsigned int duration = state.nsamples * params->interval;
+	unsigned int avgdepth = state.nsamples ? state.avgdepth / state.nsamples : 0;
+
+	unsigned char *data = dc_buffer_get_data (buffer);
+	unsigned int size = dc_buffer_get_size (buffer);
+	data[0] = data[1] = 0xFA;
+	data[8] = 0x24;
+	put_uint24_le (data + 9, size - sizeof (header) + 3);
+	put_uint24_le (data + sizeof (header), size - sizeof (header) + 3);
+	data[12] = 26;
+	data[13] = 1;
+	data[14] = 1;
+	data[15] = 12;
+	data[16] = 0;
+	put_uint16_le (data + 17, state.maxdepth);
+	put_uint16_le (data + 19, duration / 60);
+	data[21] = duration % 60;
+	put_uint16_le (data + 22, 200 - state.maxdepth / 200);
+	put_uint16_le (data + 24, 1013);
+	for (unsigned int i = 0; i < NGASMIXES; ++i) {
+		data[28 + 4 * i + 0] = g_gasmixes[i][0];
+		data[28 + 4 * i + 1] = g_gasmixes[i][1];
+		data[28 + 4 * i + 3] = i == 0 ? 1 : 2;
+	}
+	put_uint16_be (data + 48, 0x030A);
+	data[70] = 3;
+	put_uint16_le (data + 73, avgdepth);
+	put_uint16_le (data + 75, duration);
+	data[77] = 30;
+	data[78] = 85;
+	data[79] = 1;
+	data[82] = 0;
+	data[254] = data[255] = 0xFB;
+
+	return DC_STATUS_SUCCESS;
+}
+
+static dc_status_t
+synthetic_pnf (dc_buffer_t *buffer, const dctool_synthetic_t *params)
+{
+	synthetic_state_t state;
+	synthetic_init (&state, params);
+
+	unsigned char opening[6][PNF_SIZE] = {{0}};
+	for (unsigned int i = 0; i < 6; ++i) {
+		opening[i][0] = PNF_OPENING + i;
+	}
+	opening[0][4] = 30;
+	opening[0][5] = 85;
+	put_uint32_be (opening[0] + 12, 1767268800);
+	for (unsigned int i = 0; i < NGASMIXES; ++i) {
+		opening[0][20 + i] = g_gasmixes[i][0];
+		if (i < 2)
+			opening[0][30 + i] = g_gasmixes[i][1];
+		else
+			opening[1][1 + i - 2] = g_gasmixes[i][1];
+	}
+	put_uint16_be (opening[1] + 16, 1013);
+	put_uint16_be (opening[3] + 3, 1025);
+	opening[4][1] = 1; /* OC technical */
+	opening[4][16] = PNF_LOGVERSION;
+	put_uint16_be (opening[4] + 17, (1 << NGASMIXES) - 1);
+	put_uint16_be (opening[5] + 23, params->interval * 1000);
+
+	if (!dc_buffer_append (buffer, opening[0], sizeof (opening)))
+		return DC_STATUS_NOMEMORY;
+
+	unsigned int gasmix = 1;
+	for (unsigned int n = 0; n < state.nsamples; ++n) {
+		unsigned char sample[PNF_SIZE] = {0};
+		unsigned int depth = synthetic_depth (&state, n);
+		unsigned int gasswitch = synthetic_gasswitch (&state, n);
+		if (gasswitch)
+			gasmix = gasswitch;
+
+		sample[0] = PNF_DIVE_SAMPLE;
+		put_uint16_be (sample + 1, depth / 10);
+		sample[8] = g_gasmixes[gasmix - 1][0];
+		sample[9] = g_gasmixes[gasmix - 1][1];
+		sample[10] = 99;
+		sample[12] = PNF_OC;
+		sample[14] = 20 - depth / 2000;
+		put_uint16_be (sample + 20, 0xFFFF);
+		sample[22] = 0xFF;
+		sample[23] = 5;
+		put_uint16_be (sample + 28, 0xFFFF);
+		if (!dc_buffer_append (buffer, sample, sizeof (sample)))
+			return DC_STATUS_NOMEMORY;
+
+		if (synthetic_event (&state)) {
+			unsigned char event[PNF_SIZE] = {0};
+			event[0] = PNF_INFO_EVENT;
+			event[1] = PNF_TAG_LOG;
+			put_uint32_be (event + 4, (n + 1) * params->interval);
+			put_uint32_be (event + 8, 0xFFFFFFFF);
+			put_uint32_be (event + 12, n);
+			if (!dc_buffer_append (buffer, event, sizeof (event)))
+				return DC_STATUS_NOMEMORY;
+		}
+	}
+
+	unsigned char closing[5][PNF_SIZE] = {{0}};
+	for (unsigned int i = 0; i < 5; ++i) {
+		closing[i][0] = PNF_CLOSING + i;
+	}
+	put_uint16_be (closing[0] + 4, state.maxdepth / 10);
+	put_uint24_be (closing[0] + 6, state.nsamples * params->interval);
+
+	unsigned char final[PNF_SIZE] = {0};
+	final[0] = PNF_FINAL;
+	final[1] = 0xFD;
+
+	if (!dc_buffer_append (buffer, closing[0], sizeof (closing)) ||
+		!dc_buffer_append (buffer, final, sizeof (final)))
+		return DC_STATUS_NOMEMORY;
+
+	return DC_STATUS_SUCCESS;
+}
+
+dc_buffer_t *
+dctool_synthetic_generate (dc_descriptor_t *descriptor, const dctool_synthetic_t *params)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+
+	if (params->interval == 0 || params->interval > 255)
+		return NULL;
+
+	dc_buffer_t *buffer = dc_buffer_new (0);
+	if (buffer == NULL)
+		return NULL;
+
+	switch (dc_descriptor_get_type (descriptor)) {
+	case DC_FAMILY_HW_OSTC3:
+		status = synthetic_ostc3 (buffer, params);
+		break;
+	case DC_FAMILY_SHEARWATER_PETREL:
+		status = synthetic_pnf (buffer, params);
+		break;
+	default:
+		status = DC_STATUS_UNSUPPORTED;
+		break;
+	}
+
+	if (status != DC_STATUS_SUCCESS) {
+		dc_buffer_free (buffer);
+		return NULL;
+	}
+
+	return buffer;
+}
@@ -0,0 +1,57 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2026 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+#ifndef DCTOOL_SYNTHETIC_H
+#define DCTOOL_SYNTHETIC_H
+
+#include <libdivecomputer/buffer.h>
+#include <libdivecomputer/descriptor.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/*
+ * Parameters of a synthetic dive. The duration and the sample interval
+ * are in seconds, the maximum depth in meters, and the event density in
+ * events per 1000 samples.
+ */
+typedef struct dctool_synthetic_t {
+	unsigned int duration;
+	unsigned int interval;
+	unsigned int maxdepth;
+	unsigned int gasswitches;
+	unsigned int events;
+	unsigned int seed;
+} dctool_synthetic_t;
+
+/*
+ * Generate a dive in the native format of the device. Only the HW OSTC3
+ * and the Shearwater Petrel (PNF) formats are supported, for the other
+ * families NULL is returned.
+ */
+dc_buffer_t *
+dctool_synthetic_generate (dc_descriptor_t *descriptor, const dctool_synthetic_t *params);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+#endif /* DCTOOL_SYNTHETIC_H */
@@ -33,6 +33,14 @@ extern "C" {
  */
 #define DC_IOCTL_BLE_GET_NAME   DC_IOCTL_IOR('b', 0, DC_IOCTL_SIZE_VARIABLE)
 
+/**
+ * Get the negotiated ATT MTU (unsigned int) in bytes.
+ *
+ * The maximum payload of a single packet is three bytes less than the
+ * MTU. The default MTU of a BLE connection is 23 bytes.
+ */
+#define DC_IOCTL_BLE_GET_MTU    DC_IOCTL_IOR('b', 1, sizeof(unsigned int))
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
@@ -24,6 +24,8 @@
 
 #include <stddef.h>
 
+#include "context.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif /* __cplusplus */
@@ -33,6 +35,22 @@ typedef struct dc_buffer_t dc_buffer_t;
 dc_buffer_t *
 dc_buffer_new (size_t capacity);
 
+/*
+ * Create a buffer that allocates its memory with the allocator of the
+ * context (see dc_context_set_allocator). The context must stay valid
+ * until the buffer is freed.
+ */
+dc_buffer_t *
+dc_buffer_new_context (dc_context_t *context, size_t capacity);
+
+/*
+ * Create a read-only view on existing memory (e.g. a memory mapped
+ * file). The data is not copied and not freed. Functions that modify
+ * the contents of a view fail.
+ */
+dc_buffer_t *
+dc_buffer_new_view (const unsigned char data[], size_t size);
+
 void
 dc_buffer_free (dc_buffer_t *buffer);
 
@@ -48,6 +66,11 @@ dc_buffer_resize (dc_buffer_t *buffer, size_t size);
 int
 dc_buffer_append (dc_buffer_t *buffer, const unsigned char data[], size_t size);
 
+/*
+ * Prepend data to the buffer. The free space is kept in front of the
+ * data, so repeated prepends only move the data when the capacity is
+ * exhausted. Reserve the final size in advance to avoid that entirely.
+ */
 int
 dc_buffer_prepend (dc_buffer_t *buffer, const unsigned char data[], size_t size);
 
@@ -0,0 +1,70 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2026 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+#ifndef DC_COLUMN_H
+#define DC_COLUMN_H
+
+#include "common.h"
+#include "buffer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/*
+ * Compact storage format for the integer sample columns, such as the
+ * columns of dc_sample_batch_fixed_t.
+ *
+ * Each value is stored as the difference with the previous value (the
+ * first one with zero), zigzag encoded and written as a little endian
+ * base-128 varint of one to five bytes. The differences wrap around at
+ * 32 bits, so every column, including DC_SAMPLE_BATCH_NONE values, is
+ * restored exactly. Slowly changing columns, like the depth and
+ * temperature, need one or two bytes per sample.
+ *
+ * The number of values is not stored, the application has to keep it
+ * along with the encoded data.
+ */
+
+/*
+ * Get the maximum size of an encoded column with 'count' values.
+ */
+size_t
+dc_column_maxsize (unsigned int count);
+
+/*
+ * Encode the values, and append them to the buffer.
+ */
+dc_status_t
+dc_column_encode (dc_buffer_t *buffer, const unsigned int values[], unsigned int count);
+
+/*
+ * Decode 'count' values. The number of bytes that were used is
+ * returned in 'consumed', the next column starts right after it.
+ * Truncated or invalid data fails with DC_STATUS_DATAFORMAT.
+ */
+dc_status_t
+dc_column_decode (const unsigned char data[], size_t size, unsigned int values[], unsigned int count, size_t *consumed);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+#endif /* DC_COLUMN_H */
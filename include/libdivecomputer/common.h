@@ -55,6 +55,11 @@ typedef enum dc_transport_t {
 // Idiotic enums can't be queried
 #define DC_TRANSPORT_USBSTORAGE DC_TRANSPORT_USBSTORAGE
 
+typedef enum dc_hotplug_t {
+	DC_HOTPLUG_ARRIVED = 1,
+	DC_HOTPLUG_LEFT = 2,
+} dc_hotplug_t;
+
 typedef enum dc_family_t {
 	DC_FAMILY_NULL = 0,
 	/* Suunto */
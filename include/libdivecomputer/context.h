@@ -41,6 +41,48 @@ typedef enum dc_loglevel_t {
 
 typedef void (*dc_logfunc_t) (dc_context_t *context, dc_loglevel_t loglevel, const char *file, unsigned int line, const char *function, const char *message, void *userdata);
 
+/*
+ * Structured log record.
+ *
+ * For a regular message, the data is NULL. For a hexdump, the raw
+ * bytes are passed in the data and size fields, along with the prefix.
+ * The formatted message text of a hexdump is only generated when the
+ * DC_LOGRECORD_TEXT flag is set, and NULL otherwise.
+ */
+typedef struct dc_logrecord_t {
+	dc_loglevel_t loglevel;
+	const char *file;
+	unsigned int line;
+	const char *function;
+	const char *message;
+	const char *prefix;
+	const unsigned char *data;
+	unsigned int size;
+} dc_logrecord_t;
+
+#define DC_LOGRECORD_TEXT (1 << 0)
+
+typedef void (*dc_logrecordfunc_t) (dc_context_t *context, const dc_logrecord_t *record, void *userdata);
+
+/*
+ * Tracing spans, for timeline profilers. A span begins and ends with
+ * the same name, and a counter reports a single value. Spans on the
+ * same thread are properly nested. The names are static strings, such
+ * as "device.read" or "parser.samples". The value of a span end is the
+ * number of bytes transferred, if applicable, and zero otherwise.
+ */
+typedef enum dc_span_type_t {
+	DC_SPAN_BEGIN,
+	DC_SPAN_END,
+	DC_SPAN_COUNTER
+} dc_span_type_t;
+
+typedef void (*dc_spanfunc_t) (dc_context_t *context, dc_span_type_t type, const char *name, unsigned long long value, void *userdata);
+
+typedef void *(*dc_malloc_func_t) (size_t size, void *userdata);
+typedef void *(*dc_realloc_func_t) (void *ptr, size_t size, void *userdata);
+typedef void (*dc_free_func_t) (void *ptr, void *userdata);
+
 dc_status_t
 dc_context_new (dc_context_t **context);
 
@@ -53,6 +95,48 @@ dc_context_set_loglevel (dc_context_t *context, dc_loglevel_t loglevel);
 dc_status_t
 dc_context_set_logfunc (dc_context_t *context, dc_logfunc_t logfunc, void *userdata);
 
+/*
+ * Install a structured log function. It replaces the regular log
+ * function, and vice versa.
+ */
+dc_status_t
+dc_context_set_logrecordfunc (dc_context_t *context, dc_logrecordfunc_t logrecordfunc, unsigned int flags, void *userdata);
+
+dc_status_t
+dc_context_set_spanfunc (dc_context_t *context, dc_spanfunc_t spanfunc, void *userdata);
+
+/*
+ * Install the memory allocation functions for the parser, device and
+ * I/O stream objects that are created with the context, the copy of
+ * the dive data and the field cache strings of the parsers, and the
+ * buffers created with dc_buffer_new_context(), including the internal
+ * download buffers of the devices. Other memory owned by the
+ * individual backends is allocated with the C library. Either all
+ * three functions or none should be provided, and the default is the C
+ * library. The allocator should only be changed while no objects
+ * exist.
+ */
+dc_status_t
+dc_context_set_allocator (dc_context_t *context, dc_malloc_func_t mallocfunc, dc_realloc_func_t reallocfunc, dc_free_func_t freefunc, void *userdata);
+
+/*
+ * Limit the size of the download buffers, in bytes, for hosts with
+ * little memory. The limit is a cap on each buffer, and not a budget
+ * for all of them together: backends that need a single buffer larger
+ * than the limit fail with DC_STATUS_NOMEMORY. The dives queued for
+ * the application are delivered earlier, to keep their total size
+ * within the limit. Zero means no limit, which is the default.
+ */
+dc_status_t
+dc_context_set_memory_limit (dc_context_t *context, size_t limit);
+
+/*
+ * Enable the collection of statistics for the parsers created with the
+ * context afterwards. See dc_parser_get_stats().
+ */
+dc_status_t
+dc_context_set_parser_stats (dc_context_t *context, unsigned int enable);
+
 unsigned int
 dc_context_get_transports (dc_context_t *context);
 
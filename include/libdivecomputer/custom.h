@@ -30,6 +30,15 @@
 extern "C" {
 #endif /* __cplusplus */
 
+/**
+ * The callback functions of a custom I/O stream.
+ *
+ * The optional writev callback receives a batch of packets at once.
+ * Each buffer must be sent as a separate packet (e.g. a BLE write
+ * without response), and the callback is responsible for the flow
+ * control. Without it, the packets are passed to the write callback
+ * one by one.
+ */
 typedef struct dc_custom_cbs_t {
 	dc_status_t (*set_timeout) (void *userdata, int timeout);
 	dc_status_t (*set_break) (void *userdata, unsigned int value);
@@ -46,6 +55,7 @@ typedef struct dc_custom_cbs_t {
 	dc_status_t (*purge) (void *userdata, dc_direction_t direction);
 	dc_status_t (*sleep) (void *userdata, unsigned int milliseconds);
 	dc_status_t (*close) (void *userdata);
+	dc_status_t (*writev) (void *userdata, const dc_iovec_t iov[], size_t count, size_t *actual);
 } dc_custom_cbs_t;
 
 /**
@@ -61,6 +71,25 @@ typedef struct dc_custom_cbs_t {
 dc_status_t
 dc_custom_open (dc_iostream_t **iostream, dc_context_t *context, dc_transport_t transport, const dc_custom_cbs_t *callbacks, void *userdata);
 
+/**
+ * Push incoming data into a custom I/O stream.
+ *
+ * Without a read callback, the custom I/O stream keeps an internal
+ * receive buffer, and the library reads from that buffer instead. The
+ * application pushes the incoming data as it arrives, for example from
+ * a BLE notification handler. This function may be called from any
+ * thread. For the BLE and USB HID transports, each call is one packet.
+ *
+ * @param[in]   iostream   A valid custom I/O stream.
+ * @param[in]   data       The incoming data.
+ * @param[in]   size       The number of bytes.
+ * @returns #DC_STATUS_SUCCESS on success, #DC_STATUS_UNSUPPORTED if the
+ * I/O stream has a read callback, #DC_STATUS_IO if the receive buffer
+ * is full, or another #dc_status_t code on failure.
+ */
+dc_status_t
+dc_custom_push (dc_iostream_t *iostream, const void *data, size_t size);
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
@@ -23,6 +23,7 @@
 #define DC_DESCRIPTOR_H
 
 #include "common.h"
+#include "context.h"
 #include "iterator.h"
 
 #ifdef __cplusplus
@@ -44,6 +45,51 @@ typedef struct dc_descriptor_t dc_descriptor_t;
 dc_status_t
 dc_descriptor_iterator (dc_iterator_t **iterator);
 
+/**
+ * Create an iterator to enumerate the supported dive computers that
+ * match a low-level I/O device.
+ *
+ * This returns the same descriptors as checking every descriptor that
+ * supports the transport with #dc_descriptor_filter, but without
+ * walking the entire table.
+ *
+ * @param[out] iterator   A location to store the iterator.
+ * @param[in]  transport  The transport type of the I/O device. Exactly
+ *                        one transport type is allowed.
+ * @param[in]  userdata   A pointer to a transport specific data structure,
+ *                        as described in #dc_descriptor_filter.
+ * @returns #DC_STATUS_SUCCESS on success, or another #dc_status_t code
+ * on failure.
+ */
+dc_status_t
+dc_descriptor_iterator_match (dc_iterator_t **iterator, dc_transport_t transport, const void *userdata);
+
+/**
+ * Get the supported dive computers matching a transport, family and
+ * vendor, without walking the entire table.
+ *
+ * The descriptors are returned in the same order as with
+ * #dc_descriptor_iterator. They are read-only references, and don't
+ * need to be freed. If the array is too small, only the first 'size'
+ * descriptors are stored, but the total number of matches is still
+ * returned, such that the function can be called again with a larger
+ * array.
+ *
+ * @param[in]  transports   A bitmask with the transports, of which the
+ *                          dive computer has to support at least one, or
+ *                          DC_TRANSPORT_NONE for all transports.
+ * @param[in]  family       The family type, or DC_FAMILY_NULL for all
+ *                          families.
+ * @param[in]  vendor       The vendor name, or NULL for all vendors.
+ * @param[out] descriptors  An array to store the descriptors.
+ * @param[in]  size         The number of elements in the array.
+ * @param[out] count        A location to store the number of matches.
+ * @returns #DC_STATUS_SUCCESS on success, or another #dc_status_t code
+ * on failure.
+ */
+dc_status_t
+dc_descriptor_query (unsigned int transports, dc_family_t family, const char *vendor, dc_descriptor_t *descriptors[], size_t size, size_t *count);
+
 /**
  * Free the device descriptor.
  *
@@ -119,6 +165,49 @@ dc_descriptor_get_transports (dc_descriptor_t *descriptor);
 int
 dc_descriptor_filter (dc_descriptor_t *descriptor, dc_transport_t transport, const void *userdata);
 
+/**
+ * Callback for #dc_descriptor_scan.
+ *
+ * The device is a transport specific object (e.g. #dc_serial_device_t
+ * for DC_TRANSPORT_SERIAL), and the callback takes ownership of it. It
+ * must be released with the matching free function (e.g.
+ * #dc_serial_device_free).
+ *
+ * @param[in]  transport  The transport type of the device.
+ * @param[in]  device     The device.
+ * @param[in]  userdata   The user data passed to #dc_descriptor_scan.
+ * @returns Non-zero to continue scanning, or zero to stop.
+ */
+typedef int (*dc_descriptor_scan_callback_t) (dc_transport_t transport, void *device, void *userdata);
+
+/**
+ * Scan several transports for devices at the same time.
+ *
+ * Each transport is enumerated with its own iterator, on its own
+ * thread, such that a slow transport (e.g. a bluetooth inquiry) doesn't
+ * delay the others. The devices are reported as soon as they are found.
+ * The callback is never called from two threads at the same time, but
+ * not necessarily from the calling thread. The log function of the
+ * context must be safe to call from several threads. Without thread
+ * support, the transports are enumerated one after the other.
+ *
+ * Transports without an iterator (e.g. DC_TRANSPORT_BLE) and transports
+ * that are not supported on the platform are skipped.
+ *
+ * @param[in]  context     A valid context object.
+ * @param[in]  descriptor  An (optional) device descriptor to filter the
+ *                         devices.
+ * @param[in]  transports  A bitmask with the transports to scan. With a
+ *                         descriptor, only the transports supported by
+ *                         the dive computer are scanned.
+ * @param[in]  callback    The callback function to call for each device.
+ * @param[in]  userdata    User data to pass to the callback function.
+ * @returns #DC_STATUS_SUCCESS on success, or the error of the first
+ * failing transport.
+ */
+dc_status_t
+dc_descriptor_scan (dc_context_t *context, dc_descriptor_t *descriptor, unsigned int transports, dc_descriptor_scan_callback_t callback, void *userdata);
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
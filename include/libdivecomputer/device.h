@@ -64,12 +64,34 @@ typedef struct dc_event_vendor_t {
 	unsigned int size;
 } dc_event_vendor_t;
 
+typedef struct dc_device_stats_t {
+	/* Time spent in each phase (milliseconds). */
+	unsigned int handshake;
+	unsigned int logbook;
+	unsigned int profile;
+	unsigned int checksum;
+	unsigned int callback;
+	/* Transfer statistics. */
+	unsigned long long nread;
+	unsigned long long nwritten;
+	unsigned int npackets;
+	unsigned int nretries;
+	unsigned int ntimeouts;
+	/* Smoothed round-trip time and its variation (milliseconds). */
+	unsigned int rtt;
+	unsigned int rttvar;
+	/* Current baudrate of the serial line (zero if unknown). */
+	unsigned int baudrate;
+} dc_device_stats_t;
+
 typedef int (*dc_cancel_callback_t) (void *userdata);
 
 typedef void (*dc_event_callback_t) (dc_device_t *device, dc_event_type_t event, const void *data, void *userdata);
 
 typedef int (*dc_dive_callback_t) (const unsigned char *data, unsigned int size, const unsigned char *fingerprint, unsigned int fsize, void *userdata);
 
+typedef int (*dc_dump_callback_t) (unsigned int offset, const unsigned char *data, unsigned int size, void *userdata);
+
 dc_status_t
 dc_device_open (dc_device_t **out, dc_context_t *context, dc_descriptor_t *descriptor, dc_iostream_t *iostream);
 
@@ -79,12 +101,37 @@ dc_device_get_type (dc_device_t *device);
 dc_status_t
 dc_device_set_cancel (dc_device_t *device, dc_cancel_callback_t callback, void *userdata);
 
+/*
+ * Cancel the current and all further operations on the device. Unlike
+ * the cancellation callback, which is only checked between packets, this
+ * also interrupts a blocking wait for incoming data or a sleep. It's
+ * safe to call from another thread, and the device should be closed
+ * afterwards.
+ */
+dc_status_t
+dc_device_cancel (dc_device_t *device);
+
 dc_status_t
 dc_device_set_events (dc_device_t *device, unsigned int events, dc_event_callback_t callback, void *userdata);
 
 dc_status_t
 dc_device_set_fingerprint (dc_device_t *device, const unsigned char data[], unsigned int size);
 
+dc_status_t
+dc_device_set_progress (dc_device_t *device, unsigned int interval, unsigned int delta);
+
+dc_status_t
+dc_device_set_pipeline (dc_device_t *device, unsigned int depth);
+
+dc_status_t
+dc_device_set_checkpoint (dc_device_t *device, const unsigned char data[], unsigned int size);
+
+dc_status_t
+dc_device_get_checkpoint (dc_device_t *device, dc_buffer_t *buffer);
+
+dc_status_t
+dc_device_get_stats (dc_device_t *device, dc_device_stats_t *stats);
+
 dc_status_t
 dc_device_read (dc_device_t *device, unsigned int address, unsigned char data[], unsigned int size);
 
@@ -94,9 +141,61 @@ dc_device_write (dc_device_t *device, unsigned int address, const unsigned char
 dc_status_t
 dc_device_dump (dc_device_t *device, dc_buffer_t *buffer);
 
+/*
+ * Download a memory dump, reusing the unchanged parts of a previous
+ * dump of the same device. Backends without support for incremental
+ * dumps, or that can't use the previous dump, download everything.
+ */
+dc_status_t
+dc_device_dump_incremental (dc_device_t *device, dc_buffer_t *previous, dc_buffer_t *buffer);
+
+/*
+ * Download a memory dump, passing each chunk to the callback as soon as
+ * it's received. The offset is the position of the chunk in the memory
+ * dump. Chunks may arrive out of order, and a chunk can be passed more
+ * than once, so the callback should store each chunk at its offset. If
+ * the callback returns zero, the download is cancelled.
+ */
+dc_status_t
+dc_device_dump_stream (dc_device_t *device, dc_dump_callback_t callback, void *userdata);
+
 dc_status_t
 dc_device_foreach (dc_device_t *device, dc_dive_callback_t callback, void *userdata);
 
+/*
+ * Enumerate the dives without downloading their profiles, by passing
+ * only the logbook or header entry of each dive to the callback, most
+ * recent first. The fingerprint is the same as for dc_device_foreach,
+ * and the enumeration stops at the fingerprint in the same way. Only
+ * backends that store the headers separately support this.
+ */
+dc_status_t
+dc_device_foreach_header (dc_device_t *device, dc_dive_callback_t callback, void *userdata);
+
+/*
+ * Get the number of dives recorded after the fingerprint, without
+ * downloading them. If there are no new dives, this takes only one or
+ * two requests. The same backends as for dc_device_foreach_header are
+ * supported.
+ */
+dc_status_t
+dc_device_has_new_dives (dc_device_t *device, unsigned int *count);
+
+/*
+ * Download only the dives with one of the fingerprints, for example
+ * dives picked from dc_device_foreach_header. The fingerprints are
+ * stored back to back, each 'fsize' bytes long. Backends that know the
+ * fingerprint before downloading a dive skip the other dives, all
+ * others download them and only the selected dives are passed to the
+ * callback. The download stops once all selected dives are delivered.
+ * The fingerprint set with dc_device_set_fingerprint still applies.
+ */
+dc_status_t
+dc_device_download_selected (dc_device_t *device, const unsigned char fingerprints[], unsigned int fsize, unsigned int count, dc_dive_callback_t callback, void *userdata);
+
+dc_status_t
+dc_device_extract_dives (dc_descriptor_t *descriptor, dc_buffer_t *dump, dc_dive_callback_t callback, void *userdata);
+
 dc_status_t
 dc_device_timesync (dc_device_t *device, const dc_datetime_t *datetime);
 
@@ -0,0 +1,134 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2026 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+#ifndef DC_FINGERPRINT_H
+#define DC_FINGERPRINT_H
+
+#include "common.h"
+#include "context.h"
+#include "buffer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * The size of a dive digest, in bytes.
+ */
+#define DC_DIVE_DIGEST_SIZE 8
+
+/**
+ * Compute the digest of a dive.
+ *
+ * The digest is a fast, non-cryptographic hash that never changes
+ * between versions or platforms, so it can be stored and compared
+ * later to detect dives that were already imported. If the fingerprint
+ * from the dive callback is given, only the family type and the
+ * fingerprint are hashed, so the digest is the same even if a backend
+ * returns other bytes of the dive slightly differently. Otherwise the
+ * entire dive data is hashed.
+ *
+ * @param[in]   family       The family type of the device.
+ * @param[in]   data         The dive data.
+ * @param[in]   size         The size of the dive data.
+ * @param[in]   fingerprint  The fingerprint data, or NULL.
+ * @param[in]   fsize        The size of the fingerprint data.
+ * @param[out]  digest       A location to store the digest.
+ * @returns #DC_STATUS_SUCCESS on success, or another #dc_status_t code
+ * on failure.
+ */
+dc_status_t
+dc_dive_digest (dc_family_t family, const unsigned char data[], unsigned int size, const unsigned char fingerprint[], unsigned int fsize, unsigned char digest[DC_DIVE_DIGEST_SIZE]);
+
+/**
+ * Opaque object representing a fingerprint store.
+ */
+typedef struct dc_fingerprint_store_t dc_fingerprint_store_t;
+
+/**
+ * Open a fingerprint store.
+ *
+ * The store keeps the most recent fingerprint of each device, indexed
+ * by the family type, model number and serial number. It is backed by
+ * an append-only file, which is created if it doesn't exist yet. Each
+ * update is appended as a single checksummed record, so an interrupted
+ * write never corrupts the previously stored fingerprints. Superseded
+ * and incomplete records are discarded when the store is opened.
+ *
+ * A store can be shared between threads. Different processes should
+ * not open the same file at the same time.
+ *
+ * @param[out]  store      A location to store the fingerprint store.
+ * @param[in]   context    A valid context object.
+ * @param[in]   filename   The name of the file.
+ * @returns #DC_STATUS_SUCCESS on success, or another #dc_status_t code
+ * on failure.
+ */
+dc_status_t
+dc_fingerprint_store_open (dc_fingerprint_store_t **store, dc_context_t *context, const char *filename);
+
+/**
+ * Get the fingerprint of a device.
+ *
+ * @param[in]   store        A valid fingerprint store.
+ * @param[in]   family       The family type of the device.
+ * @param[in]   model        The model number of the device.
+ * @param[in]   serial       The serial number of the device.
+ * @param[out]  fingerprint  A buffer to store the fingerprint.
+ * @returns #DC_STATUS_SUCCESS on success, #DC_STATUS_UNSUPPORTED if
+ * there is no fingerprint for the device, or another #dc_status_t code
+ * on failure.
+ */
+dc_status_t
+dc_fingerprint_store_get (dc_fingerprint_store_t *store, dc_family_t family, unsigned int model, unsigned int serial, dc_buffer_t *fingerprint);
+
+/**
+ * Set the fingerprint of a device.
+ *
+ * The new fingerprint is written to the file before returning. An
+ * empty fingerprint removes the device from the store.
+ *
+ * @param[in]   store      A valid fingerprint store.
+ * @param[in]   family     The family type of the device.
+ * @param[in]   model      The model number of the device.
+ * @param[in]   serial     The serial number of the device.
+ * @param[in]   data       The fingerprint data.
+ * @param[in]   size       The size of the fingerprint data.
+ * @returns #DC_STATUS_SUCCESS on success, or another #dc_status_t code
+ * on failure.
+ */
+dc_status_t
+dc_fingerprint_store_set (dc_fingerprint_store_t *store, dc_family_t family, unsigned int model, unsigned int serial, const unsigned char data[], unsigned int size);
+
+/**
+ * Close the fingerprint store and free all resources.
+ *
+ * @param[in]   store      A valid fingerprint store.
+ * @returns #DC_STATUS_SUCCESS on success, or another #dc_status_t code
+ * on failure.
+ */
+dc_status_t
+dc_fingerprint_store_close (dc_fingerprint_store_t *store);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+#endif /* DC_FINGERPRINT_H */
@@ -50,12 +50,28 @@ hw_ostc3_device_customtext (dc_device_t *device, const char *text);
 dc_status_t
 hw_ostc3_device_config_read (dc_device_t *abstract, unsigned int config, unsigned char data[], unsigned int size);
 
+/*
+ * Read several settings in one exchange. The values are stored one
+ * after the other, each with the size given for its setting.
+ */
+dc_status_t
+hw_ostc3_device_config_read_multiple (dc_device_t *abstract, const unsigned int config[], const unsigned int size[], unsigned int count, unsigned char data[]);
+
 dc_status_t
 hw_ostc3_device_config_write (dc_device_t *abstract, unsigned int config, const unsigned char data[], unsigned int size);
 
 dc_status_t
 hw_ostc3_device_config_reset (dc_device_t *abstract);
 
+/*
+ * Enter service mode, which also supports all the download and
+ * settings commands. A session that needs both has to enter
+ * service mode first, because there is no way back from download
+ * mode without reconnecting.
+ */
+dc_status_t
+hw_ostc3_device_service (dc_device_t *abstract);
+
 dc_status_t
 hw_ostc3_device_fwupdate (dc_device_t *abstract, const char *filename, bool forceUpdate);
 
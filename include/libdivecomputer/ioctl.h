@@ -67,6 +67,28 @@ extern "C" {
 #define DC_IOCTL_TYPE(request) (((request) >>  8) & 0x00FF)
 #define DC_IOCTL_NR(request)   (((request) >>  0) & 0x00FF)
 
+/*
+ * Latency modes.
+ */
+typedef enum dc_latency_t {
+	DC_LATENCY_DEFAULT,    /**< Default settings of the transport. */
+	DC_LATENCY_LOW,        /**< Minimum latency, for short request/response exchanges. */
+	DC_LATENCY_THROUGHPUT, /**< Maximum throughput, for large transfers. */
+} dc_latency_t;
+
+/**
+ * Request minimum latency or maximum throughput.
+ *
+ * The argument is one of the #dc_latency_t values, passed as an
+ * unsigned int. This request is supported by all transports, but it
+ * is only a hint: each I/O stream maps it onto whatever its driver
+ * offers (e.g. the FTDI latency timer for serial ports), and returns
+ * #DC_STATUS_UNSUPPORTED if there is nothing to tune. Custom I/O streams receive it through their ioctl
+ * callback, where a BLE implementation can for example request a
+ * shorter connection interval.
+ */
+#define DC_IOCTL_SET_LATENCY DC_IOCTL_IOW('g', 0, sizeof(unsigned int))
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
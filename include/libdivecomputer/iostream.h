@@ -35,6 +35,29 @@ extern "C" {
  */
 typedef struct dc_iostream_t dc_iostream_t;
 
+/**
+ * Opaque object representing an event loop.
+ */
+typedef struct dc_loop_t dc_loop_t;
+
+/**
+ * Completion callback for asynchronous read and write requests.
+ *
+ * @param[in]  iostream  The I/O stream of the request.
+ * @param[in]  status    The result of the request.
+ * @param[in]  actual    The actual number of bytes transferred.
+ * @param[in]  userdata  The user data pointer of the request.
+ */
+typedef void (*dc_iostream_callback_t) (dc_iostream_t *iostream, dc_status_t status, size_t actual, void *userdata);
+
+/**
+ * A buffer for a vectored write.
+ */
+typedef struct dc_iovec_t {
+	const void *data; /**< The data. */
+	size_t size;      /**< The size of the data in bytes. */
+} dc_iovec_t;
+
 /**
  * The parity checking scheme.
  */
@@ -253,6 +276,45 @@ dc_iostream_read (dc_iostream_t *iostream, void *data, size_t size, size_t *actu
 dc_status_t
 dc_iostream_write (dc_iostream_t *iostream, const void *data, size_t size, size_t *actual);
 
+/**
+ * Start an asynchronous read from the I/O stream.
+ *
+ * The request completes once the buffer is full, a shorter packet has
+ * been received, or an error occurs. The callback is always invoked
+ * from #dc_loop_run. Requests on the same I/O stream are completed in
+ * the order they were started. Backends without native support for
+ * asynchronous requests are serviced by the event loop, using the
+ * regular blocking functions on data that has already arrived.
+ *
+ * @param[in]  iostream  A valid I/O stream.
+ * @param[in]  loop      A valid event loop.
+ * @param[out] data      The memory buffer to read the data into. It
+ *                       must remain valid until the callback runs.
+ * @param[in]  size      The number of bytes to read.
+ * @param[in]  callback  The completion callback.
+ * @param[in]  userdata  The user data pointer for the callback.
+ * @returns #DC_STATUS_SUCCESS on success, or another #dc_status_t code
+ * on failure. On failure, the callback is not invoked.
+ */
+dc_status_t
+dc_iostream_read_async (dc_iostream_t *iostream, dc_loop_t *loop, void *data, size_t size, dc_iostream_callback_t callback, void *userdata);
+
+/**
+ * Start an asynchronous write to the I/O stream.
+ *
+ * @param[in]  iostream  A valid I/O stream.
+ * @param[in]  loop      A valid event loop.
+ * @param[in]  data      The memory buffer to write the data from. It
+ *                       must remain valid until the callback runs.
+ * @param[in]  size      The number of bytes to write.
+ * @param[in]  callback  The completion callback.
+ * @param[in]  userdata  The user data pointer for the callback.
+ * @returns #DC_STATUS_SUCCESS on success, or another #dc_status_t code
+ * on failure. On failure, the callback is not invoked.
+ */
+dc_status_t
+dc_iostream_write_async (dc_iostream_t *iostream, dc_loop_t *loop, const void *data, size_t size, dc_iostream_callback_t callback, void *userdata);
+
 /**
  * Perform an I/O stream specific request.
  *
@@ -310,6 +372,51 @@ dc_iostream_sleep (dc_iostream_t *iostream, unsigned int milliseconds);
 dc_status_t
 dc_iostream_close (dc_iostream_t *iostream);
 
+/**
+ * Create a new event loop.
+ *
+ * A single thread can drive the asynchronous requests of any number of
+ * I/O streams with one event loop.
+ *
+ * @param[out] loop     A location to store the event loop.
+ * @param[in]  context  A valid context object.
+ * @returns #DC_STATUS_SUCCESS on success, or another #dc_status_t code
+ * on failure.
+ */
+dc_status_t
+dc_loop_new (dc_loop_t **loop, dc_context_t *context);
+
+/**
+ * Process the asynchronous requests and invoke their callbacks.
+ *
+ * The function returns once there are no more outstanding requests,
+ * including those started from within the callbacks, or when the
+ * timeout expires.
+ *
+ * @param[in]  loop     A valid event loop.
+ * @param[in]  timeout  The timeout in milliseconds. A negative value
+ *                      waits forever, and zero performs a single pass.
+ * @returns #DC_STATUS_SUCCESS if no requests are left,
+ * #DC_STATUS_TIMEOUT if some requests are still outstanding, or another
+ * #dc_status_t code on failure.
+ */
+dc_status_t
+dc_loop_run (dc_loop_t *loop, int timeout);
+
+/**
+ * Free the event loop.
+ *
+ * Requests that are still waiting to be serviced by the event loop are
+ * completed with #DC_STATUS_CANCELLED. Requests that a backend is
+ * handling natively must have completed first.
+ *
+ * @param[in]  loop  A valid event loop.
+ * @returns #DC_STATUS_SUCCESS on success, or another #dc_status_t code
+ * on failure.
+ */
+dc_status_t
+dc_loop_free (dc_loop_t *loop);
+
 dc_status_t
 dc_usb_storage_open (dc_iostream_t **out, dc_context_t *context, const char *name);
 
@@ -22,6 +22,8 @@
 #ifndef DC_ITERATOR_H
 #define DC_ITERATOR_H
 
+#include <stddef.h>
+
 #include "common.h"
 
 #ifdef __cplusplus
@@ -33,6 +35,15 @@ typedef struct dc_iterator_t dc_iterator_t;
 dc_status_t
 dc_iterator_next (dc_iterator_t *iterator, void *item);
 
+/*
+ * Get up to 'size' items at once. The number of items is stored in
+ * 'count', and is only smaller than 'size' at the end of the iteration.
+ * All iterators return pointers, and the items are stored as such.
+ * Without any items left, DC_STATUS_DONE is returned.
+ */
+dc_status_t
+dc_iterator_next_n (dc_iterator_t *iterator, void *items[], size_t size, size_t *count);
+
 dc_status_t
 dc_iterator_free (dc_iterator_t *iterator);
 
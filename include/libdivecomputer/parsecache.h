@@ -0,0 +1,114 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2026 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+#ifndef DC_PARSECACHE_H
+#define DC_PARSECACHE_H
+
+#include "common.h"
+#include "context.h"
+#include "buffer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * Opaque object representing a parse cache.
+ */
+typedef struct dc_parse_cache_t dc_parse_cache_t;
+
+/**
+ * Open a parse cache.
+ *
+ * The cache keeps the results of parsing a dive, indexed by the family
+ * type, the model number, the version of the parsers and the digest of
+ * the dive data. The contents of a result are up to the application,
+ * for example the summary fields and the sample columns encoded with
+ * dc_column_encode(). Each result is stored in its own record, and is
+ * only read from the file when it is requested.
+ *
+ * The cache is backed by an append-only file, which is created if it
+ * doesn't exist yet, with the same checksummed records as the
+ * fingerprint store. Results from another version of the library are
+ * discarded when the cache is opened, because the parsers may have
+ * changed.
+ *
+ * A cache can be shared between threads. Different processes should
+ * not open the same file at the same time.
+ *
+ * @param[out]  cache      A location to store the parse cache.
+ * @param[in]   context    A valid context object.
+ * @param[in]   filename   The name of the file.
+ * @returns #DC_STATUS_SUCCESS on success, or another #dc_status_t code
+ * on failure.
+ */
+dc_status_t
+dc_parse_cache_open (dc_parse_cache_t **cache, dc_context_t *context, const char *filename);
+
+/**
+ * Get the cached result for a dive.
+ *
+ * @param[in]   cache      A valid parse cache.
+ * @param[in]   family     The family type of the device.
+ * @param[in]   model      The model number of the device.
+ * @param[in]   data       The dive data.
+ * @param[in]   size       The size of the dive data.
+ * @param[out]  result     A buffer to store the result.
+ * @returns #DC_STATUS_SUCCESS on success, #DC_STATUS_UNSUPPORTED if
+ * the dive is not in the cache, or another #dc_status_t code on
+ * failure.
+ */
+dc_status_t
+dc_parse_cache_get (dc_parse_cache_t *cache, dc_family_t family, unsigned int model, const unsigned char data[], unsigned int size, dc_buffer_t *result);
+
+/**
+ * Store the result for a dive.
+ *
+ * The result is written to the file before returning. An empty result
+ * removes the dive from the cache.
+ *
+ * @param[in]   cache      A valid parse cache.
+ * @param[in]   family     The family type of the device.
+ * @param[in]   model      The model number of the device.
+ * @param[in]   data       The dive data.
+ * @param[in]   size       The size of the dive data.
+ * @param[in]   result     The result data.
+ * @param[in]   rsize      The size of the result data.
+ * @returns #DC_STATUS_SUCCESS on success, or another #dc_status_t code
+ * on failure.
+ */
+dc_status_t
+dc_parse_cache_set (dc_parse_cache_t *cache, dc_family_t family, unsigned int model, const unsigned char data[], unsigned int size, const unsigned char result[], unsigned int rsize);
+
+/**
+ * Close the parse cache and free all resources.
+ *
+ * @param[in]   cache      A valid parse cache.
+ * @returns #DC_STATUS_SUCCESS on success, or another #dc_status_t code
+ * on failure.
+ */
+dc_status_t
+dc_parse_cache_close (dc_parse_cache_t *cache);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+#endif /* DC_PARSECACHE_H */
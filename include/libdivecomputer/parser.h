@@ -48,10 +48,16 @@ typedef enum dc_sample_type_t {
 	DC_SAMPLE_DECO,
 	DC_SAMPLE_GASMIX,
 	DC_SAMPLE_TTS,		// time to surface in seconds
+	DC_SAMPLE_POSITION,	// GPS position
 } dc_sample_type_t;
 
 // Make it easy to test support compile-time with "#ifdef DC_SAMPLE_TTS"
 #define DC_SAMPLE_TTS DC_SAMPLE_TTS
+#define DC_SAMPLE_POSITION DC_SAMPLE_POSITION
+
+// Sample type masks for dc_parser_set_sample_mask()
+#define DC_SAMPLE_MASK(type) (1u << (type))
+#define DC_SAMPLE_MASK_ALL 0xFFFFFFFFu
 
 typedef enum dc_field_type_t {
 	DC_FIELD_DIVETIME,
@@ -69,10 +75,19 @@ typedef enum dc_field_type_t {
 	DC_FIELD_DIVEMODE,
 	DC_FIELD_DECOMODEL,
 	DC_FIELD_STRING,
+	DC_FIELD_LOCATION,
+	DC_FIELD_SAMPLE_COUNT, // Upper bound, flags is the sample type
+	DC_FIELD_SAMPLE_INTERVAL,
 } dc_field_type_t;
 
 // Make it easy to test support compile-time with "#ifdef DC_FIELD_STRING"
 #define DC_FIELD_STRING DC_FIELD_STRING
+#define DC_FIELD_LOCATION DC_FIELD_LOCATION
+#define DC_FIELD_SAMPLE_COUNT DC_FIELD_SAMPLE_COUNT
+#define DC_FIELD_SAMPLE_INTERVAL DC_FIELD_SAMPLE_INTERVAL
+
+// Field type masks for dc_parser_get_header_fields()
+#define DC_FIELD_MASK(type) (1u << (type))
 
 typedef enum parser_sample_event_t {
 	SAMPLE_EVENT_NONE,
@@ -274,6 +289,34 @@ typedef struct dc_decomodel_t {
 	} params;
 } dc_decomodel_t;
 
+/*
+ * Location
+ *
+ * The latitude and longitude are in degrees, positive towards the north
+ * and the east. The entry point of the dive has index zero, and the exit
+ * point (if available) index one.
+ */
+typedef struct dc_location_t {
+	double latitude;
+	double longitude;
+} dc_location_t;
+
+#define DC_LOCATION_ENTRY 0
+#define DC_LOCATION_EXIT  1
+
+/*
+ * Sample interval
+ *
+ * The interval is the time between the time samples in milliseconds.
+ * If the regular field is non-zero, every time sample is exactly one
+ * interval after the previous one. Otherwise, gaps such as surface
+ * intervals are recorded with a different timestamp.
+ */
+typedef struct dc_sample_interval_t {
+	unsigned int interval;
+	unsigned int regular;
+} dc_sample_interval_t;
+
 typedef struct dc_field_string_t {
 	const char *desc;
 	const char *value;
@@ -315,18 +358,307 @@ typedef union dc_sample_value_t {
 		unsigned int tts;
 	} deco;
 	unsigned int gasmix; /* Gas mix index */
+	struct {
+		double latitude; /* Degrees */
+		double longitude; /* Degrees */
+	} position;
 } dc_sample_value_t;
 
 typedef struct dc_parser_t dc_parser_t;
 
 typedef void (*dc_sample_callback_t) (dc_sample_type_t type, const dc_sample_value_t *value, void *userdata);
 
+/*
+ * Sample callback which can stop the sample walk, by returning zero.
+ */
+typedef int (*dc_sample_callback2_t) (dc_sample_type_t type, const dc_sample_value_t *value, void *userdata);
+
+/*
+ * Fixed point sample values
+ *
+ * The same samples as dc_sample_value_t, with the floating point
+ * values replaced by integers in fixed units. Negative depths and
+ * pressures are reported as zero.
+ */
+typedef union dc_sample_value_fixed_t {
+	unsigned int time; /* Milliseconds */
+	unsigned int depth; /* Millimeters */
+	struct {
+		unsigned int tank;
+		unsigned int value; /* Millibar */
+	} pressure;
+	unsigned int temperature; /* Millikelvin */
+	struct {
+		unsigned int type;
+		unsigned int time;
+		unsigned int flags;
+		unsigned int value;
+		const char *name;
+	} event;
+	unsigned int rbt;
+	unsigned int heartbeat;
+	unsigned int bearing;
+	struct {
+		unsigned int type;
+		unsigned int size;
+		const void *data;
+	} vendor;
+	unsigned int setpoint; /* Millibar */
+	struct {
+		unsigned int sensor;
+		unsigned int value; /* Millibar */
+	} ppo2;
+	unsigned int cns; /* Hundredths of a percent */
+	struct {
+		unsigned int type;
+		unsigned int time;
+		unsigned int depth; /* Millimeters */
+		unsigned int tts;
+	} deco;
+	unsigned int gasmix; /* Gas mix index */
+	struct {
+		int latitude; /* Microdegrees */
+		int longitude; /* Microdegrees */
+	} position;
+} dc_sample_value_fixed_t;
+
+typedef void (*dc_sample_fixed_callback_t) (dc_sample_type_t type, const dc_sample_value_fixed_t *value, void *userdata);
+
+/*
+ * Vector sample
+ *
+ * All the ppO2 sensors, or all the tank pressures, of a single time
+ * sample. The index is the sensor or tank number.
+ */
+#define DC_SAMPLE_MAXVECTOR 8
+
+typedef struct dc_sample_vector_t {
+	unsigned int count;
+	unsigned int index[DC_SAMPLE_MAXVECTOR];
+	double value[DC_SAMPLE_MAXVECTOR];
+} dc_sample_vector_t;
+
+typedef void (*dc_sample_vector_callback_t) (dc_sample_type_t type, const dc_sample_vector_t *vector, void *userdata);
+
+/*
+ * Columnar sample batch
+ *
+ * The caller provides one array per column, each with room for at
+ * least "capacity" samples. Columns that are not needed can be left
+ * NULL. The pressure column is an array of "ntanks" arrays, indexed
+ * by the tank number first and the sample number second.
+ *
+ * The parser fills the arrays with up to "capacity" samples, sets the
+ * "count" field, and hands the block to the batch callback. The same
+ * arrays are reused for the next block, so the callback has to copy
+ * the data it wants to keep.
+ *
+ * Every row starts with a time sample. Values that are not present in
+ * a row are set to NAN for the floating point columns, and to
+ * DC_SAMPLE_BATCH_NONE for the integer columns.
+ *
+ * The ppo2 column has room for a single value per row. It contains the
+ * combined ppo2 (DC_SENSOR_NONE) if the dive computer reports one, and
+ * the value of the first sensor in the row otherwise. The individual
+ * sensors are only available through the sample callbacks.
+ */
+
+#define DC_SAMPLE_BATCH_NONE 0xFFFFFFFF
+
+typedef struct dc_sample_batch_t {
+	unsigned int capacity;
+	unsigned int count;
+	unsigned int ntanks;
+	unsigned int *time;         /* Milliseconds */
+	double *depth;
+	double *temperature;
+	double **pressure;          /* pressure[tank][sample] */
+	unsigned int *rbt;
+	unsigned int *heartbeat;
+	unsigned int *bearing;
+	double *setpoint;
+	double *ppo2;
+	double *cns;
+	unsigned int *gasmix;
+	unsigned int *deco_type;
+	unsigned int *deco_time;
+	double *deco_depth;
+	unsigned int *tts;
+	/* Only with dc_parser_set_implicit_time() enabled. */
+	unsigned int start;         /* Time of the first row (milliseconds) */
+	unsigned int interval;      /* Time between the rows (milliseconds) */
+} dc_sample_batch_t;
+
+typedef void (*dc_sample_batch_callback_t) (const dc_sample_batch_t *batch, void *userdata);
+
+/*
+ * Columnar sample batch with the fixed point units of
+ * dc_sample_value_fixed_t. Values that are not present in a row are
+ * set to DC_SAMPLE_BATCH_NONE in all columns.
+ */
+typedef struct dc_sample_batch_fixed_t {
+	unsigned int capacity;
+	unsigned int count;
+	unsigned int ntanks;
+	unsigned int *time;         /* Milliseconds */
+	unsigned int *depth;        /* Millimeters */
+	unsigned int *temperature;  /* Millikelvin */
+	unsigned int **pressure;    /* Millibar, pressure[tank][sample] */
+	unsigned int *rbt;
+	unsigned int *heartbeat;
+	unsigned int *bearing;
+	unsigned int *setpoint;     /* Millibar */
+	unsigned int *ppo2;         /* Millibar */
+	unsigned int *cns;          /* Hundredths of a percent */
+	unsigned int *gasmix;
+	unsigned int *deco_type;
+	unsigned int *deco_time;
+	unsigned int *deco_depth;   /* Millimeters */
+	unsigned int *tts;
+	/* Only with dc_parser_set_implicit_time() enabled. */
+	unsigned int start;         /* Time of the first row (milliseconds) */
+	unsigned int interval;      /* Time between the rows (milliseconds) */
+} dc_sample_batch_fixed_t;
+
+typedef void (*dc_sample_batch_fixed_callback_t) (const dc_sample_batch_fixed_t *batch, void *userdata);
+
+/*
+ * Parser statistics, collected when enabled on the context. The sample
+ * and event counters are indexed by the sample and event type. The
+ * time of the sample walks includes the time spent in the callback.
+ */
+#define DC_PARSER_STATS_TYPES 32
+
+typedef struct dc_parser_stats_t {
+	unsigned int samples[DC_PARSER_STATS_TYPES];
+	unsigned int events[DC_PARSER_STATS_TYPES];
+	/* Number of sample walks, and the dive data they covered. */
+	unsigned int nwalks;
+	unsigned long long nbytes;
+	/* Number of field requests. */
+	unsigned int nfields;
+	/* Time spent in the sample walks and field requests (microseconds). */
+	unsigned long long samples_time;
+	unsigned long long field_time;
+	/* Number of memory allocations made by the parser. */
+	unsigned int nallocs;
+} dc_parser_stats_t;
+
+/*
+ * Summary of the header fields, as returned by dc_parser_get_summary().
+ * The fields member contains the DC_FIELD_MASK() values of the fields
+ * that are available, all other members are zero. The entries beyond
+ * the size of the arrays are only available with dc_parser_get_field(),
+ * which also returns the same strings.
+ */
+#define DC_SUMMARY_GASMIXES  20
+#define DC_SUMMARY_TANKS     20
+#define DC_SUMMARY_STRINGS   32
+#define DC_SUMMARY_LOCATIONS 2
+
+typedef struct dc_parser_summary_t {
+	unsigned int fields;
+	unsigned int divetime;
+	double maxdepth;
+	double avgdepth;
+	unsigned int gasmix_count;
+	dc_gasmix_t gasmix[DC_SUMMARY_GASMIXES];
+	dc_salinity_t salinity;
+	double atmospheric;
+	double temperature_surface;
+	double temperature_minimum;
+	double temperature_maximum;
+	unsigned int tank_count;
+	dc_tank_t tank[DC_SUMMARY_TANKS];
+	dc_divemode_t divemode;
+	dc_decomodel_t decomodel;
+	unsigned int string_count;
+	dc_field_string_t string[DC_SUMMARY_STRINGS];
+	unsigned int location_count;
+	dc_location_t location[DC_SUMMARY_LOCATIONS];
+	dc_sample_interval_t sample_interval;
+} dc_parser_summary_t;
+
+/*
+ * Resampling modes
+ *
+ * DC_RESAMPLE_LAST keeps the most recent value of each sample type
+ * within an interval. DC_RESAMPLE_ENVELOPE does the same, except for
+ * the depth, where the minimum and maximum depth of the interval are
+ * reported, each at its own time.
+ */
+typedef enum dc_resample_mode_t {
+	DC_RESAMPLE_LAST,
+	DC_RESAMPLE_ENVELOPE,
+} dc_resample_mode_t;
+
+/*
+ * Callback for dc_parse_batch(). It's called from one of the worker
+ * threads, with a parser bound to the dive at position 'index' in the
+ * input. The parser is only valid during the callback.
+ */
+typedef dc_status_t (*dc_parse_batch_callback_t) (dc_parser_t *parser, unsigned int index, void *userdata);
+
 dc_status_t
 dc_parser_new (dc_parser_t **parser, dc_device_t *device, const unsigned char data[], size_t size);
 
 dc_status_t
 dc_parser_new2 (dc_parser_t **parser, dc_context_t *context, dc_descriptor_t *descriptor, const unsigned char data[], size_t size);
 
+/*
+ * Create a parser for the summary fields only.
+ *
+ * The parser behaves like one created with dc_parser_new2(), but backends
+ * are allowed to take the summary fields (divetime, maximum depth, etc)
+ * from the dive header, instead of decoding the entire sample stream.
+ * Fields that can only be derived from the samples may be missing. The
+ * samples can still be retrieved with dc_parser_samples_foreach().
+ */
+dc_status_t
+dc_parser_new_summary (dc_parser_t **parser, dc_context_t *context, dc_descriptor_t *descriptor, const unsigned char data[], size_t size);
+
+/*
+ * Create a parser without copying the dive data.
+ *
+ * The parser behaves like one created with dc_parser_new2(), but keeps
+ * a reference to the caller's buffer instead of a private copy. The
+ * buffer must remain valid, and must not be modified, until the parser
+ * is destroyed with dc_parser_destroy().
+ */
+dc_status_t
+dc_parser_new_borrowed (dc_parser_t **parser, dc_context_t *context, dc_descriptor_t *descriptor, const unsigned char data[], size_t size);
+
+/*
+ * Get the size of the storage needed for a parser for the device, or
+ * zero if the parser can't be created in place.
+ */
+size_t
+dc_parser_sizeof (dc_descriptor_t *descriptor);
+
+/*
+ * Create a parser in storage provided by the caller, instead of
+ * allocating it. The storage must be suitably aligned for any type,
+ * hold at least dc_parser_sizeof() bytes, and remain valid until the
+ * parser is destroyed with dc_parser_destroy(), which doesn't free it.
+ * The dive data is borrowed, as with dc_parser_new_borrowed().
+ */
+dc_status_t
+dc_parser_init_inplace (dc_parser_t **parser, void *storage, size_t capacity, dc_context_t *context, dc_descriptor_t *descriptor, const unsigned char data[], size_t size);
+
+/*
+ * Rebind an existing parser to the data of another dive.
+ *
+ * The parser keeps its configuration (model, serial number, clock,
+ * atmospheric pressure and density), but all cached information about
+ * the previous dive is discarded. The private copy of the data is
+ * reused whenever the new dive fits. For a parser created with
+ * dc_parser_new_borrowed(), the new buffer is referenced instead, and
+ * the same lifetime rules apply. If the reset fails, the parser can
+ * only be reset again or destroyed.
+ */
+dc_status_t
+dc_parser_reset (dc_parser_t *parser, const unsigned char data[], size_t size);
+
 dc_family_t
 dc_parser_get_type (dc_parser_t *parser);
 
@@ -339,18 +671,179 @@ dc_parser_set_atmospheric (dc_parser_t *parser, double atmospheric);
 dc_status_t
 dc_parser_set_density (dc_parser_t *parser, double density);
 
+/*
+ * Select the sample types that are reported by the sample functions,
+ * as a combination of DC_SAMPLE_MASK() values. Time samples are always
+ * reported. Backends may skip decoding the other types entirely. The
+ * default is DC_SAMPLE_MASK_ALL, and the mask survives a reset.
+ */
+dc_status_t
+dc_parser_set_sample_mask (dc_parser_t *parser, unsigned int mask);
+
+/*
+ * Leave the time column of the sample batches implicit. Each block that
+ * is passed to the batch callbacks then has equally spaced rows, with
+ * row i at start + i * interval milliseconds, and the time column can
+ * be left NULL. A time sample that doesn't fit, such as the end of a
+ * surface interval, starts a new block. The interval is taken from
+ * DC_FIELD_SAMPLE_INTERVAL, or from the first two rows of the block
+ * for backends without it. The setting survives a reset.
+ */
+dc_status_t
+dc_parser_set_implicit_time (dc_parser_t *parser, unsigned int enable);
+
 dc_status_t
 dc_parser_get_datetime (dc_parser_t *parser, dc_datetime_t *datetime);
 
+/*
+ * Get a header field. For the DC_FIELD_SAMPLE_COUNT field, the flags
+ * are the sample type, and the value is an upper bound for the number
+ * of samples of that type, to preallocate storage. Backends that can't
+ * tell it from the header fall back to counting the samples.
+ */
 dc_status_t
 dc_parser_get_field (dc_parser_t *parser, dc_field_type_t type, unsigned int flags, void *value);
 
+/*
+ * Get all the header fields at once. This is equivalent to requesting
+ * each field with dc_parser_get_field(), including the gas mixes, tanks,
+ * strings and locations, but without the per call overhead.
+ */
+dc_status_t
+dc_parser_get_summary (dc_parser_t *parser, dc_parser_summary_t *summary);
+
+/*
+ * Retrieve the fields, as a combination of DC_FIELD_MASK() values, that
+ * the backend takes directly from the dive header. The first request
+ * for any other field decodes the entire profile. Fields which are not
+ * supported at all are also included.
+ */
+dc_status_t
+dc_parser_get_header_fields (dc_parser_t *parser, unsigned int *fields);
+
+/*
+ * Retrieve the statistics of the parser, accumulated since it was
+ * created. Fails with DC_STATUS_UNSUPPORTED if the statistics were not
+ * enabled on the context when the parser was created.
+ */
+dc_status_t
+dc_parser_get_stats (dc_parser_t *parser, dc_parser_stats_t *stats);
+
 dc_status_t
 dc_parser_samples_foreach (dc_parser_t *parser, dc_sample_callback_t callback, void *userdata);
 
+/*
+ * Same as dc_parser_samples_foreach(), but the walk ends as soon as the
+ * callback returns zero, and no more samples are reported. Most
+ * backends also stop decoding the remainder of the profile.
+ */
+dc_status_t
+dc_parser_samples_foreach2 (dc_parser_t *parser, dc_sample_callback2_t callback, void *userdata);
+
+/*
+ * Retrieve the samples with a time between 'begin' and 'end'
+ * milliseconds, inclusive. Backends with a seek index start decoding
+ * close to the beginning of the range. All others walk the profile
+ * from the start, and drop the samples before the range. State changes
+ * from before the range, such as the active gas mix, are not repeated.
+ */
+dc_status_t
+dc_parser_samples_range (dc_parser_t *parser, unsigned int begin, unsigned int end, dc_sample_callback_t callback, void *userdata);
+
+dc_status_t
+dc_parser_samples_batch (dc_parser_t *parser, dc_sample_batch_t *batch, dc_sample_batch_callback_t callback, void *userdata);
+
+/*
+ * Retrieve the samples in fixed point units, one by one or in
+ * columnar blocks. The sample mask applies as for the floating point
+ * variants.
+ */
+dc_status_t
+dc_parser_samples_fixed (dc_parser_t *parser, dc_sample_fixed_callback_t callback, void *userdata);
+
+dc_status_t
+dc_parser_samples_batch_fixed (dc_parser_t *parser, dc_sample_batch_fixed_t *batch, dc_sample_batch_fixed_callback_t callback, void *userdata);
+
+/*
+ * Retrieve the samples reduced to at most one time sample for every
+ * 'interval' milliseconds, or two with DC_RESAMPLE_ENVELOPE. Without
+ * the envelope, the time of the most recent sample in the interval is
+ * reported. Events and
+ * vendor samples are never dropped, and are reported with the last
+ * time sample of their interval.
+ */
+dc_status_t
+dc_parser_samples_resample (dc_parser_t *parser, unsigned int interval, dc_resample_mode_t mode, dc_sample_callback_t callback, void *userdata);
+
+/*
+ * Retrieve the samples with the warnings that are repeated on every
+ * sample combined. The first occurrence of an event is reported with
+ * the SAMPLE_FLAGS_BEGIN flag. The repetitions in the following time
+ * samples are dropped. An event with the SAMPLE_FLAGS_END flag is
+ * reported in the first time sample without it, or at the end of the
+ * dive. Events that already have a begin or end flag, bookmarks,
+ * headings and gas changes are passed on unchanged.
+ */
+dc_status_t
+dc_parser_samples_coalesce (dc_parser_t *parser, dc_sample_callback_t callback, void *userdata);
+
+/*
+ * Retrieve the samples with the ppO2 and pressure samples of each time
+ * sample combined into a single vector, which is passed to the vector
+ * callback, with the DC_SAMPLE_PPO2 or DC_SAMPLE_PRESSURE type, right
+ * before the next time sample. A repeated sensor or tank replaces the
+ * earlier value. All other samples are passed to the regular callback
+ * unchanged.
+ */
+dc_status_t
+dc_parser_samples_vector (dc_parser_t *parser, dc_sample_callback_t callback, dc_sample_vector_callback_t vector, void *userdata);
+
+/*
+ * Retrieve the samples with decompression information computed by the
+ * library, for dive computers that don't record it. A Buhlmann ZHL-16C
+ * model is run over the profile, with the gradient factors of the dive
+ * computer if they are known. For every time sample without a deco
+ * sample from the dive computer, a deco sample with the NDL, or the
+ * first stop, and the time to surface is added. Open circuit is
+ * assumed, and the ascent is calculated on the active gas mix.
+ */
+dc_status_t
+dc_parser_samples_deco (dc_parser_t *parser, dc_sample_callback_t callback, void *userdata);
+
+/*
+ * Append data to a dive that is still being written, and emit the
+ * samples of all complete records that were not emitted by a previous
+ * call. The first call emits the samples from the start of the dive.
+ * A trailing partial record is kept until the remaining data arrives.
+ *
+ * Only backends with a sequential record format support this, and
+ * return DC_STATUS_UNSUPPORTED otherwise. For a parser created with
+ * dc_parser_new_borrowed(), the data is copied into a private buffer.
+ * A reset of the parser starts again from the beginning.
+ */
+dc_status_t
+dc_parser_append (dc_parser_t *parser, const unsigned char data[], size_t size, dc_sample_callback_t callback, void *userdata);
+
 dc_status_t
 dc_parser_destroy (dc_parser_t *parser);
 
+/*
+ * Parse a set of dives on a pool of worker threads.
+ *
+ * The callback is invoked once for each of the 'count' dives, with a
+ * parser created from the descriptor. The worker threads share the
+ * context, so the log function and the callback must be safe to call
+ * from several threads at the same time. Passing zero for 'nthreads'
+ * uses one thread per processor.
+ *
+ * The parsers reference the data directly, so the buffers must remain
+ * valid until the function returns. The result of each dive is stored
+ * in the optional 'status' array, in input order. The return value is
+ * the first error in input order, or DC_STATUS_SUCCESS.
+ */
+dc_status_t
+dc_parse_batch (dc_context_t *context, dc_descriptor_t *descriptor, const unsigned char *const data[], const size_t size[], unsigned int count, unsigned int nthreads, dc_parse_batch_callback_t callback, void *userdata, dc_status_t status[]);
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
@@ -0,0 +1,96 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2026 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+#ifndef DC_RELAY_H
+#define DC_RELAY_H
+
+#include "common.h"
+#include "context.h"
+#include "iostream.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * The relay options.
+ */
+typedef enum dc_relay_flags_t {
+	DC_RELAY_COMPRESS = (1 << 0), /**< Compress the received data. */
+} dc_relay_flags_t;
+
+/**
+ * Serve an I/O stream to a single remote relay I/O stream.
+ *
+ * Waits for an incoming TCP connection on the address and port, and
+ * executes the operations of the remote I/O stream on the base I/O
+ * stream, until the remote I/O stream is closed or the connection is
+ * lost. The data received from the base I/O stream is read ahead and
+ * sent to the remote side immediately, without waiting for a read
+ * request. The base I/O stream is not closed.
+ *
+ * Without an address, only connections from the local host are
+ * accepted. The remote side has to present the same token before any
+ * request is served, and only the ioctl requests that the backends
+ * need are forwarded. The connection itself is not encrypted, so on
+ * an untrusted network it should be tunneled through SSH or similar.
+ *
+ * @param[in]   context    A valid context object.
+ * @param[in]   iostream   A valid I/O stream.
+ * @param[in]   address    The (optional) local address to listen on,
+ *                         e.g. "0.0.0.0" for all IPv4 interfaces.
+ * @param[in]   port       The TCP port to listen on.
+ * @param[in]   token      The shared token (at most 256 characters).
+ * @returns #DC_STATUS_SUCCESS on success, or another #dc_status_t code
+ * on failure.
+ */
+dc_status_t
+dc_relay_serve (dc_context_t *context, dc_iostream_t *iostream, const char *address, unsigned int port, const char *token);
+
+/**
+ * Open a relay I/O stream, connected to an I/O stream served with
+ * #dc_relay_serve on another host.
+ *
+ * Reads are answered from the data that was read ahead by the serving
+ * side, and writes, sleeps and line changes are queued and sent
+ * together, such that only the operations that return a result from
+ * the device (configure, get_lines, ioctl, flush and purge) need a
+ * network round trip. Errors of the queued operations are reported by
+ * the next operation. The timeouts are measured locally, and therefore
+ * include the network latency.
+ *
+ * @param[out]  iostream   A location to store the relay I/O stream.
+ * @param[in]   context    A valid context object.
+ * @param[in]   hostname   The name or address of the serving host.
+ * @param[in]   port       The TCP port of the serving host.
+ * @param[in]   token      The shared token of the serving host.
+ * @param[in]   flags      A combination of #dc_relay_flags_t options.
+ * @returns #DC_STATUS_SUCCESS on success, #DC_STATUS_NOACCESS if the
+ * serving host rejected the token, or another #dc_status_t code on
+ * failure.
+ */
+dc_status_t
+dc_relay_open (dc_iostream_t **iostream, dc_context_t *context, const char *hostname, unsigned int port, const char *token, unsigned int flags);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+#endif /* DC_RELAY_H */
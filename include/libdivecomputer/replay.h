@@ -0,0 +1,120 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2026 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+#ifndef DC_REPLAY_H
+#define DC_REPLAY_H
+
+#include "common.h"
+#include "context.h"
+#include "iostream.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * The replay speed.
+ */
+typedef enum dc_replay_mode_t {
+	DC_REPLAY_FAST,     /**< Return the responses immediately. */
+	DC_REPLAY_REALTIME, /**< Return the responses with the recorded latency. */
+} dc_replay_mode_t;
+
+/**
+ * Create a recording I/O stream layered on top of another base I/O
+ * stream.
+ *
+ * All operations are passed to the base I/O stream, and are logged to
+ * the file, together with their result, the transferred data and a
+ * timestamp. The base I/O stream is not closed when the recording I/O
+ * stream is closed.
+ *
+ * @param[out]  iostream   A location to store the recording I/O stream.
+ * @param[in]   context    A valid context object.
+ * @param[in]   base       A valid I/O stream.
+ * @param[in]   filename   The name of the recording file.
+ * @returns #DC_STATUS_SUCCESS on success, or another #dc_status_t code
+ * on failure.
+ */
+dc_status_t
+dc_record_open (dc_iostream_t **iostream, dc_context_t *context, dc_iostream_t *base, const char *filename);
+
+/**
+ * Create a replay I/O stream from a recording file.
+ *
+ * Every operation returns the result which was recorded for the
+ * corresponding operation, without accessing any hardware. The
+ * operations are expected in the same order as they were recorded.
+ *
+ * @param[out]  iostream   A location to store the replay I/O stream.
+ * @param[in]   context    A valid context object.
+ * @param[in]   filename   The name of the recording file.
+ * @param[in]   mode       The replay speed.
+ * @returns #DC_STATUS_SUCCESS on success, or another #dc_status_t code
+ * on failure.
+ */
+dc_status_t
+dc_replay_open (dc_iostream_t **iostream, dc_context_t *context, const char *filename, dc_replay_mode_t mode);
+
+/**
+ * Create a tracing I/O stream layered on top of another base I/O
+ * stream.
+ *
+ * All operations are passed to the base I/O stream, and are logged
+ * together with their result, the transferred data and a timestamp,
+ * in a compact binary format. The records are kept in a ring buffer in
+ * memory, which discards the oldest records when it is full, and are
+ * written to the file when the tracing I/O stream is closed. Unlike a
+ * recording, tracing never changes the result of an operation. The
+ * base I/O stream is not closed when the tracing I/O stream is closed.
+ *
+ * @param[out]  iostream   A location to store the tracing I/O stream.
+ * @param[in]   context    A valid context object.
+ * @param[in]   base       A valid I/O stream.
+ * @param[in]   filename   The name of the trace file.
+ * @param[in]   capacity   The size of the ring buffer (in bytes), or
+ *                         zero for the default size.
+ * @returns #DC_STATUS_SUCCESS on success, or another #dc_status_t code
+ * on failure.
+ */
+dc_status_t
+dc_trace_open (dc_iostream_t **iostream, dc_context_t *context, dc_iostream_t *base, const char *filename, size_t capacity);
+
+/**
+ * Convert a trace file into a recording file.
+ *
+ * The resulting file can be used with #dc_replay_open. If the ring
+ * buffer discarded records, the conversion succeeds with a warning,
+ * but replaying the incomplete trace will likely fail.
+ *
+ * @param[in]   context    A valid context object.
+ * @param[in]   input      The name of the trace file.
+ * @param[in]   output     The name of the recording file.
+ * @returns #DC_STATUS_SUCCESS on success, or another #dc_status_t code
+ * on failure.
+ */
+dc_status_t
+dc_trace_convert (dc_context_t *context, const char *input, const char *output);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+#endif /* DC_REPLAY_H */
@@ -82,9 +82,10 @@ dc_serial_open (dc_iostream_t **iostream, dc_context_t *context, const char *nam
  * Set the receive latency in milliseconds.
  *
  * The effect of this setting is highly platform and driver specific. On
- * Windows it does nothing at all, on Linux it controls the low latency
- * flag (e.g. only zero vs non-zero latency), and on Mac OS X it sets
- * the receive latency as requested.
+ * Windows it sets the latency timer of FTDI devices (which requires
+ * administrator rights, and re-opens the port when the value changes),
+ * on Linux it controls the low latency flag (e.g. only zero vs non-zero
+ * latency), and on Mac OS X it sets the receive latency as requested.
  */
 #define DC_IOCTL_SERIAL_SET_LATENCY DC_IOCTL_IOW('s', 0, sizeof(unsigned int))
 
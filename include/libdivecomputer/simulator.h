@@ -0,0 +1,66 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2026 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+#ifndef DC_SIMULATOR_H
+#define DC_SIMULATOR_H
+
+#include "common.h"
+#include "context.h"
+#include "descriptor.h"
+#include "iostream.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * Create a simulator I/O stream.
+ *
+ * The simulator implements the device side of the communication
+ * protocol, and answers the commands of the backend from a memory
+ * image, without accessing any hardware. Supported are:
+ *
+ * - Oceanic Atom 2 family (serial): the 16 byte version string,
+ *   followed by a memory dump.
+ *
+ * The link is simulated with a fixed latency per response, and a
+ * bandwidth for the transferred bytes. Both zero answers immediately,
+ * and also skips the sleeps requested by the backend.
+ *
+ * @param[out]  iostream   A location to store the simulator I/O stream.
+ * @param[in]   context    A valid context object.
+ * @param[in]   descriptor The descriptor of the simulated device.
+ * @param[in]   data       The memory image.
+ * @param[in]   size       The size of the memory image.
+ * @param[in]   latency    The latency of a response (milliseconds).
+ * @param[in]   bandwidth  The bandwidth of the link (bytes per second),
+ *                         or zero for an unlimited bandwidth.
+ * @returns #DC_STATUS_SUCCESS on success, #DC_STATUS_UNSUPPORTED if
+ * there is no simulator for the device, or another #dc_status_t code
+ * on failure.
+ */
+dc_status_t
+dc_simulator_open (dc_iostream_t **iostream, dc_context_t *context, dc_descriptor_t *descriptor, const unsigned char data[], size_t size, unsigned int latency, unsigned int bandwidth);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+#endif /* DC_SIMULATOR_H */
@@ -81,6 +81,69 @@ dc_usbhid_device_free(dc_usbhid_device_t *device);
 dc_status_t
 dc_usbhid_iterator_new (dc_iterator_t **iterator, dc_context_t *context, dc_descriptor_t *descriptor);
 
+/**
+ * Opaque object representing a USB HID device monitor.
+ */
+typedef struct dc_usbhid_monitor_t dc_usbhid_monitor_t;
+
+/**
+ * Callback for USB HID devices that are plugged in or removed.
+ *
+ * The device is owned by the monitor, and remains valid until the
+ * callback for its removal has returned.
+ *
+ * @param[in]  device    The USB HID device.
+ * @param[in]  event     The type of event.
+ * @param[in]  userdata  The user data pointer of the monitor.
+ */
+typedef void (*dc_usbhid_monitor_callback_t) (dc_usbhid_device_t *device, dc_hotplug_t event, void *userdata);
+
+/**
+ * Create a monitor that keeps track of the USB HID devices.
+ *
+ * Unlike an iterator, the monitor keeps its list of devices, and only
+ * reports the changes. The devices that are already present are
+ * reported as arrived on the first call to #dc_usbhid_monitor_poll.
+ *
+ * @param[out] monitor     A location to store the monitor.
+ * @param[in]  context     A valid context object.
+ * @param[in]  descriptor  A valid device descriptor or NULL.
+ * @param[in]  callback    The callback for arrived and removed devices.
+ * @param[in]  userdata    The user data pointer for the callback.
+ * @returns #DC_STATUS_SUCCESS on success, or another #dc_status_t code
+ * on failure.
+ */
+dc_status_t
+dc_usbhid_monitor_new (dc_usbhid_monitor_t **monitor, dc_context_t *context, dc_descriptor_t *descriptor, dc_usbhid_monitor_callback_t callback, void *userdata);
+
+/**
+ * Wait for changes and invoke the callback for each device that was
+ * plugged in or removed.
+ *
+ * With hotplug support, the function waits for the notifications of
+ * the operating system. Otherwise the bus is scanned again once every
+ * second.
+ *
+ * @param[in]  monitor  A valid monitor.
+ * @param[in]  timeout  The timeout in milliseconds. A negative value
+ *                      waits forever, and zero does not wait at all.
+ * @returns #DC_STATUS_SUCCESS if at least one device arrived or was
+ * removed, #DC_STATUS_TIMEOUT if nothing changed, or another
+ * #dc_status_t code on failure.
+ */
+dc_status_t
+dc_usbhid_monitor_poll (dc_usbhid_monitor_t *monitor, int timeout);
+
+/**
+ * Destroy the monitor, along with its devices.
+ *
+ * @param[in]  monitor  A valid monitor.
+ * @returns #DC_STATUS_SUCCESS on success, or another #dc_status_t code
+ * on failure.
+ */
+dc_status_t
+dc_usbhid_monitor_free (dc_usbhid_monitor_t *monitor);
+
 /**
  * Open a USB HID connection.
  *
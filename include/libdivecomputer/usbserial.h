@@ -0,0 +1,55 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2026 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+#ifndef DC_USBSERIAL_H
+#define DC_USBSERIAL_H
+
+#include "common.h"
+#include "context.h"
+#include "iostream.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * Open a serial connection over a USB serial converter.
+ *
+ * The converter is driven directly over usbfs, without a kernel or
+ * platform driver. Supported are the FTDI, Silicon Labs CP210x and
+ * Prolific PL2303 chips, and devices implementing the CDC ACM class.
+ * This is mainly useful on Android, where the application obtains the
+ * file descriptor from the UsbDeviceConnection, and keeps ownership of
+ * it. The connection behaves like a regular serial port.
+ *
+ * @param[out]  iostream A location to store the serial connection.
+ * @param[in]   context  A valid context object.
+ * @param[in]   fd       An open usbfs file descriptor of the device.
+ * @returns #DC_STATUS_SUCCESS on success, or another #dc_status_t code
+ * on failure.
+ */
+dc_status_t
+dc_usbserial_open (dc_iostream_t **iostream, dc_context_t *context, int fd);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+#endif /* DC_USBSERIAL_H */
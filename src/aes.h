@@ -38,7 +38,9 @@ typedef unsigned int  uint32_t;
 // #define the macros below to 1/0 to enable/disable the mode of operation.
 //
 // CBC enables AES128 encryption in CBC-mode of operation and handles 0-padding.
-// ECB enables the basic ECB 16-byte block algorithm. Both can be enabled simultaneously.
+// ECB enables the basic ECB 16-byte block algorithm.
+// CFB enables AES128 decryption in CFB-mode, for buffers of any length.
+// All of them can be enabled simultaneously.
 
 // The #ifndef-guard allows it to be configured before #include'ing or at compile time.
 #ifndef CBC
@@ -49,6 +51,10 @@ typedef unsigned int  uint32_t;
   #define ECB 1
 #endif
 
+#ifndef CFB
+  #define CFB 1
+#endif
+
 
 
 #if defined(ECB) && ECB
@@ -67,5 +73,12 @@ void AES128_CBC_decrypt_buffer(uint8_t* output, uint8_t* input, uint32_t length,
 #endif // #if defined(CBC) && CBC
 
 
+#if defined(CFB) && CFB
+
+void AES128_CFB_decrypt_buffer(uint8_t* output, const uint8_t* input, uint32_t length, const uint8_t* key, const uint8_t* iv);
+
+#endif // #if defined(CFB) && CFB
+
+
 
 #endif //_AES_H_
@@ -21,6 +21,8 @@
 
 #include <string.h>
 
+// Keep the out-of-line implementations of the readers.
+#define ARRAY_NO_INLINE
 #include "array.h"
 
 void
@@ -34,20 +36,30 @@ array_reverse_bytes (unsigned char data[], unsigned int size)
 }
 
 
+static const unsigned char reverse_bits[256] = {
+	0x00, 0x80, 0x40, 0xC0, 0x20, 0xA0, 0x60, 0xE0, 0x10, 0x90, 0x50, 0xD0, 0x30, 0xB0, 0x70, 0xF0,
+	0x08, 0x88, 0x48, 0xC8, 0x28, 0xA8, 0x68, 0xE8, 0x18, 0x98, 0x58, 0xD8, 0x38, 0xB8, 0x78, 0xF8,
+	0x04, 0x84, 0x44, 0xC4, 0x24, 0xA4, 0x64, 0xE4, 0x14, 0x94, 0x54, 0xD4, 0x34, 0xB4, 0x74, 0xF4,
+	0x0C, 0x8C, 0x4C, 0xCC, 0x2C, 0xAC, 0x6C, 0xEC, 0x1C, 0x9C, 0x5C, 0xDC, 0x3C, 0xBC, 0x7C, 0xFC,
+	0x02, 0x82, 0x42, 0xC2, 0x22, 0xA2, 0x62, 0xE2, 0x12, 0x92, 0x52, 0xD2, 0x32, 0xB2, 0x72, 0xF2,
+	0x0A, 0x8A, 0x4A, 0xCA, 0x2A, 0xAA, 0x6A, 0xEA, 0x1A, 0x9A, 0x5A, 0xDA, 0x3A, 0xBA, 0x7A, 0xFA,
+	0x06, 0x86, 0x46, 0xC6, 0x26, 0xA6, 0x66, 0xE6, 0x16, 0x96, 0x56, 0xD6, 0x36, 0xB6, 0x76, 0xF6,
+	0x0E, 0x8E, 0x4E, 0xCE, 0x2E, 0xAE, 0x6E, 0xEE, 0x1E, 0x9E, 0x5E, 0xDE, 0x3E, 0xBE, 0x7E, 0xFE,
+	0x01, 0x81, 0x41, 0xC1, 0x21, 0xA1, 0x61, 0xE1, 0x11, 0x91, 0x51, 0xD1, 0x31, 0xB1, 0x71, 0xF1,
+	0x09, 0x89, 0x49, 0xC9, 0x29, 0xA9, 0x69, 0xE9, 0x19, 0x99, 0x59, 0xD9, 0x39, 0xB9, 0x79, 0xF9,
+	0x05, 0x85, 0x45, 0xC5, 0x25, 0xA5, 0x65, 0xE5, 0x15, 0x95, 0x55, 0xD5, 0x35, 0xB5, 0x75, 0xF5,
+	0x0D, 0x8D, 0x4D, 0xCD, 0x2D, 0xAD, 0x6D, 0xED, 0x1D, 0x9D, 0x5D, 0xDD, 0x3D, 0xBD, 0x7D, 0xFD,
+	0x03, 0x83, 0x43, 0xC3, 0x23, 0xA3, 0x63, 0xE3, 0x13, 0x93, 0x53, 0xD3, 0x33, 0xB3, 0x73, 0xF3,
+	0x0B, 0x8B, 0x4B, 0xCB, 0x2B, 0xAB, 0x6B, 0xEB, 0x1B, 0x9B, 0x5B, 0xDB, 0x3B, 0xBB, 0x7B, 0xFB,
+	0x07, 0x87, 0x47, 0xC7, 0x27, 0xA7, 0x67, 0xE7, 0x17, 0x97, 0x57, 0xD7, 0x37, 0xB7, 0x77, 0xF7,
+	0x0F, 0x8F, 0x4F, 0xCF, 0x2F, 0xAF, 0x6F, 0xEF, 0x1F, 0x9F, 0x5F, 0xDF, 0x3F, 0xBF, 0x7F, 0xFF,
+};
+
 void
 array_reverse_bits (unsigned char data[], unsigned int size)
 {
 	for (unsigned int i = 0; i < size; ++i) {
-		unsigned char j = 0;
-		j  = (data[i] & 0x01) << 7;
-		j += (data[i] & 0x02) << 5;
-		j += (data[i] & 0x04) << 3;
-		j += (data[i] & 0x08) << 1;
-		j += (data[i] & 0x10) >> 1;
-		j += (data[i] & 0x20) >> 3;
-		j += (data[i] & 0x40) >> 5;
-		j += (data[i] & 0x80) >> 7;
-		data[i] = j;
+		data[i] = reverse_bits[data[i]];
 	}
 }
 
@@ -55,12 +67,52 @@ array_reverse_bits (unsigned char data[], unsigned int size)
 int
 array_isequal (const unsigned char data[], unsigned int size, unsigned char value)
 {
-	for (unsigned int i = 0; i < size; ++i) {
-		if (data[i] != value)
-			return 0;
+	if (size == 0)
+		return 1;
+
+	// If the first byte matches, and every byte is equal to the next
+	// one, all bytes match. This lets memcmp do the heavy lifting.
+	return data[0] == value && memcmp (data, data + 1, size - 1) == 0;
+}
+
+
+/*
+ * Return the number of leading bytes equal to the value. The data
+ * is compared a machine word at a time, and only the tail and the
+ * mismatching word are handled byte by byte.
+ */
+static unsigned int
+array_span (const unsigned char data[], unsigned int size, unsigned char value)
+{
+	const size_t pattern = ((size_t) -1 / 0xFF) * value;
+	unsigned int i = 0;
+
+	while (size - i >= sizeof (size_t)) {
+		size_t word;
+		memcpy (&word, data + i, sizeof (word));
+		if (word != pattern)
+			break;
+		i += sizeof (size_t);
 	}
 
-	return 1;
+	while (i < size && data[i] == value)
+		i++;
+
+	return i;
+}
+
+
+unsigned int
+array_search_notequal (const unsigned char data[], unsigned int size, unsigned int bsize, unsigned char value)
+{
+	if (bsize == 0)
+		return size;
+
+	unsigned int offset = array_span (data, size, value);
+	if (offset == size)
+		return size;
+
+	return offset - offset % bsize;
 }
 
 
@@ -68,11 +120,18 @@ const unsigned char *
 array_search_forward (const unsigned char *data, unsigned int size,
                       const unsigned char *marker, unsigned int msize)
 {
-	while (size >= msize) {
-		if (memcmp (data, marker, msize) == 0)
-			return data;
-		size--;
-		data++;
+	if (msize == 0)
+		return data;
+
+	// Jump from one candidate first byte to the next with memchr.
+	const unsigned char *end = data + size;
+	while ((unsigned int) (end - data) >= msize) {
+		const unsigned char *p = (const unsigned char *) memchr (data, marker[0], end - data - msize + 1);
+		if (p == NULL)
+			break;
+		if (memcmp (p + 1, marker + 1, msize - 1) == 0)
+			return p;
+		data = p + 1;
 	}
 	return NULL;
 }
@@ -82,9 +141,14 @@ const unsigned char *
 array_search_backward (const unsigned char *data, unsigned int size,
                        const unsigned char *marker, unsigned int msize)
 {
+	if (msize == 0)
+		return data + size;
+
+	// Check the last byte first, to skip most candidates cheaply.
+	const unsigned char last = marker[msize - 1];
 	data += size;
 	while (size >= msize) {
-		if (memcmp (data - msize, marker, msize) == 0)
+		if (data[-1] == last && memcmp (data - msize, marker, msize - 1) == 0)
 			return data;
 		size--;
 		data--;
@@ -93,56 +157,102 @@ array_search_backward (const unsigned char *data, unsigned int size,
 }
 
 
+/*
+ * Lookup table with the two hex digits of each byte value, to
+ * convert a whole byte at once.
+ */
+static const char hexdigits[2 * 256 + 1] =
+	"0001020304050607"
+	"08090A0B0C0D0E0F"
+	"1011121314151617"
+	"18191A1B1C1D1E1F"
+	"2021222324252627"
+	"28292A2B2C2D2E2F"
+	"3031323334353637"
+	"38393A3B3C3D3E3F"
+	"4041424344454647"
+	"48494A4B4C4D4E4F"
+	"5051525354555657"
+	"58595A5B5C5D5E5F"
+	"6061626364656667"
+	"68696A6B6C6D6E6F"
+	"7071727374757677"
+	"78797A7B7C7D7E7F"
+	"8081828384858687"
+	"88898A8B8C8D8E8F"
+	"9091929394959697"
+	"98999A9B9C9D9E9F"
+	"A0A1A2A3A4A5A6A7"
+	"A8A9AAABACADAEAF"
+	"B0B1B2B3B4B5B6B7"
+	"B8B9BABBBCBDBEBF"
+	"C0C1C2C3C4C5C6C7"
+	"C8C9CACBCCCDCECF"
+	"D0D1D2D3D4D5D6D7"
+	"D8D9DADBDCDDDEDF"
+	"E0E1E2E3E4E5E6E7"
+	"E8E9EAEBECEDEEEF"
+	"F0F1F2F3F4F5F6F7"
+	"F8F9FAFBFCFDFEFF";
+
 int
 array_convert_bin2hex (const unsigned char input[], unsigned int isize, unsigned char output[], unsigned int osize)
 {
 	if (osize != 2 * isize)
 		return -1;
 
-	const unsigned char ascii[] = {
-		'0', '1', '2', '3', '4', '5', '6', '7',
-		'8', '9', 'A', 'B', 'C', 'D', 'E', 'F'};
-
 	for (unsigned int i = 0; i < isize; ++i) {
-		// Set the most-significant nibble.
-		unsigned char msn = (input[i] >> 4) & 0x0F;
-		output[i * 2 + 0] = ascii[msn];
-
-		// Set the least-significant nibble.
-		unsigned char lsn = input[i] & 0x0F;
-		output[i * 2 + 1] = ascii[lsn];
+		memcpy (output, hexdigits + 2 * input[i], 2);
+		output += 2;
 	}
 
 	return 0;
 }
 
 
+/*
+ * Lookup table with the value of each hex digit, and 0x10 for all
+ * characters that are not a valid hex digit.
+ */
+static const unsigned char hexvalue[256] = {
+	0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+	0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+	0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+	0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+	0x10, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+	0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+	0x10, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+	0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+	0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+	0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+	0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+	0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+	0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+	0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+	0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+	0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10
+};
+
 int
 array_convert_hex2bin (const unsigned char input[], unsigned int isize, unsigned char output[], unsigned int osize)
 {
 	if (isize != 2 * osize)
 		return -1;
 
+	// Validate all digits at once at the end, instead of
+	// branching on every single character.
+	unsigned char invalid = 0;
 	for (unsigned int i = 0; i < osize; ++i) {
-		unsigned char value = 0;
-		for (unsigned int j = 0; j < 2; ++j) {
-			unsigned char number = 0;
-			unsigned char ascii = input[i * 2 + j];
-			if (ascii >= '0' && ascii <= '9')
-				number = ascii - '0';
-			else if (ascii >= 'A' && ascii <= 'F')
-				number = 10 + ascii - 'A';
-			else if (ascii >= 'a' && ascii <= 'f')
-				number = 10 + ascii - 'a';
-			else
-				return -1; /* Invalid character */
-
-			value <<= 4;
-			value += number;
-		}
-		output[i] = value;
+		unsigned char msn = hexvalue[input[0]];
+		unsigned char lsn = hexvalue[input[1]];
+		invalid |= msn | lsn;
+		output[i] = (msn << 4) | (lsn & 0x0F);
+		input += 2;
 	}
 
+	if (invalid & 0x10)
+		return -1; /* Invalid character */
+
 	return 0;
 }
 
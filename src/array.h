@@ -22,6 +22,11 @@
 #ifndef ARRAY_H
 #define ARRAY_H
 
+#include <string.h>
+#ifdef _MSC_VER
+#include <stdlib.h>
+#endif
+
 #define C_ARRAY_SIZE(a) (sizeof (a) / sizeof *(a))
 
 #ifdef __cplusplus
@@ -37,6 +42,15 @@ array_reverse_bits (unsigned char data[], unsigned int size);
 int
 array_isequal (const unsigned char data[], unsigned int size, unsigned char value);
 
+/*
+ * Find the first block of bsize bytes that is not entirely filled
+ * with the value (e.g. the first non-empty 0xFF page of a memory
+ * dump). The offset of that block is returned, or the size if all
+ * bytes are equal to the value.
+ */
+unsigned int
+array_search_notequal (const unsigned char data[], unsigned int size, unsigned int bsize, unsigned char value);
+
 const unsigned char *
 array_search_forward (const unsigned char *data, unsigned int size,
                       const unsigned char *marker, unsigned int msize);
@@ -48,6 +62,10 @@ array_search_backward (const unsigned char *data, unsigned int size,
 int
 array_convert_bin2hex (const unsigned char input[], unsigned int isize, unsigned char output[], unsigned int osize);
 
+/*
+ * The output may overlap the input, as long as it doesn't start
+ * after it. That allows decoding a hex buffer in place.
+ */
 int
 array_convert_hex2bin (const unsigned char input[], unsigned int isize, unsigned char output[], unsigned int osize);
 
@@ -129,6 +147,170 @@ signextend (unsigned int value, unsigned int nbits);
 unsigned int
 popcount (unsigned int value);
 
+/*
+ * Inline versions of the fixed size readers.
+ *
+ * The decoders call these for every field of every sample, so
+ * they are expanded in place instead of going through a call.
+ * The loads are done with memcpy, which is safe for unaligned
+ * data, and compiles to a single load (plus a byte swap when
+ * the endianness doesn't match) on the common compilers. The
+ * out-of-line functions above remain available, and array.c
+ * defines ARRAY_NO_INLINE to implement them.
+ */
+#if defined(_MSC_VER)
+#define ARRAY_INLINE static __inline
+#else
+#define ARRAY_INLINE static inline
+#endif
+
+#if defined(__GNUC__) && defined(__BYTE_ORDER__) && defined(__ORDER_LITTLE_ENDIAN__) && defined(__ORDER_BIG_ENDIAN__)
+#define ARRAY_BSWAP16(x) __builtin_bswap16(x)
+#define ARRAY_BSWAP32(x) __builtin_bswap32(x)
+#define ARRAY_BSWAP64(x) __builtin_bswap64(x)
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define ARRAY_LITTLE_ENDIAN
+#elif __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define ARRAY_BIG_ENDIAN
+#endif
+#elif defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64) || defined(_M_ARM) || defined(_M_ARM64))
+#define ARRAY_BSWAP16(x) _byteswap_ushort(x)
+#define ARRAY_BSWAP32(x) _byteswap_ulong(x)
+#define ARRAY_BSWAP64(x) _byteswap_uint64(x)
+#define ARRAY_LITTLE_ENDIAN
+#endif
+
+#if defined(ARRAY_LITTLE_ENDIAN) || defined(ARRAY_BIG_ENDIAN)
+#define ARRAY_NATIVE_LOAD
+
+ARRAY_INLINE unsigned short
+array_load16 (const unsigned char data[])
+{
+	unsigned short value;
+	memcpy (&value, data, sizeof (value));
+	return value;
+}
+
+ARRAY_INLINE unsigned int
+array_load32 (const unsigned char data[])
+{
+	unsigned int value;
+	memcpy (&value, data, sizeof (value));
+	return value;
+}
+
+ARRAY_INLINE unsigned long long
+array_load64 (const unsigned char data[])
+{
+	unsigned long long value;
+	memcpy (&value, data, sizeof (value));
+	return value;
+}
+
+#ifdef ARRAY_LITTLE_ENDIAN
+#define ARRAY_LOAD_LE(bits, data) array_load##bits (data)
+#define ARRAY_LOAD_BE(bits, data) ARRAY_BSWAP##bits (array_load##bits (data))
+#else
+#define ARRAY_LOAD_LE(bits, data) ARRAY_BSWAP##bits (array_load##bits (data))
+#define ARRAY_LOAD_BE(bits, data) array_load##bits (data)
+#endif
+#endif
+
+ARRAY_INLINE unsigned int
+array_uint_be_inline (const unsigned char data[], unsigned int n)
+{
+	unsigned int value = 0;
+	for (unsigned int i = 0; i < n; ++i) {
+		value = (value << 8) | data[i];
+	}
+	return value;
+}
+
+ARRAY_INLINE unsigned int
+array_uint_le_inline (const unsigned char data[], unsigned int n)
+{
+	unsigned int value = 0;
+	for (unsigned int i = n; i > 0; --i) {
+		value = (value << 8) | data[i - 1];
+	}
+	return value;
+}
+
+ARRAY_INLINE unsigned long long
+array_uint64_be_inline (const unsigned char data[])
+{
+#ifdef ARRAY_NATIVE_LOAD
+	return ARRAY_LOAD_BE(64, data);
+#else
+	return ((unsigned long long) array_uint_be_inline (data, 4) << 32) |
+	       array_uint_be_inline (data + 4, 4);
+#endif
+}
+
+ARRAY_INLINE unsigned long long
+array_uint64_le_inline (const unsigned char data[])
+{
+#ifdef ARRAY_NATIVE_LOAD
+	return ARRAY_LOAD_LE(64, data);
+#else
+	return ((unsigned long long) array_uint_le_inline (data + 4, 4) << 32) |
+	       array_uint_le_inline (data, 4);
+#endif
+}
+
+ARRAY_INLINE unsigned int
+array_uint32_be_inline (const unsigned char data[])
+{
+#ifdef ARRAY_NATIVE_LOAD
+	return ARRAY_LOAD_BE(32, data);
+#else
+	return array_uint_be_inline (data, 4);
+#endif
+}
+
+ARRAY_INLINE unsigned int
+array_uint32_le_inline (const unsigned char data[])
+{
+#ifdef ARRAY_NATIVE_LOAD
+	return ARRAY_LOAD_LE(32, data);
+#else
+	return array_uint_le_inline (data, 4);
+#endif
+}
+
+ARRAY_INLINE unsigned short
+array_uint16_be_inline (const unsigned char data[])
+{
+#ifdef ARRAY_NATIVE_LOAD
+	return ARRAY_LOAD_BE(16, data);
+#else
+	return array_uint_be_inline (data, 2);
+#endif
+}
+
+ARRAY_INLINE unsigned short
+array_uint16_le_inline (const unsigned char data[])
+{
+#ifdef ARRAY_NATIVE_LOAD
+	return ARRAY_LOAD_LE(16, data);
+#else
+	return array_uint_le_inline (data, 2);
+#endif
+}
+
+#ifndef ARRAY_NO_INLINE
+#define array_uint_be(data, n) array_uint_be_inline (data, n)
+#define array_uint_le(data, n) array_uint_le_inline (data, n)
+#define array_uint64_be(data) array_uint64_be_inline (data)
+#define array_uint64_le(data) array_uint64_le_inline (data)
+#define array_uint32_be(data) array_uint32_be_inline (data)
+#define array_uint32_le(data) array_uint32_le_inline (data)
+#define array_uint24_be(data) array_uint_be_inline (data, 3)
+#define array_uint24_le(data) array_uint_le_inline (data, 3)
+#define array_uint16_be(data) array_uint16_be_inline (data)
+#define array_uint16_le(data) array_uint16_le_inline (data)
+#endif
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
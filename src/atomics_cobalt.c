@@ -63,9 +63,11 @@ static const dc_device_vtable_t atomics_cobalt_device_vtable = {
 	DC_FAMILY_ATOMICS_COBALT,
 	atomics_cobalt_device_set_fingerprint, /* set_fingerprint */
 	NULL, /* read */
+	NULL, /* read_range */
 	NULL, /* write */
 	NULL, /* dump */
 	atomics_cobalt_device_foreach, /* foreach */
+	NULL, /* foreach_header */
 	NULL, /* timesync */
 	NULL /* close */
 };
@@ -334,7 +336,7 @@ atomics_cobalt_device_foreach (dc_device_t *abstract, dc_dive_callback_t callbac
 	device_event_emit (abstract, DC_EVENT_DEVINFO, &devinfo);
 
 	// Allocate a memory buffer.
-	dc_buffer_t *buffer = dc_buffer_new (0);
+	dc_buffer_t *buffer = dc_buffer_new_context (abstract->context, 0);
 	if (buffer == NULL)
 		return DC_STATUS_NOMEMORY;
 
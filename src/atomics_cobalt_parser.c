@@ -62,7 +62,13 @@ static const dc_parser_vtable_t atomics_cobalt_parser_vtable = {
 	atomics_cobalt_parser_set_density, /* set_density */
 	atomics_cobalt_parser_get_datetime, /* datetime */
 	atomics_cobalt_parser_get_field, /* fields */
+	NULL, /* summary */
 	atomics_cobalt_parser_samples_foreach, /* samples_foreach */
+	NULL, /* samples_batch */
+	NULL, /* samples_fixed */
+	NULL, /* samples_append */
+	NULL, /* samples_range */
+	NULL, /* reset */
 	NULL /* destroy */
 };
 
@@ -24,6 +24,8 @@
 #endif
 
 #include <stdlib.h> // malloc, free
+#include <string.h> // memcpy, memset, strncpy
+#include <time.h>
 
 #include "socket.h"
 
@@ -42,6 +44,8 @@
 #include <bluetooth/hci_lib.h>
 #include <bluetooth/sdp.h>
 #include <bluetooth/sdp_lib.h>
+#include <poll.h>
+#include <unistd.h>
 #endif
 #endif
 
@@ -52,6 +56,7 @@
 #include "iostream-private.h"
 #include "iterator-private.h"
 #include "platform.h"
+#include "thread.h"
 
 #ifdef _WIN32
 #define DC_ADDRESS_FORMAT "%012I64X"
@@ -64,6 +69,12 @@
 #define MAX_DEVICES 255
 #define MAX_PERIODS 8
 
+// The discovery cache remembers the name and the rfcomm channel of the
+// most recently seen devices for a few minutes, such that the slow
+// name requests and SDP queries can be skipped on the next attempt.
+#define CACHE_SIZE 32
+#define CACHE_TIMEOUT 300
+
 #define ISINSTANCE(device) dc_iostream_isinstance((device), &dc_bluetooth_vtable)
 
 struct dc_bluetooth_device_t {
@@ -72,6 +83,14 @@ struct dc_bluetooth_device_t {
 };
 
 #ifdef BLUETOOTH
+#ifdef HAVE_BLUEZ
+typedef struct dc_bluetooth_result_t {
+	bdaddr_t bdaddr;
+	unsigned int reported;
+	char name[HCI_MAX_NAME_LENGTH];
+} dc_bluetooth_result_t;
+#endif
+
 static dc_status_t dc_bluetooth_iterator_next (dc_iterator_t *iterator, void *item);
 static dc_status_t dc_bluetooth_iterator_free (dc_iterator_t *iterator);
 
@@ -82,12 +101,26 @@ typedef struct dc_bluetooth_iterator_t {
 	HANDLE hLookup;
 #else
 	int fd;
-	inquiry_info *devices;
+	int active;
+	dc_bluetooth_result_t *results;
 	size_t count;
+	size_t capacity;
 	size_t current;
 #endif
 } dc_bluetooth_iterator_t;
 
+#ifdef HAVE_BLUEZ
+typedef struct dc_bluetooth_cache_t {
+	dc_bluetooth_address_t address;
+	time_t timestamp;
+	unsigned int port;
+	char name[248];
+} dc_bluetooth_cache_t;
+
+static dc_mutex_t g_cache_mutex = DC_MUTEX_INIT;
+static dc_bluetooth_cache_t g_cache[CACHE_SIZE];
+#endif
+
 static const dc_iterator_vtable_t dc_bluetooth_iterator_vtable = {
 	sizeof(dc_bluetooth_iterator_t),
 	dc_bluetooth_iterator_next,
@@ -106,10 +139,14 @@ static const dc_iostream_vtable_t dc_bluetooth_vtable = {
 	dc_socket_poll, /* poll */
 	dc_socket_read, /* read */
 	dc_socket_write, /* write */
+	dc_socket_read_async, /* read_async */
+	dc_socket_write_async, /* write_async */
+	NULL, /* writev */
 	dc_socket_ioctl, /* ioctl */
 	NULL, /* flush */
 	NULL, /* purge */
 	dc_socket_sleep, /* sleep */
+	NULL, /* set_interrupt */
 	dc_socket_close, /* close */
 };
 
@@ -138,6 +175,332 @@ dc_address_set (bdaddr_t *ba, dc_bluetooth_address_t address)
 	}
 }
 
+/*
+ * Find the cache entry for the address, or a free entry to replace.
+ * The cache mutex must be locked.
+ */
+static dc_bluetooth_cache_t *
+dc_bluetooth_cache_find (dc_bluetooth_address_t address, int create)
+{
+	dc_bluetooth_cache_t *oldest = &g_cache[0];
+	time_t now = time (NULL);
+
+	for (size_t i = 0; i < C_ARRAY_SIZE(g_cache); ++i) {
+		dc_bluetooth_cache_t *entry = &g_cache[i];
+		if (entry->timestamp && now - entry->timestamp > CACHE_TIMEOUT) {
+			memset (entry, 0, sizeof (*entry));
+		}
+
+		if (entry->timestamp && entry->address == address) {
+			if (create)
+				entry->timestamp = now;
+			return entry;
+		}
+
+		if (entry->timestamp < oldest->timestamp) {
+			oldest = entry;
+		}
+	}
+
+	if (!create)
+		return NULL;
+
+	memset (oldest, 0, sizeof (*oldest));
+	oldest->address = address;
+	oldest->timestamp = now;
+
+	return oldest;
+}
+
+static int
+dc_bluetooth_cache_get_name (dc_bluetooth_address_t address, char *name, size_t size)
+{
+	int found = 0;
+
+	dc_mutex_lock (&g_cache_mutex);
+	dc_bluetooth_cache_t *entry = dc_bluetooth_cache_find (address, 0);
+	if (entry && entry->name[0]) {
+		strncpy (name, entry->name, size - 1);
+		name[size - 1] = '\0';
+		found = 1;
+	}
+	dc_mutex_unlock (&g_cache_mutex);
+
+	return found;
+}
+
+static void
+dc_bluetooth_cache_set_name (dc_bluetooth_address_t address, const char *name)
+{
+	dc_mutex_lock (&g_cache_mutex);
+	dc_bluetooth_cache_t *entry = dc_bluetooth_cache_find (address, 1);
+	strncpy (entry->name, name, sizeof (entry->name) - 1);
+	entry->name[sizeof (entry->name) - 1] = '\0';
+	dc_mutex_unlock (&g_cache_mutex);
+}
+
+static unsigned int
+dc_bluetooth_cache_get_port (dc_bluetooth_address_t address)
+{
+	unsigned int port = 0;
+
+	dc_mutex_lock (&g_cache_mutex);
+	dc_bluetooth_cache_t *entry = dc_bluetooth_cache_find (address, 0);
+	if (entry)
+		port = entry->port;
+	dc_mutex_unlock (&g_cache_mutex);
+
+	return port;
+}
+
+static void
+dc_bluetooth_cache_set_port (dc_bluetooth_address_t address, unsigned int port)
+{
+	dc_mutex_lock (&g_cache_mutex);
+	dc_bluetooth_cache_t *entry = dc_bluetooth_cache_find (address, 1);
+	entry->port = port;
+	dc_mutex_unlock (&g_cache_mutex);
+}
+
+/*
+ * Extract the device name from the extended inquiry response data.
+ */
+static int
+dc_bluetooth_eir_name (const unsigned char data[], size_t size, char *name, size_t namesize)
+{
+	size_t offset = 0;
+	while (offset + 1 < size) {
+		size_t length = data[offset];
+		if (length == 0 || offset + 1 + length > size)
+			break;
+
+		unsigned char type = data[offset + 1];
+		if (type == 0x08 || type == 0x09) {
+			size_t n = length - 1;
+			if (n > namesize - 1)
+				n = namesize - 1;
+			memcpy (name, data + offset + 2, n);
+			name[n] = '\0';
+			return 1;
+		}
+
+		offset += 1 + length;
+	}
+
+	return 0;
+}
+
+/*
+ * Add a device to the list of inquiry results. Devices which are
+ * already present are not added again, but a name received in a later
+ * response is still filled in.
+ */
+static dc_status_t
+dc_bluetooth_result_add (dc_bluetooth_iterator_t *iterator, const bdaddr_t *bdaddr, const char *name)
+{
+	dc_bluetooth_result_t *result = NULL;
+
+	for (size_t i = 0; i < iterator->count; ++i) {
+		if (bacmp (&iterator->results[i].bdaddr, bdaddr) == 0) {
+			result = &iterator->results[i];
+			break;
+		}
+	}
+
+	if (result == NULL) {
+		if (iterator->count >= iterator->capacity) {
+			size_t capacity = iterator->capacity ? iterator->capacity * 2 : 16;
+			dc_bluetooth_result_t *results = (dc_bluetooth_result_t *) realloc (iterator->results, capacity * sizeof (dc_bluetooth_result_t));
+			if (results == NULL) {
+				SYSERROR (iterator->base.context, S_ENOMEM);
+				return DC_STATUS_NOMEMORY;
+			}
+			iterator->results = results;
+			iterator->capacity = capacity;
+		}
+
+		result = &iterator->results[iterator->count++];
+		memset (result, 0, sizeof (*result));
+		bacpy (&result->bdaddr, bdaddr);
+
+		// Use the name from a previous discovery, if available.
+		dc_bluetooth_cache_get_name (dc_address_get (bdaddr), result->name, sizeof (result->name));
+	}
+
+	if (name && name[0] && !result->reported) {
+		strncpy (result->name, name, sizeof (result->name) - 1);
+		result->name[sizeof (result->name) - 1] = '\0';
+		dc_bluetooth_cache_set_name (dc_address_get (bdaddr), result->name);
+	}
+
+	return DC_STATUS_SUCCESS;
+}
+
+/*
+ * Start a periodic inquiry in the background. The results are
+ * delivered as HCI events while the inquiry is running, which allows
+ * the iterator to report devices as soon as they are found, instead of
+ * waiting for the entire inquiry window.
+ */
+static dc_status_t
+dc_bluetooth_inquiry_start (dc_bluetooth_iterator_t *iterator)
+{
+	dc_context_t *context = iterator->base.context;
+
+	struct hci_filter filter;
+	hci_filter_clear (&filter);
+	hci_filter_set_ptype (HCI_EVENT_PKT, &filter);
+	hci_filter_set_event (EVT_INQUIRY_RESULT, &filter);
+	hci_filter_set_event (EVT_INQUIRY_RESULT_WITH_RSSI, &filter);
+	hci_filter_set_event (EVT_EXTENDED_INQUIRY_RESULT, &filter);
+	hci_filter_set_event (EVT_INQUIRY_COMPLETE, &filter);
+	hci_filter_set_event (EVT_CMD_STATUS, &filter);
+	if (setsockopt (iterator->fd, SOL_HCI, HCI_FILTER, &filter, sizeof (filter)) < 0) {
+		s_errcode_t errcode = S_ERRNO;
+		SYSERROR (context, errcode);
+		return dc_socket_syserror(errcode);
+	}
+
+	// General inquiry access code (GIAC), for at most MAX_PERIODS * 1.28
+	// seconds, and without a limit on the number of responses.
+	inquiry_cp cp;
+	memset (&cp, 0, sizeof (cp));
+	cp.lap[0] = 0x33;
+	cp.lap[1] = 0x8b;
+	cp.lap[2] = 0x9e;
+	cp.length = MAX_PERIODS;
+	cp.num_rsp = 0;
+	if (hci_send_cmd (iterator->fd, OGF_LINK_CTL, OCF_INQUIRY, INQUIRY_CP_SIZE, &cp) < 0) {
+		s_errcode_t errcode = S_ERRNO;
+		SYSERROR (context, errcode);
+		return dc_socket_syserror(errcode);
+	}
+
+	iterator->active = 1;
+
+	return DC_STATUS_SUCCESS;
+}
+
+/*
+ * Wait for the next HCI event of the running inquiry, and process it.
+ */
+static dc_status_t
+dc_bluetooth_inquiry_process (dc_bluetooth_iterator_t *iterator)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	dc_context_t *context = iterator->base.context;
+
+	struct pollfd pfd;
+	pfd.fd = iterator->fd;
+	pfd.events = POLLIN;
+	pfd.revents = 0;
+
+	int rc = poll (&pfd, 1, MAX_PERIODS * 1280 + 5000);
+	if (rc < 0) {
+		s_errcode_t errcode = S_ERRNO;
+		if (errcode == EINTR)
+			return DC_STATUS_SUCCESS;
+		SYSERROR (context, errcode);
+		iterator->active = 0;
+		return dc_socket_syserror(errcode);
+	} else if (rc == 0) {
+		WARNING (context, "Inquiry complete event not received.");
+		iterator->active = 0;
+		return DC_STATUS_SUCCESS;
+	}
+
+	unsigned char buf[HCI_MAX_EVENT_SIZE];
+	ssize_t n = read (iterator->fd, buf, sizeof (buf));
+	if (n < 0) {
+		s_errcode_t errcode = S_ERRNO;
+		if (errcode == EINTR || errcode == EAGAIN)
+			return DC_STATUS_SUCCESS;
+		SYSERROR (context, errcode);
+		iterator->active = 0;
+		return dc_socket_syserror(errcode);
+	}
+
+	if (n < 1 + HCI_EVENT_HDR_SIZE || buf[0] != HCI_EVENT_PKT)
+		return DC_STATUS_SUCCESS;
+
+	const hci_event_hdr *hdr = (const hci_event_hdr *) (buf + 1);
+	const unsigned char *data = buf + 1 + HCI_EVENT_HDR_SIZE;
+	size_t length = n - 1 - HCI_EVENT_HDR_SIZE;
+	if (length > hdr->plen)
+		length = hdr->plen;
+
+	switch (hdr->evt) {
+	case EVT_INQUIRY_RESULT:
+	case EVT_INQUIRY_RESULT_WITH_RSSI:
+	case EVT_EXTENDED_INQUIRY_RESULT:
+		if (length < 1)
+			break;
+		size_t size = hdr->evt == EVT_INQUIRY_RESULT ? INQUIRY_INFO_SIZE :
+			hdr->evt == EVT_INQUIRY_RESULT_WITH_RSSI ? INQUIRY_INFO_WITH_RSSI_SIZE :
+			EXTENDED_INQUIRY_INFO_SIZE;
+		unsigned int nresults = data[0];
+		for (unsigned int i = 0; i < nresults && 1 + (i + 1) * size <= length; ++i) {
+			const unsigned char *info = data + 1 + i * size;
+			char name[HCI_MAX_NAME_LENGTH] = {0};
+			if (hdr->evt == EVT_EXTENDED_INQUIRY_RESULT) {
+				const extended_inquiry_info *eir = (const extended_inquiry_info *) info;
+				dc_bluetooth_eir_name (eir->data, sizeof (eir->data), name, sizeof (name));
+			}
+			status = dc_bluetooth_result_add (iterator, (const bdaddr_t *) info, name);
+			if (status != DC_STATUS_SUCCESS)
+				return status;
+		}
+		break;
+	case EVT_INQUIRY_COMPLETE:
+		iterator->active = 0;
+		break;
+	case EVT_CMD_STATUS:
+		if (length >= EVT_CMD_STATUS_SIZE) {
+			const evt_cmd_status *cs = (const evt_cmd_status *) data;
+			if (btohs (cs->opcode) == cmd_opcode_pack (OGF_LINK_CTL, OCF_INQUIRY) && cs->status) {
+				ERROR (context, "Failed to start the inquiry (%02x).", cs->status);
+				iterator->active = 0;
+				return DC_STATUS_IO;
+			}
+		}
+		break;
+	default:
+		break;
+	}
+
+	return DC_STATUS_SUCCESS;
+}
+
+/*
+ * Perform a blocking inquiry, as a fallback for adapters which refuse
+ * the background inquiry.
+ */
+static dc_status_t
+dc_bluetooth_inquiry_blocking (dc_bluetooth_iterator_t *iterator, int dev)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+
+	// The inquiry lasts for at most MAX_PERIODS * 1.28 seconds, and at
+	// most MAX_DEVICES devices will be returned.
+	inquiry_info *devices = NULL;
+	int ndevices = hci_inquiry (dev, MAX_PERIODS, MAX_DEVICES, NULL, &devices, IREQ_CACHE_FLUSH);
+	if (ndevices < 0) {
+		s_errcode_t errcode = S_ERRNO;
+		SYSERROR (iterator->base.context, errcode);
+		return dc_socket_syserror(errcode);
+	}
+
+	for (int i = 0; i < ndevices; ++i) {
+		status = dc_bluetooth_result_add (iterator, &devices[i].bdaddr, NULL);
+		if (status != DC_STATUS_SUCCESS)
+			break;
+	}
+
+	bt_free (devices);
+
+	return status;
+}
+
 static dc_status_t
 dc_bluetooth_sdp (uint8_t *port, dc_context_t *context, const bdaddr_t *ba)
 {
@@ -357,22 +720,23 @@ dc_bluetooth_iterator_new (dc_iterator_t **out, dc_context_t *context, dc_descri
 		goto error_socket_exit;
 	}
 
-	// Perform the bluetooth device discovery. The inquiry lasts for at
-	// most MAX_PERIODS * 1.28 seconds, and at most MAX_DEVICES devices
-	// will be returned.
-	inquiry_info *devices = NULL;
-	int ndevices = hci_inquiry (dev, MAX_PERIODS, MAX_DEVICES, NULL, &devices, IREQ_CACHE_FLUSH);
-	if (ndevices < 0) {
-		s_errcode_t errcode = S_ERRNO;
-		SYSERROR (context, errcode);
-		status = dc_socket_syserror(errcode);
-		goto error_close;
-	}
-
 	iterator->fd = fd;
-	iterator->devices = devices;
-	iterator->count = ndevices;
+	iterator->active = 0;
+	iterator->results = NULL;
+	iterator->count = 0;
+	iterator->capacity = 0;
 	iterator->current = 0;
+
+	// Start the bluetooth device discovery in the background, and fall
+	// back to a blocking inquiry if that fails.
+	status = dc_bluetooth_inquiry_start (iterator);
+	if (status != DC_STATUS_SUCCESS) {
+		WARNING (context, "Falling back to a blocking inquiry.");
+		status = dc_bluetooth_inquiry_blocking (iterator, dev);
+		if (status != DC_STATUS_SUCCESS) {
+			goto error_close;
+		}
+	}
 #endif
 	iterator->descriptor = descriptor;
 
@@ -382,6 +746,7 @@ dc_bluetooth_iterator_new (dc_iterator_t **out, dc_context_t *context, dc_descri
 
 #ifndef _WIN32
 error_close:
+	free (iterator->results);
 	hci_close_dev(fd);
 #endif
 error_socket_exit:
@@ -435,20 +800,48 @@ dc_bluetooth_iterator_next (dc_iterator_t *abstract, void *out)
 		dc_bluetooth_address_t address = sa->btAddr;
 		const char *name = (char *) pwsaResults->lpszServiceInstanceName;
 #else
-	while (iterator->current < iterator->count) {
-		inquiry_info *dev = &iterator->devices[iterator->current++];
+	while (1) {
+		dc_bluetooth_result_t *result = NULL;
+
+		// While the inquiry is still running, report the devices for which
+		// the name is already known. A remote name request interferes with
+		// the inquiry, so the other devices have to wait until it's done.
+		for (size_t i = iterator->current; i < iterator->count; ++i) {
+			dc_bluetooth_result_t *r = &iterator->results[i];
+			if (!r->reported && (r->name[0] || !iterator->active)) {
+				result = r;
+				break;
+			}
+		}
 
-		dc_bluetooth_address_t address = dc_address_get (&dev->bdaddr);
+		if (result == NULL) {
+			if (!iterator->active)
+				break;
 
-		// Get the user friendly name.
-		char buf[HCI_MAX_NAME_LENGTH], *name = buf;
-		int rc = hci_read_remote_name (iterator->fd, &dev->bdaddr, sizeof(buf), buf, 0);
-		if (rc < 0) {
-			name = NULL;
+			dc_status_t status = dc_bluetooth_inquiry_process (iterator);
+			if (status != DC_STATUS_SUCCESS)
+				return status;
+			continue;
 		}
 
-		// Null terminate the string.
-		buf[sizeof(buf) - 1] = '\0';
+		result->reported = 1;
+		while (iterator->current < iterator->count && iterator->results[iterator->current].reported)
+			iterator->current++;
+
+		dc_bluetooth_address_t address = dc_address_get (&result->bdaddr);
+
+		// Get the user friendly name.
+		char *name = result->name;
+		if (name[0] == '\0') {
+			int rc = hci_read_remote_name (iterator->fd, &result->bdaddr, sizeof(result->name), result->name, 0);
+			if (rc < 0) {
+				name = NULL;
+			} else {
+				// Null terminate the string.
+				result->name[sizeof(result->name) - 1] = '\0';
+				dc_bluetooth_cache_set_name (address, result->name);
+			}
+		}
 #endif
 
 		INFO (abstract->context, "Discover: address=" DC_ADDRESS_FORMAT ", name=%s",
@@ -490,7 +883,10 @@ dc_bluetooth_iterator_free (dc_iterator_t *abstract)
 		WSALookupServiceEnd (iterator->hLookup);
 	}
 #else
-	bt_free(iterator->devices);
+	if (iterator->active) {
+		hci_send_cmd (iterator->fd, OGF_LINK_CTL, OCF_INQUIRY_CANCEL, 0, NULL);
+	}
+	free(iterator->results);
 	hci_close_dev(iterator->fd);
 #endif
 	dc_socket_exit (abstract->context);
@@ -542,10 +938,18 @@ dc_bluetooth_open (dc_iostream_t **out, dc_context_t *context, dc_bluetooth_addr
 	struct sockaddr_rc sa;
 	sa.rc_family = AF_BLUETOOTH;
 	dc_address_set (&sa.rc_bdaddr, address);
+	unsigned int cached = 0;
 	if (port == 0) {
-		status = dc_bluetooth_sdp (&sa.rc_channel, context, &sa.rc_bdaddr);
-		if (status != DC_STATUS_SUCCESS) {
-			goto error_close;
+		// Re-use the rfcomm channel from a previous SDP query.
+		cached = dc_bluetooth_cache_get_port (address);
+		if (cached) {
+			sa.rc_channel = cached;
+		} else {
+			status = dc_bluetooth_sdp (&sa.rc_channel, context, &sa.rc_bdaddr);
+			if (status != DC_STATUS_SUCCESS) {
+				goto error_close;
+			}
+			dc_bluetooth_cache_set_port (address, sa.rc_channel);
 		}
 	} else {
 		sa.rc_channel = port;
@@ -553,6 +957,28 @@ dc_bluetooth_open (dc_iostream_t **out, dc_context_t *context, dc_bluetooth_addr
 #endif
 
 	status = dc_socket_connect (&device->base, (struct sockaddr *) &sa, sizeof (sa));
+#ifdef HAVE_BLUEZ
+	if (status != DC_STATUS_SUCCESS && cached) {
+		// The cached channel may be outdated. Forget it, and retry with a
+		// fresh SDP query on a new socket.
+		WARNING (context, "Failed to connect using the cached channel %u.", cached);
+		dc_bluetooth_cache_set_port (address, 0);
+
+		dc_socket_close (&device->base);
+		status = dc_socket_open (&device->base, AF_BLUETOOTH, SOCK_STREAM, BTPROTO_RFCOMM);
+		if (status != DC_STATUS_SUCCESS) {
+			goto error_free;
+		}
+
+		status = dc_bluetooth_sdp (&sa.rc_channel, context, &sa.rc_bdaddr);
+		if (status != DC_STATUS_SUCCESS) {
+			goto error_close;
+		}
+		dc_bluetooth_cache_set_port (address, sa.rc_channel);
+
+		status = dc_socket_connect (&device->base, (struct sockaddr *) &sa, sizeof (sa));
+	}
+#endif
 	if (status != DC_STATUS_SUCCESS) {
 		goto error_close;
 	}
@@ -19,27 +19,39 @@
  * MA 02110-1301 USA
  */
 
-#include <stdlib.h> // malloc, realloc, free
 #include <string.h> // memcpy, memmove
 
 #include <libdivecomputer/buffer.h>
 
+#include "context-private.h"
+
 struct dc_buffer_t {
+	dc_context_t *context;
 	unsigned char *data;
 	size_t capacity, offset, size;
+	int readonly;
 };
 
 dc_buffer_t *
 dc_buffer_new (size_t capacity)
 {
-	dc_buffer_t *buffer = (dc_buffer_t *) malloc (sizeof (dc_buffer_t));
+	return dc_buffer_new_context (NULL, capacity);
+}
+
+
+dc_buffer_t *
+dc_buffer_new_context (dc_context_t *context, size_t capacity)
+{
+	dc_buffer_t *buffer = (dc_buffer_t *) dc_context_malloc (context, sizeof (dc_buffer_t));
 	if (buffer == NULL)
 		return NULL;
 
+	buffer->context = context;
+
 	if (capacity) {
-		buffer->data = (unsigned char *) malloc (capacity);
+		buffer->data = (unsigned char *) dc_context_malloc (context, capacity);
 		if (buffer->data == NULL) {
-			free (buffer);
+			dc_context_release (context, buffer);
 			return NULL;
 		}
 	} else {
@@ -49,6 +61,30 @@ dc_buffer_new (size_t capacity)
 	buffer->capacity = capacity;
 	buffer->offset = 0;
 	buffer->size = 0;
+	buffer->readonly = 0;
+
+	return buffer;
+}
+
+
+dc_buffer_t *
+dc_buffer_new_view (const unsigned char data[], size_t size)
+{
+	if (data == NULL && size)
+		return NULL;
+
+	dc_buffer_t *buffer = (dc_buffer_t *) dc_context_malloc (NULL, sizeof (dc_buffer_t));
+	if (buffer == NULL)
+		return NULL;
+
+	// The buffer only references the data. The caller remains the
+	// owner and is responsible for keeping it valid.
+	buffer->context = NULL;
+	buffer->data = (unsigned char *) data;
+	buffer->capacity = size;
+	buffer->offset = 0;
+	buffer->size = size;
+	buffer->readonly = 1;
 
 	return buffer;
 }
@@ -60,10 +96,10 @@ dc_buffer_free (dc_buffer_t *buffer)
 	if (buffer == NULL)
 		return;
 
-	if (buffer->data)
-		free (buffer->data);
+	if (buffer->data && !buffer->readonly)
+		dc_context_release (buffer->context, buffer->data);
 
-	free (buffer);
+	dc_context_release (buffer->context, buffer);
 }
 
 
@@ -99,18 +135,18 @@ dc_buffer_expand_append (dc_buffer_t *buffer, size_t n)
 		if (n > buffer->capacity) {
 			size_t capacity = dc_buffer_expand_calc (buffer, n);
 
-			unsigned char *data = (unsigned char *) malloc (capacity);
+			// Move the data to the start of the buffer, such that
+			// realloc can grow the memory block in place.
+			if (buffer->size && buffer->offset)
+				memmove (buffer->data, buffer->data + buffer->offset, buffer->size);
+			buffer->offset = 0;
+
+			unsigned char *data = (unsigned char *) dc_context_realloc (buffer->context, buffer->data, capacity);
 			if (data == NULL)
 				return 0;
 
-			if (buffer->size)
-				memcpy (data, buffer->data + buffer->offset, buffer->size);
-
-			free (buffer->data);
-
 			buffer->data = data;
 			buffer->capacity = capacity;
-			buffer->offset = 0;
 		} else {
 			if (buffer->size)
 				memmove (buffer->data, buffer->data + buffer->offset, buffer->size);
@@ -132,14 +168,13 @@ dc_buffer_expand_prepend (dc_buffer_t *buffer, size_t n)
 		if (n > buffer->capacity) {
 			size_t capacity = dc_buffer_expand_calc (buffer, n);
 
-			unsigned char *data = (unsigned char *) malloc (capacity);
+			unsigned char *data = (unsigned char *) dc_context_realloc (buffer->context, buffer->data, capacity);
 			if (data == NULL)
 				return 0;
 
+			// Move the data to the end of the enlarged buffer.
 			if (buffer->size)
-				memcpy (data + capacity - buffer->size, buffer->data + buffer->offset, buffer->size);
-
-			free (buffer->data);
+				memmove (data + capacity - buffer->size, data + buffer->offset, buffer->size);
 
 			buffer->data = data;
 			buffer->capacity = capacity;
@@ -159,13 +194,13 @@ dc_buffer_expand_prepend (dc_buffer_t *buffer, size_t n)
 int
 dc_buffer_reserve (dc_buffer_t *buffer, size_t capacity)
 {
-	if (buffer == NULL)
+	if (buffer == NULL || buffer->readonly)
 		return 0;
 
 	if (capacity <= buffer->capacity)
 		return 1;
 
-	unsigned char *data = (unsigned char *) realloc (buffer->data, capacity);
+	unsigned char *data = (unsigned char *) dc_context_realloc (buffer->context, buffer->data, capacity);
 	if (data == NULL)
 		return 0;
 
@@ -179,7 +214,7 @@ dc_buffer_reserve (dc_buffer_t *buffer, size_t capacity)
 int
 dc_buffer_resize (dc_buffer_t *buffer, size_t size)
 {
-	if (buffer == NULL)
+	if (buffer == NULL || buffer->readonly)
 		return 0;
 
 	if (!dc_buffer_expand_append (buffer, size))
@@ -197,7 +232,7 @@ dc_buffer_resize (dc_buffer_t *buffer, size_t size)
 int
 dc_buffer_append (dc_buffer_t *buffer, const unsigned char data[], size_t size)
 {
-	if (buffer == NULL)
+	if (buffer == NULL || buffer->readonly)
 		return 0;
 
 	if (!dc_buffer_expand_append (buffer, buffer->size + size))
@@ -215,7 +250,7 @@ dc_buffer_append (dc_buffer_t *buffer, const unsigned char data[], size_t size)
 int
 dc_buffer_prepend (dc_buffer_t *buffer, const unsigned char data[], size_t size)
 {
-	if (buffer == NULL)
+	if (buffer == NULL || buffer->readonly)
 		return 0;
 
 	if (!dc_buffer_expand_prepend (buffer, buffer->size + size))
@@ -234,7 +269,7 @@ dc_buffer_prepend (dc_buffer_t *buffer, const unsigned char data[], size_t size)
 int
 dc_buffer_insert (dc_buffer_t *buffer, size_t offset, const unsigned char data[], size_t size)
 {
-	if (buffer == NULL)
+	if (buffer == NULL || buffer->readonly)
 		return 0;
 
 	if (offset > buffer->size)
@@ -273,7 +308,7 @@ dc_buffer_insert (dc_buffer_t *buffer, size_t offset, const unsigned char data[]
 
 		size_t tmp_offset = head > tail ? available : 0;
 
-		unsigned char *tmp = (unsigned char *) malloc (capacity);
+		unsigned char *tmp = (unsigned char *) dc_context_malloc (buffer->context, capacity);
 		if (tmp == NULL)
 			return 0;
 
@@ -282,7 +317,7 @@ dc_buffer_insert (dc_buffer_t *buffer, size_t offset, const unsigned char data[]
 			memcpy (tmp + tmp_offset + offset + size, ptr + offset, buffer->size - offset);
 		}
 
-		free (buffer->data);
+		dc_context_release (buffer->context, buffer->data);
 		buffer->data = tmp;
 		buffer->capacity = capacity;
 		buffer->offset = tmp_offset;
@@ -19,14 +19,351 @@
  * MA 02110-1301 USA
  */
 
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+
 #include "checksum.h"
+#include "thread.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HAVE_PCLMUL
+#include <cpuid.h>
+#include <emmintrin.h>
+#include <wmmintrin.h>
+#endif
+
+#if defined(__ARM_FEATURE_CRC32)
+#define HAVE_ARMCRC
+#include <arm_acle.h>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define HAVE_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#define HAVE_NEON
+#include <arm_neon.h>
+#endif
+
+#if defined(HAVE_SSE2) || defined(HAVE_NEON)
+/*
+ * Sum of all bytes (or all nibbles if requested) of the data, processed
+ * in blocks of 16 bytes. Only the lower 16 bits of the result are
+ * valid. The number of bytes that were processed is returned in the
+ * last parameter, the remainder is left for the caller.
+ */
+static unsigned int
+checksum_sum_simd (const unsigned char data[], unsigned int size, int nibbles, unsigned int *count)
+{
+	unsigned int i = 0;
+#ifdef HAVE_SSE2
+	const __m128i zero = _mm_setzero_si128 ();
+	const __m128i mask = _mm_set1_epi8 (0x0F);
+	__m128i acc = _mm_setzero_si128 ();
+
+	for (i = 0; i + 16 <= size; i += 16) {
+		__m128i v = _mm_loadu_si128 ((const __m128i *) (data + i));
+		if (nibbles) {
+			__m128i hi = _mm_and_si128 (_mm_srli_epi16 (v, 4), mask);
+			acc = _mm_add_epi64 (acc, _mm_sad_epu8 (hi, zero));
+			v = _mm_and_si128 (v, mask);
+		}
+		acc = _mm_add_epi64 (acc, _mm_sad_epu8 (v, zero));
+	}
+
+	*count = i;
+
+	return _mm_cvtsi128_si32 (acc) + _mm_cvtsi128_si32 (_mm_srli_si128 (acc, 8));
+#else
+	const uint8x16_t mask = vdupq_n_u8 (0x0F);
+	uint16x8_t acc = vdupq_n_u16 (0);
+
+	// The 16 bit lanes may wrap around, but that doesn't matter
+	// for the lower 16 bits of the total.
+	for (i = 0; i + 16 <= size; i += 16) {
+		uint8x16_t v = vld1q_u8 (data + i);
+		if (nibbles) {
+			acc = vpadalq_u8 (acc, vshrq_n_u8 (v, 4));
+			v = vandq_u8 (v, mask);
+		}
+		acc = vpadalq_u8 (acc, v);
+	}
+
+	*count = i;
+
+	return vaddvq_u16 (acc);
+#endif
+}
+
+static unsigned int
+checksum_xor_simd (const unsigned char data[], unsigned int size, unsigned int *count)
+{
+	unsigned char result = 0;
+	unsigned char bytes[16];
+	unsigned int i = 0;
+#ifdef HAVE_SSE2
+	__m128i acc = _mm_setzero_si128 ();
+
+	for (i = 0; i + 16 <= size; i += 16) {
+		acc = _mm_xor_si128 (acc, _mm_loadu_si128 ((const __m128i *) (data + i)));
+	}
+
+	_mm_storeu_si128 ((__m128i *) bytes, acc);
+#else
+	uint8x16_t acc = vdupq_n_u8 (0);
+
+	for (i = 0; i + 16 <= size; i += 16) {
+		acc = veorq_u8 (acc, vld1q_u8 (data + i));
+	}
+
+	vst1q_u8 (bytes, acc);
+#endif
+
+	for (unsigned int j = 0; j < sizeof (bytes); ++j)
+		result ^= bytes[j];
+
+	*count = i;
+
+	return result;
+}
+#endif
+
+/*
+ * Inputs of at least this size are processed eight bytes at a time,
+ * using the slicing-by-8 technique. The extra tables are derived from
+ * the regular byte-wise table on first use.
+ */
+#define SLICE_MIN 32
+
+static dc_mutex_t g_mutex = DC_MUTEX_INIT;
+
+static void
+crc16_slices_init (unsigned short slices[8][256], const unsigned short table[], int *initialized, int reflected)
+{
+	dc_mutex_lock (&g_mutex);
+	if (!*initialized) {
+		for (unsigned int i = 0; i < 256; ++i) {
+			unsigned short crc = table[i];
+			slices[0][i] = crc;
+			for (unsigned int k = 1; k < 8; ++k) {
+				if (reflected)
+					crc = (crc >> 8) ^ table[crc & 0xff];
+				else
+					crc = (crc << 8) ^ table[crc >> 8];
+				slices[k][i] = crc;
+			}
+		}
+		*initialized = 1;
+	}
+	dc_mutex_unlock (&g_mutex);
+}
+
+static void
+crc32_slices_init (unsigned int slices[8][256], const unsigned int table[], int *initialized, int reflected)
+{
+	dc_mutex_lock (&g_mutex);
+	if (!*initialized) {
+		for (unsigned int i = 0; i < 256; ++i) {
+			unsigned int crc = table[i];
+			slices[0][i] = crc;
+			for (unsigned int k = 1; k < 8; ++k) {
+				if (reflected)
+					crc = (crc >> 8) ^ table[crc & 0xff];
+				else
+					crc = (crc << 8) ^ table[crc >> 24];
+				slices[k][i] = crc;
+			}
+		}
+		*initialized = 1;
+	}
+	dc_mutex_unlock (&g_mutex);
+}
+
+static unsigned int
+crc16_slice8 (const unsigned short slices[8][256], const unsigned char data[], unsigned int size, unsigned int crc)
+{
+	for (unsigned int i = 0; i + 8 <= size; i += 8) {
+		const unsigned char *p = data + i;
+		crc = slices[7][p[0] ^ (crc >> 8)] ^ slices[6][p[1] ^ (crc & 0xff)] ^
+			slices[5][p[2]] ^ slices[4][p[3]] ^
+			slices[3][p[4]] ^ slices[2][p[5]] ^
+			slices[1][p[6]] ^ slices[0][p[7]];
+	}
+
+	return crc;
+}
+
+static unsigned int
+crc16r_slice8 (const unsigned short slices[8][256], const unsigned char data[], unsigned int size, unsigned int crc)
+{
+	for (unsigned int i = 0; i + 8 <= size; i += 8) {
+		const unsigned char *p = data + i;
+		crc = slices[7][p[0] ^ (crc & 0xff)] ^ slices[6][p[1] ^ (crc >> 8)] ^
+			slices[5][p[2]] ^ slices[4][p[3]] ^
+			slices[3][p[4]] ^ slices[2][p[5]] ^
+			slices[1][p[6]] ^ slices[0][p[7]];
+	}
+
+	return crc;
+}
+
+static unsigned int
+crc32_slice8 (const unsigned int slices[8][256], const unsigned char data[], unsigned int size, unsigned int crc)
+{
+	for (unsigned int i = 0; i + 8 <= size; i += 8) {
+		const unsigned char *p = data + i;
+		crc = slices[7][p[0] ^ (crc >> 24)] ^ slices[6][p[1] ^ ((crc >> 16) & 0xff)] ^
+			slices[5][p[2] ^ ((crc >> 8) & 0xff)] ^ slices[4][p[3] ^ (crc & 0xff)] ^
+			slices[3][p[4]] ^ slices[2][p[5]] ^
+			slices[1][p[6]] ^ slices[0][p[7]];
+	}
+
+	return crc;
+}
+
+static unsigned int
+crc32r_slice8 (const unsigned int slices[8][256], const unsigned char data[], unsigned int size, unsigned int crc)
+{
+	for (unsigned int i = 0; i + 8 <= size; i += 8) {
+		const unsigned char *p = data + i;
+		crc = slices[7][p[0] ^ (crc & 0xff)] ^ slices[6][p[1] ^ ((crc >> 8) & 0xff)] ^
+			slices[5][p[2] ^ ((crc >> 16) & 0xff)] ^ slices[4][p[3] ^ (crc >> 24)] ^
+			slices[3][p[4]] ^ slices[2][p[5]] ^
+			slices[1][p[6]] ^ slices[0][p[7]];
+	}
+
+	return crc;
+}
+
+#ifdef HAVE_PCLMUL
+static int
+crc32r_have_pclmul (void)
+{
+	static int supported = -1;
+	int result = 0;
+
+	dc_mutex_lock (&g_mutex);
+	if (supported < 0) {
+		unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+		supported = __get_cpuid (1, &eax, &ebx, &ecx, &edx) &&
+			(ecx & bit_PCLMUL) && (edx & bit_SSE2);
+	}
+	result = supported;
+	dc_mutex_unlock (&g_mutex);
+
+	return result;
+}
+
+/*
+ * Reflected CRC-32 using carry-less multiplication, as described in the
+ * Intel white paper "Fast CRC Computation for Generic Polynomials Using
+ * PCLMULQDQ Instruction". The size must be a multiple of 16 bytes, and
+ * at least 64 bytes.
+ */
+__attribute__((target("sse2,pclmul")))
+static unsigned int
+crc32r_pclmul (const unsigned char data[], unsigned int size, unsigned int crc)
+{
+	const __m128i k1k2 = _mm_set_epi64x (0x01c6e41596LL, 0x0154442bd4LL);
+	const __m128i k3k4 = _mm_set_epi64x (0x00ccaa009eLL, 0x01751997d0LL);
+	const __m128i k5k0 = _mm_set_epi64x (0x0000000000LL, 0x0163cd6124LL);
+	const __m128i poly = _mm_set_epi64x (0x01f7011641LL, 0x01db710641LL);
+	const __m128i mask = _mm_setr_epi32 (~0, 0, ~0, 0);
+	__m128i x0, x1, x2, x3, x4, x5, x6, x7, x8;
+
+	x1 = _mm_loadu_si128 ((const __m128i *) (data + 0x00));
+	x2 = _mm_loadu_si128 ((const __m128i *) (data + 0x10));
+	x3 = _mm_loadu_si128 ((const __m128i *) (data + 0x20));
+	x4 = _mm_loadu_si128 ((const __m128i *) (data + 0x30));
+	x1 = _mm_xor_si128 (x1, _mm_cvtsi32_si128 (crc));
+	data += 64;
+	size -= 64;
+
+	// Fold four blocks of 16 bytes in parallel.
+	x0 = k1k2;
+	while (size >= 64) {
+		x5 = _mm_clmulepi64_si128 (x1, x0, 0x00);
+		x6 = _mm_clmulepi64_si128 (x2, x0, 0x00);
+		x7 = _mm_clmulepi64_si128 (x3, x0, 0x00);
+		x8 = _mm_clmulepi64_si128 (x4, x0, 0x00);
+		x1 = _mm_clmulepi64_si128 (x1, x0, 0x11);
+		x2 = _mm_clmulepi64_si128 (x2, x0, 0x11);
+		x3 = _mm_clmulepi64_si128 (x3, x0, 0x11);
+		x4 = _mm_clmulepi64_si128 (x4, x0, 0x11);
+		x1 = _mm_xor_si128 (_mm_xor_si128 (x1, x5), _mm_loadu_si128 ((const __m128i *) (data + 0x00)));
+		x2 = _mm_xor_si128 (_mm_xor_si128 (x2, x6), _mm_loadu_si128 ((const __m128i *) (data + 0x10)));
+		x3 = _mm_xor_si128 (_mm_xor_si128 (x3, x7), _mm_loadu_si128 ((const __m128i *) (data + 0x20)));
+		x4 = _mm_xor_si128 (_mm_xor_si128 (x4, x8), _mm_loadu_si128 ((const __m128i *) (data + 0x30)));
+		data += 64;
+		size -= 64;
+	}
+
+	// Fold into a single block of 16 bytes.
+	x0 = k3k4;
+	x5 = _mm_clmulepi64_si128 (x1, x0, 0x00);
+	x1 = _mm_clmulepi64_si128 (x1, x0, 0x11);
+	x1 = _mm_xor_si128 (_mm_xor_si128 (x1, x2), x5);
+	x5 = _mm_clmulepi64_si128 (x1, x0, 0x00);
+	x1 = _mm_clmulepi64_si128 (x1, x0, 0x11);
+	x1 = _mm_xor_si128 (_mm_xor_si128 (x1, x3), x5);
+	x5 = _mm_clmulepi64_si128 (x1, x0, 0x00);
+	x1 = _mm_clmulepi64_si128 (x1, x0, 0x11);
+	x1 = _mm_xor_si128 (_mm_xor_si128 (x1, x4), x5);
+
+	while (size >= 16) {
+		x5 = _mm_clmulepi64_si128 (x1, x0, 0x00);
+		x1 = _mm_clmulepi64_si128 (x1, x0, 0x11);
+		x1 = _mm_xor_si128 (_mm_xor_si128 (x1, _mm_loadu_si128 ((const __m128i *) data)), x5);
+		data += 16;
+		size -= 16;
+	}
+
+	// Fold 128 bits into 64 bits.
+	x2 = _mm_clmulepi64_si128 (x1, x0, 0x10);
+	x1 = _mm_xor_si128 (_mm_srli_si128 (x1, 8), x2);
+	x2 = _mm_srli_si128 (x1, 4);
+	x1 = _mm_and_si128 (x1, mask);
+	x1 = _mm_clmulepi64_si128 (x1, k5k0, 0x00);
+	x1 = _mm_xor_si128 (x1, x2);
+
+	// Barrett reduction to 32 bits.
+	x2 = _mm_and_si128 (x1, mask);
+	x2 = _mm_clmulepi64_si128 (x2, poly, 0x10);
+	x2 = _mm_and_si128 (x2, mask);
+	x2 = _mm_clmulepi64_si128 (x2, poly, 0x00);
+	x1 = _mm_xor_si128 (x1, x2);
+
+	return _mm_cvtsi128_si32 (_mm_srli_si128 (x1, 4));
+}
+#endif
+
+#ifdef HAVE_ARMCRC
+static unsigned int
+crc32r_armcrc (const unsigned char data[], unsigned int size, unsigned int crc)
+{
+	for (unsigned int i = 0; i + 8 <= size; i += 8) {
+		unsigned long long value = 0;
+		memcpy (&value, data + i, sizeof (value));
+		crc = __crc32d (crc, value);
+	}
+
+	return crc;
+}
+#endif
 
 
 unsigned char
 checksum_add_uint4 (const unsigned char data[], unsigned int size, unsigned char init)
 {
 	unsigned char crc = init;
-	for (unsigned int i = 0; i < size; ++i) {
+	unsigned int i = 0;
+#if defined(HAVE_SSE2) || defined(HAVE_NEON)
+	crc += checksum_sum_simd (data, size, 1, &i);
+#endif
+	for (; i < size; ++i) {
 		crc += (data[i] & 0xF0) >> 4;
 		crc += (data[i] & 0x0F);
 	}
@@ -39,7 +376,11 @@ unsigned char
 checksum_add_uint8 (const unsigned char data[], unsigned int size, unsigned char init)
 {
 	unsigned char crc = init;
-	for (unsigned int i = 0; i < size; ++i)
+	unsigned int i = 0;
+#if defined(HAVE_SSE2) || defined(HAVE_NEON)
+	crc += checksum_sum_simd (data, size, 0, &i);
+#endif
+	for (; i < size; ++i)
 		crc += data[i];
 
 	return crc;
@@ -50,7 +391,11 @@ unsigned short
 checksum_add_uint16 (const unsigned char data[], unsigned int size, unsigned short init)
 {
 	unsigned short crc = init;
-	for (unsigned int i = 0; i < size; ++i)
+	unsigned int i = 0;
+#if defined(HAVE_SSE2) || defined(HAVE_NEON)
+	crc += checksum_sum_simd (data, size, 0, &i);
+#endif
+	for (; i < size; ++i)
 		crc += data[i];
 
 	return crc;
@@ -61,7 +406,11 @@ unsigned char
 checksum_xor_uint8 (const unsigned char data[], unsigned int size, unsigned char init)
 {
 	unsigned char crc = init;
-	for (unsigned int i = 0; i < size; ++i)
+	unsigned int i = 0;
+#if defined(HAVE_SSE2) || defined(HAVE_NEON)
+	crc ^= checksum_xor_simd (data, size, &i);
+#endif
+	for (; i < size; ++i)
 		crc ^= data[i];
 
 	return crc;
@@ -111,8 +460,17 @@ checksum_crc16_ccitt (const unsigned char data[], unsigned int size, unsigned sh
 		0x6e17, 0x7e36, 0x4e55, 0x5e74, 0x2e93, 0x3eb2, 0x0ed1, 0x1ef0
 	};
 
+	static unsigned short slices[8][256];
+	static int initialized = 0;
+
 	unsigned short crc = init;
-	for (unsigned int i = 0; i < size; ++i)
+	unsigned int i = 0;
+	if (size >= SLICE_MIN) {
+		crc16_slices_init (slices, crc_ccitt_table, &initialized, 0);
+		i = size & ~7u;
+		crc = crc16_slice8 (slices, data, i, crc);
+	}
+	for (; i < size; ++i)
 		crc = (crc << 8) ^ crc_ccitt_table[(crc >> 8) ^ data[i]];
 
 	return crc ^ xorout;
@@ -162,8 +520,17 @@ checksum_crc16r_ccitt (const unsigned char data[], unsigned int size, unsigned s
 		0x7bc7, 0x6a4e, 0x58d5, 0x495c, 0x3de3, 0x2c6a, 0x1ef1, 0x0f78
 	};
 
+	static unsigned short slices[8][256];
+	static int initialized = 0;
+
 	unsigned short crc = init;
-	for (unsigned int i = 0; i < size; ++i)
+	unsigned int i = 0;
+	if (size >= SLICE_MIN) {
+		crc16_slices_init (slices, crc_ccitt_table, &initialized, 1);
+		i = size & ~7u;
+		crc = crc16r_slice8 (slices, data, i, crc);
+	}
+	for (; i < size; ++i)
 		crc = (crc >> 8) ^ crc_ccitt_table[(crc ^ data[i]) & 0xff];
 
 	return crc ^ xorout;
@@ -212,8 +579,17 @@ checksum_crc16_ansi (const unsigned char data[], unsigned int size, unsigned sho
 		0x8213, 0x0216, 0x021c, 0x8219, 0x0208, 0x820d, 0x8207, 0x0202
 	};
 
+	static unsigned short slices[8][256];
+	static int initialized = 0;
+
 	unsigned short crc = init;
-	for (unsigned int i = 0; i < size; ++i)
+	unsigned int i = 0;
+	if (size >= SLICE_MIN) {
+		crc16_slices_init (slices, crc_ccitt_table, &initialized, 0);
+		i = size & ~7u;
+		crc = crc16_slice8 (slices, data, i, crc);
+	}
+	for (; i < size; ++i)
 		crc = (crc << 8) ^ crc_ccitt_table[(crc >> 8) ^ data[i]];
 
 	return crc ^ xorout;
@@ -262,13 +638,41 @@ checksum_crc16r_ansi (const unsigned char data[], unsigned int size, unsigned sh
 		0x8201, 0x42c0, 0x4380, 0x8341, 0x4100, 0x81c1, 0x8081, 0x4040
 	};
 
+	static unsigned short slices[8][256];
+	static int initialized = 0;
+
 	unsigned short crc = init;
-	for (unsigned int i = 0; i < size; ++i)
+	unsigned int i = 0;
+	if (size >= SLICE_MIN) {
+		crc16_slices_init (slices, crc_ccitt_table, &initialized, 1);
+		i = size & ~7u;
+		crc = crc16r_slice8 (slices, data, i, crc);
+	}
+	for (; i < size; ++i)
 		crc = (crc >> 8) ^ crc_ccitt_table[(crc ^ data[i]) & 0xff];
 
 	return crc ^ xorout;
 }
 
+/*
+ * Polynomial: 0x1021
+ * RefIn: False
+ * RefOut: False
+ *
+ * Unlike a real CRC, only a single bit is shifted out per byte.
+ */
+unsigned short
+checksum_crc16_ccitt_1bit (const unsigned char data[], unsigned int size, unsigned short init)
+{
+	unsigned int crc = init;
+	for (unsigned int i = 0; i < size; ++i) {
+		crc ^= (unsigned int) data[i] << 8;
+		crc = ((crc << 1) ^ (-((crc >> 15) & 1) & 0x1021)) & 0xFFFF;
+	}
+
+	return crc;
+}
+
 
 /*
  * Polynomial: 0x04C11DB7
@@ -315,8 +719,27 @@ checksum_crc32r (const unsigned char data[], unsigned int size)
 		0xb3667a2e, 0xc4614ab8, 0x5d681b02, 0x2a6f2b94, 0xb40bbe37, 0xc30c8ea1, 0x5a05df1b, 0x2d02ef8d,
 	};
 
+	static unsigned int slices[8][256];
+	static int initialized = 0;
+
 	unsigned int crc = 0xffffffff;
-	for (unsigned int i = 0; i < size; ++i)
+	unsigned int i = 0;
+#if defined(HAVE_ARMCRC)
+	i = size & ~7u;
+	crc = crc32r_armcrc (data, i, crc);
+#elif defined(HAVE_PCLMUL)
+	if (size >= 64 && crc32r_have_pclmul ()) {
+		i = size & ~15u;
+		crc = crc32r_pclmul (data, i, crc);
+	}
+#endif
+	if (size - i >= SLICE_MIN) {
+		crc32_slices_init (slices, crc_table, &initialized, 1);
+		unsigned int n = (size - i) & ~7u;
+		crc = crc32r_slice8 (slices, data + i, n, crc);
+		i += n;
+	}
+	for (; i < size; ++i)
 		crc = crc_table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
 
 	return crc ^ 0xffffffff;
@@ -368,8 +791,17 @@ checksum_crc32 (const unsigned char data[], unsigned int size)
 		0xAFB010B1, 0xAB710D06, 0xA6322BDF, 0xA2F33668, 0xBCB4666D, 0xB8757BDA, 0xB5365D03, 0xB1F740B4,
 	};
 
+	static unsigned int slices[8][256];
+	static int initialized = 0;
+
 	unsigned int crc = 0xffffffff;
-	for (unsigned int i = 0; i < size; ++i)
+	unsigned int i = 0;
+	if (size >= SLICE_MIN) {
+		crc32_slices_init (slices, crc_table, &initialized, 0);
+		i = size & ~7u;
+		crc = crc32_slice8 (slices, data, i, crc);
+	}
+	for (; i < size; ++i)
 		crc = crc_table[((crc >> 24) ^ data[i]) & 0xFF] ^ (crc << 8);
 
 	return crc ^ 0xffffffff;
@@ -50,6 +50,9 @@ checksum_crc16_ansi (const unsigned char data[], unsigned int size, unsigned sho
 unsigned short
 checksum_crc16r_ansi (const unsigned char data[], unsigned int size, unsigned short init, unsigned short xorout);
 
+unsigned short
+checksum_crc16_ccitt_1bit (const unsigned char data[], unsigned int size, unsigned short init);
+
 unsigned int
 checksum_crc32r (const unsigned char data[], unsigned int size);
 
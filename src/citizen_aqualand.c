@@ -48,9 +48,11 @@ static const dc_device_vtable_t citizen_aqualand_device_vtable = {
 	DC_FAMILY_CITIZEN_AQUALAND,
 	citizen_aqualand_device_set_fingerprint, /* set_fingerprint */
 	NULL, /* read */
+	NULL, /* read_range */
 	NULL, /* write */
 	citizen_aqualand_device_dump, /* dump */
 	citizen_aqualand_device_foreach, /* foreach */
+	NULL, /* foreach_header */
 	NULL, /* timesync */
 	NULL /* close */
 };
@@ -189,7 +191,7 @@ citizen_aqualand_device_foreach (dc_device_t *abstract, dc_dive_callback_t callb
 {
 	citizen_aqualand_device_t *device = (citizen_aqualand_device_t *) abstract;
 
-	dc_buffer_t *buffer = dc_buffer_new (0);
+	dc_buffer_t *buffer = dc_buffer_new_context (abstract->context, 0);
 	if (buffer == NULL)
 		return DC_STATUS_NOMEMORY;
 
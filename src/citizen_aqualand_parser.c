@@ -48,7 +48,13 @@ static const dc_parser_vtable_t citizen_aqualand_parser_vtable = {
 	NULL, /* set_density */
 	citizen_aqualand_parser_get_datetime, /* datetime */
 	citizen_aqualand_parser_get_field, /* fields */
+	NULL, /* summary */
 	citizen_aqualand_parser_samples_foreach, /* samples_foreach */
+	NULL, /* samples_batch */
+	NULL, /* samples_fixed */
+	NULL, /* samples_append */
+	NULL, /* samples_range */
+	NULL, /* reset */
 	NULL /* destroy */
 };
 
@@ -101,6 +101,7 @@ typedef struct cochran_commander_device_t {
 
 static dc_status_t cochran_commander_device_set_fingerprint (dc_device_t *device, const unsigned char data[], unsigned int size);
 static dc_status_t cochran_commander_device_read (dc_device_t *device, unsigned int address, unsigned char data[], unsigned int size);
+static dc_status_t cochran_commander_device_read_range (dc_device_t *device, unsigned int address, unsigned char data[], unsigned int size, dc_event_progress_t *progress);
 static dc_status_t cochran_commander_device_dump (dc_device_t *device, dc_buffer_t *data);
 static dc_status_t cochran_commander_device_foreach (dc_device_t *device, dc_dive_callback_t callback, void *userdata);
 
@@ -109,9 +110,11 @@ static const dc_device_vtable_t cochran_commander_device_vtable = {
 	DC_FAMILY_COCHRAN_COMMANDER,
 	cochran_commander_device_set_fingerprint,/* set_fingerprint */
 	cochran_commander_device_read, /* read */
+	cochran_commander_device_read_range, /* read_range */
 	NULL, /* write */
 	cochran_commander_device_dump, /* dump */
 	cochran_commander_device_foreach, /* foreach */
+	NULL, /* foreach_header */
 	NULL, /* timesync */
 	NULL /* close */
 };
@@ -537,34 +540,45 @@ cochran_commander_read (cochran_commander_device_t *device, dc_event_progress_t
 }
 
 
+typedef struct cochran_commander_transfer_t {
+	dc_event_progress_t *progress;
+	unsigned int saved;
+	unsigned int address;
+	unsigned char *data;
+	unsigned int size;
+} cochran_commander_transfer_t;
+
+
 static dc_status_t
-cochran_commander_read_retry (cochran_commander_device_t *device, dc_event_progress_t *progress, unsigned int address, unsigned char data[], unsigned int size)
+cochran_commander_attempt (dc_device_t *abstract, unsigned int attempt, void *userdata)
 {
-	// Save the state of the progress events.
-	unsigned int saved = 0;
-	if (progress) {
-		saved = progress->current;
+	cochran_commander_device_t *device = (cochran_commander_device_t *) abstract;
+	cochran_commander_transfer_t *transfer = (cochran_commander_transfer_t *) userdata;
+
+	// Restore the state of the progress events.
+	if (attempt && transfer->progress) {
+		transfer->progress->current = transfer->saved;
 	}
 
-	unsigned int nretries = 0;
-	dc_status_t rc = DC_STATUS_SUCCESS;
-	while ((rc = cochran_commander_read (device, progress, address, data, size)) != DC_STATUS_SUCCESS) {
-		// Automatically discard a corrupted packet,
-		// and request a new one.
-		if (rc != DC_STATUS_PROTOCOL && rc != DC_STATUS_TIMEOUT)
-			return rc;
+	return cochran_commander_read (device, transfer->progress, transfer->address, transfer->data, transfer->size);
+}
 
-		// Abort if the maximum number of retries is reached.
-		if (nretries++ >= MAXRETRIES)
-			return rc;
 
-		// Restore the state of the progress events.
-		if (progress) {
-			progress->current = saved;
-		}
+static dc_status_t
+cochran_commander_read_retry (cochran_commander_device_t *device, dc_event_progress_t *progress, unsigned int address, unsigned char data[], unsigned int size)
+{
+	// Every read resets the serial line and the timeout, and waits a
+	// fixed amount of time for the device. There is no point in using
+	// the adaptive timeouts.
+	const device_retry_t policy = {MAXRETRIES, 0, 0, 0, 0};
+
+	// Save the state of the progress events.
+	cochran_commander_transfer_t transfer = {progress, 0, address, data, size};
+	if (progress) {
+		transfer.saved = progress->current;
 	}
 
-	return rc;
+	return device_transfer_retry ((dc_device_t *) device, device->iostream, &policy, cochran_commander_attempt, &transfer);
 }
 
 
@@ -805,6 +819,16 @@ cochran_commander_device_read (dc_device_t *abstract, unsigned int address, unsi
 }
 
 
+static dc_status_t
+cochran_commander_device_read_range (dc_device_t *abstract, unsigned int address, unsigned char data[], unsigned int size, dc_event_progress_t *progress)
+{
+	cochran_commander_device_t *device = (cochran_commander_device_t *) abstract;
+
+	// The entire range is transferred with a single read command.
+	return cochran_commander_read_retry(device, progress, address, data, size);
+}
+
+
 static dc_status_t
 cochran_commander_device_dump (dc_device_t *abstract, dc_buffer_t *buffer)
 {
@@ -823,23 +847,21 @@ cochran_commander_device_dump (dc_device_t *abstract, dc_buffer_t *buffer)
 	if (device->layout->model == COCHRAN_MODEL_COMMANDER_TM)
 		config_size = 512;
 
-	// Determine size for progress
-	dc_event_progress_t progress = EVENT_PROGRESS_INITIALIZER;
-	progress.maximum = config_size + size;
-	device_event_emit (abstract, DC_EVENT_PROGRESS, &progress);
-
 	// Emit ID block
 	dc_event_vendor_t vendor;
 	vendor.data = device->id;
 	vendor.size = sizeof (device->id);
 	device_event_emit (abstract, DC_EVENT_VENDOR, &vendor);
 
-	rc = cochran_commander_read_config (device, &progress, config, config_size);
+	// The config blocks are small compared to the memory, so only the
+	// sample data is included in the progress events.
+	rc = cochran_commander_read_config (device, NULL, config, config_size);
 	if (rc != DC_STATUS_SUCCESS)
 		return rc;
 
-	// Read the sample data, logbook and sample data are contiguous
-	rc = cochran_commander_read_retry (device, &progress, device->layout->rb_logbook_begin, dc_buffer_get_data(buffer), size);
+	// Read the sample data, logbook and sample data are contiguous. The
+	// entire range is transferred with a single read command.
+	rc = device_dump_read (abstract, device->layout->rb_logbook_begin, dc_buffer_get_data(buffer), size, size);
 	if (rc != DC_STATUS_SUCCESS) {
 		ERROR (abstract->context, "Failed to read the sample data.");
 		return rc;
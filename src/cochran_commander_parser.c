@@ -97,11 +97,15 @@ typedef struct cochran_commander_parser_t {
 	const cochran_parser_layout_t *layout;
 	const event_size_t *events;
 	unsigned int nevents;
+	// Cached end of an incomplete profile.
+	unsigned int cached;
+	unsigned int profile_size;
 } cochran_commander_parser_t ;
 
 static dc_status_t cochran_commander_parser_get_datetime (dc_parser_t *parser, dc_datetime_t *datetime);
 static dc_status_t cochran_commander_parser_get_field (dc_parser_t *parser, dc_field_type_t type, unsigned int flags, void *value);
 static dc_status_t cochran_commander_parser_samples_foreach (dc_parser_t *parser, dc_sample_callback_t callback, void *userdata);
+static dc_status_t cochran_commander_parser_reset (dc_parser_t *parser);
 
 static const dc_parser_vtable_t cochran_commander_parser_vtable = {
 	sizeof(cochran_commander_parser_t),
@@ -111,7 +115,13 @@ static const dc_parser_vtable_t cochran_commander_parser_vtable = {
 	NULL, /* set_density */
 	cochran_commander_parser_get_datetime, /* datetime */
 	cochran_commander_parser_get_field, /* fields */
+	NULL, /* summary */
 	cochran_commander_parser_samples_foreach, /* samples_foreach */
+	NULL, /* samples_batch */
+	NULL, /* samples_fixed */
+	NULL, /* samples_append */
+	NULL, /* samples_range */
+	cochran_commander_parser_reset, /* reset */
 	NULL /* destroy */
 };
 
@@ -324,28 +334,35 @@ cochran_commander_handle_event (cochran_commander_parser_t *parser, unsigned cha
 /*
  * Used to find the end of a dive that has an incomplete dive-end
  * block. It parses backwards past inter-dive events.
+ *
+ * Because we are parsing backwards and the events vary in size, we can't
+ * be sure the byte that matches the event code is an event code or data
+ * from inside a longer or shorter event. Every match is therefore followed,
+ * and the smallest offset that can be reached is the end of the dive.
+ * The reachable offsets are tracked in a sliding window, one bit for each
+ * of the next bytes, which is enough because the events are short.
  */
-static int
-cochran_commander_backparse(cochran_commander_parser_t *parser, const unsigned char *samples, int size)
+static unsigned int
+cochran_commander_backparse(cochran_commander_parser_t *parser, const unsigned char *samples, unsigned int size)
 {
-	int result = size, best_result = size;
-
-	for (unsigned int i = 0; i < parser->nevents; i++) {
-		int ptr = size - parser->events[i].size;
-		if (ptr > 0 && samples[ptr] == parser->events[i].code) {
-			// Recurse to find the largest match. Because we are parsing backwards
-			// and the events vary in size we can't be sure the byte that matches
-			// the event code is an event code or data from inside a longer or shorter
-			// event.
-			result = cochran_commander_backparse(parser, samples, ptr);
-		}
+	unsigned int result = size;
+	unsigned int reachable = 1;
+
+	for (unsigned int ptr = size; ptr > 0 && reachable; ptr--, reachable >>= 1) {
+		if ((reachable & 1) == 0)
+			continue;
 
-		if (result < best_result) {
-			best_result = result;
+		result = ptr;
+
+		for (unsigned int i = 0; i < parser->nevents; i++) {
+			unsigned int n = parser->events[i].size;
+			if (ptr > n && samples[ptr - n] == parser->events[i].code) {
+				reachable |= 1u << n;
+			}
 		}
 	}
 
-	return best_result;
+	return result;
 }
 
 
@@ -366,6 +383,7 @@ cochran_commander_parser_create (dc_parser_t **out, dc_context_t *context, const
 	}
 
 	parser->model = model;
+	cochran_commander_parser_reset ((dc_parser_t *) parser);
 
 	switch (model) {
 	case COCHRAN_MODEL_COMMANDER_TM:
@@ -405,6 +423,18 @@ error_free:
 }
 
 
+static dc_status_t
+cochran_commander_parser_reset (dc_parser_t *abstract)
+{
+	cochran_commander_parser_t *parser = (cochran_commander_parser_t *) abstract;
+
+	parser->cached = 0;
+	parser->profile_size = 0;
+
+	return DC_STATUS_SUCCESS;
+}
+
+
 static dc_status_t
 cochran_commander_parser_get_datetime (dc_parser_t *abstract, dc_datetime_t *datetime)
 {
@@ -692,7 +722,11 @@ cochran_commander_parser_samples_foreach_emc (dc_parser_t *abstract, dc_sample_c
 				d.year, d.month, d.day, d.hour, d.minute, d.second);
 
 		// Eliminate inter-dive events
-		size = cochran_commander_backparse(parser, samples, size);
+		if (!parser->cached) {
+			parser->profile_size = cochran_commander_backparse(parser, samples, size);
+			parser->cached = 1;
+		}
+		size = parser->profile_size;
 	}
 
 	// Cochran samples depth every second and varies between ascent rate
@@ -0,0 +1,112 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2026 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+
+#include <libdivecomputer/column.h>
+
+#define MAXVARINT 5
+
+size_t
+dc_column_maxsize (unsigned int count)
+{
+	return (size_t) count * MAXVARINT;
+}
+
+dc_status_t
+dc_column_encode (dc_buffer_t *buffer, const unsigned int values[], unsigned int count)
+{
+	if (buffer == NULL || (values == NULL && count))
+		return DC_STATUS_INVALIDARGS;
+
+	size_t offset = dc_buffer_get_size (buffer);
+	if (!dc_buffer_resize (buffer, offset + dc_column_maxsize (count)))
+		return DC_STATUS_NOMEMORY;
+
+	unsigned char *data = dc_buffer_get_data (buffer);
+	unsigned char *p = data + offset;
+
+	unsigned int previous = 0;
+	for (unsigned int i = 0; i < count; ++i) {
+		unsigned int delta = (values[i] - previous) & 0xFFFFFFFF;
+		unsigned int value = ((delta << 1) ^ (0 - (delta >> 31))) & 0xFFFFFFFF;
+		while (value >= 0x80) {
+			*p++ = (value & 0x7F) | 0x80;
+			value >>= 7;
+		}
+		*p++ = value;
+		previous = values[i];
+	}
+
+	dc_buffer_resize (buffer, p - data);
+
+	return DC_STATUS_SUCCESS;
+}
+
+dc_status_t
+dc_column_decode (const unsigned char data[], size_t size, unsigned int values[], unsigned int count, size_t *consumed)
+{
+	if ((data == NULL && size) || (values == NULL && count))
+		return DC_STATUS_INVALIDARGS;
+
+	size_t offset = 0;
+	unsigned int previous = 0;
+	unsigned int i = 0;
+
+	// As long as a full varint fits in the remaining data, the bounds
+	// don't need to be checked for every byte. Single byte values take
+	// a shortcut.
+	while (i < count && size - offset >= MAXVARINT) {
+		unsigned int value = data[offset++];
+		if (value & 0x80) {
+			unsigned int shift = 7;
+			value &= 0x7F;
+			for (;;) {
+				unsigned int byte = data[offset++];
+				value |= (byte & 0x7F) << shift;
+				if ((byte & 0x80) == 0)
+					break;
+				shift += 7;
+				if (shift == 7 * MAXVARINT)
+					return DC_STATUS_DATAFORMAT;
+			}
+		}
+		previous += (value >> 1) ^ (0 - (value & 1));
+		values[i++] = previous & 0xFFFFFFFF;
+	}
+
+	while (i < count) {
+		unsigned int value = 0, shift = 0, byte = 0;
+		do {
+			if (offset == size || shift == 7 * MAXVARINT)
+				return DC_STATUS_DATAFORMAT;
+			byte = data[offset++];
+			value |= (byte & 0x7F) << shift;
+			shift += 7;
+		} while (byte & 0x80);
+		previous += (value >> 1) ^ (0 - (value & 1));
+		values[i++] = previous & 0xFFFFFFFF;
+	}
+
+	if (consumed)
+		*consumed = offset;
+
+	return DC_STATUS_SUCCESS;
+}
@@ -29,6 +29,8 @@
 #include <libdivecomputer/context.h>
 
 #include "platform.h"
+#include "thread.h"
+#include "timer.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -42,13 +44,78 @@ extern "C" {
 #define FUNCTION __FUNCTION__
 #endif
 
+#ifndef MAX_LOGLEVEL
+#define MAX_LOGLEVEL DC_LOGLEVEL_ALL
+#endif
+
+/*
+ * The context is only opaque for the applications. The log level is
+ * checked inline by the logging macros, before any of the arguments
+ * are evaluated.
+ */
+struct dc_context_t {
+	dc_loglevel_t loglevel;
+	dc_logfunc_t logfunc;
+	dc_logrecordfunc_t logrecordfunc;
+	unsigned int logflags;
+	void *userdata;
+	dc_malloc_func_t mallocfunc;
+	dc_realloc_func_t reallocfunc;
+	dc_free_func_t freefunc;
+	void *allocdata;
+	size_t memlimit;
+	unsigned int parserstats;
+	dc_spanfunc_t spanfunc;
+	void *spandata;
 #ifdef ENABLE_LOGGING
-#define HEXDUMP(context, loglevel, prefix, data, size) dc_context_hexdump (context, loglevel, __FILE__, __LINE__, FUNCTION, prefix, data, size)
-#define SYSERROR(context, errcode) dc_context_syserror (context, DC_LOGLEVEL_ERROR, __FILE__, __LINE__, FUNCTION, errcode)
-#define ERROR(context, ...) dc_context_log (context, DC_LOGLEVEL_ERROR, __FILE__, __LINE__, FUNCTION, __VA_ARGS__)
-#define WARNING(context, ...) dc_context_log (context, DC_LOGLEVEL_WARNING, __FILE__, __LINE__, FUNCTION, __VA_ARGS__)
-#define INFO(context, ...) dc_context_log (context, DC_LOGLEVEL_INFO, __FILE__, __LINE__, FUNCTION, __VA_ARGS__)
-#define DEBUG(context, ...) dc_context_log (context, DC_LOGLEVEL_DEBUG, __FILE__, __LINE__, FUNCTION, __VA_ARGS__)
+#ifndef DC_THREAD_LOCAL
+	char *msg;
+	dc_mutex_t mutex;
+#endif
+	dc_nsecs_t start;
+#endif
+};
+
+/*
+ * Allocate memory with the allocator of the context. Without a context,
+ * the C library is used.
+ */
+void *
+dc_context_malloc (dc_context_t *context, size_t size);
+
+void *
+dc_context_realloc (dc_context_t *context, void *ptr, size_t size);
+
+void
+dc_context_release (dc_context_t *context, void *ptr);
+
+/*
+ * Check a single buffer of 'size' bytes against the memory limit of
+ * the context. The limit applies to each buffer on its own, and not to
+ * the total of the buffers that are alive at the same time. The error
+ * message names the component that needs it.
+ */
+dc_status_t
+dc_context_check_buffer (dc_context_t *context, size_t size, const char *component);
+
+/*
+ * Check whether messages at the log level are enabled. Levels above the
+ * configured maximum are a constant false, and the compiler removes the
+ * logging code entirely.
+ */
+#define LOGLEVEL_ENABLED(context, level) \
+	((level) <= MAX_LOGLEVEL && (context) != NULL && (level) <= ((dc_context_t *) (context))->loglevel)
+
+#define LOG_IF(context, level, call) \
+	(LOGLEVEL_ENABLED (context, level) ? (void) (call) : (void) 0)
+
+#ifdef ENABLE_LOGGING
+#define HEXDUMP(context, loglevel, prefix, data, size) LOG_IF (context, loglevel, dc_context_hexdump (context, loglevel, __FILE__, __LINE__, FUNCTION, prefix, data, size))
+#define SYSERROR(context, errcode) LOG_IF (context, DC_LOGLEVEL_ERROR, dc_context_syserror (context, DC_LOGLEVEL_ERROR, __FILE__, __LINE__, FUNCTION, errcode))
+#define ERROR(context, ...) LOG_IF (context, DC_LOGLEVEL_ERROR, dc_context_log (context, DC_LOGLEVEL_ERROR, __FILE__, __LINE__, FUNCTION, __VA_ARGS__))
+#define WARNING(context, ...) LOG_IF (context, DC_LOGLEVEL_WARNING, dc_context_log (context, DC_LOGLEVEL_WARNING, __FILE__, __LINE__, FUNCTION, __VA_ARGS__))
+#define INFO(context, ...) LOG_IF (context, DC_LOGLEVEL_INFO, dc_context_log (context, DC_LOGLEVEL_INFO, __FILE__, __LINE__, FUNCTION, __VA_ARGS__))
+#define DEBUG(context, ...) LOG_IF (context, DC_LOGLEVEL_DEBUG, dc_context_log (context, DC_LOGLEVEL_DEBUG, __FILE__, __LINE__, FUNCTION, __VA_ARGS__))
 #else
 #define HEXDUMP(context, loglevel, prefix, data, size) UNUSED(context)
 #define SYSERROR(context, errcode) UNUSED(context)
@@ -58,6 +125,23 @@ extern "C" {
 #define DEBUG(context, ...) UNUSED(context)
 #endif
 
+/*
+ * Report a tracing span. Without a span function, only a pointer test
+ * remains.
+ */
+#define SPAN_ENABLED(context) \
+	((context) != NULL && ((dc_context_t *) (context))->spanfunc != NULL)
+
+#define SPAN(context, type, name, value) \
+	(SPAN_ENABLED (context) ? dc_context_span (context, type, name, value) : (void) 0)
+
+#define SPAN_BEGIN(context, name) SPAN (context, DC_SPAN_BEGIN, name, 0)
+#define SPAN_END(context, name, value) SPAN (context, DC_SPAN_END, name, value)
+#define SPAN_COUNTER(context, name, value) SPAN (context, DC_SPAN_COUNTER, name, value)
+
+void
+dc_context_span (dc_context_t *context, dc_span_type_t type, const char *name, unsigned long long value);
+
 dc_status_t
 dc_context_log (dc_context_t *context, dc_loglevel_t loglevel, const char *file, unsigned int line, const char *function, const char *format, ...) DC_ATTR_FORMAT_PRINTF(6, 7);
 
@@ -36,19 +36,69 @@
 
 #include "context-private.h"
 #include "platform.h"
+#include "thread.h"
 #include "timer.h"
 
-struct dc_context_t {
-	dc_loglevel_t loglevel;
-	dc_logfunc_t logfunc;
-	void *userdata;
+#define MSGSIZE (16384 + 32)
+
 #ifdef ENABLE_LOGGING
-	char msg[16384 + 32];
-	dc_timer_t *timer;
+#ifdef DC_THREAD_LOCAL
+/*
+ * Every thread formats its messages in a private buffer, such that a
+ * context can be shared between threads without any locking.
+ */
+static DC_THREAD_LOCAL char g_msg[MSGSIZE];
 #endif
-};
 
-#ifdef ENABLE_LOGGING
+/*
+ * Get the buffer to format a message. Without thread local storage, the
+ * buffer is only allocated for the first message, such that a context
+ * that never logs anything stays small. Returns NULL if out of memory.
+ */
+static char *
+msgbuf_acquire (dc_context_t *context)
+{
+#ifdef DC_THREAD_LOCAL
+	return g_msg;
+#else
+	dc_mutex_lock (&context->mutex);
+	if (context->msg == NULL)
+		context->msg = (char *) malloc (MSGSIZE);
+	if (context->msg == NULL)
+		dc_mutex_unlock (&context->mutex);
+	return context->msg;
+#endif
+}
+
+/*
+ * Detach the formatted message from the shared buffer. Without thread
+ * local storage, the message is copied and the shared buffer unlocked,
+ * such that the log function can log again, or call other functions
+ * that log, without a deadlock. Returns NULL if out of memory.
+ */
+static char *
+msgbuf_detach (dc_context_t *context, char *msg)
+{
+#ifdef DC_THREAD_LOCAL
+	return msg;
+#else
+	size_t length = strlen (msg);
+	char *copy = (char *) malloc (length + 1);
+	if (copy)
+		memcpy (copy, msg, length + 1);
+	dc_mutex_unlock (&context->mutex);
+	return copy;
+#endif
+}
+
+static void
+msgbuf_release (dc_context_t *context, char *msg)
+{
+#ifndef DC_THREAD_LOCAL
+	free (msg);
+#endif
+}
+
 static int
 l_hexdump (char *str, size_t size, const unsigned char data[], size_t n)
 {
@@ -81,13 +131,29 @@ l_hexdump (char *str, size_t size, const unsigned char data[], size_t n)
 	return (n > maxlength ? -1 : (int) (length * 2));
 }
 
+static void
+logrecord (dc_context_t *context, dc_loglevel_t loglevel, const char *file, unsigned int line, const char *function, const char *msg, const char *prefix, const unsigned char data[], unsigned int size)
+{
+	dc_logrecord_t record;
+
+	record.loglevel = loglevel;
+	record.file = file;
+	record.line = line;
+	record.function = function;
+	record.message = msg;
+	record.prefix = prefix;
+	record.data = data;
+	record.size = size;
+
+	context->logrecordfunc (context, &record, context->userdata);
+}
+
 static void
 loghandler (dc_context_t *context, dc_loglevel_t loglevel, const char *file, unsigned int line, const char *function, const char *msg, void *userdata)
 {
 	const char *loglevels[] = {"NONE", "ERROR", "WARNING", "INFO", "DEBUG", "ALL"};
 
-	dc_usecs_t now = 0;
-	dc_timer_now (context->timer, &now);
+	dc_usecs_t now = (dc_clock_monotonic () - context->start) / 1000;
 
 	unsigned long seconds = now / 1000000;
 	unsigned long microseconds = now % 1000000;
@@ -123,12 +189,25 @@ dc_context_new (dc_context_t **out)
 	context->loglevel = DC_LOGLEVEL_NONE;
 	context->logfunc = NULL;
 #endif
+	context->logrecordfunc = NULL;
+	context->logflags = 0;
 	context->userdata = NULL;
+	context->mallocfunc = NULL;
+	context->reallocfunc = NULL;
+	context->freefunc = NULL;
+	context->allocdata = NULL;
+	context->memlimit = 0;
+	context->parserstats = 0;
+	context->spanfunc = NULL;
+	context->spandata = NULL;
 
 #ifdef ENABLE_LOGGING
-	memset (context->msg, 0, sizeof (context->msg));
-	context->timer = NULL;
-	dc_timer_new (&context->timer);
+#ifndef DC_THREAD_LOCAL
+	dc_mutex_t mutex = DC_MUTEX_INIT;
+	context->msg = NULL;
+	context->mutex = mutex;
+#endif
+	context->start = dc_clock_monotonic ();
 #endif
 
 	*out = context;
@@ -142,8 +221,8 @@ dc_context_free (dc_context_t *context)
 	if (context == NULL)
 		return DC_STATUS_SUCCESS;
 
-#ifdef ENABLE_LOGGING
-	dc_timer_free (context->timer);
+#if defined(ENABLE_LOGGING) && !defined(DC_THREAD_LOCAL)
+	free (context->msg);
 #endif
 	free (context);
 
@@ -171,17 +250,141 @@ dc_context_set_logfunc (dc_context_t *context, dc_logfunc_t logfunc, void *userd
 
 #ifdef ENABLE_LOGGING
 	context->logfunc = logfunc;
+	context->logrecordfunc = NULL;
+	context->logflags = 0;
 	context->userdata = userdata;
 #endif
 
 	return DC_STATUS_SUCCESS;
 }
 
+dc_status_t
+dc_context_set_logrecordfunc (dc_context_t *context, dc_logrecordfunc_t logrecordfunc, unsigned int flags, void *userdata)
+{
+	if (context == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+#ifdef ENABLE_LOGGING
+	context->logfunc = NULL;
+	context->logrecordfunc = logrecordfunc;
+	context->logflags = flags;
+	context->userdata = userdata;
+#endif
+
+	return DC_STATUS_SUCCESS;
+}
+
+dc_status_t
+dc_context_set_spanfunc (dc_context_t *context, dc_spanfunc_t spanfunc, void *userdata)
+{
+	if (context == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	context->spanfunc = spanfunc;
+	context->spandata = userdata;
+
+	return DC_STATUS_SUCCESS;
+}
+
+void
+dc_context_span (dc_context_t *context, dc_span_type_t type, const char *name, unsigned long long value)
+{
+	if (context == NULL || context->spanfunc == NULL)
+		return;
+
+	context->spanfunc (context, type, name, value, context->spandata);
+}
+
+dc_status_t
+dc_context_set_allocator (dc_context_t *context, dc_malloc_func_t mallocfunc, dc_realloc_func_t reallocfunc, dc_free_func_t freefunc, void *userdata)
+{
+	if (context == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	if ((mallocfunc == NULL) != (freefunc == NULL) ||
+		(mallocfunc == NULL) != (reallocfunc == NULL))
+		return DC_STATUS_INVALIDARGS;
+
+	context->mallocfunc = mallocfunc;
+	context->reallocfunc = reallocfunc;
+	context->freefunc = freefunc;
+	context->allocdata = userdata;
+
+	return DC_STATUS_SUCCESS;
+}
+
+dc_status_t
+dc_context_set_memory_limit (dc_context_t *context, size_t limit)
+{
+	if (context == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	context->memlimit = limit;
+
+	return DC_STATUS_SUCCESS;
+}
+
+dc_status_t
+dc_context_set_parser_stats (dc_context_t *context, unsigned int enable)
+{
+	if (context == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	context->parserstats = enable != 0;
+
+	return DC_STATUS_SUCCESS;
+}
+
+dc_status_t
+dc_context_check_buffer (dc_context_t *context, size_t size, const char *component)
+{
+	if (context == NULL || context->memlimit == 0 || size <= context->memlimit)
+		return DC_STATUS_SUCCESS;
+
+	ERROR (context, "The %s needs %lu bytes, which exceeds the memory limit of %lu bytes.",
+		component, (unsigned long) size, (unsigned long) context->memlimit);
+
+	return DC_STATUS_NOMEMORY;
+}
+
+void *
+dc_context_malloc (dc_context_t *context, size_t size)
+{
+	if (context == NULL || context->mallocfunc == NULL)
+		return malloc (size);
+
+	return context->mallocfunc (size, context->allocdata);
+}
+
+void *
+dc_context_realloc (dc_context_t *context, void *ptr, size_t size)
+{
+	if (context == NULL || context->reallocfunc == NULL)
+		return realloc (ptr, size);
+
+	return context->reallocfunc (ptr, size, context->allocdata);
+}
+
+void
+dc_context_release (dc_context_t *context, void *ptr)
+{
+	if (ptr == NULL)
+		return;
+
+	if (context == NULL || context->freefunc == NULL) {
+		free (ptr);
+		return;
+	}
+
+	context->freefunc (ptr, context->allocdata);
+}
+
 dc_status_t
 dc_context_log (dc_context_t *context, dc_loglevel_t loglevel, const char *file, unsigned int line, const char *function, const char *format, ...)
 {
 #ifdef ENABLE_LOGGING
 	va_list ap;
+	char *msg = NULL;
 #endif
 
 	if (context == NULL)
@@ -191,14 +394,27 @@ dc_context_log (dc_context_t *context, dc_loglevel_t loglevel, const char *file,
 	if (loglevel > context->loglevel)
 		return DC_STATUS_SUCCESS;
 
-	if (context->logfunc == NULL)
+	if (context->logfunc == NULL && context->logrecordfunc == NULL)
 		return DC_STATUS_SUCCESS;
 
+	msg = msgbuf_acquire (context);
+	if (msg == NULL)
+		return DC_STATUS_NOMEMORY;
+
 	va_start (ap, format);
-	dc_platform_vsnprintf (context->msg, sizeof (context->msg), format, ap);
+	dc_platform_vsnprintf (msg, MSGSIZE, format, ap);
 	va_end (ap);
 
-	context->logfunc (context, loglevel, file, line, function, context->msg, context->userdata);
+	msg = msgbuf_detach (context, msg);
+	if (msg == NULL)
+		return DC_STATUS_NOMEMORY;
+
+	if (context->logrecordfunc)
+		logrecord (context, loglevel, file, line, function, msg, NULL, NULL, 0);
+	else
+		context->logfunc (context, loglevel, file, line, function, msg, context->userdata);
+
+	msgbuf_release (context, msg);
 #endif
 
 	return DC_STATUS_SUCCESS;
@@ -248,6 +464,7 @@ dc_status_t
 dc_context_hexdump (dc_context_t *context, dc_loglevel_t loglevel, const char *file, unsigned int line, const char *function, const char *prefix, const unsigned char data[], unsigned int size)
 {
 #ifdef ENABLE_LOGGING
+	char *msg = NULL;
 	int n;
 #endif
 
@@ -258,16 +475,35 @@ dc_context_hexdump (dc_context_t *context, dc_loglevel_t loglevel, const char *f
 	if (loglevel > context->loglevel)
 		return DC_STATUS_SUCCESS;
 
-	if (context->logfunc == NULL)
+	if (context->logfunc == NULL && context->logrecordfunc == NULL)
+		return DC_STATUS_SUCCESS;
+
+	// Pass the raw bytes without formatting, unless the text is needed.
+	if (context->logrecordfunc && !(context->logflags & DC_LOGRECORD_TEXT)) {
+		logrecord (context, loglevel, file, line, function, NULL, prefix, data, size);
 		return DC_STATUS_SUCCESS;
+	}
+
+	msg = msgbuf_acquire (context);
+	if (msg == NULL)
+		return DC_STATUS_NOMEMORY;
 
-	n = dc_platform_snprintf (context->msg, sizeof (context->msg), "%s: size=%u, data=", prefix, size);
+	n = dc_platform_snprintf (msg, MSGSIZE, "%s: size=%u, data=", prefix, size);
 
 	if (n >= 0) {
-		n = l_hexdump (context->msg + n, sizeof (context->msg) - n, data, size);
+		n = l_hexdump (msg + n, MSGSIZE - n, data, size);
 	}
 
-	context->logfunc (context, loglevel, file, line, function, context->msg, context->userdata);
+	msg = msgbuf_detach (context, msg);
+	if (msg == NULL)
+		return DC_STATUS_NOMEMORY;
+
+	if (context->logrecordfunc)
+		logrecord (context, loglevel, file, line, function, msg, prefix, data, size);
+	else
+		context->logfunc (context, loglevel, file, line, function, msg, context->userdata);
+
+	msgbuf_release (context, msg);
 #endif
 
 	return DC_STATUS_SUCCESS;
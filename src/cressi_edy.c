@@ -73,9 +73,11 @@ static const dc_device_vtable_t cressi_edy_device_vtable = {
 	DC_FAMILY_CRESSI_EDY,
 	cressi_edy_device_set_fingerprint, /* set_fingerprint */
 	cressi_edy_device_read, /* read */
+	NULL, /* read_range */
 	NULL, /* write */
 	cressi_edy_device_dump, /* dump */
 	cressi_edy_device_foreach, /* foreach */
+	NULL, /* foreach_header */
 	NULL, /* timesync */
 	cressi_edy_device_close /* close */
 };
@@ -165,6 +167,8 @@ cressi_edy_transfer (cressi_edy_device_t *device, const unsigned char command[],
 		if (nretries++ >= MAXRETRIES)
 			return rc;
 
+		device_stats_retry ((dc_device_t *) device);
+
 		// Delay the next attempt.
 		dc_iostream_sleep (device->iostream, 300);
 		dc_iostream_purge (device->iostream, DC_DIRECTION_INPUT);
@@ -52,7 +52,13 @@ static const dc_parser_vtable_t cressi_edy_parser_vtable = {
 	NULL, /* set_density */
 	cressi_edy_parser_get_datetime, /* datetime */
 	cressi_edy_parser_get_field, /* fields */
+	NULL, /* summary */
 	cressi_edy_parser_samples_foreach, /* samples_foreach */
+	NULL, /* samples_batch */
+	NULL, /* samples_fixed */
+	NULL, /* samples_append */
+	NULL, /* samples_range */
+	NULL, /* reset */
 	NULL /* destroy */
 };
 
@@ -118,6 +124,23 @@ cressi_edy_parser_get_datetime (dc_parser_t *abstract, dc_datetime_t *datetime)
 }
 
 
+static unsigned int
+cressi_edy_parser_interval (cressi_edy_parser_t *parser)
+{
+	const unsigned char *data = parser->base.data;
+
+	unsigned int interval = 30;
+	if (parser->model == EDY) {
+		interval = 1;
+	} else if (parser->model == IQ700) {
+		if (data[0x07] & 0x40)
+			interval = 15;
+	}
+
+	return interval;
+}
+
+
 static dc_status_t
 cressi_edy_parser_get_field (dc_parser_t *abstract, dc_field_type_t type, unsigned int flags, void *value)
 {
@@ -129,6 +152,7 @@ cressi_edy_parser_get_field (dc_parser_t *abstract, dc_field_type_t type, unsign
 	const unsigned char *p = abstract->data;
 
 	dc_gasmix_t *gasmix = (dc_gasmix_t *) value;
+	dc_sample_interval_t *interval = (dc_sample_interval_t *) value;
 
 	if (value) {
 		switch (type) {
@@ -153,6 +177,10 @@ cressi_edy_parser_get_field (dc_parser_t *abstract, dc_field_type_t type, unsign
 		case DC_FIELD_TEMPERATURE_MINIMUM:
 			*((double *) value) = (bcd2dec (p[0x0B]) * 100 + bcd2dec (p[0x0C])) / 100.0;
 			break;
+		case DC_FIELD_SAMPLE_INTERVAL:
+			interval->interval = cressi_edy_parser_interval (parser) * 1000;
+			interval->regular = 1;
+			break;
 		default:
 			return DC_STATUS_UNSUPPORTED;
 		}
@@ -171,13 +199,7 @@ cressi_edy_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_t c
 	unsigned int size = abstract->size;
 
 	unsigned int time = 0;
-	unsigned int interval = 30;
-	if (parser->model == EDY) {
-		interval = 1;
-	} else if (parser->model == IQ700) {
-		if (data[0x07] & 0x40)
-			interval = 15;
-	}
+	unsigned int interval = cressi_edy_parser_interval (parser);
 
 	unsigned int ngasmixes = cressi_edy_parser_count_gasmixes(data);
 	unsigned int gasmix = 0xFFFFFFFF;
@@ -65,9 +65,11 @@ static const dc_device_vtable_t cressi_goa_device_vtable = {
 	DC_FAMILY_CRESSI_GOA,
 	cressi_goa_device_set_fingerprint, /* set_fingerprint */
 	NULL, /* read */
+	NULL, /* read_range */
 	NULL, /* write */
 	NULL, /* dump */
 	cressi_goa_device_foreach, /* foreach */
+	NULL, /* foreach_header */
 	NULL, /* timesync */
 	NULL /* close */
 };
@@ -216,9 +218,14 @@ cressi_goa_device_download (cressi_goa_device_t *device, dc_buffer_t *buffer, dc
 			return status;
 		}
 
-		// Get the total size from the first data packet.
+		// Get the total size from the first data packet, and reserve
+		// the memory for the entire payload at once.
 		if (nbytes == 0) {
 			size += array_uint16_le (packet + 3);
+			if (!dc_buffer_reserve (buffer, size - skip)) {
+				ERROR (abstract->context, "Insufficient buffer space available.");
+				return DC_STATUS_NOMEMORY;
+			}
 		}
 
 		// Calculate the payload size of the packet.
@@ -74,7 +74,13 @@ static const dc_parser_vtable_t cressi_goa_parser_vtable = {
 	NULL, /* set_density */
 	cressi_goa_parser_get_datetime, /* datetime */
 	cressi_goa_parser_get_field, /* fields */
+	NULL, /* summary */
 	cressi_goa_parser_samples_foreach, /* samples_foreach */
+	NULL, /* samples_batch */
+	NULL, /* samples_fixed */
+	NULL, /* samples_append */
+	NULL, /* samples_range */
+	NULL, /* reset */
 	NULL /* destroy */
 };
 
@@ -210,6 +216,7 @@ cressi_goa_parser_get_field (dc_parser_t *abstract, dc_field_type_t type, unsign
 	}
 
 	dc_gasmix_t *gasmix = (dc_gasmix_t *) value;
+	dc_sample_interval_t *interval = (dc_sample_interval_t *) value;
 
 	if (value) {
 		switch (type) {
@@ -263,6 +270,11 @@ cressi_goa_parser_get_field (dc_parser_t *abstract, dc_field_type_t type, unsign
 				return DC_STATUS_DATAFORMAT;
 			}
 			break;
+		case DC_FIELD_SAMPLE_INTERVAL:
+			// The profile contains time records that can skip ahead.
+			interval->interval = (divemode == FREEDIVE ? 2 : 5) * 1000;
+			interval->regular = 0;
+			break;
 		default:
 			return DC_STATUS_UNSUPPORTED;
 		}
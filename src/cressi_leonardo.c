@@ -29,10 +29,12 @@
 #include "checksum.h"
 #include "array.h"
 #include "ringbuffer.h"
+#include "rbstream.h"
 
 #define ISINSTANCE(device) dc_device_isinstance((device), &cressi_leonardo_device_vtable)
 
 #define SZ_MEMORY 32000
+#define SZ_CONFIG 0x68
 
 #define RB_LOGBOOK_BEGIN 0x0100
 #define RB_LOGBOOK_END   0x1438
@@ -45,6 +47,7 @@
 
 #define MAXRETRIES 4
 #define PACKETSIZE 32
+#define READAHEAD  4
 
 typedef struct cressi_leonardo_device_t {
 	dc_device_t base;
@@ -62,16 +65,15 @@ static const dc_device_vtable_t cressi_leonardo_device_vtable = {
 	DC_FAMILY_CRESSI_LEONARDO,
 	cressi_leonardo_device_set_fingerprint, /* set_fingerprint */
 	cressi_leonardo_device_read, /* read */
+	NULL, /* read_range */
 	NULL, /* write */
 	cressi_leonardo_device_dump, /* dump */
 	cressi_leonardo_device_foreach, /* foreach */
+	NULL, /* foreach_header */
 	NULL, /* timesync */
 	NULL /* close */
 };
 
-static dc_status_t
-cressi_leonardo_extract_dives (dc_device_t *abstract, const unsigned char data[], unsigned int size, dc_dive_callback_t callback, void *userdata);
-
 static void
 cressi_leonardo_make_ascii (const unsigned char raw[], unsigned int rsize, unsigned char ascii[], unsigned int asize)
 {
@@ -153,6 +155,8 @@ cressi_leonardo_transfer (cressi_leonardo_device_t *device, const unsigned char
 		if (nretries++ >= MAXRETRIES)
 			return rc;
 
+		device_stats_retry ((dc_device_t *) device);
+
 		// Discard any garbage bytes.
 		dc_iostream_sleep (device->iostream, 100);
 		dc_iostream_purge (device->iostream, DC_DIRECTION_INPUT);
@@ -389,9 +393,9 @@ cressi_leonardo_device_dump (dc_device_t *abstract, dc_buffer_t *buffer)
 }
 
 static dc_status_t
-cressi_leonardo_device_foreach (dc_device_t *abstract, dc_dive_callback_t callback, void *userdata)
+cressi_leonardo_device_foreach_dump (dc_device_t *abstract, dc_dive_callback_t callback, void *userdata)
 {
-	dc_buffer_t *buffer = dc_buffer_new (SZ_MEMORY);
+	dc_buffer_t *buffer = dc_buffer_new_context (abstract->context, SZ_MEMORY);
 	if (buffer == NULL)
 		return DC_STATUS_NOMEMORY;
 
@@ -410,6 +414,241 @@ cressi_leonardo_device_foreach (dc_device_t *abstract, dc_dive_callback_t callba
 }
 
 static dc_status_t
+cressi_leonardo_device_foreach (dc_device_t *abstract, dc_dive_callback_t callback, void *userdata)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	cressi_leonardo_device_t *device = (cressi_leonardo_device_t *) abstract;
+	dc_rbstream_t *logbook = NULL, *profile = NULL;
+	unsigned char *logbooks = NULL, *buffer = NULL;
+
+	// The read command returns only 32 bytes per round trip, hex encoded,
+	// while the memory dump streams the raw data. Without a fingerprint,
+	// all dives are downloaded, and the memory dump is much faster.
+	if (array_isequal (device->fingerprint, sizeof (device->fingerprint), 0))
+		return cressi_leonardo_device_foreach_dump (abstract, callback, userdata);
+
+	// Enable progress notifications.
+	dc_event_progress_t progress = EVENT_PROGRESS_INITIALIZER;
+	progress.maximum = SZ_CONFIG +
+		(RB_LOGBOOK_END - RB_LOGBOOK_BEGIN) +
+		(RB_PROFILE_END - RB_PROFILE_BEGIN);
+	device_event_emit (abstract, DC_EVENT_PROGRESS, &progress);
+
+	// Read the configuration data.
+	unsigned char config[SZ_CONFIG] = {0};
+	status = cressi_leonardo_device_read (abstract, 0, config, sizeof (config));
+	if (status != DC_STATUS_SUCCESS) {
+		ERROR (abstract->context, "Failed to read the configuration data.");
+		goto error_exit;
+	}
+
+	// Update and emit a progress event.
+	progress.current += sizeof (config);
+	device_event_emit (abstract, DC_EVENT_PROGRESS, &progress);
+
+	// Emit a device info event.
+	dc_event_devinfo_t devinfo;
+	devinfo.model = config[0];
+	devinfo.firmware = 0;
+	devinfo.serial = array_uint24_le (config + 1);
+	device_event_emit (abstract, DC_EVENT_DEVINFO, &devinfo);
+
+	// Get the logbook pointer.
+	unsigned int last = array_uint16_le (config + 0x64);
+	if (last < RB_LOGBOOK_BEGIN || last > RB_LOGBOOK_END ||
+		((last - RB_LOGBOOK_BEGIN) % RB_LOGBOOK_SIZE) != 0) {
+		ERROR (abstract->context, "Invalid logbook pointer (0x%04x).", last);
+		status = DC_STATUS_DATAFORMAT;
+		goto error_exit;
+	}
+
+	// Convert to an index.
+	unsigned int latest = (last - RB_LOGBOOK_BEGIN) / RB_LOGBOOK_SIZE;
+
+	// Get the profile pointer.
+	unsigned int eop = array_uint16_le (config + 0x66);
+	if (eop < RB_PROFILE_BEGIN || eop > RB_PROFILE_END) {
+		ERROR (abstract->context, "Invalid profile pointer (0x%04x).", eop);
+		status = DC_STATUS_DATAFORMAT;
+		goto error_exit;
+	}
+
+	// Memory buffer for the logbook entries.
+	logbooks = (unsigned char *) malloc (RB_LOGBOOK_END - RB_LOGBOOK_BEGIN);
+	if (logbooks == NULL) {
+		ERROR (abstract->context, "Failed to allocate memory.");
+		status = DC_STATUS_NOMEMORY;
+		goto error_exit;
+	}
+
+	// Create the ringbuffer stream for the logbook entries, starting
+	// at the end of the most recent entry.
+	status = dc_rbstream_new (&logbook, abstract, 1, PACKETSIZE, RB_LOGBOOK_BEGIN, RB_LOGBOOK_END,
+		RB_LOGBOOK_BEGIN + (latest % RB_LOGBOOK_COUNT + 1) * RB_LOGBOOK_SIZE);
+	if (status != DC_STATUS_SUCCESS) {
+		ERROR (abstract->context, "Failed to create the ringbuffer stream.");
+		goto error_free;
+	}
+
+	status = dc_rbstream_set_readahead (logbook, READAHEAD);
+	if (status != DC_STATUS_SUCCESS) {
+		ERROR (abstract->context, "Failed to enable the read ahead.");
+		goto error_free;
+	}
+
+	// Read the logbook entries, from the most recent one backwards, until
+	// an empty entry or the fingerprint is found. The total length of the
+	// profiles is limited by the size of the profile ringbuffer. An
+	// invalid entry is only reported after the newer dives have been
+	// downloaded, the same as with cressi_leonardo_extract_dives().
+	dc_status_t error = DC_STATUS_SUCCESS;
+	unsigned int count = 0;
+	unsigned int total = 0;
+	unsigned int previous = eop;
+	unsigned int remaining = RB_PROFILE_END - RB_PROFILE_BEGIN;
+	for (unsigned int i = 0; i < RB_LOGBOOK_COUNT; ++i) {
+		unsigned char *entry = logbooks + i * RB_LOGBOOK_SIZE;
+
+		status = dc_rbstream_read (logbook, &progress, entry, RB_LOGBOOK_SIZE);
+		if (status != DC_STATUS_SUCCESS) {
+			ERROR (abstract->context, "Failed to read the logbook entry.");
+			goto error_free;
+		}
+
+		// Ignore uninitialized header entries.
+		if (array_isequal (entry, RB_LOGBOOK_SIZE, 0xFF))
+			break;
+
+		// Get the ringbuffer pointers.
+		unsigned int header = array_uint16_le (entry + 2);
+		unsigned int footer = array_uint16_le (entry + 4);
+		if (header < RB_PROFILE_BEGIN || header + 2 > RB_PROFILE_END ||
+			footer < RB_PROFILE_BEGIN || footer + 2 > RB_PROFILE_END ||
+			RB_PROFILE_DISTANCE (header, footer) < 2)
+		{
+			ERROR (abstract->context, "Invalid ringbuffer pointer detected (0x%04x 0x%04x).", header, footer);
+			error = DC_STATUS_DATAFORMAT;
+			break;
+		}
+
+		if (previous && previous != footer + 2) {
+			ERROR (abstract->context, "Profiles are not continuous (0x%04x 0x%04x 0x%04x).", header, footer, previous);
+			error = DC_STATUS_DATAFORMAT;
+			break;
+		}
+
+		// Check the fingerprint data.
+		if (memcmp (entry + 8, device->fingerprint, sizeof (device->fingerprint)) == 0)
+			break;
+
+		// Check whether the profile data is still available.
+		unsigned int length = RB_PROFILE_DISTANCE (header, footer) - 2;
+		if (remaining && remaining >= length + 4) {
+			total += length + 4;
+			remaining -= length + 4;
+		} else {
+			remaining = 0;
+		}
+
+		previous = header;
+		count++;
+	}
+
+	dc_rbstream_free (logbook);
+	logbook = NULL;
+
+	// With a large part of the profile ringbuffer to download, the
+	// memory dump is faster than reading the profiles.
+	if (total > SZ_MEMORY / 4) {
+		free (logbooks);
+		return cressi_leonardo_device_foreach_dump (abstract, callback, userdata);
+	}
+
+	// Update and emit a progress event.
+	progress.maximum = progress.current + total;
+	device_event_emit (abstract, DC_EVENT_PROGRESS, &progress);
+
+	// Memory buffer for a single dive.
+	buffer = (unsigned char *) malloc (RB_LOGBOOK_SIZE + RB_PROFILE_END - RB_PROFILE_BEGIN);
+	if (buffer == NULL) {
+		ERROR (abstract->context, "Failed to allocate memory.");
+		status = DC_STATUS_NOMEMORY;
+		goto error_free;
+	}
+
+	// Create the ringbuffer stream for the profiles.
+	status = dc_rbstream_new (&profile, abstract, 1, PACKETSIZE, RB_PROFILE_BEGIN, RB_PROFILE_END, eop);
+	if (status != DC_STATUS_SUCCESS) {
+		ERROR (abstract->context, "Failed to create the ringbuffer stream.");
+		goto error_free;
+	}
+
+	status = dc_rbstream_set_readahead (profile, READAHEAD);
+	if (status != DC_STATUS_SUCCESS) {
+		ERROR (abstract->context, "Failed to enable the read ahead.");
+		goto error_free;
+	}
+
+	remaining = total;
+	for (unsigned int i = 0; i < count; ++i) {
+		const unsigned char *entry = logbooks + i * RB_LOGBOOK_SIZE;
+
+		unsigned int header = array_uint16_le (entry + 2);
+		unsigned int footer = array_uint16_le (entry + 4);
+
+		// Copy the logbook entry.
+		memcpy (buffer, entry, RB_LOGBOOK_SIZE);
+
+		// Read the profile, including the pointers at both ends.
+		unsigned int length = RB_PROFILE_DISTANCE (header, footer) - 2;
+		if (remaining >= length + 4) {
+			unsigned char *p = buffer + RB_LOGBOOK_SIZE - 2;
+			unsigned char tmp[2] = {buffer[RB_LOGBOOK_SIZE - 2], buffer[RB_LOGBOOK_SIZE - 1]};
+
+			status = dc_rbstream_read (profile, &progress, p, length + 4);
+			if (status != DC_STATUS_SUCCESS) {
+				ERROR (abstract->context, "Failed to read the dive.");
+				goto error_free;
+			}
+
+			// Get the same pointers from the profile.
+			unsigned int footer2 = array_uint16_le (p);
+			unsigned int header2 = array_uint16_le (p + length + 2);
+			if (header2 != header || footer2 != footer) {
+				ERROR (abstract->context, "Invalid ringbuffer pointer detected (0x%04x 0x%04x).", header2, footer2);
+				status = DC_STATUS_DATAFORMAT;
+				goto error_free;
+			}
+
+			// Restore the end of the logbook entry.
+			p[0] = tmp[0];
+			p[1] = tmp[1];
+
+			remaining -= length + 4;
+		} else {
+			// No more profile data available!
+			remaining = 0;
+			length = 0;
+		}
+
+		if (callback && !callback (buffer, RB_LOGBOOK_SIZE + length, buffer + 8, sizeof (device->fingerprint), userdata)) {
+			goto error_free;
+		}
+	}
+
+	// Report the invalid logbook entry, if any.
+	status = error;
+
+error_free:
+	dc_rbstream_free (profile);
+	dc_rbstream_free (logbook);
+	free (buffer);
+	free (logbooks);
+error_exit:
+	return status;
+}
+
+dc_status_t
 cressi_leonardo_extract_dives (dc_device_t *abstract, const unsigned char data[], unsigned int size, dc_dive_callback_t callback, void *userdata)
 {
 	cressi_leonardo_device_t *device = (cressi_leonardo_device_t *) abstract;
@@ -437,7 +676,7 @@ cressi_leonardo_extract_dives (dc_device_t *abstract, const unsigned char data[]
 
 	// Get the profile pointer.
 	unsigned int eop = array_uint16_le(data + 0x66);
-	if (eop < RB_PROFILE_BEGIN || last > RB_PROFILE_END) {
+	if (eop < RB_PROFILE_BEGIN || eop > RB_PROFILE_END) {
 		ERROR (context, "Invalid profile pointer (0x%04x).", eop);
 		return DC_STATUS_DATAFORMAT;
 	}
@@ -462,7 +701,8 @@ cressi_leonardo_extract_dives (dc_device_t *abstract, const unsigned char data[]
 		unsigned int header = array_uint16_le (data + offset + 2);
 		unsigned int footer = array_uint16_le (data + offset + 4);
 		if (header < RB_PROFILE_BEGIN || header + 2 > RB_PROFILE_END ||
-			footer < RB_PROFILE_BEGIN || footer + 2 > RB_PROFILE_END)
+			footer < RB_PROFILE_BEGIN || footer + 2 > RB_PROFILE_END ||
+			RB_PROFILE_DISTANCE (header, footer) < 2)
 		{
 			ERROR (context, "Invalid ringbuffer pointer detected (0x%04x 0x%04x).", header, footer);
 			free (buffer);
@@ -51,7 +51,13 @@ static const dc_parser_vtable_t cressi_leonardo_parser_vtable = {
 	NULL, /* set_density */
 	cressi_leonardo_parser_get_datetime, /* datetime */
 	cressi_leonardo_parser_get_field, /* fields */
+	NULL, /* summary */
 	cressi_leonardo_parser_samples_foreach, /* samples_foreach */
+	NULL, /* samples_batch */
+	NULL, /* samples_fixed */
+	NULL, /* samples_append */
+	NULL, /* samples_range */
+	NULL, /* reset */
 	NULL /* destroy */
 };
 
@@ -145,6 +151,11 @@ cressi_leonardo_parser_get_field (dc_parser_t *abstract, dc_field_type_t type, u
 		case DC_FIELD_TEMPERATURE_MINIMUM:
 			*((double *) value) = data[0x22];
 			break;
+		case DC_FIELD_SAMPLE_INTERVAL:
+			// Surface intervals in the profile are skipped over.
+			((dc_sample_interval_t *) value)->interval = interval * 1000;
+			((dc_sample_interval_t *) value)->regular = 0;
+			break;
 		default:
 			return DC_STATUS_UNSUPPORTED;
 		}
@@ -19,13 +19,27 @@
  * MA 02110-1301 USA
  */
 
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
 #include <stdlib.h> // malloc, free
+#include <string.h> // memcpy
 
 #include <libdivecomputer/custom.h>
 
 #include "iostream-private.h"
 #include "common-private.h"
 #include "context-private.h"
+#include "thread.h"
+#include "timer.h"
+#include "array.h"
+
+#define PUSH_CAPACITY 16384
+#define PUSH_HEADER   2
+
+// Interval (in milliseconds) to check for a cancellation while waiting.
+#define CANCEL_INTERVAL 100
 
 static dc_status_t dc_custom_set_timeout (dc_iostream_t *abstract, int timeout);
 static dc_status_t dc_custom_set_break (dc_iostream_t *abstract, unsigned int value);
@@ -37,6 +51,7 @@ static dc_status_t dc_custom_configure (dc_iostream_t *abstract, unsigned int ba
 static dc_status_t dc_custom_poll (dc_iostream_t *abstract, int timeout);
 static dc_status_t dc_custom_read (dc_iostream_t *abstract, void *data, size_t size, size_t *actual);
 static dc_status_t dc_custom_write (dc_iostream_t *abstract, const void *data, size_t size, size_t *actual);
+static dc_status_t dc_custom_writev (dc_iostream_t *abstract, const dc_iovec_t iov[], size_t count, size_t *actual);
 static dc_status_t dc_custom_ioctl (dc_iostream_t *abstract, unsigned int request, void *data, size_t size);
 static dc_status_t dc_custom_flush (dc_iostream_t *abstract);
 static dc_status_t dc_custom_purge (dc_iostream_t *abstract, dc_direction_t direction);
@@ -49,8 +64,18 @@ typedef struct dc_custom_t {
 	/* Internal state. */
 	dc_custom_cbs_t callbacks;
 	void *userdata;
+	/* Push mode. */
+	dc_mutex_t mutex;
+	dc_cond_t *cond;
+	unsigned char *buffer;
+	size_t head, count;
+	size_t remaining;
+	unsigned int packets;
+	int timeout;
 } dc_custom_t;
 
+static const dc_mutex_t mutex_init = DC_MUTEX_INIT;
+
 static const dc_iostream_vtable_t dc_custom_vtable = {
 	sizeof(dc_custom_t),
 	dc_custom_set_timeout, /* set_timeout */
@@ -63,16 +88,21 @@ static const dc_iostream_vtable_t dc_custom_vtable = {
 	dc_custom_poll, /* poll */
 	dc_custom_read, /* read */
 	dc_custom_write, /* write */
+	NULL, /* read_async */
+	NULL, /* write_async */
+	dc_custom_writev, /* writev */
 	dc_custom_ioctl, /* ioctl */
 	dc_custom_flush, /* flush */
 	dc_custom_purge, /* purge */
 	dc_custom_sleep, /* sleep */
+	NULL, /* set_interrupt */
 	dc_custom_close, /* close */
 };
 
 dc_status_t
 dc_custom_open (dc_iostream_t **out, dc_context_t *context, dc_transport_t transport, const dc_custom_cbs_t *callbacks, void *userdata)
 {
+	dc_status_t status = DC_STATUS_SUCCESS;
 	dc_custom_t *custom = NULL;
 
 	if (out == NULL || callbacks == NULL)
@@ -89,10 +119,209 @@ dc_custom_open (dc_iostream_t **out, dc_context_t *context, dc_transport_t trans
 
 	custom->callbacks = *callbacks;
 	custom->userdata = userdata;
+	custom->mutex = mutex_init;
+	custom->cond = NULL;
+	custom->buffer = NULL;
+	custom->head = 0;
+	custom->count = 0;
+	custom->remaining = 0;
+	custom->packets = (transport == DC_TRANSPORT_BLE || transport == DC_TRANSPORT_USBHID);
+	custom->timeout = -1;
+
+	// Without a read callback, the incoming data is pushed by the
+	// application with dc_custom_push.
+	if (callbacks->read == NULL) {
+		status = dc_cond_new (&custom->cond);
+		if (status != DC_STATUS_SUCCESS) {
+			ERROR (context, "Failed to create a condition variable.");
+			goto error_free;
+		}
+
+		custom->buffer = (unsigned char *) malloc (PUSH_CAPACITY);
+		if (custom->buffer == NULL) {
+			ERROR (context, "Failed to allocate memory.");
+			status = DC_STATUS_NOMEMORY;
+			goto error_cond_free;
+		}
+	}
 
 	*out = (dc_iostream_t *) custom;
 
 	return DC_STATUS_SUCCESS;
+
+error_cond_free:
+	dc_cond_free (custom->cond);
+error_free:
+	dc_iostream_deallocate ((dc_iostream_t *) custom);
+	return status;
+}
+
+static void
+dc_custom_put (dc_custom_t *custom, const unsigned char data[], size_t size)
+{
+	size_t tail = (custom->head + custom->count) % PUSH_CAPACITY;
+	size_t n = size;
+	if (n > PUSH_CAPACITY - tail)
+		n = PUSH_CAPACITY - tail;
+
+	memcpy (custom->buffer + tail, data, n);
+	memcpy (custom->buffer, data + n, size - n);
+	custom->count += size;
+}
+
+static void
+dc_custom_get (dc_custom_t *custom, unsigned char data[], size_t size)
+{
+	size_t n = size;
+	if (n > PUSH_CAPACITY - custom->head)
+		n = PUSH_CAPACITY - custom->head;
+
+	memcpy (data, custom->buffer + custom->head, n);
+	memcpy (data + n, custom->buffer, size - n);
+	custom->head = (custom->head + size) % PUSH_CAPACITY;
+	custom->count -= size;
+}
+
+dc_status_t
+dc_custom_push (dc_iostream_t *iostream, const void *data, size_t size)
+{
+	dc_custom_t *custom = (dc_custom_t *) iostream;
+
+	if (!dc_iostream_isinstance (iostream, &dc_custom_vtable))
+		return DC_STATUS_INVALIDARGS;
+
+	if (custom->buffer == NULL)
+		return DC_STATUS_UNSUPPORTED;
+
+	if (size == 0)
+		return DC_STATUS_SUCCESS;
+
+	if (data == NULL || (custom->packets && size > 0xFFFF))
+		return DC_STATUS_INVALIDARGS;
+
+	HEXDUMP (iostream->context, DC_LOGLEVEL_DEBUG, "Push", (const unsigned char *) data, size);
+
+	dc_mutex_lock (&custom->mutex);
+
+	size_t needed = size + (custom->packets ? PUSH_HEADER : 0);
+	if (needed > PUSH_CAPACITY - custom->count) {
+		dc_mutex_unlock (&custom->mutex);
+		ERROR (iostream->context, "Receive buffer overflow (%u bytes dropped).", (unsigned int) size);
+		return DC_STATUS_IO;
+	}
+
+	if (custom->packets) {
+		unsigned char header[PUSH_HEADER];
+		array_uint16_le_set (header, size);
+		dc_custom_put (custom, header, sizeof (header));
+	}
+
+	dc_custom_put (custom, (const unsigned char *) data, size);
+
+	dc_cond_signal (custom->cond);
+
+	dc_mutex_unlock (&custom->mutex);
+
+	return DC_STATUS_SUCCESS;
+}
+
+/*
+ * Wait for more data until the absolute target time. Must be called
+ * with the mutex locked. With a cancellation event, the wait is split
+ * into short slices, to check the event in between.
+ */
+static dc_status_t
+dc_custom_wait (dc_custom_t *custom, int timeout, dc_nsecs_t target)
+{
+	dc_interrupt_t *interrupt = custom->base.interrupt;
+
+	if (dc_interrupt_isset (interrupt))
+		return DC_STATUS_CANCELLED;
+
+	if (timeout < 0) {
+		if (interrupt)
+			dc_cond_timedwait (custom->cond, &custom->mutex, CANCEL_INTERVAL);
+		else
+			dc_cond_wait (custom->cond, &custom->mutex);
+		return DC_STATUS_SUCCESS;
+	}
+
+	dc_nsecs_t now = dc_clock_now ();
+	if (timeout == 0 || now >= target)
+		return DC_STATUS_TIMEOUT;
+
+	// Round up, to never wake up before the target time.
+	unsigned int remaining = (target - now + 999999) / 1000000;
+	if (interrupt && remaining > CANCEL_INTERVAL)
+		remaining = CANCEL_INTERVAL;
+
+	dc_cond_timedwait (custom->cond, &custom->mutex, remaining);
+
+	return DC_STATUS_SUCCESS;
+}
+
+static dc_nsecs_t
+dc_custom_target (int timeout)
+{
+	if (timeout <= 0)
+		return 0;
+
+	return dc_clock_now () + (dc_nsecs_t) timeout * 1000000;
+}
+
+/*
+ * In packet mode, a read returns the data of a single packet. If the
+ * packet doesn't fit, the remainder is returned by the next read.
+ */
+static dc_status_t
+dc_custom_push_read (dc_custom_t *custom, unsigned char data[], size_t size, size_t *actual)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	size_t nbytes = 0;
+
+	dc_mutex_lock (&custom->mutex);
+
+	int timeout = custom->timeout;
+	dc_nsecs_t target = dc_custom_target (timeout);
+
+	while (nbytes < size) {
+		if (custom->count == 0) {
+			status = dc_custom_wait (custom, timeout, target);
+			if (status != DC_STATUS_SUCCESS)
+				break;
+			continue;
+		}
+
+		if (custom->packets && custom->remaining == 0) {
+			unsigned char header[PUSH_HEADER];
+			dc_custom_get (custom, header, sizeof (header));
+			custom->remaining = array_uint16_le (header);
+		}
+
+		size_t n = size - nbytes;
+		if (custom->packets) {
+			if (n > custom->remaining)
+				n = custom->remaining;
+		} else {
+			if (n > custom->count)
+				n = custom->count;
+		}
+
+		dc_custom_get (custom, data + nbytes, n);
+		nbytes += n;
+
+		if (custom->packets) {
+			custom->remaining -= n;
+			break;
+		}
+	}
+
+	dc_mutex_unlock (&custom->mutex);
+
+	if (actual)
+		*actual = nbytes;
+
+	return status;
 }
 
 static dc_status_t
@@ -100,6 +329,12 @@ dc_custom_set_timeout (dc_iostream_t *abstract, int timeout)
 {
 	dc_custom_t *custom = (dc_custom_t *) abstract;
 
+	if (custom->buffer) {
+		dc_mutex_lock (&custom->mutex);
+		custom->timeout = timeout;
+		dc_mutex_unlock (&custom->mutex);
+	}
+
 	if (custom->callbacks.set_timeout == NULL)
 		return DC_STATUS_SUCCESS;
 
@@ -155,6 +390,24 @@ dc_custom_get_available (dc_iostream_t *abstract, size_t *value)
 {
 	dc_custom_t *custom = (dc_custom_t *) abstract;
 
+	if (custom->buffer) {
+		dc_mutex_lock (&custom->mutex);
+		if (custom->packets && custom->remaining == 0 && custom->count) {
+			size_t offset = custom->head;
+			unsigned char header[PUSH_HEADER];
+			for (unsigned int i = 0; i < PUSH_HEADER; ++i) {
+				header[i] = custom->buffer[(offset + i) % PUSH_CAPACITY];
+			}
+			*value = array_uint16_le (header);
+		} else if (custom->packets) {
+			*value = custom->remaining;
+		} else {
+			*value = custom->count;
+		}
+		dc_mutex_unlock (&custom->mutex);
+		return DC_STATUS_SUCCESS;
+	}
+
 	if (custom->callbacks.get_available == NULL)
 		return DC_STATUS_SUCCESS;
 
@@ -177,6 +430,17 @@ dc_custom_poll (dc_iostream_t *abstract, int timeout)
 {
 	dc_custom_t *custom = (dc_custom_t *) abstract;
 
+	if (custom->buffer) {
+		dc_status_t status = DC_STATUS_SUCCESS;
+		dc_nsecs_t target = dc_custom_target (timeout);
+		dc_mutex_lock (&custom->mutex);
+		while (custom->count == 0 && status == DC_STATUS_SUCCESS) {
+			status = dc_custom_wait (custom, timeout, target);
+		}
+		dc_mutex_unlock (&custom->mutex);
+		return status;
+	}
+
 	if (custom->callbacks.poll == NULL)
 		return DC_STATUS_SUCCESS;
 
@@ -188,6 +452,14 @@ dc_custom_read (dc_iostream_t *abstract, void *data, size_t size, size_t *actual
 {
 	dc_custom_t *custom = (dc_custom_t *) abstract;
 
+	if (custom->buffer)
+		return dc_custom_push_read (custom, (unsigned char *) data, size, actual);
+
+	// The callbacks can't be interrupted, but a cancelled download
+	// shouldn't start another read.
+	if (dc_interrupt_isset (abstract->interrupt))
+		return DC_STATUS_CANCELLED;
+
 	if (custom->callbacks.read == NULL)
 		return DC_STATUS_SUCCESS;
 
@@ -205,6 +477,41 @@ dc_custom_write (dc_iostream_t *abstract, const void *data, size_t size, size_t
 	return custom->callbacks.write (custom->userdata, data, size, actual);
 }
 
+static dc_status_t
+dc_custom_writev (dc_iostream_t *abstract, const dc_iovec_t iov[], size_t count, size_t *actual)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	dc_custom_t *custom = (dc_custom_t *) abstract;
+	size_t nbytes = 0;
+
+	if (custom->callbacks.writev)
+		return custom->callbacks.writev (custom->userdata, iov, count, actual);
+
+	for (size_t i = 0; i < count; ++i) {
+		size_t offset = 0;
+		while (offset < iov[i].size) {
+			size_t n = 0;
+			status = dc_custom_write (abstract, (const unsigned char *) iov[i].data + offset, iov[i].size - offset, &n);
+			if (status != DC_STATUS_SUCCESS)
+				goto out;
+
+			if (n == 0) {
+				status = DC_STATUS_IO;
+				goto out;
+			}
+
+			offset += n;
+			nbytes += n;
+		}
+	}
+
+out:
+	if (actual)
+		*actual = nbytes;
+
+	return status;
+}
+
 static dc_status_t
 dc_custom_ioctl (dc_iostream_t *abstract, unsigned int request, void *data, size_t size)
 {
@@ -232,6 +539,14 @@ dc_custom_purge (dc_iostream_t *abstract, dc_direction_t direction)
 {
 	dc_custom_t *custom = (dc_custom_t *) abstract;
 
+	if (custom->buffer && (direction & DC_DIRECTION_INPUT)) {
+		dc_mutex_lock (&custom->mutex);
+		custom->head = 0;
+		custom->count = 0;
+		custom->remaining = 0;
+		dc_mutex_unlock (&custom->mutex);
+	}
+
 	if (custom->callbacks.purge == NULL)
 		return DC_STATUS_SUCCESS;
 
@@ -243,6 +558,9 @@ dc_custom_sleep (dc_iostream_t *abstract, unsigned int milliseconds)
 {
 	dc_custom_t *custom = (dc_custom_t *) abstract;
 
+	if (dc_interrupt_isset (abstract->interrupt))
+		return DC_STATUS_CANCELLED;
+
 	if (custom->callbacks.sleep == NULL)
 		return DC_STATUS_SUCCESS;
 
@@ -254,6 +572,9 @@ dc_custom_close (dc_iostream_t *abstract)
 {
 	dc_custom_t *custom = (dc_custom_t *) abstract;
 
+	free (custom->buffer);
+	dc_cond_free (custom->cond);
+
 	if (custom->callbacks.close == NULL)
 		return DC_STATUS_SUCCESS;
 
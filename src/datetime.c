@@ -44,53 +44,57 @@ dc_localtime_r (const time_t *t, struct tm *tm)
 #endif
 }
 
-static struct tm *
-dc_gmtime_r (const time_t *t, struct tm *tm)
-{
-#ifdef HAVE_GMTIME_R
-	return gmtime_r (t, tm);
-#else
-	struct tm *p = gmtime (t);
-	if (p == NULL)
-		return NULL;
+/*
+ * Convert between a civil date (proleptic Gregorian calendar) and the
+ * number of days since 1970-01-01, using pure integer arithmetic. The
+ * calculations are done in 400 year eras, starting on March 1st, such
+ * that the leap day is always the last day of the year.
+ */
 
-	if (tm)
-		*tm = *p;
+static dc_ticks_t
+dc_days_from_civil (dc_ticks_t year, unsigned int month, unsigned int day)
+{
+	year -= (month <= 2);
+	dc_ticks_t era = (year >= 0 ? year : year - 399) / 400;
+	unsigned int yoe = (unsigned int) (year - era * 400);
+	unsigned int doy = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+	unsigned int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+	return era * 146097 + (dc_ticks_t) doe - 719468;
+}
 
-	return tm;
-#endif
+static void
+dc_civil_from_days (dc_ticks_t days, dc_ticks_t *year, unsigned int *month, unsigned int *day)
+{
+	days += 719468;
+	dc_ticks_t era = (days >= 0 ? days : days - 146096) / 146097;
+	unsigned int doe = (unsigned int) (days - era * 146097);
+	unsigned int yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+	unsigned int doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+	unsigned int mp = (5 * doy + 2) / 153;
+	unsigned int m = mp < 10 ? mp + 3 : mp - 9;
+
+	*year = (dc_ticks_t) yoe + era * 400 + (m <= 2);
+	*month = m;
+	*day = doy - (153 * mp + 2) / 5 + 1;
 }
 
 static time_t
 dc_timegm (struct tm *tm)
 {
-#if defined(HAVE_TIMEGM)
-	return timegm (tm);
-#elif defined (HAVE__MKGMTIME)
-	return _mkgmtime (tm);
-#else
-	static const unsigned int mdays[] = {
-		0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334
-	};
-
-	if (tm == NULL ||
-		tm->tm_mon  < 0 || tm->tm_mon  > 11 ||
-		tm->tm_mday < 1 || tm->tm_mday > 31 ||
-		tm->tm_hour < 0 || tm->tm_hour > 23 ||
-		tm->tm_min  < 0 || tm->tm_min  > 59 ||
-		tm->tm_sec  < 0 || tm->tm_sec  > 60)
+	if (tm == NULL)
 		return (time_t) -1;
 
-	/* Number of leap days since 1970-01-01. */
-	int year = tm->tm_year + 1900 - (tm->tm_mon < 2);
-	int leapdays =
-		((year / 4) - (year / 100) + (year / 400)) -
-		((1969 / 4) - (1969 / 100) + (1969 / 400));
+	/* Normalize the month, like timegm() does. */
+	dc_ticks_t year = (dc_ticks_t) tm->tm_year + 1900;
+	int month = tm->tm_mon;
+	year += month / 12;
+	month %= 12;
+	if (month < 0) {
+		month += 12;
+		year--;
+	}
 
-	time_t result = 0;
-	result += (tm->tm_year - 70) * 365;
-	result += leapdays;
-	result += mdays[tm->tm_mon];
+	dc_ticks_t result = dc_days_from_civil (year, month + 1, 1);
 	result += tm->tm_mday - 1;
 	result *= 24;
 	result += tm->tm_hour;
@@ -99,7 +103,6 @@ dc_timegm (struct tm *tm)
 	result *= 60;
 	result += tm->tm_sec;
 	return result;
-#endif
 }
 
 dc_ticks_t
@@ -147,19 +150,26 @@ dc_datetime_t *
 dc_datetime_gmtime (dc_datetime_t *result,
                     dc_ticks_t ticks)
 {
-	time_t t = ticks;
+	dc_ticks_t days = ticks / 86400;
+	dc_ticks_t seconds = ticks % 86400;
+	if (seconds < 0) {
+		seconds += 86400;
+		days--;
+	}
 
-	struct tm tm;
-	if (dc_gmtime_r (&t, &tm) == NULL)
+	dc_ticks_t year = 0;
+	unsigned int month = 0, day = 0;
+	dc_civil_from_days (days, &year, &month, &day);
+	if (year < -2147483647 || year > 2147483647)
 		return NULL;
 
 	if (result) {
-		result->year = tm.tm_year + 1900;
-		result->month = tm.tm_mon + 1;
-		result->day = tm.tm_mday;
-		result->hour = tm.tm_hour;
-		result->minute = tm.tm_min;
-		result->second = tm.tm_sec;
+		result->year = year;
+		result->month = month;
+		result->day = day;
+		result->hour = seconds / 3600;
+		result->minute = (seconds % 3600) / 60;
+		result->second = seconds % 60;
 		result->timezone = 0;
 	}
 
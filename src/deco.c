@@ -0,0 +1,297 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2026 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+#include <string.h>
+#include <math.h>
+
+#include <libdivecomputer/units.h>
+
+#include "deco.h"
+
+#define LN2         0.69314718055994530942
+#define WATERVAPOUR 0.0627 /* bar */
+#define N2_AIR      0.79
+
+#define STOPSTEP    3.0  /* meters */
+#define ASCENTRATE  10.0 /* meters per minute */
+#define WAITTIME    60   /* seconds */
+#define MAXTTS      (1000 * 60 * 1000) /* milliseconds */
+
+#define NC DC_DECO_COMPARTMENTS
+
+static const double n2_halftime[NC] = {
+	5.0, 8.0, 12.5, 18.5, 27.0, 38.3, 54.3, 77.0,
+	109.0, 146.0, 187.0, 239.0, 305.0, 390.0, 498.0, 635.0};
+static const double n2_a[NC] = {
+	1.1696, 1.0, 0.8618, 0.7562, 0.62, 0.5043, 0.441, 0.4,
+	0.375, 0.35, 0.3295, 0.3065, 0.2835, 0.261, 0.248, 0.2327};
+static const double n2_b[NC] = {
+	0.5578, 0.6514, 0.7222, 0.7825, 0.8126, 0.8434, 0.8693, 0.891,
+	0.9092, 0.9222, 0.9319, 0.9403, 0.9477, 0.9544, 0.9602, 0.9653};
+
+static const double he_halftime[NC] = {
+	1.88, 3.02, 4.72, 6.99, 10.21, 14.48, 20.53, 29.11,
+	41.2, 55.19, 70.69, 90.34, 115.29, 147.42, 188.24, 240.03};
+static const double he_a[NC] = {
+	1.6189, 1.383, 1.1919, 1.0458, 0.922, 0.8205, 0.7305, 0.6502,
+	0.595, 0.5545, 0.5333, 0.5189, 0.5181, 0.5176, 0.5172, 0.5119};
+static const double he_b[NC] = {
+	0.477, 0.5747, 0.6527, 0.7223, 0.7582, 0.7957, 0.8279, 0.8553,
+	0.8757, 0.8903, 0.8997, 0.9073, 0.9122, 0.9171, 0.9217, 0.9267};
+
+
+static double
+dc_deco_pressure (const dc_deco_t *deco, double depth)
+{
+	return deco->surface + depth * deco->barpermeter;
+}
+
+
+static const dc_deco_factors_t *
+dc_deco_factors (dc_deco_t *deco, unsigned int duration)
+{
+	for (unsigned int i = 0; i < DC_DECO_CACHE; ++i) {
+		if (deco->cache[i].duration == duration)
+			return deco->cache + i;
+	}
+
+	dc_deco_factors_t *factors = deco->cache + deco->next;
+	deco->next = (deco->next + 1) % DC_DECO_CACHE;
+
+	double minutes = duration / 60000.0;
+	for (unsigned int i = 0; i < NC; ++i) {
+		factors->n2[i] = exp (-minutes * LN2 / n2_halftime[i]);
+		factors->he[i] = exp (-minutes * LN2 / he_halftime[i]);
+	}
+	factors->duration = duration;
+
+	return factors;
+}
+
+
+/*
+ * Schreiner equation, for an inspired pressure that starts at 'pi' and
+ * changes with 'rate' bar per minute.
+ */
+static void
+dc_deco_schreiner (double tissue[], const double halftime[], const double factor[], double pi, double rate, double minutes)
+{
+	for (unsigned int i = 0; i < NC; ++i) {
+		double tau = halftime[i] * (1.0 / LN2);
+		tissue[i] = pi + rate * (minutes - tau) - (pi - tissue[i] - rate * tau) * factor[i];
+	}
+}
+
+
+static void
+dc_deco_load (dc_deco_t *deco, double n2[], double he[], double depth1, double depth2, unsigned int duration, const dc_gasmix_t *gasmix)
+{
+	if (duration == 0)
+		return;
+
+	double fhe = gasmix->helium;
+	double fn2 = 1.0 - gasmix->oxygen - gasmix->helium;
+	if (fn2 < 0.0)
+		fn2 = 0.0;
+
+	double p1 = dc_deco_pressure (deco, depth1) - WATERVAPOUR;
+	double p2 = dc_deco_pressure (deco, depth2) - WATERVAPOUR;
+	if (p1 < 0.0)
+		p1 = 0.0;
+	if (p2 < 0.0)
+		p2 = 0.0;
+
+	double minutes = duration / 60000.0;
+	double rate = (p2 - p1) / minutes;
+
+	const dc_deco_factors_t *factors = dc_deco_factors (deco, duration);
+	dc_deco_schreiner (n2, n2_halftime, factors->n2, p1 * fn2, rate * fn2, minutes);
+	dc_deco_schreiner (he, he_halftime, factors->he, p1 * fhe, rate * fhe, minutes);
+}
+
+
+/*
+ * Get the depth of the ceiling for a fixed gradient factor.
+ */
+static double
+dc_deco_ceiling_gf (const dc_deco_t *deco, const double n2[], const double he[], double gf)
+{
+	double tolerated[NC];
+
+	for (unsigned int i = 0; i < NC; ++i) {
+		double p = n2[i] + he[i];
+		double a = (n2_a[i] * n2[i] + he_a[i] * he[i]) / p;
+		double b = (n2_b[i] * n2[i] + he_b[i] * he[i]) / p;
+		tolerated[i] = (p - a * gf) / (gf / b + 1.0 - gf);
+	}
+
+	double maximum = 0.0;
+	for (unsigned int i = 0; i < NC; ++i) {
+		if (tolerated[i] > maximum)
+			maximum = tolerated[i];
+	}
+
+	double depth = (maximum - deco->surface) / deco->barpermeter;
+	if (depth < 0.0)
+		depth = 0.0;
+
+	return depth;
+}
+
+
+static double
+dc_deco_gf (const dc_deco_t *deco, double anchor, double depth)
+{
+	if (anchor <= 0.0)
+		return deco->gfhigh;
+	if (depth >= anchor)
+		return deco->gflow;
+
+	return deco->gfhigh + (deco->gflow - deco->gfhigh) * depth / anchor;
+}
+
+
+static int
+dc_deco_allowed (const dc_deco_t *deco, const double n2[], const double he[], double anchor, double depth)
+{
+	return dc_deco_ceiling_gf (deco, n2, he, dc_deco_gf (deco, anchor, depth)) <= depth;
+}
+
+
+void
+dc_deco_init (dc_deco_t *deco, double surface, double density, double gflow, double gfhigh)
+{
+	memset (deco, 0, sizeof (*deco));
+
+	for (unsigned int i = 0; i < NC; ++i) {
+		deco->n2[i] = (surface - WATERVAPOUR) * N2_AIR;
+		deco->he[i] = 0.0;
+	}
+
+	deco->surface = surface;
+	deco->barpermeter = density * GRAVITY / BAR;
+	deco->gflow = gflow;
+	deco->gfhigh = gfhigh;
+	deco->anchor = 0.0;
+}
+
+
+void
+dc_deco_update (dc_deco_t *deco, double depth1, double depth2, unsigned int duration, const dc_gasmix_t *gasmix)
+{
+	dc_deco_load (deco, deco->n2, deco->he, depth1, depth2, duration, gasmix);
+}
+
+
+double
+dc_deco_ceiling (dc_deco_t *deco)
+{
+	double low = dc_deco_ceiling_gf (deco, deco->n2, deco->he, deco->gflow);
+	if (low > deco->anchor)
+		deco->anchor = low;
+
+	if (dc_deco_ceiling_gf (deco, deco->n2, deco->he, deco->gfhigh) <= 0.0)
+		return 0.0;
+
+	// The ceiling is the depth where it equals the ceiling for its own
+	// gradient factor. It's located between the surface and the anchor.
+	double lo = 0.0, hi = deco->anchor;
+	for (unsigned int i = 0; i < 16; ++i) {
+		double mid = (lo + hi) / 2.0;
+		if (dc_deco_allowed (deco, deco->n2, deco->he, deco->anchor, mid))
+			hi = mid;
+		else
+			lo = mid;
+	}
+
+	return hi;
+}
+
+
+unsigned int
+dc_deco_ndl (dc_deco_t *deco, double depth, const dc_gasmix_t *gasmix, unsigned int limit)
+{
+	double n2[NC], he[NC];
+
+	memcpy (n2, deco->n2, sizeof (n2));
+	memcpy (he, deco->he, sizeof (he));
+
+	if (dc_deco_ceiling_gf (deco, n2, he, deco->gfhigh) > 0.0)
+		return 0;
+
+	unsigned int ndl = 0;
+	while (ndl < limit) {
+		dc_deco_load (deco, n2, he, depth, depth, WAITTIME * 1000, gasmix);
+		if (dc_deco_ceiling_gf (deco, n2, he, deco->gfhigh) > 0.0)
+			break;
+		ndl += WAITTIME;
+	}
+
+	if (ndl > limit)
+		ndl = limit;
+
+	return ndl;
+}
+
+
+unsigned int
+dc_deco_tts (dc_deco_t *deco, double depth, const dc_gasmix_t *gasmix, double *stopdepth, unsigned int *stoptime)
+{
+	double n2[NC], he[NC];
+
+	memcpy (n2, deco->n2, sizeof (n2));
+	memcpy (he, deco->he, sizeof (he));
+
+	double anchor = dc_deco_ceiling_gf (deco, n2, he, deco->gflow);
+	if (anchor < deco->anchor)
+		anchor = deco->anchor;
+
+	*stopdepth = 0.0;
+	*stoptime = 0;
+
+	unsigned int tts = 0;
+	double current = depth;
+	while (current > 0.0 && tts < MAXTTS) {
+		// The next stop is the first multiple of the stop step that is
+		// shallower than the current depth.
+		double next = ceil (current / STOPSTEP - 1.0) * STOPSTEP;
+		if (next < 0.0)
+			next = 0.0;
+
+		if (dc_deco_allowed (deco, n2, he, anchor, next)) {
+			unsigned int duration = (unsigned int) ((current - next) * 60000.0 / ASCENTRATE + 0.5);
+			dc_deco_load (deco, n2, he, current, next, duration, gasmix);
+			tts += duration;
+			current = next;
+			continue;
+		}
+
+		if (*stoptime == 0 || *stopdepth == current) {
+			*stopdepth = current;
+			*stoptime += WAITTIME;
+		}
+
+		dc_deco_load (deco, n2, he, current, current, WAITTIME * 1000, gasmix);
+		tts += WAITTIME * 1000;
+	}
+
+	return tts / 1000;
+}
@@ -0,0 +1,102 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2026 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+#ifndef DC_DECO_H
+#define DC_DECO_H
+
+#include <libdivecomputer/parser.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#define DC_DECO_COMPARTMENTS 16
+#define DC_DECO_CACHE        4
+
+/*
+ * Exponential decay factors for a segment length, shared by all the
+ * tissue updates with the same duration.
+ */
+typedef struct dc_deco_factors_t {
+	unsigned int duration;
+	double n2[DC_DECO_COMPARTMENTS];
+	double he[DC_DECO_COMPARTMENTS];
+} dc_deco_factors_t;
+
+/*
+ * Buhlmann ZHL-16C tissue state with gradient factors.
+ *
+ * The inert gas loadings are kept as separate arrays per gas, such
+ * that the per compartment loops can be vectorized by the compiler.
+ * Depths are in meters and pressures in bar.
+ */
+typedef struct dc_deco_t {
+	double n2[DC_DECO_COMPARTMENTS];
+	double he[DC_DECO_COMPARTMENTS];
+	double surface;
+	double barpermeter;
+	double gflow, gfhigh;
+	double anchor; /* Deepest ceiling at the low gradient factor. */
+	dc_deco_factors_t cache[DC_DECO_CACHE];
+	unsigned int next;
+} dc_deco_t;
+
+/*
+ * Initialize the tissues, saturated with air at the surface. The
+ * gradient factors are fractions, and the density of the water is in
+ * kg/m³.
+ */
+void
+dc_deco_init (dc_deco_t *deco, double surface, double density, double gflow, double gfhigh);
+
+/*
+ * Load the tissues for a linear change in depth over 'duration'
+ * milliseconds, breathing the gas mix.
+ */
+void
+dc_deco_update (dc_deco_t *deco, double depth1, double depth2, unsigned int duration, const dc_gasmix_t *gasmix);
+
+/*
+ * Get the current ceiling, with the gradient factor interpolated
+ * between the deepest first stop and the surface.
+ */
+double
+dc_deco_ceiling (dc_deco_t *deco);
+
+/*
+ * Get the no decompression limit in seconds at the depth, or zero if
+ * there is a ceiling. The result is capped at 'limit' seconds.
+ */
+unsigned int
+dc_deco_ndl (dc_deco_t *deco, double depth, const dc_gasmix_t *gasmix, unsigned int limit);
+
+/*
+ * Get the time to surface in seconds from the depth, staying on the gas
+ * mix, with stops every 3 meters. The depth and duration of the first
+ * stop are returned, both are zero without stops.
+ */
+unsigned int
+dc_deco_tts (dc_deco_t *deco, double depth, const dc_gasmix_t *gasmix, double *stopdepth, unsigned int *stoptime);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+#endif /* DC_DECO_H */
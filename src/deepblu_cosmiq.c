@@ -78,9 +78,11 @@ static const dc_device_vtable_t deepblu_cosmiq_device_vtable = {
 	DC_FAMILY_DEEPBLU_COSMIQ,
 	deepblu_cosmiq_device_set_fingerprint, /* set_fingerprint */
 	NULL, /* read */
+	NULL, /* read_range */
 	NULL, /* write */
 	NULL, /* dump */
 	deepblu_cosmiq_device_foreach, /* foreach */
+	NULL, /* foreach_header */
 	deepblu_cosmiq_device_timesync, /* timesync */
 	NULL, /* close */
 };
@@ -222,44 +224,46 @@ deepblu_cosmiq_recv (deepblu_cosmiq_device_t *device, const unsigned char cmd, u
 		return DC_STATUS_PROTOCOL;
 	}
 
-	size_t length = transferred - 2;
+	size_t length = (transferred - 2) / 2 - 3;
 
-	unsigned char raw[3 + MAX_DATA] = {0};
-	if (array_convert_hex2bin (packet + 1, length, raw, length / 2) != 0) {
+	// Decode the header, and the payload straight into the
+	// output buffer, once its length is known to fit.
+	unsigned char header[3] = {0};
+	if (array_convert_hex2bin (packet + 1, 2 * sizeof(header), header, sizeof(header)) != 0) {
 		ERROR (device->base.context, "Unexpected packet data.");
 		return DC_STATUS_PROTOCOL;
 	}
 
-	length /= 2;
-
-	HEXDUMP (device->base.context, DC_LOGLEVEL_DEBUG, "rcv", raw, length);
-
-	unsigned char rsp = raw[0];
+	unsigned char rsp = header[0];
 	if (rsp != cmd) {
 		ERROR (device->base.context, "Unexpected packet command byte (%02x)", rsp);
 		return DC_STATUS_PROTOCOL;
 	}
 
-	unsigned int n = raw[2];
+	unsigned int n = header[2];
 	if ((n % 2) != 0 || n != transferred - 8) {
 		ERROR (device->base.context, "Unexpected packet length (%u)", n);
 		return DC_STATUS_PROTOCOL;
 	}
 
-	unsigned char csum = checksum_add_uint8 (raw, length, 0);
-	if (csum != 0) {
-		ERROR (device->base.context, "Unexpected packet checksum (%02x).", csum);
+	if (length > size) {
+		ERROR (device->base.context, "Unexpected number of bytes received (" DC_PRINTF_SIZE " " DC_PRINTF_SIZE ").", length, size);
 		return DC_STATUS_PROTOCOL;
 	}
 
-	length -= 3;
-
-	if (length > size) {
-		ERROR (device->base.context, "Unexpected number of bytes received (" DC_PRINTF_SIZE " " DC_PRINTF_SIZE ").", length, size);
+	if (array_convert_hex2bin (packet + 7, 2 * length, data, length) != 0) {
+		ERROR (device->base.context, "Unexpected packet data.");
 		return DC_STATUS_PROTOCOL;
 	}
 
-	memcpy (data, raw + 3, length);
+	HEXDUMP (device->base.context, DC_LOGLEVEL_DEBUG, "rcv", header, sizeof(header));
+	HEXDUMP (device->base.context, DC_LOGLEVEL_DEBUG, "rcv", data, length);
+
+	unsigned char csum = checksum_add_uint8 (data, length, checksum_add_uint8 (header, sizeof(header), 0));
+	if (csum != 0) {
+		ERROR (device->base.context, "Unexpected packet checksum (%02x).", csum);
+		return DC_STATUS_PROTOCOL;
+	}
 
 	if (actual)
 		*actual = length;
@@ -468,7 +472,7 @@ deepblu_cosmiq_device_foreach (dc_device_t *abstract, dc_dive_callback_t callbac
 	device_event_emit (abstract, DC_EVENT_PROGRESS, &progress);
 
 	// Allocate memory for the dive.
-	dc_buffer_t *dive = dc_buffer_new (4096);
+	dc_buffer_t *dive = dc_buffer_new_context (abstract->context, 4096);
 	if (dive == NULL) {
 		ERROR (abstract->context, "Failed to allocate memory.");
 		status = DC_STATUS_NOMEMORY;
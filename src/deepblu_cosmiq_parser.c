@@ -54,7 +54,13 @@ static const dc_parser_vtable_t deepblu_cosmiq_parser_vtable = {
 	deepblu_cosmiq_parser_set_density, /* set_density */
 	deepblu_cosmiq_parser_get_datetime, /* datetime */
 	deepblu_cosmiq_parser_get_field, /* fields */
+	NULL, /* summary */
 	deepblu_cosmiq_parser_samples_foreach, /* samples_foreach */
+	NULL, /* samples_batch */
+	NULL, /* samples_fixed */
+	NULL, /* samples_append */
+	NULL, /* samples_range */
+	NULL, /* reset */
 	NULL /* destroy */
 };
 
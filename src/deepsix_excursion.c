@@ -80,9 +80,11 @@ static const dc_device_vtable_t deepsix_excursion_device_vtable = {
 	DC_FAMILY_DEEPSIX_EXCURSION,
 	deepsix_excursion_device_set_fingerprint, /* set_fingerprint */
 	NULL, /* read */
+	NULL, /* read_range */
 	NULL, /* write */
 	NULL, /* dump */
 	deepsix_excursion_device_foreach, /* foreach */
+	NULL, /* foreach_header */
 	deepsix_excursion_device_timesync, /* timesync */
 	NULL, /* close */
 };
@@ -195,6 +197,20 @@ deepsix_excursion_transfer (deepsix_excursion_device_t *device, unsigned char gr
 	return status;
 }
 
+static dc_status_t
+deepsix_excursion_request_profile (deepsix_excursion_device_t *device, unsigned int number, unsigned int offset)
+{
+	const unsigned char cmd_profile[] = {
+		(number      ) & 0xFF,
+		(number >>  8) & 0xFF,
+		(offset      ) & 0xFF,
+		(offset >>  8) & 0xFF,
+		(offset >> 16) & 0xFF,
+		(offset >> 24) & 0xFF};
+
+	return deepsix_excursion_send (device, GRP_DIVE, CMD_DIVE_PROFILE, DIR_READ, cmd_profile, sizeof(cmd_profile));
+}
+
 dc_status_t
 deepsix_excursion_device_open (dc_device_t **out, dc_context_t *context, dc_iostream_t *iostream)
 {
@@ -410,30 +426,53 @@ deepsix_excursion_device_foreach (dc_device_t *abstract, dc_dive_callback_t call
 			goto error_free;
 		}
 
-		unsigned offset = 0;
+		// Request the first profile packet.
+		unsigned int offset = 0, requested = 0, chunk = 0;
+		if (length) {
+			status = deepsix_excursion_request_profile (device, number, requested);
+			if (status != DC_STATUS_SUCCESS) {
+				ERROR (abstract->context, "Failed to read the dive profile.");
+				goto error_free;
+			}
+		}
+
 		while (offset < length) {
 			unsigned int len = 0;
-			const unsigned char cmd_profile[] = {
-				(number      ) & 0xFF,
-				(number >>  8) & 0xFF,
-				(offset      ) & 0xFF,
-				(offset >>  8) & 0xFF,
-				(offset >> 16) & 0xFF,
-				(offset >> 24) & 0xFF};
 			unsigned char rsp_profile[MAXPACKET] = {0};
-			status = deepsix_excursion_transfer (device, GRP_DIVE, CMD_DIVE_PROFILE, DIR_READ,
-				cmd_profile, sizeof(cmd_profile), rsp_profile, sizeof(rsp_profile), &len);
+			status = deepsix_excursion_recv (device, GRP_DIVE + 1, CMD_DIVE_PROFILE, DIR_READ,
+				rsp_profile, sizeof(rsp_profile), &len);
 			if (status != DC_STATUS_SUCCESS) {
 				ERROR (abstract->context, "Failed to read the dive profile.");
 				goto error_free;
 			}
 
+			// The size of the first packet determines the offsets of all
+			// the other requests. Only the last one can be smaller.
+			if (chunk == 0)
+				chunk = len;
+			if (len == 0 || (len != chunk && offset + len < length)) {
+				ERROR (abstract->context, "Unexpected profile packet size (%u %u).", len, chunk);
+				status = DC_STATUS_PROTOCOL;
+				goto error_free;
+			}
+
 			// Remove padding from the last packet.
 			unsigned int n = len;
 			if (offset + n > length) {
 				n = length - offset;
 			}
 
+			// Keep the request for the packet after the next one in flight,
+			// such that the dive computer doesn't wait for the round trip.
+			while (requested + chunk < length && requested < offset + n + chunk) {
+				requested += chunk;
+				status = deepsix_excursion_request_profile (device, number, requested);
+				if (status != DC_STATUS_SUCCESS) {
+					ERROR (abstract->context, "Failed to read the dive profile.");
+					goto error_free;
+				}
+			}
+
 			// Update and emit a progress event.
 			progress.current = (i + 1) * NSTEPS + STEP(headersize + offset + n, headersize + length);
 			device_event_emit(abstract, DC_EVENT_PROGRESS, &progress);
@@ -30,12 +30,12 @@
 #include "context-private.h"
 #include "parser-private.h"
 #include "array.h"
+#include "field-cache.h"
 
 #define HEADERSIZE_MIN 128
 
 #define MAX_SAMPLES   7
 #define MAX_EVENTS    7
-#define MAX_GASMIXES  20
 
 #define ALARM        0x0001
 #define TEMPERATURE  0x0002
@@ -109,7 +109,8 @@ typedef struct deepsix_excursion_parser_t {
 	dc_parser_t base;
 	unsigned int cached;
 	unsigned int ngasmixes;
-	deepsix_excursion_gasmix_t gasmix[MAX_GASMIXES];
+	deepsix_excursion_gasmix_t gasmix[MAXGASES];
+	dc_gasmix_map_t gasmap;
 } deepsix_excursion_parser_t;
 
 static dc_status_t deepsix_excursion_parser_get_datetime (dc_parser_t *abstract, dc_datetime_t *datetime);
@@ -117,6 +118,7 @@ static dc_status_t deepsix_excursion_parser_get_field (dc_parser_t *abstract, dc
 static dc_status_t deepsix_excursion_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_t callback, void *userdata);
 static dc_status_t deepsix_excursion_parser_samples_foreach_v0 (dc_parser_t *abstract, dc_sample_callback_t callback, void *userdata);
 static dc_status_t deepsix_excursion_parser_samples_foreach_v1 (dc_parser_t *abstract, dc_sample_callback_t callback, void *userdata);
+static dc_status_t deepsix_excursion_parser_reset (dc_parser_t *abstract);
 
 static const dc_parser_vtable_t deepsix_parser_vtable = {
 	sizeof(deepsix_excursion_parser_t),
@@ -126,7 +128,13 @@ static const dc_parser_vtable_t deepsix_parser_vtable = {
 	NULL, /* set_density */
 	deepsix_excursion_parser_get_datetime, /* datetime */
 	deepsix_excursion_parser_get_field, /* fields */
+	NULL, /* summary */
 	deepsix_excursion_parser_samples_foreach, /* samples_foreach */
+	NULL, /* samples_batch */
+	NULL, /* samples_fixed */
+	NULL, /* samples_append */
+	NULL, /* samples_range */
+	deepsix_excursion_parser_reset, /* reset */
 	NULL /* destroy */
 };
 
@@ -173,13 +181,10 @@ pressure_to_depth(unsigned int depth, unsigned int atmospheric, unsigned int den
 static unsigned int
 deepsix_excursion_find_gasmix(deepsix_excursion_parser_t *parser, unsigned int o2, unsigned int he, unsigned int id)
 {
-	unsigned int i = 0;
-	while (i < parser->ngasmixes) {
-		if (o2 == parser->gasmix[i].oxygen && he == parser->gasmix[i].helium && id == parser->gasmix[i].id)
-			break;
-		i++;
-	}
-	return i;
+	unsigned int idx = dc_gasmix_map_find(&parser->gasmap, o2, he, id);
+	if (idx == DC_GASMIX_UNKNOWN)
+		return parser->ngasmixes;
+	return idx;
 }
 
 dc_status_t
@@ -198,15 +203,27 @@ deepsix_excursion_parser_create (dc_parser_t **out, dc_context_t *context, const
 	}
 
 	// Set the default values.
+	deepsix_excursion_parser_reset ((dc_parser_t *) parser);
+
+	*out = (dc_parser_t *) parser;
+
+	return DC_STATUS_SUCCESS;
+}
+
+
+static dc_status_t
+deepsix_excursion_parser_reset (dc_parser_t *abstract)
+{
+	deepsix_excursion_parser_t *parser = (deepsix_excursion_parser_t *) abstract;
+
 	parser->cached = 0;
 	parser->ngasmixes = 0;
-	for (unsigned int i = 0; i < MAX_GASMIXES; ++i) {
+	for (unsigned int i = 0; i < MAXGASES; ++i) {
 		parser->gasmix[i].id = 0;
 		parser->gasmix[i].oxygen = 0;
 		parser->gasmix[i].helium = 0;
 	}
-
-	*out = (dc_parser_t *) parser;
+	dc_gasmix_map_clear (&parser->gasmap);
 
 	return DC_STATUS_SUCCESS;
 }
@@ -657,7 +674,7 @@ deepsix_excursion_parser_samples_foreach_v1 (dc_parser_t *abstract, dc_sample_ca
 
 					mix_idx = deepsix_excursion_find_gasmix(parser, o2, he, id);
 					if (mix_idx >= parser->ngasmixes) {
-						if (mix_idx >= MAX_GASMIXES) {
+						if (mix_idx >= MAXGASES) {
 							ERROR (abstract->context, "Maximum number of gas mixes reached.");
 							return DC_STATUS_NOMEMORY;
 						}
@@ -665,6 +682,7 @@ deepsix_excursion_parser_samples_foreach_v1 (dc_parser_t *abstract, dc_sample_ca
 						parser->gasmix[mix_idx].helium = he;
 						parser->gasmix[mix_idx].id = id;
 						parser->ngasmixes = mix_idx + 1;
+						dc_gasmix_map_insert (&parser->gasmap, o2, he, id, mix_idx);
 					}
 
 					sample.gasmix = mix_idx;
@@ -19,16 +19,24 @@
  * MA 02110-1301 USA
  */
 
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
 #include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include <libdivecomputer/descriptor.h>
+#include <libdivecomputer/serial.h>
+#include <libdivecomputer/irda.h>
+#include <libdivecomputer/bluetooth.h>
 #include <libdivecomputer/usbhid.h>
 #include <libdivecomputer/usb.h>
 
 #include "iterator-private.h"
 #include "platform.h"
+#include "thread.h"
 
 #define C_ARRAY_SIZE(array) (sizeof (array) / sizeof *(array))
 #define C_ARRAY_ITEMSIZE(array) (sizeof *(array))
@@ -45,25 +53,56 @@ typedef int (*dc_match_t)(const void *, const void *);
 
 typedef int (*dc_filter_t) (dc_descriptor_t *descriptor, dc_transport_t transport, const void *userdata);
 
+#ifndef DISABLE_BACKEND_UWATEC
 static int dc_filter_uwatec (dc_descriptor_t *descriptor, dc_transport_t transport, const void *userdata);
+#endif
+#ifndef DISABLE_BACKEND_SUUNTO
 static int dc_filter_suunto (dc_descriptor_t *descriptor, dc_transport_t transport, const void *userdata);
+#endif
+#ifndef DISABLE_BACKEND_SHEARWATER
 static int dc_filter_shearwater (dc_descriptor_t *descriptor, dc_transport_t transport, const void *userdata);
+#endif
+#ifndef DISABLE_BACKEND_HW
 static int dc_filter_hw (dc_descriptor_t *descriptor, dc_transport_t transport, const void *userdata);
+#endif
+#ifndef DISABLE_BACKEND_TECDIVING
 static int dc_filter_tecdiving (dc_descriptor_t *descriptor, dc_transport_t transport, const void *userdata);
+#endif
+#ifndef DISABLE_BACKEND_MARES
 static int dc_filter_mares (dc_descriptor_t *descriptor, dc_transport_t transport, const void *userdata);
+#endif
+#ifndef DISABLE_BACKEND_DIVESYSTEM
 static int dc_filter_divesystem (dc_descriptor_t *descriptor, dc_transport_t transport, const void *userdata);
+#endif
+#ifndef DISABLE_BACKEND_OCEANIC
 static int dc_filter_oceanic (dc_descriptor_t *descriptor, dc_transport_t transport, const void *userdata);
+#endif
+#ifndef DISABLE_BACKEND_MCLEAN
 static int dc_filter_mclean (dc_descriptor_t *descriptor, dc_transport_t transport, const void *userdata);
+#endif
+#ifndef DISABLE_BACKEND_ATOMICS
 static int dc_filter_atomic (dc_descriptor_t *descriptor, dc_transport_t transport, const void *userdata);
+#endif
+#ifndef DISABLE_BACKEND_DEEPSIX
 static int dc_filter_deepsix (dc_descriptor_t *descriptor, dc_transport_t transport, const void *userdata);
+#endif
+#ifndef DISABLE_BACKEND_DEEPBLU
 static int dc_filter_deepblu (dc_descriptor_t *descriptor, dc_transport_t transport, const void *userdata);
+#endif
+#ifndef DISABLE_BACKEND_OCEANS
 static int dc_filter_oceans (dc_descriptor_t *descriptor, dc_transport_t transport, const void *userdata);
+#endif
+#ifndef DISABLE_BACKEND_DIVESOFT
 static int dc_filter_divesoft (dc_descriptor_t *descriptor, dc_transport_t transport, const void *userdata);
+#endif
 
 // Not merged upstream yet
+#ifndef DISABLE_BACKEND_GARMIN
 static int dc_filter_garmin (dc_descriptor_t *descriptor, dc_transport_t transport, const void *userdata);
+#endif
 
 static dc_status_t dc_descriptor_iterator_next (dc_iterator_t *iterator, void *item);
+static dc_status_t dc_descriptor_match_iterator_next (dc_iterator_t *iterator, void *item);
 
 struct dc_descriptor_t {
 	const char *vendor;
@@ -85,6 +124,24 @@ static const dc_iterator_vtable_t dc_descriptor_iterator_vtable = {
 	NULL,
 };
 
+#define NTRANSPORTS 7
+#define MAXGROUPS   32
+
+typedef struct dc_descriptor_index_t dc_descriptor_index_t;
+
+typedef struct dc_descriptor_match_iterator_t {
+	dc_iterator_t base;
+	const dc_descriptor_index_t *index;
+	unsigned int matched;
+	unsigned int group, current;
+} dc_descriptor_match_iterator_t;
+
+static const dc_iterator_vtable_t dc_descriptor_match_iterator_vtable = {
+	sizeof(dc_descriptor_match_iterator_t),
+	dc_descriptor_match_iterator_next,
+	NULL,
+};
+
 /*
  * The model numbers in the table are the actual model numbers reported by the
  * device. For devices where there is no model number available (or known), an
@@ -93,6 +150,7 @@ static const dc_iterator_vtable_t dc_descriptor_iterator_vtable = {
  */
 
 static const dc_descriptor_t g_descriptors[] = {
+#ifndef DISABLE_BACKEND_SUUNTO
 	/* Suunto Solution */
 	{"Suunto", "Solution", DC_FAMILY_SUUNTO_SOLUTION, 0, DC_TRANSPORT_SERIAL, NULL},
 	/* Suunto Eon */
@@ -132,6 +190,8 @@ static const dc_descriptor_t g_descriptors[] = {
 	{"Suunto", "EON Core",        DC_FAMILY_SUUNTO_EONSTEEL, 1, DC_TRANSPORT_USBHID | DC_TRANSPORT_BLE, dc_filter_suunto},
 	{"Suunto", "D5",              DC_FAMILY_SUUNTO_EONSTEEL, 2, DC_TRANSPORT_USBHID | DC_TRANSPORT_BLE, dc_filter_suunto},
 	{"Suunto", "EON Steel Black", DC_FAMILY_SUUNTO_EONSTEEL, 3, DC_TRANSPORT_USBHID | DC_TRANSPORT_BLE, dc_filter_suunto},
+#endif
+#ifndef DISABLE_BACKEND_UWATEC
 	/* Uwatec Aladin */
 	{"Uwatec", "Aladin Air Twin",     DC_FAMILY_UWATEC_ALADIN, 0x1C, DC_TRANSPORT_SERIAL, NULL},
 	{"Uwatec", "Aladin Sport Plus",   DC_FAMILY_UWATEC_ALADIN, 0x3E, DC_TRANSPORT_SERIAL, NULL},
@@ -177,10 +237,14 @@ static const dc_descriptor_t g_descriptors[] = {
 	{"Scubapro", "G2 HUD",              DC_FAMILY_UWATEC_SMART, 0x42, DC_TRANSPORT_USBHID | DC_TRANSPORT_BLE, dc_filter_uwatec},
 	{"Scubapro", "Luna 2.0 AI",         DC_FAMILY_UWATEC_SMART, 0x50, DC_TRANSPORT_BLE, dc_filter_uwatec},
 	{"Scubapro", "Luna 2.0",            DC_FAMILY_UWATEC_SMART, 0x51, DC_TRANSPORT_BLE, dc_filter_uwatec},
+#endif
+#ifndef DISABLE_BACKEND_REEFNET
 	/* Reefnet */
 	{"Reefnet", "Sensus",       DC_FAMILY_REEFNET_SENSUS, 1, DC_TRANSPORT_SERIAL, NULL},
 	{"Reefnet", "Sensus Pro",   DC_FAMILY_REEFNET_SENSUSPRO, 2, DC_TRANSPORT_SERIAL, NULL},
 	{"Reefnet", "Sensus Ultra", DC_FAMILY_REEFNET_SENSUSULTRA, 3, DC_TRANSPORT_SERIAL, NULL},
+#endif
+#ifndef DISABLE_BACKEND_OCEANIC
 	/* Oceanic VT Pro */
 	{"Aeris",    "500 AI",     DC_FAMILY_OCEANIC_VTPRO, 0x4151, DC_TRANSPORT_SERIAL, NULL},
 	{"Oceanic",  "Versa Pro",  DC_FAMILY_OCEANIC_VTPRO, 0x4155, DC_TRANSPORT_SERIAL, NULL},
@@ -275,6 +339,8 @@ static const dc_descriptor_t g_descriptors[] = {
 	{"Aqualung", "i470TC",              DC_FAMILY_OCEANIC_ATOM2, 0x4743, DC_TRANSPORT_SERIAL | DC_TRANSPORT_BLE, dc_filter_oceanic},
 	{"Aqualung", "i200Cv2",             DC_FAMILY_OCEANIC_ATOM2, 0x4749, DC_TRANSPORT_SERIAL | DC_TRANSPORT_BLE, dc_filter_oceanic},
 	{"Oceanic",  "Geo Air",             DC_FAMILY_OCEANIC_ATOM2, 0x474B, DC_TRANSPORT_SERIAL | DC_TRANSPORT_BLE, dc_filter_oceanic},
+#endif
+#ifndef DISABLE_BACKEND_MARES
 	/* Mares Nemo */
 	{"Mares", "Nemo",         DC_FAMILY_MARES_NEMO, 0, DC_TRANSPORT_SERIAL, NULL},
 	{"Mares", "Nemo Steel",   DC_FAMILY_MARES_NEMO, 0, DC_TRANSPORT_SERIAL, NULL},
@@ -307,6 +373,8 @@ static const dc_descriptor_t g_descriptors[] = {
 	{"Mares", "Smart Air",         DC_FAMILY_MARES_ICONHD , 0x24, DC_TRANSPORT_SERIAL | DC_TRANSPORT_BLE, dc_filter_mares},
 	{"Mares", "Quad",              DC_FAMILY_MARES_ICONHD , 0x29, DC_TRANSPORT_SERIAL | DC_TRANSPORT_BLE, dc_filter_mares},
 	{"Mares", "Horizon",           DC_FAMILY_MARES_ICONHD , 0x2C, DC_TRANSPORT_SERIAL, NULL},
+#endif
+#ifndef DISABLE_BACKEND_HW
 	/* Heinrichs Weikamp */
 	{"Heinrichs Weikamp", "OSTC",     DC_FAMILY_HW_OSTC, 0, DC_TRANSPORT_SERIAL, NULL},
 	{"Heinrichs Weikamp", "OSTC Mk2", DC_FAMILY_HW_OSTC, 1, DC_TRANSPORT_SERIAL, NULL},
@@ -325,6 +393,8 @@ static const dc_descriptor_t g_descriptors[] = {
 	{"Heinrichs Weikamp", "OSTC Sport", DC_FAMILY_HW_OSTC3, 0x12, DC_TRANSPORT_SERIAL | DC_TRANSPORT_BLUETOOTH | DC_TRANSPORT_BLE, dc_filter_hw},
 	{"Heinrichs Weikamp", "OSTC Sport", DC_FAMILY_HW_OSTC3, 0x13, DC_TRANSPORT_SERIAL | DC_TRANSPORT_BLUETOOTH | DC_TRANSPORT_BLE, dc_filter_hw},
 	{"Heinrichs Weikamp", "OSTC 2 TR",  DC_FAMILY_HW_OSTC3, 0x33, DC_TRANSPORT_SERIAL | DC_TRANSPORT_BLUETOOTH | DC_TRANSPORT_BLE, dc_filter_hw},
+#endif
+#ifndef DISABLE_BACKEND_CRESSI
 	/* Cressi Edy */
 	{"Tusa",   "IQ-700", DC_FAMILY_CRESSI_EDY, 0x05, DC_TRANSPORT_SERIAL, NULL},
 	{"Cressi", "Edy",    DC_FAMILY_CRESSI_EDY, 0x08, DC_TRANSPORT_SERIAL, NULL},
@@ -339,14 +409,20 @@ static const dc_descriptor_t g_descriptors[] = {
 	{"Cressi", "Donatello",    DC_FAMILY_CRESSI_GOA, 4, DC_TRANSPORT_SERIAL, NULL},
 	{"Cressi", "Michelangelo", DC_FAMILY_CRESSI_GOA, 5, DC_TRANSPORT_SERIAL, NULL},
 	{"Cressi", "Neon",     DC_FAMILY_CRESSI_GOA, 9, DC_TRANSPORT_SERIAL, NULL},
+#endif
+#ifndef DISABLE_BACKEND_ZEAGLE
 	/* Zeagle N2iTiON3 */
 	{"Zeagle",    "N2iTiON3",   DC_FAMILY_ZEAGLE_N2ITION3, 0, DC_TRANSPORT_SERIAL, NULL},
 	{"Apeks",     "Quantum X",  DC_FAMILY_ZEAGLE_N2ITION3, 0, DC_TRANSPORT_SERIAL, NULL},
 	{"Dive Rite", "NiTek Trio", DC_FAMILY_ZEAGLE_N2ITION3, 0, DC_TRANSPORT_SERIAL, NULL},
 	{"Scubapro",  "XTender 5",  DC_FAMILY_ZEAGLE_N2ITION3, 0, DC_TRANSPORT_SERIAL, NULL},
+#endif
+#ifndef DISABLE_BACKEND_ATOMICS
 	/* Atomic Aquatics Cobalt */
 	{"Atomic Aquatics", "Cobalt",   DC_FAMILY_ATOMICS_COBALT, 0, DC_TRANSPORT_USB, dc_filter_atomic},
 	{"Atomic Aquatics", "Cobalt 2", DC_FAMILY_ATOMICS_COBALT, 2, DC_TRANSPORT_USB, dc_filter_atomic},
+#endif
+#ifndef DISABLE_BACKEND_SHEARWATER
 	/* Shearwater Predator */
 	{"Shearwater", "Predator", DC_FAMILY_SHEARWATER_PREDATOR, 2, DC_TRANSPORT_SERIAL | DC_TRANSPORT_BLUETOOTH, dc_filter_shearwater},
 	/* Shearwater Petrel */
@@ -361,10 +437,16 @@ static const dc_descriptor_t g_descriptors[] = {
 	{"Shearwater", "Petrel 3",  DC_FAMILY_SHEARWATER_PETREL, 10, DC_TRANSPORT_BLE, dc_filter_shearwater},
 	{"Shearwater", "Perdix 2",  DC_FAMILY_SHEARWATER_PETREL, 11, DC_TRANSPORT_BLE, dc_filter_shearwater},
 	{"Shearwater", "Tern",      DC_FAMILY_SHEARWATER_PETREL, 12, DC_TRANSPORT_BLE, dc_filter_shearwater},
+#endif
+#ifndef DISABLE_BACKEND_DIVERITE
 	/* Dive Rite NiTek Q */
 	{"Dive Rite", "NiTek Q",   DC_FAMILY_DIVERITE_NITEKQ, 0, DC_TRANSPORT_SERIAL, NULL},
+#endif
+#ifndef DISABLE_BACKEND_CITIZEN
 	/* Citizen Hyper Aqualand */
 	{"Citizen", "Hyper Aqualand", DC_FAMILY_CITIZEN_AQUALAND, 0, DC_TRANSPORT_SERIAL, NULL},
+#endif
+#ifndef DISABLE_BACKEND_DIVESYSTEM
 	/* DiveSystem/Ratio iDive */
 	{"DiveSystem", "Orca",          DC_FAMILY_DIVESYSTEM_IDIVE, 0x02, DC_TRANSPORT_SERIAL, NULL},
 	{"DiveSystem", "iDive Pro",     DC_FAMILY_DIVESYSTEM_IDIVE, 0x03, DC_TRANSPORT_SERIAL, NULL},
@@ -435,6 +517,8 @@ static const dc_descriptor_t g_descriptors[] = {
 	{"Ratio",      "iX3M 2 Tech+",        DC_FAMILY_DIVESYSTEM_IDIVE, 0x104, DC_TRANSPORT_SERIAL | DC_TRANSPORT_BLE, dc_filter_divesystem},
 	{"Seac",       "Jack",          DC_FAMILY_DIVESYSTEM_IDIVE, 0x1000, DC_TRANSPORT_SERIAL, NULL},
 	{"Seac",       "Guru",          DC_FAMILY_DIVESYSTEM_IDIVE, 0x1002, DC_TRANSPORT_SERIAL, NULL},
+#endif
+#ifndef DISABLE_BACKEND_COCHRAN
 	/* Cochran Commander */
 	{"Cochran", "Commander TM", DC_FAMILY_COCHRAN_COMMANDER, 0, DC_TRANSPORT_SERIAL, NULL},
 	{"Cochran", "Commander I",  DC_FAMILY_COCHRAN_COMMANDER, 1, DC_TRANSPORT_SERIAL, NULL},
@@ -442,43 +526,64 @@ static const dc_descriptor_t g_descriptors[] = {
 	{"Cochran", "EMC-14",       DC_FAMILY_COCHRAN_COMMANDER, 3, DC_TRANSPORT_SERIAL, NULL},
 	{"Cochran", "EMC-16",       DC_FAMILY_COCHRAN_COMMANDER, 4, DC_TRANSPORT_SERIAL, NULL},
 	{"Cochran", "EMC-20H",      DC_FAMILY_COCHRAN_COMMANDER, 5, DC_TRANSPORT_SERIAL, NULL},
+#endif
+#ifndef DISABLE_BACKEND_TECDIVING
 	/* Tecdiving DiveComputer.eu */
 	{"Tecdiving", "DiveComputer.eu", DC_FAMILY_TECDIVING_DIVECOMPUTEREU, 0, DC_TRANSPORT_SERIAL | DC_TRANSPORT_BLUETOOTH, dc_filter_tecdiving},
+#endif
+#ifndef DISABLE_BACKEND_MCLEAN
 	/* McLean Extreme */
 	{ "McLean", "Extreme", DC_FAMILY_MCLEAN_EXTREME, 0, DC_TRANSPORT_SERIAL | DC_TRANSPORT_BLUETOOTH | DC_TRANSPORT_BLE, dc_filter_mclean},
+#endif
+#ifndef DISABLE_BACKEND_LIQUIVISION
 	/* Liquivision */
 	{"Liquivision", "Xen",  DC_FAMILY_LIQUIVISION_LYNX, 0, DC_TRANSPORT_SERIAL, NULL},
 	{"Liquivision", "Xeo",  DC_FAMILY_LIQUIVISION_LYNX, 1, DC_TRANSPORT_SERIAL, NULL},
 	{"Liquivision", "Lynx", DC_FAMILY_LIQUIVISION_LYNX, 2, DC_TRANSPORT_SERIAL, NULL},
 	{"Liquivision", "Kaon", DC_FAMILY_LIQUIVISION_LYNX, 3, DC_TRANSPORT_SERIAL, NULL},
+#endif
+#ifndef DISABLE_BACKEND_SPORASUB
 	/* Sporasub */
 	{"Sporasub", "SP2", DC_FAMILY_SPORASUB_SP2, 0, DC_TRANSPORT_SERIAL, NULL},
+#endif
+#ifndef DISABLE_BACKEND_DEEPSIX
 	/* Deep Six Excursion */
 	{"Deep Six", "Excursion", DC_FAMILY_DEEPSIX_EXCURSION, 0, DC_TRANSPORT_BLE, dc_filter_deepsix},
 	{"Crest",    "CR-4",      DC_FAMILY_DEEPSIX_EXCURSION, 0, DC_TRANSPORT_BLE, dc_filter_deepsix},
 	{"Genesis",  "Centauri",  DC_FAMILY_DEEPSIX_EXCURSION, 0, DC_TRANSPORT_BLE, dc_filter_deepsix},
 	{"Scorpena", "Alpha",     DC_FAMILY_DEEPSIX_EXCURSION, 0, DC_TRANSPORT_BLE, dc_filter_deepsix},
+#endif
+#ifndef DISABLE_BACKEND_SEAC
 	/* Seac Screen */
 	{"Seac", "Screen", DC_FAMILY_SEAC_SCREEN, 0, DC_TRANSPORT_SERIAL, NULL},
 	{"Seac", "Action", DC_FAMILY_SEAC_SCREEN, 0, DC_TRANSPORT_SERIAL, NULL},
+#endif
+#ifndef DISABLE_BACKEND_DEEPBLU
 	/* Deepblu Cosmiq */
 	{"Deepblu", "Cosmiq+", DC_FAMILY_DEEPBLU_COSMIQ, 0, DC_TRANSPORT_BLE, dc_filter_deepblu},
+#endif
+#ifndef DISABLE_BACKEND_OCEANS
 	/* Oceans S1 */
 	{"Oceans", "S1", DC_FAMILY_OCEANS_S1, 0, DC_TRANSPORT_BLE, dc_filter_oceans},
+#endif
+#ifndef DISABLE_BACKEND_DIVESOFT
 	/* Divesoft Freedom */
 	{"Divesoft", "Freedom", DC_FAMILY_DIVESOFT_FREEDOM, 19, DC_TRANSPORT_BLE, dc_filter_divesoft},
 	{"Divesoft", "Liberty", DC_FAMILY_DIVESOFT_FREEDOM, 10, DC_TRANSPORT_BLE, dc_filter_divesoft},
+#endif
 
 	// Not merged upstream yet
+#ifndef DISABLE_BACKEND_GARMIN
 	/* Garmin -- model numbers as defined in FIT format; USB product id is (0x4000 | model) */
 	/* for the Mk1 we are using the model of the global model - the APAC model is 2991 */
 	/* for the Mk2 we are using the model of the global model - the APAC model is 3702 */
 	{"Garmin", "Descent Mk1", DC_FAMILY_GARMIN, 2859, DC_TRANSPORT_USBSTORAGE, dc_filter_garmin},
 	{"Garmin", "Descent Mk2/Mk2i", DC_FAMILY_GARMIN, 3258, DC_TRANSPORT_USBSTORAGE, dc_filter_garmin},
 	{"FIT", "File import", DC_FAMILY_GARMIN, 0, DC_TRANSPORT_USBSTORAGE, NULL },
+#endif
 };
 
-static int
+static DC_ATTR_UNUSED int
 dc_match_name (const void *key, const void *value)
 {
 	const char *k = (const char *) key;
@@ -487,7 +592,7 @@ dc_match_name (const void *key, const void *value)
 	return strcasecmp (k, v) == 0;
 }
 
-static int
+static DC_ATTR_UNUSED int
 dc_match_prefix (const void *key, const void *value)
 {
 	const char *k = (const char *) key;
@@ -496,7 +601,7 @@ dc_match_prefix (const void *key, const void *value)
 	return strncasecmp (k, v, strlen (v)) == 0;
 }
 
-static int
+static DC_ATTR_UNUSED int
 dc_match_devname (const void *key, const void *value)
 {
 	const char *k = (const char *) key;
@@ -505,7 +610,7 @@ dc_match_devname (const void *key, const void *value)
 	return strncmp (k, v, strlen (v)) == 0;
 }
 
-static int
+static DC_ATTR_UNUSED int
 dc_match_usb (const void *key, const void *value)
 {
 	const dc_usb_desc_t *k = (const dc_usb_desc_t *) key;
@@ -514,7 +619,7 @@ dc_match_usb (const void *key, const void *value)
 	return k->vid == v->vid && k->pid == v->pid;
 }
 
-static int
+static DC_ATTR_UNUSED int
 dc_match_usbhid (const void *key, const void *value)
 {
 	const dc_usbhid_desc_t *k = (const dc_usbhid_desc_t *) key;
@@ -523,7 +628,7 @@ dc_match_usbhid (const void *key, const void *value)
 	return k->vid == v->vid && k->pid == v->pid;
 }
 
-static int
+static DC_ATTR_UNUSED int
 dc_match_number_with_prefix (const void *key, const void *value)
 {
 	const char *str = (const char *) key;
@@ -546,7 +651,7 @@ dc_match_number_with_prefix (const void *key, const void *value)
 	return 1;
 }
 
-static int
+static DC_ATTR_UNUSED int
 dc_match_oceanic (const void *key, const void *value)
 {
 	unsigned int model = *(const unsigned int *) value;
@@ -562,7 +667,7 @@ dc_match_oceanic (const void *key, const void *value)
 	return dc_match_number_with_prefix (key, &p);
 }
 
-static int
+static DC_ATTR_UNUSED int
 dc_filter_internal (const void *key, const void *values, size_t count, size_t size, dc_match_t match)
 {
 	if (key == NULL)
@@ -577,13 +682,14 @@ dc_filter_internal (const void *key, const void *values, size_t count, size_t si
 	return count == 0;
 }
 
-static const char * const rfcomm[] = {
+static const char * const rfcomm[] DC_ATTR_UNUSED = {
 #if defined (__linux__)
 	"/dev/rfcomm",
 #endif
 	NULL
 };
 
+#ifndef DISABLE_BACKEND_UWATEC
 static int
 dc_filter_uwatec (dc_descriptor_t *descriptor, dc_transport_t transport, const void *userdata)
 {
@@ -624,7 +730,9 @@ dc_filter_uwatec (dc_descriptor_t *descriptor, dc_transport_t transport, const v
 
 	return 1;
 }
+#endif
 
+#ifndef DISABLE_BACKEND_SUUNTO
 static int
 dc_filter_suunto (dc_descriptor_t *descriptor, dc_transport_t transport, const void *userdata)
 {
@@ -649,7 +757,9 @@ dc_filter_suunto (dc_descriptor_t *descriptor, dc_transport_t transport, const v
 
 	return 1;
 }
+#endif
 
+#ifndef DISABLE_BACKEND_HW
 static int
 dc_filter_hw (dc_descriptor_t *descriptor, dc_transport_t transport, const void *userdata)
 {
@@ -666,7 +776,9 @@ dc_filter_hw (dc_descriptor_t *descriptor, dc_transport_t transport, const void
 
 	return 1;
 }
+#endif
 
+#ifndef DISABLE_BACKEND_SHEARWATER
 static int
 dc_filter_shearwater (dc_descriptor_t *descriptor, dc_transport_t transport, const void *userdata)
 {
@@ -691,7 +803,9 @@ dc_filter_shearwater (dc_descriptor_t *descriptor, dc_transport_t transport, con
 
 	return 1;
 }
+#endif
 
+#ifndef DISABLE_BACKEND_TECDIVING
 static int
 dc_filter_tecdiving (dc_descriptor_t *descriptor, dc_transport_t transport, const void *userdata)
 {
@@ -707,7 +821,9 @@ dc_filter_tecdiving (dc_descriptor_t *descriptor, dc_transport_t transport, cons
 
 	return 1;
 }
+#endif
 
+#ifndef DISABLE_BACKEND_MARES
 static int
 dc_filter_mares (dc_descriptor_t *descriptor, dc_transport_t transport, const void *userdata)
 {
@@ -722,7 +838,9 @@ dc_filter_mares (dc_descriptor_t *descriptor, dc_transport_t transport, const vo
 
 	return 1;
 }
+#endif
 
+#ifndef DISABLE_BACKEND_DIVESYSTEM
 static int
 dc_filter_divesystem (dc_descriptor_t *descriptor, dc_transport_t transport, const void *userdata)
 {
@@ -738,7 +856,9 @@ dc_filter_divesystem (dc_descriptor_t *descriptor, dc_transport_t transport, con
 
 	return 1;
 }
+#endif
 
+#ifndef DISABLE_BACKEND_OCEANIC
 static int
 dc_filter_oceanic (dc_descriptor_t *descriptor, dc_transport_t transport, const void *userdata)
 {
@@ -766,7 +886,9 @@ dc_filter_oceanic (dc_descriptor_t *descriptor, dc_transport_t transport, const
 
 	return 1;
 }
+#endif
 
+#ifndef DISABLE_BACKEND_MCLEAN
 static int
 dc_filter_mclean(dc_descriptor_t *descriptor, dc_transport_t transport, const void *userdata)
 {
@@ -782,7 +904,9 @@ dc_filter_mclean(dc_descriptor_t *descriptor, dc_transport_t transport, const vo
 
 	return 1;
 }
+#endif
 
+#ifndef DISABLE_BACKEND_ATOMICS
 static int
 dc_filter_atomic (dc_descriptor_t *descriptor, dc_transport_t transport, const void *userdata)
 {
@@ -796,7 +920,9 @@ dc_filter_atomic (dc_descriptor_t *descriptor, dc_transport_t transport, const v
 
 	return 1;
 }
+#endif
 
+#ifndef DISABLE_BACKEND_DEEPSIX
 static int
 dc_filter_deepsix (dc_descriptor_t *descriptor, dc_transport_t transport, const void *userdata)
 {
@@ -813,7 +939,9 @@ dc_filter_deepsix (dc_descriptor_t *descriptor, dc_transport_t transport, const
 
 	return 1;
 }
+#endif
 
+#ifndef DISABLE_BACKEND_DEEPBLU
 static int
 dc_filter_deepblu (dc_descriptor_t *descriptor, dc_transport_t transport, const void *userdata)
 {
@@ -827,7 +955,9 @@ dc_filter_deepblu (dc_descriptor_t *descriptor, dc_transport_t transport, const
 
 	return 1;
 }
+#endif
 
+#ifndef DISABLE_BACKEND_OCEANS
 static int
 dc_filter_oceans (dc_descriptor_t *descriptor, dc_transport_t transport, const void *userdata)
 {
@@ -841,7 +971,9 @@ dc_filter_oceans (dc_descriptor_t *descriptor, dc_transport_t transport, const v
 
 	return 1;
 }
+#endif
 
+#ifndef DISABLE_BACKEND_DIVESOFT
 static int
 dc_filter_divesoft (dc_descriptor_t *descriptor, dc_transport_t transport, const void *userdata)
 {
@@ -856,8 +988,10 @@ dc_filter_divesoft (dc_descriptor_t *descriptor, dc_transport_t transport, const
 
 	return 1;
 }
+#endif
 
 // Not merged upstream yet
+#ifndef DISABLE_BACKEND_GARMIN
 static int
 dc_filter_garmin (dc_descriptor_t *descriptor, dc_transport_t transport, const void *userdata)
 {
@@ -871,6 +1005,7 @@ dc_filter_garmin (dc_descriptor_t *descriptor, dc_transport_t transport, const v
 
 	return 1;
 }
+#endif
 
 dc_status_t
 dc_descriptor_iterator (dc_iterator_t **out)
@@ -912,6 +1047,321 @@ dc_descriptor_iterator_next (dc_iterator_t *abstract, void *out)
 	return DC_STATUS_SUCCESS;
 }
 
+/*
+ * The descriptors sharing a filter function, for a single transport.
+ * Since the filter functions only look at their own per-vendor tables
+ * (and never at the descriptor itself), the filter needs to be called
+ * only once for the whole group.
+ */
+typedef struct dc_descriptor_group_t {
+	dc_filter_t filter;
+	unsigned int first, count;
+} dc_descriptor_group_t;
+
+struct dc_descriptor_index_t {
+	unsigned int ngroups;
+	dc_descriptor_group_t groups[MAXGROUPS];
+	unsigned short items[C_ARRAY_SIZE (g_descriptors)];
+};
+
+/*
+ * The descriptors of a single vendor or family, in table order.
+ */
+typedef struct dc_descriptor_range_t {
+	const char *vendor;
+	dc_family_t family;
+	unsigned int first, count;
+} dc_descriptor_range_t;
+
+typedef struct dc_descriptor_query_index_t {
+	unsigned int nvendors, nfamilies;
+	dc_descriptor_range_t vendors[C_ARRAY_SIZE (g_descriptors)];
+	dc_descriptor_range_t families[C_ARRAY_SIZE (g_descriptors)];
+	unsigned short vendor_items[C_ARRAY_SIZE (g_descriptors)];
+	unsigned short family_items[C_ARRAY_SIZE (g_descriptors)];
+	unsigned short transport_items[NTRANSPORTS][C_ARRAY_SIZE (g_descriptors)];
+	unsigned int transport_count[NTRANSPORTS];
+} dc_descriptor_query_index_t;
+
+static dc_descriptor_index_t g_index[NTRANSPORTS];
+static dc_descriptor_query_index_t g_query;
+static int g_index_initialized = 0;
+static dc_mutex_t g_index_mutex = DC_MUTEX_INIT;
+
+static void
+dc_descriptor_index_build (dc_descriptor_index_t *index, unsigned int transport)
+{
+	unsigned int nitems = 0;
+
+	index->ngroups = 0;
+
+	for (size_t i = 0; i < C_ARRAY_SIZE (g_descriptors); ++i) {
+		dc_filter_t filter = g_descriptors[i].filter;
+		dc_descriptor_group_t *group = NULL;
+
+		if ((g_descriptors[i].transports & transport) == 0)
+			continue;
+
+		// Skip filters that already have a group.
+		for (unsigned int j = 0; j < index->ngroups; ++j) {
+			if (index->groups[j].filter == filter) {
+				group = index->groups + j;
+				break;
+			}
+		}
+		if (group)
+			continue;
+
+		group = index->groups + index->ngroups++;
+		group->filter = filter;
+		group->first = nitems;
+		group->count = 0;
+
+		// Collect all members of the new group, in table order.
+		for (size_t j = i; j < C_ARRAY_SIZE (g_descriptors); ++j) {
+			if (g_descriptors[j].filter == filter &&
+				(g_descriptors[j].transports & transport) != 0) {
+				index->items[nitems++] = j;
+				group->count++;
+			}
+		}
+	}
+}
+
+static void
+dc_descriptor_query_build (dc_descriptor_query_index_t *query)
+{
+	unsigned int nvendor = 0, nfamily = 0;
+
+	query->nvendors = 0;
+	query->nfamilies = 0;
+
+	for (size_t i = 0; i < C_ARRAY_SIZE (g_descriptors); ++i) {
+		const char *vendor = g_descriptors[i].vendor;
+		dc_family_t family = g_descriptors[i].type;
+		int found = 0;
+
+		for (unsigned int j = 0; j < query->nvendors; ++j) {
+			if (strcmp (query->vendors[j].vendor, vendor) == 0) {
+				found = 1;
+				break;
+			}
+		}
+		if (!found) {
+			dc_descriptor_range_t *range = query->vendors + query->nvendors++;
+			range->vendor = vendor;
+			range->family = DC_FAMILY_NULL;
+			range->first = nvendor;
+			range->count = 0;
+			for (size_t j = i; j < C_ARRAY_SIZE (g_descriptors); ++j) {
+				if (strcmp (g_descriptors[j].vendor, vendor) == 0) {
+					query->vendor_items[nvendor++] = j;
+					range->count++;
+				}
+			}
+		}
+
+		found = 0;
+		for (unsigned int j = 0; j < query->nfamilies; ++j) {
+			if (query->families[j].family == family) {
+				found = 1;
+				break;
+			}
+		}
+		if (!found) {
+			dc_descriptor_range_t *range = query->families + query->nfamilies++;
+			range->vendor = NULL;
+			range->family = family;
+			range->first = nfamily;
+			range->count = 0;
+			for (size_t j = i; j < C_ARRAY_SIZE (g_descriptors); ++j) {
+				if (g_descriptors[j].type == family) {
+					query->family_items[nfamily++] = j;
+					range->count++;
+				}
+			}
+		}
+	}
+
+	for (unsigned int n = 0; n < NTRANSPORTS; ++n) {
+		query->transport_count[n] = 0;
+		for (size_t i = 0; i < C_ARRAY_SIZE (g_descriptors); ++i) {
+			if (g_descriptors[i].transports & (1u << n))
+				query->transport_items[n][query->transport_count[n]++] = i;
+		}
+	}
+}
+
+static void
+dc_descriptor_index_init (void)
+{
+	dc_mutex_lock (&g_index_mutex);
+	if (!g_index_initialized) {
+		for (unsigned int i = 0; i < NTRANSPORTS; ++i) {
+			dc_descriptor_index_build (g_index + i, 1u << i);
+		}
+		dc_descriptor_query_build (&g_query);
+		g_index_initialized = 1;
+	}
+	dc_mutex_unlock (&g_index_mutex);
+}
+
+static const dc_descriptor_index_t *
+dc_descriptor_index (unsigned int n)
+{
+	dc_descriptor_index_init ();
+
+	return g_index + n;
+}
+
+dc_status_t
+dc_descriptor_iterator_match (dc_iterator_t **out, dc_transport_t transport, const void *userdata)
+{
+	dc_descriptor_match_iterator_t *iterator = NULL;
+	const dc_descriptor_index_t *index = NULL;
+	unsigned int n = 0;
+
+	if (out == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	// Exactly one transport is required.
+	if (transport == DC_TRANSPORT_NONE || (transport & (transport - 1)) != 0)
+		return DC_STATUS_INVALIDARGS;
+
+	while ((1u << n) != (unsigned int) transport)
+		n++;
+
+	if (n >= NTRANSPORTS)
+		return DC_STATUS_INVALIDARGS;
+
+	iterator = (dc_descriptor_match_iterator_t *) dc_iterator_allocate (NULL, &dc_descriptor_match_iterator_vtable);
+	if (iterator == NULL)
+		return DC_STATUS_NOMEMORY;
+
+	index = dc_descriptor_index (n);
+
+	// Run each filter once, and remember which groups matched. This
+	// has the same semantics as dc_descriptor_filter().
+	iterator->index = index;
+	iterator->matched = 0;
+	for (unsigned int i = 0; i < index->ngroups; ++i) {
+		dc_filter_t filter = index->groups[i].filter;
+		if (filter == NULL || userdata == NULL ||
+			filter ((dc_descriptor_t *) &g_descriptors[index->items[index->groups[i].first]], transport, userdata)) {
+			iterator->matched |= 1u << i;
+		}
+	}
+	iterator->group = 0;
+	iterator->current = 0;
+
+	*out = (dc_iterator_t *) iterator;
+
+	return DC_STATUS_SUCCESS;
+}
+
+static dc_status_t
+dc_descriptor_match_iterator_next (dc_iterator_t *abstract, void *out)
+{
+	dc_descriptor_match_iterator_t *iterator = (dc_descriptor_match_iterator_t *) abstract;
+	const dc_descriptor_index_t *index = iterator->index;
+	dc_descriptor_t **item = (dc_descriptor_t **) out;
+
+	while (iterator->group < index->ngroups) {
+		const dc_descriptor_group_t *group = index->groups + iterator->group;
+
+		if ((iterator->matched & (1u << iterator->group)) &&
+			iterator->current < group->count) {
+			*item = (dc_descriptor_t *) &g_descriptors[index->items[group->first + iterator->current++]];
+			return DC_STATUS_SUCCESS;
+		}
+
+		iterator->group++;
+		iterator->current = 0;
+	}
+
+	return DC_STATUS_DONE;
+}
+
+dc_status_t
+dc_descriptor_query (unsigned int transports, dc_family_t family, const char *vendor, dc_descriptor_t *descriptors[], size_t size, size_t *count)
+{
+	const unsigned short *items = NULL;
+	size_t nitems = C_ARRAY_SIZE (g_descriptors);
+	size_t nresults = 0;
+
+	if (size && descriptors == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	dc_descriptor_index_init ();
+
+	// Start from the smallest precomputed list of candidates, and check
+	// the remaining criteria on each of them.
+	if (vendor) {
+		const dc_descriptor_range_t *range = NULL;
+		for (unsigned int i = 0; i < g_query.nvendors; ++i) {
+			if (strcmp (g_query.vendors[i].vendor, vendor) == 0) {
+				range = g_query.vendors + i;
+				break;
+			}
+		}
+		if (range == NULL) {
+			nitems = 0;
+		} else {
+			items = g_query.vendor_items + range->first;
+			nitems = range->count;
+		}
+	}
+
+	if (family != DC_FAMILY_NULL && nitems) {
+		const dc_descriptor_range_t *range = NULL;
+		for (unsigned int i = 0; i < g_query.nfamilies; ++i) {
+			if (g_query.families[i].family == family) {
+				range = g_query.families + i;
+				break;
+			}
+		}
+		if (range == NULL) {
+			nitems = 0;
+		} else if (range->count < nitems) {
+			items = g_query.family_items + range->first;
+			nitems = range->count;
+		}
+	}
+
+	if (transports != DC_TRANSPORT_NONE && (transports & (transports - 1)) == 0 && nitems) {
+		unsigned int n = 0;
+		while ((1u << n) != transports)
+			n++;
+		if (n >= NTRANSPORTS) {
+			nitems = 0;
+		} else if (g_query.transport_count[n] < nitems) {
+			items = g_query.transport_items[n];
+			nitems = g_query.transport_count[n];
+		}
+	}
+
+	for (size_t i = 0; i < nitems; ++i) {
+		const dc_descriptor_t *descriptor = &g_descriptors[items ? items[i] : i];
+
+		if (transports != DC_TRANSPORT_NONE && (descriptor->transports & transports) == 0)
+			continue;
+		if (family != DC_FAMILY_NULL && descriptor->type != family)
+			continue;
+		if (vendor && strcmp (descriptor->vendor, vendor) != 0)
+			continue;
+
+		// See dc_descriptor_iterator_next() for the cast.
+		if (nresults < size)
+			descriptors[nresults] = (dc_descriptor_t *) descriptor;
+		nresults++;
+	}
+
+	if (count)
+		*count = nresults;
+
+	return DC_STATUS_SUCCESS;
+}
+
 void
 dc_descriptor_free (dc_descriptor_t *descriptor)
 {
@@ -971,3 +1421,171 @@ dc_descriptor_filter (dc_descriptor_t *descriptor, dc_transport_t transport, con
 
 	return descriptor->filter (descriptor, transport, userdata);
 }
+
+typedef struct dc_descriptor_scan_t {
+	dc_descriptor_t *descriptor;
+	dc_descriptor_scan_callback_t callback;
+	void *userdata;
+	dc_mutex_t mutex;
+	int stop;
+} dc_descriptor_scan_t;
+
+typedef struct dc_descriptor_scan_worker_t {
+	dc_descriptor_scan_t *scan;
+	dc_context_t *context;
+	dc_transport_t transport;
+	dc_thread_t *thread;
+	dc_status_t status;
+} dc_descriptor_scan_worker_t;
+
+static const dc_transport_t g_scan_transports[] = {
+	DC_TRANSPORT_SERIAL,
+	DC_TRANSPORT_USB,
+	DC_TRANSPORT_USBHID,
+	DC_TRANSPORT_IRDA,
+	DC_TRANSPORT_BLUETOOTH,
+};
+
+static void
+dc_descriptor_scan_device_free (dc_transport_t transport, void *device)
+{
+	switch (transport) {
+	case DC_TRANSPORT_SERIAL:
+		dc_serial_device_free ((dc_serial_device_t *) device);
+		break;
+	case DC_TRANSPORT_USB:
+		dc_usb_device_free ((dc_usb_device_t *) device);
+		break;
+	case DC_TRANSPORT_USBHID:
+		dc_usbhid_device_free ((dc_usbhid_device_t *) device);
+		break;
+	case DC_TRANSPORT_IRDA:
+		dc_irda_device_free ((dc_irda_device_t *) device);
+		break;
+	case DC_TRANSPORT_BLUETOOTH:
+		dc_bluetooth_device_free ((dc_bluetooth_device_t *) device);
+		break;
+	default:
+		break;
+	}
+}
+
+static void
+dc_descriptor_scan_worker (void *userdata)
+{
+	dc_descriptor_scan_worker_t *worker = (dc_descriptor_scan_worker_t *) userdata;
+	dc_descriptor_scan_t *scan = worker->scan;
+	dc_status_t status = DC_STATUS_SUCCESS;
+	dc_iterator_t *iterator = NULL;
+
+	switch (worker->transport) {
+	case DC_TRANSPORT_SERIAL:
+		status = dc_serial_iterator_new (&iterator, worker->context, scan->descriptor);
+		break;
+	case DC_TRANSPORT_USB:
+		status = dc_usb_iterator_new (&iterator, worker->context, scan->descriptor);
+		break;
+	case DC_TRANSPORT_USBHID:
+		status = dc_usbhid_iterator_new (&iterator, worker->context, scan->descriptor);
+		break;
+	case DC_TRANSPORT_IRDA:
+		status = dc_irda_iterator_new (&iterator, worker->context, scan->descriptor);
+		break;
+	case DC_TRANSPORT_BLUETOOTH:
+		status = dc_bluetooth_iterator_new (&iterator, worker->context, scan->descriptor);
+		break;
+	default:
+		status = DC_STATUS_UNSUPPORTED;
+		break;
+	}
+	if (status != DC_STATUS_SUCCESS) {
+		worker->status = status;
+		return;
+	}
+
+	void *device = NULL;
+	while ((status = dc_iterator_next (iterator, &device)) == DC_STATUS_SUCCESS) {
+		// Report the device, unless the scan has already been stopped.
+		dc_mutex_lock (&scan->mutex);
+		int report = !scan->stop;
+		if (report && !scan->callback (worker->transport, device, scan->userdata))
+			scan->stop = 1;
+		int stop = scan->stop;
+		dc_mutex_unlock (&scan->mutex);
+
+		if (!report)
+			dc_descriptor_scan_device_free (worker->transport, device);
+
+		if (stop) {
+			status = DC_STATUS_DONE;
+			break;
+		}
+	}
+
+	dc_iterator_free (iterator);
+
+	worker->status = (status == DC_STATUS_DONE) ? DC_STATUS_SUCCESS : status;
+}
+
+dc_status_t
+dc_descriptor_scan (dc_context_t *context, dc_descriptor_t *descriptor, unsigned int transports, dc_descriptor_scan_callback_t callback, void *userdata)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	dc_descriptor_scan_worker_t workers[C_ARRAY_SIZE (g_scan_transports)];
+	unsigned int nworkers = 0;
+
+	if (callback == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	if (descriptor)
+		transports &= dc_descriptor_get_transports (descriptor);
+
+	dc_descriptor_scan_t scan = {
+		descriptor,
+		callback, userdata,
+		DC_MUTEX_INIT, 0};
+
+	for (size_t i = 0; i < C_ARRAY_SIZE (g_scan_transports); ++i) {
+		if ((transports & g_scan_transports[i]) == 0)
+			continue;
+
+		dc_descriptor_scan_worker_t *worker = workers + nworkers;
+		worker->scan = &scan;
+		worker->context = context;
+		worker->transport = g_scan_transports[i];
+		worker->thread = NULL;
+		worker->status = DC_STATUS_SUCCESS;
+
+		nworkers++;
+	}
+
+	// Start the worker threads. The calling thread scans the first
+	// transport, and also any transport for which no thread can be
+	// started.
+	for (unsigned int i = 1; i < nworkers; ++i) {
+		if (dc_thread_new (&workers[i].thread, dc_descriptor_scan_worker, workers + i) != DC_STATUS_SUCCESS) {
+			workers[i].thread = NULL;
+		}
+	}
+
+	for (unsigned int i = 0; i < nworkers; ++i) {
+		if (i == 0 || workers[i].thread == NULL)
+			dc_descriptor_scan_worker (workers + i);
+	}
+
+	for (unsigned int i = 1; i < nworkers; ++i) {
+		if (workers[i].thread)
+			dc_thread_join (workers[i].thread);
+	}
+
+	// Report the first error, in transport order.
+	for (unsigned int i = 0; i < nworkers; ++i) {
+		if (workers[i].status != DC_STATUS_SUCCESS &&
+			workers[i].status != DC_STATUS_UNSUPPORTED) {
+			status = workers[i].status;
+			break;
+		}
+	}
+
+	return status;
+}
@@ -28,6 +28,8 @@
 #include <libdivecomputer/device.h>
 
 #include "common-private.h"
+#include "iostream-private.h"
+#include "timer.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -35,10 +37,29 @@ extern "C" {
 
 #define EVENT_PROGRESS_INITIALIZER {0, UINT_MAX}
 
+#define CHECKPOINT_HEADER  12
+#define CHECKPOINT_MAXSIZE (CHECKPOINT_HEADER + 2 * 32)
+
 struct dc_device_t;
 struct dc_device_vtable_t;
+struct dc_device_pipeline_t;
 
 typedef struct dc_device_vtable_t dc_device_vtable_t;
+typedef struct dc_device_pipeline_t dc_device_pipeline_t;
+
+/*
+ * The phases of an operation, for the timing statistics. The time is
+ * accounted to the current phase, until the next phase starts.
+ */
+typedef enum device_phase_t {
+	DEVICE_PHASE_NONE,
+	DEVICE_PHASE_HANDSHAKE,
+	DEVICE_PHASE_LOGBOOK,
+	DEVICE_PHASE_PROFILE,
+	DEVICE_PHASE_CHECKSUM,
+	DEVICE_PHASE_CALLBACK,
+	DEVICE_PHASE_COUNT
+} device_phase_t;
 
 struct dc_device_t {
 	const dc_device_vtable_t *vtable;
@@ -51,9 +72,41 @@ struct dc_device_t {
 	// Cancellation support.
 	dc_cancel_callback_t cancel_callback;
 	void *cancel_userdata;
+	dc_interrupt_t *interrupt;
 	// Cached events for the parsers.
 	dc_event_devinfo_t devinfo;
 	dc_event_clock_t clock;
+	// Download checkpoint.
+	unsigned char checkpoint[CHECKPOINT_MAXSIZE];
+	unsigned int checkpoint_size;
+	// Progress event throttling.
+	dc_timer_t *timer;
+	unsigned int progress_interval;
+	unsigned int progress_delta;
+	dc_usecs_t progress_time;
+	dc_event_progress_t progress;
+	// Streaming memory dump.
+	dc_dump_callback_t dump_callback;
+	void *dump_userdata;
+	dc_buffer_t *dump_buffer;
+	unsigned int dump_streamed;
+	// Previous memory dump, for an incremental dump.
+	dc_buffer_t *dump_previous;
+	// Selected dives, for a selective download.
+	const unsigned char *selection;
+	unsigned int selection_fsize;
+	unsigned int selection_count;
+	// Pipelined dive delivery.
+	unsigned int pipeline_depth;
+	dc_device_pipeline_t *pipeline;
+	// Statistics of the most recent operation.
+	dc_iostream_t *iostream;
+	dc_iostream_stats_t iostats;
+	unsigned int noperations;
+	device_phase_t phase;
+	dc_usecs_t phase_time;
+	dc_usecs_t phases[DEVICE_PHASE_COUNT];
+	unsigned int nretries;
 };
 
 struct dc_device_vtable_t {
@@ -65,12 +118,16 @@ struct dc_device_vtable_t {
 
 	dc_status_t (*read) (dc_device_t *device, unsigned int address, unsigned char data[], unsigned int size);
 
+	dc_status_t (*read_range) (dc_device_t *device, unsigned int address, unsigned char data[], unsigned int size, dc_event_progress_t *progress);
+
 	dc_status_t (*write) (dc_device_t *device, unsigned int address, const unsigned char data[], unsigned int size);
 
 	dc_status_t (*dump) (dc_device_t *device, dc_buffer_t *buffer);
 
 	dc_status_t (*foreach) (dc_device_t *device, dc_dive_callback_t callback, void *userdata);
 
+	dc_status_t (*foreach_header) (dc_device_t *device, dc_dive_callback_t callback, void *userdata);
+
 	dc_status_t (*timesync) (dc_device_t *device, const dc_datetime_t *datetime);
 
 	dc_status_t (*close) (dc_device_t *device);
@@ -91,9 +148,118 @@ device_event_emit (dc_device_t *device, dc_event_type_t event, const void *data)
 int
 device_is_cancelled (dc_device_t *device);
 
+int
+device_checkpoint_get (dc_device_t *device, unsigned int *address, unsigned char first[], unsigned char last[], unsigned int fsize);
+
+void
+device_checkpoint_set (dc_device_t *device, unsigned int address, const unsigned char first[], const unsigned char last[], unsigned int fsize);
+
+void
+device_checkpoint_clear (dc_device_t *device);
+
+/*
+ * Check whether a dive is left out by a selective download, such that
+ * the backend can skip downloading it. Without a selection, no dive is
+ * left out.
+ */
+int
+device_is_excluded (dc_device_t *device, const unsigned char fingerprint[], unsigned int fsize);
+
+/*
+ * Get the previous memory dump of an incremental dump, if there is one
+ * with the expected size.
+ */
+const unsigned char *
+device_dump_previous (dc_device_t *device, unsigned int size);
+
 dc_status_t
 device_dump_read (dc_device_t *device, unsigned int address, unsigned char data[], unsigned int size, unsigned int blocksize);
 
+/*
+ * Switch to another phase of the current operation, and return the
+ * previous phase, such that it can be restored afterwards.
+ */
+device_phase_t
+device_phase_set (dc_device_t *device, device_phase_t phase);
+
+void
+device_stats_retry (dc_device_t *device);
+
+/*
+ * An adaptive delay between two commands, in milliseconds. After a
+ * failed attempt, the delay grows towards the maximum. After a number
+ * of consecutive successful transfers, it shrinks again towards the
+ * minimum, so a single burst of errors doesn't slow down the rest of
+ * the download.
+ */
+typedef struct device_delay_t {
+	unsigned int minimum;
+	unsigned int maximum;
+	unsigned int current;
+	unsigned int nsuccess;
+} device_delay_t;
+
+void
+device_delay_init (device_delay_t *delay, unsigned int minimum, unsigned int maximum);
+
+void
+device_delay_wait (device_delay_t *delay, dc_iostream_t *iostream);
+
+void
+device_delay_success (device_delay_t *delay);
+
+void
+device_delay_failure (device_delay_t *delay);
+
+/*
+ * Retry policy for the device_transfer_retry function. Only timeouts
+ * and protocol errors are retried, at most maxretries times. Before the
+ * next attempt, the helper waits for the delay (in milliseconds) and
+ * discards any pending input if requested. The delay is doubled for
+ * every consecutive retry, up to eight times the initial value.
+ *
+ * If the maximum timeout is non-zero, the timeout of each attempt is
+ * derived from the measured round-trip times, and clamped to the range
+ * [minimum, maximum]. The maximum timeout is used until the first
+ * measurement is available. The timeout remains in effect afterwards,
+ * so backends should only enable it if all their transfers go through
+ * the helper.
+ */
+typedef struct device_retry_t {
+	unsigned int maxretries;
+	unsigned int delay;
+	unsigned int purge;
+	int minimum;
+	int maximum;
+} device_retry_t;
+
+/*
+ * A single attempt of the transfer. The attempt number is zero for
+ * the first attempt, and increments for every retry.
+ */
+typedef dc_status_t (*device_attempt_t) (dc_device_t *device, unsigned int attempt, void *userdata);
+
+dc_status_t
+device_transfer_retry (dc_device_t *device, dc_iostream_t *iostream, const device_retry_t *policy, device_attempt_t attempt, void *userdata);
+
+/*
+ * Probe whether the device responds at the current baudrate.
+ */
+typedef dc_status_t (*device_probe_t) (dc_device_t *device, void *userdata);
+
+/*
+ * Negotiate the fastest baudrate supported by both the device and the
+ * serial driver. The candidates are taken from the baudrate table of
+ * the device family, starting with the hint (if non-zero) and then
+ * ordered from fast to slow. If the driver rejects a baudrate, or the
+ * probe fails with a timeout or protocol error, the next candidate is
+ * tried. The last error is returned if none of them succeeds.
+ */
+dc_status_t
+device_baudrate_negotiate (dc_device_t *device, dc_iostream_t *iostream, unsigned int hint,
+	unsigned int databits, dc_parity_t parity, dc_stopbits_t stopbits, dc_flowcontrol_t flowcontrol,
+	device_probe_t probe, void *userdata);
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
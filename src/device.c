@@ -19,6 +19,10 @@
  * MA 02110-1301 USA
  */
 
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
 #include <assert.h>
 #include <stdlib.h>
 #include <string.h>
@@ -71,6 +75,73 @@
 
 #include "device-private.h"
 #include "context-private.h"
+#include "serial-private.h"
+#include "array.h"
+#include "thread.h"
+
+// Maximum number of times the retry delay is doubled.
+#define RETRY_BACKOFF 3
+
+// Number of consecutive successes before an adaptive delay shrinks.
+#define DELAY_DECAY 16
+
+typedef struct dc_device_pipeline_entry_t {
+	unsigned char *data;
+	unsigned int size;
+	unsigned char *fingerprint;
+	unsigned int fsize;
+} dc_device_pipeline_entry_t;
+
+struct dc_device_pipeline_t {
+	dc_device_t *device;
+	dc_dive_callback_t callback;
+	void *userdata;
+	dc_mutex_t mutex;
+	dc_cond_t *notempty;
+	dc_cond_t *notfull;
+	dc_device_pipeline_entry_t *entries;
+	unsigned int depth;
+	unsigned int head;
+	unsigned int count;
+	size_t queued;
+	unsigned int finished;
+	unsigned int stopped;
+	unsigned int dropped;
+	dc_status_t status;
+	dc_usecs_t elapsed;
+};
+
+/*
+ * Baudrates supported by each family, from fast to slow. Families with
+ * a single fixed baudrate are not listed.
+ */
+typedef struct dc_device_baudrates_t {
+	dc_family_t family;
+	unsigned int baudrates[4];
+} dc_device_baudrates_t;
+
+static const dc_device_baudrates_t g_baudrates[] = {
+	{DC_FAMILY_SUUNTO_D9, {115200, 9600}},
+};
+
+/*
+ * Tracing spans of the phases. The handshake is covered by the span of
+ * dc_device_open, because a failed open never ends the phase.
+ */
+static const char *g_phase_spans[DEVICE_PHASE_COUNT] = {
+	NULL,
+	NULL,
+	"device.logbook",
+	"device.profile",
+	"device.checksum",
+	"device.callback",
+};
+
+typedef struct dc_device_callback_t {
+	dc_device_t *device;
+	dc_dive_callback_t callback;
+	void *userdata;
+} dc_device_callback_t;
 
 dc_device_t *
 dc_device_allocate (dc_context_t *context, const dc_device_vtable_t *vtable)
@@ -81,7 +152,7 @@ dc_device_allocate (dc_context_t *context, const dc_device_vtable_t *vtable)
 	assert(vtable->size >= sizeof(dc_device_t));
 
 	// Allocate memory.
-	device = (dc_device_t *) malloc (vtable->size);
+	device = (dc_device_t *) dc_context_malloc (context, vtable->size);
 	if (device == NULL) {
 		ERROR (context, "Failed to allocate memory.");
 		return device;
@@ -98,16 +169,124 @@ dc_device_allocate (dc_context_t *context, const dc_device_vtable_t *vtable)
 	device->cancel_callback = NULL;
 	device->cancel_userdata = NULL;
 
+	// Without the cancellation event, blocking waits are only cancelled
+	// when they time out.
+	if (dc_interrupt_new (&device->interrupt) != DC_STATUS_SUCCESS) {
+		WARNING (context, "Failed to create the cancellation event.");
+		device->interrupt = NULL;
+	}
+
 	memset (&device->devinfo, 0, sizeof (device->devinfo));
 	memset (&device->clock, 0, sizeof (device->clock));
 
+	memset (device->checkpoint, 0, sizeof (device->checkpoint));
+	device->checkpoint_size = 0;
+
+	device->timer = NULL;
+	device->progress_interval = 0;
+	device->progress_delta = 0;
+	device->progress_time = 0;
+	memset (&device->progress, 0, sizeof (device->progress));
+
+	device->dump_callback = NULL;
+	device->dump_userdata = NULL;
+	device->dump_buffer = NULL;
+	device->dump_streamed = 0;
+	device->dump_previous = NULL;
+
+	device->selection = NULL;
+	device->selection_fsize = 0;
+	device->selection_count = 0;
+
+	device->pipeline_depth = 0;
+	device->pipeline = NULL;
+
+	// The statistics timer is optional.
+	if (dc_timer_new (&device->timer) != DC_STATUS_SUCCESS) {
+		WARNING (context, "Failed to create a high resolution timer.");
+		device->timer = NULL;
+	}
+
+	// The open function counts as the first operation, which is finished
+	// by dc_device_open.
+	device->iostream = NULL;
+	memset (&device->iostats, 0, sizeof (device->iostats));
+	device->noperations = 1;
+	device->phase = DEVICE_PHASE_HANDSHAKE;
+	device->phase_time = 0;
+	memset (device->phases, 0, sizeof (device->phases));
+	device->nretries = 0;
+	if (device->timer)
+		dc_timer_now (device->timer, &device->phase_time);
+
 	return device;
 }
 
 void
 dc_device_deallocate (dc_device_t *device)
 {
-	free (device);
+	if (device) {
+		dc_interrupt_free (device->interrupt);
+		dc_timer_free (device->timer);
+		dc_context_release (device->context, device);
+	}
+}
+
+static void
+device_phase_span (dc_device_t *device, device_phase_t previous, device_phase_t phase)
+{
+	if (previous == phase || !SPAN_ENABLED (device->context))
+		return;
+
+	if (g_phase_spans[previous])
+		SPAN_END (device->context, g_phase_spans[previous], 0);
+	if (g_phase_spans[phase])
+		SPAN_BEGIN (device->context, g_phase_spans[phase]);
+}
+
+static dc_usecs_t
+device_stats_now (dc_device_t *device)
+{
+	dc_usecs_t now = 0;
+
+	if (device->timer)
+		dc_timer_now (device->timer, &now);
+
+	return now;
+}
+
+/*
+ * Start an operation in the given phase. The backends also call the
+ * public functions internally, so the statistics are only reset by the
+ * outermost operation. The handshake time is kept, because it's only
+ * measured once.
+ */
+static void
+device_stats_begin (dc_device_t *device, device_phase_t phase)
+{
+	if (device->noperations++)
+		return;
+
+	dc_usecs_t handshake = device->phases[DEVICE_PHASE_HANDSHAKE];
+	memset (device->phases, 0, sizeof (device->phases));
+	device->phases[DEVICE_PHASE_HANDSHAKE] = handshake;
+
+	if (device->iostream)
+		device->iostats = device->iostream->stats;
+	device->nretries = 0;
+
+	device_phase_span (device, device->phase, phase);
+	device->phase = phase;
+	device->phase_time = device_stats_now (device);
+}
+
+static dc_status_t
+device_stats_end (dc_device_t *device, dc_status_t status)
+{
+	if (--device->noperations == 0)
+		device_phase_set (device, DEVICE_PHASE_NONE);
+
+	return status;
 }
 
 dc_status_t
@@ -119,7 +298,16 @@ dc_device_open (dc_device_t **out, dc_context_t *context, dc_descriptor_t *descr
 	if (out == NULL || descriptor == NULL)
 		return DC_STATUS_INVALIDARGS;
 
+	// Take a snapshot of the transfer statistics, to include the
+	// handshake in the statistics.
+	dc_iostream_stats_t iostats = {0};
+	if (iostream)
+		iostats = iostream->stats;
+
+	SPAN_BEGIN (context, "device.open");
+
 	switch (dc_descriptor_get_type (descriptor)) {
+#ifndef DISABLE_BACKEND_SUUNTO
 	case DC_FAMILY_SUUNTO_SOLUTION:
 		rc = suunto_solution_device_open (&device, context, iostream);
 		break;
@@ -138,6 +326,8 @@ dc_device_open (dc_device_t **out, dc_context_t *context, dc_descriptor_t *descr
 	case DC_FAMILY_SUUNTO_EONSTEEL:
 		rc = suunto_eonsteel_device_open (&device, context, iostream, dc_descriptor_get_model (descriptor));
 		break;
+#endif
+#ifndef DISABLE_BACKEND_UWATEC
 	case DC_FAMILY_UWATEC_ALADIN:
 		rc = uwatec_aladin_device_open (&device, context, iostream);
 		break;
@@ -147,6 +337,8 @@ dc_device_open (dc_device_t **out, dc_context_t *context, dc_descriptor_t *descr
 	case DC_FAMILY_UWATEC_SMART:
 		rc = uwatec_smart_device_open (&device, context, iostream);
 		break;
+#endif
+#ifndef DISABLE_BACKEND_REEFNET
 	case DC_FAMILY_REEFNET_SENSUS:
 		rc = reefnet_sensus_device_open (&device, context, iostream);
 		break;
@@ -156,6 +348,8 @@ dc_device_open (dc_device_t **out, dc_context_t *context, dc_descriptor_t *descr
 	case DC_FAMILY_REEFNET_SENSUSULTRA:
 		rc = reefnet_sensusultra_device_open (&device, context, iostream);
 		break;
+#endif
+#ifndef DISABLE_BACKEND_OCEANIC
 	case DC_FAMILY_OCEANIC_VTPRO:
 		rc = oceanic_vtpro_device_open (&device, context, iostream, dc_descriptor_get_model (descriptor));
 		break;
@@ -165,6 +359,8 @@ dc_device_open (dc_device_t **out, dc_context_t *context, dc_descriptor_t *descr
 	case DC_FAMILY_OCEANIC_ATOM2:
 		rc = oceanic_atom2_device_open (&device, context, iostream, dc_descriptor_get_model (descriptor));
 		break;
+#endif
+#ifndef DISABLE_BACKEND_MARES
 	case DC_FAMILY_MARES_NEMO:
 		rc = mares_nemo_device_open (&device, context, iostream);
 		break;
@@ -177,6 +373,8 @@ dc_device_open (dc_device_t **out, dc_context_t *context, dc_descriptor_t *descr
 	case DC_FAMILY_MARES_ICONHD:
 		rc = mares_iconhd_device_open (&device, context, iostream);
 		break;
+#endif
+#ifndef DISABLE_BACKEND_HW
 	case DC_FAMILY_HW_OSTC:
 		rc = hw_ostc_device_open (&device, context, iostream);
 		break;
@@ -186,6 +384,8 @@ dc_device_open (dc_device_t **out, dc_context_t *context, dc_descriptor_t *descr
 	case DC_FAMILY_HW_OSTC3:
 		rc = hw_ostc3_device_open (&device, context, iostream);
 		break;
+#endif
+#ifndef DISABLE_BACKEND_CRESSI
 	case DC_FAMILY_CRESSI_EDY:
 		rc = cressi_edy_device_open (&device, context, iostream);
 		break;
@@ -195,66 +395,115 @@ dc_device_open (dc_device_t **out, dc_context_t *context, dc_descriptor_t *descr
 	case DC_FAMILY_CRESSI_GOA:
 		rc = cressi_goa_device_open (&device, context, iostream);
 		break;
+#endif
+#ifndef DISABLE_BACKEND_ZEAGLE
 	case DC_FAMILY_ZEAGLE_N2ITION3:
 		rc = zeagle_n2ition3_device_open (&device, context, iostream);
 		break;
+#endif
+#ifndef DISABLE_BACKEND_ATOMICS
 	case DC_FAMILY_ATOMICS_COBALT:
 		rc = atomics_cobalt_device_open (&device, context, iostream);
 		break;
+#endif
+#ifndef DISABLE_BACKEND_SHEARWATER
 	case DC_FAMILY_SHEARWATER_PREDATOR:
 		rc = shearwater_predator_device_open (&device, context, iostream);
 		break;
 	case DC_FAMILY_SHEARWATER_PETREL:
 		rc = shearwater_petrel_device_open (&device, context, iostream);
 		break;
+#endif
+#ifndef DISABLE_BACKEND_DIVERITE
 	case DC_FAMILY_DIVERITE_NITEKQ:
 		rc = diverite_nitekq_device_open (&device, context, iostream);
 		break;
+#endif
+#ifndef DISABLE_BACKEND_CITIZEN
 	case DC_FAMILY_CITIZEN_AQUALAND:
 		rc = citizen_aqualand_device_open (&device, context, iostream);
 		break;
+#endif
+#ifndef DISABLE_BACKEND_DIVESYSTEM
 	case DC_FAMILY_DIVESYSTEM_IDIVE:
 		rc = divesystem_idive_device_open (&device, context, iostream, dc_descriptor_get_model (descriptor));
 		break;
+#endif
+#ifndef DISABLE_BACKEND_COCHRAN
 	case DC_FAMILY_COCHRAN_COMMANDER:
 		rc = cochran_commander_device_open (&device, context, iostream);
 		break;
+#endif
+#ifndef DISABLE_BACKEND_TECDIVING
 	case DC_FAMILY_TECDIVING_DIVECOMPUTEREU:
 		rc = tecdiving_divecomputereu_device_open (&device, context, iostream);
 		break;
+#endif
+#ifndef DISABLE_BACKEND_MCLEAN
 	case DC_FAMILY_MCLEAN_EXTREME:
 		rc = mclean_extreme_device_open (&device, context, iostream);
 		break;
+#endif
+#ifndef DISABLE_BACKEND_LIQUIVISION
 	case DC_FAMILY_LIQUIVISION_LYNX:
 		rc = liquivision_lynx_device_open (&device, context, iostream);
 		break;
+#endif
+#ifndef DISABLE_BACKEND_SPORASUB
 	case DC_FAMILY_SPORASUB_SP2:
 		rc = sporasub_sp2_device_open (&device, context, iostream);
 		break;
+#endif
+#ifndef DISABLE_BACKEND_DEEPSIX
 	case DC_FAMILY_DEEPSIX_EXCURSION:
 		rc = deepsix_excursion_device_open (&device, context, iostream);
 		break;
+#endif
+#ifndef DISABLE_BACKEND_SEAC
 	case DC_FAMILY_SEAC_SCREEN:
 		rc = seac_screen_device_open (&device, context, iostream);
 		break;
+#endif
+#ifndef DISABLE_BACKEND_DEEPBLU
 	case DC_FAMILY_DEEPBLU_COSMIQ:
 		rc = deepblu_cosmiq_device_open (&device, context, iostream);
 		break;
+#endif
+#ifndef DISABLE_BACKEND_OCEANS
 	case DC_FAMILY_OCEANS_S1:
 		rc = oceans_s1_device_open (&device, context, iostream);
 		break;
+#endif
+#ifndef DISABLE_BACKEND_DIVESOFT
 	case DC_FAMILY_DIVESOFT_FREEDOM:
 		rc = divesoft_freedom_device_open (&device, context, iostream);
 		break;
+#endif
 	default:
 		return DC_STATUS_INVALIDARGS;
 
 	// Not merged upstream yet
+#ifndef DISABLE_BACKEND_GARMIN
 	case DC_FAMILY_GARMIN:
 		rc = garmin_device_open (&device, context, iostream, dc_descriptor_get_model (descriptor));
 		break;
+#endif
+	}
+
+	if (device) {
+		device->iostream = iostream;
+		device->iostats = iostats;
+		dc_iostream_set_interrupt (iostream, device->interrupt);
+		device_stats_end (device, rc);
 	}
 
+	// Remember which descriptor works on the serial port, such that the
+	// iterator returns the port first next time.
+	if (rc == DC_STATUS_SUCCESS)
+		dc_serial_remember (iostream, descriptor);
+
+	SPAN_END (context, "device.open", 0);
+
 	*out = device;
 
 	return rc;
@@ -294,6 +543,21 @@ dc_device_set_cancel (dc_device_t *device, dc_cancel_callback_t callback, void *
 }
 
 
+dc_status_t
+dc_device_cancel (dc_device_t *device)
+{
+	if (device == NULL)
+		return DC_STATUS_UNSUPPORTED;
+
+	if (device->interrupt == NULL)
+		return DC_STATUS_UNSUPPORTED;
+
+	dc_interrupt_set (device->interrupt);
+
+	return DC_STATUS_SUCCESS;
+}
+
+
 dc_status_t
 dc_device_set_events (dc_device_t *device, unsigned int events, dc_event_callback_t callback, void *userdata)
 {
@@ -321,6 +585,112 @@ dc_device_set_fingerprint (dc_device_t *device, const unsigned char data[], unsi
 }
 
 
+dc_status_t
+dc_device_set_progress (dc_device_t *device, unsigned int interval, unsigned int delta)
+{
+	if (device == NULL)
+		return DC_STATUS_UNSUPPORTED;
+
+	if (interval && device->timer == NULL) {
+		dc_status_t status = dc_timer_new (&device->timer);
+		if (status != DC_STATUS_SUCCESS) {
+			ERROR (device->context, "Failed to create a high resolution timer.");
+			return status;
+		}
+	}
+
+	device->progress_interval = interval;
+	device->progress_delta = delta;
+	memset (&device->progress, 0, sizeof (device->progress));
+
+	return DC_STATUS_SUCCESS;
+}
+
+
+dc_status_t
+dc_device_set_pipeline (dc_device_t *device, unsigned int depth)
+{
+	if (device == NULL)
+		return DC_STATUS_UNSUPPORTED;
+
+	device->pipeline_depth = depth;
+
+	return DC_STATUS_SUCCESS;
+}
+
+
+dc_status_t
+dc_device_set_checkpoint (dc_device_t *device, const unsigned char data[], unsigned int size)
+{
+	if (device == NULL)
+		return DC_STATUS_UNSUPPORTED;
+
+	if (size > sizeof (device->checkpoint))
+		return DC_STATUS_INVALIDARGS;
+
+	if (size && data == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	if (size)
+		memcpy (device->checkpoint, data, size);
+	device->checkpoint_size = size;
+
+	return DC_STATUS_SUCCESS;
+}
+
+
+dc_status_t
+dc_device_get_checkpoint (dc_device_t *device, dc_buffer_t *buffer)
+{
+	if (device == NULL)
+		return DC_STATUS_UNSUPPORTED;
+
+	if (buffer == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	dc_buffer_clear (buffer);
+
+	if (!dc_buffer_append (buffer, device->checkpoint, device->checkpoint_size))
+		return DC_STATUS_NOMEMORY;
+
+	return DC_STATUS_SUCCESS;
+}
+
+
+dc_status_t
+dc_device_get_stats (dc_device_t *device, dc_device_stats_t *stats)
+{
+	if (device == NULL)
+		return DC_STATUS_UNSUPPORTED;
+
+	if (stats == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	memset (stats, 0, sizeof (*stats));
+
+	stats->handshake = device->phases[DEVICE_PHASE_HANDSHAKE] / 1000;
+	stats->logbook = device->phases[DEVICE_PHASE_LOGBOOK] / 1000;
+	stats->profile = device->phases[DEVICE_PHASE_PROFILE] / 1000;
+	stats->checksum = device->phases[DEVICE_PHASE_CHECKSUM] / 1000;
+	stats->callback = device->phases[DEVICE_PHASE_CALLBACK] / 1000;
+
+	if (device->iostream) {
+		const dc_iostream_stats_t *current = &device->iostream->stats;
+		stats->nread = current->nread - device->iostats.nread;
+		stats->nwritten = current->nwritten - device->iostats.nwritten;
+		stats->npackets = current->npackets - device->iostats.npackets;
+		stats->ntimeouts = current->ntimeouts - device->iostats.ntimeouts;
+		stats->rtt = device->iostream->rtt.srtt / 1000;
+		stats->rttvar = device->iostream->rtt.rttvar / 1000;
+		stats->baudrate = device->iostream->baudrate;
+	}
+
+	stats->nretries = device->nretries;
+
+	return DC_STATUS_SUCCESS;
+}
+
+
 dc_status_t
 dc_device_read (dc_device_t *device, unsigned int address, unsigned char data[], unsigned int size)
 {
@@ -330,7 +700,13 @@ dc_device_read (dc_device_t *device, unsigned int address, unsigned char data[],
 	if (device->vtable->read == NULL)
 		return DC_STATUS_UNSUPPORTED;
 
-	return device->vtable->read (device, address, data, size);
+	device_stats_begin (device, DEVICE_PHASE_PROFILE);
+
+	SPAN_BEGIN (device->context, "device.read");
+	dc_status_t status = device->vtable->read (device, address, data, size);
+	SPAN_END (device->context, "device.read", size);
+
+	return device_stats_end (device, status);
 }
 
 
@@ -343,7 +719,9 @@ dc_device_write (dc_device_t *device, unsigned int address, const unsigned char
 	if (device->vtable->write == NULL)
 		return DC_STATUS_UNSUPPORTED;
 
-	return device->vtable->write (device, address, data, size);
+	device_stats_begin (device, DEVICE_PHASE_NONE);
+
+	return device_stats_end (device, device->vtable->write (device, address, data, size));
 }
 
 
@@ -361,7 +739,189 @@ dc_device_dump (dc_device_t *device, dc_buffer_t *buffer)
 
 	dc_buffer_clear (buffer);
 
-	return device->vtable->dump (device, buffer);
+	device_stats_begin (device, DEVICE_PHASE_PROFILE);
+
+	return device_stats_end (device, device->vtable->dump (device, buffer));
+}
+
+
+dc_status_t
+dc_device_dump_incremental (dc_device_t *device, dc_buffer_t *previous, dc_buffer_t *buffer)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+
+	if (previous == NULL || previous == buffer)
+		return DC_STATUS_INVALIDARGS;
+
+	if (device == NULL)
+		return DC_STATUS_UNSUPPORTED;
+
+	device->dump_previous = previous;
+	status = dc_device_dump (device, buffer);
+	device->dump_previous = NULL;
+
+	return status;
+}
+
+
+dc_status_t
+dc_device_dump_stream (dc_device_t *device, dc_dump_callback_t callback, void *userdata)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+
+	if (device == NULL)
+		return DC_STATUS_UNSUPPORTED;
+
+	if (device->vtable->dump == NULL)
+		return DC_STATUS_UNSUPPORTED;
+
+	if (callback == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	// The backends still assemble the memory dump in a buffer, but every
+	// chunk read into that buffer is passed on immediately.
+	dc_buffer_t *buffer = dc_buffer_new_context (device->context, 0);
+	if (buffer == NULL) {
+		ERROR (device->context, "Failed to allocate memory.");
+		return DC_STATUS_NOMEMORY;
+	}
+
+	device->dump_callback = callback;
+	device->dump_userdata = userdata;
+	device->dump_buffer = buffer;
+	device->dump_streamed = 0;
+
+	device_stats_begin (device, DEVICE_PHASE_PROFILE);
+
+	status = device->vtable->dump (device, buffer);
+
+	// Backends that don't read directly into the buffer (or only partly)
+	// pass the complete memory dump at the end.
+	if (status == DC_STATUS_SUCCESS && device->dump_streamed != dc_buffer_get_size (buffer)) {
+		if (!callback (0, dc_buffer_get_data (buffer), dc_buffer_get_size (buffer), userdata))
+			status = DC_STATUS_CANCELLED;
+	}
+
+	device->dump_callback = NULL;
+	device->dump_userdata = NULL;
+	device->dump_buffer = NULL;
+	device->dump_streamed = 0;
+
+	dc_buffer_free (buffer);
+
+	return device_stats_end (device, status);
+}
+
+
+/*
+ * The checkpoint layout is:
+ *
+ *   0  family (uint32, little endian)
+ *   4  serial number (uint32, little endian)
+ *   8  resume address (uint32, little endian)
+ *  12  fingerprint of the most recent dive
+ *  12 + fsize  fingerprint of the last delivered dive
+ *
+ * A checkpoint is only accepted if it was created by the same family and
+ * serial number, with the same fingerprint size.
+ */
+
+int
+device_checkpoint_get (dc_device_t *device, unsigned int *address, unsigned char first[], unsigned char last[], unsigned int fsize)
+{
+	if (device == NULL)
+		return 0;
+
+	// A selective download neither resumes nor updates the checkpoint,
+	// because it doesn't deliver the dives in between.
+	if (device->selection)
+		return 0;
+
+	if (fsize == 0 || device->checkpoint_size != CHECKPOINT_HEADER + 2 * fsize)
+		return 0;
+
+	const unsigned char *data = device->checkpoint;
+	if (array_uint32_le (data + 0) != device->vtable->type ||
+		array_uint32_le (data + 4) != device->devinfo.serial) {
+		WARNING (device->context, "Ignoring checkpoint for a different device.");
+		return 0;
+	}
+
+	if (address)
+		*address = array_uint32_le (data + 8);
+	if (first)
+		memcpy (first, data + CHECKPOINT_HEADER, fsize);
+	if (last)
+		memcpy (last, data + CHECKPOINT_HEADER + fsize, fsize);
+
+	return 1;
+}
+
+
+void
+device_checkpoint_set (dc_device_t *device, unsigned int address, const unsigned char first[], const unsigned char last[], unsigned int fsize)
+{
+	if (device == NULL || device->selection)
+		return;
+
+	if (CHECKPOINT_HEADER + 2 * fsize > sizeof (device->checkpoint)) {
+		device->checkpoint_size = 0;
+		return;
+	}
+
+	unsigned char *data = device->checkpoint;
+	array_uint32_le_set (data + 0, device->vtable->type);
+	array_uint32_le_set (data + 4, device->devinfo.serial);
+	array_uint32_le_set (data + 8, address);
+	memcpy (data + CHECKPOINT_HEADER, first, fsize);
+	memcpy (data + CHECKPOINT_HEADER + fsize, last, fsize);
+	device->checkpoint_size = CHECKPOINT_HEADER + 2 * fsize;
+}
+
+
+void
+device_checkpoint_clear (dc_device_t *device)
+{
+	if (device == NULL || device->selection)
+		return;
+
+	device->checkpoint_size = 0;
+}
+
+
+const unsigned char *
+device_dump_previous (dc_device_t *device, unsigned int size)
+{
+	if (device == NULL || device->dump_previous == NULL)
+		return NULL;
+
+	if (dc_buffer_get_size (device->dump_previous) != size) {
+		WARNING (device->context, "Ignoring previous dump with a different size.");
+		return NULL;
+	}
+
+	return dc_buffer_get_data (device->dump_previous);
+}
+
+
+/*
+ * Pass a chunk to the streaming dump callback, if it's part of the
+ * memory dump. Returns zero if the callback cancelled the download.
+ */
+static int
+device_dump_deliver (dc_device_t *device, const unsigned char data[], unsigned int size)
+{
+	if (device->dump_callback == NULL)
+		return 1;
+
+	const unsigned char *begin = dc_buffer_get_data (device->dump_buffer);
+	size_t length = dc_buffer_get_size (device->dump_buffer);
+	if (begin == NULL || data < begin || data + size > begin + length)
+		return 1;
+
+	device->dump_streamed += size;
+
+	return device->dump_callback ((unsigned int) (data - begin), data, size, device->dump_userdata);
 }
 
 
@@ -371,7 +931,7 @@ device_dump_read (dc_device_t *device, unsigned int address, unsigned char data[
 	if (device == NULL)
 		return DC_STATUS_UNSUPPORTED;
 
-	if (device->vtable->read == NULL)
+	if (device->vtable->read == NULL && device->vtable->read_range == NULL)
 		return DC_STATUS_UNSUPPORTED;
 
 	// Enable progress notifications.
@@ -379,6 +939,19 @@ device_dump_read (dc_device_t *device, unsigned int address, unsigned char data[
 	progress.maximum = size;
 	device_event_emit (device, DC_EVENT_PROGRESS, &progress);
 
+	// Prefer a single transfer for the entire range, if the backend
+	// supports it. The backend emits the progress events itself.
+	if (device->vtable->read_range) {
+		dc_status_t rc = device->vtable->read_range (device, address, data, size, &progress);
+		if (rc == DC_STATUS_SUCCESS && !device_dump_deliver (device, data, size))
+			rc = DC_STATUS_CANCELLED;
+		return rc;
+	}
+
+	// Limit the progress events to about one percent of the total size.
+	unsigned int step = size / 100;
+	unsigned int reported = 0;
+
 	unsigned int nbytes = 0;
 	while (nbytes < size) {
 		// Calculate the packet size.
@@ -391,17 +964,220 @@ device_dump_read (dc_device_t *device, unsigned int address, unsigned char data[
 		if (rc != DC_STATUS_SUCCESS)
 			return rc;
 
-		// Update and emit a progress event.
-		progress.current += len;
-		device_event_emit (device, DC_EVENT_PROGRESS, &progress);
+		if (!device_dump_deliver (device, data + nbytes, len))
+			return DC_STATUS_CANCELLED;
 
 		nbytes += len;
+
+		// Update and emit a progress event.
+		progress.current += len;
+		if (nbytes == size || progress.current - reported >= step) {
+			device_event_emit (device, DC_EVENT_PROGRESS, &progress);
+			reported = progress.current;
+		}
 	}
 
 	return DC_STATUS_SUCCESS;
 }
 
 
+static void
+dc_device_pipeline_consumer (void *userdata)
+{
+	dc_device_pipeline_t *pipeline = (dc_device_pipeline_t *) userdata;
+
+	dc_mutex_lock (&pipeline->mutex);
+	while (1) {
+		// Wait for the next dive.
+		while (pipeline->count == 0 && !pipeline->finished) {
+			dc_cond_wait (pipeline->notempty, &pipeline->mutex);
+		}
+
+		if (pipeline->count == 0)
+			break;
+
+		dc_device_pipeline_entry_t entry = pipeline->entries[pipeline->head];
+		dc_mutex_unlock (&pipeline->mutex);
+
+		// Pass the dive to the application, without holding the lock.
+		int more = 1;
+		if (!pipeline->stopped) {
+			dc_usecs_t start = device_stats_now (pipeline->device);
+			more = pipeline->callback (entry.data, entry.size, entry.fingerprint, entry.fsize, pipeline->userdata);
+			pipeline->elapsed += device_stats_now (pipeline->device) - start;
+		}
+
+		free (entry.data);
+		free (entry.fingerprint);
+
+		dc_mutex_lock (&pipeline->mutex);
+		if (pipeline->stopped) {
+			pipeline->dropped++;
+		}
+		if (!more) {
+			pipeline->stopped = 1;
+		}
+		pipeline->head = (pipeline->head + 1) % pipeline->depth;
+		pipeline->count--;
+		pipeline->queued -= entry.size + entry.fsize;
+		dc_cond_signal (pipeline->notfull);
+	}
+	dc_mutex_unlock (&pipeline->mutex);
+}
+
+
+static int
+dc_device_pipeline_producer (const unsigned char *data, unsigned int size, const unsigned char *fingerprint, unsigned int fsize, void *userdata)
+{
+	dc_device_pipeline_t *pipeline = (dc_device_pipeline_t *) userdata;
+
+	SPAN_COUNTER (pipeline->device->context, "device.dive", size);
+
+	// Copy the dive, because the backend re-uses its buffers as soon as
+	// the callback returns.
+	dc_device_pipeline_entry_t entry = {NULL, size, NULL, fsize};
+	entry.data = (unsigned char *) malloc (size ? size : 1);
+	entry.fingerprint = (unsigned char *) malloc (fsize ? fsize : 1);
+	if (entry.data == NULL || entry.fingerprint == NULL) {
+		ERROR (pipeline->device->context, "Failed to allocate memory.");
+		free (entry.data);
+		free (entry.fingerprint);
+		dc_mutex_lock (&pipeline->mutex);
+		pipeline->status = DC_STATUS_NOMEMORY;
+		pipeline->dropped++;
+		dc_mutex_unlock (&pipeline->mutex);
+		return 0;
+	}
+
+	if (size)
+		memcpy (entry.data, data, size);
+	if (fsize)
+		memcpy (entry.fingerprint, fingerprint, fsize);
+
+	dc_mutex_lock (&pipeline->mutex);
+
+	// Wait until there is space available in the queue. With a memory
+	// limit, the queued dives are delivered first if the new one doesn't
+	// fit anymore. The consumer always makes progress, so this never
+	// blocks forever.
+	size_t limit = pipeline->device->context ? pipeline->device->context->memlimit : 0;
+	while ((pipeline->count == pipeline->depth ||
+		(limit && pipeline->count && pipeline->queued + size + fsize > limit)) &&
+		!pipeline->stopped) {
+		dc_cond_wait (pipeline->notfull, &pipeline->mutex);
+	}
+
+	if (pipeline->stopped) {
+		pipeline->dropped++;
+		dc_mutex_unlock (&pipeline->mutex);
+		free (entry.data);
+		free (entry.fingerprint);
+		return 0;
+	}
+
+	unsigned int tail = (pipeline->head + pipeline->count) % pipeline->depth;
+	pipeline->entries[tail] = entry;
+	pipeline->count++;
+	pipeline->queued += size + fsize;
+	dc_cond_signal (pipeline->notempty);
+
+	dc_mutex_unlock (&pipeline->mutex);
+
+	return 1;
+}
+
+
+static int
+dc_device_foreach_callback (const unsigned char *data, unsigned int size, const unsigned char *fingerprint, unsigned int fsize, void *userdata)
+{
+	dc_device_callback_t *cb = (dc_device_callback_t *) userdata;
+
+	SPAN_COUNTER (cb->device->context, "device.dive", size);
+
+	device_phase_t previous = device_phase_set (cb->device, DEVICE_PHASE_CALLBACK);
+	int result = cb->callback (data, size, fingerprint, fsize, cb->userdata);
+	device_phase_set (cb->device, previous);
+
+	return result;
+}
+
+
+static dc_status_t
+dc_device_foreach_timed (dc_device_t *device, dc_dive_callback_t callback, void *userdata)
+{
+	dc_device_callback_t cb = {device, callback, userdata};
+
+	return device->vtable->foreach (device, dc_device_foreach_callback, &cb);
+}
+
+
+static dc_status_t
+dc_device_foreach_pipelined (dc_device_t *device, dc_dive_callback_t callback, void *userdata)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	dc_thread_t *thread = NULL;
+
+	dc_device_pipeline_t pipeline = {
+		device, callback, userdata,
+		DC_MUTEX_INIT, NULL, NULL,
+		NULL, device->pipeline_depth, 0, 0, 0,
+		0, 0, 0, DC_STATUS_SUCCESS, 0};
+
+	pipeline.entries = (dc_device_pipeline_entry_t *) malloc (pipeline.depth * sizeof (dc_device_pipeline_entry_t));
+	if (pipeline.entries == NULL) {
+		ERROR (device->context, "Failed to allocate memory.");
+		return DC_STATUS_NOMEMORY;
+	}
+
+	// Fall back to the synchronous mode without thread support.
+	if (dc_cond_new (&pipeline.notempty) != DC_STATUS_SUCCESS ||
+		dc_cond_new (&pipeline.notfull) != DC_STATUS_SUCCESS ||
+		dc_thread_new (&thread, dc_device_pipeline_consumer, &pipeline) != DC_STATUS_SUCCESS) {
+		WARNING (device->context, "Failed to start the consumer thread.");
+		status = dc_device_foreach_timed (device, callback, userdata);
+		goto error_free;
+	}
+
+	device->pipeline = &pipeline;
+
+	status = device->vtable->foreach (device, dc_device_pipeline_producer, &pipeline);
+
+	// Deliver the remaining dives and wait for the consumer to finish.
+	dc_mutex_lock (&pipeline.mutex);
+	pipeline.finished = 1;
+	dc_cond_signal (pipeline.notempty);
+	dc_mutex_unlock (&pipeline.mutex);
+
+	dc_thread_join (thread);
+
+	device->pipeline = NULL;
+
+	// The callback runs concurrently with the download, so its time is
+	// accounted separately.
+	device->phases[DEVICE_PHASE_CALLBACK] += pipeline.elapsed;
+
+	// A cancellation requested by the application callback is a normal
+	// end of the download.
+	if (pipeline.stopped && status == DC_STATUS_CANCELLED)
+		status = DC_STATUS_SUCCESS;
+
+	if (pipeline.status != DC_STATUS_SUCCESS)
+		status = pipeline.status;
+
+	// The backend already advanced the checkpoint past the dives that
+	// were still queued, so it can't be trusted anymore.
+	if (pipeline.dropped)
+		device_checkpoint_clear (device);
+
+error_free:
+	dc_cond_free (pipeline.notfull);
+	dc_cond_free (pipeline.notempty);
+	free (pipeline.entries);
+
+	return status;
+}
+
+
 dc_status_t
 dc_device_foreach (dc_device_t *device, dc_dive_callback_t callback, void *userdata)
 {
@@ -411,7 +1187,210 @@ dc_device_foreach (dc_device_t *device, dc_dive_callback_t callback, void *userd
 	if (device->vtable->foreach == NULL)
 		return DC_STATUS_UNSUPPORTED;
 
-	return device->vtable->foreach (device, callback, userdata);
+	dc_status_t status = DC_STATUS_SUCCESS;
+
+	device_stats_begin (device, DEVICE_PHASE_PROFILE);
+
+	if (callback == NULL)
+		status = device->vtable->foreach (device, NULL, userdata);
+	else if (device->pipeline_depth)
+		status = dc_device_foreach_pipelined (device, callback, userdata);
+	else
+		status = dc_device_foreach_timed (device, callback, userdata);
+
+	return device_stats_end (device, status);
+}
+
+
+dc_status_t
+dc_device_foreach_header (dc_device_t *device, dc_dive_callback_t callback, void *userdata)
+{
+	if (device == NULL)
+		return DC_STATUS_UNSUPPORTED;
+
+	if (device->vtable->foreach_header == NULL)
+		return DC_STATUS_UNSUPPORTED;
+
+	device_stats_begin (device, DEVICE_PHASE_LOGBOOK);
+
+	return device_stats_end (device, device->vtable->foreach_header (device, callback, userdata));
+}
+
+
+static int
+dc_device_count_callback (const unsigned char *data, unsigned int size, const unsigned char *fingerprint, unsigned int fsize, void *userdata)
+{
+	unsigned int *count = (unsigned int *) userdata;
+
+	(*count)++;
+
+	return 1;
+}
+
+
+dc_status_t
+dc_device_has_new_dives (dc_device_t *device, unsigned int *count)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	unsigned int n = 0;
+
+	if (count == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	// The header enumeration stops at the fingerprint, which is the
+	// cheapest way to find the new dives. Without any new dive, that
+	// takes only the first logbook or directory request.
+	status = dc_device_foreach_header (device, dc_device_count_callback, &n);
+	if (status != DC_STATUS_SUCCESS)
+		return status;
+
+	*count = n;
+
+	return DC_STATUS_SUCCESS;
+}
+
+
+typedef struct dc_device_selected_t {
+	dc_device_t *device;
+	dc_dive_callback_t callback;
+	void *userdata;
+	unsigned char *found;
+	unsigned int remaining;
+} dc_device_selected_t;
+
+static int
+dc_device_selected_callback (const unsigned char *data, unsigned int size, const unsigned char *fingerprint, unsigned int fsize, void *userdata)
+{
+	dc_device_selected_t *selected = (dc_device_selected_t *) userdata;
+	dc_device_t *device = selected->device;
+
+	if (fsize != device->selection_fsize)
+		return 1;
+
+	// Deliver each selected dive only once, and stop as soon as all of
+	// them have been delivered.
+	for (unsigned int i = 0; i < device->selection_count; ++i) {
+		if (selected->found[i] ||
+			memcmp (device->selection + i * fsize, fingerprint, fsize) != 0)
+			continue;
+
+		selected->found[i] = 1;
+		selected->remaining--;
+
+		if (selected->callback && !selected->callback (data, size, fingerprint, fsize, selected->userdata))
+			return 0;
+
+		return selected->remaining != 0;
+	}
+
+	return 1;
+}
+
+
+dc_status_t
+dc_device_download_selected (dc_device_t *device, const unsigned char fingerprints[], unsigned int fsize, unsigned int count, dc_dive_callback_t callback, void *userdata)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+
+	if (device == NULL)
+		return DC_STATUS_UNSUPPORTED;
+
+	if (fsize == 0 || (fingerprints == NULL && count))
+		return DC_STATUS_INVALIDARGS;
+
+	if (count == 0)
+		return DC_STATUS_SUCCESS;
+
+	unsigned char *found = (unsigned char *) calloc (count, 1);
+	if (found == NULL) {
+		ERROR (device->context, "Failed to allocate memory.");
+		return DC_STATUS_NOMEMORY;
+	}
+
+	dc_device_selected_t selected = {device, callback, userdata, found, count};
+
+	device->selection = fingerprints;
+	device->selection_fsize = fsize;
+	device->selection_count = count;
+
+	status = dc_device_foreach (device, dc_device_selected_callback, &selected);
+
+	device->selection = NULL;
+	device->selection_fsize = 0;
+	device->selection_count = 0;
+
+	if (selected.remaining)
+		WARNING (device->context, "%u of %u selected dives not found.", selected.remaining, count);
+
+	free (found);
+
+	return status;
+}
+
+
+dc_status_t
+dc_device_extract_dives (dc_descriptor_t *descriptor, dc_buffer_t *dump, dc_dive_callback_t callback, void *userdata)
+{
+	dc_status_t rc = DC_STATUS_SUCCESS;
+
+	if (descriptor == NULL || dump == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	// The memory dump is split without a device, and thus without a
+	// fingerprint. All dives present in the dump are returned.
+	const unsigned char *data = dc_buffer_get_data (dump);
+	unsigned int size = dc_buffer_get_size (dump);
+
+	switch (dc_descriptor_get_type (descriptor)) {
+#ifndef DISABLE_BACKEND_SUUNTO
+	case DC_FAMILY_SUUNTO_SOLUTION:
+		rc = suunto_solution_extract_dives (NULL, data, size, callback, userdata);
+		break;
+#endif
+#ifndef DISABLE_BACKEND_REEFNET
+	case DC_FAMILY_REEFNET_SENSUS:
+		rc = reefnet_sensus_extract_dives (NULL, data, size, callback, userdata);
+		break;
+	case DC_FAMILY_REEFNET_SENSUSPRO:
+		rc = reefnet_sensuspro_extract_dives (NULL, data, size, callback, userdata);
+		break;
+#endif
+#ifndef DISABLE_BACKEND_UWATEC
+	case DC_FAMILY_UWATEC_ALADIN:
+		rc = uwatec_aladin_extract_dives (NULL, data, size, callback, userdata);
+		break;
+	case DC_FAMILY_UWATEC_MEMOMOUSE:
+		rc = uwatec_memomouse_extract_dives (NULL, data, size, callback, userdata);
+		break;
+	case DC_FAMILY_UWATEC_SMART:
+		rc = uwatec_smart_extract_dives (NULL, data, size, callback, userdata);
+		break;
+#endif
+#ifndef DISABLE_BACKEND_HW
+	case DC_FAMILY_HW_OSTC:
+		rc = hw_ostc_extract_dives (NULL, data, size, callback, userdata);
+		break;
+#endif
+#ifndef DISABLE_BACKEND_CRESSI
+	case DC_FAMILY_CRESSI_LEONARDO:
+		rc = cressi_leonardo_extract_dives (NULL, data, size, callback, userdata);
+		break;
+#endif
+#ifndef DISABLE_BACKEND_SHEARWATER
+	case DC_FAMILY_SHEARWATER_PREDATOR:
+		rc = shearwater_predator_extract_dives (NULL, data, size, callback, userdata);
+		break;
+#endif
+#ifndef DISABLE_BACKEND_DIVERITE
+	case DC_FAMILY_DIVERITE_NITEKQ:
+		rc = diverite_nitekq_extract_dives (NULL, data, size, callback, userdata);
+		break;
+#endif
+	default:
+		return DC_STATUS_UNSUPPORTED;
+	}
+
+	return rc;
 }
 
 
@@ -427,7 +1406,9 @@ dc_device_timesync (dc_device_t *device, const dc_datetime_t *datetime)
 	if (datetime == NULL)
 		return DC_STATUS_INVALIDARGS;
 
-	return device->vtable->timesync (device, datetime);
+	device_stats_begin (device, DEVICE_PHASE_NONE);
+
+	return device_stats_end (device, device->vtable->timesync (device, datetime));
 }
 
 
@@ -443,6 +1424,10 @@ dc_device_close (dc_device_t *device)
 	device->cancel_callback = NULL;
 	device->cancel_userdata = NULL;
 
+	// The I/O stream outlives the device, and the backend should still be
+	// able to shut down the connection cleanly.
+	dc_iostream_set_interrupt (device->iostream, NULL);
+
 	if (device->vtable->close) {
 		status = device->vtable->close (device);
 	}
@@ -501,18 +1486,247 @@ device_event_emit (dc_device_t *device, dc_event_type_t event, const void *data)
 	if ((event & device->event_mask) == 0)
 		return;
 
+	// Throttle the progress events. The first and the final event, and
+	// any change of the maximum or backwards step are always delivered.
+	if (event == DC_EVENT_PROGRESS && (device->progress_interval || device->progress_delta)) {
+		dc_usecs_t now = 0;
+		if (device->timer)
+			dc_timer_now (device->timer, &now);
+
+		if (progress->current != progress->maximum &&
+			progress->maximum == device->progress.maximum &&
+			progress->current >= device->progress.current &&
+			(progress->current - device->progress.current < device->progress_delta ||
+			now - device->progress_time < device->progress_interval * 1000ULL))
+			return;
+
+		device->progress = *progress;
+		device->progress_time = now;
+	}
+
 	device->event_callback (device, event, data, device->event_userdata);
 }
 
 
+int
+device_is_excluded (dc_device_t *device, const unsigned char fingerprint[], unsigned int fsize)
+{
+	if (device == NULL || device->selection == NULL)
+		return 0;
+
+	if (fsize != device->selection_fsize)
+		return 0;
+
+	for (unsigned int i = 0; i < device->selection_count; ++i) {
+		if (memcmp (device->selection + i * fsize, fingerprint, fsize) == 0)
+			return 0;
+	}
+
+	return 1;
+}
+
+
 int
 device_is_cancelled (dc_device_t *device)
 {
 	if (device == NULL)
 		return 0;
 
+	if (dc_interrupt_isset (device->interrupt))
+		return 1;
+
+	// Abort the download as soon as the application callback stopped the
+	// pipelined delivery.
+	if (device->pipeline) {
+		dc_mutex_lock (&device->pipeline->mutex);
+		unsigned int stopped = device->pipeline->stopped;
+		dc_mutex_unlock (&device->pipeline->mutex);
+		if (stopped)
+			return 1;
+	}
+
 	if (device->cancel_callback == NULL)
 		return 0;
 
 	return device->cancel_callback (device->cancel_userdata);
 }
+
+
+device_phase_t
+device_phase_set (dc_device_t *device, device_phase_t phase)
+{
+	if (device == NULL)
+		return DEVICE_PHASE_NONE;
+
+	dc_usecs_t now = device_stats_now (device);
+
+	device_phase_t previous = device->phase;
+	device->phases[previous] += now - device->phase_time;
+	device_phase_span (device, previous, phase);
+	device->phase = phase;
+	device->phase_time = now;
+
+	return previous;
+}
+
+
+void
+device_delay_init (device_delay_t *delay, unsigned int minimum, unsigned int maximum)
+{
+	delay->minimum = minimum;
+	delay->maximum = maximum > minimum ? maximum : minimum;
+	delay->current = minimum;
+	delay->nsuccess = 0;
+}
+
+void
+device_delay_wait (device_delay_t *delay, dc_iostream_t *iostream)
+{
+	if (delay->current)
+		dc_iostream_sleep (iostream, delay->current);
+}
+
+void
+device_delay_success (device_delay_t *delay)
+{
+	if (delay->current <= delay->minimum)
+		return;
+
+	if (++delay->nsuccess >= DELAY_DECAY) {
+		delay->nsuccess = 0;
+		delay->current--;
+	}
+}
+
+void
+device_delay_failure (device_delay_t *delay)
+{
+	unsigned int current = delay->current + delay->current / 2 + 1;
+
+	delay->current = current < delay->maximum ? current : delay->maximum;
+	delay->nsuccess = 0;
+}
+
+void
+device_stats_retry (dc_device_t *device)
+{
+	if (device == NULL)
+		return;
+
+	device->nretries++;
+}
+
+
+dc_status_t
+device_transfer_retry (dc_device_t *device, dc_iostream_t *iostream, const device_retry_t *policy, device_attempt_t attempt, void *userdata)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	unsigned int adaptive = policy->maximum > 0;
+
+	unsigned int nretries = 0;
+	while (1) {
+		if (adaptive) {
+			status = dc_iostream_rtt_apply (iostream, policy->minimum, policy->maximum);
+			if (status != DC_STATUS_SUCCESS) {
+				ERROR (device->context, "Failed to set the timeout.");
+				return status;
+			}
+		}
+
+		dc_usecs_t begin = device_stats_now (device);
+		status = attempt (device, nretries, userdata);
+		dc_usecs_t end = device_stats_now (device);
+		if (status == DC_STATUS_SUCCESS) {
+			// Only the first attempt provides an unambiguous measurement
+			// of the round-trip time (Karn's algorithm). For a retry, the
+			// answer may belong to any of the previous attempts.
+			if (nretries == 0 && device->timer)
+				dc_iostream_rtt_update (iostream, end - begin);
+			break;
+		}
+
+		// Automatically discard a corrupted packet,
+		// and request a new one.
+		if (status != DC_STATUS_TIMEOUT && status != DC_STATUS_PROTOCOL)
+			break;
+
+		if (status == DC_STATUS_TIMEOUT)
+			dc_iostream_rtt_backoff (iostream);
+
+		// Abort if the maximum number of retries is reached.
+		if (nretries++ >= policy->maxretries)
+			break;
+
+		if (device_is_cancelled (device)) {
+			status = DC_STATUS_CANCELLED;
+			break;
+		}
+
+		device_stats_retry (device);
+
+		// Delay the next attempt, and back off if the device keeps
+		// failing.
+		if (policy->delay) {
+			unsigned int shift = nretries - 1 < RETRY_BACKOFF ? nretries - 1 : RETRY_BACKOFF;
+			dc_iostream_sleep (iostream, policy->delay << shift);
+		}
+		if (policy->purge)
+			dc_iostream_purge (iostream, DC_DIRECTION_INPUT);
+	}
+
+	return status;
+}
+
+
+dc_status_t
+device_baudrate_negotiate (dc_device_t *device, dc_iostream_t *iostream, unsigned int hint,
+	unsigned int databits, dc_parity_t parity, dc_stopbits_t stopbits, dc_flowcontrol_t flowcontrol,
+	device_probe_t probe, void *userdata)
+{
+	dc_status_t status = DC_STATUS_UNSUPPORTED;
+
+	// Lookup the baudrate table of the family.
+	const unsigned int *table = NULL;
+	for (unsigned int i = 0; i < C_ARRAY_SIZE(g_baudrates); ++i) {
+		if (g_baudrates[i].family == device->vtable->type) {
+			table = g_baudrates[i].baudrates;
+			break;
+		}
+	}
+
+	// Build the list with candidates, starting with the hint.
+	unsigned int candidates[C_ARRAY_SIZE(g_baudrates[0].baudrates) + 1] = {0};
+	unsigned int count = 0;
+	if (hint) {
+		candidates[count++] = hint;
+	}
+	for (unsigned int i = 0; table && i < C_ARRAY_SIZE(g_baudrates[0].baudrates); ++i) {
+		if (table[i] && table[i] != hint) {
+			candidates[count++] = table[i];
+		}
+	}
+
+	for (unsigned int i = 0; i < count; ++i) {
+		// Adjust the baudrate.
+		status = dc_iostream_configure (iostream, candidates[i], databits, parity, stopbits, flowcontrol);
+		if (status == DC_STATUS_UNSUPPORTED || status == DC_STATUS_INVALIDARGS) {
+			WARNING (device->context, "Baudrate %u not supported by the driver.", candidates[i]);
+			continue;
+		} else if (status != DC_STATUS_SUCCESS) {
+			ERROR (device->context, "Failed to set the terminal attributes.");
+			return status;
+		}
+
+		// Check whether the device responds.
+		status = probe (device, userdata);
+		if (status == DC_STATUS_SUCCESS) {
+			INFO (device->context, "Negotiated baudrate: %u", candidates[i]);
+			break;
+		}
+
+		if (status != DC_STATUS_TIMEOUT && status != DC_STATUS_PROTOCOL)
+			break;
+	}
+
+	return status;
+}
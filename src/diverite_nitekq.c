@@ -65,16 +65,15 @@ static const dc_device_vtable_t diverite_nitekq_device_vtable = {
 	DC_FAMILY_DIVERITE_NITEKQ,
 	diverite_nitekq_device_set_fingerprint, /* set_fingerprint */
 	NULL, /* read */
+	NULL, /* read_range */
 	NULL, /* write */
 	diverite_nitekq_device_dump, /* dump */
 	diverite_nitekq_device_foreach, /* foreach */
+	NULL, /* foreach_header */
 	NULL, /* timesync */
 	diverite_nitekq_device_close /* close */
 };
 
-static dc_status_t
-diverite_nitekq_extract_dives (dc_device_t *device, const unsigned char data[], unsigned int size, dc_dive_callback_t callback, void *userdata);
-
 static dc_status_t
 diverite_nitekq_send (diverite_nitekq_device_t *device, unsigned char cmd)
 {
@@ -320,7 +319,7 @@ diverite_nitekq_device_dump (dc_device_t *abstract, dc_buffer_t *buffer)
 static dc_status_t
 diverite_nitekq_device_foreach (dc_device_t *abstract, dc_dive_callback_t callback, void *userdata)
 {
-	dc_buffer_t *buffer = dc_buffer_new (0);
+	dc_buffer_t *buffer = dc_buffer_new_context (abstract->context, 0);
 	if (buffer == NULL)
 		return DC_STATUS_NOMEMORY;
 
@@ -339,7 +338,7 @@ diverite_nitekq_device_foreach (dc_device_t *abstract, dc_dive_callback_t callba
 }
 
 
-static dc_status_t
+dc_status_t
 diverite_nitekq_extract_dives (dc_device_t *abstract, const unsigned char data[], unsigned int size, dc_dive_callback_t callback, void *userdata)
 {
 	diverite_nitekq_device_t *device = (diverite_nitekq_device_t *) abstract;
@@ -52,6 +52,7 @@ struct diverite_nitekq_parser_t {
 static dc_status_t diverite_nitekq_parser_get_datetime (dc_parser_t *abstract, dc_datetime_t *datetime);
 static dc_status_t diverite_nitekq_parser_get_field (dc_parser_t *abstract, dc_field_type_t type, unsigned int flags, void *value);
 static dc_status_t diverite_nitekq_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_t callback, void *userdata);
+static dc_status_t diverite_nitekq_parser_reset (dc_parser_t *abstract);
 
 static const dc_parser_vtable_t diverite_nitekq_parser_vtable = {
 	sizeof(diverite_nitekq_parser_t),
@@ -61,7 +62,13 @@ static const dc_parser_vtable_t diverite_nitekq_parser_vtable = {
 	NULL, /* set_density */
 	diverite_nitekq_parser_get_datetime, /* datetime */
 	diverite_nitekq_parser_get_field, /* fields */
+	NULL, /* summary */
 	diverite_nitekq_parser_samples_foreach, /* samples_foreach */
+	NULL, /* samples_batch */
+	NULL, /* samples_fixed */
+	NULL, /* samples_append */
+	NULL, /* samples_range */
+	diverite_nitekq_parser_reset, /* reset */
 	NULL /* destroy */
 };
 
@@ -82,6 +89,19 @@ diverite_nitekq_parser_create (dc_parser_t **out, dc_context_t *context, const u
 	}
 
 	// Set the default values.
+	diverite_nitekq_parser_reset ((dc_parser_t *) parser);
+
+	*out = (dc_parser_t*) parser;
+
+	return DC_STATUS_SUCCESS;
+}
+
+
+static dc_status_t
+diverite_nitekq_parser_reset (dc_parser_t *abstract)
+{
+	diverite_nitekq_parser_t *parser = (diverite_nitekq_parser_t *) abstract;
+
 	parser->cached = 0;
 	parser->divemode = DC_DIVEMODE_OC;
 	parser->metric = 0;
@@ -93,8 +113,6 @@ diverite_nitekq_parser_create (dc_parser_t **out, dc_context_t *context, const u
 		parser->he[i] = 0;
 	}
 
-	*out = (dc_parser_t*) parser;
-
 	return DC_STATUS_SUCCESS;
 }
 
@@ -83,9 +83,11 @@ static const dc_device_vtable_t divesoft_freedom_device_vtable = {
 	DC_FAMILY_DIVESOFT_FREEDOM,
 	divesoft_freedom_device_set_fingerprint, /* set_fingerprint */
 	NULL, /* read */
+	NULL, /* read_range */
 	NULL, /* write */
 	NULL, /* dump */
 	divesoft_freedom_device_foreach, /* foreach */
+	NULL, /* foreach_header */
 	NULL, /* timesync */
 	divesoft_freedom_device_close, /* close */
 };
@@ -222,7 +224,7 @@ divesoft_freedom_recv (divesoft_freedom_device_t *device, dc_event_progress_t *p
 }
 
 static dc_status_t
-divesoft_freedom_transfer (divesoft_freedom_device_t *device, dc_event_progress_t *progress, message_t cmd, const unsigned char data[], size_t size, message_t *msg, dc_buffer_t *buffer)
+divesoft_freedom_request (divesoft_freedom_device_t *device, message_t cmd, const unsigned char data[], size_t size)
 {
 	dc_status_t status = DC_STATUS_SUCCESS;
 	dc_device_t *abstract = (dc_device_t *) device;
@@ -238,6 +240,20 @@ divesoft_freedom_transfer (divesoft_freedom_device_t *device, dc_event_progress_
 		return status;
 	}
 
+	return status;
+}
+
+static dc_status_t
+divesoft_freedom_transfer (divesoft_freedom_device_t *device, dc_event_progress_t *progress, message_t cmd, const unsigned char data[], size_t size, message_t *msg, dc_buffer_t *buffer)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	dc_device_t *abstract = (dc_device_t *) device;
+
+	status = divesoft_freedom_request (device, cmd, data, size);
+	if (status != DC_STATUS_SUCCESS) {
+		return status;
+	}
+
 	status = divesoft_freedom_recv (device, progress, msg, buffer);
 	if(status != DC_STATUS_SUCCESS) {
 		ERROR (abstract->context, "Failed to receive response.");
@@ -247,13 +263,38 @@ divesoft_freedom_transfer (divesoft_freedom_device_t *device, dc_event_progress_
 	return status;
 }
 
+static dc_status_t
+divesoft_freedom_request_dive (divesoft_freedom_device_t *device, unsigned int version, const unsigned char record[])
+{
+	unsigned int headersize = version == MSG_DIVE_LIST_V1 ?
+		HEADER_SIZE_V1 : HEADER_SIZE_V2;
+
+	// Get the record data.
+	unsigned int handle = array_uint32_le (record);
+	const unsigned char *header = record + 4 + FINGERPRINT_SIZE;
+
+	// Get the length of the dive.
+	unsigned int nrecords = version == MSG_DIVE_LIST_V1 ?
+		array_uint32_le (header + 16) & 0x3FFFF :
+		array_uint32_le (header + 20);
+	unsigned int length = headersize + nrecords * RECORD_SIZE;
+
+	// Prepare the command.
+	unsigned char cmd_dive[12] = {0};
+	array_uint32_le_set (cmd_dive + 0, handle);
+	array_uint32_le_set (cmd_dive + 4, 0);
+	array_uint32_le_set (cmd_dive + 8, length);
+
+	return divesoft_freedom_request (device, MSG_DIVE_DATA, cmd_dive, sizeof(cmd_dive));
+}
+
 static dc_status_t
 divesoft_freedom_download (divesoft_freedom_device_t *device, message_t cmd, const unsigned char cdata[], size_t csize, unsigned char rdata[], size_t rsize)
 {
 	dc_status_t status = DC_STATUS_SUCCESS;
 	dc_device_t *abstract = (dc_device_t *) device;
 
-	dc_buffer_t *buffer = dc_buffer_new (rsize);
+	dc_buffer_t *buffer = dc_buffer_new_context (device->base.context, rsize);
 	if (buffer == NULL) {
 		ERROR (abstract->context, "Failed to allocate memory.");
 		status = DC_STATUS_NOMEMORY;
@@ -417,14 +458,14 @@ divesoft_freedom_device_foreach (dc_device_t *abstract, dc_dive_callback_t callb
 	device_event_emit(abstract, DC_EVENT_DEVINFO, &devinfo);
 
 	// Allocate memory for the dive list.
-	dc_buffer_t *divelist = dc_buffer_new (0);
+	dc_buffer_t *divelist = dc_buffer_new_context (abstract->context, 0);
 	if (divelist == NULL) {
 		status = DC_STATUS_NOMEMORY;
 		goto error_exit;
 	}
 
 	// Allocate memory for the download buffer.
-	dc_buffer_t *buffer = dc_buffer_new (NRECORDS * (4 + FINGERPRINT_SIZE + HEADER_SIZE_V2));
+	dc_buffer_t *buffer = dc_buffer_new_context (abstract->context, NRECORDS * (4 + FINGERPRINT_SIZE + HEADER_SIZE_V2));
 	if (buffer == NULL) {
 		status = DC_STATUS_NOMEMORY;
 		goto error_free_divelist;
@@ -499,24 +540,28 @@ divesoft_freedom_device_foreach (dc_device_t *abstract, dc_dive_callback_t callb
 				array_uint32_le (header + 20);
 			unsigned int length = headersize + nrecords * RECORD_SIZE;
 
-			// Calculate the total and maximum size.
-			if (length > maxsize)
-				maxsize = length;
-			total += length;
+			// Append the record to the dive list buffer, unless the dive
+			// is left out by a selective download.
+			if (!device_is_excluded (abstract, fingerprint, sizeof(device->fingerprint))) {
+				if (!dc_buffer_append (divelist, data + offset, recordsize)) {
+					ERROR (abstract->context, "Insufficient buffer space available.");
+					status = DC_STATUS_NOMEMORY;
+					goto error_free_buffer;
+				}
+
+				// Calculate the total and maximum size.
+				if (length > maxsize)
+					maxsize = length;
+				total += length;
+
+				ndives++;
+			}
 
 			// Set the handle for the next request.
 			current = handle;
 
 			offset += recordsize;
 			count++;
-			ndives++;
-		}
-
-		// Append the records to the dive list buffer.
-		if (!dc_buffer_append (divelist, data, count * recordsize)) {
-			ERROR (abstract->context, "Insufficient buffer space available.");
-			status = DC_STATUS_NOMEMORY;
-			goto error_free_buffer;
 		}
 
 		// Stop downloading if there are no more records.
@@ -534,31 +579,27 @@ divesoft_freedom_device_foreach (dc_device_t *abstract, dc_dive_callback_t callb
 	const unsigned char *data = dc_buffer_get_data (divelist);
 	size_t size = dc_buffer_get_size (divelist);
 
+	// Request the first dive.
 	size_t offset = 0;
+	if (offset + recordsize <= size) {
+		status = divesoft_freedom_request_dive (device, version, data + offset);
+		if (status != DC_STATUS_SUCCESS) {
+			ERROR (abstract->context, "Failed to request the dive.");
+			goto error_free_buffer;
+		}
+	}
+
 	while (offset + recordsize <= size) {
 		// Get the record data.
-		unsigned int handle = array_uint32_le (data + offset);
 		const unsigned char *fingerprint = data + offset + 4;
 		const unsigned char *header = data + offset + 4 + FINGERPRINT_SIZE;
 
-		// Get the length of the dive.
-		unsigned int nrecords = version == MSG_DIVE_LIST_V1 ?
-			array_uint32_le (header + 16) & 0x3FFFF :
-			array_uint32_le (header + 20);
-		unsigned int length = headersize + nrecords * RECORD_SIZE;
-
 		// Clear the buffer.
 		dc_buffer_clear (buffer);
 
-		// Prepare the command.
-		unsigned char cmd_dive[12] = {0};
-		array_uint32_le_set (cmd_dive + 0, handle);
-		array_uint32_le_set (cmd_dive + 4, 0);
-		array_uint32_le_set (cmd_dive + 8, length);
-
-		// Download the dive.
+		// Receive the dive.
 		message_t msg_dive = MSG_ECHO;
-		status = divesoft_freedom_transfer (device, &progress, MSG_DIVE_DATA, cmd_dive, sizeof(cmd_dive), &msg_dive, buffer);
+		status = divesoft_freedom_recv (device, &progress, &msg_dive, buffer);
 		if (status != DC_STATUS_SUCCESS) {
 			ERROR (abstract->context, "Failed to download the dive.");
 			goto error_free_buffer;
@@ -579,11 +620,32 @@ divesoft_freedom_device_foreach (dc_device_t *abstract, dc_dive_callback_t callb
 			goto error_free_buffer;
 		}
 
+		offset += recordsize;
+
+		// Request the next dive already, such that the dive computer can
+		// send it while the current dive is being processed.
+		unsigned int pending = 0;
+		if (offset + recordsize <= size) {
+			status = divesoft_freedom_request_dive (device, version, data + offset);
+			if (status != DC_STATUS_SUCCESS) {
+				ERROR (abstract->context, "Failed to request the dive.");
+				goto error_free_buffer;
+			}
+			pending = 1;
+		}
+
 		if (callback && !callback (dc_buffer_get_data(buffer), dc_buffer_get_size(buffer), fingerprint, sizeof (device->fingerprint), userdata)) {
+			// Discard the pending response.
+			if (pending) {
+				dc_buffer_clear (buffer);
+				status = divesoft_freedom_recv (device, NULL, NULL, buffer);
+				if (status != DC_STATUS_SUCCESS) {
+					ERROR (abstract->context, "Failed to receive the pending dive.");
+					goto error_free_buffer;
+				}
+			}
 			break;
 		}
-
-		offset += recordsize;
 	}
 
 error_free_buffer:
@@ -29,6 +29,7 @@
 #include "parser-private.h"
 #include "checksum.h"
 #include "array.h"
+#include "field-cache.h"
 
 #define UNDEFINED 0xFFFFFFFF
 
@@ -229,6 +230,12 @@ typedef struct divesoft_freedom_tank_t {
 	unsigned int active;
 } divesoft_freedom_tank_t;
 
+typedef struct divesoft_freedom_state_t {
+	unsigned int offset;
+	unsigned int time;
+	unsigned int initial;
+} divesoft_freedom_state_t;
+
 typedef struct divesoft_freedom_parser_t {
 	dc_parser_t base;
 	// Cached fields.
@@ -243,6 +250,7 @@ typedef struct divesoft_freedom_parser_t {
 	unsigned int avgdepth;
 	unsigned int ngasmixes;
 	divesoft_freedom_gasmix_t gasmix[NGASMIXES];
+	dc_gasmix_map_t gasmap;
 	unsigned int diluent;
 	unsigned int ntanks;
 	divesoft_freedom_tank_t tank[NTANKS];
@@ -252,11 +260,15 @@ typedef struct divesoft_freedom_parser_t {
 	unsigned int seawater;
 	unsigned int calibration[NSENSORS];
 	unsigned int calibrated;
+	// Incremental parsing.
+	divesoft_freedom_state_t live;
 } divesoft_freedom_parser_t;
 
 static dc_status_t divesoft_freedom_parser_get_datetime (dc_parser_t *abstract, dc_datetime_t *datetime);
 static dc_status_t divesoft_freedom_parser_get_field (dc_parser_t *abstract, dc_field_type_t type, unsigned int flags, void *value);
 static dc_status_t divesoft_freedom_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_t callback, void *userdata);
+static dc_status_t divesoft_freedom_parser_samples_append (dc_parser_t *abstract, dc_sample_callback_t callback, void *userdata);
+static dc_status_t divesoft_freedom_parser_reset (dc_parser_t *abstract);
 
 static const dc_parser_vtable_t divesoft_freedom_parser_vtable = {
 	sizeof(divesoft_freedom_parser_t),
@@ -266,7 +278,13 @@ static const dc_parser_vtable_t divesoft_freedom_parser_vtable = {
 	NULL, /* set_density */
 	divesoft_freedom_parser_get_datetime, /* datetime */
 	divesoft_freedom_parser_get_field, /* fields */
+	NULL, /* summary */
 	divesoft_freedom_parser_samples_foreach, /* samples_foreach */
+	NULL, /* samples_batch */
+	NULL, /* samples_fixed */
+	divesoft_freedom_parser_samples_append, /* samples_append */
+	NULL, /* samples_range */
+	divesoft_freedom_parser_reset, /* reset */
 	NULL /* destroy */
 };
 
@@ -620,8 +638,10 @@ divesoft_freedom_cache (divesoft_freedom_parser_t *parser)
 	parser->atmospheric = atmospheric;
 	parser->avgdepth = avgdepth;
 	parser->ngasmixes = ngasmixes;
+	dc_gasmix_map_clear (&parser->gasmap);
 	for (unsigned int i = 0; i < ngasmixes; ++i) {
 		parser->gasmix[i] = gasmix[i];
+		dc_gasmix_map_insert (&parser->gasmap, gasmix[i].oxygen, gasmix[i].helium, gasmix[i].type, i);
 	}
 	parser->diluent = diluent;
 	parser->ntanks = ntanks;
@@ -656,6 +676,19 @@ divesoft_freedom_parser_create (dc_parser_t **out, dc_context_t *context, const
 	}
 
 	// Set the default values.
+	divesoft_freedom_parser_reset ((dc_parser_t *) parser);
+
+	*out = (dc_parser_t *) parser;
+
+	return DC_STATUS_SUCCESS;
+}
+
+
+static dc_status_t
+divesoft_freedom_parser_reset (dc_parser_t *abstract)
+{
+	divesoft_freedom_parser_t *parser = (divesoft_freedom_parser_t *) abstract;
+
 	parser->cached = 0;
 	parser->version = 0;
 	parser->headersize = 0;
@@ -672,6 +705,7 @@ divesoft_freedom_parser_create (dc_parser_t **out, dc_context_t *context, const
 		parser->gasmix[i].type = 0;
 		parser->gasmix[i].id = 0;
 	}
+	dc_gasmix_map_clear (&parser->gasmap);
 	parser->diluent = UNDEFINED;
 	parser->ntanks = 0;
 	for (unsigned int i = 0; i < NTANKS; ++i) {
@@ -690,8 +724,9 @@ divesoft_freedom_parser_create (dc_parser_t **out, dc_context_t *context, const
 		parser->calibration[i] = 0;
 	}
 	parser->calibrated = 0;
-
-	*out = (dc_parser_t *) parser;
+	parser->live.offset = 0;
+	parser->live.time = UNDEFINED;
+	parser->live.initial = 0;
 
 	return DC_STATUS_SUCCESS;
 }
@@ -842,195 +877,231 @@ divesoft_freedom_parser_get_field (dc_parser_t *abstract, dc_field_type_t type,
 }
 
 static dc_status_t
-divesoft_freedom_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_t callback, void *userdata)
+divesoft_freedom_parser_record (divesoft_freedom_parser_t *parser, divesoft_freedom_state_t *state, const unsigned char data[], unsigned int offset, dc_sample_callback_t callback, void *userdata)
 {
-	dc_status_t status = DC_STATUS_SUCCESS;
-	divesoft_freedom_parser_t *parser = (divesoft_freedom_parser_t *) abstract;
-	const unsigned char *data = abstract->data;
-	unsigned int size = abstract->size;
-
-	// Cache the header data.
-	status = divesoft_freedom_cache (parser);
-	if (status != DC_STATUS_SUCCESS)
-		return status;
-
-	unsigned int time = UNDEFINED;
-	unsigned int initial = 0;
-	unsigned int offset = parser->headersize;
-	while (offset + RECORD_SIZE <= size) {
-		dc_sample_value_t sample = {0};
-
-		if (array_isequal(data + offset, RECORD_SIZE, 0xFF)) {
-			WARNING (abstract->context, "Skipping empty sample.");
-			offset += RECORD_SIZE;
-			continue;
-		}
+	dc_parser_t *abstract = (dc_parser_t *) parser;
+	dc_sample_value_t sample = {0};
 
-		unsigned int flags = array_uint32_le (data + offset);
-		unsigned int type      = (flags & 0x0000000F) >> 0;
-		unsigned int timestamp = (flags & 0x001FFFF0) >> 4;
-		unsigned int id        = (flags & 0x7FE00000) >> 21;
+	if (array_isequal(data + offset, RECORD_SIZE, 0xFF)) {
+		WARNING (abstract->context, "Skipping empty sample.");
+		return DC_STATUS_SUCCESS;
+	}
 
-		if (timestamp != time) {
-			if (timestamp < time && time != UNDEFINED) {
-				// The timestamp are supposed to be monotonically increasing,
-				// but occasionally there are small jumps back in time with just
-				// 1 or 2 seconds. To get back in sync, those samples are
-				// skipped. Larger jumps are treated as errors.
-				if (time - timestamp > 5) {
-					ERROR (abstract->context, "Timestamp moved backwards (%u %u).", timestamp, time);
-					return DC_STATUS_DATAFORMAT;
-				}
-				WARNING (abstract->context, "Timestamp moved backwards (%u %u).", timestamp, time);
-				offset += RECORD_SIZE;
-				continue;
+	unsigned int flags = array_uint32_le (data + offset);
+	unsigned int type      = (flags & 0x0000000F) >> 0;
+	unsigned int timestamp = (flags & 0x001FFFF0) >> 4;
+	unsigned int id        = (flags & 0x7FE00000) >> 21;
+
+	if (timestamp != state->time) {
+		if (timestamp < state->time && state->time != UNDEFINED) {
+			// The timestamp are supposed to be monotonically increasing,
+			// but occasionally there are small jumps back in time with just
+			// 1 or 2 seconds. To get back in sync, those samples are
+			// skipped. Larger jumps are treated as errors.
+			if (state->time - timestamp > 5) {
+				ERROR (abstract->context, "Timestamp moved backwards (%u %u).", timestamp, state->time);
+				return DC_STATUS_DATAFORMAT;
 			}
-			time = timestamp;
-			sample.time = time * 1000;
-			if (callback) callback(DC_SAMPLE_TIME, &sample, userdata);
+			WARNING (abstract->context, "Timestamp moved backwards (%u %u).", timestamp, state->time);
+			return DC_STATUS_SUCCESS;
 		}
+		state->time = timestamp;
+		sample.time = state->time * 1000;
+		if (callback) callback(DC_SAMPLE_TIME, &sample, userdata);
+	}
 
-		// Initial diluent.
-		if (!initial) {
-			if (parser->diluent != UNDEFINED) {
-				sample.gasmix = parser->diluent;
-				if (callback) callback(DC_SAMPLE_GASMIX, &sample, userdata);
-			}
-			initial = 1;
+	// Initial diluent.
+	if (!state->initial) {
+		if (parser->diluent != UNDEFINED) {
+			sample.gasmix = parser->diluent;
+			if (callback) callback(DC_SAMPLE_GASMIX, &sample, userdata);
 		}
+		state->initial = 1;
+	}
 
-		if (type == LREC_POINT) {
-			// General log record.
-			unsigned int depth = array_uint16_le (data + offset + 4);
-			unsigned int ppo2  = array_uint16_le (data + offset + 6);
-
-			sample.depth = depth / 100.0;
-			if (callback) callback(DC_SAMPLE_DEPTH, &sample, userdata);
+	if (type == LREC_POINT) {
+		// General log record.
+		unsigned int depth = array_uint16_le (data + offset + 4);
+		unsigned int ppo2  = array_uint16_le (data + offset + 6);
 
-			if (ppo2) {
-				sample.ppo2.sensor = DC_SENSOR_NONE;
-				sample.ppo2.value = ppo2 * 10.0 / BAR;
-				if (callback) callback(DC_SAMPLE_PPO2, &sample, userdata);
-			}
+		sample.depth = depth / 100.0;
+		if (callback) callback(DC_SAMPLE_DEPTH, &sample, userdata);
 
-			if (id == POINT_2) {
-				unsigned int orientation = array_uint32_le (data + offset + 8);
-				unsigned int heading = orientation & 0x1FF;
-				sample.bearing = heading;
-				if (callback) callback (DC_SAMPLE_BEARING, &sample, userdata);
-			} else if (id == POINT_1 || id == POINT_1_OLD) {
-				unsigned int misc = array_uint32_le (data + offset + 8);
-				unsigned int ceiling = array_uint16_le (data + offset + 12);
-				unsigned int setpoint = data[offset + 15];
-				unsigned int ndl  = (misc & 0x000003FF);
-				unsigned int tts  = (misc & 0x000FFC00) >> 10;
-				unsigned int temp = (misc & 0x3FF00000) >> 20;
-
-				// Temperature
-				sample.temperature = (signed int) signextend (temp, 10) / 10.0;
-				if (callback) callback(DC_SAMPLE_TEMPERATURE, &sample, userdata);
-
-				// Deco / NDL
-				if (ceiling) {
-					sample.deco.type = DC_DECO_DECOSTOP;
-					sample.deco.time = 0;
-					sample.deco.depth = ceiling / 100.0;
-				} else {
-					sample.deco.type = DC_DECO_NDL;
-					sample.deco.time = ndl * 60;
-					sample.deco.depth = 0.0;
-				}
-				sample.deco.tts = tts * 60;
-				if (callback) callback(DC_SAMPLE_DECO, &sample, userdata);
+		if (ppo2) {
+			sample.ppo2.sensor = DC_SENSOR_NONE;
+			sample.ppo2.value = ppo2 * 10.0 / BAR;
+			if (callback) callback(DC_SAMPLE_PPO2, &sample, userdata);
+		}
 
-				// Setpoint
-				if (setpoint) {
-					sample.setpoint = setpoint / 100.0;
-					if (callback) callback(DC_SAMPLE_SETPOINT, &sample, userdata);
-				}
+		if (id == POINT_2) {
+			unsigned int orientation = array_uint32_le (data + offset + 8);
+			unsigned int heading = orientation & 0x1FF;
+			sample.bearing = heading;
+			if (callback) callback (DC_SAMPLE_BEARING, &sample, userdata);
+		} else if (id == POINT_1 || id == POINT_1_OLD) {
+			unsigned int misc = array_uint32_le (data + offset + 8);
+			unsigned int ceiling = array_uint16_le (data + offset + 12);
+			unsigned int setpoint = data[offset + 15];
+			unsigned int ndl  = (misc & 0x000003FF);
+			unsigned int tts  = (misc & 0x000FFC00) >> 10;
+			unsigned int temp = (misc & 0x3FF00000) >> 20;
+
+			// Temperature
+			sample.temperature = (signed int) signextend (temp, 10) / 10.0;
+			if (callback) callback(DC_SAMPLE_TEMPERATURE, &sample, userdata);
+
+			// Deco / NDL
+			if (ceiling) {
+				sample.deco.type = DC_DECO_DECOSTOP;
+				sample.deco.time = 0;
+				sample.deco.depth = ceiling / 100.0;
+			} else {
+				sample.deco.type = DC_DECO_NDL;
+				sample.deco.time = ndl * 60;
+				sample.deco.depth = 0.0;
 			}
-		} else if ((type >= LREC_MANIPULATION && type <= LREC_ACTIVITY) || type == LREC_INFO) {
-			// Event record.
-			unsigned int event = array_uint16_le (data + offset + 4);
+			sample.deco.tts = tts * 60;
+			if (callback) callback(DC_SAMPLE_DECO, &sample, userdata);
 
-			if (event == EVENT_BOOKMARK) {
-				sample.event.type = SAMPLE_EVENT_BOOKMARK;
-				sample.event.time = 0;
-				sample.event.flags = 0;
-				sample.event.value = 0;
-				if (callback) callback(DC_SAMPLE_EVENT, &sample, userdata);
-			} else if (event == EVENT_MIX_CHANGED || event == EVENT_DILUENT || event == EVENT_CHANGE_MODE) {
-				unsigned int o2 = data[offset + 6];
-				unsigned int he = data[offset + 7];
-				unsigned int mixtype = OC;
-				if (event == EVENT_DILUENT) {
+			// Setpoint
+			if (setpoint) {
+				sample.setpoint = setpoint / 100.0;
+				if (callback) callback(DC_SAMPLE_SETPOINT, &sample, userdata);
+			}
+		}
+	} else if ((type >= LREC_MANIPULATION && type <= LREC_ACTIVITY) || type == LREC_INFO) {
+		// Event record.
+		unsigned int event = array_uint16_le (data + offset + 4);
+
+		if (event == EVENT_BOOKMARK) {
+			sample.event.type = SAMPLE_EVENT_BOOKMARK;
+			sample.event.time = 0;
+			sample.event.flags = 0;
+			sample.event.value = 0;
+			if (callback) callback(DC_SAMPLE_EVENT, &sample, userdata);
+		} else if (event == EVENT_MIX_CHANGED || event == EVENT_DILUENT || event == EVENT_CHANGE_MODE) {
+			unsigned int o2 = data[offset + 6];
+			unsigned int he = data[offset + 7];
+			unsigned int mixtype = OC;
+			if (event == EVENT_DILUENT) {
+				mixtype = DILUENT;
+			} else if (event == EVENT_CHANGE_MODE) {
+				unsigned int mode = data[offset + 8];
+				if (divesoft_freedom_is_ccr (mode)) {
 					mixtype = DILUENT;
-				} else if (event == EVENT_CHANGE_MODE) {
-					unsigned int mode = data[offset + 8];
-					if (divesoft_freedom_is_ccr (mode)) {
-						mixtype = DILUENT;
-					}
 				}
+			}
 
-				unsigned int idx = divesoft_freedom_find_gasmix (parser->gasmix, parser->ngasmixes, o2, he, mixtype);
-				if (idx >= parser->ngasmixes) {
-					ERROR (abstract->context, "Gas mix (%u/%u) not found.", o2, he);
+			unsigned int idx = dc_gasmix_map_find (&parser->gasmap, o2, he, mixtype);
+			if (idx >= parser->ngasmixes) {
+				ERROR (abstract->context, "Gas mix (%u/%u) not found.", o2, he);
+				return DC_STATUS_DATAFORMAT;
+			}
+			sample.gasmix = idx;
+			if (callback) callback(DC_SAMPLE_GASMIX, &sample, userdata);
+		} else if (event == EVENT_CNS) {
+			sample.cns = array_uint16_le (data + offset + 6) / 100.0;
+			if (callback) callback(DC_SAMPLE_CNS, &sample, userdata);
+		} else if (event == EVENT_SETPOINT_MANUAL || event == EVENT_SETPOINT_AUTO) {
+			sample.setpoint = data[6] / 100.0;
+			if (callback) callback(DC_SAMPLE_SETPOINT, &sample, userdata);
+		}
+	} else if (type == LREC_MEASURE) {
+		// Measurement record.
+		if (id == MEASURE_ID_AI_PRESSURE) {
+			for (unsigned int i = 0; i < NTANKS; ++i) {
+				unsigned int pressure = data[offset + 4 + i];
+				if (pressure == 0 || pressure == 0xFF)
+					continue;
+
+				unsigned int idx = divesoft_freedom_find_tank (parser->tank, parser->ntanks, i);
+				if (idx >= parser->ntanks) {
+					ERROR (abstract->context, "Tank %u not found.", idx);
 					return DC_STATUS_DATAFORMAT;
 				}
-				sample.gasmix = idx;
-				if (callback) callback(DC_SAMPLE_GASMIX, &sample, userdata);
-			} else if (event == EVENT_CNS) {
-				sample.cns = array_uint16_le (data + offset + 6) / 100.0;
-				if (callback) callback(DC_SAMPLE_CNS, &sample, userdata);
-			} else if (event == EVENT_SETPOINT_MANUAL || event == EVENT_SETPOINT_AUTO) {
-				sample.setpoint = data[6] / 100.0;
-				if (callback) callback(DC_SAMPLE_SETPOINT, &sample, userdata);
-			}
-		} else if (type == LREC_MEASURE) {
-			// Measurement record.
-			if (id == MEASURE_ID_AI_PRESSURE) {
-				for (unsigned int i = 0; i < NTANKS; ++i) {
-					unsigned int pressure = data[offset + 4 + i];
-					if (pressure == 0 || pressure == 0xFF)
-						continue;
-
-					unsigned int idx = divesoft_freedom_find_tank (parser->tank, parser->ntanks, i);
-					if (idx >= parser->ntanks) {
-						ERROR (abstract->context, "Tank %u not found.", idx);
-						return DC_STATUS_DATAFORMAT;
-					}
 
-					sample.pressure.tank = idx;
-					sample.pressure.value = pressure * 2.0;
-					if (callback) callback(DC_SAMPLE_PRESSURE, &sample, userdata);
-				}
-			} else if (id == MEASURE_ID_OXYGEN) {
-				for (unsigned int i = 0; i < NSENSORS; ++i) {
-					unsigned int ppo2 = array_uint16_le (data + offset + 4 + i * 2);
-					if (ppo2 == 0 || ppo2 == 0xFFFF)
-						continue;
-					sample.ppo2.sensor = i;
-					sample.ppo2.value = ppo2 * 10.0 / BAR;
-					if (callback) callback(DC_SAMPLE_PPO2, &sample, userdata);
-				}
-			} else if (id == MEASURE_ID_OXYGEN_MV) {
-				for (unsigned int i = 0; i < NSENSORS; ++i) {
-					unsigned int value = array_uint16_le (data + offset + 4 + i * 2);
-					unsigned int state = data[offset + 12 + i];
-					if (!parser->calibrated || parser->calibration[i] == 0 ||
-						state == SENSTAT_UNCALIBRATED || state == SENSTAT_NOT_EXIST)
-						continue;
-					sample.ppo2.sensor = i;
-					sample.ppo2.value = value / 100.0 * parser->calibration[i] / BAR;
-					if (callback) callback(DC_SAMPLE_PPO2, &sample, userdata);
-				}
+				sample.pressure.tank = idx;
+				sample.pressure.value = pressure * 2.0;
+				if (callback) callback(DC_SAMPLE_PRESSURE, &sample, userdata);
+			}
+		} else if (id == MEASURE_ID_OXYGEN) {
+			for (unsigned int i = 0; i < NSENSORS; ++i) {
+				unsigned int ppo2 = array_uint16_le (data + offset + 4 + i * 2);
+				if (ppo2 == 0 || ppo2 == 0xFFFF)
+					continue;
+				sample.ppo2.sensor = i;
+				sample.ppo2.value = ppo2 * 10.0 / BAR;
+				if (callback) callback(DC_SAMPLE_PPO2, &sample, userdata);
+			}
+		} else if (id == MEASURE_ID_OXYGEN_MV) {
+			for (unsigned int i = 0; i < NSENSORS; ++i) {
+				unsigned int value = array_uint16_le (data + offset + 4 + i * 2);
+				unsigned int state = data[offset + 12 + i];
+				if (!parser->calibrated || parser->calibration[i] == 0 ||
+					state == SENSTAT_UNCALIBRATED || state == SENSTAT_NOT_EXIST)
+					continue;
+				sample.ppo2.sensor = i;
+				sample.ppo2.value = value / 100.0 * parser->calibration[i] / BAR;
+				if (callback) callback(DC_SAMPLE_PPO2, &sample, userdata);
 			}
-		} else if (type == LREC_STATE) {
-			// Tissue saturation record.
 		}
+	} else if (type == LREC_STATE) {
+		// Tissue saturation record.
+	}
 
-		offset += RECORD_SIZE;
+	return DC_STATUS_SUCCESS;
+}
+
+static dc_status_t
+divesoft_freedom_parser_records (divesoft_freedom_parser_t *parser, divesoft_freedom_state_t *state, dc_sample_callback_t callback, void *userdata)
+{
+	dc_parser_t *abstract = (dc_parser_t *) parser;
+	const unsigned char *data = abstract->data;
+	unsigned int size = abstract->size;
+
+	if (state->offset < parser->headersize)
+		state->offset = parser->headersize;
+
+	while (state->offset + RECORD_SIZE <= size) {
+		dc_status_t status = divesoft_freedom_parser_record (parser, state, data, state->offset, callback, userdata);
+		if (status != DC_STATUS_SUCCESS)
+			return status;
+
+		state->offset += RECORD_SIZE;
 	}
 
 	return DC_STATUS_SUCCESS;
 }
+
+static dc_status_t
+divesoft_freedom_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_t callback, void *userdata)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	divesoft_freedom_parser_t *parser = (divesoft_freedom_parser_t *) abstract;
+
+	// Cache the header data.
+	status = divesoft_freedom_cache (parser);
+	if (status != DC_STATUS_SUCCESS)
+		return status;
+
+	divesoft_freedom_state_t state = {0, UNDEFINED, 0};
+
+	return divesoft_freedom_parser_records (parser, &state, callback, userdata);
+}
+
+static dc_status_t
+divesoft_freedom_parser_samples_append (dc_parser_t *abstract, dc_sample_callback_t callback, void *userdata)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	divesoft_freedom_parser_t *parser = (divesoft_freedom_parser_t *) abstract;
+
+	// The new records may contain additional gas mixes, tanks and
+	// configuration data. Only the new samples are emitted, but the
+	// cached data is updated from the entire dive.
+	parser->cached = 0;
+	status = divesoft_freedom_cache (parser);
+	if (status != DC_STATUS_SUCCESS)
+		return status;
+
+	return divesoft_freedom_parser_records (parser, &parser->live, callback, userdata);
+}
@@ -110,9 +110,11 @@ static const dc_device_vtable_t divesystem_idive_device_vtable = {
 	DC_FAMILY_DIVESYSTEM_IDIVE,
 	divesystem_idive_device_set_fingerprint, /* set_fingerprint */
 	NULL, /* read */
+	NULL, /* read_range */
 	NULL, /* write */
 	NULL, /* dump */
 	divesystem_idive_device_foreach, /* foreach */
+	NULL, /* foreach_header */
 	divesystem_idive_device_timesync, /* timesync */
 	divesystem_idive_device_close /* close */
 };
@@ -420,6 +422,8 @@ divesystem_idive_transfer (divesystem_idive_device_t *device, const unsigned cha
 		if (nretries++ >= MAXRETRIES)
 			break;
 
+		device_stats_retry ((dc_device_t *) device);
+
 		// Delay the next attempt.
 		dc_iostream_sleep (device->iostream, 100);
 	}
@@ -529,8 +533,12 @@ divesystem_idive_device_foreach (dc_device_t *abstract, dc_dive_callback_t callb
 		progress.current = i * NSTEPS + STEP(1, nsamples + 1);
 		device_event_emit (abstract, DC_EVENT_PROGRESS, &progress);
 
+		// Reserve space for all sample packets, including the unused
+		// samples at the end of the last packet.
+		unsigned int npackets = (nsamples + commands->nsamples - 1) / commands->nsamples;
+		unsigned int packetsize = commands->sample.size * commands->nsamples;
 		dc_buffer_clear(buffer);
-		dc_buffer_reserve(buffer, commands->header.size + commands->sample.size * nsamples);
+		dc_buffer_reserve(buffer, commands->header.size + packetsize * npackets);
 
 		if (!dc_buffer_append(buffer, packet, commands->header.size)) {
 			ERROR (abstract->context, "Insufficient buffer space available.");
@@ -543,7 +551,16 @@ divesystem_idive_device_foreach (dc_device_t *abstract, dc_dive_callback_t callb
 			unsigned char cmd_sample[] = {commands->sample.cmd,
 				(idx     ) & 0xFF,
 				(idx >> 8) & 0xFF};
-			rc = divesystem_idive_transfer (device, cmd_sample, sizeof(cmd_sample), packet, commands->sample.size * commands->nsamples, &errcode);
+
+			// Receive the samples directly into the dive buffer.
+			unsigned int offset = dc_buffer_get_size(buffer);
+			if (!dc_buffer_resize(buffer, offset + packetsize)) {
+				ERROR (abstract->context, "Insufficient buffer space available.");
+				dc_buffer_free(buffer);
+				return DC_STATUS_NOMEMORY;
+			}
+
+			rc = divesystem_idive_transfer (device, cmd_sample, sizeof(cmd_sample), dc_buffer_get_data(buffer) + offset, packetsize, &errcode);
 			if (rc != DC_STATUS_SUCCESS) {
 				dc_buffer_free(buffer);
 				return rc;
@@ -555,17 +572,12 @@ divesystem_idive_device_foreach (dc_device_t *abstract, dc_dive_callback_t callb
 			unsigned int n = commands->nsamples;
 			if (j + n > nsamples) {
 				n = nsamples - j;
+				dc_buffer_resize(buffer, offset + commands->sample.size * n);
 			}
 
 			// Update and emit a progress event.
 			progress.current = i * NSTEPS + STEP(j + n + 1, nsamples + 1);
 			device_event_emit (abstract, DC_EVENT_PROGRESS, &progress);
-
-			if (!dc_buffer_append(buffer, packet, commands->sample.size * n)) {
-				ERROR (abstract->context, "Insufficient buffer space available.");
-				dc_buffer_free(buffer);
-				return DC_STATUS_NOMEMORY;
-			}
 		}
 
 		unsigned char *data = dc_buffer_get_data(buffer);
@@ -701,7 +713,6 @@ static dc_status_t
 divesystem_idive_firmware_readfile (dc_buffer_t *buffer, dc_context_t *context, const char *filename)
 {
 	dc_status_t status = DC_STATUS_SUCCESS;
-	dc_buffer_t *tmp = NULL;
 	FILE *fp = NULL;
 
 	if (!dc_buffer_clear (buffer)) {
@@ -709,46 +720,52 @@ divesystem_idive_firmware_readfile (dc_buffer_t *buffer, dc_context_t *context,
 		return DC_STATUS_INVALIDARGS;
 	}
 
-	// Allocate a temporary buffer.
-	tmp = dc_buffer_new (0x20000);
-	if (tmp == NULL) {
-		ERROR (context, "Failed to allocate memory.");
-		status = DC_STATUS_NOMEMORY;
-		goto error_exit;
-	}
-
 	// Open the file.
 	fp = fopen (filename, "rb");
 	if (fp == NULL) {
 		ERROR (context, "Failed to open the file.");
-		status = DC_STATUS_IO;
-		goto error_free;
+		return DC_STATUS_IO;
 	}
 
-	// Read the entire file into the buffer.
-	size_t n = 0;
-	unsigned char block[4096] = {0};
-	while ((n = fread (block, 1, sizeof (block), fp)) > 0) {
-		if (!dc_buffer_append (tmp, block, n)) {
+	// Reserve the space for the binary data upfront.
+	if (fseek (fp, 0, SEEK_END) == 0) {
+		long length = ftell (fp);
+		if (length > 0 && !dc_buffer_reserve (buffer, length / 2)) {
 			ERROR (context, "Insufficient buffer space available.");
 			status = DC_STATUS_NOMEMORY;
 			goto error_close;
 		}
+		rewind (fp);
 	}
 
-	// Resize the output buffer.
-	size_t nbytes = dc_buffer_get_size (tmp);
-	if (!dc_buffer_resize (buffer, nbytes / 2)) {
-		ERROR (context, "Insufficient buffer space available.");
-		status = DC_STATUS_NOMEMORY;
-		goto error_close;
+	// Convert the file to binary data while reading, without keeping
+	// a copy of the hex data in memory. An odd digit at the end of a
+	// block is carried over to the next block.
+	size_t n = 0, carry = 0;
+	unsigned char block[4096] = {0};
+	while ((n = fread (block + carry, 1, sizeof (block) - carry, fp)) > 0) {
+		size_t navailable = carry + n;
+		size_t nbytes = navailable / 2;
+		size_t offset = dc_buffer_get_size (buffer);
+
+		if (!dc_buffer_resize (buffer, offset + nbytes)) {
+			ERROR (context, "Insufficient buffer space available.");
+			status = DC_STATUS_NOMEMORY;
+			goto error_close;
+		}
+
+		if (array_convert_hex2bin (block, nbytes * 2, dc_buffer_get_data (buffer) + offset, nbytes) != 0) {
+			ERROR (context, "Unexpected data format.");
+			status = DC_STATUS_DATAFORMAT;
+			goto error_close;
+		}
+
+		carry = navailable % 2;
+		if (carry)
+			block[0] = block[navailable - 1];
 	}
 
-	// Convert to binary data.
-	int rc = array_convert_hex2bin (
-		dc_buffer_get_data (tmp), dc_buffer_get_size (tmp),
-		dc_buffer_get_data (buffer), dc_buffer_get_size (buffer));
-	if (rc != 0) {
+	if (carry) {
 		ERROR (context, "Unexpected data format.");
 		status = DC_STATUS_DATAFORMAT;
 		goto error_close;
@@ -756,19 +773,24 @@ divesystem_idive_firmware_readfile (dc_buffer_t *buffer, dc_context_t *context,
 
 error_close:
 	fclose (fp);
-error_free:
-	dc_buffer_free (tmp);
-error_exit:
 	return status;
 }
 
+/*
+ * Send a frame, and wait for the bootloader to accept it. While busy,
+ * the bootloader sends wait bytes. The delay after a wait byte starts
+ * at the (conservative) value for the model, and adapts to the time
+ * the bootloader actually needs: it's halved when a single wait was
+ * sufficient, and doubled again when several were needed.
+ */
 static dc_status_t
-divesystem_idive_firmware_send (divesystem_idive_device_t *device, const divesystem_idive_signature_t *signature, const unsigned char data[], size_t size)
+divesystem_idive_firmware_send (divesystem_idive_device_t *device, const divesystem_idive_signature_t *signature, unsigned int *delay, const unsigned char data[], size_t size)
 {
 	dc_status_t status = DC_STATUS_SUCCESS;
 	dc_device_t *abstract = (dc_device_t *) device;
 
 	unsigned int nretries = 0;
+	unsigned int nwaits = 0;
 	while (1) {
 		// Send the frame.
 		status = dc_iostream_write (device->iostream, data, size, NULL);
@@ -795,7 +817,8 @@ divesystem_idive_firmware_send (divesystem_idive_device_t *device, const divesys
 				state = response;
 				break;
 			case WAIT:
-				dc_iostream_sleep (device->iostream, signature->delay);
+				dc_iostream_sleep (device->iostream, *delay);
+				nwaits++;
 				break;
 			case 'A':
 			case 'B':
@@ -823,6 +846,17 @@ divesystem_idive_firmware_send (divesystem_idive_device_t *device, const divesys
 			ERROR (abstract->context, "Maximum number of retries reached.");
 			return DC_STATUS_PROTOCOL;
 		}
+
+		device_stats_retry (abstract);
+	}
+
+	// Adapt the delay for the next frame.
+	if (nwaits == 1 && *delay > 1) {
+		*delay /= 2;
+	} else if (nwaits > 1) {
+		*delay *= 2;
+		if (*delay > signature->delay)
+			*delay = signature->delay;
 	}
 
 	return DC_STATUS_SUCCESS;
@@ -836,7 +870,7 @@ divesystem_idive_device_fwupdate (dc_device_t *abstract, const char *filename)
 	unsigned int errcode = 0;
 
 	// Allocate memory for the firmware data.
-	dc_buffer_t *buffer = dc_buffer_new (0);
+	dc_buffer_t *buffer = dc_buffer_new_context (abstract->context, 0);
 	if (buffer == NULL) {
 		ERROR (abstract->context, "Failed to allocate memory for the firmware data.");
 		status = DC_STATUS_NOMEMORY;
@@ -929,6 +963,7 @@ divesystem_idive_device_fwupdate (dc_device_t *abstract, const char *filename)
 	dc_iostream_sleep (device->iostream, 100);
 
 	// Upload the firmware.
+	unsigned int delay = signature->delay;
 	unsigned int offset = 0;
 	while (offset + 2 <= size) {
 		// Get the number of bytes in the current frame.
@@ -940,7 +975,7 @@ divesystem_idive_device_fwupdate (dc_device_t *abstract, const char *filename)
 		}
 
 		// Send the frame.
-		status = divesystem_idive_firmware_send (device, signature, data + offset, len);
+		status = divesystem_idive_firmware_send (device, signature, &delay, data + offset, len);
 		if (status != DC_STATUS_SUCCESS) {
 			ERROR (abstract->context, "Failed to send the frame.");
 			goto error_free;
@@ -95,6 +95,7 @@ struct divesystem_idive_parser_t {
 static dc_status_t divesystem_idive_parser_get_datetime (dc_parser_t *abstract, dc_datetime_t *datetime);
 static dc_status_t divesystem_idive_parser_get_field (dc_parser_t *abstract, dc_field_type_t type, unsigned int flags, void *value);
 static dc_status_t divesystem_idive_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_t callback, void *userdata);
+static dc_status_t divesystem_idive_parser_reset (dc_parser_t *abstract);
 
 static const dc_parser_vtable_t divesystem_idive_parser_vtable = {
 	sizeof(divesystem_idive_parser_t),
@@ -104,7 +105,13 @@ static const dc_parser_vtable_t divesystem_idive_parser_vtable = {
 	NULL, /* set_density */
 	divesystem_idive_parser_get_datetime, /* datetime */
 	divesystem_idive_parser_get_field, /* fields */
+	NULL, /* summary */
 	divesystem_idive_parser_samples_foreach, /* samples_foreach */
+	NULL, /* samples_batch */
+	NULL, /* samples_fixed */
+	NULL, /* samples_append */
+	NULL, /* samples_range */
+	divesystem_idive_parser_reset, /* reset */
 	NULL /* destroy */
 };
 
@@ -131,6 +138,19 @@ divesystem_idive_parser_create (dc_parser_t **out, dc_context_t *context, const
 	} else {
 		parser->headersize = SZ_HEADER_IDIVE;
 	}
+	divesystem_idive_parser_reset ((dc_parser_t *) parser);
+
+	*out = (dc_parser_t*) parser;
+
+	return DC_STATUS_SUCCESS;
+}
+
+
+static dc_status_t
+divesystem_idive_parser_reset (dc_parser_t *abstract)
+{
+	divesystem_idive_parser_t *parser = (divesystem_idive_parser_t *) abstract;
+
 	parser->cached = 0;
 	parser->divemode = INVALID;
 	parser->divetime = 0;
@@ -150,9 +170,6 @@ divesystem_idive_parser_create (dc_parser_t **out, dc_context_t *context, const
 	parser->gf_low = INVALID;
 	parser->gf_high = INVALID;
 
-
-	*out = (dc_parser_t*) parser;
-
 	return DC_STATUS_SUCCESS;
 }
 
@@ -381,6 +398,12 @@ divesystem_idive_parser_get_field (dc_parser_t *abstract, dc_field_type_t type,
 				}
 			}
 			break;
+		case DC_FIELD_SAMPLE_COUNT:
+			if (flags != DC_SAMPLE_TIME && flags != DC_SAMPLE_DEPTH)
+				return DC_STATUS_UNSUPPORTED;
+			// The iDive samples are the smallest ones.
+			*((unsigned int *) value) = (abstract->size - parser->headersize) / SZ_SAMPLE_IDIVE;
+			break;
 		default:
 			return DC_STATUS_UNSUPPORTED;
 		}
@@ -1,15 +1,83 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <stdarg.h>
 #include <string.h>
+#include <stddef.h>
 
 #include "parser-private.h"
+#include "context-private.h"
 #include "field-cache.h"
 
+// The arena starts small, and never grows beyond
+// what the maximum number of strings can need.
+#define CHUNKSIZE 1024
+#define MAXARENA (MAXSTRINGS * 256)
+
+struct dc_field_chunk {
+	dc_field_chunk_t *next;
+	size_t size, used;
+};
+
+static char *dc_field_arena_alloc(dc_field_arena_t *arena, size_t len)
+{
+	dc_field_chunk_t *chunk;
+	size_t size;
+
+	for (chunk = arena->chunks; chunk; chunk = chunk->next) {
+		if (chunk->size - chunk->used >= len) {
+			char *p = (char *) (chunk + 1) + chunk->used;
+			chunk->used += len;
+			return p;
+		}
+	}
+
+	size = arena->chunks ? arena->chunks->size * 2 : CHUNKSIZE;
+	while (size < len)
+		size *= 2;
+	if (arena->allocated + size > MAXARENA) {
+		size = MAXARENA - arena->allocated;
+		if (size < len)
+			return NULL;
+	}
+
+	chunk = (dc_field_chunk_t *) dc_context_malloc(arena->context, sizeof(*chunk) + size);
+	if (!chunk)
+		return NULL;
+	chunk->next = arena->chunks;
+	chunk->size = size;
+	chunk->used = len;
+	arena->chunks = chunk;
+	arena->allocated += size;
+
+	return (char *) (chunk + 1);
+}
+
+static void dc_field_arena_rewind(dc_field_arena_t *arena)
+{
+	dc_field_chunk_t *chunk;
+
+	for (chunk = arena->chunks; chunk; chunk = chunk->next)
+		chunk->used = 0;
+}
+
+static void dc_field_arena_free(dc_field_arena_t *arena)
+{
+	dc_field_chunk_t *chunk = arena->chunks;
+
+	while (chunk) {
+		dc_field_chunk_t *next = chunk->next;
+		dc_context_release(arena->context, chunk);
+		chunk = next;
+	}
+	arena->chunks = NULL;
+	arena->allocated = 0;
+}
+
 /*
  * The field cache 'string' interface has some simple rules:
  * the "descriptor" part is assumed to be a static allocation,
  * while the "value" is something that this interface will
- * always allocate with 'strdup()', so you can generate it
+ * always copy into the cache arena, so you can generate it
  * dynamically on the stack or whatever without having to
  * worry about it.
  */
@@ -20,11 +88,18 @@ dc_status_t dc_field_add_string(dc_field_cache_t *cache, const char *desc, const
 	cache->initialized |= 1 << DC_FIELD_STRING;
 	for (i = 0; i < MAXSTRINGS; i++) {
 		dc_field_string_t *str = cache->strings+i;
+		size_t len;
+		char *p;
+
 		if (str->desc)
 			continue;
-		str->value = strdup(value);
-		if (!str->value)
+		len = strlen(value) + 1;
+		p = dc_field_arena_alloc(&cache->arena, len);
+		if (!p)
 			return DC_STATUS_NOMEMORY;
+		memcpy(p, value, len);
+		str->value = p;
+		cache->nstrings = i + 1;
 		str->desc = desc;
 		return DC_STATUS_SUCCESS;
 	}
@@ -64,6 +139,219 @@ dc_status_t dc_field_get_string(dc_field_cache_t *cache, unsigned idx, dc_field_
 }
 
 
+/*
+ * Initialize an empty cache. The memory for the strings
+ * is allocated with the allocator of the context.
+ */
+void dc_field_init(dc_field_cache_t *cache, dc_context_t *context)
+{
+	memset(cache, 0, sizeof(*cache));
+	cache->arena.context = context;
+}
+
+/*
+ * Drop the string values and mark all fields as
+ * uninitialized again, so the cache can be refilled.
+ * The arena memory is kept around for reuse.
+ */
+void dc_field_clear(dc_field_cache_t *cache)
+{
+	dc_field_arena_t arena = cache->arena;
+	unsigned int ngases = cache->ngases;
+	unsigned int nstrings = cache->nstrings;
+
+	// Backends also fill the gas mixes directly, up to the count.
+	if (ngases < cache->GASMIX_COUNT)
+		ngases = cache->GASMIX_COUNT;
+	if (ngases > MAXGASES)
+		ngases = MAXGASES;
+
+	dc_field_arena_rewind(&arena);
+	memset(cache, 0, offsetof(dc_field_cache_t, GASMIX));
+	memset(cache->GASMIX, 0, ngases * sizeof(cache->GASMIX[0]));
+	memset(cache->tankinfo, 0, ngases * sizeof(cache->tankinfo[0]));
+	memset(cache->tankusage, 0, ngases * sizeof(cache->tankusage[0]));
+	memset(cache->tanksize, 0, ngases * sizeof(cache->tanksize[0]));
+	memset(cache->tankworkingpressure, 0, ngases * sizeof(cache->tankworkingpressure[0]));
+	memset(cache->strings, 0, nstrings * sizeof(cache->strings[0]));
+	cache->arena = arena;
+}
+
+/*
+ * Release all memory owned by the cache.
+ */
+void dc_field_free(dc_field_cache_t *cache)
+{
+	dc_context_t *context = cache->arena.context;
+
+	dc_field_arena_free(&cache->arena);
+	dc_field_init(cache, context);
+}
+
+/*
+ * The string table entries are kept sorted by key, so
+ * that the lookup is a simple binary search. The entry
+ * array may move around when it grows, but the strings
+ * themselves never do.
+ */
+static unsigned int dc_string_find(const dc_string_table_t *table, unsigned int key)
+{
+	unsigned int lo = 0, hi = table->count;
+
+	while (lo < hi) {
+		unsigned int mid = lo + (hi - lo) / 2;
+		if (table->entries[mid].key < key)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+const char *dc_string_lookup(const dc_string_table_t *table, unsigned int key)
+{
+	unsigned int idx = dc_string_find(table, key);
+
+	if (idx < table->count && table->entries[idx].key == key)
+		return table->entries[idx].value;
+	return NULL;
+}
+
+const char *dc_string_intern(dc_string_table_t *table, unsigned int key, const char *value, size_t len)
+{
+	unsigned int idx = dc_string_find(table, key);
+	dc_string_entry_t *entry;
+	char *str;
+
+	if (idx < table->count && table->entries[idx].key == key)
+		return table->entries[idx].value;
+
+	if (table->count == table->allocated) {
+		unsigned int allocated = table->allocated ? table->allocated * 2 : 16;
+		dc_string_entry_t *entries = (dc_string_entry_t *) dc_context_realloc(table->context, table->entries, allocated * sizeof(*entries));
+		if (!entries)
+			return NULL;
+		table->entries = entries;
+		table->allocated = allocated;
+	}
+
+	str = (char *) dc_context_malloc(table->context, len + 1);
+	if (!str)
+		return NULL;
+	memcpy(str, value, len);
+	str[len] = 0;
+
+	entry = table->entries + idx;
+	memmove(entry + 1, entry, (table->count - idx) * sizeof(*entry));
+	entry->key = key;
+	entry->value = str;
+	table->count++;
+
+	return str;
+}
+
+void dc_string_init(dc_string_table_t *table, dc_context_t *context)
+{
+	memset(table, 0, sizeof(*table));
+	table->context = context;
+}
+
+void dc_string_clear(dc_string_table_t *table)
+{
+	unsigned int i;
+
+	for (i = 0; i < table->count; i++)
+		dc_context_release(table->context, table->entries[i].value);
+	dc_context_release(table->context, table->entries);
+	dc_string_init(table, table->context);
+}
+
+void dc_gasmix_map_clear(dc_gasmix_map_t *map)
+{
+	memset(map, 0, sizeof(*map));
+}
+
+/*
+ * Open addressing with linear probing. The slots hold the
+ * entry number plus one, so zero means an empty slot. With
+ * at most MAXGASES entries in GASMIX_SLOTS slots, the table
+ * never fills up and the probe sequence stays short.
+ */
+static unsigned int dc_gasmix_hash(unsigned int oxygen, unsigned int helium, unsigned int usage)
+{
+	unsigned int hash = oxygen * 0x9E3779B1u;
+
+	hash = (hash ^ helium) * 0x85EBCA77u;
+	hash = (hash ^ usage) * 0xC2B2AE3Du;
+	return (hash >> 16) % GASMIX_SLOTS;
+}
+
+unsigned int dc_gasmix_map_find(const dc_gasmix_map_t *map, unsigned int oxygen, unsigned int helium, unsigned int usage)
+{
+	unsigned int slot = dc_gasmix_hash(oxygen, helium, usage);
+
+	while (map->slots[slot]) {
+		const dc_gasmix_entry_t *entry = map->entries + map->slots[slot] - 1;
+		if (entry->oxygen == oxygen && entry->helium == helium && entry->usage == usage)
+			return entry->index;
+		slot = (slot + 1) % GASMIX_SLOTS;
+	}
+	return DC_GASMIX_UNKNOWN;
+}
+
+/*
+ * Returns zero on success, including when the key is already
+ * present, and -1 when the map is full.
+ */
+int dc_gasmix_map_insert(dc_gasmix_map_t *map, unsigned int oxygen, unsigned int helium, unsigned int usage, unsigned int index)
+{
+	unsigned int slot = dc_gasmix_hash(oxygen, helium, usage);
+	dc_gasmix_entry_t *entry;
+
+	while (map->slots[slot]) {
+		entry = map->entries + map->slots[slot] - 1;
+		if (entry->oxygen == oxygen && entry->helium == helium && entry->usage == usage)
+			return 0;
+		slot = (slot + 1) % GASMIX_SLOTS;
+	}
+
+	if (map->count == MAXGASES)
+		return -1;
+
+	entry = map->entries + map->count++;
+	entry->oxygen = oxygen;
+	entry->helium = helium;
+	entry->usage = usage;
+	entry->index = index;
+	map->slots[slot] = map->count;
+	return 0;
+}
+
+/*
+ * Run the resolver for a field the first time it's asked
+ * for. Fields without a resolver are assumed to be filled
+ * in up front.
+ */
+dc_status_t dc_field_resolve(dc_field_cache_t *cache, dc_parser_t *parser, const dc_field_resolver_t resolvers[], unsigned int count, dc_field_type_t type)
+{
+	dc_status_t rc;
+
+	if ((unsigned int) type >= count || !resolvers[type])
+		return DC_STATUS_SUCCESS;
+
+	if (cache->resolved & (1u << type))
+		return DC_STATUS_SUCCESS;
+
+	rc = resolvers[type](parser, type);
+	if (rc != DC_STATUS_SUCCESS)
+		return rc;
+
+	// The resolver may have cleared the cache, so mark it afterwards.
+	cache->resolved |= 1u << type;
+
+	return DC_STATUS_SUCCESS;
+}
+
 /*
  * Use this generic "pick fields from the field cache" helper
  * after you've handled all the ones you do differently
@@ -117,3 +405,82 @@ dc_field_get(dc_field_cache_t *cache, dc_field_type_t type, unsigned int flags,
 
 	return DC_STATUS_UNSUPPORTED;
 }
+
+/*
+ * Copy everything in the cache into a summary at once,
+ * the same way dc_field_get() returns the fields one by
+ * one. The backend adds the fields that are not cached.
+ */
+void
+dc_field_summary(dc_field_cache_t *cache, dc_parser_summary_t *summary)
+{
+	unsigned int initialized = cache->initialized;
+	unsigned int fields = initialized & (
+		DC_FIELD_MASK(DC_FIELD_DIVETIME) |
+		DC_FIELD_MASK(DC_FIELD_MAXDEPTH) |
+		DC_FIELD_MASK(DC_FIELD_AVGDEPTH) |
+		DC_FIELD_MASK(DC_FIELD_GASMIX_COUNT) |
+		DC_FIELD_MASK(DC_FIELD_GASMIX) |
+		DC_FIELD_MASK(DC_FIELD_SALINITY) |
+		DC_FIELD_MASK(DC_FIELD_ATMOSPHERIC) |
+		DC_FIELD_MASK(DC_FIELD_TANK_COUNT) |
+		DC_FIELD_MASK(DC_FIELD_TANK) |
+		DC_FIELD_MASK(DC_FIELD_DIVEMODE));
+
+	if (initialized & DC_FIELD_MASK(DC_FIELD_DIVETIME))
+		summary->divetime = cache->DIVETIME;
+	if (initialized & DC_FIELD_MASK(DC_FIELD_MAXDEPTH))
+		summary->maxdepth = cache->MAXDEPTH;
+	if (initialized & DC_FIELD_MASK(DC_FIELD_AVGDEPTH))
+		summary->avgdepth = cache->AVGDEPTH;
+	if (initialized & DC_FIELD_MASK(DC_FIELD_SALINITY))
+		summary->salinity = cache->SALINITY;
+	if (initialized & DC_FIELD_MASK(DC_FIELD_ATMOSPHERIC))
+		summary->atmospheric = cache->ATMOSPHERIC;
+	if (initialized & DC_FIELD_MASK(DC_FIELD_DIVEMODE))
+		summary->divemode = cache->DIVEMODE;
+
+	// Both counts are stored in the same member.
+	if (initialized & DC_FIELD_MASK(DC_FIELD_GASMIX_COUNT))
+		summary->gasmix_count = cache->GASMIX_COUNT;
+	if (initialized & DC_FIELD_MASK(DC_FIELD_TANK_COUNT))
+		summary->tank_count = cache->GASMIX_COUNT;
+
+	if (initialized & DC_FIELD_MASK(DC_FIELD_GASMIX)) {
+		unsigned int n = summary->gasmix_count;
+		if (n > MAXGASES)
+			n = MAXGASES;
+		if (n > DC_SUMMARY_GASMIXES)
+			n = DC_SUMMARY_GASMIXES;
+		memcpy(summary->gasmix, cache->GASMIX, n * sizeof(cache->GASMIX[0]));
+	}
+
+	if (initialized & DC_FIELD_MASK(DC_FIELD_TANK)) {
+		unsigned int n = summary->tank_count;
+		if (n > MAXGASES)
+			n = MAXGASES;
+		if (n > DC_SUMMARY_TANKS)
+			n = DC_SUMMARY_TANKS;
+		for (unsigned int i = 0; i < n; i++) {
+			dc_tank_t *tank = summary->tank + i;
+			tank->volume = cache->tanksize[i];
+			tank->gasmix = i;
+			tank->workpressure = cache->tankworkingpressure[i];
+			tank->type = cache->tankinfo[i];
+		}
+	}
+
+	if (initialized & DC_FIELD_MASK(DC_FIELD_STRING)) {
+		unsigned int n = 0;
+		while (n < MAXSTRINGS && n < DC_SUMMARY_STRINGS &&
+			cache->strings[n].desc && cache->strings[n].value) {
+			summary->string[n] = cache->strings[n];
+			n++;
+		}
+		summary->string_count = n;
+		if (n)
+			fields |= DC_FIELD_MASK(DC_FIELD_STRING);
+	}
+
+	summary->fields |= fields;
+}
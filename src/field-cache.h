@@ -1,27 +1,55 @@
 #include <string.h>
 
-#define MAXGASES 16
+#define MAXGASES 20
 #define MAXSTRINGS 32
 
-// dc_get_field() data
+/*
+ * The string values are bump-allocated from a small
+ * arena owned by the cache. Clearing the cache only
+ * rewinds the arena, so the memory is reused for the
+ * next dive, and it's released by dc_field_free().
+ */
+typedef struct dc_field_chunk dc_field_chunk_t;
+
+typedef struct dc_field_arena {
+	dc_context_t *context;
+	dc_field_chunk_t *chunks;
+	size_t allocated;
+} dc_field_arena_t;
+
+/*
+ * dc_get_field() data
+ *
+ * The scalar fields and the bookkeeping come first, and
+ * only take a couple of cache lines. The per-gas arrays
+ * and the strings are cleared up to what is actually in
+ * use, not as a whole.
+ */
 typedef struct dc_field_cache {
 	unsigned int initialized;
+	unsigned int resolved;
 
 	// DC_GET_FIELD_xyz
 	unsigned int DIVETIME;
+	unsigned int GASMIX_COUNT;
+	dc_divemode_t DIVEMODE;
+	dc_salinity_t SALINITY;
 	double MAXDEPTH;
 	double AVGDEPTH;
 	double ATMOSPHERIC;
-	dc_divemode_t DIVEMODE;
-	unsigned int GASMIX_COUNT;
-	dc_salinity_t SALINITY;
-	dc_gasmix_t GASMIX[MAXGASES];
 
 	// misc - clean me up!
 	double lowsetpoint;
 	double highsetpoint;
 	double customsetpoint;
 
+	// High water marks of the arrays below
+	unsigned int ngases;
+	unsigned int nstrings;
+	dc_field_arena_t arena;
+
+	dc_gasmix_t GASMIX[MAXGASES];
+
 	// This (along with GASMIX) should be something like
 	//     dc_tank_t TANK[MAXGASES]
 	// but that's for later
@@ -34,10 +62,73 @@ typedef struct dc_field_cache {
 	dc_field_string_t strings[MAXSTRINGS];
 } dc_field_cache_t;
 
+/*
+ * Lazy field resolution.
+ *
+ * A backend can register a resolver per field type, which
+ * fills in that field (and possibly others) on first use.
+ * The result is remembered in the 'resolved' bitmap until
+ * the cache is cleared.
+ */
+typedef dc_status_t (*dc_field_resolver_t) (dc_parser_t *parser, dc_field_type_t type);
+
+dc_status_t dc_field_resolve(dc_field_cache_t *, dc_parser_t *, const dc_field_resolver_t resolvers[], unsigned int count, dc_field_type_t type);
+
 dc_status_t dc_field_add_string(dc_field_cache_t *, const char *desc, const char *data);
 dc_status_t dc_field_add_string_fmt(dc_field_cache_t *, const char *desc, const char *fmt, ...);
 dc_status_t dc_field_get_string(dc_field_cache_t *, unsigned idx, dc_field_string_t *value);
 dc_status_t dc_field_get(dc_field_cache_t *, dc_field_type_t, unsigned int, void *);
+void dc_field_summary(dc_field_cache_t *, dc_parser_summary_t *);
+void dc_field_init(dc_field_cache_t *, dc_context_t *);
+void dc_field_clear(dc_field_cache_t *);
+void dc_field_free(dc_field_cache_t *);
+
+/*
+ * Interned strings for sample events, looked up by a
+ * backend-defined key. The strings stay valid until the
+ * table is cleared, so they can be handed out as the
+ * 'event.name' of a sample without any per-sample
+ * allocations.
+ */
+typedef struct dc_string_entry {
+	unsigned int key;
+	char *value;
+} dc_string_entry_t;
+
+typedef struct dc_string_table {
+	dc_context_t *context;
+	dc_string_entry_t *entries;
+	unsigned int count, allocated;
+} dc_string_table_t;
+
+const char *dc_string_lookup(const dc_string_table_t *, unsigned int key);
+const char *dc_string_intern(dc_string_table_t *, unsigned int key, const char *value, size_t len);
+void dc_string_init(dc_string_table_t *, dc_context_t *);
+void dc_string_clear(dc_string_table_t *);
+
+/*
+ * Small hash map from a gas mix to its index in the backend's list
+ * of gas mixes, used to resolve gas switches in the samples. The
+ * usage is part of the key, and can be any backend specific value
+ * (diluent flag, mix type, gas id). The caller chooses the index,
+ * and the first index stored for a key wins, just like the first
+ * match of a linear search.
+ */
+#define GASMIX_SLOTS 64
+
+typedef struct dc_gasmix_entry {
+	unsigned int oxygen, helium, usage, index;
+} dc_gasmix_entry_t;
+
+typedef struct dc_gasmix_map {
+	unsigned int count;
+	dc_gasmix_entry_t entries[MAXGASES];
+	unsigned char slots[GASMIX_SLOTS];
+} dc_gasmix_map_t;
+
+void dc_gasmix_map_clear(dc_gasmix_map_t *);
+unsigned int dc_gasmix_map_find(const dc_gasmix_map_t *, unsigned int oxygen, unsigned int helium, unsigned int usage);
+int dc_gasmix_map_insert(dc_gasmix_map_t *, unsigned int oxygen, unsigned int helium, unsigned int usage, unsigned int index);
 
 /*
  * Macro to make it easy to set DC_FIELD_xyz values.
@@ -54,6 +145,8 @@ dc_status_t dc_field_get(dc_field_cache_t *, dc_field_type_t, unsigned int, void
 #define DC_ASSIGN_IDX(cache, name, idx, value) do { \
 	(cache).initialized |= 1u << DC_FIELD_##name; \
 	(cache).name[idx] = (value); \
+	if ((cache).ngases < (unsigned int) (idx) + 1) \
+		(cache).ngases = (idx) + 1; \
 } while (0)
 
 // Ugly define thing makes the code much easier to read
@@ -0,0 +1,191 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2026 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h> // malloc, free
+
+#include <libdivecomputer/fingerprint.h>
+
+#include "context-private.h"
+#include "recordstore.h"
+#include "array.h"
+
+/*
+ * Each update is appended as a record, containing the family type,
+ * model number, serial number and size, followed by the fingerprint
+ * data. The last valid record of each device wins, and an empty
+ * fingerprint removes the device.
+ */
+#define MAGIC          0x50464344 /* DCFP */
+#define FORMAT_VERSION 1
+
+#define SZ_RECORD  16
+#define SZ_MAXIMUM 0x10000
+
+#define INITIAL_CAPACITY 16
+
+struct dc_fingerprint_store_t {
+	dc_record_store_t *records;
+};
+
+static const dc_record_layout_t dc_fingerprint_layout = {
+	"fingerprint",
+	MAGIC, FORMAT_VERSION,
+	SZ_RECORD, SZ_MAXIMUM,
+	INITIAL_CAPACITY,
+	NULL,
+};
+
+#define DIGEST_K1 0x87C37B91114253D5ULL
+#define DIGEST_K2 0x4CF5AD432745937FULL
+
+static unsigned long long
+dc_digest_mix (unsigned long long h, unsigned long long k)
+{
+	k *= DIGEST_K1;
+	k = (k << 31) | (k >> 33);
+	k *= DIGEST_K2;
+
+	h ^= k;
+	h = (h << 27) | (h >> 37);
+	return h * 5 + 0x52DCE729;
+}
+
+/*
+ * Hash the data eight bytes at a time, with the round and finalization
+ * steps of MurmurHash3. The words are read in little endian byte order,
+ * so the result is the same on every platform.
+ */
+static unsigned long long
+dc_digest_update (unsigned long long h, const unsigned char data[], size_t size)
+{
+	size_t n = size & ~(size_t) 7;
+	for (size_t i = 0; i < n; i += 8) {
+		h = dc_digest_mix (h, array_uint64_le (data + i));
+	}
+
+	unsigned long long tail = 0;
+	for (size_t i = n; i < size; ++i) {
+		tail |= (unsigned long long) data[i] << (8 * (i - n));
+	}
+
+	return dc_digest_mix (h, tail ^ ((unsigned long long) size << 56));
+}
+
+dc_status_t
+dc_dive_digest (dc_family_t family, const unsigned char data[], unsigned int size, const unsigned char fingerprint[], unsigned int fsize, unsigned char digest[DC_DIVE_DIGEST_SIZE])
+{
+	if (digest == NULL || (data == NULL && size))
+		return DC_STATUS_INVALIDARGS;
+
+	unsigned long long h = family;
+	if (fingerprint && fsize) {
+		h = dc_digest_update (h, fingerprint, fsize);
+	} else {
+		h = dc_digest_update (~h, data, size);
+	}
+
+	h ^= h >> 33;
+	h *= 0xFF51AFD7ED558CCDULL;
+	h ^= h >> 33;
+	h *= 0xC4CEB9FE1A85EC53ULL;
+	h ^= h >> 33;
+
+	array_uint64_le_set (digest, h);
+
+	return DC_STATUS_SUCCESS;
+}
+
+static void
+dc_fingerprint_header (unsigned char buffer[SZ_RECORD], dc_family_t family, unsigned int model, unsigned int serial)
+{
+	array_uint32_le_set (buffer + 0, family);
+	array_uint32_le_set (buffer + 4, model);
+	array_uint32_le_set (buffer + 8, serial);
+	array_uint32_le_set (buffer + 12, 0);
+}
+
+dc_status_t
+dc_fingerprint_store_open (dc_fingerprint_store_t **out, dc_context_t *context, const char *filename)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	dc_fingerprint_store_t *store = NULL;
+
+	if (out == NULL || filename == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	// Allocate memory.
+	store = (dc_fingerprint_store_t *) malloc (sizeof (dc_fingerprint_store_t));
+	if (store == NULL) {
+		ERROR (context, "Failed to allocate memory.");
+		return DC_STATUS_NOMEMORY;
+	}
+
+	status = dc_record_store_open (&store->records, context, filename, &dc_fingerprint_layout);
+	if (status != DC_STATUS_SUCCESS) {
+		free (store);
+		return status;
+	}
+
+	*out = store;
+
+	return DC_STATUS_SUCCESS;
+}
+
+dc_status_t
+dc_fingerprint_store_get (dc_fingerprint_store_t *store, dc_family_t family, unsigned int model, unsigned int serial, dc_buffer_t *fingerprint)
+{
+	if (store == NULL || fingerprint == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	unsigned char header[SZ_RECORD];
+	dc_fingerprint_header (header, family, model, serial);
+
+	return dc_record_store_get (store->records, header, fingerprint);
+}
+
+dc_status_t
+dc_fingerprint_store_set (dc_fingerprint_store_t *store, dc_family_t family, unsigned int model, unsigned int serial, const unsigned char data[], unsigned int size)
+{
+	if (store == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	unsigned char header[SZ_RECORD];
+	dc_fingerprint_header (header, family, model, serial);
+
+	return dc_record_store_set (store->records, header, data, size);
+}
+
+dc_status_t
+dc_fingerprint_store_close (dc_fingerprint_store_t *store)
+{
+	if (store == NULL)
+		return DC_STATUS_SUCCESS;
+
+	dc_status_t status = dc_record_store_close (store->records);
+
+	free (store);
+
+	return status;
+}
@@ -19,6 +19,10 @@
  * MA 02110-1301 USA
  */
 
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -29,11 +33,16 @@
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <unistd.h>
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
 
 #include "garmin.h"
 #include "context-private.h"
 #include "device-private.h"
+#include "parser-private.h"
 #include "array.h"
+#include "thread.h"
 
 #ifdef HAVE_LIBMTP
 #include "libmtp.h"
@@ -68,9 +77,11 @@ static const dc_device_vtable_t garmin_device_vtable = {
 	DC_FAMILY_GARMIN,
 	garmin_device_set_fingerprint, /* set_fingerprint */
 	NULL, /* read */
+	NULL, /* read_range */
 	NULL, /* write */
 	NULL, /* dump */
 	garmin_device_foreach, /* foreach */
+	NULL, /* foreach_header */
 	NULL, /* timesync */
 	garmin_device_close, /* close */
 };
@@ -146,6 +157,7 @@ garmin_device_close (dc_device_t *abstract)
 
 struct fit_file {
 	char name[FILE_NAME_SIZE + 1];
+	char key[FILE_NAME_SIZE + 1]; // Sort key, with short names expanded
 	unsigned int mtp_id;
 };
 
@@ -183,24 +195,8 @@ static int name_cmp(const void *_a, const void *_b)
 	const struct fit_file *a = _a;
 	const struct fit_file *b = _b;
 
-	const char *a_name = a->name;
-	const char *b_name = b->name;
-
-	char a_buffer[FILE_NAME_SIZE];
-	char b_buffer[FILE_NAME_SIZE];
-
-	if (strlen(a_name) == 12) {
-		parse_short_name(a_name, a_buffer);
-		a_name = a_buffer;
-	}
-
-	if (strlen(b_name) == 12) {
-		parse_short_name(b_name, b_buffer);
-		b_name = b_buffer;
-	}
-
 	// Sort reverse string ordering (newest first), so use 'b,a'
-	return strcmp(b_name, a_name);
+	return strcmp(b->key, a->key);
 }
 
 /*
@@ -256,6 +252,57 @@ add_name(struct file_list *files, const char *name, unsigned int mtp_id)
 	strncpy(entry->name, name, FILE_NAME_SIZE);
 	entry->name[FILE_NAME_SIZE] = 0; // ensure it's null-terminated
 	entry->mtp_id = mtp_id;
+
+	// The sort key is computed once, instead of on every comparison.
+	if (strlen(entry->name) == 12)
+		parse_short_name(entry->name, entry->key);
+	else
+		strcpy(entry->key, entry->name);
+}
+
+/*
+ * Drop the files up to and including the fingerprint, and sort the
+ * remaining ones, newest first. That way only the new files need to
+ * be sorted.
+ */
+static void
+select_files(dc_device_t *abstract, struct file_list *files, const unsigned char fingerprint[])
+{
+	char key[FILE_NAME_SIZE + 1];
+	int found = 0;
+
+	for (int i = 0; i < files->nr; i++) {
+		const struct fit_file *entry = files->array + i;
+
+		if (memcmp(entry->name, fingerprint, FIT_NAME_SIZE))
+			continue;
+
+		DEBUG(abstract->context, "Ignoring '%s' and older", entry->name);
+		strcpy(key, entry->key);
+		found = 1;
+		break;
+	}
+
+	if (found) {
+		int n = 0;
+		for (int i = 0; i < files->nr; i++) {
+			if (strcmp(files->array[i].key, key) > 0)
+				files->array[n++] = files->array[i];
+		}
+		files->nr = n;
+	}
+
+	// Drop the files left out by a selective download.
+	int n = 0;
+	for (int i = 0; i < files->nr; i++) {
+		const struct fit_file *entry = files->array + i;
+		if (!device_is_excluded(abstract, (const unsigned char *) entry->name, FIT_NAME_SIZE))
+			files->array[n++] = *entry;
+	}
+	files->nr = n;
+
+	if (files->nr)
+		qsort(files->array, files->nr, sizeof(struct fit_file), name_cmp);
 }
 
 static dc_status_t
@@ -275,8 +322,6 @@ get_file_list(dc_device_t *abstract, DIR *dir, struct file_list *files)
 	}
 	DEBUG(abstract->context, "Found %d files", files->nr);
 
-	if (files->array)
-		qsort(files->array, files->nr, sizeof(struct fit_file), name_cmp);
 	return DC_STATUS_SUCCESS;
 }
 
@@ -373,8 +418,6 @@ mtp_get_file_list(dc_device_t *abstract, struct file_list *files)
 	free(rawdevices);
 	DEBUG(abstract->context, "Found %d files", files->nr);
 
-	if (files->array)
-		qsort(files->array, files->nr, sizeof(struct fit_file), name_cmp);
 	return DC_STATUS_SUCCESS;
 }
 
@@ -412,12 +455,16 @@ mtp_read_file(garmin_device_t *device, unsigned int file_id, dc_buffer_t *file)
 #endif
 
 static dc_status_t
-read_file(char *pathname, int pathlen, const char *name, dc_buffer_t *file)
+read_file(const char *dirname, const char *name, dc_buffer_t *file)
 {
+	char pathname[PATH_MAX];
+	size_t pathlen = strlen(dirname);
 	int fd, rc;
 
+	memcpy(pathname, dirname, pathlen);
 	pathname[pathlen] = '/';
 	memcpy(pathname+pathlen+1, name, FILE_NAME_SIZE);
+	pathname[pathlen+1+FILE_NAME_SIZE] = 0;
 	fd = open(pathname, O_RDONLY | O_BINARY);
 
 	if (fd < 0)
@@ -443,6 +490,185 @@ read_file(char *pathname, int pathlen, const char *name, dc_buffer_t *file)
 	return rc;
 }
 
+/*
+ * The files are read in batches, on up to NTHREADS threads, before the
+ * calling thread runs the dive detection on them. Opening and reading
+ * the many small activity files is dominated by the file system
+ * latency, and not by the bandwidth, so a few parallel reads hide most
+ * of it. The batches start with a single file and double in size up
+ * to PREFETCH files, so little is read in vain when the application
+ * stops the download after the first few dives.
+ */
+#define PREFETCH 8
+#define NTHREADS 4
+
+#if defined(HAVE_MMAP) && defined(HAVE_SYS_MMAN_H)
+#if !defined(MAP_ANONYMOUS) && defined(MAP_ANON)
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+#ifdef MAP_ANONYMOUS
+#define USE_MMAP
+#endif
+#endif
+
+struct fit_data {
+	dc_buffer_t *buffer;
+	unsigned char *base;
+	size_t length;
+	const unsigned char *data;
+	size_t size;
+	dc_status_t status;
+};
+
+typedef struct garmin_prefetch_t {
+	garmin_device_t *device;
+	const char *pathname;
+	const struct fit_file *files;
+	struct fit_data slots[PREFETCH];
+	unsigned int count;
+	unsigned int next;
+	dc_mutex_t mutex;
+} garmin_prefetch_t;
+
+static void
+unmap_file(struct fit_data *slot)
+{
+#ifdef USE_MMAP
+	if (slot->base)
+		munmap(slot->base, slot->length);
+#endif
+	slot->base = NULL;
+	slot->length = 0;
+}
+
+/*
+ * Map the file into memory, directly behind the filename fingerprint,
+ * so the parser and the callback can use it in place, without copying
+ * it into a buffer. A page of anonymous memory is reserved in front of
+ * the file mapping to hold the fingerprint. Only the pages the parser
+ * actually touches are read from the storage.
+ */
+static dc_status_t
+map_file(const char *dirname, const char *name, struct fit_data *slot)
+{
+#ifdef USE_MMAP
+	char pathname[PATH_MAX];
+	size_t pathlen = strlen(dirname);
+	struct stat st;
+	int fd;
+
+	memcpy(pathname, dirname, pathlen);
+	pathname[pathlen] = '/';
+	memcpy(pathname+pathlen+1, name, FILE_NAME_SIZE);
+	pathname[pathlen+1+FILE_NAME_SIZE] = 0;
+	fd = open(pathname, O_RDONLY | O_BINARY);
+	if (fd < 0)
+		return DC_STATUS_IO;
+
+	if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+		close(fd);
+		return DC_STATUS_UNSUPPORTED;
+	}
+
+	size_t pagesize = sysconf(_SC_PAGESIZE);
+	size_t length = pagesize + st.st_size;
+	unsigned char *base = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (base == MAP_FAILED) {
+		close(fd);
+		return DC_STATUS_UNSUPPORTED;
+	}
+
+	if (mmap(base + pagesize, st.st_size, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED) {
+		munmap(base, length);
+		close(fd);
+		return DC_STATUS_UNSUPPORTED;
+	}
+
+	close(fd);
+
+	memcpy(base + pagesize - FIT_NAME_SIZE, name, FIT_NAME_SIZE);
+
+	slot->base = base;
+	slot->length = length;
+	slot->data = base + pagesize - FIT_NAME_SIZE;
+	slot->size = FIT_NAME_SIZE + st.st_size;
+
+	return DC_STATUS_SUCCESS;
+#else
+	return DC_STATUS_UNSUPPORTED;
+#endif
+}
+
+static dc_status_t
+garmin_read_file(garmin_device_t *device, const char *pathname, const struct fit_file *entry, struct fit_data *slot)
+{
+	dc_buffer_t *file = slot->buffer;
+	dc_status_t rc = DC_STATUS_SUCCESS;
+
+	unmap_file(slot);
+
+#ifdef HAVE_LIBMTP
+	if (!device->use_mtp)
+#endif
+	{
+		// Prefer the memory mapping, and fall back to reading the file.
+		rc = map_file(pathname, entry->name, slot);
+		if (rc != DC_STATUS_UNSUPPORTED)
+			return rc;
+	}
+
+	// Reset the membuffer, read the data
+	dc_buffer_clear(file);
+	if (!dc_buffer_append(file, entry->name, FIT_NAME_SIZE))
+		return DC_STATUS_NOMEMORY;
+#ifdef HAVE_LIBMTP
+	if (device->use_mtp)
+		rc = mtp_read_file(device, entry->mtp_id, file);
+	else
+#endif
+		rc = read_file(pathname, entry->name, file);
+
+	slot->data = dc_buffer_get_data(file);
+	slot->size = dc_buffer_get_size(file);
+
+	return rc;
+}
+
+static void
+garmin_prefetch_worker(void *userdata)
+{
+	garmin_prefetch_t *prefetch = (garmin_prefetch_t *) userdata;
+
+	while (1) {
+		dc_mutex_lock(&prefetch->mutex);
+		unsigned int i = prefetch->next++;
+		dc_mutex_unlock(&prefetch->mutex);
+
+		if (i >= prefetch->count)
+			break;
+
+		if (dc_interrupt_isset(prefetch->device->base.interrupt)) {
+			prefetch->slots[i].status = DC_STATUS_CANCELLED;
+			continue;
+		}
+
+		prefetch->slots[i].status = garmin_read_file(prefetch->device, prefetch->pathname, prefetch->files + i, prefetch->slots + i);
+	}
+}
+
+static void
+garmin_prefetch(garmin_prefetch_t *prefetch, const struct fit_file *files, unsigned int count, unsigned int nthreads)
+{
+	prefetch->files = files;
+	prefetch->count = count;
+	prefetch->next = 0;
+
+	if (nthreads > count)
+		nthreads = count;
+
+	dc_thread_pool_run(nthreads, garmin_prefetch_worker, prefetch);
+}
+
 static dc_status_t
 garmin_device_foreach (dc_device_t *abstract, dc_dive_callback_t callback, void *userdata)
 {
@@ -456,7 +682,6 @@ garmin_device_foreach (dc_device_t *abstract, dc_dive_callback_t callback, void
 		0,     // allocated
 		NULL   // array of file names / ids
 	};
-	dc_buffer_t *file;
 	DIR *dir;
 	dc_status_t rc;
 
@@ -514,36 +739,42 @@ garmin_device_foreach (dc_device_t *abstract, dc_dive_callback_t callback, void
 		}
 	}
 	// We found at least one file
-	// Can we find the fingerprint entry?
-	for (int i = 0; i < files.nr; i++) {
-		const char *name = files.array[i].name;
-
-		if (memcmp(name, device->fingerprint, sizeof (device->fingerprint)))
-			continue;
-
-		// Found fingerprint, just cut the array short here
-		files.nr = i;
-		DEBUG(abstract->context, "Ignoring '%s' and older", name);
-		break;
-	}
+	select_files(abstract, &files, device->fingerprint);
 	// Enable progress notifications.
 	dc_event_progress_t progress = EVENT_PROGRESS_INITIALIZER;
 	progress.maximum = files.nr;
 	progress.current = 0;
 	device_event_emit (abstract, DC_EVENT_PROGRESS, &progress);
 
-	file = dc_buffer_new (16384);
-	if (file == NULL) {
-		ERROR (abstract->context, "Insufficient buffer space available.");
-		free(files.array);
-		return DC_STATUS_NOMEMORY;
+	garmin_prefetch_t prefetch = {
+		device, pathname, NULL,
+		{{NULL}},
+		0, 0, DC_MUTEX_INIT};
+
+	for (unsigned int i = 0; i < PREFETCH; ++i) {
+		prefetch.slots[i].buffer = dc_buffer_new_context (abstract->context, 16384);
+		if (prefetch.slots[i].buffer == NULL) {
+			ERROR (abstract->context, "Insufficient buffer space available.");
+			for (unsigned int j = 0; j < i; ++j)
+				dc_buffer_free(prefetch.slots[j].buffer);
+			free(files.array);
+			return DC_STATUS_NOMEMORY;
+		}
 	}
 
+	// The MTP device handle can't be shared between threads.
+	unsigned int nthreads = NTHREADS;
+#ifdef HAVE_LIBMTP
+	if (device->use_mtp)
+		nthreads = 1;
+#endif
+
 	dc_event_devinfo_t devinfo;
 	dc_event_devinfo_t *devinfo_p = &devinfo;
+	dc_parser_t *parser = NULL;
+	unsigned int batch = 1, first = 0, count = 0;
 	for (int i = 0; i < files.nr; i++) {
 		const char *name = files.array[i].name;
-		dc_parser_t *parser;
 		const unsigned char *data;
 		unsigned int size;
 		short is_dive = 0;
@@ -553,27 +784,40 @@ garmin_device_foreach (dc_device_t *abstract, dc_dive_callback_t callback, void
 			break;
 		}
 
-		// Reset the membuffer, read the data
-		dc_buffer_clear(file);
-		dc_buffer_append(file, name, FIT_NAME_SIZE);
-#ifdef HAVE_LIBMTP
-		if (device->use_mtp)
-			status = mtp_read_file(device, files.array[i].mtp_id, file);
-		else
-#endif
-			status = read_file(pathname, pathlen, name, file);
+		// Read the next batch of files.
+		if ((unsigned int) i >= first + count) {
+			first = i;
+			count = files.nr - i;
+			if (count > batch)
+				count = batch;
+			garmin_prefetch(&prefetch, files.array + i, count, nthreads);
+			if (batch < PREFETCH)
+				batch *= 2;
+		}
+		unsigned int slot = i - first;
 
+		status = prefetch.slots[slot].status;
 		if (status != DC_STATUS_SUCCESS)
 			break;
 
-		data = dc_buffer_get_data(file);
-		size = dc_buffer_get_size(file);
+		data = prefetch.slots[slot].data;
+		size = prefetch.slots[slot].size;
 
-		status = garmin_parser_create(&parser, abstract->context, data, size);
-		if (status != DC_STATUS_SUCCESS) {
-			ERROR (abstract->context, "Failed to create parser for dive verification.");
-			free(files.array);
-			return rc;
+		// A single parser is reused for all files.
+		if (parser == NULL) {
+			status = garmin_parser_create(&parser, abstract->context, data, size);
+			if (status != DC_STATUS_SUCCESS) {
+				ERROR (abstract->context, "Failed to create parser for dive verification.");
+				break;
+			}
+
+			// The dive verification only needs the summary records,
+			// and the parser references the file buffer directly.
+			parser->flags |= DC_PARSER_FLAG_SUMMARY | DC_PARSER_FLAG_BORROWED;
+		} else {
+			status = dc_parser_reset(parser, data, size);
+			if (status != DC_STATUS_SUCCESS)
+				break;
 		}
 
 		is_dive = !device->model || garmin_parser_is_dive(parser, devinfo_p);
@@ -585,7 +829,6 @@ garmin_device_foreach (dc_device_t *abstract, dc_dive_callback_t callback, void
 		}
 		if (!is_dive) {
 			DEBUG(abstract->context, "decided %s isn't a dive.", name);
-			dc_parser_destroy(parser);
 			continue;
 		}
 
@@ -594,10 +837,13 @@ garmin_device_foreach (dc_device_t *abstract, dc_dive_callback_t callback, void
 
 		progress.current++;
 		device_event_emit(abstract, DC_EVENT_PROGRESS, &progress);
-		dc_parser_destroy(parser);
 	}
 
+	dc_parser_destroy(parser);
 	free(files.array);
-	dc_buffer_free(file);
+	for (unsigned int i = 0; i < PREFETCH; ++i) {
+		unmap_file(prefetch.slots + i);
+		dc_buffer_free(prefetch.slots[i].buffer);
+	}
 	return status;
 }
@@ -34,14 +34,41 @@
 
 struct msg_desc;
 
+struct field_desc;
+
+// Decode plan for one field of a local type, compiled
+// once from the definition message.
+struct field_plan {
+	const struct field_desc *desc;
+	unsigned char nr, len, base_type;
+};
+
 // Local types
 struct type_desc {
 	const char *msg_name;
 	const struct msg_desc *msg_desc;
 	unsigned char nrfields, devfields;
-	unsigned char fields[MAXFIELDS][3];
+	unsigned char big_endian;
+	// Number of usable fields in the plan, and what to
+	// return after them if the definition was broken.
+	unsigned char nrvalid, error;
+	// Number of fields with a handler, and the total length
+	// of the regular fields. Without debug output, records
+	// without any handled fields are skipped by length.
+	unsigned char nrhandled, verbose;
+	unsigned int reclen;
+	unsigned int devlen;
+	// The regular fields, followed by the developer fields
+	// with their raw definition bytes. The array only grows,
+	// so redefining a local type doesn't allocate.
+	unsigned int capacity;
+	struct field_plan *plan;
 };
 
+#define PLAN_OK      0
+#define PLAN_DISCARD 1
+#define PLAN_FATAL   2
+
 // Positions are signed 32-bit values, turning
 // into 180 * val // 2**31 degrees.
 struct pos {
@@ -57,7 +84,6 @@ struct garmin_sensor {
 };
 
 #define MAXTYPE 16
-#define MAXGASES 16
 #define MAXSTRINGS 32
 
 // Some record data needs to be bunched up
@@ -92,6 +118,9 @@ struct record_data {
 
 	// RECORD_SETPOINT_CHANGE
 	unsigned int setpoint_actual_cbar;
+
+	// RECORD_POSITION
+	struct pos pos;
 };
 
 #define RECORD_GASMIX		1
@@ -102,6 +131,7 @@ struct record_data {
 #define RECORD_SENSOR_PROFILE	32
 #define RECORD_TANK_UPDATE	64
 #define RECORD_SETPOINT_CHANGE	128
+#define RECORD_POSITION		256
 
 typedef struct garmin_parser_t {
 	dc_parser_t base;
@@ -116,6 +146,7 @@ typedef struct garmin_parser_t {
 
 	// Field cache
 	struct {
+		unsigned int rejected;
 		unsigned int sub_sport;
 		unsigned int serial;
 		unsigned int product;
@@ -149,6 +180,7 @@ typedef struct garmin_parser_t {
 
 	struct dc_field_cache cache;
 	unsigned char is_big_endian; // instead of bool
+	unsigned char cached; // instead of bool
 } garmin_parser_t;
 
 typedef int (*garmin_data_cb_t)(unsigned char type, const unsigned char *data, int len, void *user);
@@ -158,6 +190,14 @@ static inline struct garmin_sensor *current_sensor(garmin_parser_t *garmin)
 	return garmin->dive.sensor + garmin->dive.nr_sensor;
 }
 
+/*
+ * The positions are in semicircles: 2**31 is 180 degrees.
+ */
+static double semicircles(int value)
+{
+	return value * (180.0 / 2147483648.0);
+}
+
 static int find_tank_index(garmin_parser_t *garmin, unsigned int sensor_id)
 {
 	for (int i = 0; i < garmin->dive.nr_sensor; i++) {
@@ -336,13 +376,24 @@ static void flush_pending_record(struct garmin_parser_t *garmin)
 		sample.setpoint = record->setpoint_actual_cbar / 100.0;
 		garmin->callback(DC_SAMPLE_SETPOINT, &sample, garmin->userdata);
 	}
+
+	if (pending & RECORD_POSITION && record->pos.lat && record->pos.lon) {
+		dc_sample_value_t sample = {0};
+
+		sample.position.latitude = semicircles(record->pos.lat);
+		sample.position.longitude = semicircles(record->pos.lon);
+		garmin->callback(DC_SAMPLE_POSITION, &sample, garmin->userdata);
+	}
 }
 
 
-static dc_status_t garmin_parser_set_data (garmin_parser_t *garmin, const unsigned char *data, unsigned int size);
+static dc_status_t garmin_parser_set_data (garmin_parser_t *garmin);
 static dc_status_t garmin_parser_get_datetime (dc_parser_t *abstract, dc_datetime_t *datetime);
 static dc_status_t garmin_parser_get_field (dc_parser_t *abstract, dc_field_type_t type, unsigned int flags, void *value);
+static dc_status_t garmin_parser_get_summary (dc_parser_t *abstract, dc_parser_summary_t *summary);
 static dc_status_t garmin_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_t callback, void *userdata);
+static dc_status_t garmin_parser_reset (dc_parser_t *abstract);
+static dc_status_t garmin_parser_destroy (dc_parser_t *abstract);
 
 static const dc_parser_vtable_t garmin_parser_vtable = {
 	sizeof(garmin_parser_t),
@@ -352,8 +403,14 @@ static const dc_parser_vtable_t garmin_parser_vtable = {
 	NULL, /* set_density */
 	garmin_parser_get_datetime, /* datetime */
 	garmin_parser_get_field, /* fields */
+	garmin_parser_get_summary, /* summary */
 	garmin_parser_samples_foreach, /* samples_foreach */
-	NULL /* destroy */
+	NULL, /* samples_batch */
+	NULL, /* samples_fixed */
+	NULL, /* samples_append */
+	NULL, /* samples_range */
+	garmin_parser_reset, /* reset */
+	garmin_parser_destroy /* destroy */
 };
 
 dc_status_t
@@ -371,13 +428,41 @@ garmin_parser_create (dc_parser_t **out, dc_context_t *context, const unsigned c
 		return DC_STATUS_NOMEMORY;
 	}
 
-	garmin_parser_set_data(parser, data, size);
+	// The data is walked on first use, such that parsers
+	// created in summary mode can skip the sample records.
+	memset(parser->type_desc, 0, sizeof(parser->type_desc));
+	dc_field_init(&parser->cache, context);
+	parser->cached = 0;
 
 	*out = (dc_parser_t *) parser;
 
 	return DC_STATUS_SUCCESS;
 }
 
+static dc_status_t
+garmin_parser_reset (dc_parser_t *abstract)
+{
+	garmin_parser_t *garmin = (garmin_parser_t *) abstract;
+
+	// Everything else is re-initialized when the new data is walked.
+	dc_field_clear(&garmin->cache);
+	garmin->cached = 0;
+
+	return DC_STATUS_SUCCESS;
+}
+
+static dc_status_t
+garmin_parser_destroy (dc_parser_t *abstract)
+{
+	garmin_parser_t *garmin = (garmin_parser_t *) abstract;
+
+	for (unsigned int i = 0; i < MAXTYPE; i++)
+		free(garmin->type_desc[i].plan);
+	dc_field_free(&garmin->cache);
+
+	return DC_STATUS_SUCCESS;
+}
+
 /*
  * We really shouldn't use array_uint_be/le, since they
  * can't deal with 64-bit types.
@@ -459,24 +544,32 @@ static const struct {
  */
 struct field_desc {
 	const char *name;
+	const char *type;
 	void (*parse)(struct garmin_parser_t *, unsigned char base_type, const unsigned char *data);
+	void (*debug)(struct garmin_parser_t *, const unsigned char *data);
 };
 
+// The type of the field is checked once, when compiling the
+// definition, and the value is only formatted for the debug
+// output. The decoder itself just loads and dispatches.
 #define DECLARE_FIELD(msg, name, type) __DECLARE_FIELD(msg##_##name, type)
 #define __DECLARE_FIELD(name, type) \
 	static void parse_##name(struct garmin_parser_t *, const type); \
 	static void parse_##name##_##type(struct garmin_parser_t *g, unsigned char base_type, const unsigned char *p) \
+	{ \
+		type val = type##_VALUE(g, p); \
+		if (val == type##_INVAL) return; \
+		parse_##name(g, val); \
+	} \
+	static void debug_##name##_##type(struct garmin_parser_t *g, const unsigned char *p) \
 	{ \
 		char fmtbuf[FMTSIZE]; \
-		if (strcmp(#type, base_type_info[base_type].type_name)) \
-			fprintf(stderr, "%s: %s should be %s\n", #name, #type, base_type_info[base_type].type_name); \
 		type val = type##_VALUE(g, p); \
 		if (val == type##_INVAL) return; \
 		type##_FORMAT(val, fmtbuf); \
 		DEBUG(g->base.context, "%s (%s): %s", #name, #type, fmtbuf); \
-		parse_##name(g, val); \
 	} \
-	static const struct field_desc name##_field_##type = { #name, parse_##name##_##type }; \
+	static const struct field_desc name##_field_##type = { #name, #type, parse_##name##_##type, debug_##name##_##type }; \
 	static void parse_##name(struct garmin_parser_t *garmin, type data)
 
 // All msg formats can have a timestamp
@@ -539,8 +632,18 @@ DECLARE_FIELD(LAP, other_pos_lat, SINT32)	{ garmin->gps.LAP.other.lat = data; }
 DECLARE_FIELD(LAP, other_pos_long, SINT32)	{ garmin->gps.LAP.other.lon = data; }
 
 // RECORD msg
-DECLARE_FIELD(RECORD, position_lat, SINT32)	{ garmin->gps.RECORD.lat = data; }
-DECLARE_FIELD(RECORD, position_long, SINT32)	{ garmin->gps.RECORD.lon = data; }
+DECLARE_FIELD(RECORD, position_lat, SINT32)
+{
+	garmin->gps.RECORD.lat = data;
+	garmin->record_data.pos.lat = data;
+	garmin->record_data.pending |= RECORD_POSITION;
+}
+DECLARE_FIELD(RECORD, position_long, SINT32)
+{
+	garmin->gps.RECORD.lon = data;
+	garmin->record_data.pos.lon = data;
+	garmin->record_data.pending |= RECORD_POSITION;
+}
 DECLARE_FIELD(RECORD, altitude, UINT16) { }		// 5 *m + 500 ?
 DECLARE_FIELD(RECORD, heart_rate, UINT8)		// bpm
 {
@@ -654,6 +757,11 @@ DECLARE_FIELD(ACTIVITY, local_timestamp, UINT32)
 DECLARE_FIELD(ACTIVITY, event_group, UINT8) { }
 
 // SPORT
+DECLARE_FIELD(SPORT, sport, ENUM) {
+	// All dive activities use the diving sport (53).
+	if (data != 53)
+		garmin->dive.rejected = 1;
+}
 DECLARE_FIELD(SPORT, sub_sport, ENUM) {
 	garmin->dive.sub_sport = (ENUM) data;
 	dc_divemode_t val;
@@ -880,7 +988,10 @@ DECLARE_FIELD(FIELD_DESCRIPTION, unit, STRING) { }		// "feet"
 DECLARE_FIELD(FIELD_DESCRIPTION, original_mesg, UINT16) { }
 DECLARE_FIELD(FIELD_DESCRIPTION, original_field, UINT8) { }
 
+// Messages marked as ignored have only handlers without any
+// effect, and their fields are decoded for the debug output only.
 struct msg_desc {
+	unsigned char ignored;
 	unsigned char maxfield;
 	const struct field_desc *field[];
 };
@@ -892,6 +1003,7 @@ struct msg_desc {
 	static const struct msg_desc name##_msg_desc
 
 DECLARE_MESG(FILE) = {
+	.ignored = 1,
 	.maxfield = 9,
 	.field = {
 		SET_FIELD(FILE, 0, file_type, ENUM),
@@ -919,6 +1031,7 @@ DECLARE_MESG(ZONES_TARGET) = { };
 DECLARE_MESG(SPORT) = {
 	.maxfield = 2,
 	.field = {
+		SET_FIELD(SPORT, 0, sport, ENUM),
 		SET_FIELD(SPORT, 1, sub_sport, ENUM),	// 53 - 57 and 63 are dive activities
 	}
 };
@@ -1108,6 +1221,7 @@ DECLARE_MESG(TANK_UPDATE) = {
 };
 
 DECLARE_MESG(TANK_SUMMARY) = {
+	.ignored = 1,
 	.maxfield = 4,
 	.field = {
 		SET_FIELD(TANK_SUMMARY, 0, sensor, UINT32Z),		// sensor ID
@@ -1118,6 +1232,7 @@ DECLARE_MESG(TANK_SUMMARY) = {
 };
 
 DECLARE_MESG(FIELD_DESCRIPTION) = {
+	.ignored = 1,
 	.maxfield = 16,
 	.field = {
 		SET_FIELD(FIELD_DESCRIPTION, 0, data_index, UINT8),
@@ -1285,38 +1400,124 @@ static int traverse_regular(struct garmin_parser_t *garmin,
 	struct type_desc *desc = garmin->type_desc + type;
 	const struct msg_desc *msg_desc = desc->msg_desc;
 	const char *msg_name = desc->msg_name;
+	int skip;
 
 	if (!msg_desc) {
 		ERROR(garmin->base.context, "Uninitialized type descriptor %d\n", type);
 		return -1;
 	}
 
-	for (int i = 0; i < desc->nrfields; i++) {
-		const unsigned char *field = desc->fields[i];
-		unsigned int field_nr = field[0];
-		unsigned int len = field[1];
-		unsigned int base_type = field[2] & 0x7f;
-		const struct field_desc *field_desc;
-		unsigned int base_size;
+	// In summary mode, the sample records are only decoded
+	// when there is someone to deliver the samples to.
+	skip = msg_desc == &RECORD_msg_desc && !garmin->callback &&
+		(garmin->base.flags & DC_PARSER_FLAG_SUMMARY);
 
-		if (!len) {
-			ERROR(garmin->base.context, "field with zero length\n");
-			return total_len + size;
-		}
+	// Nothing to decode, unless it's needed for the debug output.
+	if (!desc->verbose && !desc->nrhandled && desc->error == PLAN_OK &&
+		size >= desc->reclen + desc->devlen)
+		return desc->reclen + desc->devlen;
+
+	garmin->is_big_endian = desc->big_endian;
+
+	for (int i = 0; i < desc->nrvalid; i++) {
+		const struct field_plan *plan = desc->plan + i;
+		unsigned int len = plan->len;
 
 		if (size < len) {
 			ERROR(garmin->base.context, "Data traversal size bigger than remaining data (%d vs %d)\n", len, size);
 			return total_len + size;
 		}
 
+		if (!skip) {
+			if (plan->desc) {
+				if (desc->verbose)
+					plan->desc->debug(garmin, data);
+				plan->desc->parse(garmin, plan->base_type, data);
+			} else if (desc->verbose) {
+				unknown_field(garmin, data, msg_name, plan->nr, plan->base_type, len);
+			}
+		}
+
+		data += len;
+		total_len += len;
+		size -= len;
+	}
+
+	if (desc->error == PLAN_DISCARD)
+		return total_len + size;
+	if (desc->error == PLAN_FATAL)
+		return -1;
+
+	if (size < desc->devlen) {
+		ERROR(garmin->base.context, "  developer field bigger than remaining data (%d vs %d)\n", desc->devlen, size);
+		return -1;
+	}
+
+	for (int i = 0; desc->verbose && i < desc->devfields; i++) {
+		const struct field_plan *field = desc->plan + desc->nrfields + i;
+		unsigned int len = field->len;
+
+		DEBUG(garmin->base.context, "Developer field %d %02x type %02x", i, field->nr, field->base_type);
+
+		if (!skip)
+			HEXDUMP(garmin->base.context, DC_LOGLEVEL_DEBUG, "data", data, len);
+		data += len;
+	}
+
+	return total_len + desc->devlen;
+}
+
+/*
+ * Get the size of a named base type, or zero for an unknown type.
+ */
+static unsigned int field_type_size(const char *type)
+{
+	for (unsigned int i = 0; i < C_ARRAY_SIZE(base_type_info); i++) {
+		if (!strcmp(type, base_type_info[i].type_name))
+			return base_type_info[i].type_size;
+	}
+	return 0;
+}
+
+/*
+ * Compile the field definitions of a local type into a decode
+ * plan, so the regular records don't have to validate every field
+ * and look up its handler over and over again.
+ */
+static void compile_definition(struct garmin_parser_t *garmin, struct type_desc *desc)
+{
+	const struct msg_desc *msg_desc = desc->msg_desc;
+	int i;
+
+	desc->error = PLAN_OK;
+	desc->verbose = LOGLEVEL_ENABLED(garmin->base.context, DC_LOGLEVEL_DEBUG);
+	desc->nrhandled = 0;
+	desc->reclen = 0;
+
+	for (i = 0; i < desc->nrfields; i++) {
+		struct field_plan *plan = desc->plan + i;
+		unsigned int field_nr = plan->nr;
+		unsigned int len = plan->len;
+		unsigned int base_type = plan->base_type & 0x7f;
+		const struct field_desc *field_desc;
+		unsigned int base_size;
+
+		if (!len) {
+			ERROR(garmin->base.context, "field with zero length\n");
+			desc->error = PLAN_DISCARD;
+			break;
+		}
+
 		if (base_type > 16) {
 			ERROR(garmin->base.context, "Unknown base type %d\n", base_type);
-			return total_len + size;
+			desc->error = PLAN_DISCARD;
+			break;
 		}
 		base_size = base_type_info[base_type].type_size;
 		if (len % base_size) {
 			ERROR(garmin->base.context, "Data traversal size not a multiple of base size (%d vs %d)\n", len, base_size);
-			return -1;
+			desc->error = PLAN_FATAL;
+			break;
 		}
 
 		// Certain field numbers have fixed meaning across all messages
@@ -1332,47 +1533,72 @@ static int traverse_regular(struct garmin_parser_t *garmin,
 			break;
 		default:
 			field_desc = NULL;
-			if (field_nr < msg_desc->maxfield)
+			if (msg_desc && field_nr < msg_desc->maxfield &&
+				(desc->verbose || !msg_desc->ignored))
 				field_desc = msg_desc->field[field_nr];
 		}
 
-		if (field_desc) {
-			field_desc->parse(garmin, base_type, data);
-		} else {
-			unknown_field(garmin, data, msg_name, field_nr, base_type, len);
+		if (field_desc && strcmp(field_desc->type, base_type_info[base_type].type_name)) {
+			WARNING(garmin->base.context, "%s: %s should be %s", field_desc->name, field_desc->type, base_type_info[base_type].type_name);
+
+			// The decoder loads a value of the expected type, which
+			// must not extend past the end of the field.
+			if (len < field_type_size(field_desc->type))
+				field_desc = NULL;
 		}
 
-		data += len;
-		total_len += len;
-		size -= len;
+		plan->desc = field_desc;
+		plan->base_type = base_type;
+		if (field_desc)
+			desc->nrhandled++;
+		desc->reclen += len;
 	}
 
-	for (int i = 0; i < desc->devfields; i++) {
-		int desc_idx = i + desc->nrfields;
-		const unsigned char *field = desc->fields[desc_idx];
-		unsigned int field_nr = field[0];
-		unsigned int len = field[1];
-		unsigned int type = field[2];
-
-		DEBUG(garmin->base.context, "Developer field %d %02x type %02x", i, field_nr, type);
+	desc->nrvalid = i;
+	if (desc->error != PLAN_OK)
+		return;
 
-		if (!len) {
+	for (i = 0; i < desc->devfields; i++) {
+		if (!desc->plan[desc->nrfields + i].len) {
 			ERROR(garmin->base.context, "  developer field with zero length\n");
-			return -1;
+			desc->error = PLAN_FATAL;
+			return;
 		}
+	}
+}
 
-		if (size < len) {
-			ERROR(garmin->base.context, "  developer field bigger than remaining data (%d vs %d)\n", len, size);
-			return -1;
-		}
+/*
+ * Make room for the fields of a definition.
+ */
+static int reserve_fields(struct garmin_parser_t *garmin, struct type_desc *desc, unsigned int count)
+{
+	struct field_plan *plan;
+	unsigned int capacity;
 
-		HEXDUMP(garmin->base.context, DC_LOGLEVEL_DEBUG, "data", data, len);
-		data += len;
-		total_len += len;
-		size -= len;
+	if (count <= desc->capacity)
+		return 0;
+
+	capacity = desc->capacity ? desc->capacity : 16;
+	while (capacity < count)
+		capacity *= 2;
+
+	plan = (struct field_plan *) realloc(desc->plan, capacity * sizeof(*plan));
+	if (!plan) {
+		ERROR(garmin->base.context, "Failed to allocate memory.");
+		return -1;
 	}
 
-	return total_len;
+	desc->plan = plan;
+	desc->capacity = capacity;
+	return 0;
+}
+
+static void copy_field(struct field_plan *plan, const unsigned char *field)
+{
+	plan->desc = NULL;
+	plan->nr = field[0];
+	plan->len = field[1];
+	plan->base_type = field[2];
 }
 
 /*
@@ -1406,7 +1632,7 @@ static int traverse_definition(struct garmin_parser_t *garmin,
 	int fields, devfields, len;
 
 	// data[1] tells us if this is big or little endian
-	garmin->is_big_endian = data[1] != 0;
+	garmin->is_big_endian = desc->big_endian = data[1] != 0;
 	msg = garmin_value(garmin, data + 2, 2);
 	desc->msg_desc = lookup_msg_desc(msg, type, &desc->msg_name);
 	fields = data[4];
@@ -1416,21 +1642,33 @@ static int traverse_definition(struct garmin_parser_t *garmin,
 		ERROR(garmin->base.context, "Too many fields in description: %d (max %d)\n", fields, MAXFIELDS);
 		return -1;
 	}
-	desc->nrfields = fields;
 	len = 5 + fields*3;
 	devfields = 0;
 
+	/* Developer fields after the regular ones */
+	if (record & 0x20) {
+		devfields = data[len];
+		if (fields + devfields > MAXFIELDS) {
+			ERROR(garmin->base.context, "Too many dev fields in description: %d+%d (max %d)\n", fields, devfields, MAXFIELDS);
+			return -1;
+		}
+	}
+
+	if (reserve_fields(garmin, desc, fields + devfields) < 0)
+		return -1;
+
+	desc->nrfields = fields;
+	desc->devlen = 0;
+
 	for (int i = 0; i < fields; i++) {
-		unsigned char *field = desc->fields[i];
-		memcpy(field, data + (5+i*3), 3);
+		const unsigned char *field = data + (5+i*3);
+		copy_field(desc->plan + i, field);
 		DEBUG(garmin->base.context, "  %d: %02x %02x %02x", i, field[0], field[1], field[2]);
 	}
 
 	data += len;
 
-	/* Developer fields after the regular ones */
 	if (record & 0x20) {
-		devfields = data[0];
 		DEBUG(garmin->base.context, "Developer field (rec=%02x len=%d, devfields=%d)",
 			record, len, devfields);
 
@@ -1441,18 +1679,15 @@ static int traverse_definition(struct garmin_parser_t *garmin,
 		len += 1 + 3*devfields;
 
 		for (int i = 0; i < devfields; i++) {
-			int idx = fields + i;
-			unsigned char *field = desc->fields[idx];
-			if (idx > MAXFIELDS) {
-				ERROR(garmin->base.context, "Too many dev fields in description: %d+%d (max %d)\n", fields, i, MAXFIELDS);
-				return -1;
-			}
-			memcpy(field, data + (1+i*3), 3);
+			const unsigned char *field = data + (1+i*3);
+			copy_field(desc->plan + fields + i, field);
 			DEBUG(garmin->base.context, "  %d: %02x %02x %02x", i, field[0], field[1], field[2]);
+			desc->devlen += field[1];
 		}
 	}
 
 	desc->devfields = devfields;
+	compile_definition(garmin, desc);
 
 	return len;
 }
@@ -1466,9 +1701,18 @@ traverse_data(struct garmin_parser_t *garmin)
 	unsigned int hdrsize, protocol, profile, datasize;
 	unsigned int time;
 
-	// Reset the time and type descriptors before walking
+	// Reset the time and type descriptors before walking,
+	// keeping the field arrays around for reuse.
 	memset(&garmin->record_data, 0, sizeof(garmin->record_data));
-	memset(garmin->type_desc, 0, sizeof(garmin->type_desc));
+	for (unsigned int i = 0; i < MAXTYPE; i++) {
+		struct type_desc *desc = garmin->type_desc + i;
+		struct field_plan *plan = desc->plan;
+		unsigned int capacity = desc->capacity;
+
+		memset(desc, 0, sizeof(*desc));
+		desc->plan = plan;
+		desc->capacity = capacity;
+	}
 
 	// The data starts with our filename fingerprint. Skip it.
 	if (len < FIT_NAME_SIZE)
@@ -1537,6 +1781,13 @@ traverse_data(struct garmin_parser_t *garmin)
 		// Flush pending data on record boundaries
 		if (garmin->record_data.pending)
 			flush_pending_record(garmin);
+
+		// In summary mode, stop as soon as the file is known not to be
+		// a dive. The sport message is normally near the start of the
+		// file, so the remainder of the file is never touched.
+		if (garmin->dive.rejected && !garmin->callback &&
+			(garmin->base.flags & DC_PARSER_FLAG_SUMMARY))
+			break;
 	}
 
 	return DC_STATUS_SUCCESS;
@@ -1584,11 +1835,16 @@ garmin_parser_is_dive (dc_parser_t *abstract, dc_event_devinfo_t *devinfo_p)
 {
 	garmin_parser_t *garmin = (garmin_parser_t *) abstract;
 
+	if (!garmin->cached)
+		garmin_parser_set_data(garmin);
+
 	if (devinfo_p) {
 		devinfo_p->firmware = garmin->dive.firmware;
 		devinfo_p->serial = garmin->dive.serial;
 		devinfo_p->model = garmin->dive.product;
 	}
+	if (garmin->dive.rejected)
+		return 0;
 	switch (garmin->dive.sub_sport) {
 	case 53:	// Single-gas
 	case 54:	// Multi-gas
@@ -1613,17 +1869,41 @@ static void add_sensor_string(garmin_parser_t *garmin, const char *desc, const s
 }
 
 static dc_status_t
-garmin_parser_set_data (garmin_parser_t *garmin, const unsigned char *data, unsigned int size)
+garmin_parser_set_data (garmin_parser_t *garmin)
 {
 	/* Walk the data once without a callback to set up the core fields */
 	garmin->callback = NULL;
 	garmin->userdata = NULL;
 	memset(&garmin->gps, 0, sizeof(garmin->gps));
 	memset(&garmin->dive, 0, sizeof(garmin->dive));
-	memset(&garmin->cache, 0, sizeof(garmin->cache));
+	dc_field_clear(&garmin->cache);
 
 	traverse_data(garmin);
 
+	// Hate hate hate gasmix vs tank counts.
+	//
+	// There's no way to match them up unless they are an identity
+	// mapping, so having two different ones doesn't actually work.
+	if (garmin->dive.nr_sensor > garmin->cache.GASMIX_COUNT)
+		DC_ASSIGN_FIELD(garmin->cache, GASMIX_COUNT, garmin->dive.nr_sensor);
+
+	garmin->cached = 1;
+
+	return DC_STATUS_SUCCESS;
+}
+
+/*
+ * The informational strings are only formatted when
+ * somebody actually asks for them.
+ */
+static dc_status_t
+garmin_parser_resolve_strings (dc_parser_t *abstract, dc_field_type_t type)
+{
+	garmin_parser_t *garmin = (garmin_parser_t *) abstract;
+
+	if (!garmin->cached)
+		garmin_parser_set_data(garmin);
+
 	// Device information
 	if (garmin->dive.serial)
 		dc_field_add_string_fmt(&garmin->cache, "Serial", "%u", garmin->dive.serial);
@@ -1652,13 +1932,6 @@ garmin_parser_set_data (garmin_parser_t *garmin, const unsigned char *data, unsi
 		// DC_ASSIGN_IDX(garmin->cache, tankworkingpressure, i, ..);
 	}
 
-	// Hate hate hate gasmix vs tank counts.
-	//
-	// There's no way to match them up unless they are an identity
-	// mapping, so having two different ones doesn't actually work.
-	if (garmin->dive.nr_sensor > garmin->cache.GASMIX_COUNT)
-		DC_ASSIGN_FIELD(garmin->cache, GASMIX_COUNT, garmin->dive.nr_sensor);
-
 	for (int i = 0; i < garmin->dive.nr_sensor; i++) {
 		static const char *name[] = { "Sensor 1", "Sensor 2", "Sensor 3", "Sensor 4", "Sensor 5" };
 		add_sensor_string(garmin, name[i], garmin->dive.sensor+i);
@@ -1685,14 +1958,23 @@ garmin_parser_set_data (garmin_parser_t *garmin, const unsigned char *data, unsi
 	return DC_STATUS_SUCCESS;
 }
 
+static const dc_field_resolver_t garmin_parser_resolvers[] = {
+	[DC_FIELD_STRING] = garmin_parser_resolve_strings,
+};
+
 
 static dc_status_t
 garmin_parser_get_datetime (dc_parser_t *abstract, dc_datetime_t *datetime)
 {
 	garmin_parser_t *garmin = (garmin_parser_t *) abstract;
-	dc_ticks_t time = 631065600 + (dc_ticks_t) garmin->dive.time;
+	dc_ticks_t time;
 	int timezone = DC_TIMEZONE_NONE;
 
+	if (!garmin->cached)
+		garmin_parser_set_data(garmin);
+
+	time = 631065600 + (dc_ticks_t) garmin->dive.time;
+
 	// Show local time (time_offset)
 	dc_datetime_gmtime(datetime, time + garmin->dive.time_offset);
 
@@ -1723,19 +2005,85 @@ static dc_status_t get_string_field(dc_field_string_t *strings, unsigned idx, dc
 	return DC_STATUS_UNSUPPORTED;
 }
 
+static dc_status_t
+garmin_parser_get_location (garmin_parser_t *garmin, unsigned int flags, dc_location_t *location)
+{
+	const struct pos *pos = NULL;
+
+	if (flags == DC_LOCATION_ENTRY)
+		pos = &garmin->gps.SESSION.entry;
+	else if (flags == DC_LOCATION_EXIT)
+		pos = &garmin->gps.SESSION.exit;
+
+	if (!location)
+		return DC_STATUS_INVALIDARGS;
+
+	if (!pos || !pos->lat || !pos->lon)
+		return DC_STATUS_UNSUPPORTED;
+
+	location->latitude = semicircles(pos->lat);
+	location->longitude = semicircles(pos->lon);
+
+	return DC_STATUS_SUCCESS;
+}
+
 static dc_status_t
 garmin_parser_get_field (dc_parser_t *abstract, dc_field_type_t type, unsigned int flags, void *value)
 {
 	garmin_parser_t *garmin = (garmin_parser_t *) abstract;
 
+	dc_status_t rc;
+
+	if (!garmin->cached)
+		garmin_parser_set_data(garmin);
+
+	if (type == DC_FIELD_LOCATION)
+		return garmin_parser_get_location(garmin, flags, (dc_location_t *) value);
+
+	rc = dc_field_resolve(&garmin->cache, abstract, garmin_parser_resolvers, C_ARRAY_SIZE(garmin_parser_resolvers), type);
+	if (rc != DC_STATUS_SUCCESS)
+		return rc;
+
 	return dc_field_get(&garmin->cache, type, flags, value);
 }
 
+/*
+ * All the fields are in the cache once the strings are resolved,
+ * except for the locations.
+ */
+static dc_status_t
+garmin_parser_get_summary (dc_parser_t *abstract, dc_parser_summary_t *summary)
+{
+	garmin_parser_t *garmin = (garmin_parser_t *) abstract;
+
+	dc_status_t rc;
+
+	if (!garmin->cached)
+		garmin_parser_set_data(garmin);
+
+	rc = dc_field_resolve(&garmin->cache, abstract, garmin_parser_resolvers, C_ARRAY_SIZE(garmin_parser_resolvers), DC_FIELD_STRING);
+	if (rc != DC_STATUS_SUCCESS)
+		return rc;
+
+	dc_field_summary(&garmin->cache, summary);
+
+	while (summary->location_count < DC_SUMMARY_LOCATIONS &&
+		garmin_parser_get_location(garmin, summary->location_count, summary->location + summary->location_count) == DC_STATUS_SUCCESS)
+		summary->location_count++;
+	if (summary->location_count)
+		summary->fields |= DC_FIELD_MASK(DC_FIELD_LOCATION);
+
+	return DC_STATUS_SUCCESS;
+}
+
 static dc_status_t
 garmin_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_t callback, void *userdata)
 {
 	garmin_parser_t *garmin = (garmin_parser_t *) abstract;
 
+	if (!garmin->cached)
+		garmin_parser_set_data(garmin);
+
 	garmin->callback = callback;
 	garmin->userdata = userdata;
 	return traverse_data(garmin);
@@ -20,6 +20,7 @@
  */
 
 #include <stdlib.h> // malloc, free
+#include <string.h> // memcpy, memchr
 
 #include "hdlc.h"
 
@@ -31,6 +32,9 @@
 #define ESC     0x7D
 #define ESC_BIT 0x20
 
+// Maximum number of packets per vectored write.
+#define MAXBATCH 16
+
 static dc_status_t dc_hdlc_set_timeout (dc_iostream_t *abstract, int timeout);
 static dc_status_t dc_hdlc_set_break (dc_iostream_t *abstract, unsigned int value);
 static dc_status_t dc_hdlc_set_dtr (dc_iostream_t *abstract, unsigned int value);
@@ -44,6 +48,7 @@ static dc_status_t dc_hdlc_ioctl (dc_iostream_t *abstract, unsigned int request,
 static dc_status_t dc_hdlc_flush (dc_iostream_t *abstract);
 static dc_status_t dc_hdlc_purge (dc_iostream_t *abstract, dc_direction_t direction);
 static dc_status_t dc_hdlc_sleep (dc_iostream_t *abstract, unsigned int milliseconds);
+static dc_status_t dc_hdlc_set_interrupt (dc_iostream_t *abstract, dc_interrupt_t *interrupt);
 static dc_status_t dc_hdlc_close (dc_iostream_t *abstract);
 
 typedef struct dc_hdlc_t {
@@ -59,6 +64,7 @@ typedef struct dc_hdlc_t {
 	size_t rbuf_available;
 	size_t wbuf_size;
 	size_t wbuf_offset;
+	size_t osize;
 } dc_hdlc_t;
 
 static const dc_iostream_vtable_t dc_hdlc_vtable = {
@@ -73,13 +79,81 @@ static const dc_iostream_vtable_t dc_hdlc_vtable = {
 	dc_hdlc_poll, /* poll */
 	dc_hdlc_read, /* read */
 	dc_hdlc_write, /* write */
+	NULL, /* read_async */
+	NULL, /* write_async */
+	NULL, /* writev */
 	dc_hdlc_ioctl, /* ioctl */
 	dc_hdlc_flush, /* flush */
 	dc_hdlc_purge, /* purge */
 	dc_hdlc_sleep, /* sleep */
+	dc_hdlc_set_interrupt, /* set_interrupt */
 	dc_hdlc_close, /* close */
 };
 
+/*
+ * Get the length of the initial run of bytes that are neither END nor
+ * ESC. Both special characters only differ in the two lowest bits, so
+ * the data can be scanned a word at a time for candidates, which are
+ * then checked byte by byte.
+ */
+static size_t
+dc_hdlc_span (const unsigned char data[], size_t size)
+{
+	const size_t ones = (size_t) -1 / 0xFF;
+	size_t i = 0;
+
+	while (i < size) {
+		size_t n = size - i;
+		if (n >= sizeof (size_t)) {
+			size_t word = 0;
+			memcpy (&word, data + i, sizeof (word));
+			word = (word | (ones * 0x03)) ^ (ones * 0x7F);
+			if (((word - ones) & ~word & (ones * 0x80)) == 0) {
+				i += sizeof (size_t);
+				continue;
+			}
+			n = sizeof (size_t);
+		}
+
+		for (size_t j = 0; j < n; ++j, ++i) {
+			if (data[i] == END || data[i] == ESC)
+				return i;
+		}
+	}
+
+	return size;
+}
+
+/*
+ * Send the contents of the write buffer, split into packets of the
+ * output packet size.
+ */
+static dc_status_t
+dc_hdlc_send (dc_hdlc_t *hdlc)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	dc_iovec_t iov[MAXBATCH];
+	size_t count = 0;
+
+	for (size_t offset = 0; offset < hdlc->wbuf_offset; offset += hdlc->osize) {
+		size_t n = hdlc->wbuf_offset - offset;
+		if (n > hdlc->osize)
+			n = hdlc->osize;
+
+		iov[count].data = hdlc->wbuf + offset;
+		iov[count].size = n;
+		count++;
+	}
+
+	status = dc_iostream_writev (hdlc->iostream, iov, count, NULL);
+	if (status != DC_STATUS_SUCCESS)
+		return status;
+
+	hdlc->wbuf_offset = 0;
+
+	return DC_STATUS_SUCCESS;
+}
+
 dc_status_t
 dc_hdlc_open (dc_iostream_t **out, dc_context_t *context, dc_iostream_t *base, size_t isize, size_t osize)
 {
@@ -94,6 +168,15 @@ dc_hdlc_open (dc_iostream_t **out, dc_context_t *context, dc_iostream_t *base, s
 
 	dc_transport_t transport = dc_iostream_get_transport (base);
 
+	// Use larger packets if the BLE transport negotiated a larger MTU.
+	size_t payload = dc_iostream_ble_payload (base);
+	if (payload) {
+		if (isize < payload)
+			isize = payload;
+		if (osize < payload)
+			osize = payload;
+	}
+
 	// Allocate memory.
 	hdlc = (dc_hdlc_t *) dc_iostream_allocate (NULL, &dc_hdlc_vtable, transport);
 	if (hdlc == NULL) {
@@ -110,8 +193,8 @@ dc_hdlc_open (dc_iostream_t **out, dc_context_t *context, dc_iostream_t *base, s
 		goto error_free;
 	}
 
-	// Allocate the write buffer.
-	hdlc->wbuf = malloc (osize);
+	// Allocate the write buffer, large enough for a batch of packets.
+	hdlc->wbuf = malloc (osize * MAXBATCH);
 	if (hdlc->wbuf == NULL) {
 		ERROR (context, "Failed to allocate memory.");
 		status = DC_STATUS_NOMEMORY;
@@ -123,8 +206,9 @@ dc_hdlc_open (dc_iostream_t **out, dc_context_t *context, dc_iostream_t *base, s
 	hdlc->rbuf_size = isize;
 	hdlc->rbuf_offset = 0;
 	hdlc->rbuf_available = 0;
-	hdlc->wbuf_size = osize;
+	hdlc->wbuf_size = osize * MAXBATCH;
 	hdlc->wbuf_offset = 0;
+	hdlc->osize = osize;
 
 	*out = (dc_iostream_t *) hdlc;
 
@@ -222,6 +306,29 @@ dc_hdlc_read (dc_iostream_t *abstract, void *data, size_t size, size_t *actual)
 		}
 
 		while (hdlc->rbuf_available) {
+			const unsigned char *p = hdlc->rbuf + hdlc->rbuf_offset;
+
+			if (!initialized) {
+				// Skip everything before the start of the frame.
+				const unsigned char *end = memchr (p, END, hdlc->rbuf_available);
+				size_t n = end ? (size_t) (end - p) : hdlc->rbuf_available;
+				hdlc->rbuf_offset += n;
+				hdlc->rbuf_available -= n;
+				if (end == NULL)
+					continue;
+			} else if (!escaped) {
+				// Copy the run of regular characters at once.
+				size_t n = dc_hdlc_span (p, hdlc->rbuf_available);
+				if (n) {
+					if (nbytes < size)
+						memcpy ((unsigned char *) data + nbytes, p, nbytes + n > size ? size - nbytes : n);
+					nbytes += n;
+					hdlc->rbuf_offset += n;
+					hdlc->rbuf_available -= n;
+					continue;
+				}
+			}
+
 			unsigned char c = hdlc->rbuf[hdlc->rbuf_offset];
 			hdlc->rbuf_offset++;
 			hdlc->rbuf_available--;
@@ -294,15 +401,37 @@ dc_hdlc_write (dc_iostream_t *abstract, const void *data, size_t size, size_t *a
 
 	// Flush the buffer if necessary.
 	if (hdlc->wbuf_offset >= hdlc->wbuf_size) {
-		status = dc_iostream_write (hdlc->iostream, hdlc->wbuf, hdlc->wbuf_offset, NULL);
+		status = dc_hdlc_send (hdlc);
 		if (status != DC_STATUS_SUCCESS) {
 			goto out;
 		}
-
-		hdlc->wbuf_offset = 0;
 	}
 
 	while (nbytes < size) {
+		// Copy the run of regular characters at once.
+		size_t n = dc_hdlc_span ((const unsigned char *) data + nbytes, size - nbytes);
+		while (n) {
+			size_t len = hdlc->wbuf_size - hdlc->wbuf_offset;
+			if (len > n)
+				len = n;
+
+			memcpy (hdlc->wbuf + hdlc->wbuf_offset, (const unsigned char *) data + nbytes, len);
+			hdlc->wbuf_offset += len;
+			nbytes += len;
+			n -= len;
+
+			// Flush the buffer if necessary.
+			if (hdlc->wbuf_offset >= hdlc->wbuf_size) {
+				status = dc_hdlc_send (hdlc);
+				if (status != DC_STATUS_SUCCESS) {
+					goto out;
+				}
+			}
+		}
+
+		if (nbytes >= size)
+			break;
+
 		unsigned char c = ((const unsigned char *) data)[nbytes];
 
 		if (c == END || c == ESC) {
@@ -311,12 +440,10 @@ dc_hdlc_write (dc_iostream_t *abstract, const void *data, size_t size, size_t *a
 
 			// Flush the buffer if necessary.
 			if (hdlc->wbuf_offset >= hdlc->wbuf_size) {
-				status = dc_iostream_write (hdlc->iostream, hdlc->wbuf, hdlc->wbuf_offset, NULL);
+				status = dc_hdlc_send (hdlc);
 				if (status != DC_STATUS_SUCCESS) {
 					goto out;
 				}
-
-				hdlc->wbuf_offset = 0;
 			}
 
 			// Escape the character.
@@ -328,12 +455,10 @@ dc_hdlc_write (dc_iostream_t *abstract, const void *data, size_t size, size_t *a
 
 		// Flush the buffer if necessary.
 		if (hdlc->wbuf_offset >= hdlc->wbuf_size) {
-			status = dc_iostream_write (hdlc->iostream, hdlc->wbuf, hdlc->wbuf_offset, NULL);
+			status = dc_hdlc_send (hdlc);
 			if (status != DC_STATUS_SUCCESS) {
 				goto out;
 			}
-
-			hdlc->wbuf_offset = 0;
 		}
 
 		nbytes++;
@@ -343,13 +468,11 @@ dc_hdlc_write (dc_iostream_t *abstract, const void *data, size_t size, size_t *a
 	hdlc->wbuf[hdlc->wbuf_offset++] = END;
 
 	// Flush the buffer.
-	status = dc_iostream_write (hdlc->iostream, hdlc->wbuf, hdlc->wbuf_offset, NULL);
+	status = dc_hdlc_send (hdlc);
 	if (status != DC_STATUS_SUCCESS) {
 		goto out;
 	}
 
-	hdlc->wbuf_offset = 0;
-
 out:
 	if (actual)
 		*actual = nbytes;
@@ -394,6 +517,14 @@ dc_hdlc_sleep (dc_iostream_t *abstract, unsigned int milliseconds)
 	return dc_iostream_sleep (hdlc->iostream, milliseconds);
 }
 
+static dc_status_t
+dc_hdlc_set_interrupt (dc_iostream_t *abstract, dc_interrupt_t *interrupt)
+{
+	dc_hdlc_t *hdlc = (dc_hdlc_t *) abstract;
+
+	return dc_iostream_set_interrupt (hdlc->iostream, interrupt);
+}
+
 static dc_status_t
 dc_hdlc_close (dc_iostream_t *abstract)
 {
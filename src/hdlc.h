@@ -33,6 +33,9 @@ extern "C" {
 /**
  * Create a HDLC I/O stream layered on top of another base I/O stream.
  *
+ * On a BLE transport, the packet sizes are increased to the maximum
+ * payload of the negotiated MTU, if that is larger.
+ *
  * @param[out]  iostream    A location to store the HDLC I/O stream.
  * @param[in]   context     A valid context.
  * @param[in]   base        A valid I/O stream.
@@ -68,9 +68,11 @@ static const dc_device_vtable_t hw_frog_device_vtable = {
 	DC_FAMILY_HW_FROG,
 	hw_frog_device_set_fingerprint, /* set_fingerprint */
 	NULL, /* read */
+	NULL, /* read_range */
 	NULL, /* write */
 	NULL, /* dump */
 	hw_frog_device_foreach, /* foreach */
+	NULL, /* foreach_header */
 	hw_frog_device_timesync, /* timesync */
 	hw_frog_device_close /* close */
 };
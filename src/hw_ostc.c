@@ -74,16 +74,15 @@ static const dc_device_vtable_t hw_ostc_device_vtable = {
 	DC_FAMILY_HW_OSTC,
 	hw_ostc_device_set_fingerprint, /* set_fingerprint */
 	NULL, /* read */
+	NULL, /* read_range */
 	NULL, /* write */
 	hw_ostc_device_dump, /* dump */
 	hw_ostc_device_foreach, /* foreach */
+	NULL, /* foreach_header */
 	hw_ostc_device_timesync, /* timesync */
 	NULL /* close */
 };
 
-static dc_status_t
-hw_ostc_extract_dives (dc_device_t *device, const unsigned char data[], unsigned int size, dc_dive_callback_t callback, void *userdata);
-
 static dc_status_t
 hw_ostc_send (hw_ostc_device_t *device, unsigned char cmd, unsigned int echo)
 {
@@ -293,7 +292,7 @@ hw_ostc_device_dump (dc_device_t *abstract, dc_buffer_t *buffer)
 static dc_status_t
 hw_ostc_device_foreach (dc_device_t *abstract, dc_dive_callback_t callback, void *userdata)
 {
-	dc_buffer_t *buffer = dc_buffer_new (0);
+	dc_buffer_t *buffer = dc_buffer_new_context (abstract->context, 0);
 	if (buffer == NULL)
 		return DC_STATUS_NOMEMORY;
 
@@ -594,7 +593,7 @@ hw_ostc_device_screenshot (dc_device_t *abstract, dc_buffer_t *buffer, hw_ostc_f
 }
 
 
-static dc_status_t
+dc_status_t
 hw_ostc_extract_dives (dc_device_t *abstract, const unsigned char data[], unsigned int size, dc_dive_callback_t callback, void *userdata)
 {
 	hw_ostc_device_t *device = (hw_ostc_device_t *) abstract;
@@ -602,6 +601,9 @@ hw_ostc_extract_dives (dc_device_t *abstract, const unsigned char data[], unsign
 	if (abstract && !ISINSTANCE (abstract))
 		return DC_STATUS_INVALIDARGS;
 
+	if (size < SZ_HEADER)
+		return DC_STATUS_DATAFORMAT;
+
 	const unsigned char header[2] = {0xFA, 0xFA};
 	const unsigned char footer[2] = {0xFD, 0xFD};
 
@@ -610,7 +612,7 @@ hw_ostc_extract_dives (dc_device_t *abstract, const unsigned char data[], unsign
 	const unsigned char *previous = data + size;
 
 	// Search the data stream for header markers.
-	while ((current = array_search_backward (data + 266, current - data - 266, header, sizeof (header))) != NULL) {
+	while ((current = array_search_backward (data + SZ_HEADER, current - data - SZ_HEADER, header, sizeof (header))) != NULL) {
 		// Move the pointer to the begin of the header.
 		current -= sizeof (header);
 
@@ -661,44 +663,25 @@ hw_ostc_firmware_readfile (hw_ostc_firmware_t *firmware, dc_context_t *context,
 	}
 
 	// Read the hex file.
-	unsigned int lba = 0;
-	dc_ihex_entry_t entry;
-	while ((rc = dc_ihex_file_read (file, &entry)) == DC_STATUS_SUCCESS) {
-		if (entry.type == 0) {
-			// Data record.
-			unsigned int address = (lba << 16) + entry.address;
-			if (address + entry.length > SZ_FIRMWARE) {
-				WARNING (context, "Ignoring out of range record (0x%08x,%u).", address, entry.length);
-				continue;
-			}
-
-			// Copy the record to the buffer.
-			memcpy (firmware->data + address, entry.data, entry.length);
-
-			// Mark the corresponding blocks in the bitmap.
-			unsigned int begin = address / SZ_BLOCK;
-			unsigned int end = (address + entry.length + SZ_BLOCK - 1) / SZ_BLOCK;
-			for (unsigned int i = begin; i < end; ++i) {
-				firmware->bitmap[i] = 1;
-			}
-		} else if (entry.type == 1) {
-			// End of file record.
-			break;
-		} else if (entry.type == 4) {
-			// Extended linear address record.
-			lba = array_uint16_be (entry.data);
-		} else {
-			ERROR (context, "Unexpected record type.");
-			dc_ihex_file_close (file);
-			return DC_STATUS_DATAFORMAT;
-		}
-	}
-	if (rc != DC_STATUS_SUCCESS && rc != DC_STATUS_DONE) {
-		ERROR (context, "Failed to read the record.");
+	dc_ihex_segment_t segments[256];
+	unsigned int nsegments = 0;
+	rc = dc_ihex_file_load (file, firmware->data, sizeof (firmware->data),
+		segments, C_ARRAY_SIZE (segments), &nsegments);
+	if (rc != DC_STATUS_SUCCESS) {
+		ERROR (context, "Failed to read the hex file.");
 		dc_ihex_file_close (file);
 		return rc;
 	}
 
+	// Mark the blocks containing data in the bitmap.
+	for (unsigned int i = 0; i < nsegments; ++i) {
+		unsigned int begin = segments[i].address / SZ_BLOCK;
+		unsigned int end = (segments[i].address + segments[i].length + SZ_BLOCK - 1) / SZ_BLOCK;
+		for (unsigned int j = begin; j < end; ++j) {
+			firmware->bitmap[j] = 1;
+		}
+	}
+
 	// Close the file.
 	dc_ihex_file_close (file);
 
@@ -773,6 +756,8 @@ hw_ostc_firmware_setup (hw_ostc_device_t *device, unsigned int maxretries)
 		// Abort if the maximum number of retries is reached.
 		if (nretries++ >= maxretries)
 			break;
+
+		device_stats_retry ((dc_device_t *) device);
 	}
 
 	return rc;
@@ -824,6 +809,8 @@ hw_ostc_firmware_write (hw_ostc_device_t *device, unsigned char *data, unsigned
 		// Abort if the maximum number of retries is reached.
 		if (nretries++ >= MAXRETRIES)
 			break;
+
+		device_stats_retry ((dc_device_t *) device);
 	}
 
 	return rc;
@@ -90,6 +90,8 @@
 #define NODELAY 0
 #define TIMEOUT 400
 
+#define MAXBATCH 16
+
 #define HDR_COMPACT_LENGTH   0 // 3 bytes
 #define HDR_COMPACT_SUMMARY  3 // 10 bytes
 #define HDR_COMPACT_NUMBER  13 // 2 bytes
@@ -150,6 +152,7 @@ static dc_status_t hw_ostc3_device_read (dc_device_t *abstract, unsigned int add
 static dc_status_t hw_ostc3_device_write (dc_device_t *abstract, unsigned int address, const unsigned char data[], unsigned int size);
 static dc_status_t hw_ostc3_device_dump (dc_device_t *abstract, dc_buffer_t *buffer);
 static dc_status_t hw_ostc3_device_foreach (dc_device_t *abstract, dc_dive_callback_t callback, void *userdata);
+static dc_status_t hw_ostc3_device_foreach_header (dc_device_t *abstract, dc_dive_callback_t callback, void *userdata);
 static dc_status_t hw_ostc3_device_timesync (dc_device_t *abstract, const dc_datetime_t *datetime);
 static dc_status_t hw_ostc3_device_close (dc_device_t *abstract);
 
@@ -158,9 +161,11 @@ static const dc_device_vtable_t hw_ostc3_device_vtable = {
 	DC_FAMILY_HW_OSTC3,
 	hw_ostc3_device_set_fingerprint, /* set_fingerprint */
 	hw_ostc3_device_read, /* read */
+	NULL, /* read_range */
 	hw_ostc3_device_write, /* write */
 	hw_ostc3_device_dump, /* dump */
 	hw_ostc3_device_foreach, /* foreach */
+	hw_ostc3_device_foreach_header, /* foreach_header */
 	hw_ostc3_device_timesync, /* timesync */
 	hw_ostc3_device_close /* close */
 };
@@ -586,6 +591,11 @@ hw_ostc3_device_init (hw_ostc3_device_t *device, hw_ostc3_state_t state)
 		// But in service mode, all download commands are supported too,
 		// so there is no need to change the state.
 		rc = DC_STATUS_SUCCESS;
+	} else if (device->state == DOWNLOAD && state == SERVICE) {
+		// Leaving download mode requires a new connection. A session
+		// that needs both modes should enter service mode first.
+		ERROR (abstract->context, "Service mode is not available after download mode.");
+		rc = DC_STATUS_INVALIDARGS;
 	} else {
 		// Not supported.
 		rc = DC_STATUS_INVALIDARGS;
@@ -722,15 +732,14 @@ hw_ostc3_device_hardware (dc_device_t *abstract, unsigned char data[], unsigned
 }
 
 
+/*
+ * Download the logbook headers, using the compact headers if the
+ * firmware supports them, and locate the most recent dive.
+ */
 static dc_status_t
-hw_ostc3_device_foreach (dc_device_t *abstract, dc_dive_callback_t callback, void *userdata)
+hw_ostc3_device_logbook (hw_ostc3_device_t *device, dc_event_progress_t *progress, unsigned char **out, const hw_ostc3_logbook_t **layout, unsigned int *index)
 {
-	hw_ostc3_device_t *device = (hw_ostc3_device_t *) abstract;
-
-	// Enable progress notifications.
-	dc_event_progress_t progress = EVENT_PROGRESS_INITIALIZER;
-	progress.maximum = SZ_MEMORY;
-	device_event_emit (abstract, DC_EVENT_PROGRESS, &progress);
+	dc_device_t *abstract = (dc_device_t *) device;
 
 	dc_status_t rc = hw_ostc3_device_init (device, DOWNLOAD);
 	if (rc != DC_STATUS_SUCCESS)
@@ -751,8 +760,12 @@ hw_ostc3_device_foreach (dc_device_t *abstract, dc_dive_callback_t callback, voi
 	}
 	device_event_emit (abstract, DC_EVENT_DEVINFO, &devinfo);
 
-	// Allocate memory.
-	unsigned char *header = (unsigned char *) malloc (RB_LOGBOOK_SIZE_FULL * RB_LOGBOOK_COUNT);
+	// Allocate memory for the compact logbook headers.
+	rc = dc_context_check_buffer (abstract->context, RB_LOGBOOK_SIZE_COMPACT * RB_LOGBOOK_COUNT, "logbook");
+	if (rc != DC_STATUS_SUCCESS)
+		return rc;
+
+	unsigned char *header = (unsigned char *) malloc (RB_LOGBOOK_SIZE_COMPACT * RB_LOGBOOK_COUNT);
 	if (header == NULL) {
 		ERROR (abstract->context, "Failed to allocate memory.");
 		return DC_STATUS_NOMEMORY;
@@ -760,13 +773,24 @@ hw_ostc3_device_foreach (dc_device_t *abstract, dc_dive_callback_t callback, voi
 
 	// Download the compact logbook headers. If the firmware doesn't support
 	// compact headers yet, fallback to downloading the full logbook headers.
-	// This is slower, but also works for older firmware versions.
+	// This is slower, but also works for older firmware versions. The full
+	// logbook headers are only needed to locate the new dives; the header
+	// of each new dive is downloaded again along with its profile.
 	unsigned int compact = 1;
-	rc = hw_ostc3_transfer (device, &progress, COMPACT,
+	rc = hw_ostc3_transfer (device, progress, COMPACT,
               NULL, 0, header, RB_LOGBOOK_SIZE_COMPACT * RB_LOGBOOK_COUNT, NULL, NODELAY);
 	if (rc == DC_STATUS_UNSUPPORTED) {
 		compact = 0;
-		rc = hw_ostc3_transfer (device, &progress, HEADER,
+		free (header);
+		rc = dc_context_check_buffer (abstract->context, RB_LOGBOOK_SIZE_FULL * RB_LOGBOOK_COUNT, "logbook");
+		if (rc != DC_STATUS_SUCCESS)
+			return rc;
+		header = (unsigned char *) malloc (RB_LOGBOOK_SIZE_FULL * RB_LOGBOOK_COUNT);
+		if (header == NULL) {
+			ERROR (abstract->context, "Failed to allocate memory.");
+			return DC_STATUS_NOMEMORY;
+		}
+		rc = hw_ostc3_transfer (device, progress, HEADER,
 		          NULL, 0, header, RB_LOGBOOK_SIZE_FULL * RB_LOGBOOK_COUNT, NULL, NODELAY);
 	}
 	if (rc != DC_STATUS_SUCCESS) {
@@ -804,6 +828,33 @@ hw_ostc3_device_foreach (dc_device_t *abstract, dc_dive_callback_t callback, voi
 		}
 	}
 
+	*out = header;
+	*layout = logbook;
+	*index = latest;
+
+	return DC_STATUS_SUCCESS;
+}
+
+
+static dc_status_t
+hw_ostc3_device_foreach (dc_device_t *abstract, dc_dive_callback_t callback, void *userdata)
+{
+	hw_ostc3_device_t *device = (hw_ostc3_device_t *) abstract;
+
+	// Enable progress notifications.
+	dc_event_progress_t progress = EVENT_PROGRESS_INITIALIZER;
+	progress.maximum = SZ_MEMORY;
+	device_event_emit (abstract, DC_EVENT_PROGRESS, &progress);
+
+	unsigned char *header = NULL;
+	const hw_ostc3_logbook_t *logbook = NULL;
+	unsigned int latest = 0;
+	dc_status_t rc = hw_ostc3_device_logbook (device, &progress, &header, &logbook, &latest);
+	if (rc != DC_STATUS_SUCCESS)
+		return rc;
+
+	unsigned int compact = logbook == &hw_ostc3_logbook_compact;
+
 	// Calculate the total and maximum size.
 	unsigned int ndives = 0;
 	unsigned int size = 0;
@@ -837,6 +888,10 @@ hw_ostc3_device_foreach (dc_device_t *abstract, dc_dive_callback_t callback, voi
 		if (memcmp (header + offset + logbook->fingerprint, device->fingerprint, sizeof (device->fingerprint)) == 0)
 			break;
 
+		// Skip dives left out by a selective download.
+		if (device_is_excluded (abstract, header + offset + logbook->fingerprint, sizeof (device->fingerprint)))
+			continue;
+
 		if (length > maxsize)
 			maxsize = length;
 		size += length;
@@ -855,6 +910,12 @@ hw_ostc3_device_foreach (dc_device_t *abstract, dc_dive_callback_t callback, voi
 	}
 
 	// Allocate enough memory for the largest dive.
+	rc = dc_context_check_buffer (abstract->context, maxsize, "profile");
+	if (rc != DC_STATUS_SUCCESS) {
+		free (header);
+		return rc;
+	}
+
 	unsigned char *profile = (unsigned char *) malloc (maxsize);
 	if (profile == NULL) {
 		ERROR (abstract->context, "Failed to allocate memory.");
@@ -930,6 +991,47 @@ hw_ostc3_device_foreach (dc_device_t *abstract, dc_dive_callback_t callback, voi
 }
 
 
+static dc_status_t
+hw_ostc3_device_foreach_header (dc_device_t *abstract, dc_dive_callback_t callback, void *userdata)
+{
+	hw_ostc3_device_t *device = (hw_ostc3_device_t *) abstract;
+
+	// Enable progress notifications.
+	dc_event_progress_t progress = EVENT_PROGRESS_INITIALIZER;
+	progress.maximum = RB_LOGBOOK_SIZE_COMPACT * RB_LOGBOOK_COUNT;
+	device_event_emit (abstract, DC_EVENT_PROGRESS, &progress);
+
+	unsigned char *header = NULL;
+	const hw_ostc3_logbook_t *logbook = NULL;
+	unsigned int latest = 0;
+	dc_status_t rc = hw_ostc3_device_logbook (device, &progress, &header, &logbook, &latest);
+	if (rc != DC_STATUS_SUCCESS)
+		return rc;
+
+	// Pass the compact or full logbook headers, depending on what the
+	// firmware supports, starting with the most recent dive.
+	for (unsigned int i = 0; i < RB_LOGBOOK_COUNT; ++i) {
+		unsigned int idx = (latest + RB_LOGBOOK_COUNT - i) % RB_LOGBOOK_COUNT;
+		unsigned char *p = header + idx * logbook->size;
+
+		// Ignore uninitialized header entries.
+		if (array_isequal (p, logbook->size, 0xFF))
+			continue;
+
+		// Check the fingerprint data.
+		if (memcmp (p + logbook->fingerprint, device->fingerprint, sizeof (device->fingerprint)) == 0)
+			break;
+
+		if (callback && !callback (p, logbook->size, p + logbook->fingerprint, sizeof (device->fingerprint), userdata))
+			break;
+	}
+
+	free (header);
+
+	return DC_STATUS_SUCCESS;
+}
+
+
 static dc_status_t
 hw_ostc3_device_timesync (dc_device_t *abstract, const dc_datetime_t *datetime)
 {
@@ -1032,6 +1134,90 @@ hw_ostc3_device_config_read (dc_device_t *abstract, unsigned int config, unsigne
 	return DC_STATUS_SUCCESS;
 }
 
+dc_status_t
+hw_ostc3_device_config_read_multiple (dc_device_t *abstract, const unsigned int config[], const unsigned int size[], unsigned int count, unsigned char data[])
+{
+	hw_ostc3_device_t *device = (hw_ostc3_device_t *) abstract;
+	dc_status_t status = DC_STATUS_SUCCESS;
+
+	if (!ISINSTANCE (abstract))
+		return DC_STATUS_INVALIDARGS;
+
+	if (count && (config == NULL || size == NULL || data == NULL))
+		return DC_STATUS_INVALIDARGS;
+
+	dc_status_t rc = hw_ostc3_device_init (device, DOWNLOAD);
+	if (rc != DC_STATUS_SUCCESS)
+		return rc;
+
+	for (unsigned int i = 0; i < count; ++i) {
+		if (device->hardware == OSTC4 ? size[i] != SZ_CONFIG : size[i] > SZ_CONFIG) {
+			ERROR (abstract->context, "Invalid parameter specified.");
+			return DC_STATUS_INVALIDARGS;
+		}
+	}
+
+	const unsigned char ready = (device->state == SERVICE ? S_READY : READY);
+
+	// The read commands are sent in batches, without waiting for the
+	// echo of every command, and the answers are collected afterwards.
+	unsigned int offset = 0;
+	for (unsigned int i = 0; i < count; i += MAXBATCH) {
+		unsigned int n = count - i < MAXBATCH ? count - i : MAXBATCH;
+
+		if (device_is_cancelled (abstract))
+			return DC_STATUS_CANCELLED;
+
+		unsigned char command[2 * MAXBATCH] = {0};
+		for (unsigned int j = 0; j < n; ++j) {
+			command[2 * j + 0] = READ;
+			command[2 * j + 1] = config[i + j];
+		}
+
+		status = dc_iostream_write (device->iostream, command, 2 * n, NULL);
+		if (status != DC_STATUS_SUCCESS) {
+			ERROR (abstract->context, "Failed to send the command.");
+			return status;
+		}
+
+		for (unsigned int j = 0; j < n; ++j) {
+			unsigned char echo[1] = {0};
+			status = dc_iostream_read (device->iostream, echo, sizeof (echo), NULL);
+			if (status != DC_STATUS_SUCCESS) {
+				ERROR (abstract->context, "Failed to receive the echo.");
+				return status;
+			}
+
+			if (echo[0] != READ) {
+				ERROR (abstract->context, "Unexpected echo.");
+				return DC_STATUS_PROTOCOL;
+			}
+
+			status = hw_ostc3_read (device, NULL, data + offset, size[i + j]);
+			if (status != DC_STATUS_SUCCESS) {
+				ERROR (abstract->context, "Failed to receive the answer.");
+				return status;
+			}
+
+			unsigned char answer[1] = {0};
+			status = dc_iostream_read (device->iostream, answer, sizeof (answer), NULL);
+			if (status != DC_STATUS_SUCCESS) {
+				ERROR (abstract->context, "Failed to receive the ready byte.");
+				return status;
+			}
+
+			if (answer[0] != ready) {
+				ERROR (abstract->context, "Unexpected ready byte.");
+				return DC_STATUS_PROTOCOL;
+			}
+
+			offset += size[i + j];
+		}
+	}
+
+	return DC_STATUS_SUCCESS;
+}
+
 dc_status_t
 hw_ostc3_device_config_write (dc_device_t *abstract, unsigned int config, const unsigned char data[], unsigned int size)
 {
@@ -1059,6 +1245,17 @@ hw_ostc3_device_config_write (dc_device_t *abstract, unsigned int config, const
 	return DC_STATUS_SUCCESS;
 }
 
+dc_status_t
+hw_ostc3_device_service (dc_device_t *abstract)
+{
+	hw_ostc3_device_t *device = (hw_ostc3_device_t *) abstract;
+
+	if (!ISINSTANCE (abstract))
+		return DC_STATUS_INVALIDARGS;
+
+	return hw_ostc3_device_init (device, SERVICE);
+}
+
 dc_status_t
 hw_ostc3_device_config_reset (dc_device_t *abstract)
 {
@@ -1160,8 +1357,6 @@ hw_ostc3_firmware_readfile3 (hw_ostc3_firmware_t *firmware, dc_context_t *contex
 	dc_status_t rc = DC_STATUS_SUCCESS;
 	FILE *fp = NULL;
 	unsigned char iv[16] = {0};
-	unsigned char tmpbuf[16] = {0};
-	unsigned char encrypted[16] = {0};
 	unsigned int bytes = 0, addr = 0;
 	unsigned char checksum[4];
 
@@ -1188,25 +1383,18 @@ hw_ostc3_firmware_readfile3 (hw_ostc3_firmware_t *firmware, dc_context_t *contex
 	}
 	bytes += 16;
 
-	// Load the iv for AES-FCB-mode
-	AES128_ECB_encrypt (iv, ostc3_key, tmpbuf);
-
 	for (addr = 0; addr < SZ_FIRMWARE; addr += 16, bytes += 16) {
-		rc = hw_ostc3_firmware_readline (fp, context, bytes, encrypted, sizeof(encrypted));
+		rc = hw_ostc3_firmware_readline (fp, context, bytes, firmware->data + addr, 16);
 		if (rc != DC_STATUS_SUCCESS) {
 			ERROR (context, "Failed to parse file data.");
 			fclose (fp);
 			return rc;
 		}
-
-		// Decrypt AES-FCB data
-		for (unsigned int i = 0; i < 16; i++)
-			firmware->data[addr + i] = encrypted[i] ^ tmpbuf[i];
-
-		// Run the next round of encryption
-		AES128_ECB_encrypt (encrypted, ostc3_key, tmpbuf);
 	}
 
+	// Decrypt the AES-FCB data in place.
+	AES128_CFB_decrypt_buffer (firmware->data, firmware->data, SZ_FIRMWARE, ostc3_key, iv);
+
 	// This file format contains a tail with the checksum in
 	rc = hw_ostc3_firmware_readline (fp, context, bytes, checksum, sizeof(checksum));
 	if (rc != DC_STATUS_SUCCESS) {
@@ -1404,9 +1592,9 @@ hw_ostc3_device_fwupdate3 (dc_device_t *abstract, const char *filename)
 	dc_context_t *context = (abstract ? abstract->context : NULL);
 
 	// Enable progress notifications.
-	// load, erase, upload FZ, verify FZ, reprogram
+	// load, compare FZ, erase, upload FZ, verify FZ, reprogram
 	dc_event_progress_t progress = EVENT_PROGRESS_INITIALIZER;
-	progress.maximum = 3 + SZ_FIRMWARE * 2 / SZ_FIRMWARE_BLOCK;
+	progress.maximum = 3 + SZ_FIRMWARE * 3 / SZ_FIRMWARE_BLOCK;
 	device_event_emit (abstract, DC_EVENT_PROGRESS, &progress);
 
 	// Allocate memory for the firmware data.
@@ -1427,13 +1615,56 @@ hw_ostc3_device_fwupdate3 (dc_device_t *abstract, const char *filename)
 	progress.current++;
 	device_event_emit (abstract, DC_EVENT_PROGRESS, &progress);
 
+	hw_ostc3_device_display (abstract, " Comparing...");
+
+	// The firmware area usually still contains an earlier upload, for
+	// example from an interrupted update. Compare the blocks first, and
+	// only erase and write the blocks which are actually different.
+	unsigned char changed[SZ_FIRMWARE / SZ_FIRMWARE_BLOCK] = {0};
+	for (unsigned int i = 0; i < C_ARRAY_SIZE (changed); ++i) {
+		unsigned char block[SZ_FIRMWARE_BLOCK];
+		unsigned int len = i * SZ_FIRMWARE_BLOCK;
+
+		rc = hw_ostc3_firmware_block_read (device, FIRMWARE_AREA + len, block, sizeof (block));
+		if (rc != DC_STATUS_SUCCESS) {
+			ERROR (context, "Failed to read block.");
+			free (firmware);
+			return rc;
+		}
+
+		if (memcmp (firmware->data + len, block, sizeof (block)) != 0) {
+			changed[i] = 1;
+		} else {
+			// An unchanged block needs no upload and verification.
+			progress.current += 2;
+		}
+
+		// One block compared
+		progress.current++;
+		device_event_emit (abstract, DC_EVENT_PROGRESS, &progress);
+	}
+
 	hw_ostc3_device_display (abstract, " Erasing FW...");
 
-	rc = hw_ostc3_firmware_erase (device, FIRMWARE_AREA, SZ_FIRMWARE);
-	if (rc != DC_STATUS_SUCCESS) {
-		ERROR (context, "Failed to erase old firmware");
-		free (firmware);
-		return rc;
+	// Erase the consecutive runs of changed blocks.
+	for (unsigned int i = 0; i < C_ARRAY_SIZE (changed); ) {
+		if (!changed[i]) {
+			i++;
+			continue;
+		}
+
+		unsigned int n = 1;
+		while (i + n < C_ARRAY_SIZE (changed) && changed[i + n])
+			n++;
+
+		rc = hw_ostc3_firmware_erase (device, FIRMWARE_AREA + i * SZ_FIRMWARE_BLOCK, n * SZ_FIRMWARE_BLOCK);
+		if (rc != DC_STATUS_SUCCESS) {
+			ERROR (context, "Failed to erase old firmware");
+			free (firmware);
+			return rc;
+		}
+
+		i += n;
 	}
 
 	// Memory erased
@@ -1443,6 +1674,9 @@ hw_ostc3_device_fwupdate3 (dc_device_t *abstract, const char *filename)
 	hw_ostc3_device_display (abstract, " Uploading...");
 
 	for (unsigned int len = 0; len < SZ_FIRMWARE; len += SZ_FIRMWARE_BLOCK) {
+		if (!changed[len / SZ_FIRMWARE_BLOCK])
+			continue;
+
 		char status[SZ_DISPLAY + 1]; // Status message on the display
 		dc_platform_snprintf (status, sizeof(status), " Uploading %2d%%", (100 * len) / SZ_FIRMWARE);
 		hw_ostc3_device_display (abstract, status);
@@ -1461,6 +1695,9 @@ hw_ostc3_device_fwupdate3 (dc_device_t *abstract, const char *filename)
 	hw_ostc3_device_display (abstract, " Verifying...");
 
 	for (unsigned int len = 0; len < SZ_FIRMWARE; len += SZ_FIRMWARE_BLOCK) {
+		if (!changed[len / SZ_FIRMWARE_BLOCK])
+			continue;
+
 		unsigned char block[SZ_FIRMWARE_BLOCK];
 		char status[SZ_DISPLAY + 1]; // Status message on the display
 		dc_platform_snprintf (status, sizeof(status), " Verifying %2d%%", (100 * len) / SZ_FIRMWARE);
@@ -1510,7 +1747,7 @@ hw_ostc3_device_fwupdate4 (dc_device_t *abstract, const char *filename, bool for
 	dc_context_t *context = (abstract ? abstract->context : NULL);
 
 	// Allocate memory for the firmware data.
-	dc_buffer_t *buffer = dc_buffer_new (0);
+	dc_buffer_t *buffer = dc_buffer_new_context (abstract->context, 0);
 	if (buffer == NULL) {
 		ERROR (context, "Failed to allocate memory.");
 		status = DC_STATUS_NOMEMORY;
@@ -1739,6 +1976,10 @@ hw_ostc3_device_dump (dc_device_t *abstract, dc_buffer_t *buffer)
 	device_event_emit (abstract, DC_EVENT_DEVINFO, &devinfo);
 
 	// Allocate the required amount of memory.
+	rc = dc_context_check_buffer (abstract->context, SZ_MEMORY, "memory dump");
+	if (rc != DC_STATUS_SUCCESS)
+		return rc;
+
 	if (!dc_buffer_resize (buffer, SZ_MEMORY)) {
 		ERROR (abstract->context, "Insufficient buffer space available.");
 		return DC_STATUS_NOMEMORY;
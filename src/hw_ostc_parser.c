@@ -34,6 +34,7 @@
 #include "context-private.h"
 #include "parser-private.h"
 #include "array.h"
+#include "field-cache.h"
 
 #define ISINSTANCE(parser) dc_parser_isinstance((parser), &hw_ostc_parser_vtable)
 
@@ -46,6 +47,8 @@
 #define HEADER  1
 #define PROFILE 2
 
+#define CHECKPOINT 64
+
 #define TEMPERATURE 0
 #define DECO        1
 #define GF          2
@@ -122,6 +125,24 @@ typedef struct hw_ostc_gasmix_t {
 	unsigned int diluent;
 } hw_ostc_gasmix_t;
 
+typedef struct hw_ostc_state_t {
+	unsigned int initialized;
+	unsigned int samplerate;
+	unsigned int nconfig;
+	hw_ostc_sample_info_t info[MAXCONFIG];
+	unsigned int firmware;
+	unsigned int ccr;
+	unsigned int time;
+	unsigned int nsamples;
+	unsigned int tank;
+	unsigned int offset;
+} hw_ostc_state_t;
+
+typedef struct hw_ostc_checkpoint_t {
+	hw_ostc_state_t state;
+	unsigned int ccr;
+} hw_ostc_checkpoint_t;
+
 typedef struct hw_ostc_parser_t {
 	dc_parser_t base;
 	unsigned int hwos;
@@ -139,14 +160,29 @@ typedef struct hw_ostc_parser_t {
 	unsigned int initial_setpoint;
 	unsigned int initial_cns;
 	hw_ostc_gasmix_t gasmix[NGASMIXES];
+	dc_gasmix_map_t manual;
 	unsigned int current_divemode_ccr;
+	// Start of the profile, with the validated sample configuration.
+	hw_ostc_state_t profile;
+	// Incremental parsing.
+	hw_ostc_state_t live;
+	// Seek index, with the decoder state every CHECKPOINT samples.
+	hw_ostc_checkpoint_t *index;
+	unsigned int nindex;
+	unsigned int capacity;
+	unsigned int indexing;
+	unsigned int nsamples;
 } hw_ostc_parser_t;
 
 static dc_status_t hw_ostc_parser_get_datetime (dc_parser_t *abstract, dc_datetime_t *datetime);
 static dc_status_t hw_ostc_parser_get_field (dc_parser_t *abstract, dc_field_type_t type, unsigned int flags, void *value);
 static dc_status_t hw_ostc_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_t callback, void *userdata);
+static dc_status_t hw_ostc_parser_samples_append (dc_parser_t *abstract, dc_sample_callback_t callback, void *userdata);
+static dc_status_t hw_ostc_parser_samples_range (dc_parser_t *abstract, unsigned int begin, dc_sample_callback_t callback, void *userdata);
 
 static dc_status_t hw_ostc_parser_internal_foreach (hw_ostc_parser_t *parser, dc_sample_callback_t callback, void *userdata);
+static dc_status_t hw_ostc_parser_reset (dc_parser_t *abstract);
+static dc_status_t hw_ostc_parser_destroy (dc_parser_t *abstract);
 
 static const dc_parser_vtable_t hw_ostc_parser_vtable = {
 	sizeof(hw_ostc_parser_t),
@@ -156,8 +192,14 @@ static const dc_parser_vtable_t hw_ostc_parser_vtable = {
 	NULL, /* set_density */
 	hw_ostc_parser_get_datetime, /* datetime */
 	hw_ostc_parser_get_field, /* fields */
+	NULL, /* summary */
 	hw_ostc_parser_samples_foreach, /* samples_foreach */
-	NULL /* destroy */
+	NULL, /* samples_batch */
+	NULL, /* samples_fixed */
+	hw_ostc_parser_samples_append, /* samples_append */
+	hw_ostc_parser_samples_range, /* samples_range */
+	hw_ostc_parser_reset, /* reset */
+	hw_ostc_parser_destroy /* destroy */
 };
 
 static const hw_ostc_layout_t hw_ostc_layout_ostc = {
@@ -217,17 +259,20 @@ static const hw_ostc_layout_t hw_ostc_layout_ostc3 = {
 static unsigned int
 hw_ostc_find_gasmix_manual (hw_ostc_parser_t *parser, unsigned int o2, unsigned int he, unsigned int dil)
 {
-	unsigned int offset = parser->nfixed - parser->ndisabled;
-	unsigned int count = parser->ngasmixes;
+	unsigned int idx = dc_gasmix_map_find (&parser->manual, o2, he, dil);
+	if (idx == DC_GASMIX_UNKNOWN)
+		return parser->ngasmixes;
 
-	unsigned int i = offset;
-	while (i < count) {
-		if (o2 == parser->gasmix[i].oxygen && he == parser->gasmix[i].helium && dil == parser->gasmix[i].diluent)
-			break;
-		i++;
-	}
+	return idx;
+}
 
-	return i;
+static void
+hw_ostc_index_gasmix_manual (hw_ostc_parser_t *parser)
+{
+	dc_gasmix_map_clear (&parser->manual);
+	for (unsigned int i = parser->nfixed - parser->ndisabled; i < parser->ngasmixes; ++i) {
+		dc_gasmix_map_insert (&parser->manual, parser->gasmix[i].oxygen, parser->gasmix[i].helium, parser->gasmix[i].diluent, i);
+	}
 }
 
 static unsigned int
@@ -246,6 +291,18 @@ hw_ostc_find_gasmix_fixed (hw_ostc_parser_t *parser, unsigned int id)
 	return i;
 }
 
+static unsigned int
+hw_ostc_has_disabled (hw_ostc_parser_t *parser)
+{
+	unsigned int count = parser->nfixed - parser->ndisabled;
+	for (unsigned int i = 0; i < count; ++i) {
+		if (!parser->gasmix[i].enabled)
+			return 1;
+	}
+
+	return 0;
+}
+
 static unsigned int
 hw_ostc_is_ccr (unsigned int divemode, unsigned int version)
 {
@@ -391,6 +448,7 @@ hw_ostc_parser_cache (hw_ostc_parser_t *parser)
 	parser->ngasmixes = ngasmixes;
 	parser->nfixed = ngasmixes;
 	parser->ndisabled = 0;
+	dc_gasmix_map_clear (&parser->manual);
 	parser->initial = initial;
 	parser->initial_setpoint = initial_setpoint;
 	parser->initial_cns = initial_cns;
@@ -420,6 +478,22 @@ hw_ostc_parser_create_internal (dc_parser_t **out, dc_context_t *context, const
 	// Set the default values.
 	parser->hwos = hwos;
 	parser->model = model;
+	parser->serial = serial;
+	parser->index = NULL;
+	parser->capacity = 0;
+	hw_ostc_parser_reset ((dc_parser_t *) parser);
+
+	*out = (dc_parser_t *) parser;
+
+	return DC_STATUS_SUCCESS;
+}
+
+
+static dc_status_t
+hw_ostc_parser_reset (dc_parser_t *abstract)
+{
+	hw_ostc_parser_t *parser = (hw_ostc_parser_t *) abstract;
+
 	parser->cached = 0;
 	parser->version = 0;
 	parser->header = 0;
@@ -439,9 +513,23 @@ hw_ostc_parser_create_internal (dc_parser_t **out, dc_context_t *context, const
 		parser->gasmix[i].active = 0;
 		parser->gasmix[i].diluent = 0;
 	}
-	parser->serial = serial;
+	dc_gasmix_map_clear (&parser->manual);
+	parser->profile.initialized = 0;
+	parser->live.initialized = 0;
+	parser->nindex = 0;
+	parser->indexing = 0;
+	parser->nsamples = 0;
+
+	return DC_STATUS_SUCCESS;
+}
 
-	*out = (dc_parser_t *) parser;
+
+static dc_status_t
+hw_ostc_parser_destroy (dc_parser_t *abstract)
+{
+	hw_ostc_parser_t *parser = (hw_ostc_parser_t *) abstract;
+
+	free (parser->index);
 
 	return DC_STATUS_SUCCESS;
 }
@@ -806,6 +894,11 @@ hw_ostc_parser_get_field (dc_parser_t *abstract, dc_field_type_t type, unsigned
 			}
 			string->value = strdup(buf);
 			break;
+		case DC_FIELD_SAMPLE_COUNT:
+			if (flags != DC_SAMPLE_TIME && flags != DC_SAMPLE_DEPTH)
+				return DC_STATUS_UNSUPPORTED;
+			*((unsigned int *) value) = parser->nsamples;
+			break;
 		default:
 			return DC_STATUS_UNSUPPORTED;
 		}
@@ -815,6 +908,28 @@ hw_ostc_parser_get_field (dc_parser_t *abstract, dc_field_type_t type, unsigned
 }
 
 
+/*
+ * The sample type reported for each kind of extended sample data.
+ */
+static dc_sample_type_t
+hw_ostc_sample_type (unsigned int type)
+{
+	switch (type) {
+	case TEMPERATURE:
+		return DC_SAMPLE_TEMPERATURE;
+	case DECO:
+		return DC_SAMPLE_DECO;
+	case PPO2:
+		return DC_SAMPLE_PPO2;
+	case CNS:
+		return DC_SAMPLE_CNS;
+	case TANK:
+		return DC_SAMPLE_PRESSURE;
+	default:
+		return DC_SAMPLE_VENDOR;
+	}
+}
+
 static void hw_ostc_notify_bailout(hw_ostc_parser_t *parser, const unsigned char *data, unsigned int index, dc_sample_callback_t callback, void *userdata)
 {
 	if (parser->current_divemode_ccr != parser->gasmix[index].diluent) {
@@ -828,7 +943,7 @@ static void hw_ostc_notify_bailout(hw_ostc_parser_t *parser, const unsigned char
 			sample.event.name = "Switched to open circuit bailout";
 		}
 
-		if (callback) {
+		if (callback && dc_parser_wants (parser, DC_SAMPLE_EVENT)) {
 			callback(DC_SAMPLE_EVENT, &sample, userdata);
 		}
 
@@ -837,7 +952,7 @@ static void hw_ostc_notify_bailout(hw_ostc_parser_t *parser, const unsigned char
 }
 
 static dc_status_t
-hw_ostc_parser_internal_foreach (hw_ostc_parser_t *parser, dc_sample_callback_t callback, void *userdata)
+hw_ostc_parser_samples_init (hw_ostc_parser_t *parser, hw_ostc_state_t *state, unsigned int live)
 {
 	dc_parser_t *abstract = (dc_parser_t *) parser;
 	const unsigned char *data = abstract->data;
@@ -847,18 +962,23 @@ hw_ostc_parser_internal_foreach (hw_ostc_parser_t *parser, dc_sample_callback_t
 	unsigned int header = parser->header;
 	const hw_ostc_layout_t *layout = parser->layout;
 
+	state->initialized = 0;
+
 	// Exit if no profile data available.
 	const unsigned char empty[] = {0x08, 0x00, 0x00, 0xFD, 0xFD};
-	if (size == header ||
+	if (!live && (size == header ||
 		(size == header + 2 && memcmp(data + header, empty + 3, 2) == 0) ||
-		(size == header + 5 && memcmp(data + header, empty, 5) == 0)) {
+		(size == header + 5 && memcmp(data + header, empty, 5) == 0))) {
 		parser->cached = PROFILE;
 		return DC_STATUS_SUCCESS;
 	}
 
-	// Check the header length.
+	// Check the header length. For a dive that is still being written,
+	// wait until the sample configuration is available.
 	if (version == 0x23 || version == 0x24) {
 		if (size < header + 5) {
+			if (live)
+				return DC_STATUS_SUCCESS;
 			ERROR (abstract->context, "Buffer overflow detected!");
 			return DC_STATUS_DATAFORMAT;
 		}
@@ -885,13 +1005,16 @@ hw_ostc_parser_internal_foreach (hw_ostc_parser_t *parser, dc_sample_callback_t
 	// Check the header length.
 	if (version == 0x23 || version == 0x24) {
 		if (size < header + 5 + 3 * nconfig) {
+			if (live)
+				return DC_STATUS_SUCCESS;
 			ERROR (abstract->context, "Buffer overflow detected!");
 			return DC_STATUS_DATAFORMAT;
 		}
 	}
 
 	// Get the extended sample configuration.
-	hw_ostc_sample_info_t info[MAXCONFIG] = {{0}};
+	hw_ostc_sample_info_t *info = state->info;
+	memset (info, 0, sizeof (state->info));
 	for (unsigned int i = 0; i < nconfig; ++i) {
 		if (version == 0x23 || version == 0x24) {
 			info[i].type    = data[header + 5 + 3 * i + 0];
@@ -947,16 +1070,70 @@ hw_ostc_parser_internal_foreach (hw_ostc_parser_t *parser, dc_sample_callback_t
 	unsigned int ccr = hw_ostc_is_ccr (divemode, version);
 	parser->current_divemode_ccr = ccr;
 
-	unsigned int time = 0;
-	unsigned int nsamples = 0;
-	unsigned int tank = parser->initial != UNDEFINED ? parser->initial - 1 : 0;
-
-	unsigned int offset = header;
+	state->samplerate = samplerate;
+	state->nconfig = nconfig;
+	state->firmware = firmware;
+	state->ccr = ccr;
+	state->time = 0;
+	state->nsamples = 0;
+	state->tank = parser->initial != UNDEFINED ? parser->initial - 1 : 0;
+	state->offset = header;
 	if (version == 0x23 || version == 0x24)
-		offset += 5 + 3 * nconfig;
+		state->offset += 5 + 3 * nconfig;
+	state->initialized = 1;
+
+	return DC_STATUS_SUCCESS;
+}
+
+static void
+hw_ostc_parser_checkpoint (hw_ostc_parser_t *parser, const hw_ostc_state_t *state)
+{
+	if (parser->nindex >= parser->capacity) {
+		unsigned int capacity = parser->capacity ? parser->capacity * 2 : 16;
+		hw_ostc_checkpoint_t *index = (hw_ostc_checkpoint_t *) realloc (parser->index, capacity * sizeof (hw_ostc_checkpoint_t));
+		if (index == NULL) {
+			// The index is optional, so just stop recording.
+			parser->indexing = 0;
+			return;
+		}
+		parser->index = index;
+		parser->capacity = capacity;
+	}
+
+	parser->index[parser->nindex].state = *state;
+	parser->index[parser->nindex].ccr = parser->current_divemode_ccr;
+	parser->nindex++;
+}
+
+static dc_status_t
+hw_ostc_parser_samples_run (hw_ostc_parser_t *parser, hw_ostc_state_t *state, unsigned int live, dc_sample_callback_t callback, void *userdata)
+{
+	dc_parser_t *abstract = (dc_parser_t *) parser;
+	const unsigned char *data = abstract->data;
+	unsigned int size = abstract->size;
+
+	unsigned int version = parser->version;
+	unsigned int samplerate = state->samplerate;
+	unsigned int nconfig = state->nconfig;
+	unsigned int firmware = state->firmware;
+	unsigned int ccr = state->ccr;
+	hw_ostc_sample_info_t *info = state->info;
+
+	unsigned int time = state->time;
+	unsigned int nsamples = state->nsamples;
+	unsigned int tank = state->tank;
+
+	unsigned int offset = state->offset;
 	while (offset + 3 <= size) {
 		dc_sample_value_t sample = {0};
 
+		if (dc_parser_stopped (parser, callback))
+			break;
+
+		// Wait for the remainder of an incomplete sample.
+		if (live && offset + 3 + (data[offset + 2] & 0x7F) > size)
+			break;
+
 		nsamples++;
 
 		// Time (seconds).
@@ -1077,6 +1254,7 @@ hw_ostc_parser_internal_foreach (hw_ostc_parser_t *parser, dc_sample_callback_t
 				parser->gasmix[idx].active = 1;
 				parser->gasmix[idx].diluent = diluent;
 				parser->ngasmixes = idx + 1;
+				dc_gasmix_map_insert (&parser->manual, o2, he, diluent, idx);
 			}
 
 			sample.gasmix = idx;
@@ -1151,6 +1329,7 @@ hw_ostc_parser_internal_foreach (hw_ostc_parser_t *parser, dc_sample_callback_t
 					parser->gasmix[idx].active = 1;
 					parser->gasmix[idx].diluent = 0;
 					parser->ngasmixes = idx + 1;
+					dc_gasmix_map_insert (&parser->manual, o2, he, 0, idx);
 				}
 
 				sample.gasmix = idx;
@@ -1182,6 +1361,13 @@ hw_ostc_parser_internal_foreach (hw_ostc_parser_t *parser, dc_sample_callback_t
 					return DC_STATUS_DATAFORMAT;
 				}
 
+				// Don't decode the sample types nobody asked for.
+				if (callback == NULL || !dc_parser_wants (parser, hw_ostc_sample_type (info[i].type))) {
+					offset += info[i].size;
+					length -= info[i].size;
+					continue;
+				}
+
 				unsigned int ppo2[3] = {0};
 				unsigned int count = 0;
 				unsigned int value = 0;
@@ -1291,6 +1477,7 @@ hw_ostc_parser_internal_foreach (hw_ostc_parser_t *parser, dc_sample_callback_t
 					parser->gasmix[idx].active = 1;
 					parser->gasmix[idx].diluent = 0;
 					parser->ngasmixes = idx + 1;
+					dc_gasmix_map_insert (&parser->manual, o2, he, 0, idx);
 				}
 
 				sample.gasmix = idx;
@@ -1308,13 +1495,66 @@ hw_ostc_parser_internal_foreach (hw_ostc_parser_t *parser, dc_sample_callback_t
 			WARNING (abstract->context, "Remaining %u bytes skipped.", length);
 		}
 		offset += length;
+
+		// Save the position after every complete sample.
+		state->time = time;
+		state->nsamples = nsamples;
+		state->tank = tank;
+		state->offset = offset;
+
+		if (parser->indexing && nsamples % CHECKPOINT == 0)
+			hw_ostc_parser_checkpoint (parser, state);
 	}
 
+	return DC_STATUS_SUCCESS;
+}
+
+static dc_status_t
+hw_ostc_parser_internal_foreach (hw_ostc_parser_t *parser, dc_sample_callback_t callback, void *userdata)
+{
+	dc_parser_t *abstract = (dc_parser_t *) parser;
+	const unsigned char *data = abstract->data;
+	unsigned int size = abstract->size;
+
+	// Decode the sample configuration only once.
+	dc_status_t rc = DC_STATUS_SUCCESS;
+	if (!parser->profile.initialized) {
+		rc = hw_ostc_parser_samples_init (parser, &parser->profile, 0);
+		if (rc != DC_STATUS_SUCCESS || !parser->profile.initialized)
+			return rc;
+	}
+
+	hw_ostc_state_t state = parser->profile;
+	parser->current_divemode_ccr = state.ccr;
+
+	// Record the seek index during the first pass.
+	if (parser->cached < PROFILE) {
+		parser->nindex = 0;
+		parser->indexing = 1;
+	}
+
+	rc = hw_ostc_parser_samples_run (parser, &state, 0, callback, userdata);
+	parser->indexing = 0;
+	if (rc != DC_STATUS_SUCCESS)
+		return rc;
+
+	// The remainder of the profile is not needed.
+	if (dc_parser_stopped (parser, callback))
+		return DC_STATUS_SUCCESS;
+
+	// Keep the divisors which were corrected for firmware bugs.
+	memcpy (parser->profile.info, state.info, sizeof (state.info));
+
+	unsigned int offset = state.offset;
 	if (offset + 2 > size || data[offset] != 0xFD || data[offset + 1] != 0xFD) {
 		ERROR (abstract->context, "Invalid end marker found!");
 		return DC_STATUS_DATAFORMAT;
 	}
 
+	// The list of gas mixes is final after the first pass.
+	if (parser->cached >= PROFILE)
+		return DC_STATUS_SUCCESS;
+
 	// Remove the disabled gas mixes from the fixed gas mixes.
 	unsigned int ndisabled = 0, nenabled = 0;
 	unsigned int count = parser->nfixed - parser->ndisabled;
@@ -1337,7 +1577,9 @@ hw_ostc_parser_internal_foreach (hw_ostc_parser_t *parser, dc_sample_callback_t
 	// Adjust the counts.
 	parser->ngasmixes -= ndisabled;
 	parser->ndisabled += ndisabled;
+	hw_ostc_index_gasmix_manual (parser);
 
+	parser->nsamples = state.nsamples;
 	parser->cached = PROFILE;
 
 	return DC_STATUS_SUCCESS;
@@ -1353,8 +1595,10 @@ hw_ostc_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_t call
 	if (rc != DC_STATUS_SUCCESS)
 		return rc;
 
-	// Cache the profile data.
-	if (parser->cached < PROFILE) {
+	// Cache the profile data. Unless some fixed gas mixes may still be
+	// removed, the gas mix indices are already final, and the samples
+	// can be reported in the same pass.
+	if (parser->cached < PROFILE && hw_ostc_has_disabled (parser)) {
 		rc = hw_ostc_parser_internal_foreach (parser, NULL, NULL);
 		if (rc != DC_STATUS_SUCCESS)
 			return rc;
@@ -1362,3 +1606,67 @@ hw_ostc_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_t call
 
 	return hw_ostc_parser_internal_foreach (parser, callback, userdata);
 }
+
+static dc_status_t
+hw_ostc_parser_samples_range (dc_parser_t *abstract, unsigned int begin, dc_sample_callback_t callback, void *userdata)
+{
+	hw_ostc_parser_t *parser = (hw_ostc_parser_t *) abstract;
+
+	// Cache the header data.
+	dc_status_t rc = hw_ostc_parser_cache (parser);
+	if (rc != DC_STATUS_SUCCESS)
+		return rc;
+
+	// Cache the profile data, which also records the seek index.
+	if (parser->cached < PROFILE) {
+		rc = hw_ostc_parser_internal_foreach (parser, NULL, NULL);
+		if (rc != DC_STATUS_SUCCESS)
+			return rc;
+	}
+
+	// Find the last checkpoint before the start of the range.
+	unsigned int lo = 0, hi = parser->nindex;
+	while (lo < hi) {
+		unsigned int mid = lo + (hi - lo) / 2;
+		if (parser->index[mid].state.time * 1000 < begin)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	if (lo == 0)
+		return hw_ostc_parser_internal_foreach (parser, callback, userdata);
+
+	// Resume from the checkpoint, with the final sample configuration.
+	const hw_ostc_checkpoint_t *checkpoint = parser->index + lo - 1;
+	hw_ostc_state_t state = checkpoint->state;
+	memcpy (state.info, parser->profile.info, sizeof (state.info));
+	parser->current_divemode_ccr = checkpoint->ccr;
+
+	return hw_ostc_parser_samples_run (parser, &state, 0, callback, userdata);
+}
+
+/*
+ * The final list of gas mixes is only known once the dive is complete,
+ * because the fixed gas mixes which are disabled and never used are
+ * removed at the end. For a dive that is still being written, the
+ * samples refer to the list with all fixed gas mixes instead.
+ */
+static dc_status_t
+hw_ostc_parser_samples_append (dc_parser_t *abstract, dc_sample_callback_t callback, void *userdata)
+{
+	hw_ostc_parser_t *parser = (hw_ostc_parser_t *) abstract;
+
+	// Cache the header data.
+	dc_status_t rc = hw_ostc_parser_cache (parser);
+	if (rc != DC_STATUS_SUCCESS)
+		return rc;
+
+	if (!parser->live.initialized) {
+		rc = hw_ostc_parser_samples_init (parser, &parser->live, 1);
+		if (rc != DC_STATUS_SUCCESS || !parser->live.initialized)
+			return rc;
+	}
+
+	return hw_ostc_parser_samples_run (parser, &parser->live, 1, callback, userdata);
+}
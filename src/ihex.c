@@ -181,6 +181,99 @@ dc_ihex_file_read (dc_ihex_file_t *file, dc_ihex_entry_t *entry)
 	return DC_STATUS_SUCCESS;
 }
 
+static int
+dc_ihex_segment_add (dc_ihex_segment_t segments[], unsigned int maxsegments, unsigned int *nsegments, unsigned int address, unsigned int length)
+{
+	unsigned int n = *nsegments;
+
+	/* Find the first segment which ends at or after the new record. */
+	unsigned int lo = 0, hi = n;
+	while (lo < hi) {
+		unsigned int mid = lo + (hi - lo) / 2;
+		if (segments[mid].address + segments[mid].length < address)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	/* Merge with all the segments which overlap or touch the new record. */
+	unsigned int begin = address, end = address + length;
+	unsigned int i = lo;
+	while (i < n && segments[i].address <= end) {
+		if (segments[i].address < begin)
+			begin = segments[i].address;
+		if (segments[i].address + segments[i].length > end)
+			end = segments[i].address + segments[i].length;
+		i++;
+	}
+
+	if (i == lo) {
+		/* Insert a new segment. */
+		if (n >= maxsegments)
+			return -1;
+		memmove (segments + lo + 1, segments + lo, (n - lo) * sizeof (dc_ihex_segment_t));
+		n++;
+	} else {
+		/* Remove the merged segments, except the first one. */
+		memmove (segments + lo + 1, segments + i, (n - i) * sizeof (dc_ihex_segment_t));
+		n -= i - lo - 1;
+	}
+
+	segments[lo].address = begin;
+	segments[lo].length = end - begin;
+	*nsegments = n;
+
+	return 0;
+}
+
+dc_status_t
+dc_ihex_file_load (dc_ihex_file_t *file, unsigned char data[], unsigned int size, dc_ihex_segment_t segments[], unsigned int maxsegments, unsigned int *nsegments)
+{
+	dc_status_t rc = DC_STATUS_SUCCESS;
+
+	if (file == NULL || (data == NULL && size) ||
+		(segments == NULL && maxsegments) || nsegments == NULL) {
+		ERROR (file ? file->context : NULL, "Invalid arguments.");
+		return DC_STATUS_INVALIDARGS;
+	}
+
+	*nsegments = 0;
+
+	unsigned int base = 0;
+	dc_ihex_entry_t entry;
+	while ((rc = dc_ihex_file_read (file, &entry)) == DC_STATUS_SUCCESS) {
+		if (entry.type == 0) {
+			/* Data record. */
+			unsigned int address = base + entry.address;
+			if (address > size || entry.length > size - address) {
+				WARNING (file->context, "Ignoring out of range record (0x%08x,%u).", address, entry.length);
+				continue;
+			}
+
+			memcpy (data + address, entry.data, entry.length);
+
+			if (dc_ihex_segment_add (segments, maxsegments, nsegments, address, entry.length) != 0) {
+				ERROR (file->context, "Too many segments.");
+				return DC_STATUS_NOMEMORY;
+			}
+		} else if (entry.type == 1) {
+			/* End of file record. */
+			break;
+		} else if (entry.type == 2) {
+			/* Extended segment address record. */
+			base = array_uint16_be (entry.data) << 4;
+		} else if (entry.type == 4) {
+			/* Extended linear address record. */
+			base = array_uint16_be (entry.data) << 16;
+		}
+	}
+	if (rc != DC_STATUS_SUCCESS && rc != DC_STATUS_DONE) {
+		return rc;
+	}
+
+	return DC_STATUS_SUCCESS;
+}
+
 dc_status_t
 dc_ihex_file_reset (dc_ihex_file_t *file)
 {
@@ -38,12 +38,27 @@ typedef struct dc_ihex_entry_t {
 	unsigned char data[255];
 } dc_ihex_entry_t;
 
+typedef struct dc_ihex_segment_t {
+	unsigned int address;
+	unsigned int length;
+} dc_ihex_segment_t;
+
 dc_status_t
 dc_ihex_file_open (dc_ihex_file_t **file, dc_context_t *context, const char *filename);
 
 dc_status_t
 dc_ihex_file_read (dc_ihex_file_t *file, dc_ihex_entry_t *entry);
 
+/*
+ * Load all data records into a flat memory image, at their absolute
+ * address. Regions without data are left untouched. Records outside the
+ * image are skipped with a warning. The address ranges with data are
+ * returned as a sorted list of contiguous segments, as long as they fit
+ * in the array.
+ */
+dc_status_t
+dc_ihex_file_load (dc_ihex_file_t *file, unsigned char data[], unsigned int size, dc_ihex_segment_t segments[], unsigned int maxsegments, unsigned int *nsegments);
+
 dc_status_t
 dc_ihex_file_reset (dc_ihex_file_t *file);
 
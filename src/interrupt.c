@@ -0,0 +1,250 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2026 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <errno.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOGDI
+#include <windows.h>
+#else
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#endif
+
+#include "interrupt.h"
+#include "platform.h"
+#include "thread.h"
+#include "timer.h"
+
+struct dc_interrupt_t {
+#ifdef _WIN32
+	HANDLE handle;
+#else
+	dc_mutex_t mutex;
+	int set;
+	int fds[2];
+#endif
+};
+
+#ifndef _WIN32
+static const dc_mutex_t mutex_init = DC_MUTEX_INIT;
+
+static int
+dc_interrupt_nonblock (int fd)
+{
+	int flags = fcntl (fd, F_GETFL);
+	if (flags < 0 || fcntl (fd, F_SETFL, flags | O_NONBLOCK) != 0)
+		return -1;
+
+	return fcntl (fd, F_SETFD, FD_CLOEXEC);
+}
+#endif
+
+dc_status_t
+dc_interrupt_new (dc_interrupt_t **out)
+{
+	dc_interrupt_t *interrupt = NULL;
+
+	if (out == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	interrupt = (dc_interrupt_t *) malloc (sizeof (dc_interrupt_t));
+	if (interrupt == NULL)
+		return DC_STATUS_NOMEMORY;
+
+#ifdef _WIN32
+	interrupt->handle = CreateEvent (NULL, TRUE, FALSE, NULL);
+	if (interrupt->handle == NULL) {
+		free (interrupt);
+		return DC_STATUS_IO;
+	}
+#else
+	interrupt->mutex = mutex_init;
+	interrupt->set = 0;
+
+	// A self-pipe, with the read end becoming readable when the event
+	// is set.
+	if (pipe (interrupt->fds) != 0) {
+		free (interrupt);
+		return DC_STATUS_IO;
+	}
+
+	if (dc_interrupt_nonblock (interrupt->fds[0]) != 0 ||
+		dc_interrupt_nonblock (interrupt->fds[1]) != 0) {
+		close (interrupt->fds[0]);
+		close (interrupt->fds[1]);
+		free (interrupt);
+		return DC_STATUS_IO;
+	}
+#endif
+
+	*out = interrupt;
+
+	return DC_STATUS_SUCCESS;
+}
+
+void
+dc_interrupt_free (dc_interrupt_t *interrupt)
+{
+	if (interrupt == NULL)
+		return;
+
+#ifdef _WIN32
+	CloseHandle (interrupt->handle);
+#else
+	close (interrupt->fds[0]);
+	close (interrupt->fds[1]);
+#endif
+
+	free (interrupt);
+}
+
+void
+dc_interrupt_set (dc_interrupt_t *interrupt)
+{
+	if (interrupt == NULL)
+		return;
+
+#ifdef _WIN32
+	SetEvent (interrupt->handle);
+#else
+	dc_mutex_lock (&interrupt->mutex);
+	if (!interrupt->set) {
+		// The pipe is empty, so this can't fail with EAGAIN.
+		const unsigned char byte = 0;
+		while (write (interrupt->fds[1], &byte, 1) < 0 && errno == EINTR)
+			continue;
+		interrupt->set = 1;
+	}
+	dc_mutex_unlock (&interrupt->mutex);
+#endif
+}
+
+void
+dc_interrupt_clear (dc_interrupt_t *interrupt)
+{
+	if (interrupt == NULL)
+		return;
+
+#ifdef _WIN32
+	ResetEvent (interrupt->handle);
+#else
+	dc_mutex_lock (&interrupt->mutex);
+	if (interrupt->set) {
+		unsigned char byte = 0;
+		while (read (interrupt->fds[0], &byte, 1) < 0 && errno == EINTR)
+			continue;
+		interrupt->set = 0;
+	}
+	dc_mutex_unlock (&interrupt->mutex);
+#endif
+}
+
+int
+dc_interrupt_isset (dc_interrupt_t *interrupt)
+{
+	if (interrupt == NULL)
+		return 0;
+
+#ifdef _WIN32
+	return WaitForSingleObject (interrupt->handle, 0) == WAIT_OBJECT_0;
+#else
+	dc_mutex_lock (&interrupt->mutex);
+	int set = interrupt->set;
+	dc_mutex_unlock (&interrupt->mutex);
+
+	return set;
+#endif
+}
+
+#ifdef _WIN32
+void *
+dc_interrupt_handle (dc_interrupt_t *interrupt)
+{
+	if (interrupt == NULL)
+		return NULL;
+
+	return interrupt->handle;
+}
+#else
+int
+dc_interrupt_fd (dc_interrupt_t *interrupt)
+{
+	if (interrupt == NULL)
+		return -1;
+
+	return interrupt->fds[0];
+}
+#endif
+
+dc_status_t
+dc_interrupt_sleep (dc_interrupt_t *interrupt, unsigned int milliseconds)
+{
+	if (interrupt == NULL) {
+		if (dc_platform_sleep (milliseconds) != 0)
+			return DC_STATUS_IO;
+		return DC_STATUS_SUCCESS;
+	}
+
+#ifdef _WIN32
+	DWORD rc = WaitForSingleObject (interrupt->handle, milliseconds);
+	if (rc == WAIT_OBJECT_0)
+		return DC_STATUS_CANCELLED;
+	else if (rc != WAIT_TIMEOUT)
+		return DC_STATUS_IO;
+#else
+	dc_nsecs_t target = dc_clock_now () + (dc_nsecs_t) milliseconds * 1000000;
+
+	while (1) {
+		int timeout = 0;
+		dc_nsecs_t now = dc_clock_now ();
+		if (now < target) {
+			// Calculate the remaining timeout (rounded up).
+			timeout = (target - now + 999999) / 1000000;
+		}
+
+		struct pollfd pfd;
+		pfd.fd = interrupt->fds[0];
+		pfd.events = POLLIN;
+		pfd.revents = 0;
+
+		int rc = poll (&pfd, 1, timeout);
+		if (rc < 0) {
+			if (errno == EINTR)
+				continue; // Retry.
+			return DC_STATUS_IO;
+		} else if (rc == 0) {
+			break; // Timeout.
+		} else {
+			return DC_STATUS_CANCELLED;
+		}
+	}
+#endif
+
+	return DC_STATUS_SUCCESS;
+}
@@ -0,0 +1,79 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2026 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+#ifndef DC_INTERRUPT_H
+#define DC_INTERRUPT_H
+
+#include <libdivecomputer/common.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/*
+ * A cancellation event, that the blocking I/O functions wait on together
+ * with their file descriptor. Once set, it stays set until it's cleared
+ * again. Setting it is safe from any thread.
+ */
+typedef struct dc_interrupt_t dc_interrupt_t;
+
+dc_status_t
+dc_interrupt_new (dc_interrupt_t **interrupt);
+
+void
+dc_interrupt_free (dc_interrupt_t *interrupt);
+
+void
+dc_interrupt_set (dc_interrupt_t *interrupt);
+
+void
+dc_interrupt_clear (dc_interrupt_t *interrupt);
+
+/*
+ * Check whether the event is set. A NULL event is never set.
+ */
+int
+dc_interrupt_isset (dc_interrupt_t *interrupt);
+
+/*
+ * Get the file descriptor that becomes readable when the event is set
+ * (POSIX), or the handle of a manual reset event object (Windows).
+ * Returns -1 or NULL for a NULL event.
+ */
+#ifdef _WIN32
+void *
+dc_interrupt_handle (dc_interrupt_t *interrupt);
+#else
+int
+dc_interrupt_fd (dc_interrupt_t *interrupt);
+#endif
+
+/*
+ * Sleep for the specified number of milliseconds, or until the event is
+ * set. Returns DC_STATUS_CANCELLED if the event is set.
+ */
+dc_status_t
+dc_interrupt_sleep (dc_interrupt_t *interrupt, unsigned int milliseconds);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+#endif /* DC_INTERRUPT_H */
@@ -26,16 +26,49 @@
 #include <libdivecomputer/context.h>
 #include <libdivecomputer/iostream.h>
 
+#include "interrupt.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif /* __cplusplus */
 
 typedef struct dc_iostream_vtable_t dc_iostream_vtable_t;
+typedef struct dc_iostream_request_t dc_iostream_request_t;
+
+/*
+ * Cumulative transfer statistics, maintained by the generic read and
+ * write functions.
+ */
+typedef struct dc_iostream_stats_t {
+	unsigned long long nread;
+	unsigned long long nwritten;
+	unsigned int npackets;
+	unsigned int ntimeouts;
+} dc_iostream_stats_t;
+
+/*
+ * Round-trip time estimator for the adaptive timeouts, using the same
+ * algorithm as the TCP retransmission timer (RFC 6298). All values are
+ * in microseconds. The backoff is the number of consecutive timeouts,
+ * and doubles the timeout each time.
+ */
+typedef struct dc_iostream_rtt_t {
+	unsigned int nsamples;
+	unsigned int srtt;
+	unsigned int rttvar;
+	unsigned int backoff;
+	int timeout;
+} dc_iostream_rtt_t;
 
 struct dc_iostream_t {
 	const dc_iostream_vtable_t *vtable;
 	dc_context_t *context;
 	dc_transport_t transport;
+	dc_iostream_stats_t stats;
+	dc_iostream_rtt_t rtt;
+	unsigned int baudrate;
+	/* Cancellation event of the device, if any. */
+	dc_interrupt_t *interrupt;
 };
 
 struct dc_iostream_vtable_t {
@@ -61,6 +94,12 @@ struct dc_iostream_vtable_t {
 
 	dc_status_t (*write) (dc_iostream_t *iostream, const void *data, size_t size, size_t *actual);
 
+	dc_status_t (*read_async) (dc_iostream_t *iostream, dc_iostream_request_t *request);
+
+	dc_status_t (*write_async) (dc_iostream_t *iostream, dc_iostream_request_t *request);
+
+	dc_status_t (*writev) (dc_iostream_t *iostream, const dc_iovec_t iov[], size_t count, size_t *actual);
+
 	dc_status_t (*ioctl) (dc_iostream_t *iostream, unsigned int request, void *data, size_t size);
 
 	dc_status_t (*flush) (dc_iostream_t *iostream);
@@ -69,9 +108,36 @@ struct dc_iostream_vtable_t {
 
 	dc_status_t (*sleep) (dc_iostream_t *iostream, unsigned int milliseconds);
 
+	dc_status_t (*set_interrupt) (dc_iostream_t *iostream, dc_interrupt_t *interrupt);
+
 	dc_status_t (*close) (dc_iostream_t *iostream);
 };
 
+/*
+ * An asynchronous read or write request. Backends implementing the
+ * read_async or write_async functions take ownership of the request,
+ * transfer the data and store the number of bytes in the actual field,
+ * and finally hand the request back with dc_iostream_request_complete.
+ * That function may be called from any thread, but never before the
+ * read_async or write_async function has returned successfully.
+ */
+struct dc_iostream_request_t {
+	dc_iostream_request_t *next;
+	dc_loop_t *loop;
+	dc_iostream_t *iostream;
+	dc_direction_t direction;
+	unsigned char *data;
+	size_t size;
+	size_t actual;
+	dc_status_t status;
+	unsigned int native;
+	dc_iostream_callback_t callback;
+	void *userdata;
+};
+
+void
+dc_iostream_request_complete (dc_iostream_request_t *request, dc_status_t status);
+
 dc_iostream_t *
 dc_iostream_allocate (dc_context_t *context, const dc_iostream_vtable_t *vtable, dc_transport_t transport);
 
@@ -81,6 +147,49 @@ dc_iostream_deallocate (dc_iostream_t *iostream);
 int
 dc_iostream_isinstance (dc_iostream_t *iostream, const dc_iostream_vtable_t *vtable);
 
+/*
+ * Write several buffers, each one as a separate packet. Transports
+ * without support for vectored writes write the buffers one by one.
+ * The actual number of bytes is the total of all buffers.
+ */
+dc_status_t
+dc_iostream_writev (dc_iostream_t *iostream, const dc_iovec_t iov[], size_t count, size_t *actual);
+
+/*
+ * Attach the cancellation event of a device, or detach it with a NULL
+ * event. Streams that wrap another stream pass it on, such that the
+ * transport at the bottom also stops waiting once it's set.
+ */
+dc_status_t
+dc_iostream_set_interrupt (dc_iostream_t *iostream, dc_interrupt_t *interrupt);
+
+/*
+ * Get the maximum payload (in bytes) of a single packet on a BLE
+ * transport, based on the negotiated MTU. Zero means unknown.
+ */
+size_t
+dc_iostream_ble_payload (dc_iostream_t *iostream);
+
+/*
+ * Get the adaptive timeout (in milliseconds), clamped to the range
+ * [minimum, maximum]. Without any round-trip time samples, the maximum
+ * value is returned.
+ */
+int
+dc_iostream_rtt_timeout (dc_iostream_t *iostream, int minimum, int maximum);
+
+/*
+ * Apply the adaptive timeout, if it differs from the current one.
+ */
+dc_status_t
+dc_iostream_rtt_apply (dc_iostream_t *iostream, int minimum, int maximum);
+
+void
+dc_iostream_rtt_update (dc_iostream_t *iostream, unsigned int rtt);
+
+void
+dc_iostream_rtt_backoff (dc_iostream_t *iostream);
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
@@ -21,14 +21,18 @@
 
 #include <stddef.h>
 #include <stdlib.h>
+#include <string.h>
 #include <assert.h>
 
 #include <libdivecomputer/ioctl.h>
+#include <libdivecomputer/ble.h>
 
 #include "iostream-private.h"
 #include "context-private.h"
 #include "platform.h"
 
+#define ATT_HEADER 3
+
 dc_iostream_t *
 dc_iostream_allocate (dc_context_t *context, const dc_iostream_vtable_t *vtable, dc_transport_t transport)
 {
@@ -38,7 +42,7 @@ dc_iostream_allocate (dc_context_t *context, const dc_iostream_vtable_t *vtable,
 	assert(vtable->size >= sizeof(dc_iostream_t));
 
 	// Allocate memory.
-	iostream = (dc_iostream_t *) malloc (vtable->size);
+	iostream = (dc_iostream_t *) dc_context_malloc (context, vtable->size);
 	if (iostream == NULL) {
 		ERROR (context, "Failed to allocate memory.");
 		return iostream;
@@ -48,6 +52,10 @@ dc_iostream_allocate (dc_context_t *context, const dc_iostream_vtable_t *vtable,
 	iostream->vtable = vtable;
 	iostream->context = context;
 	iostream->transport = transport;
+	memset (&iostream->stats, 0, sizeof (iostream->stats));
+	memset (&iostream->rtt, 0, sizeof (iostream->rtt));
+	iostream->baudrate = 0;
+	iostream->interrupt = NULL;
 
 	return iostream;
 }
@@ -55,7 +63,10 @@ dc_iostream_allocate (dc_context_t *context, const dc_iostream_vtable_t *vtable,
 void
 dc_iostream_deallocate (dc_iostream_t *iostream)
 {
-	free (iostream);
+	if (iostream == NULL)
+		return;
+
+	dc_context_release (iostream->context, iostream);
 }
 
 int
@@ -76,6 +87,75 @@ dc_iostream_get_transport (dc_iostream_t *iostream)
 	return iostream->transport;
 }
 
+int
+dc_iostream_rtt_timeout (dc_iostream_t *iostream, int minimum, int maximum)
+{
+	if (iostream == NULL || iostream->rtt.nsamples == 0)
+		return maximum;
+
+	// RTO = SRTT + 4 * RTTVAR, rounded up to milliseconds.
+	unsigned long long rto = iostream->rtt.srtt + 4ULL * iostream->rtt.rttvar;
+	rto = (rto + 999) / 1000;
+
+	// Exponential backoff after a timeout.
+	rto <<= iostream->rtt.backoff;
+
+	if (rto < (unsigned long long) minimum)
+		return minimum;
+	if (rto > (unsigned long long) maximum)
+		return maximum;
+
+	return (int) rto;
+}
+
+dc_status_t
+dc_iostream_rtt_apply (dc_iostream_t *iostream, int minimum, int maximum)
+{
+	if (iostream == NULL)
+		return DC_STATUS_SUCCESS;
+
+	int timeout = dc_iostream_rtt_timeout (iostream, minimum, maximum);
+	if (timeout == iostream->rtt.timeout)
+		return DC_STATUS_SUCCESS;
+
+	return dc_iostream_set_timeout (iostream, timeout);
+}
+
+void
+dc_iostream_rtt_update (dc_iostream_t *iostream, unsigned int rtt)
+{
+	if (iostream == NULL)
+		return;
+
+	dc_iostream_rtt_t *estimator = &iostream->rtt;
+
+	if (estimator->nsamples == 0) {
+		estimator->srtt = rtt;
+		estimator->rttvar = rtt / 2;
+	} else {
+		// RTTVAR = 3/4 * RTTVAR + 1/4 * |SRTT - R|
+		// SRTT = 7/8 * SRTT + 1/8 * R
+		unsigned int delta = estimator->srtt > rtt ?
+			estimator->srtt - rtt : rtt - estimator->srtt;
+		estimator->rttvar = estimator->rttvar - estimator->rttvar / 4 + delta / 4;
+		estimator->srtt = estimator->srtt - estimator->srtt / 8 + rtt / 8;
+	}
+
+	estimator->nsamples++;
+	estimator->backoff = 0;
+}
+
+void
+dc_iostream_rtt_backoff (dc_iostream_t *iostream)
+{
+	if (iostream == NULL)
+		return;
+
+	// Limit the backoff, the timeout is clamped to the maximum anyway.
+	if (iostream->rtt.backoff < 16)
+		iostream->rtt.backoff++;
+}
+
 dc_status_t
 dc_iostream_set_timeout (dc_iostream_t *iostream, int timeout)
 {
@@ -84,7 +164,11 @@ dc_iostream_set_timeout (dc_iostream_t *iostream, int timeout)
 
 	INFO (iostream->context, "Timeout: value=%i", timeout);
 
-	return iostream->vtable->set_timeout (iostream, timeout);
+	dc_status_t status = iostream->vtable->set_timeout (iostream, timeout);
+	if (status == DC_STATUS_SUCCESS)
+		iostream->rtt.timeout = timeout;
+
+	return status;
 }
 
 dc_status_t
@@ -171,7 +255,11 @@ dc_iostream_configure (dc_iostream_t *iostream, unsigned int baudrate, unsigned
 	INFO (iostream->context, "Configure: baudrate=%i, databits=%i, parity=%i, stopbits=%i, flowcontrol=%i",
 		baudrate, databits, parity, stopbits, flowcontrol);
 
-	return iostream->vtable->configure (iostream, baudrate, databits, parity, stopbits, flowcontrol);
+	dc_status_t status = iostream->vtable->configure (iostream, baudrate, databits, parity, stopbits, flowcontrol);
+	if (status == DC_STATUS_SUCCESS)
+		iostream->baudrate = baudrate;
+
+	return status;
 }
 
 dc_status_t
@@ -198,9 +286,17 @@ dc_iostream_read (dc_iostream_t *iostream, void *data, size_t size, size_t *actu
 		dc_status_t status;
 		size_t nbytes = 0;
 
+		SPAN_BEGIN (iostream->context, "iostream.read");
 		status = iostream->vtable->read (iostream, data, size, &nbytes);
+		SPAN_END (iostream->context, "iostream.read", nbytes);
 		HEXDUMP (iostream->context, DC_LOGLEVEL_INFO, "Read", (unsigned char *) data, nbytes);
 
+		iostream->stats.nread += nbytes;
+		if (nbytes)
+			iostream->stats.npackets++;
+		if (status == DC_STATUS_TIMEOUT)
+			iostream->stats.ntimeouts++;
+
 		/*
 		 * If the reader is able to handle partial results,
 		 * return them as such. NOTE! No need to add up a
@@ -249,9 +345,17 @@ dc_iostream_write (dc_iostream_t *iostream, const void *data, size_t size, size_
 		dc_status_t status;
 		size_t nbytes = 0;
 
+		SPAN_BEGIN (iostream->context, "iostream.write");
 		status = iostream->vtable->write (iostream, data, size, &nbytes);
+		SPAN_END (iostream->context, "iostream.write", nbytes);
 		HEXDUMP (iostream->context, DC_LOGLEVEL_INFO, "Write", (const unsigned char *) data, nbytes);
 
+		iostream->stats.nwritten += nbytes;
+		if (nbytes)
+			iostream->stats.npackets++;
+		if (status == DC_STATUS_TIMEOUT)
+			iostream->stats.ntimeouts++;
+
 		if (actual) {
 			*actual = nbytes;
 			return status;
@@ -270,6 +374,61 @@ dc_iostream_write (dc_iostream_t *iostream, const void *data, size_t size, size_
 	return DC_STATUS_SUCCESS;
 }
 
+dc_status_t
+dc_iostream_writev (dc_iostream_t *iostream, const dc_iovec_t iov[], size_t count, size_t *actual)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	size_t nbytes = 0;
+
+	if (iostream == NULL || iostream->vtable->writev == NULL) {
+		for (size_t i = 0; i < count; ++i) {
+			status = dc_iostream_write (iostream, iov[i].data, iov[i].size, NULL);
+			if (status != DC_STATUS_SUCCESS)
+				break;
+
+			nbytes += iov[i].size;
+		}
+	} else {
+		SPAN_BEGIN (iostream->context, "iostream.write");
+		status = iostream->vtable->writev (iostream, iov, count, &nbytes);
+		SPAN_END (iostream->context, "iostream.write", nbytes);
+
+		// Dump the packets that were written.
+		size_t remaining = nbytes;
+		for (size_t i = 0; i < count && remaining; ++i) {
+			size_t n = iov[i].size < remaining ? iov[i].size : remaining;
+			HEXDUMP (iostream->context, DC_LOGLEVEL_INFO, "Write", (const unsigned char *) iov[i].data, n);
+			iostream->stats.npackets++;
+			remaining -= n;
+		}
+
+		iostream->stats.nwritten += nbytes;
+		if (status == DC_STATUS_TIMEOUT)
+			iostream->stats.ntimeouts++;
+	}
+
+	if (actual)
+		*actual = nbytes;
+
+	return status;
+}
+
+size_t
+dc_iostream_ble_payload (dc_iostream_t *iostream)
+{
+	unsigned int mtu = 0;
+
+	if (iostream == NULL || iostream->transport != DC_TRANSPORT_BLE)
+		return 0;
+
+	// The ATT header takes three bytes of each packet.
+	dc_status_t status = dc_iostream_ioctl (iostream, DC_IOCTL_BLE_GET_MTU, &mtu, sizeof(mtu));
+	if (status != DC_STATUS_SUCCESS || mtu <= ATT_HEADER)
+		return 0;
+
+	return mtu - ATT_HEADER;
+}
+
 dc_status_t
 dc_iostream_ioctl (dc_iostream_t *iostream, unsigned int request, void *data, size_t size)
 {
@@ -337,6 +496,20 @@ dc_iostream_sleep (dc_iostream_t *iostream, unsigned int milliseconds)
 	return iostream->vtable->sleep (iostream, milliseconds);
 }
 
+dc_status_t
+dc_iostream_set_interrupt (dc_iostream_t *iostream, dc_interrupt_t *interrupt)
+{
+	if (iostream == NULL)
+		return DC_STATUS_SUCCESS;
+
+	iostream->interrupt = interrupt;
+
+	if (iostream->vtable->set_interrupt == NULL)
+		return DC_STATUS_SUCCESS;
+
+	return iostream->vtable->set_interrupt (iostream, interrupt);
+}
+
 dc_status_t
 dc_iostream_close (dc_iostream_t *iostream)
 {
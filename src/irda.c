@@ -98,10 +98,14 @@ static const dc_iostream_vtable_t dc_irda_vtable = {
 	dc_socket_poll, /* poll */
 	dc_socket_read, /* read */
 	dc_socket_write, /* write */
+	dc_socket_read_async, /* read_async */
+	dc_socket_write_async, /* write_async */
+	NULL, /* writev */
 	dc_socket_ioctl, /* ioctl */
 	NULL, /* flush */
 	NULL, /* purge */
 	dc_socket_sleep, /* sleep */
+	NULL, /* set_interrupt */
 	dc_socket_close, /* close */
 };
 #endif
@@ -74,6 +74,39 @@ dc_iterator_next (dc_iterator_t *iterator, void *item)
 	return iterator->vtable->next (iterator, item);
 }
 
+dc_status_t
+dc_iterator_next_n (dc_iterator_t *iterator, void *items[], size_t size, size_t *count)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	size_t n = 0;
+
+	if (count)
+		*count = 0;
+
+	if (iterator == NULL || iterator->vtable->next == NULL)
+		return DC_STATUS_UNSUPPORTED;
+
+	if (items == NULL || size == 0)
+		return DC_STATUS_INVALIDARGS;
+
+	while (n < size) {
+		status = iterator->vtable->next (iterator, items + n);
+		if (status != DC_STATUS_SUCCESS)
+			break;
+		n++;
+	}
+
+	if (count)
+		*count = n;
+
+	// A partial batch is still a success, the end of the iteration is
+	// only reported once no items are left.
+	if (status == DC_STATUS_DONE && n)
+		return DC_STATUS_SUCCESS;
+
+	return status;
+}
+
 dc_status_t
 dc_iterator_free (dc_iterator_t *iterator)
 {
@@ -73,6 +73,7 @@
 #define RB_PROFILE_END           (500 * PAGESIZE)
 #define RB_PROFILE_SIZE          (RB_PROFILE_END - RB_PROFILE_BEGIN)
 #define RB_PROFILE_DISTANCE(a,b) ringbuffer_distance (a, b, 1, RB_PROFILE_BEGIN, RB_PROFILE_END)
+#define RB_PROFILE_READAHEAD_MIN (8 * PAGESIZE)
 
 #define SZ_HEADER_XEN   80
 #define SZ_HEADER_OTHER 96
@@ -97,9 +98,11 @@ static const dc_device_vtable_t liquivision_lynx_device_vtable = {
 	DC_FAMILY_LIQUIVISION_LYNX,
 	liquivision_lynx_device_set_fingerprint, /* set_fingerprint */
 	liquivision_lynx_device_read, /* read */
+	NULL, /* read_range */
 	NULL, /* write */
 	liquivision_lynx_device_dump, /* dump */
 	liquivision_lynx_device_foreach, /* foreach */
+	NULL, /* foreach_header */
 	NULL, /* timesync */
 	liquivision_lynx_device_close /* close */
 };
@@ -197,6 +200,27 @@ liquivision_lynx_packet (liquivision_lynx_device_t *device, const unsigned char
 	return DC_STATUS_SUCCESS;
 }
 
+static void
+liquivision_lynx_command_read (unsigned char command[MAXPACKET], unsigned int address)
+{
+	// Get the page and segment number.
+	unsigned int page    = (address / PAGESIZE);
+	unsigned int segment = (address % PAGESIZE) / SEGMENTSIZE;
+
+	command[0] = 0x50;
+	command[1] = 0x41;
+	command[2] = 0x47;
+	command[3] = 0x45;
+	command[4] = '0' + ((page / 100) % 10);
+	command[5] = '0' + ((page /  10) % 10);
+	command[6] = '0' + ((page /   1) % 10);
+	command[7] = '0' + ((page / 100) % 10);
+	command[8] = '0' + ((page /  10) % 10);
+	command[9] = '0' + ((page /   1) % 10);
+	command[10] = '0' + segment;
+	command[11] = '0' + segment;
+}
+
 static dc_status_t
 liquivision_lynx_transfer (liquivision_lynx_device_t *device, const unsigned char command[], unsigned int csize, unsigned char answer[], unsigned int asize)
 {
@@ -210,6 +234,8 @@ liquivision_lynx_transfer (liquivision_lynx_device_t *device, const unsigned cha
 		if (nretries++ >= MAXRETRIES)
 			return rc;
 
+		device_stats_retry ((dc_device_t *) device);
+
 		// Delay the next attempt.
 		dc_iostream_sleep (device->iostream, 100);
 		dc_iostream_purge (device->iostream, DC_DIRECTION_INPUT);
@@ -328,36 +354,55 @@ liquivision_lynx_device_read (dc_device_t *abstract, unsigned int address, unsig
 		(size    % SEGMENTSIZE != 0))
 		return DC_STATUS_INVALIDARGS;
 
-	// Get the page and segment number.
-	unsigned int page    = (address / PAGESIZE);
-	unsigned int segment = (address % PAGESIZE) / SEGMENTSIZE;
-
 	unsigned int nbytes = 0;
+	unsigned int pending = 0;
 	while (nbytes < size) {
-		const unsigned char command[] = {
-			0x50, 0x41, 0x47, 0x45,
-			'0' + ((page / 100) % 10),
-			'0' + ((page /  10) % 10),
-			'0' + ((page /   1) % 10),
-			'0' + ((page / 100) % 10),
-			'0' + ((page /  10) % 10),
-			'0' + ((page /   1) % 10),
-			'0' + segment,
-			'0' + segment
-		};
-
-		status = liquivision_lynx_transfer (device, command, sizeof(command), data + nbytes, SEGMENTSIZE);
+		unsigned char command[MAXPACKET] = {0};
+		liquivision_lynx_command_read (command, address + nbytes);
+
+		// Send the command for the current segment, unless it was
+		// already sent together with the previous one.
+		if (!pending) {
+			status = liquivision_lynx_packet (device, command, sizeof(command), NULL, 0);
+			if (status != DC_STATUS_SUCCESS) {
+				return status;
+			}
+		}
+
+		// Send the command for the next segment already, such that the
+		// device doesn't have to wait for the round-trip.
+		pending = 0;
+		if (nbytes + SEGMENTSIZE < size) {
+			unsigned char next[MAXPACKET] = {0};
+			liquivision_lynx_command_read (next, address + nbytes + SEGMENTSIZE);
+			status = liquivision_lynx_packet (device, next, sizeof(next), NULL, 0);
+			if (status != DC_STATUS_SUCCESS) {
+				return status;
+			}
+			pending = 1;
+		}
+
+		status = liquivision_lynx_recv (device, data + nbytes, SEGMENTSIZE);
 		if (status != DC_STATUS_SUCCESS) {
-			ERROR (abstract->context, "Failed to read page %u segment %u.", page, segment);
-			return status;
+			if (status != DC_STATUS_TIMEOUT && status != DC_STATUS_PROTOCOL)
+				return status;
+
+			// Discard the answer to the pending command, and fall back to
+			// the regular transfer, with retries, for the current segment.
+			device_stats_retry (abstract);
+			dc_iostream_sleep (device->iostream, 100);
+			dc_iostream_purge (device->iostream, DC_DIRECTION_INPUT);
+			pending = 0;
+
+			status = liquivision_lynx_transfer (device, command, sizeof(command), data + nbytes, SEGMENTSIZE);
+			if (status != DC_STATUS_SUCCESS) {
+				ERROR (abstract->context, "Failed to read page %u segment %u.",
+					(address + nbytes) / PAGESIZE, ((address + nbytes) % PAGESIZE) / SEGMENTSIZE);
+				return status;
+			}
 		}
 
 		nbytes += SEGMENTSIZE;
-		segment++;
-		if (segment == (PAGESIZE / SEGMENTSIZE)) {
-			segment = 0;
-			page++;
-		}
 	}
 
 	return DC_STATUS_SUCCESS;
@@ -383,7 +428,7 @@ liquivision_lynx_device_dump (dc_device_t *abstract, dc_buffer_t *buffer)
 
 	// Download the memory dump.
 	return device_dump_read (abstract, 0, dc_buffer_get_data (buffer),
-		dc_buffer_get_size (buffer), SEGMENTSIZE);
+		dc_buffer_get_size (buffer), PAGESIZE);
 }
 
 static dc_status_t
@@ -606,6 +651,17 @@ liquivision_lynx_device_foreach (dc_device_t *abstract, dc_dive_callback_t callb
 		goto error_free_profile;
 	}
 
+	// Read a full page at once, to pipeline the segment requests. The
+	// last read can overshoot the oldest dive by up to a page, so this
+	// is only worth it for larger downloads.
+	if (rb_profile_size >= RB_PROFILE_READAHEAD_MIN) {
+		status = dc_rbstream_set_readahead (rbprofile, PAGESIZE / SEGMENTSIZE);
+		if (status != DC_STATUS_SUCCESS) {
+			ERROR (abstract->context, "Failed to set the read-ahead.");
+			goto error_free_rbprofile;
+		}
+	}
+
 	// Traverse the logbook ringbuffer backwards to retrieve the most recent
 	// dives first. The logbook ringbuffer is linearized at this point, so
 	// we do not have to take into account any memory wrapping near the end
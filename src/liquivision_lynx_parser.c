@@ -120,6 +120,7 @@ struct liquivision_lynx_parser_t {
 static dc_status_t liquivision_lynx_parser_get_datetime (dc_parser_t *abstract, dc_datetime_t *datetime);
 static dc_status_t liquivision_lynx_parser_get_field (dc_parser_t *abstract, dc_field_type_t type, unsigned int flags, void *value);
 static dc_status_t liquivision_lynx_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_t callback, void *userdata);
+static dc_status_t liquivision_lynx_parser_reset (dc_parser_t *abstract);
 
 static const dc_parser_vtable_t liquivision_lynx_parser_vtable = {
 	sizeof(liquivision_lynx_parser_t),
@@ -129,7 +130,13 @@ static const dc_parser_vtable_t liquivision_lynx_parser_vtable = {
 	NULL, /* set_density */
 	liquivision_lynx_parser_get_datetime, /* datetime */
 	liquivision_lynx_parser_get_field, /* fields */
+	NULL, /* summary */
 	liquivision_lynx_parser_samples_foreach, /* samples_foreach */
+	NULL, /* samples_batch */
+	NULL, /* samples_fixed */
+	NULL, /* samples_append */
+	NULL, /* samples_range */
+	liquivision_lynx_parser_reset, /* reset */
 	NULL /* destroy */
 };
 
@@ -152,6 +159,19 @@ liquivision_lynx_parser_create (dc_parser_t **out, dc_context_t *context, const
 	// Set the default values.
 	parser->model = model;
 	parser->headersize = (model == XEN) ? SZ_HEADER_XEN : SZ_HEADER_OTHER;
+	liquivision_lynx_parser_reset ((dc_parser_t *) parser);
+
+	*out = (dc_parser_t *) parser;
+
+	return DC_STATUS_SUCCESS;
+}
+
+
+static dc_status_t
+liquivision_lynx_parser_reset (dc_parser_t *abstract)
+{
+	liquivision_lynx_parser_t *parser = (liquivision_lynx_parser_t *) abstract;
+
 	parser->cached = 0;
 	parser->ngasmixes = 0;
 	parser->ntanks = 0;
@@ -165,8 +185,6 @@ liquivision_lynx_parser_create (dc_parser_t **out, dc_context_t *context, const
 		parser->tank[i].endpressure = 0;
 	}
 
-	*out = (dc_parser_t *) parser;
-
 	return DC_STATUS_SUCCESS;
 }
 
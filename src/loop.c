@@ -0,0 +1,430 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2026 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+
+#include "iostream-private.h"
+#include "context-private.h"
+#include "platform.h"
+#include "thread.h"
+#include "timer.h"
+
+// Maximum time (in milliseconds) to wait before checking the
+// emulated requests again.
+#define INTERVAL 10
+
+struct dc_loop_t {
+	dc_context_t *context;
+	dc_timer_t *timer;
+	/* Requests serviced by the loop itself. Only accessed from the
+	 * thread running the loop. */
+	dc_iostream_request_t *pending;
+	/* Finished requests, and the number of requests in progress in a
+	 * backend. Protected by the mutex, because backends can complete
+	 * their requests from another thread. */
+	dc_mutex_t mutex;
+	dc_cond_t *cond;
+	dc_iostream_request_t *completed;
+	dc_iostream_request_t **tail;
+	unsigned int nactive;
+};
+
+static const dc_mutex_t mutex_init = DC_MUTEX_INIT;
+
+dc_status_t
+dc_loop_new (dc_loop_t **out, dc_context_t *context)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	dc_loop_t *loop = NULL;
+
+	if (out == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	loop = (dc_loop_t *) malloc (sizeof (dc_loop_t));
+	if (loop == NULL) {
+		ERROR (context, "Failed to allocate memory.");
+		return DC_STATUS_NOMEMORY;
+	}
+
+	loop->context = context;
+	loop->timer = NULL;
+	loop->pending = NULL;
+	loop->mutex = mutex_init;
+	loop->cond = NULL;
+	loop->completed = NULL;
+	loop->tail = &loop->completed;
+	loop->nactive = 0;
+
+	status = dc_timer_new (&loop->timer);
+	if (status != DC_STATUS_SUCCESS) {
+		ERROR (context, "Failed to create a high resolution timer.");
+		goto error_free;
+	}
+
+	// Without thread support, backends can only complete their requests
+	// synchronously, and there is nothing to wait for.
+	status = dc_cond_new (&loop->cond);
+	if (status != DC_STATUS_SUCCESS && status != DC_STATUS_UNSUPPORTED) {
+		ERROR (context, "Failed to create a condition variable.");
+		goto error_timer_free;
+	}
+
+	*out = loop;
+
+	return DC_STATUS_SUCCESS;
+
+error_timer_free:
+	dc_timer_free (loop->timer);
+error_free:
+	free (loop);
+	return status;
+}
+
+void
+dc_iostream_request_complete (dc_iostream_request_t *request, dc_status_t status)
+{
+	dc_loop_t *loop = request->loop;
+
+	request->status = status;
+	request->next = NULL;
+
+	dc_mutex_lock (&loop->mutex);
+	*loop->tail = request;
+	loop->tail = &request->next;
+	if (request->native)
+		loop->nactive--;
+	if (loop->cond)
+		dc_cond_signal (loop->cond);
+	dc_mutex_unlock (&loop->mutex);
+}
+
+static unsigned int
+dc_loop_dispatch (dc_loop_t *loop)
+{
+	unsigned int count = 0;
+
+	dc_mutex_lock (&loop->mutex);
+	dc_iostream_request_t *request = loop->completed;
+	loop->completed = NULL;
+	loop->tail = &loop->completed;
+	dc_mutex_unlock (&loop->mutex);
+
+	while (request) {
+		dc_iostream_request_t *next = request->next;
+
+		// The I/O stream of a cancelled request may already be closed.
+		if (request->native && request->status != DC_STATUS_CANCELLED) {
+			dc_iostream_stats_t *stats = &request->iostream->stats;
+
+			HEXDUMP (loop->context, DC_LOGLEVEL_INFO,
+				request->direction == DC_DIRECTION_INPUT ? "Read" : "Write",
+				request->data, request->actual);
+
+			if (request->direction == DC_DIRECTION_INPUT)
+				stats->nread += request->actual;
+			else
+				stats->nwritten += request->actual;
+			if (request->actual)
+				stats->npackets++;
+			if (request->status == DC_STATUS_TIMEOUT)
+				stats->ntimeouts++;
+		}
+
+		request->callback (request->iostream, request->status, request->actual, request->userdata);
+		free (request);
+
+		request = next;
+		count++;
+	}
+
+	return count;
+}
+
+/*
+ * Check whether an earlier request in the pending list is for the same
+ * I/O stream and direction. Only the oldest one can make progress.
+ */
+static int
+dc_loop_blocked (dc_loop_t *loop, dc_iostream_request_t *request)
+{
+	for (dc_iostream_request_t *r = loop->pending; r != request; r = r->next) {
+		if (r->iostream == request->iostream && r->direction == request->direction)
+			return 1;
+	}
+
+	return 0;
+}
+
+/*
+ * Service a request of a backend without asynchronous support. Returns
+ * non-zero once the request is finished.
+ */
+static int
+dc_loop_service (dc_iostream_request_t *request, int timeout)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	dc_iostream_t *iostream = request->iostream;
+	size_t nbytes = 0;
+
+	if (request->direction == DC_DIRECTION_OUTPUT) {
+		status = dc_iostream_write (iostream, request->data + request->actual, request->size - request->actual, &nbytes);
+		request->actual += nbytes;
+		request->status = status;
+		return status != DC_STATUS_SUCCESS || nbytes == 0 || request->actual == request->size;
+	}
+
+	// Wait for some data to arrive. Backends without poll support are
+	// always considered ready.
+	status = dc_iostream_poll (iostream, timeout);
+	if (status == DC_STATUS_TIMEOUT) {
+		return 0;
+	} else if (status != DC_STATUS_SUCCESS && status != DC_STATUS_UNSUPPORTED) {
+		request->status = status;
+		return 1;
+	}
+
+	// Read only what is already available, if the backend knows.
+	size_t available = 0;
+	size_t length = request->size - request->actual;
+	if (dc_iostream_get_available (iostream, &available) == DC_STATUS_SUCCESS &&
+		available > 0 && available < length) {
+		length = available;
+	}
+
+	status = dc_iostream_read (iostream, request->data + request->actual, length, &nbytes);
+	request->actual += nbytes;
+	request->status = status;
+
+	// A short read without an error marks the end of a packet.
+	return status != DC_STATUS_SUCCESS || nbytes < length || request->actual == request->size;
+}
+
+dc_status_t
+dc_loop_run (dc_loop_t *loop, int timeout)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	dc_usecs_t start = 0, now = 0;
+
+	if (loop == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	if (timeout > 0) {
+		status = dc_timer_now (loop->timer, &start);
+		if (status != DC_STATUS_SUCCESS)
+			return status;
+	}
+
+	while (1) {
+		unsigned int progress = dc_loop_dispatch (loop);
+
+		// Service the emulated requests.
+		unsigned int npending = 0;
+		for (dc_iostream_request_t *r = loop->pending; r; r = r->next)
+			npending++;
+
+		dc_mutex_lock (&loop->mutex);
+		unsigned int nactive = loop->nactive;
+		unsigned int ncompleted = loop->completed != NULL;
+		dc_mutex_unlock (&loop->mutex);
+
+		if (npending == 0 && nactive == 0 && ncompleted == 0)
+			return DC_STATUS_SUCCESS;
+
+		// Get the remaining time.
+		int remaining = timeout;
+		if (timeout > 0) {
+			status = dc_timer_now (loop->timer, &now);
+			if (status != DC_STATUS_SUCCESS)
+				return status;
+
+			dc_usecs_t elapsed = (now - start) / 1000;
+			remaining = elapsed >= (dc_usecs_t) timeout ? 0 : timeout - (int) elapsed;
+		}
+
+		// A single stream can simply block in its poll function. With
+		// more, each one is only checked, and the loop waits in between.
+		int wait = (npending == 1 && nactive == 0 && ncompleted == 0) ? remaining : 0;
+
+		dc_iostream_request_t **link = &loop->pending;
+		while (*link) {
+			dc_iostream_request_t *request = *link;
+			if (!dc_loop_blocked (loop, request) && dc_loop_service (request, wait)) {
+				*link = request->next;
+				dc_iostream_request_complete (request, request->status);
+				progress++;
+			} else {
+				link = &request->next;
+			}
+		}
+
+		if (progress)
+			continue;
+
+		if (remaining == 0)
+			break;
+
+		unsigned int interval = (remaining < 0 || remaining > INTERVAL) ? INTERVAL : remaining;
+		if (npending && wait)
+			continue;
+
+		dc_mutex_lock (&loop->mutex);
+		if (loop->completed == NULL) {
+			if (loop->cond) {
+				if (npending)
+					dc_cond_timedwait (loop->cond, &loop->mutex, interval);
+				else if (remaining < 0)
+					dc_cond_wait (loop->cond, &loop->mutex);
+				else
+					dc_cond_timedwait (loop->cond, &loop->mutex, remaining);
+			} else {
+				dc_mutex_unlock (&loop->mutex);
+				dc_platform_sleep (interval);
+				dc_mutex_lock (&loop->mutex);
+			}
+		}
+		dc_mutex_unlock (&loop->mutex);
+	}
+
+	return DC_STATUS_TIMEOUT;
+}
+
+dc_status_t
+dc_loop_free (dc_loop_t *loop)
+{
+	if (loop == NULL)
+		return DC_STATUS_SUCCESS;
+
+	// Cancel the emulated requests.
+	while (loop->pending) {
+		dc_iostream_request_t *request = loop->pending;
+		loop->pending = request->next;
+		dc_iostream_request_complete (request, DC_STATUS_CANCELLED);
+	}
+
+	dc_loop_dispatch (loop);
+
+	dc_mutex_lock (&loop->mutex);
+	unsigned int nactive = loop->nactive;
+	dc_mutex_unlock (&loop->mutex);
+
+	if (nactive) {
+		ERROR (loop->context, "Event loop still has %u outstanding requests.", nactive);
+		return DC_STATUS_INVALIDARGS;
+	}
+
+	dc_cond_free (loop->cond);
+	dc_timer_free (loop->timer);
+	free (loop);
+
+	return DC_STATUS_SUCCESS;
+}
+
+static dc_status_t
+dc_iostream_submit (dc_iostream_t *iostream, dc_loop_t *loop, dc_direction_t direction, void *data, size_t size, dc_iostream_callback_t callback, void *userdata)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	dc_iostream_request_t *request = NULL;
+
+	if (iostream == NULL || loop == NULL || callback == NULL || (data == NULL && size))
+		return DC_STATUS_INVALIDARGS;
+
+	request = (dc_iostream_request_t *) malloc (sizeof (dc_iostream_request_t));
+	if (request == NULL) {
+		ERROR (iostream->context, "Failed to allocate memory.");
+		return DC_STATUS_NOMEMORY;
+	}
+
+	request->next = NULL;
+	request->loop = loop;
+	request->iostream = iostream;
+	request->direction = direction;
+	request->data = (unsigned char *) data;
+	request->size = size;
+	request->actual = 0;
+	request->status = DC_STATUS_SUCCESS;
+	request->native = 0;
+	request->callback = callback;
+	request->userdata = userdata;
+
+	dc_status_t (*submit) (dc_iostream_t *, dc_iostream_request_t *) =
+		direction == DC_DIRECTION_INPUT ?
+		iostream->vtable->read_async :
+		iostream->vtable->write_async;
+
+	// Requests for backends without native support are queued for the
+	// event loop.
+	if (submit == NULL || size == 0) {
+		if (size == 0) {
+			dc_iostream_request_complete (request, DC_STATUS_SUCCESS);
+		} else {
+			dc_iostream_request_t **link = &loop->pending;
+			while (*link)
+				link = &(*link)->next;
+			*link = request;
+		}
+		return DC_STATUS_SUCCESS;
+	}
+
+	request->native = 1;
+
+	dc_mutex_lock (&loop->mutex);
+	loop->nactive++;
+	dc_mutex_unlock (&loop->mutex);
+
+	status = submit (iostream, request);
+	if (status != DC_STATUS_SUCCESS) {
+		dc_mutex_lock (&loop->mutex);
+		loop->nactive--;
+		dc_mutex_unlock (&loop->mutex);
+
+		// Backends can only support asynchronous requests on some
+		// platforms, and fall back to the emulation elsewhere.
+		if (status == DC_STATUS_UNSUPPORTED) {
+			request->native = 0;
+			dc_iostream_request_t **link = &loop->pending;
+			while (*link)
+				link = &(*link)->next;
+			*link = request;
+			return DC_STATUS_SUCCESS;
+		}
+
+		free (request);
+		return status;
+	}
+
+	return DC_STATUS_SUCCESS;
+}
+
+dc_status_t
+dc_iostream_read_async (dc_iostream_t *iostream, dc_loop_t *loop, void *data, size_t size, dc_iostream_callback_t callback, void *userdata)
+{
+	return dc_iostream_submit (iostream, loop, DC_DIRECTION_INPUT, data, size, callback, userdata);
+}
+
+dc_status_t
+dc_iostream_write_async (dc_iostream_t *iostream, dc_loop_t *loop, const void *data, size_t size, dc_iostream_callback_t callback, void *userdata)
+{
+	return dc_iostream_submit (iostream, loop, DC_DIRECTION_OUTPUT, (void *) data, size, callback, userdata);
+}
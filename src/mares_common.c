@@ -27,6 +27,7 @@
 #include "mares_common.h"
 #include "checksum.h"
 #include "array.h"
+#include "ringbuffer.h"
 
 #define MAXRETRIES 4
 
@@ -55,6 +56,8 @@ mares_common_device_init (mares_common_device_t *device, dc_iostream_t *iostream
 	device->iostream = iostream;
 	device->echo = 0;
 	device->delay = 0;
+	device->packetsize = PACKETSIZE;
+	device->probed = 0;
 }
 
 
@@ -139,27 +142,64 @@ mares_common_packet (mares_common_device_t *device, const unsigned char command[
 }
 
 
+typedef struct mares_common_transfer_t {
+	const unsigned char *command;
+	unsigned int csize;
+	unsigned char *answer;
+	unsigned int asize;
+} mares_common_transfer_t;
+
+static dc_status_t
+mares_common_attempt (dc_device_t *abstract, unsigned int attempt, void *userdata)
+{
+	mares_common_device_t *device = (mares_common_device_t *) abstract;
+	mares_common_transfer_t *transfer = (mares_common_transfer_t *) userdata;
+
+	return mares_common_packet (device, transfer->command, transfer->csize, transfer->answer, transfer->asize);
+}
+
 static dc_status_t
 mares_common_transfer (mares_common_device_t *device, const unsigned char command[], unsigned int csize, unsigned char answer[], unsigned int asize)
 {
-	unsigned int nretries = 0;
+	// Automatically discard a corrupted packet, and request a new one.
+	// Any garbage bytes are discarded before the next attempt.
+	const device_retry_t policy = {MAXRETRIES, 100, 1, 0, 0};
+	mares_common_transfer_t transfer = {command, csize, answer, asize};
+
+	return device_transfer_retry ((dc_device_t *) device, device->iostream, &policy, mares_common_attempt, &transfer);
+}
+
+
+static dc_status_t
+mares_common_read_packet (mares_common_device_t *device, unsigned int address, unsigned char data[], unsigned int len, unsigned int retry)
+{
 	dc_status_t rc = DC_STATUS_SUCCESS;
-	while ((rc = mares_common_packet (device, command, csize, answer, asize)) != DC_STATUS_SUCCESS) {
-		// Automatically discard a corrupted packet,
-		// and request a new one.
-		if (rc != DC_STATUS_PROTOCOL && rc != DC_STATUS_TIMEOUT)
-			return rc;
 
-		// Abort if the maximum number of retries is reached.
-		if (nretries++ >= MAXRETRIES)
-			return rc;
+	assert (len <= MAXPACKETSIZE);
 
-		// Discard any garbage bytes.
-		dc_iostream_sleep (device->iostream, 100);
-		dc_iostream_purge (device->iostream, DC_DIRECTION_INPUT);
-	}
+	// Build the raw command.
+	unsigned char raw[] = {0x51,
+		(address     ) & 0xFF, // Low
+		(address >> 8) & 0xFF, // High
+		len}; // Count
+
+	// Build the ascii command.
+	unsigned char command[2 * (sizeof (raw) + 2)] = {0};
+	mares_common_make_ascii (raw, sizeof (raw), command, sizeof (command));
 
-	return rc;
+	// Send the command and receive the answer.
+	unsigned char answer[2 * (MAXPACKETSIZE + 2)] = {0};
+	if (retry)
+		rc = mares_common_transfer (device, command, sizeof (command), answer, 2 * (len + 2));
+	else
+		rc = mares_common_packet (device, command, sizeof (command), answer, 2 * (len + 2));
+	if (rc != DC_STATUS_SUCCESS)
+		return rc;
+
+	// Extract the raw data from the packet.
+	array_convert_hex2bin (answer + 1, 2 * len, data, len);
+
+	return DC_STATUS_SUCCESS;
 }
 
 
@@ -172,28 +212,21 @@ mares_common_device_read (dc_device_t *abstract, unsigned int address, unsigned
 	while (nbytes < size) {
 		// Calculate the packet size.
 		unsigned int len = size - nbytes;
-		if (len > PACKETSIZE)
-			len = PACKETSIZE;
-
-		// Build the raw command.
-		unsigned char raw[] = {0x51,
-			(address     ) & 0xFF, // Low
-			(address >> 8) & 0xFF, // High
-			len}; // Count
-
-		// Build the ascii command.
-		unsigned char command[2 * (sizeof (raw) + 2)] = {0};
-		mares_common_make_ascii (raw, sizeof (raw), command, sizeof (command));
-
-		// Send the command and receive the answer.
-		unsigned char answer[2 * (PACKETSIZE + 2)] = {0};
-		dc_status_t rc = mares_common_transfer (device, command, sizeof (command), answer, 2 * (len + 2));
+		if (len > device->packetsize)
+			len = device->packetsize;
+
+		dc_status_t rc = mares_common_read_packet (device, address, data, len, 1);
+		if (rc != DC_STATUS_SUCCESS && rc != DC_STATUS_CANCELLED && len > PACKETSIZE) {
+			// The larger packets are not reliable after all.
+			WARNING (abstract->context, "Falling back to the default packet size.");
+			device->packetsize = PACKETSIZE;
+			dc_iostream_sleep (device->iostream, 100);
+			dc_iostream_purge (device->iostream, DC_DIRECTION_INPUT);
+			continue;
+		}
 		if (rc != DC_STATUS_SUCCESS)
 			return rc;
 
-		// Extract the raw data from the packet.
-		array_convert_hex2bin (answer + 1, 2 * len, data, len);
-
 		nbytes += len;
 		address += len;
 		data += len;
@@ -203,6 +236,179 @@ mares_common_device_read (dc_device_t *abstract, unsigned int address, unsigned
 }
 
 
+/*
+ * Probe for the largest packet size supported by the device. A larger
+ * packet is only used if its data matches a packet with the default
+ * size. A failed probe is not fatal, and leaves the default size.
+ */
+void
+mares_common_device_probe (mares_common_device_t *device)
+{
+	dc_device_t *abstract = (dc_device_t *) device;
+
+	if (device->probed)
+		return;
+
+	device->probed = 1;
+
+	unsigned char reference[PACKETSIZE] = {0};
+	if (mares_common_read_packet (device, 0, reference, sizeof (reference), 1) != DC_STATUS_SUCCESS)
+		return;
+
+	for (unsigned int size = MAXPACKETSIZE; size > PACKETSIZE; size /= 2) {
+		DEBUG (abstract->context, "Probing a packet size of %u bytes.", size);
+
+		unsigned char data[MAXPACKETSIZE] = {0};
+		dc_status_t rc = mares_common_read_packet (device, 0, data, size, 0);
+		if (rc == DC_STATUS_SUCCESS && memcmp (data, reference, sizeof (reference)) == 0) {
+			device->packetsize = size;
+			break;
+		}
+
+		if (rc == DC_STATUS_CANCELLED)
+			break;
+
+		// Discard the remainder of the answer.
+		dc_iostream_sleep (device->iostream, 100);
+		dc_iostream_purge (device->iostream, DC_DIRECTION_INPUT);
+	}
+
+	DEBUG (abstract->context, "Packet size: %u bytes.", device->packetsize);
+}
+
+
+static dc_status_t
+mares_common_read_ring (dc_device_t *abstract, const mares_common_layout_t *layout, unsigned int address, unsigned char data[], unsigned int size, dc_event_progress_t *progress)
+{
+	mares_common_device_t *device = (mares_common_device_t *) abstract;
+
+	while (size) {
+		unsigned int len = layout->rb_profile_end - address;
+		if (len > size)
+			len = size;
+		if (len > device->packetsize)
+			len = device->packetsize;
+
+		dc_status_t rc = mares_common_device_read (abstract, address, data, len);
+		if (rc != DC_STATUS_SUCCESS) {
+			ERROR (abstract->context, "Failed to read the memory.");
+			return rc;
+		}
+
+		address = ringbuffer_increment (address, len, layout->rb_profile_begin, layout->rb_profile_end);
+		data += len;
+		size -= len;
+
+		if (progress) {
+			progress->current += len;
+			device_event_emit (abstract, DC_EVENT_PROGRESS, progress);
+		}
+	}
+
+	return DC_STATUS_SUCCESS;
+}
+
+
+static dc_status_t
+mares_common_read_memory (dc_device_t *abstract, unsigned int address, unsigned char data[], unsigned int size, dc_event_progress_t *progress)
+{
+	// A range outside the profile ringbuffer never wraps.
+	const mares_common_layout_t layout = {0, 0, address + size, 0, 0};
+
+	return mares_common_read_ring (abstract, &layout, address, data + address, size, progress);
+}
+
+
+/*
+ * Incremental memory dump. The memory outside the profile ringbuffer,
+ * which includes the logbook, is always downloaded. From the profile
+ * ringbuffer, only the data between the previous and the current end
+ * of profile pointer is downloaded, and everything else is copied from
+ * the previous dump. Returns DC_STATUS_UNSUPPORTED if the previous dump
+ * can't be used.
+ */
+dc_status_t
+mares_common_device_dump_incremental (dc_device_t *abstract, const mares_common_layout_t *layout, unsigned int eop, unsigned int bigendian, const unsigned char previous[], unsigned char data[])
+{
+	dc_status_t rc = DC_STATUS_SUCCESS;
+
+	unsigned int begin = layout->rb_profile_begin;
+	unsigned int end = layout->rb_profile_end;
+
+	if (eop + 2 > begin || end - begin < PACKETSIZE)
+		return DC_STATUS_UNSUPPORTED;
+
+	// Enable progress notifications. The maximum is increased once the
+	// size of the new profile data is known.
+	dc_event_progress_t progress = EVENT_PROGRESS_INITIALIZER;
+	progress.maximum = begin + (layout->memsize - end);
+	device_event_emit (abstract, DC_EVENT_PROGRESS, &progress);
+
+	// Download everything outside the profile ringbuffer.
+	rc = mares_common_read_memory (abstract, 0, data, begin, &progress);
+	if (rc != DC_STATUS_SUCCESS)
+		return rc;
+
+	rc = mares_common_read_memory (abstract, end, data, layout->memsize - end, &progress);
+	if (rc != DC_STATUS_SUCCESS)
+		return rc;
+
+	if (memcmp (data + 8, previous + 8, 2) != 0) {
+		WARNING (abstract->context, "The previous dump is from a different device.");
+		return DC_STATUS_UNSUPPORTED;
+	}
+
+	unsigned int eop_previous = bigendian ?
+		array_uint16_be (previous + eop) : array_uint16_le (previous + eop);
+	unsigned int eop_current = bigendian ?
+		array_uint16_be (data + eop) : array_uint16_le (data + eop);
+	if (eop_previous < begin || eop_previous >= end ||
+		eop_current < begin || eop_current >= end) {
+		WARNING (abstract->context, "Invalid ringbuffer pointer detected (0x%04x 0x%04x).",
+			eop_previous, eop_current);
+		return DC_STATUS_UNSUPPORTED;
+	}
+
+	unsigned int length = ringbuffer_distance (eop_previous, eop_current, 0, begin, end);
+
+	progress.maximum += PACKETSIZE + length;
+	device_event_emit (abstract, DC_EVENT_PROGRESS, &progress);
+
+	DEBUG (abstract->context, "Incremental dump: %u of %u profile bytes.",
+		length, end - begin);
+
+	// Verify the previous dump with the data preceding its end of
+	// profile pointer.
+	unsigned char check[PACKETSIZE] = {0};
+	unsigned int address = ringbuffer_decrement (eop_previous, sizeof (check), begin, end);
+	rc = mares_common_read_ring (abstract, layout, address, check, sizeof (check), &progress);
+	if (rc != DC_STATUS_SUCCESS)
+		return rc;
+
+	for (unsigned int i = 0; i < sizeof (check); ++i) {
+		unsigned int offset = ringbuffer_increment (address, i, begin, end);
+		if (check[i] != previous[offset]) {
+			WARNING (abstract->context, "The previous dump doesn't match the device.");
+			return DC_STATUS_UNSUPPORTED;
+		}
+	}
+
+	// Take the old profile data from the previous dump, and download
+	// the new data, which may wrap around the end of the ringbuffer.
+	memcpy (data + begin, previous + begin, end - begin);
+
+	unsigned int first = end - eop_previous;
+	if (first > length)
+		first = length;
+
+	rc = mares_common_read_ring (abstract, layout, eop_previous, data + eop_previous, first, &progress);
+	if (rc != DC_STATUS_SUCCESS)
+		return rc;
+
+	return mares_common_read_ring (abstract, layout, begin, data + begin, length - first, &progress);
+}
+
+
 dc_status_t
 mares_common_extract_dives (dc_context_t *context, const mares_common_layout_t *layout, const unsigned char fingerprint[], const unsigned char data[], dc_dive_callback_t callback, void *userdata)
 {
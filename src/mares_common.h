@@ -30,7 +30,8 @@
 extern "C" {
 #endif /* __cplusplus */
 
-#define PACKETSIZE 0x20
+#define PACKETSIZE    0x20
+#define MAXPACKETSIZE 0x80
 
 typedef struct mares_common_layout_t {
 	unsigned int memsize;
@@ -45,6 +46,8 @@ typedef struct mares_common_device_t {
 	dc_iostream_t *iostream;
 	unsigned int echo;
 	unsigned int delay;
+	unsigned int packetsize;
+	unsigned int probed;
 } mares_common_device_t;
 
 void
@@ -53,6 +56,12 @@ mares_common_device_init (mares_common_device_t *device, dc_iostream_t *iostream
 dc_status_t
 mares_common_device_read (dc_device_t *abstract, unsigned int address, unsigned char data[], unsigned int size);
 
+void
+mares_common_device_probe (mares_common_device_t *device);
+
+dc_status_t
+mares_common_device_dump_incremental (dc_device_t *abstract, const mares_common_layout_t *layout, unsigned int eop, unsigned int bigendian, const unsigned char previous[], unsigned char data[]);
+
 dc_status_t
 mares_common_extract_dives (dc_context_t *context, const mares_common_layout_t *layout, const unsigned char fingerprint[], const unsigned char data[], dc_dive_callback_t callback, void *userdata);
 
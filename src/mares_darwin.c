@@ -66,9 +66,11 @@ static const dc_device_vtable_t mares_darwin_device_vtable = {
 	DC_FAMILY_MARES_DARWIN,
 	mares_darwin_device_set_fingerprint, /* set_fingerprint */
 	mares_common_device_read, /* read */
+	NULL, /* read_range */
 	NULL, /* write */
 	mares_darwin_device_dump, /* dump */
 	mares_darwin_device_foreach, /* foreach */
+	NULL, /* foreach_header */
 	NULL, /* timesync */
 	NULL /* close */
 };
@@ -200,9 +202,28 @@ mares_darwin_device_dump (dc_device_t *abstract, dc_buffer_t *buffer)
 		return DC_STATUS_NOMEMORY;
 	}
 
-	// Download the memory dump.
-	status = device_dump_read (abstract, 0, dc_buffer_get_data (buffer),
-		dc_buffer_get_size (buffer), PACKETSIZE);
+	// Use larger packets if the device supports them.
+	mares_common_device_probe (&device->base);
+
+	// Download the memory dump, incrementally if possible.
+	status = DC_STATUS_UNSUPPORTED;
+	const unsigned char *previous = device_dump_previous (abstract, device->layout->memsize);
+	if (previous) {
+		const mares_common_layout_t layout = {
+			device->layout->memsize,
+			device->layout->rb_profile_begin,
+			device->layout->rb_profile_end,
+			device->layout->rb_profile_end,
+			device->layout->rb_profile_end};
+		status = mares_common_device_dump_incremental (abstract, &layout,
+			0x8A, 1, previous, dc_buffer_get_data (buffer));
+		if (status == DC_STATUS_UNSUPPORTED)
+			WARNING (abstract->context, "Falling back to a full memory dump.");
+	}
+	if (status == DC_STATUS_UNSUPPORTED) {
+		status = device_dump_read (abstract, 0, dc_buffer_get_data (buffer),
+			dc_buffer_get_size (buffer), device->base.packetsize);
+	}
 	if (status != DC_STATUS_SUCCESS) {
 		return status;
 	}
@@ -226,7 +247,7 @@ mares_darwin_device_foreach (dc_device_t *abstract, dc_dive_callback_t callback,
 
 	assert (device->layout != NULL);
 
-	dc_buffer_t *buffer = dc_buffer_new (device->layout->memsize);
+	dc_buffer_t *buffer = dc_buffer_new_context (abstract->context, device->layout->memsize);
 	if (buffer == NULL)
 		return DC_STATUS_NOMEMORY;
 
@@ -59,7 +59,13 @@ static const dc_parser_vtable_t mares_darwin_parser_vtable = {
 	NULL, /* set_density */
 	mares_darwin_parser_get_datetime, /* datetime */
 	mares_darwin_parser_get_field, /* fields */
+	NULL, /* summary */
 	mares_darwin_parser_samples_foreach, /* samples_foreach */
+	NULL, /* samples_batch */
+	NULL, /* samples_fixed */
+	NULL, /* samples_append */
+	NULL, /* samples_range */
+	NULL, /* reset */
 	NULL /* destroy */
 };
 
@@ -51,6 +51,8 @@
 
 #define MAXRETRIES 4
 
+#define SZ_HEADER_MAX 0x84
+
 #define ACK 0xAA
 #define EOF 0xEA
 #define XOR 0xA5
@@ -99,6 +101,7 @@ static dc_status_t mares_iconhd_device_set_fingerprint (dc_device_t *abstract, c
 static dc_status_t mares_iconhd_device_read (dc_device_t *abstract, unsigned int address, unsigned char data[], unsigned int size);
 static dc_status_t mares_iconhd_device_dump (dc_device_t *abstract, dc_buffer_t *buffer);
 static dc_status_t mares_iconhd_device_foreach (dc_device_t *abstract, dc_dive_callback_t callback, void *userdata);
+static dc_status_t mares_iconhd_device_foreach_header (dc_device_t *abstract, dc_dive_callback_t callback, void *userdata);
 static dc_status_t mares_iconhd_device_close (dc_device_t *abstract);
 
 static const dc_device_vtable_t mares_iconhd_device_vtable = {
@@ -106,9 +109,11 @@ static const dc_device_vtable_t mares_iconhd_device_vtable = {
 	DC_FAMILY_MARES_ICONHD,
 	mares_iconhd_device_set_fingerprint, /* set_fingerprint */
 	mares_iconhd_device_read, /* read */
+	NULL, /* read_range */
 	NULL, /* write */
 	mares_iconhd_device_dump, /* dump */
 	mares_iconhd_device_foreach, /* foreach */
+	mares_iconhd_device_foreach_header, /* foreach_header */
 	NULL, /* timesync */
 	mares_iconhd_device_close /* close */
 };
@@ -259,6 +264,8 @@ mares_iconhd_transfer (mares_iconhd_device_t *device, unsigned char cmd, const u
 		if (nretries++ >= MAXRETRIES)
 			return rc;
 
+		device_stats_retry ((dc_device_t *) device);
+
 		// Discard any garbage bytes.
 		dc_iostream_sleep (device->iostream, 100);
 		dc_iostream_purge (device->iostream, DC_DIRECTION_INPUT);
@@ -309,6 +316,12 @@ mares_iconhd_read_object(mares_iconhd_device_t *device, dc_event_progress_t *pro
 		// data packets. The first packet contains only the total size
 		// of the payload.
 		size = array_uint32_le (rsp_init + 4);
+
+		// Allocate memory for the entire payload at once.
+		if (!dc_buffer_reserve (buffer, dc_buffer_get_size (buffer) + size)) {
+			ERROR (abstract->context, "Insufficient buffer space available.");
+			return DC_STATUS_NOMEMORY;
+		}
 	} else if (rsp_init[0] == 0x42) {
 		// A short (and fixed size) payload is embedded into the first
 		// data packet.
@@ -704,33 +717,39 @@ mares_iconhd_device_foreach_raw (dc_device_t *abstract, dc_dive_callback_t callb
 		return rc;
 	}
 
-	// Allocate memory for the dives.
-	unsigned char *buffer = (unsigned char *) malloc (layout->rb_profile_end - layout->rb_profile_begin);
+	// Memory buffer for a single dive. Each dive is delivered as soon as it
+	// has been read, so only the largest dive needs to fit in memory.
+	dc_buffer_t *buffer = dc_buffer_new_context (abstract->context, 0);
 	if (buffer == NULL) {
 		ERROR (abstract->context, "Failed to allocate memory.");
 		dc_rbstream_free (rbstream);
 		return DC_STATUS_NOMEMORY;
 	}
 
+	// The dive header is read first, and aligned to the end of this
+	// buffer, because its size is only known after the first part.
+	unsigned char dheader[SZ_HEADER_MAX] = {0};
+	unsigned char *end = dheader + sizeof (dheader);
+
 	unsigned int offset = layout->rb_profile_end - layout->rb_profile_begin;
 	while (offset >= header + 4) {
 		// Read the first part of the dive header.
-		rc = dc_rbstream_read (rbstream, &progress, buffer + offset - header, header);
+		rc = dc_rbstream_read (rbstream, &progress, end - header, header);
 		if (rc != DC_STATUS_SUCCESS) {
 			ERROR (abstract->context, "Failed to read the dive.");
 			dc_rbstream_free (rbstream);
-			free (buffer);
+			dc_buffer_free (buffer);
 			return rc;
 		}
 
 		// Get the number of samples in the profile data.
 		unsigned int type = 0, nsamples = 0;
 		if (model == SMART || model == SMARTAPNEA || model == SMARTAIR) {
-			type     = array_uint16_le (buffer + offset - header + 2);
-			nsamples = array_uint16_le (buffer + offset - header + 0);
+			type     = array_uint16_le (end - header + 2);
+			nsamples = array_uint16_le (end - header + 0);
 		} else {
-			type     = array_uint16_le (buffer + offset - header + 0);
-			nsamples = array_uint16_le (buffer + offset - header + 2);
+			type     = array_uint16_le (end - header + 0);
+			nsamples = array_uint16_le (end - header + 2);
 		}
 		if (nsamples == 0xFFFF || type == 0xFFFF)
 			break;
@@ -777,14 +796,21 @@ mares_iconhd_device_foreach_raw (dc_device_t *abstract, dc_dive_callback_t callb
 			break;
 
 		// Read the second part of the dive header.
-		rc = dc_rbstream_read (rbstream, &progress, buffer + offset - headersize, headersize - header);
+		rc = dc_rbstream_read (rbstream, &progress, end - headersize, headersize - header);
 		if (rc != DC_STATUS_SUCCESS) {
 			ERROR (abstract->context, "Failed to read the dive.");
 			dc_rbstream_free (rbstream);
-			free (buffer);
+			dc_buffer_free (buffer);
 			return rc;
 		}
 
+		// The fingerprint is stored in the dive header, which is read
+		// first. Stop before reading the remainder of an already
+		// downloaded dive.
+		if (memcmp (end - headersize + fingerprint, device->fingerprint, sizeof (device->fingerprint)) == 0) {
+			break;
+		}
+
 		// Calculate the total number of bytes for this dive.
 		// If the buffer does not contain that much bytes, we reached the
 		// end of the ringbuffer. The current dive is incomplete (partially
@@ -793,8 +819,8 @@ mares_iconhd_device_foreach_raw (dc_device_t *abstract, dc_dive_callback_t callb
 		if (model == ICONHDNET || model == QUADAIR || (model == SMARTAIR && mode != FREEDIVE)) {
 			nbytes += (nsamples / 4) * 8;
 		} else if (model == SMARTAPNEA) {
-			unsigned int settings = array_uint16_le (buffer + offset - headersize + 0x1C);
-			unsigned int divetime = array_uint32_le (buffer + offset - headersize + 0x24);
+			unsigned int settings = array_uint16_le (end - headersize + 0x1C);
+			unsigned int divetime = array_uint32_le (end - headersize + 0x24);
 			unsigned int samplerate = 1 << ((settings >> 9) & 0x03);
 
 			nbytes += divetime * samplerate * 2;
@@ -802,43 +828,66 @@ mares_iconhd_device_foreach_raw (dc_device_t *abstract, dc_dive_callback_t callb
 		if (offset < nbytes)
 			break;
 
+		// Skip dives left out by a selective download.
+		if (device_is_excluded (abstract, end - headersize + fingerprint, sizeof (device->fingerprint))) {
+			rc = dc_rbstream_skip (rbstream, &progress, nbytes - headersize);
+			if (rc != DC_STATUS_SUCCESS) {
+				ERROR (abstract->context, "Failed to skip the dive.");
+				dc_rbstream_free (rbstream);
+				dc_buffer_free (buffer);
+				return rc;
+			}
+			offset -= nbytes;
+			continue;
+		}
+
+		// Allocate memory for the dive.
+		dc_buffer_clear (buffer);
+		if (!dc_buffer_resize (buffer, nbytes)) {
+			ERROR (abstract->context, "Failed to allocate memory.");
+			dc_rbstream_free (rbstream);
+			dc_buffer_free (buffer);
+			return DC_STATUS_NOMEMORY;
+		}
+
+		unsigned char *data = dc_buffer_get_data (buffer);
+
 		// Read the remainder of the dive.
-		rc = dc_rbstream_read (rbstream, &progress, buffer + offset - nbytes, nbytes - headersize);
+		rc = dc_rbstream_read (rbstream, &progress, data, nbytes - headersize);
 		if (rc != DC_STATUS_SUCCESS) {
 			ERROR (abstract->context, "Failed to read the dive.");
 			dc_rbstream_free (rbstream);
-			free (buffer);
+			dc_buffer_free (buffer);
 			return rc;
 		}
 
+		// Append the dive header.
+		memcpy (data + nbytes - headersize, end - headersize, headersize);
+
 		// Move to the start of the dive.
 		offset -= nbytes;
 
 		// Verify that the length that is stored in the profile data
 		// equals the calculated length. If both values are different,
 		// we assume we reached the last dive.
-		unsigned int length = array_uint32_le (buffer + offset);
+		unsigned int length = array_uint32_le (data);
 		if (length != nbytes)
 			break;
 
-		unsigned char *fp = buffer + offset + length - headersize + fingerprint;
-		if (memcmp (fp, device->fingerprint, sizeof (device->fingerprint)) == 0) {
-			break;
-		}
-
-		if (callback && !callback (buffer + offset, length, fp, sizeof (device->fingerprint), userdata)) {
+		unsigned char *fp = data + length - headersize + fingerprint;
+		if (callback && !callback (data, length, fp, sizeof (device->fingerprint), userdata)) {
 			break;
 		}
 	}
 
 	dc_rbstream_free (rbstream);
-	free (buffer);
+	dc_buffer_free (buffer);
 
 	return rc;
 }
 
 static dc_status_t
-mares_iconhd_device_foreach_object (dc_device_t *abstract, dc_dive_callback_t callback, void *userdata)
+mares_iconhd_device_foreach_object (dc_device_t *abstract, dc_dive_callback_t callback, void *userdata, unsigned int headers)
 {
 	dc_status_t rc = DC_STATUS_SUCCESS;
 	mares_iconhd_device_t *device = (mares_iconhd_device_t *) abstract;
@@ -848,7 +897,7 @@ mares_iconhd_device_foreach_object (dc_device_t *abstract, dc_dive_callback_t ca
 	device_event_emit (abstract, DC_EVENT_PROGRESS, &progress);
 
 	// Allocate memory for the dives.
-	dc_buffer_t *buffer = dc_buffer_new (4096);
+	dc_buffer_t *buffer = dc_buffer_new_context (abstract->context, 4096);
 	if (buffer == NULL) {
 		ERROR (abstract->context, "Failed to allocate memory.");
 		return DC_STATUS_NOMEMORY;
@@ -874,7 +923,7 @@ mares_iconhd_device_foreach_object (dc_device_t *abstract, dc_dive_callback_t ca
 
 	// Update and emit a progress event.
 	progress.current = 1 * NSTEPS;
-	progress.maximum = (1 + ndives * 2) * NSTEPS;
+	progress.maximum = (1 + ndives * (headers ? 1 : 2)) * NSTEPS;
 	device_event_emit (abstract, DC_EVENT_PROGRESS, &progress);
 
 	// Download the dives.
@@ -895,6 +944,21 @@ mares_iconhd_device_foreach_object (dc_device_t *abstract, dc_dive_callback_t ca
 			break;
 		}
 
+		if (headers) {
+			const unsigned char *data = dc_buffer_get_data (buffer);
+			if (callback && !callback (data, dc_buffer_get_size (buffer), data + 0x08, device->fingerprint_size, userdata)) {
+				break;
+			}
+			continue;
+		}
+
+		// Skip dives left out by a selective download.
+		if (device_is_excluded (abstract, dc_buffer_get_data (buffer) + 0x08, device->fingerprint_size)) {
+			progress.current += NSTEPS;
+			device_event_emit (abstract, DC_EVENT_PROGRESS, &progress);
+			continue;
+		}
+
 		// Read the dive data.
 		rc = mares_iconhd_read_object (device, &progress, buffer, OBJ_DIVE + i, OBJ_DIVE_DATA);
 		if (rc != DC_STATUS_SUCCESS) {
@@ -914,7 +978,7 @@ mares_iconhd_device_foreach_object (dc_device_t *abstract, dc_dive_callback_t ca
 }
 
 static dc_status_t
-mares_iconhd_device_foreach (dc_device_t *abstract, dc_dive_callback_t callback, void *userdata)
+mares_iconhd_device_info (dc_device_t *abstract)
 {
 	dc_status_t rc = DC_STATUS_SUCCESS;
 	mares_iconhd_device_t *device = (mares_iconhd_device_t *) abstract;
@@ -940,9 +1004,37 @@ mares_iconhd_device_foreach (dc_device_t *abstract, dc_dive_callback_t callback,
 	devinfo.serial = array_uint32_le (serial);
 	device_event_emit (abstract, DC_EVENT_DEVINFO, &devinfo);
 
+	return DC_STATUS_SUCCESS;
+}
+
+static dc_status_t
+mares_iconhd_device_foreach (dc_device_t *abstract, dc_dive_callback_t callback, void *userdata)
+{
+	mares_iconhd_device_t *device = (mares_iconhd_device_t *) abstract;
+
+	dc_status_t rc = mares_iconhd_device_info (abstract);
+	if (rc != DC_STATUS_SUCCESS)
+		return rc;
+
 	if (device->model == GENIUS || device->model == HORIZON) {
-		return mares_iconhd_device_foreach_object (abstract, callback, userdata);
+		return mares_iconhd_device_foreach_object (abstract, callback, userdata, 0);
 	} else {
 		return mares_iconhd_device_foreach_raw (abstract, callback, userdata);
 	}
 }
+
+static dc_status_t
+mares_iconhd_device_foreach_header (dc_device_t *abstract, dc_dive_callback_t callback, void *userdata)
+{
+	mares_iconhd_device_t *device = (mares_iconhd_device_t *) abstract;
+
+	// Only the object based models have separate dive headers.
+	if (device->model != GENIUS && device->model != HORIZON)
+		return DC_STATUS_UNSUPPORTED;
+
+	dc_status_t rc = mares_iconhd_device_info (abstract);
+	if (rc != DC_STATUS_SUCCESS)
+		return rc;
+
+	return mares_iconhd_device_foreach_object (abstract, callback, userdata, 1);
+}
@@ -154,6 +154,7 @@ struct mares_iconhd_parser_t {
 	unsigned int model;
 	// Cached fields.
 	unsigned int cached;
+	unsigned int verified;
 	unsigned int logformat;
 	unsigned int mode;
 	unsigned int nsamples;
@@ -270,6 +271,7 @@ static const mares_iconhd_layout_t horizon = {
 static dc_status_t mares_iconhd_parser_get_datetime (dc_parser_t *abstract, dc_datetime_t *datetime);
 static dc_status_t mares_iconhd_parser_get_field (dc_parser_t *abstract, dc_field_type_t type, unsigned int flags, void *value);
 static dc_status_t mares_iconhd_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_t callback, void *userdata);
+static dc_status_t mares_iconhd_parser_reset (dc_parser_t *abstract);
 
 static const dc_parser_vtable_t mares_iconhd_parser_vtable = {
 	sizeof(mares_iconhd_parser_t),
@@ -279,7 +281,13 @@ static const dc_parser_vtable_t mares_iconhd_parser_vtable = {
 	NULL, /* set_density */
 	mares_iconhd_parser_get_datetime, /* datetime */
 	mares_iconhd_parser_get_field, /* fields */
+	NULL, /* summary */
 	mares_iconhd_parser_samples_foreach, /* samples_foreach */
+	NULL, /* samples_batch */
+	NULL, /* samples_fixed */
+	NULL, /* samples_append */
+	NULL, /* samples_range */
+	mares_iconhd_parser_reset, /* reset */
 	NULL /* destroy */
 };
 
@@ -305,6 +313,63 @@ mares_genius_isvalid (const unsigned char data[], size_t size, unsigned int type
 	return 1;
 }
 
+/*
+ * Verify all the records of the Genius profile data in a single pass.
+ * The records have a fixed size and order, so their offsets follow
+ * from the number of samples. Once verified, the sample walks no
+ * longer need to check the records individually.
+ */
+static dc_status_t
+mares_genius_verify (mares_iconhd_parser_t *parser, const unsigned char data[])
+{
+	dc_parser_t *abstract = (dc_parser_t *) parser;
+
+	if (parser->verified) {
+		return DC_STATUS_SUCCESS;
+	}
+
+	unsigned int offset = 4;
+
+	if (!mares_genius_isvalid (data + offset, DSTR_SIZE, DSTR_TYPE)) {
+		ERROR (abstract->context, "Invalid DSTR record.");
+		return DC_STATUS_DATAFORMAT;
+	}
+	offset += DSTR_SIZE;
+
+	if (!mares_genius_isvalid (data + offset, TISS_SIZE, TISS_TYPE)) {
+		ERROR (abstract->context, "Invalid TISS record.");
+		return DC_STATUS_DATAFORMAT;
+	}
+	offset += TISS_SIZE;
+
+	unsigned int type = parser->logformat == 1 ? SDPT_TYPE : DPRS_TYPE;
+	for (unsigned int i = 1; i <= parser->nsamples; ++i) {
+		if (!mares_genius_isvalid (data + offset, parser->samplesize, type)) {
+			ERROR (abstract->context, "Invalid %s record.",
+				parser->logformat == 1 ? "SDPT" : "DPRS");
+			return DC_STATUS_DATAFORMAT;
+		}
+		offset += parser->samplesize;
+
+		if (parser->layout->tanks != UNSUPPORTED && (i % 4) == 0) {
+			if (!mares_genius_isvalid (data + offset, AIRS_SIZE, AIRS_TYPE)) {
+				ERROR (abstract->context, "Invalid AIRS record.");
+				return DC_STATUS_DATAFORMAT;
+			}
+			offset += AIRS_SIZE;
+		}
+	}
+
+	if (!mares_genius_isvalid (data + offset, DEND_SIZE, DEND_TYPE)) {
+		ERROR (abstract->context, "Invalid DEND record.");
+		return DC_STATUS_DATAFORMAT;
+	}
+
+	parser->verified = 1;
+
+	return DC_STATUS_SUCCESS;
+}
+
 static dc_status_t
 mares_iconhd_cache (mares_iconhd_parser_t *parser)
 {
@@ -673,9 +738,24 @@ mares_iconhd_parser_create (dc_parser_t **out, dc_context_t *context, const unsi
 
 	// Set the default values.
 	parser->model = model;
+	parser->serial = serial;
+	mares_iconhd_parser_reset ((dc_parser_t *) parser);
+
+	*out = (dc_parser_t*) parser;
+
+	return DC_STATUS_SUCCESS;
+}
+
+
+static dc_status_t
+mares_iconhd_parser_reset (dc_parser_t *abstract)
+{
+	mares_iconhd_parser_t *parser = (mares_iconhd_parser_t *) abstract;
+
 	parser->cached = 0;
+	parser->verified = 0;
 	parser->logformat = 0;
-	parser->mode = (model == GENIUS || model == HORIZON) ? GENIUS_AIR : ICONHD_AIR;
+	parser->mode = (parser->model == GENIUS || parser->model == HORIZON) ? GENIUS_AIR : ICONHD_AIR;
 	parser->nsamples = 0;
 	parser->samplesize = 0;
 	parser->headersize = 0;
@@ -685,7 +765,6 @@ mares_iconhd_parser_create (dc_parser_t **out, dc_context_t *context, const unsi
 	parser->samplerate = 0;
 	parser->ntanks = 0;
 	parser->ngasmixes = 0;
-	parser->serial = serial;
 	for (unsigned int i = 0; i < NGASMIXES; ++i) {
 		parser->gasmix[i].oxygen = 0;
 		parser->gasmix[i].helium = 0;
@@ -698,8 +777,6 @@ mares_iconhd_parser_create (dc_parser_t **out, dc_context_t *context, const unsi
 	}
 	parser->layout = NULL;
 
-	*out = (dc_parser_t*) parser;
-
 	return DC_STATUS_SUCCESS;
 }
 
@@ -967,19 +1044,13 @@ mares_iconhd_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_t
 			return DC_STATUS_DATAFORMAT;
 		}
 
-		// Skip the DSTR record.
-		if (!mares_genius_isvalid (data + offset, DSTR_SIZE, DSTR_TYPE)) {
-			ERROR (abstract->context, "Invalid DSTR record.");
-			return DC_STATUS_DATAFORMAT;
-		}
-		offset += DSTR_SIZE;
+		// Verify all records.
+		rc = mares_genius_verify (parser, data);
+		if (rc != DC_STATUS_SUCCESS)
+			return rc;
 
-		// Skip the TISS record.
-		if (!mares_genius_isvalid (data + offset, TISS_SIZE, TISS_TYPE)) {
-			ERROR (abstract->context, "Invalid TISS record.");
-			return DC_STATUS_DATAFORMAT;
-		}
-		offset += TISS_SIZE;
+		// Skip the DSTR and TISS records.
+		offset += DSTR_SIZE + TISS_SIZE;
 
 		// Size of the record type marker.
 		marker = 4;
@@ -1053,11 +1124,6 @@ mares_iconhd_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_t
 			unsigned int bookmark = 0;
 			if (parser->model == GENIUS || parser->model == HORIZON) {
 				if (parser->logformat == 1) {
-					if (!mares_genius_isvalid (data + offset, SDPT_SIZE, SDPT_TYPE)) {
-						ERROR (abstract->context, "Invalid SDPT record.");
-						return DC_STATUS_DATAFORMAT;
-					}
-
 					unsigned int misc = 0, deco = 0;
 					depth       = array_uint16_le (data + offset + marker + 2);
 					temperature = array_uint16_le (data + offset + marker + 6);
@@ -1075,11 +1141,6 @@ mares_iconhd_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_t
 						decotime  = deco & 0xFF;
 					}
 				} else {
-					if (!mares_genius_isvalid (data + offset, DPRS_SIZE, DPRS_TYPE)) {
-						ERROR (abstract->context, "Invalid DPRS record.");
-						return DC_STATUS_DATAFORMAT;
-					}
-
 					unsigned int misc = 0;
 					depth       = array_uint16_le (data + offset + marker + 0);
 					temperature = array_uint16_le (data + offset + marker + 4);
@@ -1179,12 +1240,6 @@ mares_iconhd_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_t
 
 			// Some extra data.
 			if (parser->layout->tanks != UNSUPPORTED && (nsamples % 4) == 0) {
-				if ((parser->model == GENIUS || parser->model == HORIZON) &&
-					!mares_genius_isvalid (data + offset, AIRS_SIZE, AIRS_TYPE)) {
-					ERROR (abstract->context, "Invalid AIRS record.");
-					return DC_STATUS_DATAFORMAT;
-				}
-
 				// Pressure (1/100 bar).
 				unsigned int pressure = array_uint16_le(data + offset + marker + 0);
 				if (gasmix < parser->ntanks) {
@@ -1200,14 +1255,5 @@ mares_iconhd_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_t
 		}
 	}
 
-	if (parser->model == GENIUS || parser->model == HORIZON) {
-		// Skip the DEND record.
-		if (!mares_genius_isvalid (data + offset, DEND_SIZE, DEND_TYPE)) {
-			ERROR (abstract->context, "Invalid DEND record.");
-			return DC_STATUS_DATAFORMAT;
-		}
-		offset += DEND_SIZE;
-	}
-
 	return DC_STATUS_SUCCESS;
 }
@@ -57,9 +57,11 @@ static const dc_device_vtable_t mares_nemo_device_vtable = {
 	DC_FAMILY_MARES_NEMO,
 	mares_nemo_device_set_fingerprint, /* set_fingerprint */
 	NULL, /* read */
+	NULL, /* read_range */
 	NULL, /* write */
 	mares_nemo_device_dump, /* dump */
 	mares_nemo_device_foreach, /* foreach */
+	NULL, /* foreach_header */
 	NULL, /* timesync */
 	NULL /* close */
 };
@@ -262,7 +264,7 @@ mares_nemo_device_foreach (dc_device_t *abstract, dc_dive_callback_t callback, v
 {
 	mares_nemo_device_t *device = (mares_nemo_device_t *) abstract;
 
-	dc_buffer_t *buffer = dc_buffer_new (MEMORYSIZE);
+	dc_buffer_t *buffer = dc_buffer_new_context (abstract->context, MEMORYSIZE);
 	if (buffer == NULL)
 		return DC_STATUS_NOMEMORY;
 
@@ -62,6 +62,7 @@ struct mares_nemo_parser_t {
 static dc_status_t mares_nemo_parser_get_datetime (dc_parser_t *abstract, dc_datetime_t *datetime);
 static dc_status_t mares_nemo_parser_get_field (dc_parser_t *abstract, dc_field_type_t type, unsigned int flags, void *value);
 static dc_status_t mares_nemo_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_t callback, void *userdata);
+static dc_status_t mares_nemo_parser_reset (dc_parser_t *abstract);
 
 static const dc_parser_vtable_t mares_nemo_parser_vtable = {
 	sizeof(mares_nemo_parser_t),
@@ -71,7 +72,13 @@ static const dc_parser_vtable_t mares_nemo_parser_vtable = {
 	NULL, /* set_density */
 	mares_nemo_parser_get_datetime, /* datetime */
 	mares_nemo_parser_get_field, /* fields */
+	NULL, /* summary */
 	mares_nemo_parser_samples_foreach, /* samples_foreach */
+	NULL, /* samples_batch */
+	NULL, /* samples_fixed */
+	NULL, /* samples_append */
+	NULL, /* samples_range */
+	mares_nemo_parser_reset, /* reset */
 	NULL /* destroy */
 };
 
@@ -97,42 +104,61 @@ mares_nemo_parser_create (dc_parser_t **out, dc_context_t *context, const unsign
 	if (model == NEMOWIDE || model == NEMOAIR || model == PUCK || model == PUCKAIR)
 		freedive = GAUGE;
 
-	if (size < 2 + 3) {
-		status = DC_STATUS_DATAFORMAT;
+	// Set the default values.
+	parser->model = model;
+	parser->freedive = freedive;
+
+	status = mares_nemo_parser_reset ((dc_parser_t *) parser);
+	if (status != DC_STATUS_SUCCESS)
 		goto error_free;
-	}
+
+	*out = (dc_parser_t*) parser;
+
+	return DC_STATUS_SUCCESS;
+
+error_free:
+	dc_parser_deallocate ((dc_parser_t *) parser);
+	return status;
+}
+
+
+static dc_status_t
+mares_nemo_parser_reset (dc_parser_t *abstract)
+{
+	mares_nemo_parser_t *parser = (mares_nemo_parser_t *) abstract;
+	const unsigned char *data = abstract->data;
+	unsigned int size = abstract->size;
+
+	if (size < 2 + 3)
+		return DC_STATUS_DATAFORMAT;
 
 	unsigned int length = array_uint16_le (data);
-	if (length > size) {
-		status = DC_STATUS_DATAFORMAT;
-		goto error_free;
-	}
+	if (length > size)
+		return DC_STATUS_DATAFORMAT;
 
 	unsigned int extra = 0;
 	const unsigned char marker[3] = {0xAA, 0xBB, 0xCC};
 	if (memcmp (data + length - 3, marker, sizeof (marker)) == 0) {
-		if (model == PUCKAIR)
+		if (parser->model == PUCKAIR)
 			extra = 7;
 		else
 			extra = 12;
 	}
 
-	if (length < 2 + extra + 3) {
-		status = DC_STATUS_DATAFORMAT;
-		goto error_free;
-	}
+	if (length < 2 + extra + 3)
+		return DC_STATUS_DATAFORMAT;
 
 	unsigned int mode = data[length - extra - 1];
 
 	unsigned int header_size = 53;
 	unsigned int sample_size = 2;
 	if (extra) {
-		if (model == PUCKAIR)
+		if (parser->model == PUCKAIR)
 			sample_size = 3;
 		else
 			sample_size = 5;
 	}
-	if (mode == freedive) {
+	if (mode == parser->freedive) {
 		header_size = 28;
 		sample_size = 6;
 	}
@@ -140,14 +166,9 @@ mares_nemo_parser_create (dc_parser_t **out, dc_context_t *context, const unsign
 	unsigned int nsamples = array_uint16_le (data + length - extra - 3);
 
 	unsigned int nbytes = 2 + nsamples * sample_size + header_size + extra;
-	if (length != nbytes) {
-		status = DC_STATUS_DATAFORMAT;
-		goto error_free;
-	}
+	if (length != nbytes)
+		return DC_STATUS_DATAFORMAT;
 
-	// Set the default values.
-	parser->model = model;
-	parser->freedive = freedive;
 	parser->mode = mode;
 	parser->length = length;
 	parser->sample_count = nsamples;
@@ -155,13 +176,7 @@ mares_nemo_parser_create (dc_parser_t **out, dc_context_t *context, const unsign
 	parser->header = header_size;
 	parser->extra = extra;
 
-	*out = (dc_parser_t*) parser;
-
 	return DC_STATUS_SUCCESS;
-
-error_free:
-	dc_parser_deallocate ((dc_parser_t *) parser);
-	return status;
 }
 
 
@@ -52,9 +52,11 @@ static const dc_device_vtable_t mares_puck_device_vtable = {
 	DC_FAMILY_MARES_PUCK,
 	mares_puck_device_set_fingerprint, /* set_fingerprint */
 	mares_common_device_read, /* read */
+	NULL, /* read_range */
 	NULL, /* write */
 	mares_puck_device_dump, /* dump */
 	mares_puck_device_foreach, /* foreach */
+	NULL, /* foreach_header */
 	NULL, /* timesync */
 	NULL /* close */
 };
@@ -203,9 +205,22 @@ mares_puck_device_dump (dc_device_t *abstract, dc_buffer_t *buffer)
 		return DC_STATUS_NOMEMORY;
 	}
 
-	// Download the memory dump.
-	status = device_dump_read (abstract, 0, dc_buffer_get_data (buffer),
-		dc_buffer_get_size (buffer), PACKETSIZE);
+	// Use larger packets if the device supports them.
+	mares_common_device_probe (&device->base);
+
+	// Download the memory dump, incrementally if possible.
+	status = DC_STATUS_UNSUPPORTED;
+	const unsigned char *previous = device_dump_previous (abstract, device->layout->memsize);
+	if (previous) {
+		status = mares_common_device_dump_incremental (abstract, device->layout,
+			0x6B, 0, previous, dc_buffer_get_data (buffer));
+		if (status == DC_STATUS_UNSUPPORTED)
+			WARNING (abstract->context, "Falling back to a full memory dump.");
+	}
+	if (status == DC_STATUS_UNSUPPORTED) {
+		status = device_dump_read (abstract, 0, dc_buffer_get_data (buffer),
+			dc_buffer_get_size (buffer), device->base.packetsize);
+	}
 	if (status != DC_STATUS_SUCCESS) {
 		return status;
 	}
@@ -229,7 +244,7 @@ mares_puck_device_foreach (dc_device_t *abstract, dc_dive_callback_t callback, v
 
 	assert (device->layout != NULL);
 
-	dc_buffer_t *buffer = dc_buffer_new (device->layout->memsize);
+	dc_buffer_t *buffer = dc_buffer_new_context (abstract->context, device->layout->memsize);
 	if (buffer == NULL)
 		return DC_STATUS_NOMEMORY;
 
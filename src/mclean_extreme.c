@@ -26,6 +26,7 @@
 #include "context-private.h"
 #include "device-private.h"
 #include "array.h"
+#include "checksum.h"
 #include "packet.h"
 
 #define ISINSTANCE(device) dc_device_isinstance((device), &mclean_extreme_device_vtable)
@@ -70,9 +71,11 @@ static const dc_device_vtable_t mclean_extreme_device_vtable = {
 	DC_FAMILY_MCLEAN_EXTREME,
 	mclean_extreme_device_set_fingerprint, /* set_fingerprint */
 	NULL, /* read */
+	NULL, /* read_range */
 	NULL, /* write */
 	NULL, /* dump */
 	mclean_extreme_device_foreach, /* foreach */
+	NULL, /* foreach_header */
 	mclean_extreme_device_timesync, /* timesync */
 	mclean_extreme_device_close, /* close */
 };
@@ -90,23 +93,6 @@ hashcode (const unsigned char data[], size_t size)
 	return result;
 }
 
-static unsigned short
-checksum_crc(const unsigned char data[], unsigned int size, unsigned short init)
-{
-	unsigned short crc = init;
-	for (unsigned int i = 0; i < size; ++i) {
-		crc ^= data[i] << 8;
-		if (crc & 0x8000) {
-			crc <<= 1;
-			crc ^= 0x1021;
-		} else {
-			crc <<= 1;
-		}
-	}
-
-	return crc;
-}
-
 static dc_status_t
 mclean_extreme_send(mclean_extreme_device_t *device, unsigned char cmd, const unsigned char data[], size_t size)
 {
@@ -133,7 +119,7 @@ mclean_extreme_send(mclean_extreme_device_t *device, unsigned char cmd, const un
 	if (size) {
 		memcpy(packet + 7, data, size);
 	}
-	crc = checksum_crc(packet + 1, size + 6, 0);
+	crc = checksum_crc16_ccitt_1bit (packet + 1, size + 6, 0);
 	packet[size + 7] = (crc >> 8) & 0xFF;
 	packet[size + 8] = (crc) & 0xFF;
 	packet[size + 9] = 0x00;
@@ -179,6 +165,8 @@ mclean_extreme_receive(mclean_extreme_device_t *device, unsigned char rsp, unsig
 			if (nretries++ >= MAXRETRIES)
 				return status;
 
+			device_stats_retry (abstract);
+
 			// Cancel if requested by the user.
 			if (device_is_cancelled(abstract))
 				return DC_STATUS_CANCELLED;
@@ -252,8 +240,8 @@ mclean_extreme_receive(mclean_extreme_device_t *device, unsigned char rsp, unsig
 	// Verify the checksum.
 	unsigned short crc = array_uint16_be(checksum);
 	unsigned short ccrc = 0;
-	ccrc = checksum_crc(header + 1, sizeof(header) - 1, ccrc);
-	ccrc = checksum_crc(data, length, ccrc);
+	ccrc = checksum_crc16_ccitt_1bit (header + 1, sizeof(header) - 1, ccrc);
+	ccrc = checksum_crc16_ccitt_1bit (data, length, ccrc);
 	if (crc != ccrc || checksum[2] != 0x00 || checksum[3] != 0) {
 		ERROR(abstract->context, "Unexpected packet checksum.");
 		return DC_STATUS_PROTOCOL;
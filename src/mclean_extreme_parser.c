@@ -61,6 +61,7 @@ struct mclean_extreme_parser_t {
 static dc_status_t mclean_extreme_parser_get_datetime(dc_parser_t *abstract, dc_datetime_t *datetime);
 static dc_status_t mclean_extreme_parser_get_field(dc_parser_t *abstract, dc_field_type_t type, unsigned int flags, void *value);
 static dc_status_t mclean_extreme_parser_samples_foreach(dc_parser_t *abstract, dc_sample_callback_t callback, void *userdata);
+static dc_status_t mclean_extreme_parser_reset(dc_parser_t *abstract);
 
 static const dc_parser_vtable_t mclean_extreme_parser_vtable = {
 	sizeof(mclean_extreme_parser_t),
@@ -70,7 +71,13 @@ static const dc_parser_vtable_t mclean_extreme_parser_vtable = {
 	NULL, /* set_density */
 	mclean_extreme_parser_get_datetime, /* datetime */
 	mclean_extreme_parser_get_field, /* fields */
+	NULL, /* summary */
 	mclean_extreme_parser_samples_foreach, /* samples_foreach */
+	NULL, /* samples_batch */
+	NULL, /* samples_fixed */
+	NULL, /* samples_append */
+	NULL, /* samples_range */
+	mclean_extreme_parser_reset, /* reset */
 	NULL /* destroy */
 };
 
@@ -91,14 +98,25 @@ mclean_extreme_parser_create(dc_parser_t **out, dc_context_t *context, const uns
 	}
 
 	// Set the default values.
+	mclean_extreme_parser_reset((dc_parser_t *) parser);
+
+	*out = (dc_parser_t *)parser;
+
+	return DC_STATUS_SUCCESS;
+}
+
+
+static dc_status_t
+mclean_extreme_parser_reset(dc_parser_t *abstract)
+{
+	mclean_extreme_parser_t *parser = (mclean_extreme_parser_t *) abstract;
+
 	parser->cached = 0;
 	parser->ngasmixes = 0;
 	for (unsigned int i = 0; i < NGASMIXES; ++i) {
 		parser->gasmix[i] = INVALID;
 	}
 
-	*out = (dc_parser_t *)parser;
-
 	return DC_STATUS_SUCCESS;
 }
 
@@ -37,8 +37,9 @@
 
 #define MAXPACKET  256
 #define MAXRETRIES 2
+#define MINTIMEOUT 500
+#define MAXTIMEOUT 1000
 #define MAXDELAY   16
-#define INVALID    0xFFFFFFFF
 
 #define CMD_INIT      0xA8
 #define CMD_VERSION   0x84
@@ -62,12 +63,9 @@ typedef struct oceanic_atom2_device_t {
 	unsigned int handshake_repeat;
 	unsigned int handshake_counter;
 	unsigned int sequence;
-	unsigned int delay;
+	device_delay_t delay;
 	unsigned int extra;
 	unsigned int bigpage;
-	unsigned char cache[256];
-	unsigned int cached_page;
-	unsigned int cached_highmem;
 } oceanic_atom2_device_t;
 
 static dc_status_t oceanic_atom2_device_read (dc_device_t *abstract, unsigned int address, unsigned char data[], unsigned int size);
@@ -80,9 +78,11 @@ static const oceanic_common_device_vtable_t oceanic_atom2_device_vtable = {
 		DC_FAMILY_OCEANIC_ATOM2,
 		oceanic_common_device_set_fingerprint, /* set_fingerprint */
 		oceanic_atom2_device_read, /* read */
+		NULL, /* read_range */
 		oceanic_atom2_device_write, /* write */
 		oceanic_common_device_dump, /* dump */
 		oceanic_common_device_foreach, /* foreach */
+		oceanic_common_device_foreach_header, /* foreach_header */
 		NULL, /* timesync */
 		oceanic_atom2_device_close /* close */
 	},
@@ -651,9 +651,7 @@ oceanic_atom2_packet (oceanic_atom2_device_t *device, const unsigned char comman
 	if (device_is_cancelled (abstract))
 		return DC_STATUS_CANCELLED;
 
-	if (device->delay) {
-		dc_iostream_sleep (device->iostream, device->delay);
-	}
+	device_delay_wait (&device->delay, device->iostream);
 
 	// Send the command to the dive computer.
 	if (transport == DC_TRANSPORT_BLE) {
@@ -735,6 +733,28 @@ oceanic_atom2_packet (oceanic_atom2_device_t *device, const unsigned char comman
 }
 
 
+typedef struct oceanic_atom2_transfer_t {
+	const unsigned char *command;
+	unsigned int csize;
+	unsigned char ack;
+	unsigned char *answer;
+	unsigned int asize;
+	unsigned int crc_size;
+} oceanic_atom2_transfer_t;
+
+static dc_status_t
+oceanic_atom2_attempt (dc_device_t *abstract, unsigned int attempt, void *userdata)
+{
+	oceanic_atom2_device_t *device = (oceanic_atom2_device_t *) abstract;
+	oceanic_atom2_transfer_t *transfer = (oceanic_atom2_transfer_t *) userdata;
+
+	// Increase the inter packet delay.
+	if (attempt)
+		device_delay_failure (&device->delay);
+
+	return oceanic_atom2_packet (device, transfer->command, transfer->csize, transfer->ack, transfer->answer, transfer->asize, transfer->crc_size);
+}
+
 static dc_status_t
 oceanic_atom2_transfer (oceanic_atom2_device_t *device, const unsigned char command[], unsigned int csize, unsigned char ack, unsigned char answer[], unsigned int asize, unsigned int crc_size)
 {
@@ -744,26 +764,14 @@ oceanic_atom2_transfer (oceanic_atom2_device_t *device, const unsigned char comm
 	// a NAK byte, we try to resend the command a number of times before
 	// returning an error.
 
-	unsigned int nretries = 0;
-	dc_status_t rc = DC_STATUS_SUCCESS;
-	while ((rc = oceanic_atom2_packet (device, command, csize, ack, answer, asize, crc_size)) != DC_STATUS_SUCCESS) {
-		if (rc != DC_STATUS_TIMEOUT && rc != DC_STATUS_PROTOCOL)
-			return rc;
-
-		// Abort if the maximum number of retries is reached.
-		if (nretries++ >= MAXRETRIES)
-			return rc;
-
-		// Increase the inter packet delay.
-		if (device->delay < MAXDELAY)
-			device->delay++;
+	const device_retry_t policy = {MAXRETRIES, 100, 1, MINTIMEOUT, MAXTIMEOUT};
+	oceanic_atom2_transfer_t transfer = {command, csize, ack, answer, asize, crc_size};
 
-		// Delay the next attempt.
-		dc_iostream_sleep (device->iostream, 100);
-		dc_iostream_purge (device->iostream, DC_DIRECTION_INPUT);
-	}
+	dc_status_t status = device_transfer_retry ((dc_device_t *) device, device->iostream, &policy, oceanic_atom2_attempt, &transfer);
+	if (status == DC_STATUS_SUCCESS)
+		device_delay_success (&device->delay);
 
-	return DC_STATUS_SUCCESS;
+	return status;
 }
 
 /*
@@ -853,13 +861,10 @@ oceanic_atom2_device_open (dc_device_t **out, dc_context_t *context, dc_iostream
 
 	// Set the default values.
 	device->iostream = iostream;
-	device->delay = 0;
+	device_delay_init (&device->delay, 0, MAXDELAY);
 	device->extra = model == PROPLUSX || model == I770R;
 	device->sequence = 0;
 	device->bigpage = 1; // no big pages
-	device->cached_page = INVALID;
-	device->cached_highmem = INVALID;
-	memset(device->cache, 0, sizeof(device->cache));
 
 	// Get the correct baudrate.
 	unsigned int baudrate = 38400;
@@ -875,7 +880,7 @@ oceanic_atom2_device_open (dc_device_t **out, dc_context_t *context, dc_iostream
 	}
 
 	// Set the timeout for receiving data (1000 ms).
-	status = dc_iostream_set_timeout (device->iostream, 1000);
+	status = dc_iostream_set_timeout (device->iostream, MAXTIMEOUT);
 	if (status != DC_STATUS_SUCCESS) {
 		ERROR (context, "Failed to set the timeout.");
 		goto error_free;
@@ -983,6 +988,8 @@ oceanic_atom2_device_close (dc_device_t *abstract)
 	oceanic_atom2_device_t *device = (oceanic_atom2_device_t*) abstract;
 	dc_status_t rc = DC_STATUS_SUCCESS;
 
+	DEBUG (abstract->context, "Page cache: hits=%u, misses=%u", device->base.cache.hits, device->base.cache.misses);
+
 	// Send the quit command.
 	unsigned char command[4] = {CMD_QUIT, 0x05, 0xA5};
 	rc = oceanic_atom2_transfer (device, command, sizeof (command), NAK, NULL, 0, 0);
@@ -1082,7 +1089,9 @@ oceanic_atom2_device_read (dc_device_t *abstract, unsigned int address, unsigned
 		// addresses back to their physical address.
 		unsigned int page = (address - highmem) / pagesize;
 
-		if (page != device->cached_page || highmem != device->cached_highmem) {
+		unsigned int hit = 0;
+		oceanic_common_page_t *entry = oceanic_common_cache_lookup (&device->base.cache, page, highmem, &hit);
+		if (!hit) {
 			if (device->handshake_repeat && ++device->handshake_counter % REPEAT == 0) {
 				unsigned char version[PAGESIZE] = {0};
 				oceanic_atom2_device_version (abstract, version, sizeof (version));
@@ -1095,13 +1104,12 @@ oceanic_atom2_device_read (dc_device_t *abstract, unsigned int address, unsigned
 					(number >> 8) & 0xFF, // high
 					(number     ) & 0xFF, // low
 				};
-			dc_status_t rc = oceanic_atom2_transfer (device, command, sizeof (command), ACK, device->cache, pagesize, crc_size);
+			dc_status_t rc = oceanic_atom2_transfer (device, command, sizeof (command), ACK, entry->data, pagesize, crc_size);
 			if (rc != DC_STATUS_SUCCESS)
 				return rc;
 
 			// Cache the page.
-			device->cached_page = page;
-			device->cached_highmem = highmem;
+			oceanic_common_cache_insert (&device->base.cache, entry, page, highmem);
 		}
 
 		unsigned int offset = address % pagesize;
@@ -1109,7 +1117,7 @@ oceanic_atom2_device_read (dc_device_t *abstract, unsigned int address, unsigned
 		if (nbytes + length > size)
 			length = size - nbytes;
 
-		memcpy (data, device->cache + offset, length);
+		memcpy (data, entry->data + offset, length);
 
 		nbytes += length;
 		address += length;
@@ -1130,8 +1138,7 @@ oceanic_atom2_device_write (dc_device_t *abstract, unsigned int address, const u
 		return DC_STATUS_INVALIDARGS;
 
 	// Invalidate the cache.
-	device->cached_page = INVALID;
-	device->cached_highmem = INVALID;
+	oceanic_common_cache_invalidate (&device->base.cache);
 
 	unsigned int nbytes = 0;
 	while (nbytes < size) {
@@ -43,6 +43,48 @@
 #define PROFILE 2
 
 typedef struct oceanic_atom2_parser_t oceanic_atom2_parser_t;
+typedef struct oceanic_atom2_layout_t oceanic_atom2_layout_t;
+
+/*
+ * Model specific sample layout.
+ *
+ * The layout is resolved once, when the parser is created, such that
+ * the sample loop doesn't need to check the model number. The more
+ * complex fields are decoded with a function, the others are described
+ * by their offset and bitmask. A zero bitmask means the field is not
+ * available.
+ */
+struct oceanic_atom2_layout_t {
+	unsigned int interval;   /* Offset of the sample rate */
+	unsigned int samplesize;
+	unsigned int freedive;   /* Sample size in freedive mode */
+	unsigned int timestamp;  /* BCD time of day in every sample */
+	unsigned int pressure;   /* Offset of the initial tank pressure */
+	unsigned int have_pressure;
+	// Temperature
+	unsigned int temperature;
+	unsigned int sign_offset;
+	unsigned int sign_mask;
+	unsigned int sign_invert;
+	// Decoders
+	unsigned int (*decode_tankswitch) (const unsigned char *p, unsigned int *tank);
+	unsigned int (*decode_temperature) (const oceanic_atom2_layout_t *layout, const unsigned char *p, unsigned int previous);
+	unsigned int (*decode_pressure) (const unsigned char *p, unsigned int previous);
+	unsigned int (*decode_depth) (const unsigned char *p);
+	// Gas mix
+	unsigned int gasmix_mask;
+	// NDL / Deco
+	unsigned int decostop_offset;
+	unsigned int decostop_mask;
+	unsigned int decostop_shift;
+	unsigned int decotime_offset;
+	unsigned int decotime_mask;
+	// Remaining bottom time
+	unsigned int rbt_offset;
+	unsigned int rbt_mask;
+	// Bookmarks
+	unsigned int bookmark_mask;
+};
 
 struct oceanic_atom2_parser_t {
 	dc_parser_t base;
@@ -50,6 +92,7 @@ struct oceanic_atom2_parser_t {
 	unsigned int headersize;
 	unsigned int footersize;
 	unsigned int serial;
+	oceanic_atom2_layout_t layout;
 	// Cached fields.
 	unsigned int cached;
 	unsigned int header;
@@ -65,6 +108,7 @@ struct oceanic_atom2_parser_t {
 static dc_status_t oceanic_atom2_parser_get_datetime (dc_parser_t *abstract, dc_datetime_t *datetime);
 static dc_status_t oceanic_atom2_parser_get_field (dc_parser_t *abstract, dc_field_type_t type, unsigned int flags, void *value);
 static dc_status_t oceanic_atom2_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_t callback, void *userdata);
+static dc_status_t oceanic_atom2_parser_reset (dc_parser_t *abstract);
 
 static const dc_parser_vtable_t oceanic_atom2_parser_vtable = {
 	sizeof(oceanic_atom2_parser_t),
@@ -74,11 +118,363 @@ static const dc_parser_vtable_t oceanic_atom2_parser_vtable = {
 	NULL, /* set_density */
 	oceanic_atom2_parser_get_datetime, /* datetime */
 	oceanic_atom2_parser_get_field, /* fields */
+	NULL, /* summary */
 	oceanic_atom2_parser_samples_foreach, /* samples_foreach */
+	NULL, /* samples_batch */
+	NULL, /* samples_fixed */
+	NULL, /* samples_append */
+	NULL, /* samples_range */
+	oceanic_atom2_parser_reset, /* reset */
 	NULL /* destroy */
 };
 
 
+static unsigned int
+oceanic_atom2_tankswitch_1psi (const unsigned char *p, unsigned int *tank)
+{
+	// Tank pressure (1 psi) and number (one based index)
+	*tank = (p[1] & 0x03) - 1;
+	return ((p[7] << 8) + p[6]) & 0x0FFF;
+}
+
+static unsigned int
+oceanic_atom2_tankswitch_datamask (const unsigned char *p, unsigned int *tank)
+{
+	// Tank pressure (1 psi) and number
+	*tank = 0;
+	return (((p[7] << 8) + p[6]) & 0x0FFF);
+}
+
+static unsigned int
+oceanic_atom2_tankswitch_atom2 (const unsigned char *p, unsigned int *tank)
+{
+	// Tank pressure (2 psi) and number (one based index)
+	*tank = (p[1] & 0x03) - 1;
+	return (((p[3] << 8) + p[4]) & 0x0FFF) * 2;
+}
+
+static unsigned int
+oceanic_atom2_tankswitch_2psi (const unsigned char *p, unsigned int *tank)
+{
+	// Tank pressure (2 psi) and number (one based index)
+	*tank = (p[1] & 0x03) - 1;
+	return (((p[4] << 8) + p[5]) & 0x0FFF) * 2;
+}
+
+static unsigned int
+oceanic_atom2_temperature_byte (const oceanic_atom2_layout_t *layout, const unsigned char *p, unsigned int previous)
+{
+	return p[layout->temperature];
+}
+
+static unsigned int
+oceanic_atom2_temperature_vt4 (const oceanic_atom2_layout_t *layout, const unsigned char *p, unsigned int previous)
+{
+	return ((p[7] & 0xF0) >> 4) | ((p[7] & 0x0C) << 2) | ((p[5] & 0x0C) << 4);
+}
+
+static unsigned int
+oceanic_atom2_temperature_delta (const oceanic_atom2_layout_t *layout, const unsigned char *p, unsigned int previous)
+{
+	unsigned int sign = ((p[layout->sign_offset] & layout->sign_mask) != 0) ^ layout->sign_invert;
+	if (sign)
+		return previous - ((p[7] & 0x0C) >> 2);
+	else
+		return previous + ((p[7] & 0x0C) >> 2);
+}
+
+static unsigned int
+oceanic_atom2_pressure_oc1 (const unsigned char *p, unsigned int previous)
+{
+	return (p[10] + (p[11] << 8)) & 0x0FFF;
+}
+
+static unsigned int
+oceanic_atom2_pressure_vt4 (const unsigned char *p, unsigned int previous)
+{
+	return (((p[0] & 0x03) << 8) + p[1]) * 5;
+}
+
+static unsigned int
+oceanic_atom2_pressure_tx1 (const unsigned char *p, unsigned int previous)
+{
+	return array_uint16_le (p + 4);
+}
+
+static unsigned int
+oceanic_atom2_pressure_delta (const unsigned char *p, unsigned int previous)
+{
+	return previous - p[1];
+}
+
+static unsigned int
+oceanic_atom2_depth_freedive (const unsigned char *p)
+{
+	return array_uint16_le (p);
+}
+
+static unsigned int
+oceanic_atom2_depth_geo20 (const unsigned char *p)
+{
+	return (p[4] + (p[5] << 8)) & 0x0FFF;
+}
+
+static unsigned int
+oceanic_atom2_depth_atom1 (const unsigned char *p)
+{
+	return p[3] * 16;
+}
+
+static unsigned int
+oceanic_atom2_depth_default (const unsigned char *p)
+{
+	return (p[2] + (p[3] << 8)) & 0x0FFF;
+}
+
+static void
+oceanic_atom2_parser_layout (oceanic_atom2_layout_t *layout, unsigned int model)
+{
+	memset (layout, 0, sizeof (*layout));
+
+	// Sample rate.
+	layout->interval = 0x17;
+	if (model == A300CS || model == VTX ||
+		model == I450T || model == I750TC ||
+		model == PROPLUSX || model == I770R ||
+		model == SAGE || model == BEACON)
+		layout->interval = 0x1f;
+
+	// Sample size.
+	layout->samplesize = PAGESIZE / 2;
+	if (model == OC1A || model == OC1B ||
+		model == OC1C || model == OCI ||
+		model == TX1 || model == A300CS ||
+		model == VTX || model == I450T ||
+		model == I750TC || model == PROPLUSX ||
+		model == I770R || model == I470TC ||
+		model == SAGE || model == BEACON ||
+		model == GEOAIR) {
+		layout->samplesize = PAGESIZE;
+	}
+	if (model == F10A || model == F10B ||
+		model == F11A || model == F11B ||
+		model == MUNDIAL2 || model == MUNDIAL3) {
+		layout->freedive = 2;
+	} else {
+		layout->freedive = 4;
+	}
+
+	// Time of day.
+	layout->timestamp = model == I450T || model == I470TC;
+
+	// Tank pressure.
+	layout->have_pressure = 1;
+	if (model == VEO30 || model == OCS ||
+		model == ELEMENT2 || model == VEO20 ||
+		model == A300 || model == ZEN ||
+		model == GEO || model == GEO20 ||
+		model == MANTA || model == I300 ||
+		model == I200 || model == I100 ||
+		model == I300C || model == TALIS ||
+		model == I200C || model == I200CV2 ||
+		model == GEO40 || model == VEO40) {
+		layout->have_pressure = 0;
+	}
+	layout->pressure = 2;
+	if (model == A300CS || model == VTX ||
+		model == I750TC || model == I770R)
+		layout->pressure = 16;
+
+	// Tank switches.
+	if (model == DATAMASK || model == COMPUMASK) {
+		layout->decode_tankswitch = oceanic_atom2_tankswitch_datamask;
+	} else if (model == A300CS || model == VTX ||
+		model == I750TC || model == I770R ||
+		model == SAGE || model == BEACON) {
+		layout->decode_tankswitch = oceanic_atom2_tankswitch_1psi;
+	} else if (model == ATOM2 || model == EPICA || model == EPICB) {
+		layout->decode_tankswitch = oceanic_atom2_tankswitch_atom2;
+	} else {
+		layout->decode_tankswitch = oceanic_atom2_tankswitch_2psi;
+	}
+
+	// Temperature (°F)
+	layout->decode_temperature = oceanic_atom2_temperature_byte;
+	if (model == GEO || model == ATOM1 ||
+		model == ELEMENT2 || model == MANTA ||
+		model == ZEN) {
+		layout->temperature = 6;
+	} else if (model == TALIS) {
+		layout->temperature = 7;
+	} else if (model == GEO20 || model == VEO20 ||
+		model == VEO30 || model == OC1A ||
+		model == OC1B || model == OC1C ||
+		model == OCI || model == A300 ||
+		model == I450T || model == I300 ||
+		model == I200 || model == I100 ||
+		model == I300C || model == I200C ||
+		model == GEO40 || model == VEO40 ||
+		model == I470TC || model == I200CV2 ||
+		model == GEOAIR) {
+		layout->temperature = 3;
+	} else if (model == OCS || model == TX1) {
+		layout->temperature = 1;
+	} else if (model == VT4 || model == VT41 ||
+		model == ATOM3 || model == ATOM31 ||
+		model == A300AI || model == VISION ||
+		model == XPAIR) {
+		layout->decode_temperature = oceanic_atom2_temperature_vt4;
+	} else if (model == A300CS || model == VTX ||
+		model == I750TC || model == PROPLUSX ||
+		model == I770R|| model == SAGE ||
+		model == BEACON) {
+		layout->temperature = 11;
+	} else {
+		// Relative to the previous temperature.
+		layout->decode_temperature = oceanic_atom2_temperature_delta;
+		if (model == DG03 || model == PROPLUS3 ||
+			model == I550 || model == I550C ||
+			model == PROPLUS4 || model == WISDOM4) {
+			layout->sign_offset = 5;
+			layout->sign_mask = 0x04;
+			layout->sign_invert = 1;
+		} else if (model == VOYAGER2G || model == AMPHOS ||
+			model == AMPHOSAIR || model == ZENAIR ||
+			model == AMPHOS2 || model == AMPHOSAIR2) {
+			layout->sign_offset = 5;
+			layout->sign_mask = 0x04;
+			layout->sign_invert = 0;
+		} else if (model == ATOM2 || model == PROPLUS21 ||
+			model == EPICA || model == EPICB ||
+			model == ATMOSAI2 ||
+			model == WISDOM2 || model == WISDOM3) {
+			layout->sign_offset = 0;
+			layout->sign_mask = 0x80;
+			layout->sign_invert = 0;
+		} else {
+			layout->sign_offset = 0;
+			layout->sign_mask = 0x80;
+			layout->sign_invert = 1;
+		}
+	}
+
+	// Tank Pressure (psi)
+	if (model == OC1A || model == OC1B ||
+		model == OC1C || model == OCI ||
+		model == I450T || model == I470TC ||
+		model == GEOAIR)
+		layout->decode_pressure = oceanic_atom2_pressure_oc1;
+	else if (model == VT4 || model == VT41||
+		model == ATOM3 || model == ATOM31 ||
+		model == ZENAIR ||model == A300AI ||
+		model == DG03 || model == PROPLUS3 ||
+		model == AMPHOSAIR || model == I550 ||
+		model == VISION || model == XPAIR ||
+		model == I550C || model == PROPLUS4 ||
+		model == WISDOM4 || model == AMPHOSAIR2)
+		layout->decode_pressure = oceanic_atom2_pressure_vt4;
+	else if (model == TX1 || model == A300CS ||
+		model == VTX || model == I750TC ||
+		model == PROPLUSX || model == I770R ||
+		model == SAGE || model == BEACON)
+		layout->decode_pressure = oceanic_atom2_pressure_tx1;
+	else
+		layout->decode_pressure = oceanic_atom2_pressure_delta;
+
+	// Depth (1/16 ft)
+	if (model == GEO20 || model == VEO20 ||
+		model == VEO30 || model == OC1A ||
+		model == OC1B || model == OC1C ||
+		model == OCI || model == A300 ||
+		model == I450T || model == I300 ||
+		model == I200 || model == I100 ||
+		model == I300C || model == I200C ||
+		model == GEO40 || model == VEO40 ||
+		model == I470TC || model == I200CV2 ||
+		model == GEOAIR)
+		layout->decode_depth = oceanic_atom2_depth_geo20;
+	else if (model == ATOM1)
+		layout->decode_depth = oceanic_atom2_depth_atom1;
+	else
+		layout->decode_depth = oceanic_atom2_depth_default;
+
+	// Gas mix
+	if (model == TX1) {
+		layout->gasmix_mask = 0x07;
+	}
+
+	// NDL / Deco
+	if (model == A300CS || model == VTX ||
+		model == I750TC || model == SAGE ||
+		model == PROPLUSX || model == I770R ||
+		model == BEACON) {
+		layout->decostop_offset = 15;
+		layout->decostop_mask = 0x70;
+		layout->decostop_shift = 4;
+		layout->decotime_offset = 6;
+		layout->decotime_mask = 0x03FF;
+	} else if (model == ZEN || model == DG03) {
+		layout->decostop_offset = 5;
+		layout->decostop_mask = 0xF0;
+		layout->decostop_shift = 4;
+		layout->decotime_offset = 4;
+		layout->decotime_mask = 0x0FFF;
+	} else if (model == TX1) {
+		layout->decostop_offset = 10;
+		layout->decostop_mask = 0xFF;
+		layout->decostop_shift = 0;
+		layout->decotime_offset = 6;
+		layout->decotime_mask = 0xFFFF;
+	} else if (model == ATOM31 || model == VISION ||
+		model == XPAIR || model == I550 ||
+		model == I550C || model == WISDOM4) {
+		layout->decostop_offset = 5;
+		layout->decostop_mask = 0xF0;
+		layout->decostop_shift = 4;
+		layout->decotime_offset = 4;
+		layout->decotime_mask = 0x03FF;
+	} else if (model == I200 || model == I300 ||
+		model == OC1A || model == OC1B ||
+		model == OC1C || model == OCI ||
+		model == I100 || model == I300C ||
+		model == I450T || model == I200C ||
+		model == GEO40 || model == VEO40 ||
+		model == I470TC || model == I200CV2 ||
+		model == GEOAIR) {
+		layout->decostop_offset = 7;
+		layout->decostop_mask = 0xF0;
+		layout->decostop_shift = 4;
+		layout->decotime_offset = 6;
+		layout->decotime_mask = 0x0FFF;
+	}
+
+	// Remaining bottom time
+	if (model == ATOM31) {
+		layout->rbt_offset = 6;
+		layout->rbt_mask = 0x01FF;
+	} else if (model == I450T || model == OC1A ||
+		model == OC1B || model == OC1C ||
+		model == OCI || model == PROPLUSX ||
+		model == I770R || model == I470TC ||
+		model == GEOAIR) {
+		layout->rbt_offset = 8;
+		layout->rbt_mask = 0x01FF;
+	} else if (model == VISION || model == XPAIR ||
+		model == I550 || model == I550C ||
+		model == WISDOM4) {
+		layout->rbt_offset = 6;
+		layout->rbt_mask = 0x03FF;
+	}
+
+	// Bookmarks
+	if (model == OC1A || model == OC1B ||
+		model == OC1C || model == OCI ||
+		model == GEOAIR) {
+		layout->bookmark_mask = 0x80;
+	}
+}
+
+
 dc_status_t
 oceanic_atom2_parser_create (dc_parser_t **out, dc_context_t *context, const unsigned char data[], size_t size, unsigned int model, unsigned int serial)
 {
@@ -137,6 +533,20 @@ oceanic_atom2_parser_create (dc_parser_t **out, dc_context_t *context, const uns
 	}
 
 	parser->serial = serial;
+	oceanic_atom2_parser_layout (&parser->layout, model);
+	oceanic_atom2_parser_reset ((dc_parser_t *) parser);
+
+	*out = (dc_parser_t*) parser;
+
+	return DC_STATUS_SUCCESS;
+}
+
+
+static dc_status_t
+oceanic_atom2_parser_reset (dc_parser_t *abstract)
+{
+	oceanic_atom2_parser_t *parser = (oceanic_atom2_parser_t *) abstract;
+
 	parser->cached = 0;
 	parser->header = 0;
 	parser->footer = 0;
@@ -149,8 +559,6 @@ oceanic_atom2_parser_create (dc_parser_t **out, dc_context_t *context, const uns
 	parser->divetime = 0;
 	parser->maxdepth = 0.0;
 
-	*out = (dc_parser_t*) parser;
-
 	return DC_STATUS_SUCCESS;
 }
 
@@ -447,6 +855,25 @@ oceanic_atom2_parser_cache (oceanic_atom2_parser_t *parser)
 }
 
 
+static unsigned int
+oceanic_atom2_parser_interval (oceanic_atom2_parser_t *parser)
+{
+	const unsigned char *data = parser->base.data;
+
+	unsigned int interval = 1000;
+	if (parser->mode != FREEDIVE) {
+		const unsigned int intervals[] = {2000, 15000, 30000, 60000};
+		unsigned int idx = data[parser->layout.interval] & 0x03;
+		interval = intervals[idx];
+	} else if (parser->model == F11A || parser->model == F11B) {
+		const unsigned int intervals[] = {250, 500, 1000, 2000};
+		unsigned int idx = data[0x29] & 0x03;
+		interval = intervals[idx];
+	}
+
+	return interval;
+}
+
 static dc_status_t
 oceanic_atom2_parser_get_field (dc_parser_t *abstract, dc_field_type_t type, unsigned int flags, void *value)
 {
@@ -459,8 +886,14 @@ oceanic_atom2_parser_get_field (dc_parser_t *abstract, dc_field_type_t type, uns
 	if (status != DC_STATUS_SUCCESS)
 		return status;
 
+	// The dive time is stored in the header for some models only. For
+	// all other models, and only for that field, the profile is needed.
+	unsigned int summary = parser->model == F10A || parser->model == F10B ||
+		parser->model == F11A || parser->model == F11B ||
+		parser->model == MUNDIAL2 || parser->model == MUNDIAL3;
+
 	// Cache the profile data.
-	if (parser->cached < PROFILE) {
+	if (type == DC_FIELD_DIVETIME && !summary && parser->cached < PROFILE) {
 		sample_statistics_t statistics = SAMPLE_STATISTICS_INITIALIZER;
 		status = oceanic_atom2_parser_samples_foreach (
 			abstract, sample_statistics_cb, &statistics);
@@ -475,23 +908,20 @@ oceanic_atom2_parser_get_field (dc_parser_t *abstract, dc_field_type_t type, uns
 	dc_gasmix_t *gasmix = (dc_gasmix_t *) value;
 	dc_salinity_t *water = (dc_salinity_t *) value;
 	dc_field_string_t *string = (dc_field_string_t *) value;
+	dc_sample_interval_t *interval = (dc_sample_interval_t *) value;
 
 	char buf[BUF_LEN];
 
 	if (value) {
 		switch (type) {
 		case DC_FIELD_DIVETIME:
-			if (parser->model == F10A || parser->model == F10B ||
-				parser->model == F11A || parser->model == F11B ||
-				parser->model == MUNDIAL2 || parser->model == MUNDIAL3)
+			if (summary)
 				*((unsigned int *) value) = bcd2dec (data[2]) + bcd2dec (data[3]) * 60;
 			else
 				*((unsigned int *) value) = parser->divetime;
 			break;
 		case DC_FIELD_MAXDEPTH:
-			if (parser->model == F10A || parser->model == F10B ||
-				parser->model == F11A || parser->model == F11B ||
-				parser->model == MUNDIAL2 || parser->model == MUNDIAL3)
+			if (summary)
 				*((double *) value) = array_uint16_le (data + 4) / 16.0 * FEET;
 			else
 				*((double *) value) = (array_uint16_le (data + parser->footer + 4) & 0x0FFF) / 16.0 * FEET;
@@ -544,6 +974,12 @@ oceanic_atom2_parser_get_field (dc_parser_t *abstract, dc_field_type_t type, uns
 			}
 			string->value = strdup(buf);
 			break;
+		case DC_FIELD_SAMPLE_INTERVAL:
+			// With a timestamp in every sample, the samples are not
+			// necessarily recorded at the nominal interval.
+			interval->interval = oceanic_atom2_parser_interval (parser);
+			interval->regular = !parser->layout.timestamp;
+			break;
 		default:
 			return DC_STATUS_UNSUPPORTED;
 		}
@@ -602,59 +1038,23 @@ oceanic_atom2_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_
 	if (status != DC_STATUS_SUCCESS)
 		return status;
 
+	const oceanic_atom2_layout_t *layout = &parser->layout;
+
 	unsigned int extratime = 0;
 	unsigned int time = 0;
-	unsigned int interval = 1000;
-	if (parser->mode != FREEDIVE) {
-		unsigned int offset = 0x17;
-		if (parser->model == A300CS || parser->model == VTX ||
-			parser->model == I450T || parser->model == I750TC ||
-			parser->model == PROPLUSX || parser->model == I770R ||
-			parser->model == SAGE || parser->model == BEACON)
-			offset = 0x1f;
-		const unsigned int intervals[] = {2000, 15000, 30000, 60000};
-		unsigned int idx = data[offset] & 0x03;
-		interval = intervals[idx];
-	} else if (parser->model == F11A || parser->model == F11B) {
-		const unsigned int intervals[] = {250, 500, 1000, 2000};
-		unsigned int idx = data[0x29] & 0x03;
-		interval = intervals[idx];
-	}
+	unsigned int interval = oceanic_atom2_parser_interval (parser);
 
-	unsigned int samplesize = PAGESIZE / 2;
+	unsigned int samplesize = layout->samplesize;
+	unsigned int (*decode_depth) (const unsigned char *) = layout->decode_depth;
 	if (parser->mode == FREEDIVE) {
-		if (parser->model == F10A || parser->model == F10B ||
-			parser->model == F11A || parser->model == F11B ||
-			parser->model == MUNDIAL2 || parser->model == MUNDIAL3) {
-			samplesize = 2;
-		} else {
-			samplesize = 4;
-		}
-	} else if (parser->model == OC1A || parser->model == OC1B ||
-		parser->model == OC1C || parser->model == OCI ||
-		parser->model == TX1 || parser->model == A300CS ||
-		parser->model == VTX || parser->model == I450T ||
-		parser->model == I750TC || parser->model == PROPLUSX ||
-		parser->model == I770R || parser->model == I470TC ||
-		parser->model == SAGE || parser->model == BEACON ||
-		parser->model == GEOAIR) {
-		samplesize = PAGESIZE;
+		samplesize = layout->freedive;
+		decode_depth = oceanic_atom2_depth_freedive;
 	}
 
-	unsigned int have_temperature = 1, have_pressure = 1;
+	unsigned int have_temperature = 1, have_pressure = layout->have_pressure;
 	if (parser->mode == FREEDIVE) {
 		have_temperature = 0;
 		have_pressure = 0;
-	} else if (parser->model == VEO30 || parser->model == OCS ||
-		parser->model == ELEMENT2 || parser->model == VEO20 ||
-		parser->model == A300 || parser->model == ZEN ||
-		parser->model == GEO || parser->model == GEO20 ||
-		parser->model == MANTA || parser->model == I300 ||
-		parser->model == I200 || parser->model == I100 ||
-		parser->model == I300C || parser->model == TALIS ||
-		parser->model == I200C || parser->model == I200CV2 ||
-		parser->model == GEO40 || parser->model == VEO40) {
-		have_pressure = 0;
 	}
 
 	// Initial temperature.
@@ -667,11 +1067,7 @@ oceanic_atom2_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_
 	unsigned int tank = 0;
 	unsigned int pressure = 0;
 	if (have_pressure) {
-		unsigned int idx = 2;
-		if (parser->model == A300CS || parser->model == VTX ||
-			parser->model == I750TC || parser->model == I770R)
-			idx = 16;
-		pressure = array_uint16_le(data + parser->header + idx);
+		pressure = array_uint16_le(data + parser->header + layout->pressure);
 		if (pressure == 10000)
 			have_pressure = 0;
 	}
@@ -717,24 +1113,7 @@ oceanic_atom2_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_
 
 		// Check for a tank switch sample.
 		if (sampletype == 0xAA) {
-			if (parser->model == DATAMASK || parser->model == COMPUMASK) {
-				// Tank pressure (1 psi) and number
-				tank = 0;
-				pressure = (((data[offset + 7] << 8) + data[offset + 6]) & 0x0FFF);
-			} else if (parser->model == A300CS || parser->model == VTX ||
-				parser->model == I750TC || parser->model == I770R ||
-				parser->model == SAGE || parser->model == BEACON) {
-				// Tank pressure (1 psi) and number (one based index)
-				tank = (data[offset + 1] & 0x03) - 1;
-				pressure = ((data[offset + 7] << 8) + data[offset + 6]) & 0x0FFF;
-			} else {
-				// Tank pressure (2 psi) and number (one based index)
-				tank = (data[offset + 1] & 0x03) - 1;
-				if (parser->model == ATOM2 || parser->model == EPICA || parser->model == EPICB)
-					pressure = (((data[offset + 3] << 8) + data[offset + 4]) & 0x0FFF) * 2;
-				else
-					pressure = (((data[offset + 4] << 8) + data[offset + 5]) & 0x0FFF) * 2;
-			}
+			pressure = layout->decode_tankswitch (data + offset, &tank);
 		} else if (sampletype == 0xBB) {
 			// The surface time is not always a nice multiple of the samplerate.
 			// The number of inserted surface samples is therefore rounded down
@@ -765,7 +1144,7 @@ oceanic_atom2_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_
 			extratime += surftime;
 		} else {
 			// Time.
-			if (parser->model == I450T || parser->model == I470TC) {
+			if (layout->timestamp) {
 				unsigned int minute = bcd2dec(data[offset + 0]);
 				unsigned int hour   = bcd2dec(data[offset + 1] & 0x0F);
 				unsigned int second = bcd2dec(data[offset + 2]);
@@ -793,165 +1172,42 @@ oceanic_atom2_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_
 
 			// Temperature (°F)
 			if (have_temperature) {
-				if (parser->model == GEO || parser->model == ATOM1 ||
-					parser->model == ELEMENT2 || parser->model == MANTA ||
-					parser->model == ZEN) {
-					temperature = data[offset + 6];
-				} else if (parser->model == TALIS) {
-					temperature = data[offset + 7];
-				} else if (parser->model == GEO20 || parser->model == VEO20 ||
-					parser->model == VEO30 || parser->model == OC1A ||
-					parser->model == OC1B || parser->model == OC1C ||
-					parser->model == OCI || parser->model == A300 ||
-					parser->model == I450T || parser->model == I300 ||
-					parser->model == I200 || parser->model == I100 ||
-					parser->model == I300C || parser->model == I200C ||
-					parser->model == GEO40 || parser->model == VEO40 ||
-					parser->model == I470TC || parser->model == I200CV2 ||
-					parser->model == GEOAIR) {
-					temperature = data[offset + 3];
-				} else if (parser->model == OCS || parser->model == TX1) {
-					temperature = data[offset + 1];
-				} else if (parser->model == VT4 || parser->model == VT41 ||
-					parser->model == ATOM3 || parser->model == ATOM31 ||
-					parser->model == A300AI || parser->model == VISION ||
-					parser->model == XPAIR) {
-					temperature = ((data[offset + 7] & 0xF0) >> 4) | ((data[offset + 7] & 0x0C) << 2) | ((data[offset + 5] & 0x0C) << 4);
-				} else if (parser->model == A300CS || parser->model == VTX ||
-					parser->model == I750TC || parser->model == PROPLUSX ||
-					parser->model == I770R|| parser->model == SAGE ||
-					parser->model == BEACON) {
-					temperature = data[offset + 11];
-				} else {
-					unsigned int sign;
-					if (parser->model == DG03 || parser->model == PROPLUS3 ||
-						parser->model == I550 || parser->model == I550C ||
-						parser->model == PROPLUS4 || parser->model == WISDOM4)
-						sign = (~data[offset + 5] & 0x04) >> 2;
-					else if (parser->model == VOYAGER2G || parser->model == AMPHOS ||
-						parser->model == AMPHOSAIR || parser->model == ZENAIR ||
-						parser->model == AMPHOS2 || parser->model == AMPHOSAIR2)
-						sign = (data[offset + 5] & 0x04) >> 2;
-					else if (parser->model == ATOM2 || parser->model == PROPLUS21 ||
-						parser->model == EPICA || parser->model == EPICB ||
-						parser->model == ATMOSAI2 ||
-						parser->model == WISDOM2 || parser->model == WISDOM3)
-						sign = (data[offset + 0] & 0x80) >> 7;
-					else
-						sign = (~data[offset + 0] & 0x80) >> 7;
-					if (sign)
-						temperature -= (data[offset + 7] & 0x0C) >> 2;
-					else
-						temperature += (data[offset + 7] & 0x0C) >> 2;
-				}
+				temperature = layout->decode_temperature (layout, data + offset, temperature);
 				sample.temperature = (temperature - 32.0) * (5.0 / 9.0);
 				if (callback) callback (DC_SAMPLE_TEMPERATURE, &sample, userdata);
 			}
 
 			// Tank Pressure (psi)
 			if (have_pressure) {
-				if (parser->model == OC1A || parser->model == OC1B ||
-					parser->model == OC1C || parser->model == OCI ||
-					parser->model == I450T || parser->model == I470TC ||
-					parser->model == GEOAIR)
-					pressure = (data[offset + 10] + (data[offset + 11] << 8)) & 0x0FFF;
-				else if (parser->model == VT4 || parser->model == VT41||
-					parser->model == ATOM3 || parser->model == ATOM31 ||
-					parser->model == ZENAIR ||parser->model == A300AI ||
-					parser->model == DG03 || parser->model == PROPLUS3 ||
-					parser->model == AMPHOSAIR || parser->model == I550 ||
-					parser->model == VISION || parser->model == XPAIR ||
-					parser->model == I550C || parser->model == PROPLUS4 ||
-					parser->model == WISDOM4 || parser->model == AMPHOSAIR2)
-					pressure = (((data[offset + 0] & 0x03) << 8) + data[offset + 1]) * 5;
-				else if (parser->model == TX1 || parser->model == A300CS ||
-					parser->model == VTX || parser->model == I750TC ||
-					parser->model == PROPLUSX || parser->model == I770R ||
-					parser->model == SAGE || parser->model == BEACON)
-					pressure = array_uint16_le (data + offset + 4);
-				else
-					pressure -= data[offset + 1];
+				pressure = layout->decode_pressure (data + offset, pressure);
 				sample.pressure.tank = tank;
 				sample.pressure.value = pressure * PSI / BAR;
 				if (callback) callback (DC_SAMPLE_PRESSURE, &sample, userdata);
 			}
 
 			// Depth (1/16 ft)
-			unsigned int depth;
-			if (parser->mode == FREEDIVE)
-				depth = array_uint16_le (data + offset);
-			else if (parser->model == GEO20 || parser->model == VEO20 ||
-				parser->model == VEO30 || parser->model == OC1A ||
-				parser->model == OC1B || parser->model == OC1C ||
-				parser->model == OCI || parser->model == A300 ||
-				parser->model == I450T || parser->model == I300 ||
-				parser->model == I200 || parser->model == I100 ||
-				parser->model == I300C || parser->model == I200C ||
-				parser->model == GEO40 || parser->model == VEO40 ||
-				parser->model == I470TC || parser->model == I200CV2 ||
-				parser->model == GEOAIR)
-				depth = (data[offset + 4] + (data[offset + 5] << 8)) & 0x0FFF;
-			else if (parser->model == ATOM1)
-				depth = data[offset + 3] * 16;
-			else
-				depth = (data[offset + 2] + (data[offset + 3] << 8)) & 0x0FFF;
+			unsigned int depth = decode_depth (data + offset);
 			sample.depth = depth / 16.0 * FEET;
 			if (callback) callback (DC_SAMPLE_DEPTH, &sample, userdata);
 
 			// Gas mix
-			unsigned int have_gasmix = 0;
-			unsigned int gasmix = 0;
-			if (parser->model == TX1) {
-				gasmix = data[offset] & 0x07;
-				have_gasmix = 1;
-			}
-			if (have_gasmix && gasmix != gasmix_previous) {
-				if (gasmix < 1 || gasmix > parser->ngasmixes) {
-					ERROR (abstract->context, "Invalid gas mix index (%u).", gasmix);
-					return DC_STATUS_DATAFORMAT;
+			if (layout->gasmix_mask) {
+				unsigned int gasmix = data[offset] & layout->gasmix_mask;
+				if (gasmix != gasmix_previous) {
+					if (gasmix < 1 || gasmix > parser->ngasmixes) {
+						ERROR (abstract->context, "Invalid gas mix index (%u).", gasmix);
+						return DC_STATUS_DATAFORMAT;
+					}
+					sample.gasmix = gasmix - 1;
+					if (callback) callback (DC_SAMPLE_GASMIX, &sample, userdata);
+					gasmix_previous = gasmix;
 				}
-				sample.gasmix = gasmix - 1;
-				if (callback) callback (DC_SAMPLE_GASMIX, &sample, userdata);
-				gasmix_previous = gasmix;
 			}
 
 			// NDL / Deco
-			unsigned int have_deco = 0;
-			unsigned int decostop = 0, decotime = 0;
-			if (parser->model == A300CS || parser->model == VTX ||
-				parser->model == I750TC || parser->model == SAGE ||
-				parser->model == PROPLUSX || parser->model == I770R ||
-				parser->model == BEACON) {
-				decostop = (data[offset + 15] & 0x70) >> 4;
-				decotime = array_uint16_le(data + offset + 6) & 0x03FF;
-				have_deco = 1;
-			} else if (parser->model == ZEN || parser->model == DG03) {
-				decostop = (data[offset + 5] & 0xF0) >> 4;
-				decotime = array_uint16_le(data + offset + 4) & 0x0FFF;
-				have_deco = 1;
-			} else if (parser->model == TX1) {
-				decostop = data[offset + 10];
-				decotime = array_uint16_le(data + offset + 6);
-				have_deco = 1;
-			} else if (parser->model == ATOM31 || parser->model == VISION ||
-				parser->model == XPAIR || parser->model == I550 ||
-				parser->model == I550C || parser->model == WISDOM4) {
-				decostop = (data[offset + 5] & 0xF0) >> 4;
-				decotime = array_uint16_le(data + offset + 4) & 0x03FF;
-				have_deco = 1;
-			} else if (parser->model == I200 || parser->model == I300 ||
-				parser->model == OC1A || parser->model == OC1B ||
-				parser->model == OC1C || parser->model == OCI ||
-				parser->model == I100 || parser->model == I300C ||
-				parser->model == I450T || parser->model == I200C ||
-				parser->model == GEO40 || parser->model == VEO40 ||
-				parser->model == I470TC || parser->model == I200CV2 ||
-				parser->model == GEOAIR) {
-				decostop = (data[offset + 7] & 0xF0) >> 4;
-				decotime = array_uint16_le(data + offset + 6) & 0x0FFF;
-				have_deco = 1;
-			}
-			if (have_deco) {
+			if (layout->decotime_mask) {
+				unsigned int decostop = (data[offset + layout->decostop_offset] & layout->decostop_mask) >> layout->decostop_shift;
+				unsigned int decotime = array_uint16_le (data + offset + layout->decotime_offset) & layout->decotime_mask;
 				if (decostop) {
 					sample.deco.type = DC_DECO_DECOSTOP;
 					sample.deco.depth = decostop * 10 * FEET;
@@ -964,37 +1220,14 @@ oceanic_atom2_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_
 				if (callback) callback (DC_SAMPLE_DECO, &sample, userdata);
 			}
 
-			unsigned int have_rbt = 0;
-			unsigned int rbt = 0;
-			if (parser->model == ATOM31) {
-				rbt = array_uint16_le(data + offset + 6) & 0x01FF;
-				have_rbt = 1;
-			} else if (parser->model == I450T || parser->model == OC1A ||
-				parser->model == OC1B || parser->model == OC1C ||
-				parser->model == OCI || parser->model == PROPLUSX ||
-				parser->model == I770R || parser->model == I470TC ||
-				parser->model == GEOAIR) {
-				rbt = array_uint16_le(data + offset + 8) & 0x01FF;
-				have_rbt = 1;
-			} else if (parser->model == VISION || parser->model == XPAIR ||
-				parser->model == I550 || parser->model == I550C ||
-				parser->model == WISDOM4) {
-				rbt = array_uint16_le(data + offset + 6) & 0x03FF;
-				have_rbt = 1;
-			}
-			if (have_rbt) {
-				sample.rbt = rbt;
+			// Remaining bottom time
+			if (layout->rbt_mask) {
+				sample.rbt = array_uint16_le (data + offset + layout->rbt_offset) & layout->rbt_mask;
 				if (callback) callback (DC_SAMPLE_RBT, &sample, userdata);
 			}
 
 			// Bookmarks
-			unsigned int have_bookmark = 0;
-			if (parser->model == OC1A || parser->model == OC1B ||
-				parser->model == OC1C || parser->model == OCI ||
-				parser->model == GEOAIR) {
-				have_bookmark = data[offset + 12] & 0x80;
-			}
-			if (have_bookmark) {
+			if (layout->bookmark_mask && (data[offset + 12] & layout->bookmark_mask)) {
 				sample.event.type = SAMPLE_EVENT_BOOKMARK;
 				sample.event.time = 0;
 				sample.event.flags = 0;
@@ -40,6 +40,8 @@
 
 #define INVALID 0
 
+#define UNCACHED 0xFFFFFFFF
+
 static unsigned int
 get_profile_first (const unsigned char data[], const oceanic_common_layout_t *layout, unsigned int pagesize)
 {
@@ -163,6 +165,61 @@ oceanic_common_device_init (oceanic_common_device_t *device)
 	device->model = 0;
 	device->layout = NULL;
 	device->multipage = 1;
+	oceanic_common_cache_invalidate (&device->cache);
+	device->cache.hits = 0;
+	device->cache.misses = 0;
+}
+
+
+void
+oceanic_common_cache_invalidate (oceanic_common_cache_t *cache)
+{
+	for (unsigned int i = 0; i < NCACHE; ++i) {
+		cache->pages[i].page = UNCACHED;
+		cache->pages[i].highmem = UNCACHED;
+		cache->pages[i].stamp = 0;
+	}
+	cache->stamp = 0;
+}
+
+
+oceanic_common_page_t *
+oceanic_common_cache_lookup (oceanic_common_cache_t *cache, unsigned int page, unsigned int highmem, unsigned int *hit)
+{
+	oceanic_common_page_t *victim = cache->pages;
+
+	for (unsigned int i = 0; i < NCACHE; ++i) {
+		oceanic_common_page_t *entry = cache->pages + i;
+		if (entry->page == page && entry->highmem == highmem) {
+			entry->stamp = ++cache->stamp;
+			cache->hits++;
+			*hit = 1;
+			return entry;
+		}
+
+		// Remember the least recently used entry. Unused entries have
+		// a zero stamp and are therefore always picked first.
+		if (entry->stamp < victim->stamp)
+			victim = entry;
+	}
+
+	// Invalidate the entry, in case the transfer fails.
+	victim->page = UNCACHED;
+	victim->highmem = UNCACHED;
+	victim->stamp = 0;
+
+	cache->misses++;
+	*hit = 0;
+	return victim;
+}
+
+
+void
+oceanic_common_cache_insert (oceanic_common_cache_t *cache, oceanic_common_page_t *entry, unsigned int page, unsigned int highmem)
+{
+	entry->page = page;
+	entry->highmem = highmem;
+	entry->stamp = ++cache->stamp;
 }
 
 
@@ -189,6 +246,207 @@ oceanic_common_device_set_fingerprint (dc_device_t *abstract, const unsigned cha
 }
 
 
+/*
+ * Read the marked pages, merging adjacent pages into larger transfers.
+ */
+static dc_status_t
+oceanic_common_read_pages (dc_device_t *abstract, unsigned char data[], unsigned int address, const unsigned char marks[], unsigned int npages, unsigned int pagesize, dc_event_progress_t *progress)
+{
+	oceanic_common_device_t *device = (oceanic_common_device_t *) abstract;
+	dc_status_t rc = DC_STATUS_SUCCESS;
+
+	unsigned int blocksize = PAGESIZE * device->multipage;
+
+	unsigned int i = 0;
+	while (i < npages) {
+		if (!marks[i]) {
+			i++;
+			continue;
+		}
+
+		unsigned int n = 1;
+		while (i + n < npages && marks[i + n])
+			n++;
+
+		unsigned int begin = address + i * pagesize;
+		unsigned int end = begin + n * pagesize;
+		while (begin < end) {
+			unsigned int len = end - begin;
+			if (len > blocksize)
+				len = blocksize;
+
+			rc = dc_device_read (abstract, begin, data + begin, len);
+			if (rc != DC_STATUS_SUCCESS) {
+				ERROR (abstract->context, "Failed to read the memory.");
+				return rc;
+			}
+
+			begin += len;
+
+			progress->current += len;
+			device_event_emit (abstract, DC_EVENT_PROGRESS, progress);
+		}
+
+		i += n;
+	}
+
+	return DC_STATUS_SUCCESS;
+}
+
+
+/*
+ * Incremental memory dump. The memory outside the profile ringbuffer,
+ * including the logbook ringbuffer, is always downloaded. From the
+ * profile ringbuffer, only the profiles of the new or modified logbook
+ * entries are downloaded, and everything else is copied from the
+ * previous dump. Returns DC_STATUS_UNSUPPORTED if the previous dump
+ * can't be used.
+ */
+static dc_status_t
+oceanic_common_device_dump_incremental (dc_device_t *abstract, const unsigned char previous[], unsigned char data[])
+{
+	oceanic_common_device_t *device = (oceanic_common_device_t *) abstract;
+	dc_status_t rc = DC_STATUS_SUCCESS;
+
+	const oceanic_common_layout_t *layout = device->layout;
+
+	unsigned int pagesize = layout->highmem ? 16 * PAGESIZE : PAGESIZE;
+
+	// The logbook entries are needed to locate the profiles, and the
+	// device info to make sure the previous dump is from the same device.
+	if (layout->rb_logbook_begin == layout->rb_logbook_end ||
+		layout->rb_profile_begin == layout->rb_profile_end ||
+		layout->rb_profile_end > layout->memsize ||
+		(layout->rb_profile_begin % pagesize) != 0 ||
+		(layout->rb_profile_end - layout->rb_profile_begin) % pagesize != 0 ||
+		(layout->cf_devinfo + PAGESIZE > layout->rb_profile_begin &&
+		layout->cf_devinfo < layout->rb_profile_end))
+		return DC_STATUS_UNSUPPORTED;
+
+	unsigned int npages = layout->memsize / PAGESIZE;
+	unsigned int nprofile = (layout->rb_profile_end - layout->rb_profile_begin) / pagesize;
+
+	unsigned char *marks = (unsigned char *) malloc (npages > nprofile ? npages : nprofile);
+	if (marks == NULL) {
+		ERROR (abstract->context, "Failed to allocate memory.");
+		return DC_STATUS_NOMEMORY;
+	}
+
+	// Enable progress notifications. The maximum is reduced once the
+	// size of the modified profiles is known.
+	dc_event_progress_t progress = EVENT_PROGRESS_INITIALIZER;
+	progress.maximum = layout->memsize;
+	device_event_emit (abstract, DC_EVENT_PROGRESS, &progress);
+
+	// Download everything outside the profile ringbuffer.
+	for (unsigned int i = 0; i < npages; ++i) {
+		unsigned int address = i * PAGESIZE;
+		marks[i] = address < layout->rb_profile_begin || address >= layout->rb_profile_end;
+	}
+
+	rc = oceanic_common_read_pages (abstract, data, 0, marks, npages, PAGESIZE, &progress);
+	if (rc != DC_STATUS_SUCCESS)
+		goto error_free;
+
+	if (memcmp (data + layout->cf_devinfo, previous + layout->cf_devinfo, PAGESIZE) != 0) {
+		WARNING (abstract->context, "The previous dump is from a different device.");
+		rc = DC_STATUS_UNSUPPORTED;
+		goto error_free;
+	}
+
+	unsigned int rb_logbook_last = array_uint16_le (data + layout->cf_pointers + 6);
+	if (rb_logbook_last < layout->rb_logbook_begin ||
+		rb_logbook_last >= layout->rb_logbook_end)
+	{
+		ERROR (abstract->context, "Invalid logbook end pointer detected (0x%04x).", rb_logbook_last);
+		rc = DC_STATUS_UNSUPPORTED;
+		goto error_free;
+	}
+
+	unsigned int rb_logbook_end = 0;
+	if (layout->pt_mode_global == 0) {
+		rb_logbook_end = RB_LOGBOOK_INCR (rb_logbook_last, layout->rb_logbook_entry_size, layout);
+	} else {
+		rb_logbook_end = rb_logbook_last;
+	}
+
+	// Mark the profile pages of the new and modified logbook entries.
+	// The most recent unmodified entry is used to verify the previous
+	// dump.
+	memset (marks, 0, nprofile);
+	unsigned int check = INVALID;
+	unsigned int nentries = (layout->rb_logbook_end - layout->rb_logbook_begin) / layout->rb_logbook_entry_size;
+	unsigned int entry = rb_logbook_end;
+	for (unsigned int i = 0; i < nentries; ++i) {
+		entry = ringbuffer_decrement (entry, layout->rb_logbook_entry_size, layout->rb_logbook_begin, layout->rb_logbook_end);
+
+		const unsigned char *p = data + entry;
+		if (array_isequal (p, layout->rb_logbook_entry_size, 0xFF))
+			continue;
+
+		unsigned int rb_entry_first = get_profile_first (p, layout, pagesize);
+		unsigned int rb_entry_last  = get_profile_last (p, layout, pagesize);
+		if (rb_entry_first < layout->rb_profile_begin ||
+			rb_entry_first >= layout->rb_profile_end ||
+			rb_entry_last < layout->rb_profile_begin ||
+			rb_entry_last >= layout->rb_profile_end)
+			continue;
+
+		if (memcmp (p, previous + entry, layout->rb_logbook_entry_size) == 0) {
+			if (check == INVALID)
+				check = rb_entry_last;
+			continue;
+		}
+
+		unsigned int page = rb_entry_first;
+		for (unsigned int j = 0; j < nprofile; ++j) {
+			marks[(page - layout->rb_profile_begin) / pagesize] = 1;
+			if (page == rb_entry_last)
+				break;
+			page = RB_PROFILE_INCR (page, pagesize, layout);
+		}
+	}
+
+	unsigned int nbytes = 0;
+	for (unsigned int i = 0; i < nprofile; ++i) {
+		if (marks[i])
+			nbytes += pagesize;
+	}
+
+	// Verify the previous dump with the last page of the most recent
+	// unmodified profile.
+	if (check != INVALID && !marks[(check - layout->rb_profile_begin) / pagesize]) {
+		rc = dc_device_read (abstract, check, data + check, pagesize);
+		if (rc != DC_STATUS_SUCCESS) {
+			ERROR (abstract->context, "Failed to read the memory.");
+			goto error_free;
+		}
+
+		if (memcmp (data + check, previous + check, pagesize) != 0) {
+			WARNING (abstract->context, "The previous dump doesn't match the device.");
+			rc = DC_STATUS_UNSUPPORTED;
+			goto error_free;
+		}
+	}
+
+	progress.maximum -= (layout->rb_profile_end - layout->rb_profile_begin) - nbytes;
+	device_event_emit (abstract, DC_EVENT_PROGRESS, &progress);
+
+	DEBUG (abstract->context, "Incremental dump: %u of %u profile bytes.",
+		nbytes, layout->rb_profile_end - layout->rb_profile_begin);
+
+	// Take the unmodified profiles from the previous dump.
+	memcpy (data + layout->rb_profile_begin, previous + layout->rb_profile_begin,
+		layout->rb_profile_end - layout->rb_profile_begin);
+
+	rc = oceanic_common_read_pages (abstract, data, layout->rb_profile_begin, marks, nprofile, pagesize, &progress);
+
+error_free:
+	free (marks);
+	return rc;
+}
+
+
 dc_status_t
 oceanic_common_device_dump (dc_device_t *abstract, dc_buffer_t *buffer)
 {
@@ -201,6 +459,10 @@ oceanic_common_device_dump (dc_device_t *abstract, dc_buffer_t *buffer)
 	const oceanic_common_layout_t *layout = device->layout;
 
 	// Allocate the required amount of memory.
+	status = dc_context_check_buffer (abstract->context, layout->memsize, "memory dump");
+	if (status != DC_STATUS_SUCCESS)
+		return status;
+
 	if (!dc_buffer_resize (buffer, layout->memsize)) {
 		ERROR (abstract->context, "Insufficient buffer space available.");
 		return DC_STATUS_NOMEMORY;
@@ -212,9 +474,18 @@ oceanic_common_device_dump (dc_device_t *abstract, dc_buffer_t *buffer)
 	vendor.size = sizeof (device->version);
 	device_event_emit (abstract, DC_EVENT_VENDOR, &vendor);
 
-	// Download the memory dump.
-	status = device_dump_read (abstract, 0, dc_buffer_get_data (buffer),
-		dc_buffer_get_size (buffer), PAGESIZE * device->multipage);
+	// Download the memory dump, incrementally if possible.
+	status = DC_STATUS_UNSUPPORTED;
+	const unsigned char *previous = device_dump_previous (abstract, layout->memsize);
+	if (previous) {
+		status = oceanic_common_device_dump_incremental (abstract, previous, dc_buffer_get_data (buffer));
+		if (status == DC_STATUS_UNSUPPORTED)
+			WARNING (abstract->context, "Falling back to a full memory dump.");
+	}
+	if (status == DC_STATUS_UNSUPPORTED) {
+		status = device_dump_read (abstract, 0, dc_buffer_get_data (buffer),
+			dc_buffer_get_size (buffer), PAGESIZE * device->multipage);
+	}
 	if (status != DC_STATUS_SUCCESS) {
 		return status;
 	}
@@ -319,6 +590,10 @@ oceanic_common_device_logbook (dc_device_t *abstract, dc_event_progress_t *progr
 	}
 
 	// Allocate memory for the logbook entries.
+	rc = dc_context_check_buffer (abstract->context, rb_logbook_size, "logbook");
+	if (rc != DC_STATUS_SUCCESS)
+		return rc;
+
 	if (!dc_buffer_resize (logbook, rb_logbook_size))
 		return DC_STATUS_NOMEMORY;
 
@@ -410,12 +685,23 @@ oceanic_common_device_profile (dc_device_t *abstract, dc_event_progress_t *progr
 	const unsigned char *logbooks = dc_buffer_get_data (logbook);
 	unsigned int rb_logbook_size = dc_buffer_get_size (logbook);
 
+	// Check for a checkpoint of a previously interrupted download.
+	unsigned char cp_first[FPMAXSIZE] = {0}, cp_last[FPMAXSIZE] = {0};
+	unsigned int cp_address = 0;
+	int resume = device_checkpoint_get (abstract, &cp_address, cp_first, cp_last, layout->rb_logbook_entry_size);
+
 	// Go through the logbook entries a first time, to get the end of
 	// profile pointer and calculate the total amount of bytes in the
 	// profile ringbuffer.
 	unsigned int rb_profile_end  = INVALID;
 	unsigned int rb_profile_size = 0;
 
+	// The most recent logbook entry, and the position to resume from.
+	unsigned int newest = INVALID;
+	unsigned int skip_entry = INVALID;
+	unsigned int skip_size = 0;
+	unsigned int skip_previous = INVALID;
+
 	// Traverse the logbook ringbuffer backwards to retrieve the most recent
 	// dives first. The logbook ringbuffer is linearized at this point, so
 	// we do not have to take into account any memory wrapping near the end
@@ -455,6 +741,7 @@ oceanic_common_device_profile (dc_device_t *abstract, dc_event_progress_t *progr
 		// end of profile pointer.
 		if (rb_profile_end == INVALID) {
 			rb_profile_end = previous = rb_entry_end;
+			newest = entry;
 		}
 
 		// Skip gaps between the profiles.
@@ -475,6 +762,30 @@ oceanic_common_device_profile (dc_device_t *abstract, dc_event_progress_t *progr
 
 		remaining -= rb_entry_size + gap;
 		previous = rb_entry_first;
+
+		// Locate the last dive delivered by the interrupted download.
+		if (resume && skip_entry == INVALID && rb_entry_first == cp_address &&
+			memcmp (logbooks + entry, cp_last, layout->rb_logbook_entry_size) == 0)
+		{
+			skip_entry = entry;
+			skip_size = rb_profile_size;
+			skip_previous = rb_entry_first;
+		}
+	}
+
+	// The checkpoint is only valid if no new dives have been recorded
+	// since the interrupted download, and the last delivered dive is
+	// still present. Otherwise the download starts from scratch.
+	if (resume) {
+		if (skip_entry == INVALID ||
+			memcmp (logbooks + newest, cp_first, layout->rb_logbook_entry_size) != 0)
+		{
+			WARNING (abstract->context, "Ignoring outdated checkpoint.");
+			resume = 0;
+		} else {
+			DEBUG (abstract->context, "Resuming the download at address 0x%06x.", skip_previous);
+			rb_profile_size -= skip_size;
+		}
 	}
 
 	// At this point, we know the exact amount of data
@@ -484,35 +795,36 @@ oceanic_common_device_profile (dc_device_t *abstract, dc_event_progress_t *progr
 
 	// Exit if there are no dives.
 	if (rb_profile_size == 0) {
+		if (status == DC_STATUS_SUCCESS)
+			device_checkpoint_clear (abstract);
 		return status;
 	}
 
 	// Create the ringbuffer stream.
 	dc_rbstream_t *rbstream = NULL;
-	rc = dc_rbstream_new (&rbstream, abstract, PAGESIZE, PAGESIZE * device->multipage, layout->rb_profile_begin, layout->rb_profile_end, rb_profile_end);
+	rc = dc_rbstream_new (&rbstream, abstract, PAGESIZE, PAGESIZE * device->multipage, layout->rb_profile_begin, layout->rb_profile_end, resume ? skip_previous : rb_profile_end);
 	if (rc != DC_STATUS_SUCCESS) {
 		ERROR (abstract->context, "Failed to create the ringbuffer stream.");
 		return rc;
 	}
 
-	// Memory buffer for the profile data.
-	unsigned char *profiles = (unsigned char *) malloc (rb_profile_size + rb_logbook_size);
-	if (profiles == NULL) {
+	// Memory buffer for a single dive. Each dive is delivered as soon as
+	// it has been read, so the buffer only needs to be large enough for
+	// the largest dive, and not for the entire profile ringbuffer.
+	dc_buffer_t *dive = dc_buffer_new_context (abstract->context, 0);
+	if (dive == NULL) {
 		ERROR (abstract->context, "Failed to allocate memory.");
 		dc_rbstream_free (rbstream);
 		return DC_STATUS_NOMEMORY;
 	}
 
-	// Keep track of the current position.
-	unsigned int offset = rb_profile_size + rb_logbook_size;
-
 	// Traverse the logbook ringbuffer backwards to retrieve the most recent
 	// dives first. The logbook ringbuffer is linearized at this point, so
 	// we do not have to take into account any memory wrapping near the end
 	// of the memory buffer.
 	remaining = rb_profile_size;
-	previous = rb_profile_end;
-	entry = rb_logbook_size;
+	previous = resume ? skip_previous : rb_profile_end;
+	entry = resume ? skip_entry : rb_logbook_size;
 	while (entry) {
 		// Move to the start of the current entry.
 		entry -= layout->rb_logbook_entry_size;
@@ -554,11 +866,35 @@ oceanic_common_device_profile (dc_device_t *abstract, dc_event_progress_t *progr
 			break;
 		}
 
-		// Move to the start of the current dive.
-		offset -= rb_entry_size + gap;
+		// Skip dives left out by a selective download.
+		if (device_is_excluded (abstract, logbooks + entry, layout->rb_logbook_entry_size)) {
+			rc = dc_rbstream_skip (rbstream, progress, rb_entry_size + gap);
+			if (rc != DC_STATUS_SUCCESS) {
+				ERROR (abstract->context, "Failed to skip the dive.");
+				status = rc;
+				break;
+			}
+			remaining -= rb_entry_size + gap;
+			previous = rb_entry_first;
+			continue;
+		}
+
+		// Allocate memory for the logbook entry and the profile data.
+		dc_buffer_clear (dive);
+		status = dc_context_check_buffer (abstract->context, layout->rb_logbook_entry_size + rb_entry_size + gap, "profile");
+		if (status != DC_STATUS_SUCCESS)
+			break;
+
+		if (!dc_buffer_resize (dive, layout->rb_logbook_entry_size + rb_entry_size + gap)) {
+			ERROR (abstract->context, "Failed to allocate memory.");
+			status = DC_STATUS_NOMEMORY;
+			break;
+		}
+
+		unsigned char *p = dc_buffer_get_data (dive);
 
 		// Read the dive.
-		rc = dc_rbstream_read (rbstream, progress, profiles + offset, rb_entry_size + gap);
+		rc = dc_rbstream_read (rbstream, progress, p + layout->rb_logbook_entry_size, rb_entry_size + gap);
 		if (rc != DC_STATUS_SUCCESS) {
 			ERROR (abstract->context, "Failed to read the dive.");
 			status = rc;
@@ -568,17 +904,15 @@ oceanic_common_device_profile (dc_device_t *abstract, dc_event_progress_t *progr
 		remaining -= rb_entry_size + gap;
 		previous = rb_entry_first;
 
-		// Prepend the logbook entry to the profile data. The memory buffer is
-		// large enough to store this entry.
-		offset -= layout->rb_logbook_entry_size;
-		memcpy (profiles + offset, logbooks + entry, layout->rb_logbook_entry_size);
+		// Prepend the logbook entry to the profile data.
+		memcpy (p, logbooks + entry, layout->rb_logbook_entry_size);
 
 		// Remove padding from the profile.
 		if (layout->highmem) {
 			// The logbook entry contains the total number of pages containing
 			// profile data, excluding the footer page. Limit the profile size
 			// to this size.
-			unsigned int value = array_uint16_le (profiles + offset + 12);
+			unsigned int value = array_uint16_le (p + 12);
 			unsigned int value_hi = value & 0xE000;
 			unsigned int value_lo = value & 0x0FFF;
 			unsigned int npages = ((value_hi >> 1) | value_lo) + 1;
@@ -588,36 +922,37 @@ oceanic_common_device_profile (dc_device_t *abstract, dc_event_progress_t *progr
 			}
 		}
 
-		unsigned char *p = profiles + offset;
-		if (callback && !callback (p, rb_entry_size + layout->rb_logbook_entry_size, p, layout->rb_logbook_entry_size, userdata)) {
+		int more = callback ? callback (p, rb_entry_size + layout->rb_logbook_entry_size, p, layout->rb_logbook_entry_size, userdata) : 1;
+
+		// Update the checkpoint with the last delivered dive.
+		device_checkpoint_set (abstract, rb_entry_first, logbooks + newest, logbooks + entry, layout->rb_logbook_entry_size);
+
+		if (!more) {
 			break;
 		}
 	}
 
+	// Discard the checkpoint once all dives have been delivered.
+	if (entry == 0 && status == DC_STATUS_SUCCESS) {
+		device_checkpoint_clear (abstract);
+	}
+
 	dc_rbstream_free (rbstream);
-	free (profiles);
+	dc_buffer_free (dive);
 
 	return status;
 }
 
 
-dc_status_t
-oceanic_common_device_foreach (dc_device_t *abstract, dc_dive_callback_t callback, void *userdata)
+/*
+ * Read the device id, and emit the vendor and device info events.
+ */
+static dc_status_t
+oceanic_common_device_id (dc_device_t *abstract, dc_event_progress_t *progress)
 {
 	oceanic_common_device_t *device = (oceanic_common_device_t *) abstract;
-
-	assert (device != NULL);
-	assert (device->layout != NULL);
-
 	const oceanic_common_layout_t *layout = device->layout;
 
-	// Enable progress notifications.
-	dc_event_progress_t progress = EVENT_PROGRESS_INITIALIZER;
-	progress.maximum = PAGESIZE +
-		(layout->rb_logbook_end - layout->rb_logbook_begin) +
-		(layout->rb_profile_end - layout->rb_profile_begin);
-	device_event_emit (abstract, DC_EVENT_PROGRESS, &progress);
-
 	// Emit a vendor event.
 	dc_event_vendor_t vendor;
 	vendor.data = device->version;
@@ -633,8 +968,8 @@ oceanic_common_device_foreach (dc_device_t *abstract, dc_dive_callback_t callbac
 	}
 
 	// Update and emit a progress event.
-	progress.current += PAGESIZE;
-	device_event_emit (abstract, DC_EVENT_PROGRESS, &progress);
+	progress->current += PAGESIZE;
+	device_event_emit (abstract, DC_EVENT_PROGRESS, progress);
 
 	// Emit a device info event.
 	dc_event_devinfo_t devinfo;
@@ -651,14 +986,42 @@ oceanic_common_device_foreach (dc_device_t *abstract, dc_dive_callback_t callbac
 			(id[13] & 0x0F) * 10     + ((id[13] & 0xF0) >> 4) * 1;
 	device_event_emit (abstract, DC_EVENT_DEVINFO, &devinfo);
 
+	return DC_STATUS_SUCCESS;
+}
+
+
+dc_status_t
+oceanic_common_device_foreach (dc_device_t *abstract, dc_dive_callback_t callback, void *userdata)
+{
+	oceanic_common_device_t *device = (oceanic_common_device_t *) abstract;
+
+	assert (device != NULL);
+	assert (device->layout != NULL);
+
+	const oceanic_common_layout_t *layout = device->layout;
+
+	// Enable progress notifications.
+	dc_event_progress_t progress = EVENT_PROGRESS_INITIALIZER;
+	progress.maximum = PAGESIZE +
+		(layout->rb_logbook_end - layout->rb_logbook_begin) +
+		(layout->rb_profile_end - layout->rb_profile_begin);
+	device_event_emit (abstract, DC_EVENT_PROGRESS, &progress);
+
+	dc_status_t rc = oceanic_common_device_id (abstract, &progress);
+	if (rc != DC_STATUS_SUCCESS) {
+		return rc;
+	}
+
 	// Memory buffer for the logbook data.
-	dc_buffer_t *logbook = dc_buffer_new (0);
+	dc_buffer_t *logbook = dc_buffer_new_context (abstract->context, 0);
 	if (logbook == NULL) {
 		return DC_STATUS_NOMEMORY;
 	}
 
 	// Download the logbook ringbuffer.
+	device_phase_t phase = device_phase_set (abstract, DEVICE_PHASE_LOGBOOK);
 	rc = VTABLE(abstract)->logbook (abstract, &progress, logbook);
+	device_phase_set (abstract, phase);
 	if (rc != DC_STATUS_SUCCESS) {
 		dc_buffer_free (logbook);
 		return rc;
@@ -681,3 +1044,59 @@ oceanic_common_device_foreach (dc_device_t *abstract, dc_dive_callback_t callbac
 
 	return DC_STATUS_SUCCESS;
 }
+
+
+dc_status_t
+oceanic_common_device_foreach_header (dc_device_t *abstract, dc_dive_callback_t callback, void *userdata)
+{
+	oceanic_common_device_t *device = (oceanic_common_device_t *) abstract;
+
+	assert (device != NULL);
+	assert (device->layout != NULL);
+
+	const oceanic_common_layout_t *layout = device->layout;
+
+	// Enable progress notifications.
+	dc_event_progress_t progress = EVENT_PROGRESS_INITIALIZER;
+	progress.maximum = PAGESIZE +
+		(layout->rb_logbook_end - layout->rb_logbook_begin);
+	device_event_emit (abstract, DC_EVENT_PROGRESS, &progress);
+
+	dc_status_t rc = oceanic_common_device_id (abstract, &progress);
+	if (rc != DC_STATUS_SUCCESS) {
+		return rc;
+	}
+
+	// Memory buffer for the logbook data.
+	dc_buffer_t *logbook = dc_buffer_new_context (abstract->context, 0);
+	if (logbook == NULL) {
+		return DC_STATUS_NOMEMORY;
+	}
+
+	// Download the logbook ringbuffer, which contains only the new
+	// entries, ordered from the oldest to the most recent one.
+	rc = VTABLE(abstract)->logbook (abstract, &progress, logbook);
+	if (rc != DC_STATUS_SUCCESS) {
+		dc_buffer_free (logbook);
+		return rc;
+	}
+
+	const unsigned char *data = dc_buffer_get_data (logbook);
+	unsigned int entry = dc_buffer_get_size (logbook);
+	while (entry >= layout->rb_logbook_entry_size) {
+		entry -= layout->rb_logbook_entry_size;
+
+		const unsigned char *p = data + entry;
+
+		// Skip uninitialized entries.
+		if (array_isequal (p, layout->rb_logbook_entry_size, 0xFF))
+			continue;
+
+		if (callback && !callback (p, layout->rb_logbook_entry_size, p, layout->rb_logbook_entry_size, userdata))
+			break;
+	}
+
+	dc_buffer_free (logbook);
+
+	return DC_STATUS_SUCCESS;
+}
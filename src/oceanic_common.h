@@ -128,6 +128,8 @@ extern "C" {
 #define PAGESIZE 0x10
 #define FPMAXSIZE 0x20
 
+#define NCACHE 8
+
 #define OCEANIC_COMMON_MATCH(version,patterns,firmware) \
 	oceanic_common_match ((version), (patterns), \
 	sizeof (patterns) / sizeof *(patterns), (firmware))
@@ -156,6 +158,24 @@ typedef struct oceanic_common_layout_t {
 	unsigned int pt_mode_serial;
 } oceanic_common_layout_t;
 
+typedef struct oceanic_common_page_t {
+	unsigned int page;
+	unsigned int highmem;
+	unsigned int stamp;
+	unsigned char data[256];
+} oceanic_common_page_t;
+
+/*
+ * Least recently used cache of the pages read from the device, such
+ * that the overlapping logbook and profile reads are not sent twice.
+ */
+typedef struct oceanic_common_cache_t {
+	oceanic_common_page_t pages[NCACHE];
+	unsigned int stamp;
+	unsigned int hits;
+	unsigned int misses;
+} oceanic_common_cache_t;
+
 typedef struct oceanic_common_device_t {
 	dc_device_t base;
 	unsigned int firmware;
@@ -164,6 +184,7 @@ typedef struct oceanic_common_device_t {
 	unsigned int model;
 	const oceanic_common_layout_t *layout;
 	unsigned int multipage;
+	oceanic_common_cache_t cache;
 } oceanic_common_device_t;
 
 typedef struct oceanic_common_device_vtable_t {
@@ -185,6 +206,20 @@ oceanic_common_match (const unsigned char *version, const oceanic_common_version
 void
 oceanic_common_device_init (oceanic_common_device_t *device);
 
+void
+oceanic_common_cache_invalidate (oceanic_common_cache_t *cache);
+
+/*
+ * Lookup a page in the cache. On a miss, the least recently used entry
+ * is returned, invalidated, and the caller fills it with
+ * oceanic_common_cache_insert after the page has been read.
+ */
+oceanic_common_page_t *
+oceanic_common_cache_lookup (oceanic_common_cache_t *cache, unsigned int page, unsigned int highmem, unsigned int *hit);
+
+void
+oceanic_common_cache_insert (oceanic_common_cache_t *cache, oceanic_common_page_t *entry, unsigned int page, unsigned int highmem);
+
 dc_status_t
 oceanic_common_device_logbook (dc_device_t *device, dc_event_progress_t *progress, dc_buffer_t *logbook);
 
@@ -200,6 +235,9 @@ oceanic_common_device_dump (dc_device_t *abstract, dc_buffer_t *buffer);
 dc_status_t
 oceanic_common_device_foreach (dc_device_t *device, dc_dive_callback_t callback, void *userdata);
 
+dc_status_t
+oceanic_common_device_foreach_header (dc_device_t *device, dc_dive_callback_t callback, void *userdata);
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
@@ -52,9 +52,11 @@ static const oceanic_common_device_vtable_t oceanic_veo250_device_vtable = {
 		DC_FAMILY_OCEANIC_VEO250,
 		oceanic_common_device_set_fingerprint, /* set_fingerprint */
 		oceanic_veo250_device_read, /* read */
+		NULL, /* read_range */
 		NULL, /* write */
 		oceanic_common_device_dump, /* dump */
 		oceanic_common_device_foreach, /* foreach */
+		oceanic_common_device_foreach_header, /* foreach_header */
 		NULL, /* timesync */
 		oceanic_veo250_device_close /* close */
 	},
@@ -147,6 +149,8 @@ oceanic_veo250_transfer (oceanic_veo250_device_t *device, const unsigned char co
 		if (nretries++ >= MAXRETRIES)
 			return rc;
 
+		device_stats_retry (abstract);
+
 		// Delay the next attempt.
 		dc_iostream_sleep (device->iostream, 100);
 	}
@@ -343,6 +347,8 @@ oceanic_veo250_device_close (dc_device_t *abstract)
 	oceanic_veo250_device_t *device = (oceanic_veo250_device_t*) abstract;
 	dc_status_t rc = DC_STATUS_SUCCESS;
 
+	DEBUG (abstract->context, "Page cache: hits=%u, misses=%u", device->base.cache.hits, device->base.cache.misses);
+
 	// Switch the device back to surface mode.
 	rc = oceanic_veo250_quit (device);
 	if (rc != DC_STATUS_SUCCESS) {
@@ -420,46 +426,61 @@ oceanic_veo250_device_read (dc_device_t *abstract, unsigned int address, unsigne
 		(size    % PAGESIZE != 0))
 		return DC_STATUS_INVALIDARGS;
 
+	// The pages are read and cached in blocks of the maximum size.
+	unsigned int blocksize = MULTIPAGE * PAGESIZE;
+
 	unsigned int nbytes = 0;
 	while (nbytes < size) {
-		// Calculate the number of packages.
-		unsigned int npackets = (size - nbytes) / PAGESIZE;
-		if (npackets > MULTIPAGE)
-			npackets = MULTIPAGE;
-
-		// Read the package.
-		unsigned int first =  address / PAGESIZE;
-		unsigned int last  = first + npackets - 1;
-		unsigned char answer[(PAGESIZE + 1) * MULTIPAGE + 1] = {0};
-		unsigned char command[6] = {0x20,
-				(first     ) & 0xFF, // low
-				(first >> 8) & 0xFF, // high
-				(last     ) & 0xFF, // low
-				(last >> 8) & 0xFF, // high
-				0};
-		dc_status_t rc = oceanic_veo250_transfer (device, command, sizeof (command), answer, (PAGESIZE + 1) * npackets + 1);
-		if (rc != DC_STATUS_SUCCESS)
-			return rc;
+		unsigned int page = address / blocksize;
+
+		unsigned int hit = 0;
+		oceanic_common_page_t *entry = oceanic_common_cache_lookup (&device->base.cache, page, 0, &hit);
+		if (!hit) {
+			// Read the package.
+			unsigned int first = page * MULTIPAGE;
+			unsigned int last  = first + MULTIPAGE - 1;
+			unsigned char answer[(PAGESIZE + 1) * MULTIPAGE + 1] = {0};
+			unsigned char command[6] = {0x20,
+					(first     ) & 0xFF, // low
+					(first >> 8) & 0xFF, // high
+					(last     ) & 0xFF, // low
+					(last >> 8) & 0xFF, // high
+					0};
+			dc_status_t rc = oceanic_veo250_transfer (device, command, sizeof (command), answer, (PAGESIZE + 1) * MULTIPAGE + 1);
+			if (rc != DC_STATUS_SUCCESS)
+				return rc;
+
+			device->last = last;
+
+			unsigned int offset = 0;
+			for (unsigned int i = 0; i < MULTIPAGE; ++i) {
+				// Verify the checksum of the answer.
+				unsigned char crc = answer[offset + PAGESIZE];
+				unsigned char ccrc = checksum_add_uint8 (answer + offset, PAGESIZE, 0x00);
+				if (crc != ccrc) {
+					ERROR (abstract->context, "Unexpected answer checksum.");
+					return DC_STATUS_PROTOCOL;
+				}
+
+				memcpy (entry->data + i * PAGESIZE, answer + offset, PAGESIZE);
+
+				offset += PAGESIZE + 1;
+			}
 
-		device->last = last;
+			// Cache the page.
+			oceanic_common_cache_insert (&device->base.cache, entry, page, 0);
+		}
 
-		unsigned int offset = 0;
-		for (unsigned int i = 0; i < npackets; ++i) {
-			// Verify the checksum of the answer.
-			unsigned char crc = answer[offset + PAGESIZE];
-			unsigned char ccrc = checksum_add_uint8 (answer + offset, PAGESIZE, 0x00);
-			if (crc != ccrc) {
-				ERROR (abstract->context, "Unexpected answer checksum.");
-				return DC_STATUS_PROTOCOL;
-			}
+		unsigned int offset = address % blocksize;
+		unsigned int length = blocksize - offset;
+		if (nbytes + length > size)
+			length = size - nbytes;
 
-			memcpy (data, answer + offset, PAGESIZE);
+		memcpy (data, entry->data + offset, length);
 
-			offset += PAGESIZE + 1;
-			nbytes += PAGESIZE;
-			address += PAGESIZE;
-			data += PAGESIZE;
-		}
+		nbytes += length;
+		address += length;
+		data += length;
 	}
 
 	return DC_STATUS_SUCCESS;
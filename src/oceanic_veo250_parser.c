@@ -45,6 +45,7 @@ struct oceanic_veo250_parser_t {
 static dc_status_t oceanic_veo250_parser_get_datetime (dc_parser_t *abstract, dc_datetime_t *datetime);
 static dc_status_t oceanic_veo250_parser_get_field (dc_parser_t *abstract, dc_field_type_t type, unsigned int flags, void *value);
 static dc_status_t oceanic_veo250_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_t callback, void *userdata);
+static dc_status_t oceanic_veo250_parser_reset (dc_parser_t *abstract);
 
 static const dc_parser_vtable_t oceanic_veo250_parser_vtable = {
 	sizeof(oceanic_veo250_parser_t),
@@ -54,7 +55,13 @@ static const dc_parser_vtable_t oceanic_veo250_parser_vtable = {
 	NULL, /* set_density */
 	oceanic_veo250_parser_get_datetime, /* datetime */
 	oceanic_veo250_parser_get_field, /* fields */
+	NULL, /* summary */
 	oceanic_veo250_parser_samples_foreach, /* samples_foreach */
+	NULL, /* samples_batch */
+	NULL, /* samples_fixed */
+	NULL, /* samples_append */
+	NULL, /* samples_range */
+	oceanic_veo250_parser_reset, /* reset */
 	NULL /* destroy */
 };
 
@@ -76,12 +83,23 @@ oceanic_veo250_parser_create (dc_parser_t **out, dc_context_t *context, const un
 
 	// Set the default values.
 	parser->model = model;
+	oceanic_veo250_parser_reset ((dc_parser_t *) parser);
+
+	*out = (dc_parser_t*) parser;
+
+	return DC_STATUS_SUCCESS;
+}
+
+
+static dc_status_t
+oceanic_veo250_parser_reset (dc_parser_t *abstract)
+{
+	oceanic_veo250_parser_t *parser = (oceanic_veo250_parser_t *) abstract;
+
 	parser->cached = 0;
 	parser->divetime = 0;
 	parser->maxdepth = 0.0;
 
-	*out = (dc_parser_t*) parser;
-
 	return DC_STATUS_SUCCESS;
 }
 
@@ -115,6 +133,36 @@ oceanic_veo250_parser_get_datetime (dc_parser_t *abstract, dc_datetime_t *dateti
 }
 
 
+static unsigned int
+oceanic_veo250_parser_interval (oceanic_veo250_parser_t *parser)
+{
+	const unsigned char *data = parser->base.data;
+
+	unsigned int interval = 0;
+	unsigned int interval_idx = data[0x27] & 0x03;
+	if (parser->model == REACTPRO || parser->model == REACTPROWHITE) {
+		interval_idx += 1;
+		interval_idx %= 4;
+	}
+	switch (interval_idx) {
+	case 0:
+		interval = 2;
+		break;
+	case 1:
+		interval = 15;
+		break;
+	case 2:
+		interval = 30;
+		break;
+	case 3:
+		interval = 60;
+		break;
+	}
+
+	return interval;
+}
+
+
 static dc_status_t
 oceanic_veo250_parser_get_field (dc_parser_t *abstract, dc_field_type_t type, unsigned int flags, void *value)
 {
@@ -126,7 +174,8 @@ oceanic_veo250_parser_get_field (dc_parser_t *abstract, dc_field_type_t type, un
 	if (size < 7 * PAGESIZE / 2)
 		return DC_STATUS_DATAFORMAT;
 
-	if (!parser->cached) {
+	// Only the maximum depth has to be derived from the profile.
+	if (type == DC_FIELD_MAXDEPTH && !parser->cached) {
 		sample_statistics_t statistics = SAMPLE_STATISTICS_INITIALIZER;
 		dc_status_t rc = oceanic_veo250_parser_samples_foreach (
 			abstract, sample_statistics_cb, &statistics);
@@ -141,6 +190,7 @@ oceanic_veo250_parser_get_field (dc_parser_t *abstract, dc_field_type_t type, un
 	unsigned int footer = size - PAGESIZE;
 
 	dc_gasmix_t *gasmix = (dc_gasmix_t *) value;
+	dc_sample_interval_t *interval = (dc_sample_interval_t *) value;
 
 	if (value) {
 		switch (type) {
@@ -162,6 +212,10 @@ oceanic_veo250_parser_get_field (dc_parser_t *abstract, dc_field_type_t type, un
 				gasmix->oxygen = 0.21;
 			gasmix->nitrogen = 1.0 - gasmix->oxygen - gasmix->helium;
 			break;
+		case DC_FIELD_SAMPLE_INTERVAL:
+			interval->interval = oceanic_veo250_parser_interval (parser) * 1000;
+			interval->regular = 1;
+			break;
 		default:
 			return DC_STATUS_UNSUPPORTED;
 		}
@@ -182,26 +236,7 @@ oceanic_veo250_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback
 		return DC_STATUS_DATAFORMAT;
 
 	unsigned int time = 0;
-	unsigned int interval = 0;
-	unsigned int interval_idx = data[0x27] & 0x03;
-	if (parser->model == REACTPRO || parser->model == REACTPROWHITE) {
-		interval_idx += 1;
-		interval_idx %= 4;
-	}
-	switch (interval_idx) {
-	case 0:
-		interval = 2;
-		break;
-	case 1:
-		interval = 15;
-		break;
-	case 2:
-		interval = 30;
-		break;
-	case 3:
-		interval = 60;
-		break;
-	}
+	unsigned int interval = oceanic_veo250_parser_interval (parser);
 
 	unsigned int offset = 5 * PAGESIZE / 2;
 	while (offset + PAGESIZE / 2 <= size - PAGESIZE) {
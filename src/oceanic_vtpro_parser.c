@@ -45,6 +45,7 @@ struct oceanic_vtpro_parser_t {
 static dc_status_t oceanic_vtpro_parser_get_datetime (dc_parser_t *abstract, dc_datetime_t *datetime);
 static dc_status_t oceanic_vtpro_parser_get_field (dc_parser_t *abstract, dc_field_type_t type, unsigned int flags, void *value);
 static dc_status_t oceanic_vtpro_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_t callback, void *userdata);
+static dc_status_t oceanic_vtpro_parser_reset (dc_parser_t *abstract);
 
 static const dc_parser_vtable_t oceanic_vtpro_parser_vtable = {
 	sizeof(oceanic_vtpro_parser_t),
@@ -54,7 +55,13 @@ static const dc_parser_vtable_t oceanic_vtpro_parser_vtable = {
 	NULL, /* set_density */
 	oceanic_vtpro_parser_get_datetime, /* datetime */
 	oceanic_vtpro_parser_get_field, /* fields */
+	NULL, /* summary */
 	oceanic_vtpro_parser_samples_foreach, /* samples_foreach */
+	NULL, /* samples_batch */
+	NULL, /* samples_fixed */
+	NULL, /* samples_append */
+	NULL, /* samples_range */
+	oceanic_vtpro_parser_reset, /* reset */
 	NULL /* destroy */
 };
 
@@ -76,12 +83,23 @@ oceanic_vtpro_parser_create (dc_parser_t **out, dc_context_t *context, const uns
 
 	// Set the default values.
 	parser->model = model;
+	oceanic_vtpro_parser_reset ((dc_parser_t *) parser);
+
+	*out = (dc_parser_t*) parser;
+
+	return DC_STATUS_SUCCESS;
+}
+
+
+static dc_status_t
+oceanic_vtpro_parser_reset (dc_parser_t *abstract)
+{
+	oceanic_vtpro_parser_t *parser = (oceanic_vtpro_parser_t *) abstract;
+
 	parser->cached = 0;
 	parser->divetime = 0;
 	parser->maxdepth = 0.0;
 
-	*out = (dc_parser_t*) parser;
-
 	return DC_STATUS_SUCCESS;
 }
 
@@ -143,7 +161,8 @@ oceanic_vtpro_parser_get_field (dc_parser_t *abstract, dc_field_type_t type, uns
 	if (size < 7 * PAGESIZE / 2)
 		return DC_STATUS_DATAFORMAT;
 
-	if (!parser->cached) {
+	// Only the dive time has to be derived from the profile.
+	if (type == DC_FIELD_DIVETIME && !parser->cached) {
 		sample_statistics_t statistics = SAMPLE_STATISTICS_INITIALIZER;
 		dc_status_t rc = oceanic_vtpro_parser_samples_foreach (
 			abstract, sample_statistics_cb, &statistics);
@@ -66,9 +66,11 @@ static const dc_device_vtable_t oceans_s1_device_vtable = {
 	DC_FAMILY_OCEANS_S1,
 	oceans_s1_device_set_fingerprint, /* set_fingerprint */
 	NULL, /* read */
+	NULL, /* read_range */
 	NULL, /* write */
 	NULL, /* dump */
 	oceans_s1_device_foreach, /* foreach */
+	NULL, /* foreach_header */
 	oceans_s1_device_timesync, /* timesync */
 	NULL, /* close */
 };
@@ -338,13 +340,18 @@ oceans_s1_xmodem_recv (oceans_s1_device_t *device, dc_buffer_t *buffer)
 			return status;
 		}
 
-		dc_buffer_append (buffer, packet, sizeof(packet));
-
-		// Ack the data packet.
+		// Ack the data packet immediately, such that the device can
+		// already start sending the next packet while the data is
+		// being processed.
 		status = dc_iostream_write (device->iostream, &ack, 1, NULL);
 		if (status != DC_STATUS_SUCCESS)
 			return status;
 
+		if (!dc_buffer_append (buffer, packet, sizeof(packet))) {
+			ERROR (device->base.context, "Insufficient buffer space available.");
+			return DC_STATUS_NOMEMORY;
+		}
+
 		seq++;
 	}
 
@@ -577,7 +584,7 @@ oceans_s1_device_foreach (dc_device_t *abstract, dc_dive_callback_t callback, vo
 	devinfo.serial = 0;
 	device_event_emit (abstract, DC_EVENT_DEVINFO, &devinfo);
 
-	dc_buffer_t *buffer = dc_buffer_new (4096);
+	dc_buffer_t *buffer = dc_buffer_new_context (abstract->context, 4096);
 	if (buffer == NULL) {
 		ERROR (abstract->context, "Failed to allocate memory.");
 		status = DC_STATUS_NOMEMORY;
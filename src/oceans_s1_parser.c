@@ -61,6 +61,7 @@ struct oceans_s1_parser_t {
 static dc_status_t oceans_s1_parser_get_datetime(dc_parser_t *abstract, dc_datetime_t *datetime);
 static dc_status_t oceans_s1_parser_get_field(dc_parser_t *abstract, dc_field_type_t type, unsigned int flags, void *value);
 static dc_status_t oceans_s1_parser_samples_foreach(dc_parser_t *abstract, dc_sample_callback_t callback, void *userdata);
+static dc_status_t oceans_s1_parser_reset (dc_parser_t *abstract);
 
 static const dc_parser_vtable_t oceans_s1_parser_vtable = {
 	sizeof(oceans_s1_parser_t),
@@ -70,7 +71,13 @@ static const dc_parser_vtable_t oceans_s1_parser_vtable = {
 	NULL, /* set_density */
 	oceans_s1_parser_get_datetime, /* datetime */
 	oceans_s1_parser_get_field, /* fields */
+	NULL, /* summary */
 	oceans_s1_parser_samples_foreach, /* samples_foreach */
+	NULL, /* samples_batch */
+	NULL, /* samples_fixed */
+	NULL, /* samples_append */
+	NULL, /* samples_range */
+	oceans_s1_parser_reset, /* reset */
 	NULL /* destroy */
 };
 
@@ -90,6 +97,19 @@ oceans_s1_parser_create (dc_parser_t **out, dc_context_t *context, const unsigne
 	}
 
 	// Set the default values.
+	oceans_s1_parser_reset ((dc_parser_t *) parser);
+
+	*out = (dc_parser_t *) parser;
+
+	return DC_STATUS_SUCCESS;
+}
+
+
+static dc_status_t
+oceans_s1_parser_reset (dc_parser_t *abstract)
+{
+	oceans_s1_parser_t *parser = (oceans_s1_parser_t *) abstract;
+
 	parser->cached = 0;
 	parser->timestamp = 0;
 	parser->number = 0;
@@ -98,8 +118,6 @@ oceans_s1_parser_create (dc_parser_t **out, dc_context_t *context, const unsigne
 	parser->maxdepth = 0;
 	parser->divetime = 0;
 
-	*out = (dc_parser_t *) parser;
-
 	return DC_STATUS_SUCCESS;
 }
 
@@ -28,6 +28,12 @@
 #include "common-private.h"
 #include "context-private.h"
 
+// Size of the read buffer in automatic mode.
+#define BUFSIZE 4096
+
+// Maximum number of packets per vectored write.
+#define MAXBATCH 16
+
 static dc_status_t dc_packet_set_timeout (dc_iostream_t *abstract, int timeout);
 static dc_status_t dc_packet_set_break (dc_iostream_t *abstract, unsigned int value);
 static dc_status_t dc_packet_set_dtr (dc_iostream_t *abstract, unsigned int value);
@@ -42,6 +48,7 @@ static dc_status_t dc_packet_ioctl (dc_iostream_t *abstract, unsigned int reques
 static dc_status_t dc_packet_flush (dc_iostream_t *abstract);
 static dc_status_t dc_packet_purge (dc_iostream_t *abstract, dc_direction_t direction);
 static dc_status_t dc_packet_sleep (dc_iostream_t *abstract, unsigned int milliseconds);
+static dc_status_t dc_packet_set_interrupt (dc_iostream_t *abstract, dc_interrupt_t *interrupt);
 static dc_status_t dc_packet_close (dc_iostream_t *abstract);
 
 typedef struct dc_packet_t {
@@ -54,6 +61,7 @@ typedef struct dc_packet_t {
 	size_t offset;
 	size_t isize;
 	size_t osize;
+	int automatic;
 } dc_packet_t;
 
 static const dc_iostream_vtable_t dc_packet_vtable = {
@@ -68,10 +76,14 @@ static const dc_iostream_vtable_t dc_packet_vtable = {
 	dc_packet_poll, /* poll */
 	dc_packet_read, /* read */
 	dc_packet_write, /* write */
+	NULL, /* read_async */
+	NULL, /* write_async */
+	NULL, /* writev */
 	dc_packet_ioctl, /* ioctl */
 	dc_packet_flush, /* flush */
 	dc_packet_purge, /* purge */
 	dc_packet_sleep, /* sleep */
+	dc_packet_set_interrupt, /* set_interrupt */
 	dc_packet_close, /* close */
 };
 
@@ -81,10 +93,25 @@ dc_packet_open (dc_iostream_t **out, dc_context_t *context, dc_iostream_t *base,
 	dc_status_t status = DC_STATUS_SUCCESS;
 	dc_packet_t *packet = NULL;
 	unsigned char *buffer = NULL;
+	int automatic = 0;
 
 	if (out == NULL || base == NULL)
 		return DC_STATUS_INVALIDARGS;
 
+	if (isize == DC_PACKET_AUTO) {
+		isize = BUFSIZE;
+		automatic = 1;
+	}
+
+	// Use larger packets if the BLE transport negotiated a larger MTU.
+	size_t payload = dc_iostream_ble_payload (base);
+	if (payload) {
+		if (isize && isize < payload)
+			isize = payload;
+		if (osize && osize < payload)
+			osize = payload;
+	}
+
 	// Allocate memory.
 	packet = (dc_packet_t *) dc_iostream_allocate (NULL, &dc_packet_vtable, dc_iostream_get_transport(base));
 	if (packet == NULL) {
@@ -109,6 +136,7 @@ dc_packet_open (dc_iostream_t **out, dc_context_t *context, dc_iostream_t *base,
 	packet->offset = 0;
 	packet->isize = isize;
 	packet->osize = osize;
+	packet->automatic = automatic;
 
 	*out = (dc_iostream_t *) packet;
 
@@ -204,6 +232,42 @@ dc_packet_read (dc_iostream_t *abstract, void *data, size_t size, size_t *actual
 		// Get the remaining size.
 		size_t length = size - nbytes;
 
+		if (packet->automatic && packet->available == 0) {
+			// Large reads bypass the buffer.
+			if (length >= packet->isize) {
+				status = dc_iostream_read (packet->iostream, (unsigned char *) data + nbytes, length, &length);
+				nbytes += length;
+				if (status != DC_STATUS_SUCCESS)
+					break;
+				continue;
+			}
+
+			// Fill the buffer with the requested data, and everything
+			// else that is already available, in a single call.
+			size_t len = 0;
+			status = dc_iostream_get_available (packet->iostream, &len);
+			if (status != DC_STATUS_SUCCESS || len < length)
+				len = length;
+			if (len > packet->isize)
+				len = packet->isize;
+
+			status = dc_iostream_read (packet->iostream, packet->cache, len, &len);
+
+			packet->available = len;
+			packet->offset = 0;
+
+			if (status != DC_STATUS_SUCCESS) {
+				// Return the partial data.
+				if (length > packet->available)
+					length = packet->available;
+				memcpy ((unsigned char *) data + nbytes, packet->cache, length);
+				packet->available -= length;
+				packet->offset += length;
+				nbytes += length;
+				break;
+			}
+		}
+
 		if (packet->isize) {
 			if (packet->available == 0) {
 				// Read a packet into the cache.
@@ -249,20 +313,34 @@ dc_packet_write (dc_iostream_t *abstract, const void *data, size_t size, size_t
 	size_t nbytes = 0;
 
 	while (nbytes < size) {
-		// Get the remaining size.
-		size_t length = size - nbytes;
+		dc_iovec_t iov[MAXBATCH];
+		size_t count = 0;
+		size_t length = 0;
+
+		// Split the data into packets of the maximum packet size.
+		while (count < MAXBATCH && nbytes + length < size) {
+			size_t n = size - nbytes - length;
+			if (packet->osize) {
+				if (n > packet->osize)
+					n = packet->osize;
+			}
 
-		// Limit to the maximum packet size.
-		if (packet->osize) {
-			if (length > packet->osize)
-				length = packet->osize;
+			iov[count].data = (const unsigned char *) data + nbytes + length;
+			iov[count].size = n;
+			length += n;
+			count++;
 		}
 
-		// Write the packet.
-		status = dc_iostream_write (packet->iostream, (const unsigned char *) data + nbytes, length, &length);
+		// Write the packets.
+		status = dc_iostream_writev (packet->iostream, iov, count, &length);
 		if (status != DC_STATUS_SUCCESS)
 			break;
 
+		if (length == 0) {
+			status = DC_STATUS_IO;
+			break;
+		}
+
 		// Update the total number of bytes.
 		nbytes += length;
 	}
@@ -310,6 +388,14 @@ dc_packet_sleep (dc_iostream_t *abstract, unsigned int milliseconds)
 	return dc_iostream_sleep (packet->iostream, milliseconds);
 }
 
+static dc_status_t
+dc_packet_set_interrupt (dc_iostream_t *abstract, dc_interrupt_t *interrupt)
+{
+	dc_packet_t *packet = (dc_packet_t *) abstract;
+
+	return dc_iostream_set_interrupt (packet->iostream, interrupt);
+}
+
 static dc_status_t
 dc_packet_close (dc_iostream_t *abstract)
 {
@@ -30,17 +30,29 @@
 extern "C" {
 #endif /* __cplusplus */
 
+/**
+ * Input packet size for a buffered byte stream.
+ *
+ * Instead of reading fixed size packets, the read buffer is filled with
+ * all the data that is already available in the base I/O stream, and
+ * small reads are served from memory.
+ */
+#define DC_PACKET_AUTO ((size_t) -1)
+
 /**
  * Create a packet I/O stream layered on top of another base I/O stream.
  *
  * This layered I/O allows reading and writing a byte stream from the
  * underlying packet oriented transport. It changes the packet oriented
- * base transport into a stream oriented transport.
+ * base transport into a stream oriented transport. On a BLE transport,
+ * the packet sizes are increased to the maximum payload of the
+ * negotiated MTU, if that is larger.
  *
  * @param[out]  iostream    A location to store the packet I/O stream.
  * @param[in]   context     A valid context.
  * @param[in]   base        A valid I/O stream.
- * @param[in]   isize       The input packet size in bytes.
+ * @param[in]   isize       The input packet size in bytes, or
+ *                          #DC_PACKET_AUTO for a buffered byte stream.
  * @param[in]   osize       The output packet size in bytes.
  * @returns #DC_STATUS_SUCCESS on success, or another #dc_status_t code
  * on failure.
@@ -0,0 +1,144 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2026 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h> // malloc, free
+
+#include <libdivecomputer/parsecache.h>
+#include <libdivecomputer/fingerprint.h>
+#include <libdivecomputer/version.h>
+
+#include "context-private.h"
+#include "recordstore.h"
+#include "array.h"
+
+/*
+ * Each result is appended as a record, containing the family type,
+ * model number, library version, size and dive digest, followed by the
+ * result data. The last valid record of each dive wins, and an empty
+ * result removes the dive. Records of another library version are
+ * skipped.
+ */
+#define MAGIC          0x50434344 /* DCCP */
+#define FORMAT_VERSION 1
+
+#define PARSER_VERSION ((DC_VERSION_MAJOR << 16) | (DC_VERSION_MINOR << 8) | DC_VERSION_MICRO)
+
+#define SZ_RECORD  (16 + DC_DIVE_DIGEST_SIZE)
+#define SZ_MAXIMUM 0x1000000
+
+#define INITIAL_CAPACITY 64
+
+struct dc_parse_cache_t {
+	dc_record_store_t *records;
+};
+
+static int
+dc_parse_cache_accept (const unsigned char header[])
+{
+	return array_uint32_le (header + 8) == PARSER_VERSION;
+}
+
+static const dc_record_layout_t dc_parse_cache_layout = {
+	"parse cache",
+	MAGIC, FORMAT_VERSION,
+	SZ_RECORD, SZ_MAXIMUM,
+	INITIAL_CAPACITY,
+	dc_parse_cache_accept,
+};
+
+static void
+dc_parse_cache_header (unsigned char buffer[SZ_RECORD], dc_family_t family, unsigned int model, const unsigned char data[], unsigned int size)
+{
+	array_uint32_le_set (buffer + 0, family);
+	array_uint32_le_set (buffer + 4, model);
+	array_uint32_le_set (buffer + 8, PARSER_VERSION);
+	array_uint32_le_set (buffer + 12, 0);
+	dc_dive_digest (family, data, size, NULL, 0, buffer + 16);
+}
+
+dc_status_t
+dc_parse_cache_open (dc_parse_cache_t **out, dc_context_t *context, const char *filename)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	dc_parse_cache_t *cache = NULL;
+
+	if (out == NULL || filename == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	// Allocate memory.
+	cache = (dc_parse_cache_t *) malloc (sizeof (dc_parse_cache_t));
+	if (cache == NULL) {
+		ERROR (context, "Failed to allocate memory.");
+		return DC_STATUS_NOMEMORY;
+	}
+
+	status = dc_record_store_open (&cache->records, context, filename, &dc_parse_cache_layout);
+	if (status != DC_STATUS_SUCCESS) {
+		free (cache);
+		return status;
+	}
+
+	*out = cache;
+
+	return DC_STATUS_SUCCESS;
+}
+
+dc_status_t
+dc_parse_cache_get (dc_parse_cache_t *cache, dc_family_t family, unsigned int model, const unsigned char data[], unsigned int size, dc_buffer_t *result)
+{
+	if (cache == NULL || result == NULL || (data == NULL && size))
+		return DC_STATUS_INVALIDARGS;
+
+	unsigned char header[SZ_RECORD];
+	dc_parse_cache_header (header, family, model, data, size);
+
+	return dc_record_store_get (cache->records, header, result);
+}
+
+dc_status_t
+dc_parse_cache_set (dc_parse_cache_t *cache, dc_family_t family, unsigned int model, const unsigned char data[], unsigned int size, const unsigned char result[], unsigned int rsize)
+{
+	if (cache == NULL || (data == NULL && size))
+		return DC_STATUS_INVALIDARGS;
+
+	unsigned char header[SZ_RECORD];
+	dc_parse_cache_header (header, family, model, data, size);
+
+	return dc_record_store_set (cache->records, header, result, rsize);
+}
+
+dc_status_t
+dc_parse_cache_close (dc_parse_cache_t *cache)
+{
+	if (cache == NULL)
+		return DC_STATUS_SUCCESS;
+
+	dc_status_t status = dc_record_store_close (cache->records);
+
+	free (cache);
+
+	return status;
+}
@@ -33,6 +33,25 @@
 extern "C" {
 #endif /* __cplusplus */
 
+/*
+ * Parser creation flags.
+ *
+ * DC_PARSER_FLAG_SUMMARY: Only the summary fields are needed. Backends
+ * may fill the field cache from the dive header alone, and skip the
+ * decoding of the sample data until the samples are actually requested.
+ *
+ * DC_PARSER_FLAG_BORROWED: The parser references the caller's buffer
+ * instead of making a private copy. The data is read-only for the
+ * backends, so this works for all of them.
+ *
+ * DC_PARSER_FLAG_INPLACE: The parser lives in storage provided by the
+ * caller, and is not freed when it is destroyed.
+ */
+#define DC_PARSER_FLAG_SUMMARY  0x01
+#define DC_PARSER_FLAG_BORROWED 0x02
+#define DC_PARSER_FLAG_INPLACE  0x04
+#define DC_PARSER_FLAG_STATS    0x08
+
 struct dc_parser_t;
 struct dc_parser_vtable_t;
 
@@ -41,10 +60,35 @@ typedef struct dc_parser_vtable_t dc_parser_vtable_t;
 struct dc_parser_t {
 	const dc_parser_vtable_t *vtable;
 	dc_context_t *context;
-	unsigned char *data;
+	const unsigned char *data;
 	unsigned int size;
+	unsigned int flags;
+	unsigned char *buffer;
+	unsigned int capacity;
+	unsigned int samplemask;
+	unsigned int implicit;
+	unsigned int wanted;
+	unsigned int stopped;
+	dc_parser_stats_t stats; /* Times in nanoseconds. */
 };
 
+/*
+ * Check whether the samples of a type are wanted by the caller of the
+ * current sample walk. Outside the public sample functions, including
+ * the internal walks for the summary fields, all types are wanted.
+ */
+#define dc_parser_wants(parser, type) \
+	(((dc_parser_t *) (parser))->wanted & DC_SAMPLE_MASK(type))
+
+/*
+ * Check whether the caller of the current sample walk asked to stop.
+ * The remaining samples are dropped anyway, but the backends can check
+ * this to skip decoding them. The internal walks without a callback
+ * are never stopped.
+ */
+#define dc_parser_stopped(parser, callback) \
+	((callback) != NULL && ((dc_parser_t *) (parser))->stopped)
+
 struct dc_parser_vtable_t {
 	size_t size;
 
@@ -60,8 +104,25 @@ struct dc_parser_vtable_t {
 
 	dc_status_t (*field) (dc_parser_t *parser, dc_field_type_t type, unsigned int flags, void *value);
 
+	/* Fill in the summary, which is already cleared. Only needed if it's
+	 * cheaper than requesting the fields one by one. */
+	dc_status_t (*summary) (dc_parser_t *parser, dc_parser_summary_t *summary);
+
 	dc_status_t (*samples_foreach) (dc_parser_t *parser, dc_sample_callback_t callback, void *userdata);
 
+	dc_status_t (*samples_batch) (dc_parser_t *parser, dc_sample_batch_t *batch, dc_sample_batch_callback_t callback, void *userdata);
+
+	dc_status_t (*samples_fixed) (dc_parser_t *parser, dc_sample_fixed_callback_t callback, void *userdata);
+
+	dc_status_t (*samples_append) (dc_parser_t *parser, dc_sample_callback_t callback, void *userdata);
+
+	/* Walk the samples, starting at or before 'begin' milliseconds. The
+	 * caller drops the samples before the range, and stops the walk at
+	 * the end of the range. */
+	dc_status_t (*samples_range) (dc_parser_t *parser, unsigned int begin, dc_sample_callback_t callback, void *userdata);
+
+	dc_status_t (*reset) (dc_parser_t *parser);
+
 	dc_status_t (*destroy) (dc_parser_t *parser);
 };
 
@@ -84,6 +145,13 @@ typedef struct sample_statistics_t {
 void
 sample_statistics_cb (dc_sample_type_t type, const dc_sample_value_t *value, void *userdata);
 
+/*
+ * Convert a sample to the units of dc_sample_value_fixed_t, for the
+ * backends that emit only some of their samples in fixed point.
+ */
+void
+dc_sample_fixed_convert (dc_sample_type_t type, const dc_sample_value_t *value, dc_sample_value_fixed_t *fixed);
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
@@ -19,10 +19,18 @@
  * MA 02110-1301 USA
  */
 
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
 #include <stdlib.h>
 #include <string.h>
+#include <limits.h>
+#include <math.h>
 #include <assert.h>
 
+#include <libdivecomputer/units.h>
+
 #include "suunto_d9.h"
 #include "suunto_eon.h"
 #include "suunto_eonsteel.h"
@@ -72,19 +80,226 @@
 #include "context-private.h"
 #include "parser-private.h"
 #include "device-private.h"
+#include "thread.h"
+#include "timer.h"
+#include "array.h"
+#include "deco.h"
 
 #define REACTPROWHITE 0x4354
 
+#define MAXCOALESCE 16
+
+typedef struct dc_sample_batch_state_t {
+	dc_sample_batch_t *batch;
+	dc_sample_batch_callback_t callback;
+	void *userdata;
+	unsigned int row;
+	unsigned int count;
+	unsigned int implicit;
+	unsigned int interval;
+} dc_sample_batch_state_t;
+
+typedef struct dc_sample_fixed_state_t {
+	dc_sample_fixed_callback_t callback;
+	void *userdata;
+	unsigned int mask;
+} dc_sample_fixed_state_t;
+
+typedef struct dc_sample_batch_fixed_state_t {
+	dc_sample_batch_fixed_t *batch;
+	dc_sample_batch_fixed_callback_t callback;
+	void *userdata;
+	unsigned int row;
+	unsigned int count;
+	unsigned int implicit;
+	unsigned int interval;
+} dc_sample_batch_fixed_state_t;
+
+typedef struct dc_sample_entry_t {
+	dc_sample_type_t type;
+	dc_sample_value_t value;
+} dc_sample_entry_t;
+
+typedef struct dc_sample_resample_t {
+	dc_sample_callback_t callback;
+	void *userdata;
+	unsigned int interval;
+	dc_resample_mode_t mode;
+	dc_status_t status;
+	// Current interval
+	unsigned int active;
+	unsigned int index;
+	unsigned int time;
+	// Depth envelope
+	unsigned int ndepths;
+	unsigned int time_min, time_max;
+	double depth_min, depth_max;
+	// Pending samples of the current interval
+	dc_sample_entry_t *entries;
+	unsigned int count;
+	unsigned int capacity;
+} dc_sample_resample_t;
+
+typedef struct dc_sample_coalesce_t {
+	dc_sample_callback_t callback;
+	void *userdata;
+	// Ongoing events, and whether they were repeated in the current
+	// time sample.
+	dc_sample_value_t active[MAXCOALESCE];
+	unsigned int seen[MAXCOALESCE];
+	unsigned int count;
+} dc_sample_coalesce_t;
+
+typedef struct dc_sample_count_t {
+	unsigned int type;
+	unsigned int count;
+} dc_sample_count_t;
+
+typedef struct dc_sample_vectors_t {
+	dc_sample_callback_t callback;
+	dc_sample_vector_callback_t vector;
+	void *userdata;
+	dc_sample_vector_t ppo2;
+	dc_sample_vector_t pressure;
+} dc_sample_vectors_t;
+
+typedef struct dc_sample_deco_t {
+	dc_sample_callback_t callback;
+	void *userdata;
+	unsigned int mask;
+	dc_deco_t deco;
+	// Gas mixes
+	dc_gasmix_t *gasmixes;
+	unsigned int ngasmixes;
+	dc_gasmix_t gasmix;
+	unsigned int pending;
+	// Current row
+	unsigned int active;
+	unsigned int time;
+	double depth;
+	unsigned int hasdeco;
+	// End of the last tissue update
+	unsigned int lasttime;
+	double lastdepth;
+} dc_sample_deco_t;
+
+typedef struct dc_parser_profile_t {
+	dc_family_t family;
+	unsigned int fields;
+} dc_parser_profile_t;
+
+#define DC_FIELD_MASK_ALL 0xFFFFFFFFu
+
+#define MAXNDL (240 * 60)
+
+/*
+ * The fields that can only be obtained by walking the profile data,
+ * for the backends that do so. All other backends take their fields
+ * directly from the dive header. The oceanic atom2 dive time is in
+ * the header for a few models, but not in general.
+ */
+static const dc_parser_profile_t g_profile_fields[] = {
+	{DC_FAMILY_SUUNTO_EON,           DC_FIELD_MASK_ALL},
+	{DC_FAMILY_SUUNTO_VYPER,         DC_FIELD_MASK_ALL},
+	{DC_FAMILY_SUUNTO_EONSTEEL,      DC_FIELD_MASK_ALL},
+	{DC_FAMILY_OCEANIC_VTPRO,        DC_FIELD_MASK(DC_FIELD_DIVETIME)},
+	{DC_FAMILY_OCEANIC_VEO250,       DC_FIELD_MASK(DC_FIELD_MAXDEPTH)},
+	{DC_FAMILY_OCEANIC_ATOM2,        DC_FIELD_MASK(DC_FIELD_DIVETIME)},
+	{DC_FAMILY_HW_OSTC,              DC_FIELD_MASK_ALL},
+	{DC_FAMILY_SHEARWATER_PREDATOR,  DC_FIELD_MASK_ALL},
+	{DC_FAMILY_SHEARWATER_PETREL,    DC_FIELD_MASK_ALL},
+	{DC_FAMILY_DIVERITE_NITEKQ,      DC_FIELD_MASK_ALL},
+	{DC_FAMILY_DIVESYSTEM_IDIVE,     DC_FIELD_MASK_ALL},
+	{DC_FAMILY_LIQUIVISION_LYNX,     DC_FIELD_MASK_ALL},
+	{DC_FAMILY_SEAC_SCREEN,          DC_FIELD_MASK_ALL},
+	{DC_FAMILY_OCEANS_S1,            DC_FIELD_MASK_ALL},
+	{DC_FAMILY_DIVESOFT_FREEDOM,     DC_FIELD_MASK_ALL},
+	{DC_FAMILY_GARMIN,               DC_FIELD_MASK_ALL},
+};
+
+typedef struct dc_sample_filter_t {
+	unsigned int mask;
+	dc_sample_callback_t callback;
+	void *userdata;
+} dc_sample_filter_t;
+
+typedef struct dc_sample_stats_t {
+	dc_parser_stats_t *stats;
+	dc_sample_callback_t callback;
+	void *userdata;
+} dc_sample_stats_t;
+
+#define dc_parser_stats_enabled(parser) ((parser)->flags & DC_PARSER_FLAG_STATS)
+
+#define dc_parser_stats_alloc(parser) \
+	(dc_parser_stats_enabled (parser) ? (void) (parser)->stats.nallocs++ : (void) 0)
+
+typedef struct dc_sample_stop_t {
+	dc_parser_t *parser;
+	dc_sample_callback2_t callback;
+	void *userdata;
+} dc_sample_stop_t;
+
+typedef struct dc_sample_range_t {
+	dc_parser_t *parser;
+	unsigned int begin;
+	unsigned int end;
+	unsigned int inside;
+	dc_sample_callback_t callback;
+	void *userdata;
+} dc_sample_range_t;
+
+typedef struct dc_parser_storage_t {
+	void *buffer;
+	size_t capacity;
+	size_t required;
+} dc_parser_storage_t;
+
+#ifdef DC_THREAD_LOCAL
+// The caller provided storage for the parser that is being created by
+// the current thread. Without a buffer, only the required size is
+// recorded, and the allocation fails.
+static DC_THREAD_LOCAL dc_parser_storage_t *g_storage = NULL;
+#endif
+
+typedef struct dc_parse_batch_t {
+	dc_context_t *context;
+	dc_family_t family;
+	unsigned int model;
+	const unsigned char *const *data;
+	const size_t *size;
+	unsigned int count;
+	dc_parse_batch_callback_t callback;
+	void *userdata;
+	dc_status_t *status;
+	dc_atomic_t next;
+} dc_parse_batch_t;
+
 static dc_status_t
-dc_parser_new_internal (dc_parser_t **out, dc_context_t *context, const unsigned char data[], size_t size, dc_family_t family, unsigned int model, unsigned int serial)
+dc_parser_new_internal (dc_parser_t **out, dc_context_t *context, const unsigned char data[], size_t size, dc_family_t family, unsigned int model, unsigned int serial, unsigned int flags)
 {
 	dc_status_t rc = DC_STATUS_SUCCESS;
 	dc_parser_t *parser = NULL;
+	unsigned char *buffer = NULL;
 
 	if (out == NULL)
 		return DC_STATUS_INVALIDARGS;
 
+	if (size && !(flags & DC_PARSER_FLAG_BORROWED)) {
+		// Allocate memory for the data.
+		buffer = (unsigned char *) dc_context_malloc (context, size);
+		if (buffer == NULL) {
+			ERROR (context, "Failed to allocate memory.");
+			return DC_STATUS_NOMEMORY;
+		}
+
+		// Copy the data.
+		memcpy (buffer, data, size);
+		data = buffer;
+	}
+
 	switch (family) {
+#ifndef DISABLE_BACKEND_SUUNTO
 	case DC_FAMILY_SUUNTO_SOLUTION:
 		rc = suunto_solution_parser_create (&parser, context, data, size);
 		break;
@@ -104,6 +319,8 @@ dc_parser_new_internal (dc_parser_t **out, dc_context_t *context, const unsigned
 	case DC_FAMILY_SUUNTO_EONSTEEL:
 		rc = suunto_eonsteel_parser_create(&parser, context, data, size, model);
 		break;
+#endif
+#ifndef DISABLE_BACKEND_UWATEC
 	case DC_FAMILY_UWATEC_ALADIN:
 	case DC_FAMILY_UWATEC_MEMOMOUSE:
 		rc = uwatec_memomouse_parser_create (&parser, context, data, size);
@@ -111,6 +328,8 @@ dc_parser_new_internal (dc_parser_t **out, dc_context_t *context, const unsigned
 	case DC_FAMILY_UWATEC_SMART:
 		rc = uwatec_smart_parser_create (&parser, context, data, size, model);
 		break;
+#endif
+#ifndef DISABLE_BACKEND_REEFNET
 	case DC_FAMILY_REEFNET_SENSUS:
 		rc = reefnet_sensus_parser_create (&parser, context, data, size);
 		break;
@@ -120,6 +339,8 @@ dc_parser_new_internal (dc_parser_t **out, dc_context_t *context, const unsigned
 	case DC_FAMILY_REEFNET_SENSUSULTRA:
 		rc = reefnet_sensusultra_parser_create (&parser, context, data, size);
 		break;
+#endif
+#ifndef DISABLE_BACKEND_OCEANIC
 	case DC_FAMILY_OCEANIC_VTPRO:
 		rc = oceanic_vtpro_parser_create (&parser, context, data, size, model);
 		break;
@@ -132,6 +353,8 @@ dc_parser_new_internal (dc_parser_t **out, dc_context_t *context, const unsigned
 		else
 			rc = oceanic_atom2_parser_create (&parser, context, data, size, model, serial);
 		break;
+#endif
+#ifndef DISABLE_BACKEND_MARES
 	case DC_FAMILY_MARES_NEMO:
 	case DC_FAMILY_MARES_PUCK:
 		rc = mares_nemo_parser_create (&parser, context, data, size, model);
@@ -142,6 +365,8 @@ dc_parser_new_internal (dc_parser_t **out, dc_context_t *context, const unsigned
 	case DC_FAMILY_MARES_ICONHD:
 		rc = mares_iconhd_parser_create (&parser, context, data, size, model, serial);
 		break;
+#endif
+#ifndef DISABLE_BACKEND_HW
 	case DC_FAMILY_HW_OSTC:
 		rc = hw_ostc_parser_create (&parser, context, data, size, serial);
 		break;
@@ -149,71 +374,122 @@ dc_parser_new_internal (dc_parser_t **out, dc_context_t *context, const unsigned
 	case DC_FAMILY_HW_OSTC3:
 		rc = hw_ostc3_parser_create (&parser, context, data, size, model, serial);
 		break;
+#endif
+#ifndef DISABLE_BACKEND_CRESSI
 	case DC_FAMILY_CRESSI_EDY:
+#endif
+#ifndef DISABLE_BACKEND_ZEAGLE
 	case DC_FAMILY_ZEAGLE_N2ITION3:
 		rc = cressi_edy_parser_create (&parser, context, data, size, model);
 		break;
+#endif
+#ifndef DISABLE_BACKEND_CRESSI
 	case DC_FAMILY_CRESSI_LEONARDO:
 		rc = cressi_leonardo_parser_create (&parser, context, data, size, model);
 		break;
 	case DC_FAMILY_CRESSI_GOA:
 		rc = cressi_goa_parser_create (&parser, context, data, size, model);
 		break;
+#endif
+#ifndef DISABLE_BACKEND_ATOMICS
 	case DC_FAMILY_ATOMICS_COBALT:
 		rc = atomics_cobalt_parser_create (&parser, context, data, size);
 		break;
+#endif
+#ifndef DISABLE_BACKEND_SHEARWATER
 	case DC_FAMILY_SHEARWATER_PREDATOR:
 		rc = shearwater_predator_parser_create (&parser, context, data, size, model, serial);
 		break;
 	case DC_FAMILY_SHEARWATER_PETREL:
 		rc = shearwater_petrel_parser_create (&parser, context, data, size, model, serial);
 		break;
+#endif
+#ifndef DISABLE_BACKEND_DIVERITE
 	case DC_FAMILY_DIVERITE_NITEKQ:
 		rc = diverite_nitekq_parser_create (&parser, context, data, size);
 		break;
+#endif
+#ifndef DISABLE_BACKEND_CITIZEN
 	case DC_FAMILY_CITIZEN_AQUALAND:
 		rc = citizen_aqualand_parser_create (&parser, context, data, size);
 		break;
+#endif
+#ifndef DISABLE_BACKEND_DIVESYSTEM
 	case DC_FAMILY_DIVESYSTEM_IDIVE:
 		rc = divesystem_idive_parser_create (&parser, context, data, size, model);
 		break;
+#endif
+#ifndef DISABLE_BACKEND_COCHRAN
 	case DC_FAMILY_COCHRAN_COMMANDER:
 		rc = cochran_commander_parser_create (&parser, context, data, size, model);
 		break;
+#endif
+#ifndef DISABLE_BACKEND_TECDIVING
 	case DC_FAMILY_TECDIVING_DIVECOMPUTEREU:
 		rc = tecdiving_divecomputereu_parser_create (&parser, context, data, size);
 		break;
+#endif
+#ifndef DISABLE_BACKEND_MCLEAN
 	case DC_FAMILY_MCLEAN_EXTREME:
 		rc = mclean_extreme_parser_create (&parser, context, data, size);
 		break;
+#endif
+#ifndef DISABLE_BACKEND_LIQUIVISION
 	case DC_FAMILY_LIQUIVISION_LYNX:
 		rc = liquivision_lynx_parser_create (&parser, context, data, size, model);
 		break;
+#endif
+#ifndef DISABLE_BACKEND_SPORASUB
 	case DC_FAMILY_SPORASUB_SP2:
 		rc = sporasub_sp2_parser_create (&parser, context, data, size);
 		break;
+#endif
+#ifndef DISABLE_BACKEND_DEEPSIX
 	case DC_FAMILY_DEEPSIX_EXCURSION:
 		rc = deepsix_excursion_parser_create (&parser, context, data, size);
 		break;
+#endif
+#ifndef DISABLE_BACKEND_SEAC
 	case DC_FAMILY_SEAC_SCREEN:
 		rc = seac_screen_parser_create (&parser, context, data, size);
 		break;
+#endif
+#ifndef DISABLE_BACKEND_DEEPBLU
 	case DC_FAMILY_DEEPBLU_COSMIQ:
 		rc = deepblu_cosmiq_parser_create (&parser, context, data, size);
 		break;
+#endif
+#ifndef DISABLE_BACKEND_OCEANS
 	case DC_FAMILY_OCEANS_S1:
 		rc = oceans_s1_parser_create (&parser, context, data, size);
 		break;
+#endif
+#ifndef DISABLE_BACKEND_DIVESOFT
 	case DC_FAMILY_DIVESOFT_FREEDOM:
 		rc = divesoft_freedom_parser_create (&parser, context, data, size);
 		break;
+#endif
 	default:
+		dc_context_release (context, buffer);
 		return DC_STATUS_INVALIDARGS;
 
 	// Not merged upstream yet
+#ifndef DISABLE_BACKEND_GARMIN
 	case DC_FAMILY_GARMIN:
 		rc = garmin_parser_create (&parser, context, data, size);
 		break;
+#endif
+	}
+
+	if (rc == DC_STATUS_SUCCESS) {
+		// The parser takes ownership of the copy.
+		parser->buffer = buffer;
+		parser->capacity = buffer ? size : 0;
+		parser->flags |= flags;
+		if (buffer)
+			dc_parser_stats_alloc (parser);
+	} else {
+		dc_context_release (context, buffer);
 	}
 
 	*out = parser;
@@ -231,7 +507,7 @@ dc_parser_new (dc_parser_t **out, dc_device_t *device, const unsigned char data[
 		return DC_STATUS_INVALIDARGS;
 
 	status = dc_parser_new_internal (&parser, device->context, data, size,
-		dc_device_get_type (device), device->devinfo.model, 0);
+		dc_device_get_type (device), device->devinfo.model, 0, 0);
 	if (status != DC_STATUS_SUCCESS)
 		goto error_exit;
 
@@ -253,45 +529,133 @@ dc_status_t
 dc_parser_new2 (dc_parser_t **out, dc_context_t *context, dc_descriptor_t *descriptor, const unsigned char data[], size_t size)
 {
 	return dc_parser_new_internal (out, context, data, size,
-		dc_descriptor_get_type (descriptor), dc_descriptor_get_model (descriptor), 0);
+		dc_descriptor_get_type (descriptor), dc_descriptor_get_model (descriptor), 0, 0);
+}
+
+dc_status_t
+dc_parser_new_summary (dc_parser_t **out, dc_context_t *context, dc_descriptor_t *descriptor, const unsigned char data[], size_t size)
+{
+	return dc_parser_new_internal (out, context, data, size,
+		dc_descriptor_get_type (descriptor), dc_descriptor_get_model (descriptor), 0, DC_PARSER_FLAG_SUMMARY);
+}
+
+dc_status_t
+dc_parser_new_borrowed (dc_parser_t **out, dc_context_t *context, dc_descriptor_t *descriptor, const unsigned char data[], size_t size)
+{
+	return dc_parser_new_internal (out, context, data, size,
+		dc_descriptor_get_type (descriptor), dc_descriptor_get_model (descriptor), 0, DC_PARSER_FLAG_BORROWED);
+}
+
+size_t
+dc_parser_sizeof (dc_descriptor_t *descriptor)
+{
+#ifdef DC_THREAD_LOCAL
+	dc_parser_storage_t storage = {NULL, 0, 0};
+	dc_parser_t *parser = NULL;
+
+	if (descriptor == NULL)
+		return 0;
+
+	// Create a parser without any storage. The backend fails with
+	// DC_STATUS_NOMEMORY, after the size of its parser is recorded.
+	g_storage = &storage;
+	dc_status_t rc = dc_parser_new_internal (&parser, NULL, NULL, 0,
+		dc_descriptor_get_type (descriptor), dc_descriptor_get_model (descriptor), 0, DC_PARSER_FLAG_BORROWED);
+	g_storage = NULL;
+
+	if (rc == DC_STATUS_SUCCESS) {
+		dc_parser_destroy (parser);
+	}
+
+	return storage.required;
+#else
+	return 0;
+#endif
+}
+
+dc_status_t
+dc_parser_init_inplace (dc_parser_t **out, void *buffer, size_t capacity, dc_context_t *context, dc_descriptor_t *descriptor, const unsigned char data[], size_t size)
+{
+#ifdef DC_THREAD_LOCAL
+	dc_parser_storage_t storage = {buffer, capacity, 0};
+
+	if (out == NULL || buffer == NULL || descriptor == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	g_storage = &storage;
+	dc_status_t rc = dc_parser_new_internal (out, context, data, size,
+		dc_descriptor_get_type (descriptor), dc_descriptor_get_model (descriptor), 0, DC_PARSER_FLAG_BORROWED);
+	g_storage = NULL;
+
+	if (rc == DC_STATUS_NOMEMORY && storage.required > capacity) {
+		ERROR (context, "Insufficient storage for the parser.");
+		return DC_STATUS_INVALIDARGS;
+	}
+
+	return rc;
+#else
+	return DC_STATUS_UNSUPPORTED;
+#endif
 }
 
 dc_parser_t *
 dc_parser_allocate (dc_context_t *context, const dc_parser_vtable_t *vtable, const unsigned char data[], size_t size)
 {
 	dc_parser_t *parser = NULL;
+	unsigned int flags = 0;
 
 	assert(vtable != NULL);
 	assert(vtable->size >= sizeof(dc_parser_t));
 
+#ifdef DC_THREAD_LOCAL
+	dc_parser_storage_t *storage = g_storage;
+	if (storage) {
+		// Use the caller provided storage, only once.
+		g_storage = NULL;
+		storage->required = vtable->size;
+		if (storage->buffer == NULL || storage->capacity < vtable->size)
+			return NULL;
+		parser = (dc_parser_t *) storage->buffer;
+		flags = DC_PARSER_FLAG_INPLACE;
+	}
+#endif
+
 	// Allocate memory.
-	parser = (dc_parser_t *) malloc (vtable->size);
 	if (parser == NULL) {
-		ERROR (context, "Failed to allocate memory.");
-		return parser;
+		parser = (dc_parser_t *) dc_context_malloc (context, vtable->size);
+		if (parser == NULL) {
+			ERROR (context, "Failed to allocate memory.");
+			return parser;
+		}
 	}
 
 	// Initialize the base class.
 	parser->vtable = vtable;
 	parser->context = context;
+	parser->flags = flags;
+	parser->buffer = NULL;
+	parser->capacity = 0;
+	parser->samplemask = DC_SAMPLE_MASK_ALL;
+	parser->implicit = 0;
+	parser->wanted = DC_SAMPLE_MASK_ALL;
+	parser->stopped = 0;
+	memset (&parser->stats, 0, sizeof (parser->stats));
+	if (context && context->parserstats) {
+		parser->flags |= DC_PARSER_FLAG_STATS;
+		if (!(flags & DC_PARSER_FLAG_INPLACE))
+			parser->stats.nallocs++;
+	}
 
+	// The data is referenced, not copied. The copy, if needed, is made
+	// by the caller before the backend specific parser is created.
 	if (size) {
-		// Allocate memory for the data.
-		parser->data = malloc (size);
-		if (parser->data == NULL) {
-			ERROR (context, "Failed to allocate memory.");
-			free (parser);
-			return NULL;
-		}
-
-		// Copy the data.
-		memcpy (parser->data, data, size);
+		parser->data = data;
 		parser->size = size;
 	} else {
 		parser->data = NULL;
 		parser->size = 0;
-
 	}
+
 	return parser;
 }
 
@@ -301,8 +665,9 @@ dc_parser_deallocate (dc_parser_t *parser)
 	if (parser == NULL)
 		return;
 
-	free (parser->data);
-	free (parser);
+	dc_context_release (parser->context, parser->buffer);
+	if (!(parser->flags & DC_PARSER_FLAG_INPLACE))
+		dc_context_release (parser->context, parser);
 }
 
 int
@@ -364,6 +729,30 @@ dc_parser_set_density (dc_parser_t *parser, double density)
 }
 
 
+dc_status_t
+dc_parser_set_sample_mask (dc_parser_t *parser, unsigned int mask)
+{
+	if (parser == NULL)
+		return DC_STATUS_UNSUPPORTED;
+
+	parser->samplemask = mask | DC_SAMPLE_MASK(DC_SAMPLE_TIME);
+
+	return DC_STATUS_SUCCESS;
+}
+
+
+dc_status_t
+dc_parser_set_implicit_time (dc_parser_t *parser, unsigned int enable)
+{
+	if (parser == NULL)
+		return DC_STATUS_UNSUPPORTED;
+
+	parser->implicit = enable != 0;
+
+	return DC_STATUS_SUCCESS;
+}
+
+
 dc_status_t
 dc_parser_get_datetime (dc_parser_t *parser, dc_datetime_t *datetime)
 {
@@ -376,6 +765,43 @@ dc_parser_get_datetime (dc_parser_t *parser, dc_datetime_t *datetime)
 	return parser->vtable->datetime (parser, datetime);
 }
 
+static dc_status_t
+dc_parser_samples_masked (dc_parser_t *parser, dc_status_t (*walk) (dc_parser_t *, dc_sample_callback_t, void *), dc_sample_callback_t callback, void *userdata);
+
+static void
+dc_sample_count_cb (dc_sample_type_t type, const dc_sample_value_t *value, void *userdata)
+{
+	dc_sample_count_t *count = (dc_sample_count_t *) userdata;
+
+	if (type == count->type)
+		count->count++;
+}
+
+/*
+ * Count the samples of a type, for the backends that can't tell the
+ * number of samples from the header.
+ */
+static dc_status_t
+dc_parser_count_samples (dc_parser_t *parser, unsigned int type, unsigned int *count)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+
+	if (parser->vtable->samples_foreach == NULL)
+		return DC_STATUS_UNSUPPORTED;
+
+	dc_sample_count_t state;
+	state.type = type;
+	state.count = 0;
+
+	status = dc_parser_samples_masked (parser, parser->vtable->samples_foreach, dc_sample_count_cb, &state);
+	if (status != DC_STATUS_SUCCESS)
+		return status;
+
+	*count = state.count;
+
+	return DC_STATUS_SUCCESS;
+}
+
 dc_status_t
 dc_parser_get_field (dc_parser_t *parser, dc_field_type_t type, unsigned int flags, void *value)
 {
@@ -385,7 +811,241 @@ dc_parser_get_field (dc_parser_t *parser, dc_field_type_t type, unsigned int fla
 	if (parser->vtable->field == NULL)
 		return DC_STATUS_UNSUPPORTED;
 
-	return parser->vtable->field (parser, type, flags, value);
+	dc_status_t status = DC_STATUS_SUCCESS;
+	SPAN_BEGIN (parser->context, "parser.field");
+	if (dc_parser_stats_enabled (parser)) {
+		dc_nsecs_t start = dc_clock_now ();
+		status = parser->vtable->field (parser, type, flags, value);
+		parser->stats.field_time += dc_clock_now () - start;
+		parser->stats.nfields++;
+	} else {
+		status = parser->vtable->field (parser, type, flags, value);
+	}
+	SPAN_END (parser->context, "parser.field", 0);
+
+	if (status == DC_STATUS_UNSUPPORTED && type == DC_FIELD_SAMPLE_COUNT && value)
+		status = dc_parser_count_samples (parser, flags, (unsigned int *) value);
+
+	return status;
+}
+
+
+static int
+dc_parser_summary_field (dc_parser_t *parser, dc_parser_summary_t *summary, dc_field_type_t type, unsigned int flags, void *value, dc_status_t *error)
+{
+	dc_status_t rc = parser->vtable->field (parser, type, flags, value);
+	if (rc != DC_STATUS_SUCCESS) {
+		// Remember the first real error, in case no field is available.
+		if (rc != DC_STATUS_UNSUPPORTED && *error == DC_STATUS_SUCCESS)
+			*error = rc;
+		return 0;
+	}
+
+	summary->fields |= DC_FIELD_MASK (type);
+
+	return 1;
+}
+
+
+static dc_status_t
+dc_parser_summary_generic (dc_parser_t *parser, dc_parser_summary_t *summary)
+{
+	dc_status_t error = DC_STATUS_SUCCESS;
+
+	dc_parser_summary_field (parser, summary, DC_FIELD_DIVETIME, 0, &summary->divetime, &error);
+	dc_parser_summary_field (parser, summary, DC_FIELD_MAXDEPTH, 0, &summary->maxdepth, &error);
+	dc_parser_summary_field (parser, summary, DC_FIELD_AVGDEPTH, 0, &summary->avgdepth, &error);
+	dc_parser_summary_field (parser, summary, DC_FIELD_SALINITY, 0, &summary->salinity, &error);
+	dc_parser_summary_field (parser, summary, DC_FIELD_ATMOSPHERIC, 0, &summary->atmospheric, &error);
+	dc_parser_summary_field (parser, summary, DC_FIELD_TEMPERATURE_SURFACE, 0, &summary->temperature_surface, &error);
+	dc_parser_summary_field (parser, summary, DC_FIELD_TEMPERATURE_MINIMUM, 0, &summary->temperature_minimum, &error);
+	dc_parser_summary_field (parser, summary, DC_FIELD_TEMPERATURE_MAXIMUM, 0, &summary->temperature_maximum, &error);
+	dc_parser_summary_field (parser, summary, DC_FIELD_DIVEMODE, 0, &summary->divemode, &error);
+	dc_parser_summary_field (parser, summary, DC_FIELD_DECOMODEL, 0, &summary->decomodel, &error);
+	dc_parser_summary_field (parser, summary, DC_FIELD_SAMPLE_INTERVAL, 0, &summary->sample_interval, &error);
+
+	if (dc_parser_summary_field (parser, summary, DC_FIELD_GASMIX_COUNT, 0, &summary->gasmix_count, &error)) {
+		for (unsigned int i = 0; i < summary->gasmix_count && i < DC_SUMMARY_GASMIXES; ++i) {
+			dc_parser_summary_field (parser, summary, DC_FIELD_GASMIX, i, summary->gasmix + i, &error);
+		}
+	}
+
+	if (dc_parser_summary_field (parser, summary, DC_FIELD_TANK_COUNT, 0, &summary->tank_count, &error)) {
+		for (unsigned int i = 0; i < summary->tank_count && i < DC_SUMMARY_TANKS; ++i) {
+			dc_parser_summary_field (parser, summary, DC_FIELD_TANK, i, summary->tank + i, &error);
+		}
+	}
+
+	while (summary->string_count < DC_SUMMARY_STRINGS &&
+		dc_parser_summary_field (parser, summary, DC_FIELD_STRING, summary->string_count, summary->string + summary->string_count, &error)) {
+		summary->string_count++;
+	}
+
+	while (summary->location_count < DC_SUMMARY_LOCATIONS &&
+		dc_parser_summary_field (parser, summary, DC_FIELD_LOCATION, summary->location_count, summary->location + summary->location_count, &error)) {
+		summary->location_count++;
+	}
+
+	if (summary->fields == 0)
+		return error;
+
+	return DC_STATUS_SUCCESS;
+}
+
+
+dc_status_t
+dc_parser_get_summary (dc_parser_t *parser, dc_parser_summary_t *summary)
+{
+	if (parser == NULL)
+		return DC_STATUS_UNSUPPORTED;
+
+	if (summary == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	memset (summary, 0, sizeof (*summary));
+
+	if (parser->vtable->summary == NULL && parser->vtable->field == NULL)
+		return DC_STATUS_UNSUPPORTED;
+
+	dc_status_t status = DC_STATUS_SUCCESS;
+	dc_nsecs_t start = 0;
+	SPAN_BEGIN (parser->context, "parser.summary");
+	if (dc_parser_stats_enabled (parser))
+		start = dc_clock_now ();
+
+	if (parser->vtable->summary)
+		status = parser->vtable->summary (parser, summary);
+	else
+		status = dc_parser_summary_generic (parser, summary);
+
+	if (dc_parser_stats_enabled (parser)) {
+		parser->stats.field_time += dc_clock_now () - start;
+		parser->stats.nfields++;
+	}
+	SPAN_END (parser->context, "parser.summary", 0);
+
+	return status;
+}
+
+
+dc_status_t
+dc_parser_get_stats (dc_parser_t *parser, dc_parser_stats_t *stats)
+{
+	if (parser == NULL || !dc_parser_stats_enabled (parser))
+		return DC_STATUS_UNSUPPORTED;
+
+	if (stats == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	*stats = parser->stats;
+	stats->samples_time /= 1000;
+	stats->field_time /= 1000;
+
+	return DC_STATUS_SUCCESS;
+}
+
+
+dc_status_t
+dc_parser_get_header_fields (dc_parser_t *parser, unsigned int *fields)
+{
+	if (parser == NULL)
+		return DC_STATUS_UNSUPPORTED;
+
+	if (fields == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	unsigned int profile = 0;
+	for (unsigned int i = 0; i < C_ARRAY_SIZE(g_profile_fields); ++i) {
+		if (g_profile_fields[i].family == parser->vtable->type) {
+			profile = g_profile_fields[i].fields;
+			break;
+		}
+	}
+
+	*fields = ~profile;
+
+	return DC_STATUS_SUCCESS;
+}
+
+
+static void
+dc_sample_filter_cb (dc_sample_type_t type, const dc_sample_value_t *value, void *userdata)
+{
+	dc_sample_filter_t *filter = (dc_sample_filter_t *) userdata;
+
+	if (filter->mask & DC_SAMPLE_MASK(type))
+		filter->callback (type, value, filter->userdata);
+}
+
+static void
+dc_sample_stats_cb (dc_sample_type_t type, const dc_sample_value_t *value, void *userdata)
+{
+	dc_sample_stats_t *state = (dc_sample_stats_t *) userdata;
+
+	if (type < DC_PARSER_STATS_TYPES)
+		state->stats->samples[type]++;
+	if (type == DC_SAMPLE_EVENT && value->event.type < DC_PARSER_STATS_TYPES)
+		state->stats->events[value->event.type]++;
+
+	state->callback (type, value, state->userdata);
+}
+
+/*
+ * Run a sample walk on behalf of the caller. The sample mask is made
+ * visible to the backend, and the samples of the unwanted types are
+ * dropped for the backends that decode them anyway.
+ */
+static dc_status_t
+dc_parser_samples_filtered (dc_parser_t *parser, dc_status_t (*walk) (dc_parser_t *, dc_sample_callback_t, void *), dc_sample_callback_t callback, void *userdata)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+
+	if (parser->samplemask == DC_SAMPLE_MASK_ALL || callback == NULL)
+		return walk (parser, callback, userdata);
+
+	dc_sample_filter_t filter;
+	filter.mask = parser->samplemask;
+	filter.callback = callback;
+	filter.userdata = userdata;
+
+	parser->wanted = parser->samplemask;
+	status = walk (parser, dc_sample_filter_cb, &filter);
+	parser->wanted = DC_SAMPLE_MASK_ALL;
+
+	return status;
+}
+
+/*
+ * Run a sample walk, and count the samples that are passed to the
+ * caller if the statistics are enabled. The walk is also reported as a
+ * tracing span.
+ */
+static dc_status_t
+dc_parser_samples_masked (dc_parser_t *parser, dc_status_t (*walk) (dc_parser_t *, dc_sample_callback_t, void *), dc_sample_callback_t callback, void *userdata)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+
+	if (!dc_parser_stats_enabled (parser)) {
+		SPAN_BEGIN (parser->context, "parser.samples");
+		status = dc_parser_samples_filtered (parser, walk, callback, userdata);
+		SPAN_END (parser->context, "parser.samples", parser->size);
+		return status;
+	}
+
+	dc_sample_stats_t state;
+	state.stats = &parser->stats;
+	state.callback = callback;
+	state.userdata = userdata;
+
+	SPAN_BEGIN (parser->context, "parser.samples");
+	dc_nsecs_t start = dc_clock_now ();
+	status = dc_parser_samples_filtered (parser, walk, callback ? dc_sample_stats_cb : NULL, &state);
+	parser->stats.samples_time += dc_clock_now () - start;
+	SPAN_END (parser->context, "parser.samples", parser->size);
+	parser->stats.nwalks++;
+	parser->stats.nbytes += parser->size;
+
+	return status;
 }
 
 
@@ -398,28 +1058,1353 @@ dc_parser_samples_foreach (dc_parser_t *parser, dc_sample_callback_t callback, v
 	if (parser->vtable->samples_foreach == NULL)
 		return DC_STATUS_UNSUPPORTED;
 
-	return parser->vtable->samples_foreach (parser, callback, userdata);
+	return dc_parser_samples_masked (parser, parser->vtable->samples_foreach, callback, userdata);
+}
+
+
+static void
+dc_sample_stop_cb (dc_sample_type_t type, const dc_sample_value_t *value, void *userdata)
+{
+	dc_sample_stop_t *state = (dc_sample_stop_t *) userdata;
+
+	if (state->parser->stopped)
+		return;
+
+	if (!state->callback (type, value, state->userdata))
+		state->parser->stopped = 1;
 }
 
 
 dc_status_t
-dc_parser_destroy (dc_parser_t *parser)
+dc_parser_samples_foreach2 (dc_parser_t *parser, dc_sample_callback2_t callback, void *userdata)
 {
 	dc_status_t status = DC_STATUS_SUCCESS;
 
 	if (parser == NULL)
-		return DC_STATUS_SUCCESS;
+		return DC_STATUS_UNSUPPORTED;
 
-	if (parser->vtable->destroy) {
-		status = parser->vtable->destroy (parser);
-	}
+	if (parser->vtable->samples_foreach == NULL)
+		return DC_STATUS_UNSUPPORTED;
 
-	dc_parser_deallocate (parser);
+	if (callback == NULL)
+		return dc_parser_samples_masked (parser, parser->vtable->samples_foreach, NULL, NULL);
+
+	dc_sample_stop_t state;
+	state.parser = parser;
+	state.callback = callback;
+	state.userdata = userdata;
+
+	parser->stopped = 0;
+	status = dc_parser_samples_masked (parser, parser->vtable->samples_foreach, dc_sample_stop_cb, &state);
+	parser->stopped = 0;
 
 	return status;
 }
 
 
+static void
+dc_sample_range_cb (dc_sample_type_t type, const dc_sample_value_t *value, void *userdata)
+{
+	dc_sample_range_t *range = (dc_sample_range_t *) userdata;
+
+	if (range->parser->stopped)
+		return;
+
+	if (type == DC_SAMPLE_TIME) {
+		if (value->time > range->end) {
+			range->parser->stopped = 1;
+			return;
+		}
+		range->inside = value->time >= range->begin;
+	}
+
+	if (range->inside)
+		range->callback (type, value, range->userdata);
+}
+
+
+dc_status_t
+dc_parser_samples_range (dc_parser_t *parser, unsigned int begin, unsigned int end, dc_sample_callback_t callback, void *userdata)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+
+	if (parser == NULL)
+		return DC_STATUS_UNSUPPORTED;
+
+	if (parser->vtable->samples_foreach == NULL)
+		return DC_STATUS_UNSUPPORTED;
+
+	if (begin > end)
+		return DC_STATUS_INVALIDARGS;
+
+	if (callback == NULL)
+		return DC_STATUS_SUCCESS;
+
+	dc_sample_filter_t filter;
+	filter.mask = parser->samplemask;
+	filter.callback = callback;
+	filter.userdata = userdata;
+
+	// The samples before the first time sample belong to the start of
+	// the dive.
+	dc_sample_range_t range;
+	range.parser = parser;
+	range.begin = begin;
+	range.end = end;
+	range.inside = begin == 0;
+	range.callback = callback;
+	range.userdata = userdata;
+	if (parser->samplemask != DC_SAMPLE_MASK_ALL) {
+		range.callback = dc_sample_filter_cb;
+		range.userdata = &filter;
+	}
+
+	parser->wanted = parser->samplemask;
+	parser->stopped = 0;
+	if (parser->vtable->samples_range) {
+		status = parser->vtable->samples_range (parser, begin, dc_sample_range_cb, &range);
+	} else {
+		status = parser->vtable->samples_foreach (parser, dc_sample_range_cb, &range);
+	}
+	parser->stopped = 0;
+	parser->wanted = DC_SAMPLE_MASK_ALL;
+
+	return status;
+}
+
+
+static void
+dc_sample_batch_clear (dc_sample_batch_t *batch, unsigned int row)
+{
+	if (batch->time)
+		batch->time[row] = DC_SAMPLE_BATCH_NONE;
+	if (batch->depth)
+		batch->depth[row] = NAN;
+	if (batch->temperature)
+		batch->temperature[row] = NAN;
+	if (batch->pressure) {
+		for (unsigned int i = 0; i < batch->ntanks; ++i) {
+			if (batch->pressure[i])
+				batch->pressure[i][row] = NAN;
+		}
+	}
+	if (batch->rbt)
+		batch->rbt[row] = DC_SAMPLE_BATCH_NONE;
+	if (batch->heartbeat)
+		batch->heartbeat[row] = DC_SAMPLE_BATCH_NONE;
+	if (batch->bearing)
+		batch->bearing[row] = DC_SAMPLE_BATCH_NONE;
+	if (batch->setpoint)
+		batch->setpoint[row] = NAN;
+	if (batch->ppo2)
+		batch->ppo2[row] = NAN;
+	if (batch->cns)
+		batch->cns[row] = NAN;
+	if (batch->gasmix)
+		batch->gasmix[row] = DC_SAMPLE_BATCH_NONE;
+	if (batch->deco_type)
+		batch->deco_type[row] = DC_SAMPLE_BATCH_NONE;
+	if (batch->deco_time)
+		batch->deco_time[row] = DC_SAMPLE_BATCH_NONE;
+	if (batch->deco_depth)
+		batch->deco_depth[row] = NAN;
+	if (batch->tts)
+		batch->tts[row] = DC_SAMPLE_BATCH_NONE;
+}
+
+/*
+ * Check whether a time sample continues a block of equally spaced rows.
+ * Without a known interval, the step between the first two rows is
+ * used.
+ */
+static int
+dc_sample_block_continues (unsigned int count, unsigned int start, unsigned int *interval, unsigned int time)
+{
+	if (count == 0)
+		return 1;
+
+	if (*interval == 0 && count == 1 && time > start) {
+		*interval = time - start;
+		return 1;
+	}
+
+	return *interval && time == start + count * *interval;
+}
+
+static unsigned int
+dc_sample_block_interval (dc_parser_t *parser)
+{
+	dc_sample_interval_t interval = {0, 0};
+
+	if (parser->vtable->field == NULL ||
+		parser->vtable->field (parser, DC_FIELD_SAMPLE_INTERVAL, 0, &interval) != DC_STATUS_SUCCESS)
+		return 0;
+
+	return interval.interval;
+}
+
+static void
+dc_sample_batch_flush (dc_sample_batch_state_t *state)
+{
+	if (state->count == 0)
+		return;
+
+	state->batch->count = state->count;
+	state->callback (state->batch, state->userdata);
+
+	state->batch->count = 0;
+	state->count = 0;
+}
+
+static void
+dc_sample_batch_cb (dc_sample_type_t type, const dc_sample_value_t *value, void *userdata)
+{
+	dc_sample_batch_state_t *state = (dc_sample_batch_state_t *) userdata;
+	dc_sample_batch_t *batch = state->batch;
+
+	// Every time sample starts a new row.
+	if (type == DC_SAMPLE_TIME) {
+		if (state->implicit && !dc_sample_block_continues (state->count, batch->start, &batch->interval, value->time))
+			dc_sample_batch_flush (state);
+
+		if (state->count == batch->capacity)
+			dc_sample_batch_flush (state);
+
+		if (state->implicit && state->count == 0) {
+			batch->start = value->time;
+			batch->interval = state->interval;
+		}
+
+		state->row = state->count++;
+		dc_sample_batch_clear (batch, state->row);
+
+		if (batch->time)
+			batch->time[state->row] = value->time;
+		return;
+	}
+
+	// Ignore samples before the first time sample.
+	if (state->count == 0)
+		return;
+
+	unsigned int row = state->row;
+
+	switch (type) {
+	case DC_SAMPLE_DEPTH:
+		if (batch->depth)
+			batch->depth[row] = value->depth;
+		break;
+	case DC_SAMPLE_TEMPERATURE:
+		if (batch->temperature)
+			batch->temperature[row] = value->temperature;
+		break;
+	case DC_SAMPLE_PRESSURE:
+		if (batch->pressure && value->pressure.tank < batch->ntanks &&
+			batch->pressure[value->pressure.tank])
+			batch->pressure[value->pressure.tank][row] = value->pressure.value;
+		break;
+	case DC_SAMPLE_RBT:
+		if (batch->rbt)
+			batch->rbt[row] = value->rbt;
+		break;
+	case DC_SAMPLE_HEARTBEAT:
+		if (batch->heartbeat)
+			batch->heartbeat[row] = value->heartbeat;
+		break;
+	case DC_SAMPLE_BEARING:
+		if (batch->bearing)
+			batch->bearing[row] = value->bearing;
+		break;
+	case DC_SAMPLE_SETPOINT:
+		if (batch->setpoint)
+			batch->setpoint[row] = value->setpoint;
+		break;
+	case DC_SAMPLE_PPO2:
+		// Prefer the combined value over the individual sensors.
+		if (batch->ppo2 && (value->ppo2.sensor == DC_SENSOR_NONE || isnan (batch->ppo2[row])))
+			batch->ppo2[row] = value->ppo2.value;
+		break;
+	case DC_SAMPLE_CNS:
+		if (batch->cns)
+			batch->cns[row] = value->cns;
+		break;
+	case DC_SAMPLE_GASMIX:
+		if (batch->gasmix)
+			batch->gasmix[row] = value->gasmix;
+		break;
+	case DC_SAMPLE_DECO:
+		if (batch->deco_type)
+			batch->deco_type[row] = value->deco.type;
+		if (batch->deco_time)
+			batch->deco_time[row] = value->deco.time;
+		if (batch->deco_depth)
+			batch->deco_depth[row] = value->deco.depth;
+		if (batch->tts && value->deco.tts)
+			batch->tts[row] = value->deco.tts;
+		break;
+	case DC_SAMPLE_TTS:
+		if (batch->tts)
+			batch->tts[row] = value->time;
+		break;
+	default:
+		break;
+	}
+}
+
+dc_status_t
+dc_parser_samples_batch (dc_parser_t *parser, dc_sample_batch_t *batch, dc_sample_batch_callback_t callback, void *userdata)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+
+	if (parser == NULL)
+		return DC_STATUS_UNSUPPORTED;
+
+	if (batch == NULL || batch->capacity == 0 || callback == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	batch->count = 0;
+
+	if (parser->vtable->samples_batch && !parser->implicit)
+		return parser->vtable->samples_batch (parser, batch, callback, userdata);
+
+	if (parser->vtable->samples_foreach == NULL)
+		return DC_STATUS_UNSUPPORTED;
+
+	// Build the blocks from the regular sample callbacks.
+	dc_sample_batch_state_t state;
+	state.batch = batch;
+	state.callback = callback;
+	state.userdata = userdata;
+	state.row = 0;
+	state.count = 0;
+	state.implicit = parser->implicit;
+	state.interval = parser->implicit ? dc_sample_block_interval (parser) : 0;
+
+	status = dc_parser_samples_masked (parser, parser->vtable->samples_foreach, dc_sample_batch_cb, &state);
+	if (status != DC_STATUS_SUCCESS)
+		return status;
+
+	dc_sample_batch_flush (&state);
+
+	return DC_STATUS_SUCCESS;
+}
+
+
+static unsigned int
+dc_sample_fixed_scale (double value, double scale)
+{
+	// Negative values and NAN end up as zero.
+	if (!(value > 0.0))
+		return 0;
+
+	return lrint (value * scale);
+}
+
+void
+dc_sample_fixed_convert (dc_sample_type_t type, const dc_sample_value_t *value, dc_sample_value_fixed_t *fixed)
+{
+	memset (fixed, 0, sizeof (*fixed));
+
+	switch (type) {
+	case DC_SAMPLE_TIME:
+	case DC_SAMPLE_TTS:
+		fixed->time = value->time;
+		break;
+	case DC_SAMPLE_DEPTH:
+		fixed->depth = dc_sample_fixed_scale (value->depth, 1000.0);
+		break;
+	case DC_SAMPLE_PRESSURE:
+		fixed->pressure.tank = value->pressure.tank;
+		fixed->pressure.value = dc_sample_fixed_scale (value->pressure.value, 1000.0);
+		break;
+	case DC_SAMPLE_TEMPERATURE:
+		fixed->temperature = dc_sample_fixed_scale (value->temperature + 273.15, 1000.0);
+		break;
+	case DC_SAMPLE_EVENT:
+		fixed->event.type = value->event.type;
+		fixed->event.time = value->event.time;
+		fixed->event.flags = value->event.flags;
+		fixed->event.value = value->event.value;
+		fixed->event.name = value->event.name;
+		break;
+	case DC_SAMPLE_RBT:
+		fixed->rbt = value->rbt;
+		break;
+	case DC_SAMPLE_HEARTBEAT:
+		fixed->heartbeat = value->heartbeat;
+		break;
+	case DC_SAMPLE_BEARING:
+		fixed->bearing = value->bearing;
+		break;
+	case DC_SAMPLE_VENDOR:
+		fixed->vendor.type = value->vendor.type;
+		fixed->vendor.size = value->vendor.size;
+		fixed->vendor.data = value->vendor.data;
+		break;
+	case DC_SAMPLE_SETPOINT:
+		fixed->setpoint = dc_sample_fixed_scale (value->setpoint, 1000.0);
+		break;
+	case DC_SAMPLE_PPO2:
+		fixed->ppo2.sensor = value->ppo2.sensor;
+		fixed->ppo2.value = dc_sample_fixed_scale (value->ppo2.value, 1000.0);
+		break;
+	case DC_SAMPLE_CNS:
+		fixed->cns = dc_sample_fixed_scale (value->cns, 10000.0);
+		break;
+	case DC_SAMPLE_DECO:
+		fixed->deco.type = value->deco.type;
+		fixed->deco.time = value->deco.time;
+		fixed->deco.depth = dc_sample_fixed_scale (value->deco.depth, 1000.0);
+		fixed->deco.tts = value->deco.tts;
+		break;
+	case DC_SAMPLE_GASMIX:
+		fixed->gasmix = value->gasmix;
+		break;
+	case DC_SAMPLE_POSITION:
+		fixed->position.latitude = lrint (value->position.latitude * 1000000.0);
+		fixed->position.longitude = lrint (value->position.longitude * 1000000.0);
+		break;
+	default:
+		break;
+	}
+}
+
+static void
+dc_sample_fixed_cb (dc_sample_type_t type, const dc_sample_value_t *value, void *userdata)
+{
+	dc_sample_fixed_state_t *state = (dc_sample_fixed_state_t *) userdata;
+	dc_sample_value_fixed_t fixed;
+
+	dc_sample_fixed_convert (type, value, &fixed);
+
+	state->callback (type, &fixed, state->userdata);
+}
+
+static void
+dc_sample_fixed_filter_cb (dc_sample_type_t type, const dc_sample_value_fixed_t *value, void *userdata)
+{
+	dc_sample_fixed_state_t *state = (dc_sample_fixed_state_t *) userdata;
+
+	if (state->mask & DC_SAMPLE_MASK(type))
+		state->callback (type, value, state->userdata);
+}
+
+dc_status_t
+dc_parser_samples_fixed (dc_parser_t *parser, dc_sample_fixed_callback_t callback, void *userdata)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+
+	if (parser == NULL)
+		return DC_STATUS_UNSUPPORTED;
+
+	dc_sample_fixed_state_t state;
+	state.callback = callback;
+	state.userdata = userdata;
+	state.mask = parser->samplemask;
+
+	// Backends with native fixed point samples.
+	if (parser->vtable->samples_fixed) {
+		if (parser->samplemask == DC_SAMPLE_MASK_ALL || callback == NULL)
+			return parser->vtable->samples_fixed (parser, callback, userdata);
+
+		parser->wanted = parser->samplemask;
+		status = parser->vtable->samples_fixed (parser, dc_sample_fixed_filter_cb, &state);
+		parser->wanted = DC_SAMPLE_MASK_ALL;
+
+		return status;
+	}
+
+	if (parser->vtable->samples_foreach == NULL)
+		return DC_STATUS_UNSUPPORTED;
+
+	return dc_parser_samples_masked (parser, parser->vtable->samples_foreach,
+		callback ? dc_sample_fixed_cb : NULL, &state);
+}
+
+static void
+dc_sample_batch_fixed_clear (dc_sample_batch_fixed_t *batch, unsigned int row)
+{
+	unsigned int *columns[] = {
+		batch->time, batch->depth, batch->temperature,
+		batch->rbt, batch->heartbeat, batch->bearing,
+		batch->setpoint, batch->ppo2, batch->cns, batch->gasmix,
+		batch->deco_type, batch->deco_time, batch->deco_depth,
+		batch->tts,
+	};
+
+	for (unsigned int i = 0; i < C_ARRAY_SIZE(columns); ++i) {
+		if (columns[i])
+			columns[i][row] = DC_SAMPLE_BATCH_NONE;
+	}
+
+	if (batch->pressure) {
+		for (unsigned int i = 0; i < batch->ntanks; ++i) {
+			if (batch->pressure[i])
+				batch->pressure[i][row] = DC_SAMPLE_BATCH_NONE;
+		}
+	}
+}
+
+static void
+dc_sample_batch_fixed_flush (dc_sample_batch_fixed_state_t *state)
+{
+	if (state->count == 0)
+		return;
+
+	state->batch->count = state->count;
+	state->callback (state->batch, state->userdata);
+
+	state->batch->count = 0;
+	state->count = 0;
+}
+
+static void
+dc_sample_batch_fixed_cb (dc_sample_type_t type, const dc_sample_value_fixed_t *value, void *userdata)
+{
+	dc_sample_batch_fixed_state_t *state = (dc_sample_batch_fixed_state_t *) userdata;
+	dc_sample_batch_fixed_t *batch = state->batch;
+
+	// Every time sample starts a new row.
+	if (type == DC_SAMPLE_TIME) {
+		if (state->implicit && !dc_sample_block_continues (state->count, batch->start, &batch->interval, value->time))
+			dc_sample_batch_fixed_flush (state);
+
+		if (state->count == batch->capacity)
+			dc_sample_batch_fixed_flush (state);
+
+		if (state->implicit && state->count == 0) {
+			batch->start = value->time;
+			batch->interval = state->interval;
+		}
+
+		state->row = state->count++;
+		dc_sample_batch_fixed_clear (batch, state->row);
+
+		if (batch->time)
+			batch->time[state->row] = value->time;
+		return;
+	}
+
+	// Ignore samples before the first time sample.
+	if (state->count == 0)
+		return;
+
+	unsigned int row = state->row;
+
+	switch (type) {
+	case DC_SAMPLE_DEPTH:
+		if (batch->depth)
+			batch->depth[row] = value->depth;
+		break;
+	case DC_SAMPLE_TEMPERATURE:
+		if (batch->temperature)
+			batch->temperature[row] = value->temperature;
+		break;
+	case DC_SAMPLE_PRESSURE:
+		if (batch->pressure && value->pressure.tank < batch->ntanks &&
+			batch->pressure[value->pressure.tank])
+			batch->pressure[value->pressure.tank][row] = value->pressure.value;
+		break;
+	case DC_SAMPLE_RBT:
+		if (batch->rbt)
+			batch->rbt[row] = value->rbt;
+		break;
+	case DC_SAMPLE_HEARTBEAT:
+		if (batch->heartbeat)
+			batch->heartbeat[row] = value->heartbeat;
+		break;
+	case DC_SAMPLE_BEARING:
+		if (batch->bearing)
+			batch->bearing[row] = value->bearing;
+		break;
+	case DC_SAMPLE_SETPOINT:
+		if (batch->setpoint)
+			batch->setpoint[row] = value->setpoint;
+		break;
+	case DC_SAMPLE_PPO2:
+		// Prefer the combined value over the individual sensors.
+		if (batch->ppo2 && (value->ppo2.sensor == DC_SENSOR_NONE || batch->ppo2[row] == DC_SAMPLE_BATCH_NONE))
+			batch->ppo2[row] = value->ppo2.value;
+		break;
+	case DC_SAMPLE_CNS:
+		if (batch->cns)
+			batch->cns[row] = value->cns;
+		break;
+	case DC_SAMPLE_GASMIX:
+		if (batch->gasmix)
+			batch->gasmix[row] = value->gasmix;
+		break;
+	case DC_SAMPLE_DECO:
+		if (batch->deco_type)
+			batch->deco_type[row] = value->deco.type;
+		if (batch->deco_time)
+			batch->deco_time[row] = value->deco.time;
+		if (batch->deco_depth)
+			batch->deco_depth[row] = value->deco.depth;
+		if (batch->tts && value->deco.tts)
+			batch->tts[row] = value->deco.tts;
+		break;
+	case DC_SAMPLE_TTS:
+		if (batch->tts)
+			batch->tts[row] = value->time;
+		break;
+	default:
+		break;
+	}
+}
+
+dc_status_t
+dc_parser_samples_batch_fixed (dc_parser_t *parser, dc_sample_batch_fixed_t *batch, dc_sample_batch_fixed_callback_t callback, void *userdata)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+
+	if (parser == NULL)
+		return DC_STATUS_UNSUPPORTED;
+
+	if (batch == NULL || batch->capacity == 0 || callback == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	batch->count = 0;
+
+	dc_sample_batch_fixed_state_t state;
+	state.batch = batch;
+	state.callback = callback;
+	state.userdata = userdata;
+	state.row = 0;
+	state.count = 0;
+	state.implicit = parser->implicit;
+	state.interval = parser->implicit ? dc_sample_block_interval (parser) : 0;
+
+	status = dc_parser_samples_fixed (parser, dc_sample_batch_fixed_cb, &state);
+	if (status != DC_STATUS_SUCCESS)
+		return status;
+
+	dc_sample_batch_fixed_flush (&state);
+
+	return DC_STATUS_SUCCESS;
+}
+
+
+/*
+ * Samples that describe the state at a point in time, where only the
+ * most recent value of an interval is kept. The pressure and ppo2
+ * samples are kept per tank and sensor.
+ */
+static int
+dc_sample_resample_replaces (const dc_sample_entry_t *entry, dc_sample_type_t type, const dc_sample_value_t *value)
+{
+	if (entry->type != type)
+		return 0;
+
+	switch (type) {
+	case DC_SAMPLE_EVENT:
+	case DC_SAMPLE_VENDOR:
+		return 0;
+	case DC_SAMPLE_PRESSURE:
+		return entry->value.pressure.tank == value->pressure.tank;
+	case DC_SAMPLE_PPO2:
+		return entry->value.ppo2.sensor == value->ppo2.sensor;
+	default:
+		return 1;
+	}
+}
+
+static void
+dc_sample_resample_emit_depth (dc_sample_resample_t *state, unsigned int time, double depth)
+{
+	dc_sample_value_t sample = {0};
+
+	sample.time = time;
+	state->callback (DC_SAMPLE_TIME, &sample, state->userdata);
+
+	sample.depth = depth;
+	state->callback (DC_SAMPLE_DEPTH, &sample, state->userdata);
+}
+
+static void
+dc_sample_resample_flush (dc_sample_resample_t *state)
+{
+	dc_sample_value_t sample = {0};
+
+	if (!state->active)
+		return;
+
+	if (state->mode == DC_RESAMPLE_ENVELOPE && state->ndepths) {
+		// Report the extremes in chronological order. The other
+		// samples are attached to the last one.
+		int maxfirst = state->time_max < state->time_min;
+		unsigned int time1 = maxfirst ? state->time_max : state->time_min;
+		unsigned int time2 = maxfirst ? state->time_min : state->time_max;
+		double depth1 = maxfirst ? state->depth_max : state->depth_min;
+		double depth2 = maxfirst ? state->depth_min : state->depth_max;
+		if (state->ndepths > 1 && time1 != time2)
+			dc_sample_resample_emit_depth (state, time1, depth1);
+		dc_sample_resample_emit_depth (state, time2, depth2);
+	} else {
+		sample.time = state->time;
+		state->callback (DC_SAMPLE_TIME, &sample, state->userdata);
+	}
+
+	for (unsigned int i = 0; i < state->count; ++i) {
+		const dc_sample_entry_t *entry = state->entries + i;
+		state->callback (entry->type, &entry->value, state->userdata);
+	}
+
+	state->active = 0;
+	state->ndepths = 0;
+	state->count = 0;
+}
+
+static void
+dc_sample_resample_cb (dc_sample_type_t type, const dc_sample_value_t *value, void *userdata)
+{
+	dc_sample_resample_t *state = (dc_sample_resample_t *) userdata;
+
+	if (state->status != DC_STATUS_SUCCESS)
+		return;
+
+	if (type == DC_SAMPLE_TIME) {
+		unsigned int index = value->time / state->interval;
+		if (state->active && index != state->index)
+			dc_sample_resample_flush (state);
+		state->active = 1;
+		state->index = index;
+		state->time = value->time;
+		return;
+	}
+
+	// Ignore samples before the first time sample.
+	if (!state->active)
+		return;
+
+	if (type == DC_SAMPLE_DEPTH && state->mode == DC_RESAMPLE_ENVELOPE) {
+		if (state->ndepths == 0 || value->depth < state->depth_min) {
+			state->depth_min = value->depth;
+			state->time_min = state->time;
+		}
+		if (state->ndepths == 0 || value->depth > state->depth_max) {
+			state->depth_max = value->depth;
+			state->time_max = state->time;
+		}
+		state->ndepths++;
+		return;
+	}
+
+	for (unsigned int i = 0; i < state->count; ++i) {
+		if (dc_sample_resample_replaces (state->entries + i, type, value)) {
+			state->entries[i].value = *value;
+			return;
+		}
+	}
+
+	if (state->count == state->capacity) {
+		unsigned int capacity = state->capacity ? state->capacity * 2 : 16;
+		dc_sample_entry_t *entries = (dc_sample_entry_t *) realloc (state->entries, capacity * sizeof (dc_sample_entry_t));
+		if (entries == NULL) {
+			state->status = DC_STATUS_NOMEMORY;
+			return;
+		}
+		state->entries = entries;
+		state->capacity = capacity;
+	}
+
+	state->entries[state->count].type = type;
+	state->entries[state->count].value = *value;
+	state->count++;
+}
+
+
+dc_status_t
+dc_parser_samples_resample (dc_parser_t *parser, unsigned int interval, dc_resample_mode_t mode, dc_sample_callback_t callback, void *userdata)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+
+	if (parser == NULL)
+		return DC_STATUS_UNSUPPORTED;
+
+	if (interval == 0 || callback == NULL ||
+		(mode != DC_RESAMPLE_LAST && mode != DC_RESAMPLE_ENVELOPE))
+		return DC_STATUS_INVALIDARGS;
+
+	if (parser->vtable->samples_foreach == NULL)
+		return DC_STATUS_UNSUPPORTED;
+
+	dc_sample_resample_t state = {0};
+	state.callback = callback;
+	state.userdata = userdata;
+	state.interval = interval;
+	state.mode = mode;
+	state.status = DC_STATUS_SUCCESS;
+
+	status = dc_parser_samples_masked (parser, parser->vtable->samples_foreach, dc_sample_resample_cb, &state);
+	if (status == DC_STATUS_SUCCESS)
+		status = state.status;
+	if (status == DC_STATUS_SUCCESS)
+		dc_sample_resample_flush (&state);
+
+	if (status == DC_STATUS_NOMEMORY)
+		ERROR (parser->context, "Failed to allocate memory.");
+
+	free (state.entries);
+
+	return status;
+}
+
+
+static void
+dc_sample_deco_flush (dc_sample_deco_t *state)
+{
+	dc_sample_value_t sample = {0};
+
+	if (!state->active)
+		return;
+
+	if (state->time > state->lasttime) {
+		dc_deco_update (&state->deco, state->lastdepth, state->depth, state->time - state->lasttime, &state->gasmix);
+		state->lasttime = state->time;
+	}
+	state->lastdepth = state->depth;
+
+	// A gas switch applies from the time of its row.
+	if (state->pending < state->ngasmixes)
+		state->gasmix = state->gasmixes[state->pending];
+	state->pending = DC_GASMIX_UNKNOWN;
+
+	// Always update the anchor of the gradient factors.
+	double ceiling = dc_deco_ceiling (&state->deco);
+
+	if (!state->hasdeco && (state->mask & DC_SAMPLE_MASK (DC_SAMPLE_DECO))) {
+		double stopdepth = 0.0;
+		unsigned int stoptime = 0;
+		sample.deco.tts = dc_deco_tts (&state->deco, state->depth, &state->gasmix, &stopdepth, &stoptime);
+		if (ceiling > 0.0 && stoptime) {
+			sample.deco.type = DC_DECO_DECOSTOP;
+			sample.deco.time = stoptime;
+			sample.deco.depth = stopdepth;
+		} else {
+			sample.deco.type = DC_DECO_NDL;
+			sample.deco.time = dc_deco_ndl (&state->deco, state->depth, &state->gasmix, MAXNDL);
+			sample.deco.depth = 0.0;
+		}
+		state->callback (DC_SAMPLE_DECO, &sample, state->userdata);
+	}
+
+	state->active = 0;
+	state->hasdeco = 0;
+}
+
+static void
+dc_sample_deco_cb (dc_sample_type_t type, const dc_sample_value_t *value, void *userdata)
+{
+	dc_sample_deco_t *state = (dc_sample_deco_t *) userdata;
+
+	switch (type) {
+	case DC_SAMPLE_TIME:
+		dc_sample_deco_flush (state);
+		state->active = 1;
+		state->time = value->time;
+		break;
+	case DC_SAMPLE_DEPTH:
+		state->depth = value->depth;
+		break;
+	case DC_SAMPLE_GASMIX:
+		state->pending = value->gasmix;
+		break;
+	case DC_SAMPLE_DECO:
+		state->hasdeco = 1;
+		break;
+	default:
+		break;
+	}
+
+	if (type == DC_SAMPLE_TIME || (state->mask & DC_SAMPLE_MASK (type)))
+		state->callback (type, value, state->userdata);
+}
+
+
+static int
+dc_sample_coalesce_match (const dc_sample_value_t *a, const dc_sample_value_t *b)
+{
+	if (a->event.type != b->event.type ||
+		a->event.value != b->event.value ||
+		(a->event.flags & ~SAMPLE_FLAGS_BEGIN) != b->event.flags)
+		return 0;
+
+	if (a->event.name == NULL || b->event.name == NULL)
+		return a->event.name == b->event.name;
+
+	return strcmp (a->event.name, b->event.name) == 0;
+}
+
+
+/*
+ * Report the end of the events which were not repeated in the current
+ * time sample, or of all events at the end of the dive.
+ */
+static void
+dc_sample_coalesce_flush (dc_sample_coalesce_t *state, unsigned int all)
+{
+	unsigned int count = 0;
+	for (unsigned int i = 0; i < state->count; ++i) {
+		if (state->seen[i] && !all) {
+			state->active[count] = state->active[i];
+			state->seen[count] = 0;
+			count++;
+			continue;
+		}
+
+		dc_sample_value_t sample = state->active[i];
+		sample.event.time = 0;
+		sample.event.flags = (sample.event.flags & ~SAMPLE_FLAGS_BEGIN) | SAMPLE_FLAGS_END;
+		state->callback (DC_SAMPLE_EVENT, &sample, state->userdata);
+	}
+
+	state->count = count;
+}
+
+
+static void
+dc_sample_coalesce_cb (dc_sample_type_t type, const dc_sample_value_t *value, void *userdata)
+{
+	dc_sample_coalesce_t *state = (dc_sample_coalesce_t *) userdata;
+
+	if (type == DC_SAMPLE_TIME) {
+		dc_sample_coalesce_flush (state, 0);
+		state->callback (type, value, state->userdata);
+		return;
+	}
+
+	// Only the events without a begin or end flag are coalesced. Point
+	// events are always passed on.
+	if (type != DC_SAMPLE_EVENT ||
+		(value->event.flags & (SAMPLE_FLAGS_BEGIN | SAMPLE_FLAGS_END)) ||
+		value->event.type == SAMPLE_EVENT_NONE ||
+		value->event.type == SAMPLE_EVENT_BOOKMARK ||
+		value->event.type == SAMPLE_EVENT_HEADING ||
+		value->event.type == SAMPLE_EVENT_GASCHANGE ||
+		value->event.type == SAMPLE_EVENT_GASCHANGE2) {
+		state->callback (type, value, state->userdata);
+		return;
+	}
+
+	for (unsigned int i = 0; i < state->count; ++i) {
+		if (dc_sample_coalesce_match (state->active + i, value)) {
+			state->seen[i] = 1;
+			return;
+		}
+	}
+
+	if (state->count == MAXCOALESCE) {
+		state->callback (type, value, state->userdata);
+		return;
+	}
+
+	dc_sample_value_t *sample = state->active + state->count;
+	*sample = *value;
+	sample->event.flags |= SAMPLE_FLAGS_BEGIN;
+	state->seen[state->count] = 1;
+	state->count++;
+
+	state->callback (type, sample, state->userdata);
+}
+
+
+dc_status_t
+dc_parser_samples_coalesce (dc_parser_t *parser, dc_sample_callback_t callback, void *userdata)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+
+	if (parser == NULL)
+		return DC_STATUS_UNSUPPORTED;
+
+	if (callback == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	if (parser->vtable->samples_foreach == NULL)
+		return DC_STATUS_UNSUPPORTED;
+
+	dc_sample_coalesce_t state;
+	state.callback = callback;
+	state.userdata = userdata;
+	state.count = 0;
+
+	status = dc_parser_samples_masked (parser, parser->vtable->samples_foreach, dc_sample_coalesce_cb, &state);
+	if (status == DC_STATUS_SUCCESS)
+		dc_sample_coalesce_flush (&state, 1);
+
+	return status;
+}
+
+
+static void
+dc_sample_vector_flush (dc_sample_vectors_t *state)
+{
+	if (state->ppo2.count) {
+		state->vector (DC_SAMPLE_PPO2, &state->ppo2, state->userdata);
+		state->ppo2.count = 0;
+	}
+
+	if (state->pressure.count) {
+		state->vector (DC_SAMPLE_PRESSURE, &state->pressure, state->userdata);
+		state->pressure.count = 0;
+	}
+}
+
+static void
+dc_sample_vector_add (dc_sample_vectors_t *state, dc_sample_type_t type, dc_sample_vector_t *vector, unsigned int index, double value)
+{
+	for (unsigned int i = 0; i < vector->count; ++i) {
+		if (vector->index[i] == index) {
+			vector->value[i] = value;
+			return;
+		}
+	}
+
+	// A full vector is passed on early, instead of dropping values.
+	if (vector->count == DC_SAMPLE_MAXVECTOR) {
+		state->vector (type, vector, state->userdata);
+		vector->count = 0;
+	}
+
+	vector->index[vector->count] = index;
+	vector->value[vector->count] = value;
+	vector->count++;
+}
+
+static void
+dc_sample_vector_cb (dc_sample_type_t type, const dc_sample_value_t *value, void *userdata)
+{
+	dc_sample_vectors_t *state = (dc_sample_vectors_t *) userdata;
+
+	switch (type) {
+	case DC_SAMPLE_TIME:
+		dc_sample_vector_flush (state);
+		break;
+	case DC_SAMPLE_PPO2:
+		dc_sample_vector_add (state, type, &state->ppo2, value->ppo2.sensor, value->ppo2.value);
+		return;
+	case DC_SAMPLE_PRESSURE:
+		dc_sample_vector_add (state, type, &state->pressure, value->pressure.tank, value->pressure.value);
+		return;
+	default:
+		break;
+	}
+
+	if (state->callback)
+		state->callback (type, value, state->userdata);
+}
+
+dc_status_t
+dc_parser_samples_vector (dc_parser_t *parser, dc_sample_callback_t callback, dc_sample_vector_callback_t vector, void *userdata)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+
+	if (parser == NULL)
+		return DC_STATUS_UNSUPPORTED;
+
+	if (vector == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	if (parser->vtable->samples_foreach == NULL)
+		return DC_STATUS_UNSUPPORTED;
+
+	dc_sample_vectors_t state;
+	state.callback = callback;
+	state.vector = vector;
+	state.userdata = userdata;
+	state.ppo2.count = 0;
+	state.pressure.count = 0;
+
+	status = dc_parser_samples_masked (parser, parser->vtable->samples_foreach, dc_sample_vector_cb, &state);
+	if (status == DC_STATUS_SUCCESS)
+		dc_sample_vector_flush (&state);
+
+	return status;
+}
+
+
+dc_status_t
+dc_parser_samples_deco (dc_parser_t *parser, dc_sample_callback_t callback, void *userdata)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+
+	if (parser == NULL)
+		return DC_STATUS_UNSUPPORTED;
+
+	if (callback == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	if (parser->vtable->samples_foreach == NULL)
+		return DC_STATUS_UNSUPPORTED;
+
+	double atmospheric = DEF_ATMOSPHERIC / BAR;
+	status = dc_parser_get_field (parser, DC_FIELD_ATMOSPHERIC, 0, &atmospheric);
+	if (status != DC_STATUS_SUCCESS && status != DC_STATUS_UNSUPPORTED)
+		return status;
+
+	dc_salinity_t salinity = {DC_WATER_SALT, DEF_DENSITY_SALT};
+	status = dc_parser_get_field (parser, DC_FIELD_SALINITY, 0, &salinity);
+	if (status != DC_STATUS_SUCCESS && status != DC_STATUS_UNSUPPORTED)
+		return status;
+	if (salinity.density <= 0.0)
+		salinity.density = salinity.type == DC_WATER_FRESH ? DEF_DENSITY_FRESH : DEF_DENSITY_SALT;
+
+	// Use the gradient factors of the dive computer, if they are known.
+	double gflow = 1.0, gfhigh = 1.0;
+	dc_decomodel_t decomodel = {DC_DECOMODEL_NONE};
+	status = dc_parser_get_field (parser, DC_FIELD_DECOMODEL, 0, &decomodel);
+	if (status != DC_STATUS_SUCCESS && status != DC_STATUS_UNSUPPORTED)
+		return status;
+	if (status == DC_STATUS_SUCCESS && decomodel.type == DC_DECOMODEL_BUHLMANN &&
+		decomodel.params.gf.low && decomodel.params.gf.high) {
+		gflow = decomodel.params.gf.low / 100.0;
+		gfhigh = decomodel.params.gf.high / 100.0;
+	}
+
+	unsigned int ngasmixes = 0;
+	status = dc_parser_get_field (parser, DC_FIELD_GASMIX_COUNT, 0, &ngasmixes);
+	if (status != DC_STATUS_SUCCESS && status != DC_STATUS_UNSUPPORTED)
+		return status;
+
+	dc_sample_deco_t state = {0};
+	state.callback = callback;
+	state.userdata = userdata;
+	state.mask = parser->samplemask;
+	state.pending = DC_GASMIX_UNKNOWN;
+	state.gasmix.oxygen = 0.21;
+	state.gasmix.nitrogen = 0.79;
+	dc_deco_init (&state.deco, atmospheric, salinity.density, gflow, gfhigh);
+
+	if (ngasmixes) {
+		state.gasmixes = (dc_gasmix_t *) dc_context_malloc (parser->context, ngasmixes * sizeof (dc_gasmix_t));
+		if (state.gasmixes == NULL) {
+			ERROR (parser->context, "Failed to allocate memory.");
+			return DC_STATUS_NOMEMORY;
+		}
+		dc_parser_stats_alloc (parser);
+
+		for (unsigned int i = 0; i < ngasmixes; ++i) {
+			status = dc_parser_get_field (parser, DC_FIELD_GASMIX, i, state.gasmixes + i);
+			if (status != DC_STATUS_SUCCESS)
+				goto error_free;
+		}
+
+		state.ngasmixes = ngasmixes;
+		state.gasmix = state.gasmixes[0];
+	}
+
+	// The deco state needs the depth and gas mix samples, so the sample
+	// mask is applied to the output only.
+	status = parser->vtable->samples_foreach (parser, dc_sample_deco_cb, &state);
+	if (status == DC_STATUS_SUCCESS)
+		dc_sample_deco_flush (&state);
+
+error_free:
+	dc_context_release (parser->context, state.gasmixes);
+	return status;
+}
+
+
+dc_status_t
+dc_parser_append (dc_parser_t *parser, const unsigned char data[], size_t size, dc_sample_callback_t callback, void *userdata)
+{
+	if (parser == NULL)
+		return DC_STATUS_UNSUPPORTED;
+
+	if (parser->vtable->samples_append == NULL)
+		return DC_STATUS_UNSUPPORTED;
+
+	if (data == NULL && size)
+		return DC_STATUS_INVALIDARGS;
+
+	if (size) {
+		size_t total = parser->size + size;
+		if (total > UINT_MAX)
+			return DC_STATUS_NOMEMORY;
+
+		// A borrowed buffer can't grow, and is replaced with a private
+		// copy. The capacity is doubled, to avoid a reallocation for
+		// every small piece of new data.
+		unsigned int borrowed = parser->flags & DC_PARSER_FLAG_BORROWED;
+		if (borrowed || total > parser->capacity) {
+			size_t capacity = parser->capacity ? parser->capacity : total;
+			while (capacity < total)
+				capacity *= 2;
+			if (capacity > UINT_MAX)
+				capacity = UINT_MAX;
+
+			unsigned char *buffer = (unsigned char *) dc_context_realloc (parser->context, parser->buffer, capacity);
+			if (buffer == NULL) {
+				ERROR (parser->context, "Failed to allocate memory.");
+				return DC_STATUS_NOMEMORY;
+			}
+
+			if (borrowed && parser->size)
+				memcpy (buffer, parser->data, parser->size);
+
+			parser->buffer = buffer;
+			parser->capacity = capacity;
+			dc_parser_stats_alloc (parser);
+			parser->flags &= ~DC_PARSER_FLAG_BORROWED;
+		}
+
+		memcpy (parser->buffer + parser->size, data, size);
+		parser->data = parser->buffer;
+		parser->size = total;
+	}
+
+	return dc_parser_samples_masked (parser, parser->vtable->samples_append, callback, userdata);
+}
+
+
+dc_status_t
+dc_parser_reset (dc_parser_t *parser, const unsigned char data[], size_t size)
+{
+	if (parser == NULL)
+		return DC_STATUS_UNSUPPORTED;
+
+	if (data == NULL && size)
+		return DC_STATUS_INVALIDARGS;
+
+	if (size == 0) {
+		parser->data = NULL;
+	} else if (parser->flags & DC_PARSER_FLAG_BORROWED) {
+		parser->data = data;
+	} else {
+		// Grow the private copy if necessary. A smaller dive fits
+		// in the existing buffer, so the allocation is reused.
+		if (size > parser->capacity) {
+			unsigned char *buffer = (unsigned char *) dc_context_realloc (parser->context, parser->buffer, size);
+			if (buffer == NULL) {
+				ERROR (parser->context, "Failed to allocate memory.");
+				return DC_STATUS_NOMEMORY;
+			}
+			parser->buffer = buffer;
+			parser->capacity = size;
+			dc_parser_stats_alloc (parser);
+		}
+
+		if (data != parser->buffer)
+			memcpy (parser->buffer, data, size);
+		parser->data = parser->buffer;
+	}
+	parser->size = size;
+
+	// Backends without any cached per-dive state don't need to
+	// provide a reset function. Rebinding the data is sufficient.
+	if (parser->vtable->reset)
+		return parser->vtable->reset (parser);
+
+	return DC_STATUS_SUCCESS;
+}
+
+
+dc_status_t
+dc_parser_destroy (dc_parser_t *parser)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+
+	if (parser == NULL)
+		return DC_STATUS_SUCCESS;
+
+	if (parser->vtable->destroy) {
+		status = parser->vtable->destroy (parser);
+	}
+
+	dc_parser_deallocate (parser);
+
+	return status;
+}
+
+
+static void
+dc_parse_batch_worker (void *userdata)
+{
+	dc_parse_batch_t *batch = (dc_parse_batch_t *) userdata;
+	dc_parser_t *parser = NULL;
+
+	while (1) {
+		// Take the next dive.
+		unsigned long i = dc_atomic_add (&batch->next, 1);
+		if (i >= batch->count)
+			break;
+
+		// Create the parser for the first dive, and reuse it for
+		// all the other dives processed by this worker.
+		dc_status_t rc = DC_STATUS_SUCCESS;
+		if (parser == NULL) {
+			rc = dc_parser_new_internal (&parser, batch->context,
+				batch->data[i], batch->size[i],
+				batch->family, batch->model, 0, DC_PARSER_FLAG_BORROWED);
+		} else {
+			rc = dc_parser_reset (parser, batch->data[i], batch->size[i]);
+		}
+
+		if (rc == DC_STATUS_SUCCESS) {
+			rc = batch->callback (parser, i, batch->userdata);
+		}
+
+		batch->status[i] = rc;
+	}
+
+	dc_parser_destroy (parser);
+}
+
+dc_status_t
+dc_parse_batch (dc_context_t *context, dc_descriptor_t *descriptor, const unsigned char *const data[], const size_t size[], unsigned int count, unsigned int nthreads, dc_parse_batch_callback_t callback, void *userdata, dc_status_t status[])
+{
+	dc_status_t rc = DC_STATUS_SUCCESS;
+	dc_status_t *results = status;
+
+	if (descriptor == NULL || callback == NULL || (count && (data == NULL || size == NULL)))
+		return DC_STATUS_INVALIDARGS;
+
+	if (count == 0)
+		return DC_STATUS_SUCCESS;
+
+	if (nthreads == 0)
+		nthreads = dc_thread_get_concurrency ();
+	if (nthreads > count)
+		nthreads = count;
+
+	// Allocate storage for the results, if necessary.
+	if (results == NULL) {
+		results = (dc_status_t *) dc_context_malloc (context, count * sizeof (dc_status_t));
+		if (results == NULL) {
+			ERROR (context, "Failed to allocate memory.");
+			return DC_STATUS_NOMEMORY;
+		}
+	}
+
+	dc_parse_batch_t batch = {
+		context,
+		dc_descriptor_get_type (descriptor),
+		dc_descriptor_get_model (descriptor),
+		data, size, count,
+		callback, userdata,
+		results,
+		0};
+
+	// The calling thread acts as the first worker, so the dives are
+	// still processed when no other threads can be started.
+	if (dc_thread_pool_run (nthreads, dc_parse_batch_worker, &batch) < nthreads) {
+		WARNING (context, "Failed to start worker thread.");
+	}
+
+	// Report the first error in input order.
+	for (unsigned int i = 0; i < count; ++i) {
+		if (results[i] != DC_STATUS_SUCCESS) {
+			rc = results[i];
+			break;
+		}
+	}
+
+	if (results != status)
+		dc_context_release (context, results);
+	return rc;
+}
+
+
 void
 sample_statistics_cb (dc_sample_type_t type, const dc_sample_value_t *value, void *userdata)
 {
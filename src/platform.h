@@ -30,8 +30,21 @@ extern "C" {
 
 #if defined(__GNUC__)
 #define DC_ATTR_FORMAT_PRINTF(a,b) __attribute__((format(printf, a, b)))
+#define DC_ATTR_UNUSED __attribute__((unused))
 #else
 #define DC_ATTR_FORMAT_PRINTF(a,b)
+#define DC_ATTR_UNUSED
+#endif
+
+/*
+ * Storage class for thread local variables, if supported by the compiler.
+ */
+#if defined(_MSC_VER)
+#define DC_THREAD_LOCAL __declspec(thread)
+#elif defined(__STDC_VERSION__) && (__STDC_VERSION__ >= 201112L)
+#define DC_THREAD_LOCAL _Thread_local
+#elif defined(__GNUC__)
+#define DC_THREAD_LOCAL __thread
 #endif
 
 #ifdef _WIN32
@@ -25,6 +25,7 @@
 #include "rbstream.h"
 #include "context-private.h"
 #include "device-private.h"
+#include "ringbuffer.h"
 
 struct dc_rbstream_t {
 	dc_device_t *device;
@@ -35,7 +36,8 @@ struct dc_rbstream_t {
 	unsigned int address;
 	unsigned int available;
 	unsigned int skip;
-	unsigned char cache[];
+	unsigned int readahead;
+	unsigned char *cache;
 };
 
 static unsigned int
@@ -85,12 +87,19 @@ dc_rbstream_new (dc_rbstream_t **out, dc_device_t *device, unsigned int pagesize
 	}
 
 	// Allocate memory.
-	rbstream = (dc_rbstream_t *) malloc (sizeof(*rbstream) + packetsize);
+	rbstream = (dc_rbstream_t *) malloc (sizeof(*rbstream));
 	if (rbstream == NULL) {
 		ERROR (device->context, "Failed to allocate memory.");
 		return DC_STATUS_NOMEMORY;
 	}
 
+	rbstream->cache = (unsigned char *) malloc (packetsize);
+	if (rbstream->cache == NULL) {
+		ERROR (device->context, "Failed to allocate memory.");
+		free (rbstream);
+		return DC_STATUS_NOMEMORY;
+	}
+
 	rbstream->device = device;
 	rbstream->pagesize = pagesize;
 	rbstream->packetsize = packetsize;
@@ -99,6 +108,7 @@ dc_rbstream_new (dc_rbstream_t **out, dc_device_t *device, unsigned int pagesize
 	rbstream->address = iceil(address, pagesize);
 	rbstream->available = 0;
 	rbstream->skip = rbstream->address - address;
+	rbstream->readahead = 1;
 
 	*out = rbstream;
 
@@ -106,13 +116,32 @@ dc_rbstream_new (dc_rbstream_t **out, dc_device_t *device, unsigned int pagesize
 }
 
 dc_status_t
-dc_rbstream_read (dc_rbstream_t *rbstream, dc_event_progress_t *progress, unsigned char data[], unsigned int size)
+dc_rbstream_set_readahead (dc_rbstream_t *rbstream, unsigned int npackets)
 {
-	dc_status_t rc = DC_STATUS_SUCCESS;
+	if (rbstream == NULL || npackets == 0)
+		return DC_STATUS_INVALIDARGS;
 
-	if (rbstream == NULL)
+	// The cache can only be resized while it's empty.
+	if (rbstream->available)
 		return DC_STATUS_INVALIDARGS;
 
+	unsigned char *cache = (unsigned char *) realloc (rbstream->cache, rbstream->packetsize * npackets);
+	if (cache == NULL) {
+		ERROR (rbstream->device->context, "Failed to allocate memory.");
+		return DC_STATUS_NOMEMORY;
+	}
+
+	rbstream->cache = cache;
+	rbstream->readahead = npackets;
+
+	return DC_STATUS_SUCCESS;
+}
+
+static dc_status_t
+dc_rbstream_read_internal (dc_rbstream_t *rbstream, dc_event_progress_t *progress, unsigned char data[], unsigned int size)
+{
+	dc_status_t rc = DC_STATUS_SUCCESS;
+
 	unsigned int address = rbstream->address;
 	unsigned int available = rbstream->available;
 	unsigned int skip = rbstream->skip;
@@ -125,16 +154,18 @@ dc_rbstream_read (dc_rbstream_t *rbstream, dc_event_progress_t *progress, unsign
 			if (address == rbstream->begin)
 				address = rbstream->end;
 
-			// Calculate the packet size.
-			unsigned int len = rbstream->packetsize;
+			// Calculate the size of the read-ahead packets.
+			unsigned int len = rbstream->packetsize * rbstream->readahead;
 			if (rbstream->begin + len > address)
 				len = address - rbstream->begin;
 
-			// Move to the begin of the current packet.
+			// Move to the begin of the current packets.
 			address -= len;
 
-			// Read the packet into the cache.
-			rc = dc_device_read (rbstream->device, address, rbstream->cache, rbstream->packetsize);
+			// Read the packets into the cache, with a single request.
+			// The size is rounded up to full packets, because the
+			// device may not support partial packets.
+			rc = dc_device_read (rbstream->device, address, rbstream->cache, iceil (len, rbstream->packetsize));
 			if (rc != DC_STATUS_SUCCESS)
 				return rc;
 
@@ -167,9 +198,70 @@ dc_rbstream_read (dc_rbstream_t *rbstream, dc_event_progress_t *progress, unsign
 	return rc;
 }
 
+dc_status_t
+dc_rbstream_read (dc_rbstream_t *rbstream, dc_event_progress_t *progress, unsigned char data[], unsigned int size)
+{
+	if (rbstream == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	dc_context_t *context = rbstream->device->context;
+
+	SPAN_BEGIN (context, "rbstream.read");
+	dc_status_t rc = dc_rbstream_read_internal (rbstream, progress, data, size);
+	SPAN_END (context, "rbstream.read", size);
+
+	return rc;
+}
+
+dc_status_t
+dc_rbstream_skip (dc_rbstream_t *rbstream, dc_event_progress_t *progress, unsigned int size)
+{
+	if (rbstream == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	if (size <= rbstream->available) {
+		rbstream->available -= size;
+	} else {
+		// Get the current position. With an empty cache, the
+		// pending skip is still part of the next packet.
+		unsigned int current = rbstream->available ?
+			rbstream->address + rbstream->available :
+			rbstream->address - rbstream->skip;
+
+		// Move the stream to the new position, and discard the cache.
+		unsigned int address = ringbuffer_decrement (
+			current, size,
+			rbstream->begin, rbstream->end);
+		rbstream->address = iceil (address, rbstream->pagesize);
+		rbstream->available = 0;
+		rbstream->skip = rbstream->address - address;
+	}
+
+	// Update and emit a progress event.
+	if (progress) {
+		progress->current += size;
+		device_event_emit (rbstream->device, DC_EVENT_PROGRESS, progress);
+	}
+
+	return DC_STATUS_SUCCESS;
+}
+
+int
+dc_rbstream_is_cached (dc_rbstream_t *rbstream, unsigned int size)
+{
+	if (rbstream == NULL)
+		return 0;
+
+	return size <= rbstream->available;
+}
+
 dc_status_t
 dc_rbstream_free (dc_rbstream_t *rbstream)
 {
+	if (rbstream == NULL)
+		return DC_STATUS_SUCCESS;
+
+	free (rbstream->cache);
 	free (rbstream);
 
 	return DC_STATUS_SUCCESS;
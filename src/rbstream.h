@@ -49,6 +49,24 @@ typedef struct dc_rbstream_t dc_rbstream_t;
 dc_status_t
 dc_rbstream_new (dc_rbstream_t **rbstream, dc_device_t *device, unsigned int pagesize, unsigned int packetsize, unsigned int begin, unsigned int end, unsigned int address);
 
+/**
+ * Set the number of packets to read ahead.
+ *
+ * By default, the ringbuffer stream reads one packet at a time. With a
+ * larger value, each refill of the cache requests several packets with
+ * a single read, which the device can process without waiting for the
+ * caller in between. The data beyond the end of the stream may be read
+ * unnecessarily, so this should only be enabled if that's cheap
+ * compared to the round-trip time.
+ *
+ * @param[in]  rbstream  A valid ringbuffer stream.
+ * @param[in]  npackets  The number of packets (non-zero).
+ * @returns #DC_STATUS_SUCCESS on success, or another #dc_status_t code
+ * on failure.
+ */
+dc_status_t
+dc_rbstream_set_readahead (dc_rbstream_t *rbstream, unsigned int npackets);
+
 /**
  * Read data from the ringbuffer stream.
  *
@@ -62,6 +80,32 @@ dc_rbstream_new (dc_rbstream_t **rbstream, dc_device_t *device, unsigned int pag
 dc_status_t
 dc_rbstream_read (dc_rbstream_t *rbstream, dc_event_progress_t *progress, unsigned char data[], unsigned int size);
 
+/**
+ * Skip data in the ringbuffer stream.
+ *
+ * The skipped data is only read if it's already cached, or shares a
+ * packet with data that is read afterwards.
+ *
+ * @param[in]  rbstream  A valid ringbuffer stream.
+ * @param[in]  progress  An (optional) progress event structure.
+ * @param[in]  size      The number of bytes to skip.
+ * @returns #DC_STATUS_SUCCESS on success, or another #dc_status_t code
+ * on failure.
+ */
+dc_status_t
+dc_rbstream_skip (dc_rbstream_t *rbstream, dc_event_progress_t *progress, unsigned int size);
+
+/**
+ * Check whether the next data is already cached.
+ *
+ * @param[in]  rbstream  A valid ringbuffer stream.
+ * @param[in]  size      The number of bytes.
+ * @returns Non-zero if the next size bytes can be read without
+ * accessing the device, or zero otherwise.
+ */
+int
+dc_rbstream_is_cached (dc_rbstream_t *rbstream, unsigned int size);
+
 /**
  * Destroy the ringbuffer stream.
  *
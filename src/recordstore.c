@@ -0,0 +1,557 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2026 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>  // FILE, fopen, rename
+#include <stdlib.h> // malloc, free
+#include <string.h> // memcpy, memcmp, strlen
+
+#include "recordstore.h"
+#include "context-private.h"
+#include "checksum.h"
+#include "thread.h"
+#include "array.h"
+
+#define SZ_HEADER  8
+#define SZ_CRC     4
+
+#define OFFSET_FAMILY 0
+#define OFFSET_SIZE   12
+
+typedef struct dc_record_entry_t {
+	/* The record header, with the size cleared. */
+	unsigned char key[DC_RECORD_HEADER_MAX];
+	unsigned int size;
+	long offset;
+} dc_record_entry_t;
+
+struct dc_record_store_t {
+	dc_context_t *context;
+	const dc_record_layout_t *layout;
+	dc_mutex_t mutex;
+	char *filename;
+	FILE *fp;
+	/* Open addressing hash table, with linear probing. Removed
+	 * keys are kept as entries with an empty payload. Only the
+	 * location of the records in the file is kept in memory. */
+	dc_record_entry_t *entries;
+	size_t count;
+	size_t capacity;
+	/* Number of records in the file. */
+	size_t nrecords;
+};
+
+#define ISUSED(entry) (array_uint32_le ((entry)->key + OFFSET_FAMILY) != DC_FAMILY_NULL)
+
+static unsigned int
+dc_record_hash (const unsigned char key[], unsigned int size)
+{
+	unsigned int h = 0x811C9DC5u;
+	for (unsigned int i = 0; i < size; ++i) {
+		h ^= key[i];
+		h *= 0x01000193u;
+	}
+	h ^= h >> 16;
+	h *= 0x7FEB352Du;
+	h ^= h >> 15;
+	return h;
+}
+
+static void
+dc_record_key (const dc_record_layout_t *layout, unsigned char key[DC_RECORD_HEADER_MAX], const unsigned char header[])
+{
+	memset (key, 0, DC_RECORD_HEADER_MAX);
+	memcpy (key, header, layout->header);
+	array_uint32_le_set (key + OFFSET_SIZE, 0);
+}
+
+static dc_record_entry_t *
+dc_record_find (dc_record_store_t *store, const unsigned char key[])
+{
+	if (store->capacity == 0)
+		return NULL;
+
+	size_t mask = store->capacity - 1;
+	size_t i = dc_record_hash (key, store->layout->header) & mask;
+	while (ISUSED (store->entries + i)) {
+		dc_record_entry_t *entry = store->entries + i;
+		if (memcmp (entry->key, key, store->layout->header) == 0)
+			return entry;
+		i = (i + 1) & mask;
+	}
+
+	return NULL;
+}
+
+static dc_status_t
+dc_record_grow (dc_record_store_t *store)
+{
+	size_t capacity = store->capacity ? store->capacity * 2 : store->layout->capacity;
+
+	dc_record_entry_t *entries = (dc_record_entry_t *) calloc (capacity, sizeof (dc_record_entry_t));
+	if (entries == NULL)
+		return DC_STATUS_NOMEMORY;
+
+	for (size_t n = 0; n < store->capacity; ++n) {
+		dc_record_entry_t *entry = store->entries + n;
+		if (!ISUSED (entry))
+			continue;
+
+		size_t i = dc_record_hash (entry->key, store->layout->header) & (capacity - 1);
+		while (ISUSED (entries + i))
+			i = (i + 1) & (capacity - 1);
+		entries[i] = *entry;
+	}
+
+	free (store->entries);
+	store->entries = entries;
+	store->capacity = capacity;
+
+	return DC_STATUS_SUCCESS;
+}
+
+/*
+ * Replace the location of the record of a key in the hash table.
+ */
+static dc_status_t
+dc_record_update (dc_record_store_t *store, const unsigned char header[], unsigned int size, long offset)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+
+	unsigned char key[DC_RECORD_HEADER_MAX];
+	dc_record_key (store->layout, key, header);
+
+	dc_record_entry_t *entry = dc_record_find (store, key);
+	if (entry == NULL) {
+		// Keep the load factor below 50%.
+		if (2 * (store->count + 1) > store->capacity) {
+			status = dc_record_grow (store);
+			if (status != DC_STATUS_SUCCESS)
+				return status;
+		}
+
+		size_t mask = store->capacity - 1;
+		size_t i = dc_record_hash (key, store->layout->header) & mask;
+		while (ISUSED (store->entries + i))
+			i = (i + 1) & mask;
+
+		entry = store->entries + i;
+		memcpy (entry->key, key, sizeof (key));
+		store->count++;
+	}
+
+	entry->size = size;
+	entry->offset = offset;
+
+	return DC_STATUS_SUCCESS;
+}
+
+/*
+ * Read a record into the buffer, and verify its checksum.
+ */
+static int
+dc_record_read (const dc_record_layout_t *layout, FILE *fp, dc_buffer_t *buffer, unsigned int size)
+{
+	unsigned int hsize = layout->header;
+
+	if (!dc_buffer_resize (buffer, hsize + size + SZ_CRC))
+		return 0;
+
+	unsigned char *record = dc_buffer_get_data (buffer);
+	if (fread (record, 1, hsize + size + SZ_CRC, fp) != hsize + size + SZ_CRC ||
+		array_uint32_le (record + OFFSET_SIZE) != size ||
+		array_uint32_le (record + hsize + size) != checksum_crc32 (record, hsize + size))
+		return 0;
+
+	return 1;
+}
+
+/*
+ * Index all records in the file. Records rejected by the filter are
+ * skipped. Returns DC_STATUS_DONE if the file ends with a truncated or
+ * corrupt record, for example because the application was interrupted
+ * while writing.
+ */
+static dc_status_t
+dc_record_load (dc_record_store_t *store, FILE *fp)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	const dc_record_layout_t *layout = store->layout;
+
+	unsigned char header[SZ_HEADER] = {0};
+	size_t n = fread (header, 1, sizeof (header), fp);
+	if (n == 0)
+		return DC_STATUS_DONE;
+	if (n != sizeof (header) ||
+		array_uint32_le (header + 0) != layout->magic ||
+		array_uint32_le (header + 4) != layout->version) {
+		ERROR (store->context, "Invalid %s file header.", layout->name);
+		return DC_STATUS_DATAFORMAT;
+	}
+
+	dc_buffer_t *record = dc_buffer_new_context (store->context, layout->header + SZ_CRC);
+	if (record == NULL) {
+		ERROR (store->context, "Failed to allocate memory.");
+		return DC_STATUS_NOMEMORY;
+	}
+
+	long offset = SZ_HEADER;
+	while (1) {
+		unsigned char peek[DC_RECORD_HEADER_MAX];
+		n = fread (peek, 1, layout->header, fp);
+		if (n == 0) {
+			if (ferror (fp)) {
+				ERROR (store->context, "Failed to read the file.");
+				status = DC_STATUS_IO;
+			}
+			break;
+		}
+
+		unsigned int size = array_uint32_le (peek + OFFSET_SIZE);
+		if (n != layout->header || size > layout->maximum ||
+			array_uint32_le (peek + OFFSET_FAMILY) == DC_FAMILY_NULL ||
+			fseek (fp, offset, SEEK_SET) != 0 ||
+			!dc_record_read (layout, fp, record, size)) {
+			WARNING (store->context, "Discarding corrupt %s record.", layout->name);
+			status = DC_STATUS_DONE;
+			break;
+		}
+
+		if (layout->accept == NULL || layout->accept (peek)) {
+			status = dc_record_update (store, peek, size, offset);
+			if (status != DC_STATUS_SUCCESS) {
+				ERROR (store->context, "Failed to allocate memory.");
+				break;
+			}
+		}
+
+		offset += layout->header + size + SZ_CRC;
+		store->nrecords++;
+	}
+
+	dc_buffer_free (record);
+
+	return status;
+}
+
+/*
+ * Replace the file with a new one, containing only the current records,
+ * which are copied from the old file. The new file is written under a
+ * temporary name first, and then renamed, so the old file remains
+ * intact until the new one is complete.
+ */
+static dc_status_t
+dc_record_rewrite (dc_record_store_t *store, FILE *old)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	const dc_record_layout_t *layout = store->layout;
+	dc_buffer_t *record = NULL;
+	long *offsets = NULL;
+	char *tmpname = NULL;
+	FILE *fp = NULL;
+
+	size_t length = strlen (store->filename);
+	tmpname = (char *) malloc (length + 5);
+	if (tmpname == NULL) {
+		ERROR (store->context, "Failed to allocate memory.");
+		status = DC_STATUS_NOMEMORY;
+		goto error_exit;
+	}
+	memcpy (tmpname, store->filename, length);
+	memcpy (tmpname + length, ".tmp", 5);
+
+	// The new locations are only applied once the file is complete.
+	offsets = (long *) malloc ((store->capacity ? store->capacity : 1) * sizeof (long));
+	record = dc_buffer_new_context (store->context, layout->header + SZ_CRC);
+	if (offsets == NULL || record == NULL) {
+		ERROR (store->context, "Failed to allocate memory.");
+		status = DC_STATUS_NOMEMORY;
+		goto error_free;
+	}
+
+	fp = fopen (tmpname, "wb");
+	if (fp == NULL) {
+		ERROR (store->context, "Failed to open the file.");
+		status = DC_STATUS_IO;
+		goto error_free;
+	}
+
+	unsigned char header[SZ_HEADER] = {0};
+	array_uint32_le_set (header + 0, layout->magic);
+	array_uint32_le_set (header + 4, layout->version);
+	int failed = fwrite (header, sizeof (header), 1, fp) != 1;
+
+	long offset = SZ_HEADER;
+	size_t nrecords = 0;
+	for (size_t i = 0; i < store->capacity && !failed; ++i) {
+		const dc_record_entry_t *entry = store->entries + i;
+		if (!ISUSED (entry) || entry->size == 0)
+			continue;
+
+		if (fseek (old, entry->offset, SEEK_SET) != 0 ||
+			!dc_record_read (layout, old, record, entry->size)) {
+			ERROR (store->context, "Failed to read the file.");
+			status = DC_STATUS_IO;
+			fclose (fp);
+			goto error_remove;
+		}
+
+		if (fwrite (dc_buffer_get_data (record), dc_buffer_get_size (record), 1, fp) != 1)
+			failed = 1;
+
+		offsets[i] = offset;
+		offset += dc_buffer_get_size (record);
+		nrecords++;
+	}
+
+	if (fclose (fp) != 0 || failed) {
+		ERROR (store->context, "Failed to write the file.");
+		status = DC_STATUS_IO;
+		goto error_remove;
+	}
+
+#ifdef _WIN32
+	// Windows can't rename over an existing file.
+	remove (store->filename);
+#endif
+	if (rename (tmpname, store->filename) != 0) {
+		ERROR (store->context, "Failed to rename the file.");
+		status = DC_STATUS_IO;
+		goto error_remove;
+	}
+
+	for (size_t i = 0; i < store->capacity; ++i) {
+		dc_record_entry_t *entry = store->entries + i;
+		if (!ISUSED (entry) || entry->size == 0)
+			continue;
+		entry->offset = offsets[i];
+	}
+
+	store->nrecords = nrecords;
+
+	dc_buffer_free (record);
+	free (offsets);
+	free (tmpname);
+
+	return DC_STATUS_SUCCESS;
+
+error_remove:
+	remove (tmpname);
+error_free:
+	dc_buffer_free (record);
+	free (offsets);
+	free (tmpname);
+error_exit:
+	return status;
+}
+
+dc_status_t
+dc_record_store_open (dc_record_store_t **out, dc_context_t *context, const char *filename, const dc_record_layout_t *layout)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	dc_record_store_t *store = NULL;
+
+	if (out == NULL || filename == NULL || layout == NULL ||
+		layout->header < OFFSET_SIZE + 4 || layout->header > DC_RECORD_HEADER_MAX)
+		return DC_STATUS_INVALIDARGS;
+
+	// Allocate memory.
+	store = (dc_record_store_t *) malloc (sizeof (dc_record_store_t));
+	if (store == NULL) {
+		ERROR (context, "Failed to allocate memory.");
+		status = DC_STATUS_NOMEMORY;
+		goto error_exit;
+	}
+
+	dc_mutex_t mutex = DC_MUTEX_INIT;
+
+	store->context = context;
+	store->layout = layout;
+	store->mutex = mutex;
+	store->filename = NULL;
+	store->fp = NULL;
+	store->entries = NULL;
+	store->count = 0;
+	store->capacity = 0;
+	store->nrecords = 0;
+
+	size_t length = strlen (filename) + 1;
+	store->filename = (char *) malloc (length);
+	if (store->filename == NULL) {
+		ERROR (context, "Failed to allocate memory.");
+		status = DC_STATUS_NOMEMORY;
+		goto error_free;
+	}
+	memcpy (store->filename, filename, length);
+
+	// Index the existing records. A missing file is the same as an
+	// empty one.
+	int rewrite = 1;
+	FILE *fp = fopen (filename, "rb");
+	if (fp) {
+		status = dc_record_load (store, fp);
+		if (status == DC_STATUS_SUCCESS) {
+			rewrite = 0;
+		} else if (status != DC_STATUS_DONE) {
+			fclose (fp);
+			goto error_free;
+		}
+	}
+
+	// Compact the file if it is missing, ends with a corrupt record, or
+	// contains mostly superseded or skipped records.
+	if (rewrite || store->nrecords > 2 * store->count + layout->capacity) {
+		status = dc_record_rewrite (store, fp);
+		if (status != DC_STATUS_SUCCESS) {
+			if (fp)
+				fclose (fp);
+			goto error_free;
+		}
+	}
+
+	if (fp)
+		fclose (fp);
+
+	store->fp = fopen (filename, "a+b");
+	if (store->fp == NULL) {
+		ERROR (context, "Failed to open the file.");
+		status = DC_STATUS_IO;
+		goto error_free;
+	}
+
+	*out = store;
+
+	return DC_STATUS_SUCCESS;
+
+error_free:
+	dc_record_store_close (store);
+error_exit:
+	return status;
+}
+
+dc_status_t
+dc_record_store_get (dc_record_store_t *store, const unsigned char header[], dc_buffer_t *payload)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+
+	if (store == NULL || header == NULL || payload == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	unsigned char key[DC_RECORD_HEADER_MAX];
+	dc_record_key (store->layout, key, header);
+
+	dc_buffer_clear (payload);
+
+	dc_mutex_lock (&store->mutex);
+
+	dc_record_entry_t *entry = dc_record_find (store, key);
+	if (entry == NULL || entry->size == 0) {
+		status = DC_STATUS_UNSUPPORTED;
+	} else if (fseek (store->fp, entry->offset, SEEK_SET) != 0 ||
+		!dc_record_read (store->layout, store->fp, payload, entry->size)) {
+		ERROR (store->context, "Failed to read the %s record.", store->layout->name);
+		status = DC_STATUS_IO;
+	} else {
+		dc_buffer_slice (payload, store->layout->header, entry->size);
+	}
+
+	dc_mutex_unlock (&store->mutex);
+
+	if (status != DC_STATUS_SUCCESS)
+		dc_buffer_clear (payload);
+
+	return status;
+}
+
+dc_status_t
+dc_record_store_set (dc_record_store_t *store, const unsigned char header[], const unsigned char data[], unsigned int size)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	unsigned char *record = NULL;
+
+	if (store == NULL || header == NULL ||
+		array_uint32_le (header + OFFSET_FAMILY) == DC_FAMILY_NULL ||
+		(data == NULL && size) || size > store->layout->maximum)
+		return DC_STATUS_INVALIDARGS;
+
+	unsigned int hsize = store->layout->header;
+
+	record = (unsigned char *) malloc (hsize + size + SZ_CRC);
+	if (record == NULL) {
+		ERROR (store->context, "Failed to allocate memory.");
+		return DC_STATUS_NOMEMORY;
+	}
+
+	memcpy (record, header, hsize);
+	array_uint32_le_set (record + OFFSET_SIZE, size);
+	if (size)
+		memcpy (record + hsize, data, size);
+	array_uint32_le_set (record + hsize + size, checksum_crc32 (record, hsize + size));
+
+	dc_mutex_lock (&store->mutex);
+
+	// Write the record first, so the index never contains a record that
+	// isn't stored. The file is opened in append mode, but the position
+	// is needed for the index.
+	long offset = -1;
+	if (fseek (store->fp, 0, SEEK_END) != 0 ||
+		(offset = ftell (store->fp)) < 0 ||
+		fwrite (record, hsize + size + SZ_CRC, 1, store->fp) != 1 ||
+		fflush (store->fp) != 0) {
+		ERROR (store->context, "Failed to write the file.");
+		status = DC_STATUS_IO;
+	} else {
+		store->nrecords++;
+		status = dc_record_update (store, record, size, offset);
+		if (status != DC_STATUS_SUCCESS) {
+			ERROR (store->context, "Failed to allocate memory.");
+		}
+	}
+
+	dc_mutex_unlock (&store->mutex);
+
+	free (record);
+
+	return status;
+}
+
+dc_status_t
+dc_record_store_close (dc_record_store_t *store)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+
+	if (store == NULL)
+		return DC_STATUS_SUCCESS;
+
+	if (store->fp && fclose (store->fp) != 0) {
+		ERROR (store->context, "Failed to close the file.");
+		status = DC_STATUS_IO;
+	}
+
+	free (store->entries);
+	free (store->filename);
+	free (store);
+
+	return status;
+}
@@ -0,0 +1,123 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2026 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+#ifndef DC_RECORDSTORE_H
+#define DC_RECORDSTORE_H
+
+#include <libdivecomputer/common.h>
+#include <libdivecomputer/context.h>
+#include <libdivecomputer/buffer.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * Maximum size of the record header.
+ */
+#define DC_RECORD_HEADER_MAX 32
+
+/**
+ * Opaque object representing an append-only record file.
+ *
+ * The file starts with a header, containing a magic value and a version
+ * number. Each update is appended as a record, containing a fixed size
+ * header, followed by the payload and a CRC-32 over the record. The
+ * record header starts with the family type, and stores the size of the
+ * payload at offset 12, both as 32 bit little endian values. All the
+ * other bytes of the record header form the key. The last valid record
+ * of each key wins, and an empty payload removes the key.
+ *
+ * Only the location of the records is kept in memory. The file is
+ * compacted when it is opened, if it ends with a corrupt record or
+ * contains mostly superseded records.
+ */
+typedef struct dc_record_store_t dc_record_store_t;
+
+/**
+ * The format of a record file.
+ */
+typedef struct dc_record_layout_t {
+	const char *name;      /**< Description, used in the log messages. */
+	unsigned int magic;    /**< Magic value of the file header. */
+	unsigned int version;  /**< Format version of the file header. */
+	unsigned int header;   /**< Size of the record header. */
+	unsigned int maximum;  /**< Maximum size of the payload. */
+	unsigned int capacity; /**< Initial capacity of the index. */
+	/** Optional filter, to skip records when loading the file. */
+	int (*accept) (const unsigned char header[]);
+} dc_record_layout_t;
+
+/**
+ * Open a record file, and index the existing records.
+ *
+ * A missing file is created.
+ *
+ * @param[out]  store     A location to store the record file.
+ * @param[in]   context   A valid context.
+ * @param[in]   filename  The name of the file.
+ * @param[in]   layout    The format of the file.
+ * @returns #DC_STATUS_SUCCESS on success, or another #dc_status_t code
+ * on failure.
+ */
+dc_status_t
+dc_record_store_open (dc_record_store_t **store, dc_context_t *context, const char *filename, const dc_record_layout_t *layout);
+
+/**
+ * Get the payload of the record with the same key as the record header.
+ *
+ * @param[in]   store     A valid record file.
+ * @param[in]   header    The record header. The size is ignored.
+ * @param[out]  payload   A buffer to store the payload.
+ * @returns #DC_STATUS_SUCCESS on success, #DC_STATUS_UNSUPPORTED if
+ * there is no record for the key, or another #dc_status_t code on
+ * failure.
+ */
+dc_status_t
+dc_record_store_get (dc_record_store_t *store, const unsigned char header[], dc_buffer_t *payload);
+
+/**
+ * Append a record, replacing the payload of its key.
+ *
+ * @param[in]   store     A valid record file.
+ * @param[in]   header    The record header. The size is filled in.
+ * @param[in]   data      The payload, or NULL to remove the key.
+ * @param[in]   size      The size of the payload.
+ * @returns #DC_STATUS_SUCCESS on success, or another #dc_status_t code
+ * on failure.
+ */
+dc_status_t
+dc_record_store_set (dc_record_store_t *store, const unsigned char header[], const unsigned char data[], unsigned int size);
+
+/**
+ * Close the record file, and free all resources.
+ *
+ * @param[in]   store     A valid record file.
+ * @returns #DC_STATUS_SUCCESS on success, or another #dc_status_t code
+ * on failure.
+ */
+dc_status_t
+dc_record_store_close (dc_record_store_t *store);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+#endif /* DC_RECORDSTORE_H */
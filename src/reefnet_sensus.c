@@ -53,16 +53,15 @@ static const dc_device_vtable_t reefnet_sensus_device_vtable = {
 	DC_FAMILY_REEFNET_SENSUS,
 	reefnet_sensus_device_set_fingerprint, /* set_fingerprint */
 	NULL, /* read */
+	NULL, /* read_range */
 	NULL, /* write */
 	reefnet_sensus_device_dump, /* dump */
 	reefnet_sensus_device_foreach, /* foreach */
+	NULL, /* foreach_header */
 	NULL, /* timesync */
 	reefnet_sensus_device_close /* close */
 };
 
-static dc_status_t
-reefnet_sensus_extract_dives (dc_device_t *device, const unsigned char data[], unsigned int size, dc_dive_callback_t callback, void *userdata);
-
 static dc_status_t
 reefnet_sensus_cancel (reefnet_sensus_device_t *device)
 {
@@ -319,8 +318,10 @@ reefnet_sensus_device_dump (dc_device_t *abstract, dc_buffer_t *buffer)
 	}
 
 	// Verify the checksum of the package.
+	device_phase_t phase = device_phase_set (abstract, DEVICE_PHASE_CHECKSUM);
 	unsigned short crc = array_uint16_le (answer + 4 + SZ_MEMORY);
 	unsigned short ccrc = checksum_add_uint16 (answer + 4, SZ_MEMORY, 0x00);
+	device_phase_set (abstract, phase);
 	if (crc != ccrc) {
 		ERROR (abstract->context, "Unexpected answer checksum.");
 		return DC_STATUS_PROTOCOL;
@@ -335,7 +336,7 @@ reefnet_sensus_device_dump (dc_device_t *abstract, dc_buffer_t *buffer)
 static dc_status_t
 reefnet_sensus_device_foreach (dc_device_t *abstract, dc_dive_callback_t callback, void *userdata)
 {
-	dc_buffer_t *buffer = dc_buffer_new (SZ_MEMORY);
+	dc_buffer_t *buffer = dc_buffer_new_context (abstract->context, SZ_MEMORY);
 	if (buffer == NULL)
 		return DC_STATUS_NOMEMORY;
 
@@ -354,7 +355,7 @@ reefnet_sensus_device_foreach (dc_device_t *abstract, dc_dive_callback_t callbac
 }
 
 
-static dc_status_t
+dc_status_t
 reefnet_sensus_extract_dives (dc_device_t *abstract, const unsigned char data[], unsigned int size, dc_dive_callback_t callback, void *userdata)
 {
 	reefnet_sensus_device_t *device = (reefnet_sensus_device_t*) abstract;
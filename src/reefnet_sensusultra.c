@@ -60,9 +60,11 @@ static const dc_device_vtable_t reefnet_sensusultra_device_vtable = {
 	DC_FAMILY_REEFNET_SENSUSULTRA,
 	reefnet_sensusultra_device_set_fingerprint, /* set_fingerprint */
 	NULL, /* read */
+	NULL, /* read_range */
 	NULL, /* write */
 	reefnet_sensusultra_device_dump, /* dump */
 	reefnet_sensusultra_device_foreach, /* foreach */
+	NULL, /* foreach_header */
 	NULL, /* timesync */
 	NULL /* close */
 };
@@ -297,6 +299,8 @@ reefnet_sensusultra_page (reefnet_sensusultra_device_t *device, unsigned char *d
 		if (nretries++ >= MAXRETRIES)
 			return rc;
 
+		device_stats_retry (abstract);
+
 		// Reject the packet.
 		rc = reefnet_sensusultra_send_uchar (device, REJECT);
 		if (rc != DC_STATUS_SUCCESS)
@@ -333,6 +337,8 @@ reefnet_sensusultra_send (reefnet_sensusultra_device_t *device, unsigned short c
 		if (nretries++ >= MAXRETRIES)
 			return rc;
 
+		device_stats_retry ((dc_device_t *) device);
+
 		// According to the developers guide, a 250 ms delay is suggested to
 		// guarantee that the prompt byte sent after the handshake packet is
 		// not accidentally buffered by the host and (mis)interpreted as part
@@ -376,6 +382,12 @@ reefnet_sensusultra_device_dump (dc_device_t *abstract, dc_buffer_t *buffer)
 		if (rc != DC_STATUS_SUCCESS)
 			return rc;
 
+		// Accept the packet immediately, such that the device can
+		// already transmit the next page while this one is processed.
+		rc = reefnet_sensusultra_send_uchar (device, ACCEPT);
+		if (rc != DC_STATUS_SUCCESS)
+			return rc;
+
 		// Update and emit a progress event.
 		progress.current += SZ_PACKET;
 		device_event_emit (abstract, DC_EVENT_PROGRESS, &progress);
@@ -386,11 +398,6 @@ reefnet_sensusultra_device_dump (dc_device_t *abstract, dc_buffer_t *buffer)
 			return DC_STATUS_NOMEMORY;
 		}
 
-		// Accept the packet.
-		rc = reefnet_sensusultra_send_uchar (device, ACCEPT);
-		if (rc != DC_STATUS_SUCCESS)
-			return rc;
-
 		nbytes += SZ_PACKET;
 		npages++;
 	}
@@ -644,7 +651,7 @@ reefnet_sensusultra_device_foreach (dc_device_t *abstract, dc_dive_callback_t ca
 {
 	reefnet_sensusultra_device_t *device = (reefnet_sensusultra_device_t*) abstract;
 
-	dc_buffer_t *buffer = dc_buffer_new (SZ_MEMORY);
+	dc_buffer_t *buffer = dc_buffer_new_context (abstract->context, SZ_MEMORY);
 	if (buffer == NULL) {
 		ERROR (abstract->context, "Failed to allocate memory.");
 		return DC_STATUS_NOMEMORY;
@@ -685,6 +692,14 @@ reefnet_sensusultra_device_foreach (dc_device_t *abstract, dc_dive_callback_t ca
 		if (array_isequal (packet + 2, SZ_PACKET, 0xFF) && nbytes != 0)
 			break;
 
+		// Accept the packet immediately, such that the device can
+		// already transmit the next page while this one is parsed.
+		rc = reefnet_sensusultra_send_uchar (device, ACCEPT);
+		if (rc != DC_STATUS_SUCCESS) {
+			dc_buffer_free (buffer);
+			return rc;
+		}
+
 		// Prepend the packet to the buffer.
 		if (!dc_buffer_prepend (buffer, packet + 2, SZ_PACKET)) {
 			dc_buffer_free (buffer);
@@ -707,13 +722,6 @@ reefnet_sensusultra_device_foreach (dc_device_t *abstract, dc_dive_callback_t ca
 		if (aborted)
 			break;
 
-		// Accept the packet.
-		rc = reefnet_sensusultra_send_uchar (device, ACCEPT);
-		if (rc != DC_STATUS_SUCCESS) {
-			dc_buffer_free (buffer);
-			return rc;
-		}
-
 		nbytes += SZ_PACKET;
 		npages++;
 	}
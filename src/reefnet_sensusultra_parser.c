@@ -53,6 +53,7 @@ static dc_status_t reefnet_sensusultra_parser_set_density (dc_parser_t *abstract
 static dc_status_t reefnet_sensusultra_parser_get_datetime (dc_parser_t *abstract, dc_datetime_t *datetime);
 static dc_status_t reefnet_sensusultra_parser_get_field (dc_parser_t *abstract, dc_field_type_t type, unsigned int flags, void *value);
 static dc_status_t reefnet_sensusultra_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_t callback, void *userdata);
+static dc_status_t reefnet_sensusultra_parser_reset (dc_parser_t *abstract);
 
 static const dc_parser_vtable_t reefnet_sensusultra_parser_vtable = {
 	sizeof(reefnet_sensusultra_parser_t),
@@ -62,7 +63,13 @@ static const dc_parser_vtable_t reefnet_sensusultra_parser_vtable = {
 	reefnet_sensusultra_parser_set_density, /* set_density */
 	reefnet_sensusultra_parser_get_datetime, /* datetime */
 	reefnet_sensusultra_parser_get_field, /* fields */
+	NULL, /* summary */
 	reefnet_sensusultra_parser_samples_foreach, /* samples_foreach */
+	NULL, /* samples_batch */
+	NULL, /* samples_fixed */
+	NULL, /* samples_append */
+	NULL, /* samples_range */
+	reefnet_sensusultra_parser_reset, /* reset */
 	NULL /* destroy */
 };
 
@@ -87,12 +94,23 @@ reefnet_sensusultra_parser_create (dc_parser_t **out, dc_context_t *context, con
 	parser->hydrostatic = DEF_DENSITY_SALT * GRAVITY;
 	parser->devtime = 0;
 	parser->systime = 0;
+	reefnet_sensusultra_parser_reset ((dc_parser_t *) parser);
+
+	*out = (dc_parser_t*) parser;
+
+	return DC_STATUS_SUCCESS;
+}
+
+
+static dc_status_t
+reefnet_sensusultra_parser_reset (dc_parser_t *abstract)
+{
+	reefnet_sensusultra_parser_t *parser = (reefnet_sensusultra_parser_t *) abstract;
+
 	parser->cached = 0;
 	parser->divetime = 0;
 	parser->maxdepth = 0;
 
-	*out = (dc_parser_t*) parser;
-
 	return DC_STATUS_SUCCESS;
 }
 
@@ -0,0 +1,1360 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2026 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "socket.h"
+
+#ifdef _WIN32
+#include <ws2tcpip.h>
+#else
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#endif
+
+#include <libdivecomputer/relay.h>
+#include <libdivecomputer/buffer.h>
+#include <libdivecomputer/ioctl.h>
+#include <libdivecomputer/serial.h>
+#include <libdivecomputer/usb.h>
+#include <libdivecomputer/ble.h>
+
+#include "common-private.h"
+#include "context-private.h"
+#include "iostream-private.h"
+#include "array.h"
+#include "platform.h"
+#include "timer.h"
+
+#define RELAY_VERSION 2
+#define HEADERSIZE 8
+
+// Maximum size of a message payload, and of the decompressed data.
+#define MAXSIZE    (1024 * 1024)
+
+// Maximum amount of received data buffered on the remote side.
+#define MAXINPUT   (16 * 1024 * 1024)
+
+// Maximum length of the shared token.
+#define MAXTOKEN   256
+
+// Maximum time (in milliseconds) to receive the rest of a message.
+#define MSGTIMEOUT 10000
+
+// Timeout (in milliseconds) of the read ahead on the serving side,
+// which is also the maximum delay before a request is serviced.
+#define READAHEAD  10
+#define CHUNKSIZE  4096
+
+// Queued messages are sent once they exceed this size.
+#define QUEUESIZE  (64 * 1024)
+
+// Smaller payloads are never compressed.
+#define MINCOMPRESS 64
+
+#define FLAG_COMPRESSED 0x01
+
+typedef enum dc_relay_type_t {
+	RELAY_HELLO     = 0x01,
+	RELAY_CONFIGURE = 0x02,
+	RELAY_SET_BREAK = 0x03,
+	RELAY_SET_DTR   = 0x04,
+	RELAY_SET_RTS   = 0x05,
+	RELAY_GET_LINES = 0x06,
+	RELAY_WRITE     = 0x07,
+	RELAY_IOCTL     = 0x08,
+	RELAY_FLUSH     = 0x09,
+	RELAY_PURGE     = 0x0A,
+	RELAY_SLEEP     = 0x0B,
+	RELAY_CLOSE     = 0x0C,
+	RELAY_REPLY     = 0x80,
+	RELAY_DATA      = 0x81,
+	RELAY_ERROR     = 0x82,
+} dc_relay_type_t;
+
+static dc_status_t dc_relay_set_timeout (dc_iostream_t *iostream, int timeout);
+static dc_status_t dc_relay_set_break (dc_iostream_t *iostream, unsigned int value);
+static dc_status_t dc_relay_set_dtr (dc_iostream_t *iostream, unsigned int value);
+static dc_status_t dc_relay_set_rts (dc_iostream_t *iostream, unsigned int value);
+static dc_status_t dc_relay_get_lines (dc_iostream_t *iostream, unsigned int *value);
+static dc_status_t dc_relay_get_available (dc_iostream_t *iostream, size_t *value);
+static dc_status_t dc_relay_configure (dc_iostream_t *iostream, unsigned int baudrate, unsigned int databits, dc_parity_t parity, dc_stopbits_t stopbits, dc_flowcontrol_t flowcontrol);
+static dc_status_t dc_relay_poll (dc_iostream_t *iostream, int timeout);
+static dc_status_t dc_relay_read (dc_iostream_t *iostream, void *data, size_t size, size_t *actual);
+static dc_status_t dc_relay_write (dc_iostream_t *iostream, const void *data, size_t size, size_t *actual);
+static dc_status_t dc_relay_ioctl (dc_iostream_t *iostream, unsigned int request, void *data, size_t size);
+static dc_status_t dc_relay_flush (dc_iostream_t *iostream);
+static dc_status_t dc_relay_purge (dc_iostream_t *iostream, dc_direction_t direction);
+static dc_status_t dc_relay_sleep (dc_iostream_t *iostream, unsigned int milliseconds);
+static dc_status_t dc_relay_close (dc_iostream_t *iostream);
+
+typedef struct dc_relay_t {
+	/* Base class. */
+	dc_socket_t base;
+	/* Internal state. */
+	int timeout;
+	unsigned int flags;
+	unsigned int packets;
+	/* Error of a queued operation or the read ahead, which is
+	 * reported by the next operation. */
+	dc_status_t error;
+	/* The received data, and for the packet based transports, the
+	 * size of each packet (32 bit little endian). */
+	dc_buffer_t *input;
+	dc_buffer_t *sizes;
+	/* The queued messages, and the offset of the last write message
+	 * in the queue, such that consecutive writes can be merged. */
+	dc_buffer_t *output;
+	size_t lastwrite;
+	dc_buffer_t *message;
+} dc_relay_t;
+
+static const dc_iostream_vtable_t dc_relay_vtable = {
+	sizeof(dc_relay_t),
+	dc_relay_set_timeout, /* set_timeout */
+	dc_relay_set_break, /* set_break */
+	dc_relay_set_dtr, /* set_dtr */
+	dc_relay_set_rts, /* set_rts */
+	dc_relay_get_lines, /* get_lines */
+	dc_relay_get_available, /* get_available */
+	dc_relay_configure, /* configure */
+	dc_relay_poll, /* poll */
+	dc_relay_read, /* read */
+	dc_relay_write, /* write */
+	NULL, /* read_async */
+	NULL, /* write_async */
+	NULL, /* writev */
+	dc_relay_ioctl, /* ioctl */
+	dc_relay_flush, /* flush */
+	dc_relay_purge, /* purge */
+	dc_relay_sleep, /* sleep */
+	NULL, /* set_interrupt */
+	dc_relay_close, /* close */
+};
+
+/* The connection on the serving side. */
+static const dc_iostream_vtable_t dc_relay_connection_vtable = {
+	sizeof(dc_socket_t),
+	dc_socket_set_timeout, /* set_timeout */
+	NULL, /* set_break */
+	NULL, /* set_dtr */
+	NULL, /* set_rts */
+	NULL, /* get_lines */
+	dc_socket_get_available, /* get_available */
+	NULL, /* configure */
+	dc_socket_poll, /* poll */
+	dc_socket_read, /* read */
+	dc_socket_write, /* write */
+	NULL, /* read_async */
+	NULL, /* write_async */
+	NULL, /* writev */
+	dc_socket_ioctl, /* ioctl */
+	NULL, /* flush */
+	NULL, /* purge */
+	dc_socket_sleep, /* sleep */
+	NULL, /* set_interrupt */
+	dc_socket_close, /* close */
+};
+
+/*
+ * PackBits run length encoding. The erased memory, which is usually
+ * the largest part of a memory dump, compresses very well. The encoded
+ * data starts with the original size (32 bit little endian).
+ */
+static int
+dc_relay_compress (dc_buffer_t *output, const unsigned char data[], size_t size)
+{
+	size_t i = 0;
+
+	unsigned char length[4];
+	array_uint32_le_set (length, size);
+
+	dc_buffer_clear (output);
+	if (!dc_buffer_append (output, length, sizeof (length)))
+		return 0;
+
+	while (i < size) {
+		size_t run = 1;
+		while (i + run < size && run < 128 && data[i + run] == data[i])
+			run++;
+
+		if (run >= 3) {
+			unsigned char header[2] = {(unsigned char) (257 - run), data[i]};
+			if (!dc_buffer_append (output, header, sizeof (header)))
+				return 0;
+			i += run;
+			continue;
+		}
+
+		// Literals, up to the start of the next run.
+		size_t start = i;
+		while (i < size && i - start < 128) {
+			if (i + 2 < size && data[i] == data[i + 1] && data[i] == data[i + 2])
+				break;
+			i++;
+		}
+
+		unsigned char header = (unsigned char) (i - start - 1);
+		if (!dc_buffer_append (output, &header, 1) ||
+			!dc_buffer_append (output, data + start, i - start))
+			return 0;
+	}
+
+	return 1;
+}
+
+/*
+ * Decode the data, and append it to the output buffer. The space for
+ * the declared original size is allocated up front, and the decoded
+ * data should match that size exactly.
+ */
+static dc_status_t
+dc_relay_decompress (dc_buffer_t *output, const unsigned char data[], size_t size)
+{
+	if (size < 4)
+		return DC_STATUS_DATAFORMAT;
+
+	size_t length = array_uint32_le (data);
+	if (length > MAXSIZE)
+		return DC_STATUS_DATAFORMAT;
+
+	size_t offset = dc_buffer_get_size (output);
+	if (!dc_buffer_resize (output, offset + length))
+		return DC_STATUS_NOMEMORY;
+
+	unsigned char *p = dc_buffer_get_data (output) + offset;
+
+	size_t i = 4, n = 0;
+	while (i < size) {
+		unsigned int header = data[i++];
+		if (header < 128) {
+			size_t count = header + 1;
+			if (i + count > size || count > length - n)
+				break;
+			memcpy (p + n, data + i, count);
+			n += count;
+			i += count;
+		} else if (header > 128) {
+			size_t count = 257 - header;
+			if (i + 1 > size || count > length - n)
+				break;
+			memset (p + n, data[i], count);
+			n += count;
+			i++;
+		}
+	}
+
+	if (i != size || n != length) {
+		dc_buffer_resize (output, offset);
+		return DC_STATUS_DATAFORMAT;
+	}
+
+	return DC_STATUS_SUCCESS;
+}
+
+static void
+dc_relay_header (unsigned char header[HEADERSIZE], unsigned int type, unsigned int flags, size_t size)
+{
+	header[0] = type;
+	header[1] = flags;
+	header[2] = 0;
+	header[3] = 0;
+	array_uint32_le_set (header + 4, size);
+}
+
+/*
+ * Append a message to the buffer.
+ */
+static int
+dc_relay_append (dc_buffer_t *buffer, unsigned int type, unsigned int flags, const unsigned char data[], size_t size)
+{
+	unsigned char header[HEADERSIZE];
+	dc_relay_header (header, type, flags, size);
+
+	return dc_buffer_append (buffer, header, sizeof (header)) &&
+		dc_buffer_append (buffer, data, size);
+}
+
+static dc_status_t
+dc_relay_send (dc_iostream_t *socket, dc_buffer_t *buffer)
+{
+	dc_status_t status = dc_socket_write (socket, dc_buffer_get_data (buffer), dc_buffer_get_size (buffer), NULL);
+	if (status != DC_STATUS_SUCCESS) {
+		ERROR (socket->context, "Failed to send the message.");
+	}
+
+	dc_buffer_clear (buffer);
+
+	return status;
+}
+
+/*
+ * Receive a message, waiting at most the timeout for its start.
+ */
+static dc_status_t
+dc_relay_receive (dc_iostream_t *socket, int timeout, unsigned int *type, unsigned int *flags, dc_buffer_t *payload)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	unsigned char header[HEADERSIZE];
+	size_t nbytes = 0;
+
+	status = dc_socket_poll (socket, timeout);
+	if (status != DC_STATUS_SUCCESS)
+		return status;
+
+	dc_socket_set_timeout (socket, MSGTIMEOUT);
+
+	status = dc_socket_read (socket, header, sizeof (header), &nbytes);
+	if (status != DC_STATUS_SUCCESS) {
+		if (status == DC_STATUS_TIMEOUT) {
+			if (nbytes != 0)
+				ERROR (socket->context, "Incomplete message header.");
+			status = DC_STATUS_IO;
+		}
+		return status;
+	}
+
+	unsigned int length = array_uint32_le (header + 4);
+	if (length > MAXSIZE) {
+		ERROR (socket->context, "Message too large (%u bytes).", length);
+		return DC_STATUS_PROTOCOL;
+	}
+
+	if (!dc_buffer_resize (payload, length)) {
+		ERROR (socket->context, "Failed to allocate memory.");
+		return DC_STATUS_NOMEMORY;
+	}
+
+	status = dc_socket_read (socket, dc_buffer_get_data (payload), length, NULL);
+	if (status != DC_STATUS_SUCCESS) {
+		ERROR (socket->context, "Failed to receive the message payload.");
+		return status == DC_STATUS_TIMEOUT ? DC_STATUS_IO : status;
+	}
+
+	*type = header[0];
+	*flags = header[1];
+
+	return DC_STATUS_SUCCESS;
+}
+
+static dc_status_t
+dc_relay_nodelay (dc_iostream_t *socket)
+{
+	dc_socket_t *device = (dc_socket_t *) socket;
+
+	// The messages are already batched, so don't delay them any further.
+	int optval = 1;
+	if (setsockopt (device->fd, IPPROTO_TCP, TCP_NODELAY, (const char *) &optval, sizeof(optval)) != 0) {
+		s_errcode_t errcode = S_ERRNO;
+		SYSERROR (socket->context, errcode);
+		return dc_socket_syserror (errcode);
+	}
+
+	return DC_STATUS_SUCCESS;
+}
+
+static int
+dc_relay_resolve (dc_context_t *context, const char *hostname, unsigned int port, struct addrinfo **result)
+{
+	struct addrinfo hints;
+	char service[16];
+
+	memset (&hints, 0, sizeof (hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_protocol = IPPROTO_TCP;
+
+	dc_platform_snprintf (service, sizeof (service), "%u", port);
+
+	int rc = getaddrinfo (hostname, service, &hints, result);
+	if (rc != 0) {
+		ERROR (context, "Failed to resolve the address (%s).", gai_strerror (rc));
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * Serving side.
+ */
+
+typedef struct dc_relay_server_t {
+	dc_context_t *context;
+	dc_iostream_t *base;
+	dc_iostream_t *connection;
+	const char *token;
+	unsigned int flags;
+	unsigned int readahead;
+	unsigned int done;
+	dc_buffer_t *payload;
+	dc_buffer_t *output;
+	dc_buffer_t *compressed;
+} dc_relay_server_t;
+
+/*
+ * Compare the token in constant time, to not reveal it through the
+ * response time.
+ */
+static int
+dc_relay_server_authorized (dc_relay_server_t *server, const unsigned char data[], size_t size)
+{
+	size_t length = strlen (server->token);
+
+	unsigned char diff = size != length;
+	for (size_t i = 0; i < size; ++i)
+		diff |= data[i] ^ (unsigned char) server->token[i % length];
+
+	return diff == 0;
+}
+
+/*
+ * Check whether an ioctl request is forwarded to the served I/O
+ * stream. Only the requests that the backends need are allowed.
+ */
+static int
+dc_relay_server_ioctl_allowed (unsigned int request)
+{
+	switch (request) {
+	case DC_IOCTL_SET_LATENCY:
+	case DC_IOCTL_SERIAL_SET_LATENCY:
+	case DC_IOCTL_USB_CONTROL_READ:
+	case DC_IOCTL_USB_CONTROL_WRITE:
+	case DC_IOCTL_BLE_GET_NAME:
+	case DC_IOCTL_BLE_GET_MTU:
+		return 1;
+	default:
+		return 0;
+	}
+}
+
+static dc_status_t
+dc_relay_server_reply (dc_relay_server_t *server, dc_status_t rc, const unsigned char data[], size_t size)
+{
+	unsigned char header[HEADERSIZE + 4];
+	dc_relay_header (header, RELAY_REPLY, 0, 4 + size);
+	array_uint32_le_set (header + HEADERSIZE, (unsigned int) rc);
+
+	if (!dc_buffer_append (server->output, header, sizeof (header)) ||
+		!dc_buffer_append (server->output, data, size)) {
+		ERROR (server->context, "Failed to allocate memory.");
+		return DC_STATUS_NOMEMORY;
+	}
+
+	return dc_relay_send (server->connection, server->output);
+}
+
+static dc_status_t
+dc_relay_server_error (dc_relay_server_t *server, dc_status_t rc)
+{
+	unsigned char data[4];
+	array_uint32_le_set (data, (unsigned int) rc);
+
+	if (!dc_relay_append (server->output, RELAY_ERROR, 0, data, sizeof (data))) {
+		ERROR (server->context, "Failed to allocate memory.");
+		return DC_STATUS_NOMEMORY;
+	}
+
+	return dc_relay_send (server->connection, server->output);
+}
+
+static dc_status_t
+dc_relay_server_data (dc_relay_server_t *server, const unsigned char data[], size_t size)
+{
+	unsigned int flags = 0;
+
+	if ((server->flags & DC_RELAY_COMPRESS) && size >= MINCOMPRESS &&
+		dc_relay_compress (server->compressed, data, size) &&
+		dc_buffer_get_size (server->compressed) < size) {
+		data = dc_buffer_get_data (server->compressed);
+		size = dc_buffer_get_size (server->compressed);
+		flags = FLAG_COMPRESSED;
+	}
+
+	if (!dc_relay_append (server->output, RELAY_DATA, flags, data, size)) {
+		ERROR (server->context, "Failed to allocate memory.");
+		return DC_STATUS_NOMEMORY;
+	}
+
+	return dc_relay_send (server->connection, server->output);
+}
+
+static dc_status_t
+dc_relay_server_handle (dc_relay_server_t *server, unsigned int type, const unsigned char data[], size_t size)
+{
+	dc_status_t rc = DC_STATUS_SUCCESS;
+
+	switch (type) {
+	case RELAY_CONFIGURE:
+		if (size < 20)
+			return DC_STATUS_PROTOCOL;
+		rc = dc_iostream_configure (server->base,
+			array_uint32_le (data),
+			array_uint32_le (data + 4),
+			(dc_parity_t) array_uint32_le (data + 8),
+			(dc_stopbits_t) array_uint32_le (data + 12),
+			(dc_flowcontrol_t) array_uint32_le (data + 16));
+		return dc_relay_server_reply (server, rc, NULL, 0);
+	case RELAY_GET_LINES:
+		{
+			unsigned int value = 0;
+			unsigned char reply[4];
+			rc = dc_iostream_get_lines (server->base, &value);
+			array_uint32_le_set (reply, value);
+			return dc_relay_server_reply (server, rc, reply, sizeof (reply));
+		}
+	case RELAY_IOCTL:
+		{
+			if (size < 4)
+				return DC_STATUS_PROTOCOL;
+			unsigned int request = array_uint32_le (data);
+			if (!dc_relay_server_ioctl_allowed (request)) {
+				WARNING (server->context, "Rejected ioctl request 0x%08x.", request);
+				return dc_relay_server_reply (server, DC_STATUS_UNSUPPORTED, NULL, 0);
+			}
+			unsigned char *buffer = dc_buffer_get_data (server->payload) + 4;
+			rc = dc_iostream_ioctl (server->base, request, size > 4 ? buffer : NULL, size - 4);
+			return dc_relay_server_reply (server, rc, buffer, size - 4);
+		}
+	case RELAY_FLUSH:
+		rc = dc_iostream_flush (server->base);
+		return dc_relay_server_reply (server, rc, NULL, 0);
+	case RELAY_PURGE:
+		if (size < 4)
+			return DC_STATUS_PROTOCOL;
+		rc = dc_iostream_purge (server->base, (dc_direction_t) array_uint32_le (data));
+		if (array_uint32_le (data) & DC_DIRECTION_INPUT)
+			server->readahead = 1;
+		return dc_relay_server_reply (server, rc, NULL, 0);
+	case RELAY_CLOSE:
+		server->done = 1;
+		return dc_relay_server_reply (server, DC_STATUS_SUCCESS, NULL, 0);
+	case RELAY_SET_BREAK:
+	case RELAY_SET_DTR:
+	case RELAY_SET_RTS:
+	case RELAY_SLEEP:
+		if (size < 4)
+			return DC_STATUS_PROTOCOL;
+		if (type == RELAY_SET_BREAK)
+			rc = dc_iostream_set_break (server->base, array_uint32_le (data));
+		else if (type == RELAY_SET_DTR)
+			rc = dc_iostream_set_dtr (server->base, array_uint32_le (data));
+		else if (type == RELAY_SET_RTS)
+			rc = dc_iostream_set_rts (server->base, array_uint32_le (data));
+		else
+			rc = dc_iostream_sleep (server->base, array_uint32_le (data));
+		break;
+	case RELAY_WRITE:
+		rc = dc_iostream_write (server->base, data, size, NULL);
+		break;
+	default:
+		ERROR (server->context, "Unexpected message type (%02x).", type);
+		return DC_STATUS_PROTOCOL;
+	}
+
+	// The queued operations only report their errors.
+	if (rc != DC_STATUS_SUCCESS)
+		return dc_relay_server_error (server, rc);
+
+	return DC_STATUS_SUCCESS;
+}
+
+static dc_status_t
+dc_relay_server_run (dc_relay_server_t *server)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	unsigned int type = 0, flags = 0;
+	unsigned char buffer[CHUNKSIZE];
+
+	// Handshake. No other request is accepted before the remote side
+	// has presented the token.
+	status = dc_relay_receive (server->connection, MSGTIMEOUT, &type, &flags, server->payload);
+	if (status != DC_STATUS_SUCCESS)
+		return status;
+
+	if (type != RELAY_HELLO || dc_buffer_get_size (server->payload) < 8) {
+		ERROR (server->context, "Unexpected handshake.");
+		return DC_STATUS_PROTOCOL;
+	}
+
+	const unsigned char *hello = dc_buffer_get_data (server->payload);
+	unsigned int version = array_uint32_le (hello);
+
+	dc_status_t rc = DC_STATUS_SUCCESS;
+	if (version != RELAY_VERSION) {
+		ERROR (server->context, "Unsupported relay version (%u).", version);
+		rc = DC_STATUS_UNSUPPORTED;
+	} else if (!dc_relay_server_authorized (server, hello + 8, dc_buffer_get_size (server->payload) - 8)) {
+		ERROR (server->context, "Invalid relay token.");
+		rc = DC_STATUS_NOACCESS;
+	}
+
+	unsigned char reply[8];
+	array_uint32_le_set (reply, RELAY_VERSION);
+	array_uint32_le_set (reply + 4, dc_iostream_get_transport (server->base));
+	status = dc_relay_server_reply (server, rc, reply, sizeof (reply));
+	if (status != DC_STATUS_SUCCESS || rc != DC_STATUS_SUCCESS)
+		return status != DC_STATUS_SUCCESS ? status : rc;
+
+	server->flags = array_uint32_le (hello + 4);
+
+	INFO (server->context, "Relay: version=%u, flags=%08x", version, server->flags);
+
+	status = dc_iostream_set_timeout (server->base, READAHEAD);
+	if (status != DC_STATUS_SUCCESS)
+		return status;
+
+	while (!server->done) {
+		// Handle all pending requests first. Without read ahead,
+		// wait for the next request instead.
+		int timeout = server->readahead ? 0 : READAHEAD;
+		for (;;) {
+			status = dc_relay_receive (server->connection, timeout, &type, &flags, server->payload);
+			if (status == DC_STATUS_TIMEOUT)
+				break;
+			if (status != DC_STATUS_SUCCESS)
+				return status;
+
+			status = dc_relay_server_handle (server, type,
+				dc_buffer_get_data (server->payload),
+				dc_buffer_get_size (server->payload));
+			if (status != DC_STATUS_SUCCESS || server->done)
+				return status;
+
+			timeout = 0;
+		}
+
+		if (!server->readahead)
+			continue;
+
+		// Read ahead, and pass the data immediately.
+		size_t nbytes = 0;
+		rc = dc_iostream_read (server->base, buffer, sizeof (buffer), &nbytes);
+		if (nbytes) {
+			status = dc_relay_server_data (server, buffer, nbytes);
+			if (status != DC_STATUS_SUCCESS)
+				return status;
+		}
+
+		// Stop reading after a failure, until the next purge.
+		if (rc != DC_STATUS_SUCCESS && rc != DC_STATUS_TIMEOUT) {
+			server->readahead = 0;
+			status = dc_relay_server_error (server, rc);
+			if (status != DC_STATUS_SUCCESS)
+				return status;
+		}
+	}
+
+	return DC_STATUS_SUCCESS;
+}
+
+dc_status_t
+dc_relay_serve (dc_context_t *context, dc_iostream_t *iostream, const char *address, unsigned int port, const char *token)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	dc_relay_server_t server;
+	struct addrinfo *addresses = NULL;
+
+	if (iostream == NULL || port == 0 || port > 0xFFFF ||
+		token == NULL || token[0] == 0 || strlen (token) > MAXTOKEN)
+		return DC_STATUS_INVALIDARGS;
+
+	// Only accept local connections by default.
+	if (address == NULL)
+		address = "localhost";
+
+	INFO (context, "Serve: address=%s, port=%u", address, port);
+
+	server.context = context;
+	server.base = iostream;
+	server.token = token;
+	server.flags = 0;
+	server.readahead = 1;
+	server.done = 0;
+	server.payload = dc_buffer_new_context (context, CHUNKSIZE);
+	server.output = dc_buffer_new_context (context, CHUNKSIZE);
+	server.compressed = dc_buffer_new_context (context, CHUNKSIZE);
+	if (server.payload == NULL || server.output == NULL || server.compressed == NULL) {
+		ERROR (context, "Failed to allocate memory.");
+		status = DC_STATUS_NOMEMORY;
+		goto error_free;
+	}
+
+	server.connection = dc_iostream_allocate (context, &dc_relay_connection_vtable, DC_TRANSPORT_NONE);
+	if (server.connection == NULL) {
+		status = DC_STATUS_NOMEMORY;
+		goto error_free;
+	}
+
+	status = dc_socket_init (context);
+	if (status != DC_STATUS_SUCCESS) {
+		goto error_deallocate;
+	}
+
+	if (dc_relay_resolve (context, address, port, &addresses) != 0) {
+		status = DC_STATUS_IO;
+		goto error_exit;
+	}
+
+	status = dc_socket_open (server.connection, addresses->ai_family, addresses->ai_socktype, addresses->ai_protocol);
+	if (status != DC_STATUS_SUCCESS) {
+		goto error_addresses;
+	}
+
+	status = dc_socket_listen (server.connection, addresses->ai_addr, addresses->ai_addrlen);
+	if (status != DC_STATUS_SUCCESS) {
+		ERROR (context, "Failed to accept a connection.");
+		goto error_close;
+	}
+
+	status = dc_relay_nodelay (server.connection);
+	if (status != DC_STATUS_SUCCESS) {
+		goto error_close;
+	}
+
+	status = dc_relay_server_run (&server);
+
+error_close:
+	dc_socket_close (server.connection);
+error_addresses:
+	freeaddrinfo (addresses);
+error_exit:
+	dc_socket_exit (context);
+error_deallocate:
+	dc_iostream_deallocate (server.connection);
+error_free:
+	dc_buffer_free (server.compressed);
+	dc_buffer_free (server.output);
+	dc_buffer_free (server.payload);
+	return status;
+}
+
+/*
+ * Remote side.
+ */
+
+static dc_status_t
+dc_relay_check (dc_relay_t *device)
+{
+	dc_status_t status = device->error;
+	device->error = DC_STATUS_SUCCESS;
+	return status;
+}
+
+static dc_status_t
+dc_relay_queue (dc_relay_t *device, unsigned int type, const unsigned char data[], size_t size)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+
+	if (type == RELAY_WRITE && device->lastwrite != (size_t) -1) {
+		// Extend the previous write message.
+		unsigned char *header = dc_buffer_get_data (device->output) + device->lastwrite;
+		array_uint32_le_set (header + 4, array_uint32_le (header + 4) + size);
+		if (!dc_buffer_append (device->output, data, size)) {
+			ERROR (device->base.base.context, "Failed to allocate memory.");
+			return DC_STATUS_NOMEMORY;
+		}
+	} else {
+		size_t offset = dc_buffer_get_size (device->output);
+		if (!dc_relay_append (device->output, type, 0, data, size)) {
+			ERROR (device->base.base.context, "Failed to allocate memory.");
+			return DC_STATUS_NOMEMORY;
+		}
+		device->lastwrite = type == RELAY_WRITE ? offset : (size_t) -1;
+	}
+
+	if (dc_buffer_get_size (device->output) >= QUEUESIZE ||
+		(type == RELAY_WRITE && dc_buffer_get_size (device->output) - device->lastwrite >= MAXSIZE)) {
+		device->lastwrite = (size_t) -1;
+		status = dc_relay_send ((dc_iostream_t *) device, device->output);
+	}
+
+	return status;
+}
+
+static dc_status_t
+dc_relay_flush_queue (dc_relay_t *device)
+{
+	device->lastwrite = (size_t) -1;
+
+	if (dc_buffer_get_size (device->output) == 0)
+		return DC_STATUS_SUCCESS;
+
+	return dc_relay_send ((dc_iostream_t *) device, device->output);
+}
+
+/*
+ * Receive and process one message. A reply is returned to the caller,
+ * all other messages are processed here.
+ */
+static dc_status_t
+dc_relay_pump (dc_relay_t *device, int timeout, unsigned int *reply)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	dc_iostream_t *abstract = (dc_iostream_t *) device;
+	unsigned int type = 0, flags = 0;
+
+	status = dc_relay_receive (abstract, timeout, &type, &flags, device->message);
+	if (status != DC_STATUS_SUCCESS)
+		return status;
+
+	const unsigned char *data = dc_buffer_get_data (device->message);
+	size_t size = dc_buffer_get_size (device->message);
+
+	switch (type) {
+	case RELAY_DATA:
+		{
+			// Check the size first, to never grow the buffer beyond the
+			// limit. For compressed data, the original size is declared
+			// at the start.
+			size_t previous = dc_buffer_get_size (device->input);
+			size_t length = size;
+			if (flags & FLAG_COMPRESSED)
+				length = size >= 4 ? array_uint32_le (data) : 0;
+			if (length == 0) {
+				ERROR (abstract->context, "Unexpected empty data.");
+				return DC_STATUS_PROTOCOL;
+			}
+			if (length > MAXINPUT - previous) {
+				ERROR (abstract->context, "Receive buffer overflow (%u bytes dropped).", (unsigned int) length);
+				return DC_STATUS_IO;
+			}
+
+			if (flags & FLAG_COMPRESSED) {
+				status = dc_relay_decompress (device->input, data, size);
+				if (status != DC_STATUS_SUCCESS) {
+					ERROR (abstract->context, "Invalid compressed data.");
+					return status;
+				}
+			} else if (!dc_buffer_append (device->input, data, size)) {
+				ERROR (abstract->context, "Failed to allocate memory.");
+				return DC_STATUS_NOMEMORY;
+			}
+
+			if (device->packets) {
+				unsigned char length[4];
+				array_uint32_le_set (length, dc_buffer_get_size (device->input) - previous);
+				if (!dc_buffer_append (device->sizes, length, sizeof (length))) {
+					ERROR (abstract->context, "Failed to allocate memory.");
+					return DC_STATUS_NOMEMORY;
+				}
+			}
+		}
+		break;
+	case RELAY_ERROR:
+		if (size < 4)
+			return DC_STATUS_PROTOCOL;
+		if (device->error == DC_STATUS_SUCCESS)
+			device->error = (dc_status_t) (int) array_uint32_le (data);
+		break;
+	case RELAY_REPLY:
+		if (reply == NULL || size < 4) {
+			ERROR (abstract->context, "Unexpected reply.");
+			return DC_STATUS_PROTOCOL;
+		}
+		*reply = 1;
+		break;
+	default:
+		ERROR (abstract->context, "Unexpected message type (%02x).", type);
+		return DC_STATUS_PROTOCOL;
+	}
+
+	return DC_STATUS_SUCCESS;
+}
+
+/*
+ * Send a request, together with the queued messages, and wait for the
+ * reply. The reply payload, without the status, is left in the message
+ * buffer.
+ */
+static dc_status_t
+dc_relay_call (dc_relay_t *device, unsigned int type, const unsigned char data[], size_t size)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+
+	if (!dc_relay_append (device->output, type, 0, data, size)) {
+		ERROR (device->base.base.context, "Failed to allocate memory.");
+		return DC_STATUS_NOMEMORY;
+	}
+
+	status = dc_relay_flush_queue (device);
+	if (status != DC_STATUS_SUCCESS)
+		return status;
+
+	unsigned int reply = 0;
+	while (!reply) {
+		status = dc_relay_pump (device, -1, &reply);
+		if (status != DC_STATUS_SUCCESS)
+			return status;
+	}
+
+	status = (dc_status_t) (int) array_uint32_le (dc_buffer_get_data (device->message));
+	dc_buffer_slice (device->message, 4, dc_buffer_get_size (device->message) - 4);
+
+	return status;
+}
+
+/*
+ * Check whether the requested data is available. For the packet based
+ * transports, a single packet is sufficient.
+ */
+static int
+dc_relay_ready (dc_relay_t *device, size_t size)
+{
+	if (device->packets)
+		return dc_buffer_get_size (device->sizes) != 0;
+	else
+		return dc_buffer_get_size (device->input) >= size;
+}
+
+dc_status_t
+dc_relay_open (dc_iostream_t **out, dc_context_t *context, const char *hostname, unsigned int port, const char *token, unsigned int flags)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	dc_relay_t *device = NULL;
+	struct addrinfo *addresses = NULL;
+
+	if (out == NULL || hostname == NULL || port == 0 || port > 0xFFFF ||
+		token == NULL || token[0] == 0 || strlen (token) > MAXTOKEN)
+		return DC_STATUS_INVALIDARGS;
+
+	INFO (context, "Open: hostname=%s, port=%u, flags=%08x", hostname, port, flags);
+
+	// Allocate memory.
+	device = (dc_relay_t *) dc_iostream_allocate (context, &dc_relay_vtable, DC_TRANSPORT_NONE);
+	if (device == NULL) {
+		SYSERROR (context, S_ENOMEM);
+		return DC_STATUS_NOMEMORY;
+	}
+
+	device->timeout = -1;
+	device->flags = flags;
+	device->packets = 0;
+	device->error = DC_STATUS_SUCCESS;
+	device->lastwrite = (size_t) -1;
+	device->input = dc_buffer_new_context (context, CHUNKSIZE);
+	device->sizes = dc_buffer_new_context (context, 0);
+	device->output = dc_buffer_new_context (context, CHUNKSIZE);
+	device->message = dc_buffer_new_context (context, CHUNKSIZE);
+	if (device->input == NULL || device->sizes == NULL ||
+		device->output == NULL || device->message == NULL) {
+		ERROR (context, "Failed to allocate memory.");
+		status = DC_STATUS_NOMEMORY;
+		goto error_free;
+	}
+
+	status = dc_socket_init (context);
+	if (status != DC_STATUS_SUCCESS) {
+		goto error_free;
+	}
+
+	if (dc_relay_resolve (context, hostname, port, &addresses) != 0) {
+		status = DC_STATUS_NODEVICE;
+		goto error_exit;
+	}
+
+	// Connect to the first address that accepts the connection.
+	status = DC_STATUS_NODEVICE;
+	for (struct addrinfo *address = addresses; address; address = address->ai_next) {
+		status = dc_socket_open (&device->base.base, address->ai_family, address->ai_socktype, address->ai_protocol);
+		if (status != DC_STATUS_SUCCESS)
+			continue;
+
+		status = dc_socket_connect (&device->base.base, address->ai_addr, address->ai_addrlen);
+		if (status == DC_STATUS_SUCCESS)
+			break;
+
+		dc_socket_close (&device->base.base);
+	}
+
+	freeaddrinfo (addresses);
+
+	if (status != DC_STATUS_SUCCESS) {
+		ERROR (context, "Failed to connect to the relay.");
+		goto error_exit;
+	}
+
+	status = dc_relay_nodelay (&device->base.base);
+	if (status != DC_STATUS_SUCCESS) {
+		goto error_close;
+	}
+
+	// Handshake.
+	size_t length = strlen (token);
+	unsigned char hello[8 + MAXTOKEN];
+	array_uint32_le_set (hello, RELAY_VERSION);
+	array_uint32_le_set (hello + 4, flags);
+	memcpy (hello + 8, token, length);
+	status = dc_relay_call (device, RELAY_HELLO, hello, 8 + length);
+	if (status != DC_STATUS_SUCCESS) {
+		ERROR (context, "Failed to start the relay.");
+		goto error_close;
+	}
+
+	if (dc_buffer_get_size (device->message) < 8) {
+		ERROR (context, "Unexpected handshake.");
+		status = DC_STATUS_PROTOCOL;
+		goto error_close;
+	}
+
+	// Take over the transport of the served I/O stream.
+	dc_transport_t transport = (dc_transport_t) array_uint32_le (dc_buffer_get_data (device->message) + 4);
+	device->base.base.transport = transport;
+	device->packets =
+		transport == DC_TRANSPORT_USB ||
+		transport == DC_TRANSPORT_USBHID ||
+		transport == DC_TRANSPORT_BLE;
+
+	*out = (dc_iostream_t *) device;
+
+	return DC_STATUS_SUCCESS;
+
+error_close:
+	dc_socket_close (&device->base.base);
+error_exit:
+	dc_socket_exit (context);
+error_free:
+	dc_buffer_free (device->message);
+	dc_buffer_free (device->output);
+	dc_buffer_free (device->sizes);
+	dc_buffer_free (device->input);
+	dc_iostream_deallocate ((dc_iostream_t *) device);
+	return status;
+}
+
+static dc_status_t
+dc_relay_close (dc_iostream_t *abstract)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	dc_relay_t *device = (dc_relay_t *) abstract;
+	dc_status_t rc = DC_STATUS_SUCCESS;
+
+	// Execute the queued operations, and stop the serving side.
+	rc = dc_relay_call (device, RELAY_CLOSE, NULL, 0);
+	if (rc != DC_STATUS_SUCCESS) {
+		dc_status_set_error(&status, rc);
+	}
+
+	rc = dc_socket_close (abstract);
+	if (rc != DC_STATUS_SUCCESS) {
+		dc_status_set_error(&status, rc);
+	}
+
+	dc_socket_exit (abstract->context);
+
+	dc_buffer_free (device->message);
+	dc_buffer_free (device->output);
+	dc_buffer_free (device->sizes);
+	dc_buffer_free (device->input);
+
+	return status;
+}
+
+static dc_status_t
+dc_relay_set_timeout (dc_iostream_t *abstract, int timeout)
+{
+	dc_relay_t *device = (dc_relay_t *) abstract;
+
+	device->timeout = timeout;
+
+	return DC_STATUS_SUCCESS;
+}
+
+static dc_status_t
+dc_relay_set_value (dc_relay_t *device, unsigned int type, unsigned int value)
+{
+	dc_status_t status = dc_relay_check (device);
+	if (status != DC_STATUS_SUCCESS)
+		return status;
+
+	unsigned char data[4];
+	array_uint32_le_set (data, value);
+
+	return dc_relay_queue (device, type, data, sizeof (data));
+}
+
+static dc_status_t
+dc_relay_set_break (dc_iostream_t *abstract, unsigned int value)
+{
+	return dc_relay_set_value ((dc_relay_t *) abstract, RELAY_SET_BREAK, value);
+}
+
+static dc_status_t
+dc_relay_set_dtr (dc_iostream_t *abstract, unsigned int value)
+{
+	return dc_relay_set_value ((dc_relay_t *) abstract, RELAY_SET_DTR, value);
+}
+
+static dc_status_t
+dc_relay_set_rts (dc_iostream_t *abstract, unsigned int value)
+{
+	return dc_relay_set_value ((dc_relay_t *) abstract, RELAY_SET_RTS, value);
+}
+
+static dc_status_t
+dc_relay_get_lines (dc_iostream_t *abstract, unsigned int *value)
+{
+	dc_relay_t *device = (dc_relay_t *) abstract;
+
+	dc_status_t status = dc_relay_check (device);
+	if (status != DC_STATUS_SUCCESS)
+		return status;
+
+	status = dc_relay_call (device, RELAY_GET_LINES, NULL, 0);
+	if (status != DC_STATUS_SUCCESS)
+		return status;
+
+	if (dc_buffer_get_size (device->message) < 4)
+		return DC_STATUS_PROTOCOL;
+
+	if (value)
+		*value = array_uint32_le (dc_buffer_get_data (device->message));
+
+	return DC_STATUS_SUCCESS;
+}
+
+static dc_status_t
+dc_relay_get_available (dc_iostream_t *abstract, size_t *value)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	dc_relay_t *device = (dc_relay_t *) abstract;
+
+	// Process the data that already arrived.
+	while ((status = dc_relay_pump (device, 0, NULL)) == DC_STATUS_SUCCESS)
+		;
+	if (status != DC_STATUS_TIMEOUT)
+		return status;
+
+	if (value)
+		*value = dc_buffer_get_size (device->input);
+
+	return DC_STATUS_SUCCESS;
+}
+
+static dc_status_t
+dc_relay_configure (dc_iostream_t *abstract, unsigned int baudrate, unsigned int databits, dc_parity_t parity, dc_stopbits_t stopbits, dc_flowcontrol_t flowcontrol)
+{
+	dc_relay_t *device = (dc_relay_t *) abstract;
+
+	dc_status_t status = dc_relay_check (device);
+	if (status != DC_STATUS_SUCCESS)
+		return status;
+
+	unsigned char data[20];
+	array_uint32_le_set (data, baudrate);
+	array_uint32_le_set (data + 4, databits);
+	array_uint32_le_set (data + 8, parity);
+	array_uint32_le_set (data + 12, stopbits);
+	array_uint32_le_set (data + 16, flowcontrol);
+
+	return dc_relay_call (device, RELAY_CONFIGURE, data, sizeof (data));
+}
+
+/*
+ * Wait until the requested data is available, or the timeout expires.
+ */
+static dc_status_t
+dc_relay_wait (dc_relay_t *device, size_t size, int timeout)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	dc_nsecs_t start = dc_clock_monotonic ();
+
+	status = dc_relay_flush_queue (device);
+	if (status != DC_STATUS_SUCCESS)
+		return status;
+
+	while (!dc_relay_ready (device, size)) {
+		if (device->error != DC_STATUS_SUCCESS)
+			return dc_relay_check (device);
+
+		int remaining = timeout;
+		if (timeout > 0) {
+			dc_nsecs_t elapsed = (dc_clock_monotonic () - start) / 1000000;
+			remaining = elapsed >= (dc_nsecs_t) timeout ? 0 : timeout - (int) elapsed;
+		}
+
+		status = dc_relay_pump (device, remaining, NULL);
+		if (status != DC_STATUS_SUCCESS)
+			return status;
+	}
+
+	return DC_STATUS_SUCCESS;
+}
+
+static dc_status_t
+dc_relay_poll (dc_iostream_t *abstract, int timeout)
+{
+	dc_relay_t *device = (dc_relay_t *) abstract;
+
+	return dc_relay_wait (device, 1, timeout);
+}
+
+static dc_status_t
+dc_relay_read (dc_iostream_t *abstract, void *data, size_t size, size_t *actual)
+{
+	dc_relay_t *device = (dc_relay_t *) abstract;
+	size_t nbytes = 0;
+
+	dc_status_t status = dc_relay_wait (device, size, device->timeout);
+	if (status != DC_STATUS_SUCCESS && status != DC_STATUS_TIMEOUT)
+		goto out;
+
+	size_t available = dc_buffer_get_size (device->input);
+	size_t length = available;
+	if (device->packets) {
+		// Return a single packet, like the transport itself. The
+		// remainder of a packet that doesn't fit is discarded.
+		length = 0;
+		if (dc_buffer_get_size (device->sizes)) {
+			length = array_uint32_le (dc_buffer_get_data (device->sizes));
+			dc_buffer_slice (device->sizes, 4, dc_buffer_get_size (device->sizes) - 4);
+		}
+	}
+
+	nbytes = length < size ? length : size;
+	memcpy (data, dc_buffer_get_data (device->input), nbytes);
+
+	size_t consumed = device->packets ? length : nbytes;
+	dc_buffer_slice (device->input, consumed, available - consumed);
+
+	if (device->packets)
+		status = length ? DC_STATUS_SUCCESS : DC_STATUS_TIMEOUT;
+	else
+		status = nbytes == size ? DC_STATUS_SUCCESS : DC_STATUS_TIMEOUT;
+
+out:
+	if (actual)
+		*actual = nbytes;
+
+	return status;
+}
+
+static dc_status_t
+dc_relay_write (dc_iostream_t *abstract, const void *data, size_t size, size_t *actual)
+{
+	dc_relay_t *device = (dc_relay_t *) abstract;
+
+	dc_status_t status = dc_relay_check (device);
+	if (status == DC_STATUS_SUCCESS)
+		status = dc_relay_queue (device, RELAY_WRITE, (const unsigned char *) data, size);
+
+	if (actual)
+		*actual = status == DC_STATUS_SUCCESS ? size : 0;
+
+	return status;
+}
+
+static dc_status_t
+dc_relay_ioctl (dc_iostream_t *abstract, unsigned int request, void *data, size_t size)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	dc_relay_t *device = (dc_relay_t *) abstract;
+
+	status = dc_relay_check (device);
+	if (status != DC_STATUS_SUCCESS)
+		return status;
+
+	if (size > MAXSIZE - 4)
+		return DC_STATUS_INVALIDARGS;
+
+	unsigned char header[4];
+	array_uint32_le_set (header, request);
+
+	dc_buffer_t *buffer = dc_buffer_new_context (abstract->context, 4 + size);
+	if (buffer == NULL ||
+		!dc_buffer_append (buffer, header, sizeof (header)) ||
+		!dc_buffer_append (buffer, (const unsigned char *) data, size)) {
+		ERROR (abstract->context, "Failed to allocate memory.");
+		dc_buffer_free (buffer);
+		return DC_STATUS_NOMEMORY;
+	}
+
+	status = dc_relay_call (device, RELAY_IOCTL, dc_buffer_get_data (buffer), dc_buffer_get_size (buffer));
+	dc_buffer_free (buffer);
+	if (status != DC_STATUS_SUCCESS)
+		return status;
+
+	if (dc_buffer_get_size (device->message) != size)
+		return DC_STATUS_PROTOCOL;
+
+	if (size)
+		memcpy (data, dc_buffer_get_data (device->message), size);
+
+	return DC_STATUS_SUCCESS;
+}
+
+static dc_status_t
+dc_relay_flush (dc_iostream_t *abstract)
+{
+	dc_relay_t *device = (dc_relay_t *) abstract;
+
+	dc_status_t status = dc_relay_check (device);
+	if (status != DC_STATUS_SUCCESS)
+		return status;
+
+	return dc_relay_call (device, RELAY_FLUSH, NULL, 0);
+}
+
+static dc_status_t
+dc_relay_purge (dc_iostream_t *abstract, dc_direction_t direction)
+{
+	dc_relay_t *device = (dc_relay_t *) abstract;
+
+	unsigned char data[4];
+	array_uint32_le_set (data, direction);
+
+	dc_status_t status = dc_relay_call (device, RELAY_PURGE, data, sizeof (data));
+
+	// All data received before the reply was read ahead before the
+	// purge, and is discarded, together with the read errors.
+	if (direction & DC_DIRECTION_INPUT) {
+		dc_buffer_clear (device->input);
+		dc_buffer_clear (device->sizes);
+		device->error = DC_STATUS_SUCCESS;
+	}
+
+	return status;
+}
+
+static dc_status_t
+dc_relay_sleep (dc_iostream_t *abstract, unsigned int timeout)
+{
+	dc_relay_t *device = (dc_relay_t *) abstract;
+
+	dc_status_t status = dc_relay_set_value (device, RELAY_SLEEP, timeout);
+	if (status != DC_STATUS_SUCCESS)
+		return status;
+
+	// Start the sleep on the serving side immediately, and sleep
+	// locally as well, such that a subsequent read timeout doesn't
+	// start too early.
+	status = dc_relay_flush_queue (device);
+	if (status != DC_STATUS_SUCCESS)
+		return status;
+
+	return dc_socket_sleep (abstract, timeout);
+}
@@ -0,0 +1,1471 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2026 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>  // FILE, fopen
+#include <stdlib.h> // malloc, free
+#include <string.h> // memcmp, memcpy
+
+#include <libdivecomputer/replay.h>
+#include <libdivecomputer/buffer.h>
+#include <libdivecomputer/ioctl.h>
+
+#include "iostream-private.h"
+#include "common-private.h"
+#include "context-private.h"
+#include "platform.h"
+#include "timer.h"
+#include "array.h"
+
+/*
+ * The recording file starts with a header, containing a magic value, a
+ * version number and the transport type. Each operation is stored as a
+ * fixed size record header, followed by the transferred data. All
+ * values are stored in little endian byte order.
+ */
+#define MAGIC          0x50524344 /* DCRP */
+#define FORMAT_VERSION 1
+
+#define SZ_HEADER 16
+#define SZ_RECORD 32
+
+/*
+ * The trace file uses a more compact encoding. Each record starts with
+ * the operation type and the negated status, followed by the time since
+ * the previous record, the elapsed time (both in microseconds), the
+ * parameter, the value and the data size, all encoded as variable
+ * length integers (LEB128).
+ */
+#define TRACE_MAGIC    0x52544344 /* DCTR */
+#define TRACE_VERSION  1
+#define TRACE_CAPACITY (1024 * 1024)
+#define SZ_TRACE_MAX   (2 + 10 * 5)
+
+#define OP_SET_TIMEOUT   1
+#define OP_SET_BREAK     2
+#define OP_SET_DTR       3
+#define OP_SET_RTS       4
+#define OP_GET_LINES     5
+#define OP_GET_AVAILABLE 6
+#define OP_CONFIGURE     7
+#define OP_POLL          8
+#define OP_READ          9
+#define OP_WRITE         10
+#define OP_IOCTL         11
+#define OP_FLUSH         12
+#define OP_PURGE         13
+#define OP_SLEEP         14
+
+typedef struct dc_replay_record_t {
+	unsigned int type;
+	dc_status_t status;
+	dc_usecs_t timestamp;
+	unsigned int elapsed;
+	unsigned int param;
+	unsigned int value;
+	const unsigned char *data;
+	size_t size;
+} dc_replay_record_t;
+
+static dc_status_t dc_record_set_timeout (dc_iostream_t *abstract, int timeout);
+static dc_status_t dc_record_set_break (dc_iostream_t *abstract, unsigned int value);
+static dc_status_t dc_record_set_dtr (dc_iostream_t *abstract, unsigned int value);
+static dc_status_t dc_record_set_rts (dc_iostream_t *abstract, unsigned int value);
+static dc_status_t dc_record_get_lines (dc_iostream_t *abstract, unsigned int *value);
+static dc_status_t dc_record_get_available (dc_iostream_t *abstract, size_t *value);
+static dc_status_t dc_record_configure (dc_iostream_t *abstract, unsigned int baudrate, unsigned int databits, dc_parity_t parity, dc_stopbits_t stopbits, dc_flowcontrol_t flowcontrol);
+static dc_status_t dc_record_poll (dc_iostream_t *abstract, int timeout);
+static dc_status_t dc_record_read (dc_iostream_t *abstract, void *data, size_t size, size_t *actual);
+static dc_status_t dc_record_write (dc_iostream_t *abstract, const void *data, size_t size, size_t *actual);
+static dc_status_t dc_record_ioctl (dc_iostream_t *abstract, unsigned int request, void *data, size_t size);
+static dc_status_t dc_record_flush (dc_iostream_t *abstract);
+static dc_status_t dc_record_purge (dc_iostream_t *abstract, dc_direction_t direction);
+static dc_status_t dc_record_sleep (dc_iostream_t *abstract, unsigned int milliseconds);
+static dc_status_t dc_record_set_interrupt (dc_iostream_t *abstract, dc_interrupt_t *interrupt);
+static dc_status_t dc_record_close (dc_iostream_t *abstract);
+
+static dc_status_t dc_trace_set_timeout (dc_iostream_t *abstract, int timeout);
+static dc_status_t dc_trace_set_break (dc_iostream_t *abstract, unsigned int value);
+static dc_status_t dc_trace_set_dtr (dc_iostream_t *abstract, unsigned int value);
+static dc_status_t dc_trace_set_rts (dc_iostream_t *abstract, unsigned int value);
+static dc_status_t dc_trace_get_lines (dc_iostream_t *abstract, unsigned int *value);
+static dc_status_t dc_trace_get_available (dc_iostream_t *abstract, size_t *value);
+static dc_status_t dc_trace_configure (dc_iostream_t *abstract, unsigned int baudrate, unsigned int databits, dc_parity_t parity, dc_stopbits_t stopbits, dc_flowcontrol_t flowcontrol);
+static dc_status_t dc_trace_poll (dc_iostream_t *abstract, int timeout);
+static dc_status_t dc_trace_read (dc_iostream_t *abstract, void *data, size_t size, size_t *actual);
+static dc_status_t dc_trace_write (dc_iostream_t *abstract, const void *data, size_t size, size_t *actual);
+static dc_status_t dc_trace_ioctl (dc_iostream_t *abstract, unsigned int request, void *data, size_t size);
+static dc_status_t dc_trace_flush (dc_iostream_t *abstract);
+static dc_status_t dc_trace_purge (dc_iostream_t *abstract, dc_direction_t direction);
+static dc_status_t dc_trace_sleep (dc_iostream_t *abstract, unsigned int milliseconds);
+static dc_status_t dc_trace_set_interrupt (dc_iostream_t *abstract, dc_interrupt_t *interrupt);
+static dc_status_t dc_trace_close (dc_iostream_t *abstract);
+
+static dc_status_t dc_replay_set_timeout (dc_iostream_t *abstract, int timeout);
+static dc_status_t dc_replay_set_break (dc_iostream_t *abstract, unsigned int value);
+static dc_status_t dc_replay_set_dtr (dc_iostream_t *abstract, unsigned int value);
+static dc_status_t dc_replay_set_rts (dc_iostream_t *abstract, unsigned int value);
+static dc_status_t dc_replay_get_lines (dc_iostream_t *abstract, unsigned int *value);
+static dc_status_t dc_replay_get_available (dc_iostream_t *abstract, size_t *value);
+static dc_status_t dc_replay_configure (dc_iostream_t *abstract, unsigned int baudrate, unsigned int databits, dc_parity_t parity, dc_stopbits_t stopbits, dc_flowcontrol_t flowcontrol);
+static dc_status_t dc_replay_poll (dc_iostream_t *abstract, int timeout);
+static dc_status_t dc_replay_read (dc_iostream_t *abstract, void *data, size_t size, size_t *actual);
+static dc_status_t dc_replay_write (dc_iostream_t *abstract, const void *data, size_t size, size_t *actual);
+static dc_status_t dc_replay_ioctl (dc_iostream_t *abstract, unsigned int request, void *data, size_t size);
+static dc_status_t dc_replay_flush (dc_iostream_t *abstract);
+static dc_status_t dc_replay_purge (dc_iostream_t *abstract, dc_direction_t direction);
+static dc_status_t dc_replay_sleep (dc_iostream_t *abstract, unsigned int milliseconds);
+static dc_status_t dc_replay_close (dc_iostream_t *abstract);
+
+typedef struct dc_record_t {
+	/* Base class. */
+	dc_iostream_t base;
+	/* Internal state. */
+	dc_context_t *context;
+	dc_iostream_t *iostream;
+	dc_timer_t *timer;
+	FILE *fp;
+} dc_record_t;
+
+typedef struct dc_trace_t {
+	/* Base class. */
+	dc_iostream_t base;
+	/* Internal state. */
+	dc_context_t *context;
+	dc_iostream_t *iostream;
+	dc_transport_t transport;
+	FILE *fp;
+	/* Ring buffer with the encoded records. */
+	unsigned char *ring;
+	size_t capacity;
+	size_t head;
+	size_t tail;
+	size_t used;
+	/* Number of discarded records. */
+	unsigned int dropped;
+	/* Timestamps (in microseconds). */
+	dc_nsecs_t start;
+	dc_usecs_t previous;
+} dc_trace_t;
+
+typedef struct dc_replay_t {
+	/* Base class. */
+	dc_iostream_t base;
+	/* Internal state. */
+	dc_context_t *context;
+	dc_replay_mode_t mode;
+	dc_buffer_t *buffer;
+	const unsigned char *data;
+	size_t size;
+	size_t offset;
+	/* Partially consumed read record. */
+	dc_replay_record_t rrecord;
+	size_t roffset;
+	/* Accumulated latency (in microseconds). */
+	dc_usecs_t latency;
+} dc_replay_t;
+
+static const dc_iostream_vtable_t dc_record_vtable = {
+	sizeof(dc_record_t),
+	dc_record_set_timeout, /* set_timeout */
+	dc_record_set_break, /* set_break */
+	dc_record_set_dtr, /* set_dtr */
+	dc_record_set_rts, /* set_rts */
+	dc_record_get_lines, /* get_lines */
+	dc_record_get_available, /* get_available */
+	dc_record_configure, /* configure */
+	dc_record_poll, /* poll */
+	dc_record_read, /* read */
+	dc_record_write, /* write */
+	NULL, /* read_async */
+	NULL, /* write_async */
+	NULL, /* writev */
+	dc_record_ioctl, /* ioctl */
+	dc_record_flush, /* flush */
+	dc_record_purge, /* purge */
+	dc_record_sleep, /* sleep */
+	dc_record_set_interrupt, /* set_interrupt */
+	dc_record_close, /* close */
+};
+
+static const dc_iostream_vtable_t dc_trace_vtable = {
+	sizeof(dc_trace_t),
+	dc_trace_set_timeout, /* set_timeout */
+	dc_trace_set_break, /* set_break */
+	dc_trace_set_dtr, /* set_dtr */
+	dc_trace_set_rts, /* set_rts */
+	dc_trace_get_lines, /* get_lines */
+	dc_trace_get_available, /* get_available */
+	dc_trace_configure, /* configure */
+	dc_trace_poll, /* poll */
+	dc_trace_read, /* read */
+	dc_trace_write, /* write */
+	NULL, /* read_async */
+	NULL, /* write_async */
+	NULL, /* writev */
+	dc_trace_ioctl, /* ioctl */
+	dc_trace_flush, /* flush */
+	dc_trace_purge, /* purge */
+	dc_trace_sleep, /* sleep */
+	dc_trace_set_interrupt, /* set_interrupt */
+	dc_trace_close, /* close */
+};
+
+static const dc_iostream_vtable_t dc_replay_vtable = {
+	sizeof(dc_replay_t),
+	dc_replay_set_timeout, /* set_timeout */
+	dc_replay_set_break, /* set_break */
+	dc_replay_set_dtr, /* set_dtr */
+	dc_replay_set_rts, /* set_rts */
+	dc_replay_get_lines, /* get_lines */
+	dc_replay_get_available, /* get_available */
+	dc_replay_configure, /* configure */
+	dc_replay_poll, /* poll */
+	dc_replay_read, /* read */
+	dc_replay_write, /* write */
+	NULL, /* read_async */
+	NULL, /* write_async */
+	NULL, /* writev */
+	dc_replay_ioctl, /* ioctl */
+	dc_replay_flush, /* flush */
+	dc_replay_purge, /* purge */
+	dc_replay_sleep, /* sleep */
+	NULL, /* set_interrupt */
+	dc_replay_close, /* close */
+};
+
+static int
+dc_record_emit (FILE *fp, const dc_replay_record_t *record)
+{
+	unsigned char header[SZ_RECORD] = {0};
+	header[0] = record->type;
+	array_uint32_le_set (header + 4, (unsigned int) record->status);
+	array_uint64_le_set (header + 8, record->timestamp);
+	array_uint32_le_set (header + 16, record->elapsed);
+	array_uint32_le_set (header + 20, record->param);
+	array_uint32_le_set (header + 24, record->value);
+	array_uint32_le_set (header + 28, record->size);
+
+	if (fwrite (header, sizeof (header), 1, fp) != 1 ||
+		(record->size && fwrite (record->data, record->size, 1, fp) != 1)) {
+		return -1;
+	}
+
+	return 0;
+}
+
+static int
+dc_record_header (FILE *fp, dc_transport_t transport)
+{
+	unsigned char header[SZ_HEADER] = {0};
+	array_uint32_le_set (header + 0, MAGIC);
+	array_uint32_le_set (header + 4, FORMAT_VERSION);
+	array_uint32_le_set (header + 8, transport);
+	if (fwrite (header, sizeof (header), 1, fp) != 1)
+		return -1;
+
+	return 0;
+}
+
+dc_status_t
+dc_record_open (dc_iostream_t **out, dc_context_t *context, dc_iostream_t *base, const char *filename)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	dc_record_t *record = NULL;
+
+	if (out == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	if (base == NULL || filename == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	dc_transport_t transport = dc_iostream_get_transport (base);
+
+	// Allocate memory.
+	record = (dc_record_t *) dc_iostream_allocate (context, &dc_record_vtable, transport);
+	if (record == NULL) {
+		ERROR (context, "Failed to allocate memory.");
+		status = DC_STATUS_NOMEMORY;
+		goto error_exit;
+	}
+
+	record->context = context;
+	record->iostream = base;
+	record->timer = NULL;
+	record->fp = NULL;
+
+	status = dc_timer_new (&record->timer);
+	if (status != DC_STATUS_SUCCESS) {
+		ERROR (context, "Failed to create a high resolution timer.");
+		goto error_free;
+	}
+
+	// Open the file.
+	record->fp = fopen (filename, "wb");
+	if (record->fp == NULL) {
+		ERROR (context, "Failed to open the file.");
+		status = DC_STATUS_IO;
+		goto error_timer_free;
+	}
+
+	// Write the file header.
+	if (dc_record_header (record->fp, transport) != 0) {
+		ERROR (context, "Failed to write the file.");
+		status = DC_STATUS_IO;
+		goto error_close;
+	}
+
+	*out = (dc_iostream_t *) record;
+
+	return DC_STATUS_SUCCESS;
+
+error_close:
+	fclose (record->fp);
+error_timer_free:
+	dc_timer_free (record->timer);
+error_free:
+	dc_iostream_deallocate ((dc_iostream_t *) record);
+error_exit:
+	return status;
+}
+
+static dc_usecs_t
+dc_record_now (dc_record_t *record)
+{
+	dc_usecs_t now = 0;
+	dc_timer_now (record->timer, &now);
+	return now;
+}
+
+/*
+ * Append a record to the file. If the record can't be written, the
+ * operation fails, even if the base I/O stream succeeded, because the
+ * recording would be incomplete.
+ */
+static dc_status_t
+dc_record_log (dc_record_t *record, unsigned int type, dc_status_t status, dc_usecs_t start, unsigned int param, unsigned int value, const void *data, size_t size)
+{
+	dc_replay_record_t entry;
+	entry.type = type;
+	entry.status = status;
+	entry.timestamp = start;
+	entry.elapsed = dc_record_now (record) - start;
+	entry.param = param;
+	entry.value = value;
+	entry.data = (const unsigned char *) data;
+	entry.size = size;
+
+	if (dc_record_emit (record->fp, &entry) != 0) {
+		ERROR (record->context, "Failed to write the file.");
+		return DC_STATUS_IO;
+	}
+
+	return status;
+}
+
+static dc_status_t
+dc_record_set_timeout (dc_iostream_t *abstract, int timeout)
+{
+	dc_record_t *record = (dc_record_t *) abstract;
+
+	dc_usecs_t start = dc_record_now (record);
+	dc_status_t status = dc_iostream_set_timeout (record->iostream, timeout);
+	return dc_record_log (record, OP_SET_TIMEOUT, status, start, timeout, 0, NULL, 0);
+}
+
+static dc_status_t
+dc_record_set_break (dc_iostream_t *abstract, unsigned int value)
+{
+	dc_record_t *record = (dc_record_t *) abstract;
+
+	dc_usecs_t start = dc_record_now (record);
+	dc_status_t status = dc_iostream_set_break (record->iostream, value);
+	return dc_record_log (record, OP_SET_BREAK, status, start, value, 0, NULL, 0);
+}
+
+static dc_status_t
+dc_record_set_dtr (dc_iostream_t *abstract, unsigned int value)
+{
+	dc_record_t *record = (dc_record_t *) abstract;
+
+	dc_usecs_t start = dc_record_now (record);
+	dc_status_t status = dc_iostream_set_dtr (record->iostream, value);
+	return dc_record_log (record, OP_SET_DTR, status, start, value, 0, NULL, 0);
+}
+
+static dc_status_t
+dc_record_set_rts (dc_iostream_t *abstract, unsigned int value)
+{
+	dc_record_t *record = (dc_record_t *) abstract;
+
+	dc_usecs_t start = dc_record_now (record);
+	dc_status_t status = dc_iostream_set_rts (record->iostream, value);
+	return dc_record_log (record, OP_SET_RTS, status, start, value, 0, NULL, 0);
+}
+
+static dc_status_t
+dc_record_get_lines (dc_iostream_t *abstract, unsigned int *value)
+{
+	dc_record_t *record = (dc_record_t *) abstract;
+	unsigned int lines = 0;
+
+	dc_usecs_t start = dc_record_now (record);
+	dc_status_t status = dc_iostream_get_lines (record->iostream, &lines);
+	status = dc_record_log (record, OP_GET_LINES, status, start, 0, lines, NULL, 0);
+
+	*value = lines;
+
+	return status;
+}
+
+static dc_status_t
+dc_record_get_available (dc_iostream_t *abstract, size_t *value)
+{
+	dc_record_t *record = (dc_record_t *) abstract;
+	size_t available = 0;
+
+	dc_usecs_t start = dc_record_now (record);
+	dc_status_t status = dc_iostream_get_available (record->iostream, &available);
+	status = dc_record_log (record, OP_GET_AVAILABLE, status, start, 0, available, NULL, 0);
+
+	*value = available;
+
+	return status;
+}
+
+static dc_status_t
+dc_record_configure (dc_iostream_t *abstract, unsigned int baudrate, unsigned int databits, dc_parity_t parity, dc_stopbits_t stopbits, dc_flowcontrol_t flowcontrol)
+{
+	dc_record_t *record = (dc_record_t *) abstract;
+
+	unsigned char settings[20] = {0};
+	array_uint32_le_set (settings + 0, baudrate);
+	array_uint32_le_set (settings + 4, databits);
+	array_uint32_le_set (settings + 8, parity);
+	array_uint32_le_set (settings + 12, stopbits);
+	array_uint32_le_set (settings + 16, flowcontrol);
+
+	dc_usecs_t start = dc_record_now (record);
+	dc_status_t status = dc_iostream_configure (record->iostream, baudrate, databits, parity, stopbits, flowcontrol);
+	return dc_record_log (record, OP_CONFIGURE, status, start, 0, 0, settings, sizeof (settings));
+}
+
+static dc_status_t
+dc_record_poll (dc_iostream_t *abstract, int timeout)
+{
+	dc_record_t *record = (dc_record_t *) abstract;
+
+	dc_usecs_t start = dc_record_now (record);
+	dc_status_t status = dc_iostream_poll (record->iostream, timeout);
+	return dc_record_log (record, OP_POLL, status, start, timeout, 0, NULL, 0);
+}
+
+static dc_status_t
+dc_record_read (dc_iostream_t *abstract, void *data, size_t size, size_t *actual)
+{
+	dc_record_t *record = (dc_record_t *) abstract;
+	size_t nbytes = 0;
+
+	dc_usecs_t start = dc_record_now (record);
+	dc_status_t status = dc_iostream_read (record->iostream, data, size, &nbytes);
+	status = dc_record_log (record, OP_READ, status, start, size, nbytes, data, nbytes);
+
+	*actual = nbytes;
+
+	return status;
+}
+
+static dc_status_t
+dc_record_write (dc_iostream_t *abstract, const void *data, size_t size, size_t *actual)
+{
+	dc_record_t *record = (dc_record_t *) abstract;
+	size_t nbytes = 0;
+
+	dc_usecs_t start = dc_record_now (record);
+	dc_status_t status = dc_iostream_write (record->iostream, data, size, &nbytes);
+	status = dc_record_log (record, OP_WRITE, status, start, size, nbytes, data, size);
+
+	*actual = nbytes;
+
+	return status;
+}
+
+static dc_status_t
+dc_record_ioctl (dc_iostream_t *abstract, unsigned int request, void *data, size_t size)
+{
+	dc_record_t *record = (dc_record_t *) abstract;
+
+	dc_usecs_t start = dc_record_now (record);
+	dc_status_t status = dc_iostream_ioctl (record->iostream, request, data, size);
+	return dc_record_log (record, OP_IOCTL, status, start, request, size, data, data ? size : 0);
+}
+
+static dc_status_t
+dc_record_flush (dc_iostream_t *abstract)
+{
+	dc_record_t *record = (dc_record_t *) abstract;
+
+	dc_usecs_t start = dc_record_now (record);
+	dc_status_t status = dc_iostream_flush (record->iostream);
+	return dc_record_log (record, OP_FLUSH, status, start, 0, 0, NULL, 0);
+}
+
+static dc_status_t
+dc_record_purge (dc_iostream_t *abstract, dc_direction_t direction)
+{
+	dc_record_t *record = (dc_record_t *) abstract;
+
+	dc_usecs_t start = dc_record_now (record);
+	dc_status_t status = dc_iostream_purge (record->iostream, direction);
+	return dc_record_log (record, OP_PURGE, status, start, direction, 0, NULL, 0);
+}
+
+static dc_status_t
+dc_record_sleep (dc_iostream_t *abstract, unsigned int milliseconds)
+{
+	dc_record_t *record = (dc_record_t *) abstract;
+
+	dc_usecs_t start = dc_record_now (record);
+	dc_status_t status = dc_iostream_sleep (record->iostream, milliseconds);
+	return dc_record_log (record, OP_SLEEP, status, start, milliseconds, 0, NULL, 0);
+}
+
+static dc_status_t
+dc_record_set_interrupt (dc_iostream_t *abstract, dc_interrupt_t *interrupt)
+{
+	dc_record_t *record = (dc_record_t *) abstract;
+
+	return dc_iostream_set_interrupt (record->iostream, interrupt);
+}
+
+static dc_status_t
+dc_record_close (dc_iostream_t *abstract)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	dc_record_t *record = (dc_record_t *) abstract;
+
+	if (fclose (record->fp) != 0) {
+		ERROR (record->context, "Failed to write the file.");
+		status = DC_STATUS_IO;
+	}
+
+	dc_timer_free (record->timer);
+
+	return status;
+}
+
+static dc_status_t
+dc_replay_load (dc_context_t *context, const char *filename, dc_buffer_t **out)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	dc_buffer_t *buffer = NULL;
+	FILE *fp = NULL;
+
+	// Allocate a temporary buffer.
+	buffer = dc_buffer_new (0);
+	if (buffer == NULL) {
+		ERROR (context, "Failed to allocate memory.");
+		status = DC_STATUS_NOMEMORY;
+		goto error_exit;
+	}
+
+	// Open the file.
+	fp = fopen (filename, "rb");
+	if (fp == NULL) {
+		ERROR (context, "Failed to open the file.");
+		status = DC_STATUS_IO;
+		goto error_buffer_free;
+	}
+
+	// Read the entire file into the buffer.
+	size_t n = 0;
+	unsigned char block[4096] = {0};
+	while ((n = fread (block, 1, sizeof (block), fp)) > 0) {
+		if (!dc_buffer_append (buffer, block, n)) {
+			ERROR (context, "Insufficient buffer space available.");
+			status = DC_STATUS_NOMEMORY;
+			goto error_close;
+		}
+	}
+
+	fclose (fp);
+
+	*out = buffer;
+
+	return DC_STATUS_SUCCESS;
+
+error_close:
+	fclose (fp);
+error_buffer_free:
+	dc_buffer_free (buffer);
+error_exit:
+	return status;
+}
+
+dc_status_t
+dc_trace_open (dc_iostream_t **out, dc_context_t *context, dc_iostream_t *base, const char *filename, size_t capacity)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	dc_trace_t *trace = NULL;
+
+	if (out == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	if (base == NULL || filename == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	if (capacity == 0)
+		capacity = TRACE_CAPACITY;
+
+	dc_transport_t transport = dc_iostream_get_transport (base);
+
+	// Allocate memory.
+	trace = (dc_trace_t *) dc_iostream_allocate (context, &dc_trace_vtable, transport);
+	if (trace == NULL) {
+		ERROR (context, "Failed to allocate memory.");
+		status = DC_STATUS_NOMEMORY;
+		goto error_exit;
+	}
+
+	trace->context = context;
+	trace->iostream = base;
+	trace->transport = transport;
+	trace->fp = NULL;
+	trace->capacity = capacity;
+	trace->head = 0;
+	trace->tail = 0;
+	trace->used = 0;
+	trace->dropped = 0;
+	trace->start = dc_clock_now ();
+	trace->previous = 0;
+
+	trace->ring = (unsigned char *) malloc (capacity);
+	if (trace->ring == NULL) {
+		ERROR (context, "Failed to allocate memory.");
+		status = DC_STATUS_NOMEMORY;
+		goto error_free;
+	}
+
+	// Open the file now, to report errors early. The records are only
+	// written when the stream is closed.
+	trace->fp = fopen (filename, "wb");
+	if (trace->fp == NULL) {
+		ERROR (context, "Failed to open the file.");
+		status = DC_STATUS_IO;
+		goto error_ring_free;
+	}
+
+	*out = (dc_iostream_t *) trace;
+
+	return DC_STATUS_SUCCESS;
+
+error_ring_free:
+	free (trace->ring);
+error_free:
+	dc_iostream_deallocate ((dc_iostream_t *) trace);
+error_exit:
+	return status;
+}
+
+static size_t
+dc_trace_varint_set (unsigned char data[], unsigned long long value)
+{
+	size_t n = 0;
+
+	while (value >= 0x80) {
+		data[n++] = (value & 0x7F) | 0x80;
+		value >>= 7;
+	}
+	data[n++] = value;
+
+	return n;
+}
+
+static int
+dc_trace_varint (const unsigned char data[], size_t size, size_t *offset, unsigned long long *value)
+{
+	unsigned long long result = 0;
+	unsigned int shift = 0;
+	size_t n = *offset;
+
+	while (n < size && shift < 64) {
+		unsigned char byte = data[n++];
+		result |= (unsigned long long) (byte & 0x7F) << shift;
+		if ((byte & 0x80) == 0) {
+			*offset = n;
+			*value = result;
+			return 0;
+		}
+		shift += 7;
+	}
+
+	return -1;
+}
+
+static void
+dc_trace_put (dc_trace_t *trace, const void *data, size_t size)
+{
+	const unsigned char *p = (const unsigned char *) data;
+
+	size_t n = trace->capacity - trace->head;
+	if (n > size)
+		n = size;
+
+	memcpy (trace->ring + trace->head, p, n);
+	memcpy (trace->ring, p + n, size - n);
+
+	trace->head = (trace->head + size) % trace->capacity;
+	trace->used += size;
+}
+
+/*
+ * Discard the oldest record in the ring buffer.
+ */
+static void
+dc_trace_evict (dc_trace_t *trace)
+{
+	unsigned char header[SZ_TRACE_MAX];
+	size_t length = trace->used < sizeof (header) ? trace->used : sizeof (header);
+	for (size_t i = 0; i < length; ++i) {
+		header[i] = trace->ring[(trace->tail + i) % trace->capacity];
+	}
+
+	// Skip the type, status and the fields preceding the data size.
+	size_t offset = 2;
+	unsigned long long value = 0;
+	for (unsigned int i = 0; i < 5; ++i) {
+		if (dc_trace_varint (header, length, &offset, &value) != 0) {
+			// Not reached, unless the ring buffer is corrupt.
+			trace->tail = trace->head;
+			trace->used = 0;
+			return;
+		}
+	}
+
+	size_t total = offset + value;
+	trace->tail = (trace->tail + total) % trace->capacity;
+	trace->used -= total;
+	trace->dropped++;
+}
+
+/*
+ * Append a record to the ring buffer. When the buffer is full, the
+ * oldest records are discarded. Tracing never changes the result of
+ * the operation.
+ */
+static void
+dc_trace_log (dc_trace_t *trace, unsigned int type, dc_status_t status, dc_nsecs_t start, unsigned int param, unsigned int value, const void *data, size_t size)
+{
+	dc_usecs_t begin = (start - trace->start) / 1000;
+	dc_usecs_t end = (dc_clock_now () - trace->start) / 1000;
+
+	unsigned char header[SZ_TRACE_MAX];
+	size_t n = 0;
+	header[n++] = type;
+	header[n++] = (unsigned char) -status;
+	n += dc_trace_varint_set (header + n, begin - trace->previous);
+	n += dc_trace_varint_set (header + n, end - begin);
+	n += dc_trace_varint_set (header + n, param);
+	n += dc_trace_varint_set (header + n, value);
+	n += dc_trace_varint_set (header + n, size);
+
+	if (n + size > trace->capacity) {
+		trace->dropped++;
+		return;
+	}
+
+	while (trace->capacity - trace->used < n + size) {
+		dc_trace_evict (trace);
+	}
+
+	dc_trace_put (trace, header, n);
+	if (size)
+		dc_trace_put (trace, data, size);
+
+	trace->previous = begin;
+}
+
+static dc_status_t
+dc_trace_set_timeout (dc_iostream_t *abstract, int timeout)
+{
+	dc_trace_t *trace = (dc_trace_t *) abstract;
+
+	dc_nsecs_t start = dc_clock_now ();
+	dc_status_t status = dc_iostream_set_timeout (trace->iostream, timeout);
+	dc_trace_log (trace, OP_SET_TIMEOUT, status, start, timeout, 0, NULL, 0);
+	return status;
+}
+
+static dc_status_t
+dc_trace_set_break (dc_iostream_t *abstract, unsigned int value)
+{
+	dc_trace_t *trace = (dc_trace_t *) abstract;
+
+	dc_nsecs_t start = dc_clock_now ();
+	dc_status_t status = dc_iostream_set_break (trace->iostream, value);
+	dc_trace_log (trace, OP_SET_BREAK, status, start, value, 0, NULL, 0);
+	return status;
+}
+
+static dc_status_t
+dc_trace_set_dtr (dc_iostream_t *abstract, unsigned int value)
+{
+	dc_trace_t *trace = (dc_trace_t *) abstract;
+
+	dc_nsecs_t start = dc_clock_now ();
+	dc_status_t status = dc_iostream_set_dtr (trace->iostream, value);
+	dc_trace_log (trace, OP_SET_DTR, status, start, value, 0, NULL, 0);
+	return status;
+}
+
+static dc_status_t
+dc_trace_set_rts (dc_iostream_t *abstract, unsigned int value)
+{
+	dc_trace_t *trace = (dc_trace_t *) abstract;
+
+	dc_nsecs_t start = dc_clock_now ();
+	dc_status_t status = dc_iostream_set_rts (trace->iostream, value);
+	dc_trace_log (trace, OP_SET_RTS, status, start, value, 0, NULL, 0);
+	return status;
+}
+
+static dc_status_t
+dc_trace_get_lines (dc_iostream_t *abstract, unsigned int *value)
+{
+	dc_trace_t *trace = (dc_trace_t *) abstract;
+	unsigned int lines = 0;
+
+	dc_nsecs_t start = dc_clock_now ();
+	dc_status_t status = dc_iostream_get_lines (trace->iostream, &lines);
+	dc_trace_log (trace, OP_GET_LINES, status, start, 0, lines, NULL, 0);
+
+	*value = lines;
+
+	return status;
+}
+
+static dc_status_t
+dc_trace_get_available (dc_iostream_t *abstract, size_t *value)
+{
+	dc_trace_t *trace = (dc_trace_t *) abstract;
+	size_t available = 0;
+
+	dc_nsecs_t start = dc_clock_now ();
+	dc_status_t status = dc_iostream_get_available (trace->iostream, &available);
+	dc_trace_log (trace, OP_GET_AVAILABLE, status, start, 0, available, NULL, 0);
+
+	*value = available;
+
+	return status;
+}
+
+static dc_status_t
+dc_trace_configure (dc_iostream_t *abstract, unsigned int baudrate, unsigned int databits, dc_parity_t parity, dc_stopbits_t stopbits, dc_flowcontrol_t flowcontrol)
+{
+	dc_trace_t *trace = (dc_trace_t *) abstract;
+
+	unsigned char settings[20] = {0};
+	array_uint32_le_set (settings + 0, baudrate);
+	array_uint32_le_set (settings + 4, databits);
+	array_uint32_le_set (settings + 8, parity);
+	array_uint32_le_set (settings + 12, stopbits);
+	array_uint32_le_set (settings + 16, flowcontrol);
+
+	dc_nsecs_t start = dc_clock_now ();
+	dc_status_t status = dc_iostream_configure (trace->iostream, baudrate, databits, parity, stopbits, flowcontrol);
+	dc_trace_log (trace, OP_CONFIGURE, status, start, 0, 0, settings, sizeof (settings));
+	return status;
+}
+
+static dc_status_t
+dc_trace_poll (dc_iostream_t *abstract, int timeout)
+{
+	dc_trace_t *trace = (dc_trace_t *) abstract;
+
+	dc_nsecs_t start = dc_clock_now ();
+	dc_status_t status = dc_iostream_poll (trace->iostream, timeout);
+	dc_trace_log (trace, OP_POLL, status, start, timeout, 0, NULL, 0);
+	return status;
+}
+
+static dc_status_t
+dc_trace_read (dc_iostream_t *abstract, void *data, size_t size, size_t *actual)
+{
+	dc_trace_t *trace = (dc_trace_t *) abstract;
+	size_t nbytes = 0;
+
+	dc_nsecs_t start = dc_clock_now ();
+	dc_status_t status = dc_iostream_read (trace->iostream, data, size, &nbytes);
+	dc_trace_log (trace, OP_READ, status, start, size, nbytes, data, nbytes);
+
+	*actual = nbytes;
+
+	return status;
+}
+
+static dc_status_t
+dc_trace_write (dc_iostream_t *abstract, const void *data, size_t size, size_t *actual)
+{
+	dc_trace_t *trace = (dc_trace_t *) abstract;
+	size_t nbytes = 0;
+
+	dc_nsecs_t start = dc_clock_now ();
+	dc_status_t status = dc_iostream_write (trace->iostream, data, size, &nbytes);
+	dc_trace_log (trace, OP_WRITE, status, start, size, nbytes, data, size);
+
+	*actual = nbytes;
+
+	return status;
+}
+
+static dc_status_t
+dc_trace_ioctl (dc_iostream_t *abstract, unsigned int request, void *data, size_t size)
+{
+	dc_trace_t *trace = (dc_trace_t *) abstract;
+
+	dc_nsecs_t start = dc_clock_now ();
+	dc_status_t status = dc_iostream_ioctl (trace->iostream, request, data, size);
+	dc_trace_log (trace, OP_IOCTL, status, start, request, size, data, data ? size : 0);
+	return status;
+}
+
+static dc_status_t
+dc_trace_flush (dc_iostream_t *abstract)
+{
+	dc_trace_t *trace = (dc_trace_t *) abstract;
+
+	dc_nsecs_t start = dc_clock_now ();
+	dc_status_t status = dc_iostream_flush (trace->iostream);
+	dc_trace_log (trace, OP_FLUSH, status, start, 0, 0, NULL, 0);
+	return status;
+}
+
+static dc_status_t
+dc_trace_purge (dc_iostream_t *abstract, dc_direction_t direction)
+{
+	dc_trace_t *trace = (dc_trace_t *) abstract;
+
+	dc_nsecs_t start = dc_clock_now ();
+	dc_status_t status = dc_iostream_purge (trace->iostream, direction);
+	dc_trace_log (trace, OP_PURGE, status, start, direction, 0, NULL, 0);
+	return status;
+}
+
+static dc_status_t
+dc_trace_sleep (dc_iostream_t *abstract, unsigned int milliseconds)
+{
+	dc_trace_t *trace = (dc_trace_t *) abstract;
+
+	dc_nsecs_t start = dc_clock_now ();
+	dc_status_t status = dc_iostream_sleep (trace->iostream, milliseconds);
+	dc_trace_log (trace, OP_SLEEP, status, start, milliseconds, 0, NULL, 0);
+	return status;
+}
+
+static dc_status_t
+dc_trace_set_interrupt (dc_iostream_t *abstract, dc_interrupt_t *interrupt)
+{
+	dc_trace_t *trace = (dc_trace_t *) abstract;
+
+	return dc_iostream_set_interrupt (trace->iostream, interrupt);
+}
+
+static dc_status_t
+dc_trace_close (dc_iostream_t *abstract)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	dc_trace_t *trace = (dc_trace_t *) abstract;
+
+	// Write the file header, followed by the records from oldest to
+	// newest.
+	unsigned char header[SZ_HEADER] = {0};
+	array_uint32_le_set (header + 0, TRACE_MAGIC);
+	array_uint32_le_set (header + 4, TRACE_VERSION);
+	array_uint32_le_set (header + 8, trace->transport);
+	array_uint32_le_set (header + 12, trace->dropped);
+
+	size_t n = trace->capacity - trace->tail;
+	if (n > trace->used)
+		n = trace->used;
+
+	if (fwrite (header, sizeof (header), 1, trace->fp) != 1 ||
+		(n && fwrite (trace->ring + trace->tail, n, 1, trace->fp) != 1) ||
+		(trace->used > n && fwrite (trace->ring, trace->used - n, 1, trace->fp) != 1)) {
+		ERROR (trace->context, "Failed to write the file.");
+		status = DC_STATUS_IO;
+	}
+
+	if (fclose (trace->fp) != 0) {
+		ERROR (trace->context, "Failed to write the file.");
+		status = DC_STATUS_IO;
+	}
+
+	free (trace->ring);
+
+	return status;
+}
+
+dc_status_t
+dc_trace_convert (dc_context_t *context, const char *input, const char *output)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	dc_buffer_t *buffer = NULL;
+	FILE *fp = NULL;
+
+	if (input == NULL || output == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	// Read the entire trace into memory.
+	status = dc_replay_load (context, input, &buffer);
+	if (status != DC_STATUS_SUCCESS)
+		goto error_exit;
+
+	const unsigned char *data = dc_buffer_get_data (buffer);
+	size_t size = dc_buffer_get_size (buffer);
+
+	// Verify the file header.
+	if (size < SZ_HEADER ||
+		array_uint32_le (data + 0) != TRACE_MAGIC ||
+		array_uint32_le (data + 4) != TRACE_VERSION) {
+		ERROR (context, "Unexpected file format.");
+		status = DC_STATUS_DATAFORMAT;
+		goto error_buffer_free;
+	}
+
+	dc_transport_t transport = array_uint32_le (data + 8);
+	unsigned int dropped = array_uint32_le (data + 12);
+	if (dropped) {
+		WARNING (context, "Incomplete trace (%u records discarded).", dropped);
+	}
+
+	// Open the file.
+	fp = fopen (output, "wb");
+	if (fp == NULL) {
+		ERROR (context, "Failed to open the file.");
+		status = DC_STATUS_IO;
+		goto error_buffer_free;
+	}
+
+	if (dc_record_header (fp, transport) != 0) {
+		ERROR (context, "Failed to write the file.");
+		status = DC_STATUS_IO;
+		goto error_close;
+	}
+
+	dc_usecs_t timestamp = 0;
+	size_t offset = SZ_HEADER;
+	while (offset < size) {
+		unsigned long long fields[5] = {0};
+
+		if (offset + 2 > size) {
+			ERROR (context, "Unexpected end of the trace.");
+			status = DC_STATUS_DATAFORMAT;
+			goto error_close;
+		}
+
+		dc_replay_record_t record;
+		record.type = data[offset];
+		record.status = (dc_status_t) -(int) data[offset + 1];
+		offset += 2;
+
+		for (unsigned int i = 0; i < C_ARRAY_SIZE(fields); ++i) {
+			if (dc_trace_varint (data, size, &offset, &fields[i]) != 0) {
+				ERROR (context, "Unexpected end of the trace.");
+				status = DC_STATUS_DATAFORMAT;
+				goto error_close;
+			}
+		}
+
+		if (fields[4] > size - offset) {
+			ERROR (context, "Unexpected end of the trace.");
+			status = DC_STATUS_DATAFORMAT;
+			goto error_close;
+		}
+
+		timestamp += fields[0];
+
+		record.timestamp = timestamp;
+		record.elapsed = fields[1];
+		record.param = fields[2];
+		record.value = fields[3];
+		record.data = data + offset;
+		record.size = fields[4];
+
+		if (dc_record_emit (fp, &record) != 0) {
+			ERROR (context, "Failed to write the file.");
+			status = DC_STATUS_IO;
+			goto error_close;
+		}
+
+		offset += record.size;
+	}
+
+	if (fclose (fp) != 0) {
+		ERROR (context, "Failed to write the file.");
+		status = DC_STATUS_IO;
+	}
+
+	dc_buffer_free (buffer);
+
+	return status;
+
+error_close:
+	fclose (fp);
+error_buffer_free:
+	dc_buffer_free (buffer);
+error_exit:
+	return status;
+}
+
+dc_status_t
+dc_replay_open (dc_iostream_t **out, dc_context_t *context, const char *filename, dc_replay_mode_t mode)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	dc_replay_t *replay = NULL;
+	dc_buffer_t *buffer = NULL;
+
+	if (out == NULL || filename == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	if (mode != DC_REPLAY_FAST && mode != DC_REPLAY_REALTIME)
+		return DC_STATUS_INVALIDARGS;
+
+	// Read the entire file into memory.
+	status = dc_replay_load (context, filename, &buffer);
+	if (status != DC_STATUS_SUCCESS)
+		goto error_exit;
+
+	const unsigned char *data = dc_buffer_get_data (buffer);
+	size_t size = dc_buffer_get_size (buffer);
+
+	// Verify the file header.
+	if (size < SZ_HEADER ||
+		array_uint32_le (data + 0) != MAGIC ||
+		array_uint32_le (data + 4) != FORMAT_VERSION) {
+		ERROR (context, "Unexpected file format.");
+		status = DC_STATUS_DATAFORMAT;
+		goto error_buffer_free;
+	}
+
+	dc_transport_t transport = array_uint32_le (data + 8);
+
+	// Allocate memory.
+	replay = (dc_replay_t *) dc_iostream_allocate (context, &dc_replay_vtable, transport);
+	if (replay == NULL) {
+		ERROR (context, "Failed to allocate memory.");
+		status = DC_STATUS_NOMEMORY;
+		goto error_buffer_free;
+	}
+
+	replay->context = context;
+	replay->mode = mode;
+	replay->buffer = buffer;
+	replay->data = data;
+	replay->size = size;
+	replay->offset = SZ_HEADER;
+	memset (&replay->rrecord, 0, sizeof (replay->rrecord));
+	replay->roffset = 0;
+	replay->latency = 0;
+
+	*out = (dc_iostream_t *) replay;
+
+	return DC_STATUS_SUCCESS;
+
+error_buffer_free:
+	dc_buffer_free (buffer);
+error_exit:
+	return status;
+}
+
+static const char *
+dc_replay_name (unsigned int type)
+{
+	static const char *names[] = {
+		NULL,
+		"set_timeout",
+		"set_break",
+		"set_dtr",
+		"set_rts",
+		"get_lines",
+		"get_available",
+		"configure",
+		"poll",
+		"read",
+		"write",
+		"ioctl",
+		"flush",
+		"purge",
+		"sleep",
+	};
+
+	if (type == 0 || type >= C_ARRAY_SIZE(names))
+		return "unknown";
+
+	return names[type];
+}
+
+/*
+ * Fetch the next record, which should be of the requested type. On a
+ * mismatch, the position is not changed.
+ */
+static dc_status_t
+dc_replay_next (dc_replay_t *replay, unsigned int type, dc_replay_record_t *record)
+{
+	if (replay->offset + SZ_RECORD > replay->size) {
+		ERROR (replay->context, "Unexpected %s operation at the end of the recording.", dc_replay_name (type));
+		return DC_STATUS_IO;
+	}
+
+	const unsigned char *header = replay->data + replay->offset;
+	size_t length = array_uint32_le (header + 28);
+	if (length > replay->size - replay->offset - SZ_RECORD) {
+		ERROR (replay->context, "Unexpected end of the recording.");
+		return DC_STATUS_DATAFORMAT;
+	}
+
+	if (header[0] != type) {
+		ERROR (replay->context, "Unexpected %s operation (recorded %s).",
+			dc_replay_name (type), dc_replay_name (header[0]));
+		return DC_STATUS_IO;
+	}
+
+	record->type = header[0];
+	record->status = (dc_status_t) (int) array_uint32_le (header + 4);
+	record->timestamp = array_uint64_le (header + 8);
+	record->elapsed = array_uint32_le (header + 16);
+	record->param = array_uint32_le (header + 20);
+	record->value = array_uint32_le (header + 24);
+	record->data = header + SZ_RECORD;
+	record->size = length;
+
+	replay->offset += SZ_RECORD + length;
+
+	// Reproduce the recorded latency. Short delays are accumulated,
+	// because the sleep function only has millisecond resolution.
+	if (replay->mode == DC_REPLAY_REALTIME) {
+		replay->latency += record->elapsed;
+		if (replay->latency >= 1000) {
+			unsigned int milliseconds = replay->latency / 1000;
+			replay->latency %= 1000;
+			if (replay->base.interrupt)
+				return dc_interrupt_sleep (replay->base.interrupt, milliseconds);
+			dc_platform_sleep (milliseconds);
+		}
+	}
+
+	return DC_STATUS_SUCCESS;
+}
+
+static dc_status_t
+dc_replay_simple (dc_iostream_t *abstract, unsigned int type)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	dc_replay_t *replay = (dc_replay_t *) abstract;
+	dc_replay_record_t record;
+
+	status = dc_replay_next (replay, type, &record);
+	if (status != DC_STATUS_SUCCESS)
+		return status;
+
+	return record.status;
+}
+
+static dc_status_t
+dc_replay_set_timeout (dc_iostream_t *abstract, int timeout)
+{
+	return dc_replay_simple (abstract, OP_SET_TIMEOUT);
+}
+
+static dc_status_t
+dc_replay_set_break (dc_iostream_t *abstract, unsigned int value)
+{
+	return dc_replay_simple (abstract, OP_SET_BREAK);
+}
+
+static dc_status_t
+dc_replay_set_dtr (dc_iostream_t *abstract, unsigned int value)
+{
+	return dc_replay_simple (abstract, OP_SET_DTR);
+}
+
+static dc_status_t
+dc_replay_set_rts (dc_iostream_t *abstract, unsigned int value)
+{
+	return dc_replay_simple (abstract, OP_SET_RTS);
+}
+
+static dc_status_t
+dc_replay_get_lines (dc_iostream_t *abstract, unsigned int *value)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	dc_replay_t *replay = (dc_replay_t *) abstract;
+	dc_replay_record_t record;
+
+	status = dc_replay_next (replay, OP_GET_LINES, &record);
+	if (status != DC_STATUS_SUCCESS)
+		return status;
+
+	*value = record.value;
+
+	return record.status;
+}
+
+static dc_status_t
+dc_replay_get_available (dc_iostream_t *abstract, size_t *value)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	dc_replay_t *replay = (dc_replay_t *) abstract;
+	dc_replay_record_t record;
+
+	status = dc_replay_next (replay, OP_GET_AVAILABLE, &record);
+	if (status != DC_STATUS_SUCCESS)
+		return status;
+
+	*value = record.value;
+
+	return record.status;
+}
+
+static dc_status_t
+dc_replay_configure (dc_iostream_t *abstract, unsigned int baudrate, unsigned int databits, dc_parity_t parity, dc_stopbits_t stopbits, dc_flowcontrol_t flowcontrol)
+{
+	return dc_replay_simple (abstract, OP_CONFIGURE);
+}
+
+static dc_status_t
+dc_replay_poll (dc_iostream_t *abstract, int timeout)
+{
+	return dc_replay_simple (abstract, OP_POLL);
+}
+
+static dc_status_t
+dc_replay_read (dc_iostream_t *abstract, void *data, size_t size, size_t *actual)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	dc_replay_t *replay = (dc_replay_t *) abstract;
+
+	// Fetch the next record, unless the previous one still contains
+	// data which didn't fit into the buffer.
+	if (replay->roffset >= replay->rrecord.size) {
+		status = dc_replay_next (replay, OP_READ, &replay->rrecord);
+		if (status != DC_STATUS_SUCCESS) {
+			memset (&replay->rrecord, 0, sizeof (replay->rrecord));
+			replay->roffset = 0;
+			*actual = 0;
+			return status;
+		}
+		replay->roffset = 0;
+	}
+
+	size_t nbytes = replay->rrecord.size - replay->roffset;
+	if (nbytes > size)
+		nbytes = size;
+
+	if (nbytes) {
+		memcpy (data, replay->rrecord.data + replay->roffset, nbytes);
+		replay->roffset += nbytes;
+	}
+
+	*actual = nbytes;
+
+	if (replay->roffset < replay->rrecord.size)
+		return DC_STATUS_SUCCESS;
+
+	return replay->rrecord.status;
+}
+
+static dc_status_t
+dc_replay_write (dc_iostream_t *abstract, const void *data, size_t size, size_t *actual)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	dc_replay_t *replay = (dc_replay_t *) abstract;
+	dc_replay_record_t record;
+
+	status = dc_replay_next (replay, OP_WRITE, &record);
+	if (status != DC_STATUS_SUCCESS) {
+		*actual = 0;
+		return status;
+	}
+
+	if (size != record.size || memcmp (data, record.data, size) != 0) {
+		WARNING (replay->context, "Written data differs from the recording.");
+	}
+
+	*actual = record.value < size ? record.value : size;
+
+	return record.status;
+}
+
+static dc_status_t
+dc_replay_ioctl (dc_iostream_t *abstract, unsigned int request, void *data, size_t size)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	dc_replay_t *replay = (dc_replay_t *) abstract;
+	dc_replay_record_t record;
+
+	status = dc_replay_next (replay, OP_IOCTL, &record);
+	if (status != DC_STATUS_SUCCESS)
+		return status;
+
+	if (record.param != request) {
+		ERROR (replay->context, "Unexpected ioctl request %08x (recorded %08x).", request, record.param);
+		return DC_STATUS_IO;
+	}
+
+	// Return the data written by the driver.
+	if ((DC_IOCTL_DIR(request) & DC_IOCTL_DIR_READ) && data) {
+		memcpy (data, record.data, record.size < size ? record.size : size);
+	}
+
+	return record.status;
+}
+
+static dc_status_t
+dc_replay_flush (dc_iostream_t *abstract)
+{
+	return dc_replay_simple (abstract, OP_FLUSH);
+}
+
+static dc_status_t
+dc_replay_purge (dc_iostream_t *abstract, dc_direction_t direction)
+{
+	return dc_replay_simple (abstract, OP_PURGE);
+}
+
+static dc_status_t
+dc_replay_sleep (dc_iostream_t *abstract, unsigned int milliseconds)
+{
+	// The recorded latency already includes the time spent sleeping.
+	return dc_replay_simple (abstract, OP_SLEEP);
+}
+
+static dc_status_t
+dc_replay_close (dc_iostream_t *abstract)
+{
+	dc_replay_t *replay = (dc_replay_t *) abstract;
+
+	dc_buffer_free (replay->buffer);
+
+	return DC_STATUS_SUCCESS;
+}
@@ -83,9 +83,11 @@ static const dc_device_vtable_t seac_screen_device_vtable = {
 	DC_FAMILY_SEAC_SCREEN,
 	seac_screen_device_set_fingerprint, /* set_fingerprint */
 	seac_screen_device_read, /* read */
+	NULL, /* read_range */
 	NULL, /* write */
 	seac_screen_device_dump, /* dump */
 	seac_screen_device_foreach, /* foreach */
+	NULL, /* foreach_header */
 	NULL, /* timesync */
 	NULL, /* close */
 };
@@ -225,6 +227,8 @@ seac_screen_transfer (seac_screen_device_t *device, unsigned int cmd, const unsi
 		if (nretries++ >= MAXRETRIES)
 			return rc;
 
+		device_stats_retry ((dc_device_t *) device);
+
 		// Discard any garbage bytes.
 		dc_iostream_sleep (device->iostream, 100);
 		dc_iostream_purge (device->iostream, DC_DIRECTION_INPUT);
@@ -51,6 +51,7 @@ struct seac_screen_parser_t {
 static dc_status_t seac_screen_parser_get_datetime (dc_parser_t *abstract, dc_datetime_t *datetime);
 static dc_status_t seac_screen_parser_get_field (dc_parser_t *abstract, dc_field_type_t type, unsigned int flags, void *value);
 static dc_status_t seac_screen_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_t callback, void *userdata);
+static dc_status_t seac_screen_parser_reset (dc_parser_t *abstract);
 
 static const dc_parser_vtable_t seac_screen_parser_vtable = {
 	sizeof(seac_screen_parser_t),
@@ -60,7 +61,13 @@ static const dc_parser_vtable_t seac_screen_parser_vtable = {
 	NULL, /* set_density */
 	seac_screen_parser_get_datetime, /* datetime */
 	seac_screen_parser_get_field, /* fields */
+	NULL, /* summary */
 	seac_screen_parser_samples_foreach, /* samples_foreach */
+	NULL, /* samples_batch */
+	NULL, /* samples_fixed */
+	NULL, /* samples_append */
+	NULL, /* samples_range */
+	seac_screen_parser_reset, /* reset */
 	NULL /* destroy */
 };
 
@@ -80,6 +87,19 @@ seac_screen_parser_create (dc_parser_t **out, dc_context_t *context, const unsig
 	}
 
 	// Set the default values.
+	seac_screen_parser_reset ((dc_parser_t *) parser);
+
+	*out = (dc_parser_t *) parser;
+
+	return DC_STATUS_SUCCESS;
+}
+
+
+static dc_status_t
+seac_screen_parser_reset (dc_parser_t *abstract)
+{
+	seac_screen_parser_t *parser = (seac_screen_parser_t *) abstract;
+
 	parser->cached = 0;
 	parser->ngasmixes = 0;
 	for (unsigned int i = 0; i < NGASMIXES; ++i) {
@@ -88,8 +108,6 @@ seac_screen_parser_create (dc_parser_t **out, dc_context_t *context, const unsig
 	parser->gf_low = 0;
 	parser->gf_high = 0;
 
-	*out = (dc_parser_t *) parser;
-
 	return DC_STATUS_SUCCESS;
 }
 
@@ -0,0 +1,64 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2026 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+
+#ifndef DC_SERIAL_PRIVATE_H
+#define DC_SERIAL_PRIVATE_H
+
+#include <libdivecomputer/descriptor.h>
+#include <libdivecomputer/iostream.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/*
+ * Process wide cache with the descriptor that last opened a device on
+ * a serial port. Ports are identified by a stable name (e.g. the udev
+ * by-id link), such that the entry survives the device node changing.
+ */
+
+void
+dc_serial_cache_insert (const char *identity, dc_descriptor_t *descriptor);
+
+/*
+ * Check whether the descriptor opened a device on the port before.
+ */
+int
+dc_serial_cache_match (const char *identity, dc_descriptor_t *descriptor);
+
+/*
+ * Check whether the descriptor opened a device on any port before.
+ */
+int
+dc_serial_cache_contains (dc_descriptor_t *descriptor);
+
+/*
+ * Remember the descriptor for the port of a serial iostream. Other
+ * iostreams are ignored.
+ */
+void
+dc_serial_remember (dc_iostream_t *iostream, dc_descriptor_t *descriptor);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+#endif /* DC_SERIAL_PRIVATE_H */
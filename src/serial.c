@@ -0,0 +1,125 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2026 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+
+#include "serial-private.h"
+#include "thread.h"
+
+#define CACHESIZE 16
+
+typedef struct dc_serial_cache_t {
+	char identity[256];
+	dc_family_t family;
+	unsigned int model;
+} dc_serial_cache_t;
+
+static dc_mutex_t g_mutex = DC_MUTEX_INIT;
+static dc_serial_cache_t g_cache[CACHESIZE];
+static unsigned int g_next = 0;
+
+static int
+dc_serial_cache_equal (const dc_serial_cache_t *entry, dc_descriptor_t *descriptor)
+{
+	return entry->identity[0] != '\0' &&
+		entry->family == dc_descriptor_get_type (descriptor) &&
+		entry->model == dc_descriptor_get_model (descriptor);
+}
+
+void
+dc_serial_cache_insert (const char *identity, dc_descriptor_t *descriptor)
+{
+	if (identity == NULL || identity[0] == '\0' || descriptor == NULL)
+		return;
+
+	if (strlen (identity) >= sizeof (g_cache[0].identity))
+		return;
+
+	dc_mutex_lock (&g_mutex);
+
+	// Replace the existing entry for the port, or else the oldest one.
+	dc_serial_cache_t *entry = NULL;
+	for (unsigned int i = 0; i < CACHESIZE; ++i) {
+		if (strcmp (g_cache[i].identity, identity) == 0) {
+			entry = g_cache + i;
+			break;
+		}
+	}
+	if (entry == NULL) {
+		entry = g_cache + g_next;
+		g_next = (g_next + 1) % CACHESIZE;
+	}
+
+	strcpy (entry->identity, identity);
+	entry->family = dc_descriptor_get_type (descriptor);
+	entry->model = dc_descriptor_get_model (descriptor);
+
+	dc_mutex_unlock (&g_mutex);
+}
+
+int
+dc_serial_cache_match (const char *identity, dc_descriptor_t *descriptor)
+{
+	int match = 0;
+
+	if (identity == NULL || descriptor == NULL)
+		return 0;
+
+	dc_mutex_lock (&g_mutex);
+
+	for (unsigned int i = 0; i < CACHESIZE; ++i) {
+		if (strcmp (g_cache[i].identity, identity) == 0) {
+			match = dc_serial_cache_equal (g_cache + i, descriptor);
+			break;
+		}
+	}
+
+	dc_mutex_unlock (&g_mutex);
+
+	return match;
+}
+
+int
+dc_serial_cache_contains (dc_descriptor_t *descriptor)
+{
+	int match = 0;
+
+	if (descriptor == NULL)
+		return 0;
+
+	dc_mutex_lock (&g_mutex);
+
+	for (unsigned int i = 0; i < CACHESIZE; ++i) {
+		if (dc_serial_cache_equal (g_cache + i, descriptor)) {
+			match = 1;
+			break;
+		}
+	}
+
+	dc_mutex_unlock (&g_mutex);
+
+	return match;
+}
@@ -23,14 +23,15 @@
 #include "config.h"
 #endif
 
-#include <stdlib.h> // malloc, free
+#include <stdlib.h> // malloc, free, realpath
+#include <limits.h> // PATH_MAX
 #include <string.h>	// strerror
 #include <errno.h>	// errno
 #include <unistd.h>	// open, close, read, write
 #include <fcntl.h>	// fcntl
 #include <termios.h>	// tcgetattr, tcsetattr, cfsetispeed, cfsetospeed, tcflush, tcsendbreak
 #include <sys/ioctl.h>	// ioctl
-#include <sys/select.h>	// select
+#include <poll.h>	// poll
 #ifdef HAVE_LINUX_SERIAL_H
 #include <linux/serial.h>
 #endif
@@ -58,9 +59,14 @@
 #include "iostream-private.h"
 #include "iterator-private.h"
 #include "platform.h"
+#include "serial-private.h"
 #include "timer.h"
 
 #define DIRNAME "/dev"
+#define BYID    "/dev/serial/by-id"
+
+// Default latency timer of FTDI devices.
+#define DEFAULT_LATENCY 16
 
 static dc_status_t dc_serial_iterator_next (dc_iterator_t *iterator, void *item);
 static dc_status_t dc_serial_iterator_free (dc_iterator_t *iterator);
@@ -89,6 +95,12 @@ typedef struct dc_serial_iterator_t {
 	dc_iterator_t base;
 	dc_descriptor_t *descriptor;
 	DIR *dp;
+	/*
+	 * Ports where the descriptor succeeded before are returned in a
+	 * first pass over the directory, and all the others in a second.
+	 */
+	unsigned int cached;
+	unsigned int pass;
 } dc_serial_iterator_t;
 
 typedef struct dc_serial_t {
@@ -98,7 +110,10 @@ typedef struct dc_serial_t {
 	 */
 	int fd;
 	int timeout;
-	dc_timer_t *timer;
+	/*
+	 * The device name, to look up the identity of the port.
+	 */
+	char name[256];
 	/*
 	 * Serial port settings are saved into this variable immediately
 	 * after the port is opened. These settings are restored when the
@@ -125,10 +140,14 @@ static const dc_iostream_vtable_t dc_serial_vtable = {
 	dc_serial_poll, /* poll */
 	dc_serial_read, /* read */
 	dc_serial_write, /* write */
+	NULL, /* read_async */
+	NULL, /* write_async */
+	NULL, /* writev */
 	dc_serial_ioctl, /* ioctl */
 	dc_serial_flush, /* flush */
 	dc_serial_purge, /* purge */
 	dc_serial_sleep, /* sleep */
+	NULL, /* set_interrupt */
 	dc_serial_close, /* close */
 };
 
@@ -150,6 +169,61 @@ syserror(int errcode)
 	}
 }
 
+/*
+ * Get a name for the port that doesn't change when the device is
+ * plugged in again. On Linux that's the udev by-id link, which contains
+ * the USB serial number. Elsewhere the device name is already stable
+ * (e.g. tty.usbserial-<serial> on Mac OS X).
+ */
+static void
+dc_serial_identity (const char *name, char identity[], size_t size)
+{
+	strncpy (identity, name, size - 1);
+	identity[size - 1] = '\0';
+
+#ifdef __linux__
+	char target[PATH_MAX];
+	if (realpath (name, target) == NULL)
+		return;
+
+	DIR *dp = opendir (BYID);
+	if (dp == NULL)
+		return;
+
+	struct dirent *ep = NULL;
+	while ((ep = readdir (dp)) != NULL) {
+		if (ep->d_name[0] == '.')
+			continue;
+
+		char link[PATH_MAX], path[PATH_MAX];
+		int n = dc_platform_snprintf (link, sizeof (link), "%s/%s", BYID, ep->d_name);
+		if (n < 0 || (size_t) n >= sizeof (link) || (size_t) n >= size)
+			continue;
+
+		if (realpath (link, path) == NULL || strcmp (path, target) != 0)
+			continue;
+
+		strcpy (identity, link);
+		break;
+	}
+
+	closedir (dp);
+#endif
+}
+
+void
+dc_serial_remember (dc_iostream_t *abstract, dc_descriptor_t *descriptor)
+{
+	dc_serial_t *device = (dc_serial_t *) abstract;
+	char identity[sizeof(device->name)];
+
+	if (!dc_iostream_isinstance (abstract, &dc_serial_vtable))
+		return;
+
+	dc_serial_identity (device->name, identity, sizeof (identity));
+	dc_serial_cache_insert (identity, descriptor);
+}
+
 const char *
 dc_serial_device_get_name (dc_serial_device_t *device)
 {
@@ -189,6 +263,8 @@ dc_serial_iterator_new (dc_iterator_t **out, dc_context_t *context, dc_descripto
 	}
 
 	iterator->descriptor = descriptor;
+	iterator->cached = dc_serial_cache_contains (descriptor);
+	iterator->pass = iterator->cached ? 0 : 1;
 
 	*out = (dc_iterator_t *) iterator;
 
@@ -218,6 +294,7 @@ dc_serial_iterator_next (dc_iterator_t *abstract, void *out)
 		NULL
 	};
 
+next:
 	while ((ep = readdir (iterator->dp)) != NULL) {
 		for (size_t i = 0; patterns[i] != NULL; ++i) {
 			if (fnmatch (patterns[i], ep->d_name, 0) != 0)
@@ -233,6 +310,15 @@ dc_serial_iterator_next (dc_iterator_t *abstract, void *out)
 				continue;
 			}
 
+			if (iterator->cached) {
+				char identity[sizeof(device->name)];
+				dc_serial_identity (filename, identity, sizeof (identity));
+				int match = dc_serial_cache_match (identity, iterator->descriptor);
+				if (match != (iterator->pass == 0)) {
+					continue;
+				}
+			}
+
 			device = (dc_serial_device_t *) malloc (sizeof(dc_serial_device_t));
 			if (device == NULL) {
 				SYSERROR (abstract->context, ENOMEM);
@@ -247,6 +333,12 @@ dc_serial_iterator_next (dc_iterator_t *abstract, void *out)
 		}
 	}
 
+	if (iterator->pass == 0) {
+		rewinddir (iterator->dp);
+		iterator->pass++;
+		goto next;
+	}
+
 	return DC_STATUS_DONE;
 }
 
@@ -281,12 +373,8 @@ dc_serial_open (dc_iostream_t **out, dc_context_t *context, const char *name)
 	// Default to blocking reads.
 	device->timeout = -1;
 
-	// Create a high resolution timer.
-	status = dc_timer_new (&device->timer);
-	if (status != DC_STATUS_SUCCESS) {
-		ERROR (context, "Failed to create a high resolution timer.");
-		goto error_free;
-	}
+	strncpy (device->name, name, sizeof (device->name) - 1);
+	device->name[sizeof (device->name) - 1] = '\0';
 
 	// Open the device in non-blocking mode, to return immediately
 	// without waiting for the modem connection to complete.
@@ -295,7 +383,7 @@ dc_serial_open (dc_iostream_t **out, dc_context_t *context, const char *name)
 		int errcode = errno;
 		SYSERROR (context, errcode);
 		status = syserror (errcode);
-		goto error_timer_free;
+		goto error_free;
 	}
 
 #ifndef ENABLE_PTY
@@ -325,8 +413,6 @@ dc_serial_open (dc_iostream_t **out, dc_context_t *context, const char *name)
 
 error_close:
 	close (device->fd);
-error_timer_free:
-	dc_timer_free (device->timer);
 error_free:
 	dc_iostream_deallocate ((dc_iostream_t *) device);
 	return status;
@@ -361,8 +447,6 @@ dc_serial_close (dc_iostream_t *abstract)
 		dc_status_set_error(&status, syserror (errcode));
 	}
 
-	dc_timer_free (device->timer);
-
 	return status;
 }
 
@@ -668,25 +752,18 @@ static dc_status_t
 dc_serial_poll (dc_iostream_t *abstract, int timeout)
 {
 	dc_serial_t *device = (dc_serial_t *) abstract;
+	struct pollfd pfd[2];
 	int rc = 0;
 
 	do {
-		fd_set fds;
-		FD_ZERO (&fds);
-		FD_SET (device->fd, &fds);
-
-		struct timeval tv, *ptv = NULL;
-		if (timeout > 0) {
-			tv.tv_sec  = (timeout / 1000);
-			tv.tv_usec = (timeout % 1000) * 1000;
-			ptv = &tv;
-		} else if (timeout == 0) {
-			tv.tv_sec  = 0;
-			tv.tv_usec = 0;
-			ptv = &tv;
-		}
-
-		rc = select (device->fd + 1, &fds, NULL, NULL, ptv);
+		pfd[0].fd = device->fd;
+		pfd[0].events = POLLIN;
+		pfd[0].revents = 0;
+		pfd[1].fd = dc_interrupt_fd (abstract->interrupt);
+		pfd[1].events = POLLIN;
+		pfd[1].revents = 0;
+
+		rc = poll (pfd, pfd[1].fd >= 0 ? 2 : 1, timeout < 0 ? -1 : timeout);
 	} while (rc < 0 && errno == EINTR);
 
 	if (rc < 0) {
@@ -695,6 +772,8 @@ dc_serial_poll (dc_iostream_t *abstract, int timeout)
 		return syserror (errcode);
 	} else if (rc == 0) {
 		return DC_STATUS_TIMEOUT;
+	} else if (pfd[1].revents & POLLIN) {
+		return DC_STATUS_CANCELLED;
 	} else {
 		return DC_STATUS_SUCCESS;
 	}
@@ -708,59 +787,62 @@ dc_serial_read (dc_iostream_t *abstract, void *data, size_t size, size_t *actual
 	size_t nbytes = 0;
 
 	// The absolute target time.
-	dc_usecs_t target = 0;
+	dc_nsecs_t target = 0;
+
+	// If enough data is already buffered, there is no need to wait.
+	int available = 0;
+	int ready = ioctl (device->fd, TIOCINQ, &available) == 0 &&
+		(size_t) available >= size;
 
 	int init = 1;
 	while (nbytes < size) {
-		fd_set fds;
-		FD_ZERO (&fds);
-		FD_SET (device->fd, &fds);
-
-		struct timeval tv, *ptv = NULL;
-		if (device->timeout > 0) {
-			dc_usecs_t timeout = 0;
-
-			dc_usecs_t now = 0;
-			status = dc_timer_now (device->timer, &now);
-			if (status != DC_STATUS_SUCCESS) {
-				goto out;
-			}
-
-			if (init) {
-				// Calculate the initial timeout.
-				timeout = (dc_usecs_t) device->timeout * 1000;
-				// Calculate the target time.
-				target = now + timeout;
-				init = 0;
-			} else {
-				// Calculate the remaining timeout.
-				if (now < target) {
-					timeout = target - now;
+		if (!ready) {
+			int timeout = device->timeout;
+			if (timeout > 0) {
+				dc_nsecs_t now = dc_clock_now ();
+				if (init) {
+					// Calculate the target time.
+					target = now + (dc_nsecs_t) device->timeout * 1000000;
+					init = 0;
+				} else if (now < target) {
+					// Calculate the remaining timeout (rounded up).
+					timeout = (target - now + 999999) / 1000000;
 				} else {
 					timeout = 0;
 				}
 			}
-			tv.tv_sec  = timeout / 1000000;
-			tv.tv_usec = timeout % 1000000;
-			ptv = &tv;
-		} else if (device->timeout == 0) {
-			tv.tv_sec  = 0;
-			tv.tv_usec = 0;
-			ptv = &tv;
-		}
 
-		int rc = select (device->fd + 1, &fds, NULL, NULL, ptv);
-		if (rc < 0) {
-			int errcode = errno;
-			if (errcode == EINTR)
-				continue; // Retry.
-			SYSERROR (abstract->context, errcode);
-			status = syserror (errcode);
-			goto out;
-		} else if (rc == 0) {
-			break; // Timeout.
+			// Wait for the cancellation event as well.
+			struct pollfd pfd[2];
+			pfd[0].fd = device->fd;
+			pfd[0].events = POLLIN;
+			pfd[0].revents = 0;
+			pfd[1].fd = dc_interrupt_fd (abstract->interrupt);
+			pfd[1].events = POLLIN;
+			pfd[1].revents = 0;
+
+			int rc = poll (pfd, pfd[1].fd >= 0 ? 2 : 1, timeout < 0 ? -1 : timeout);
+			if (rc < 0) {
+				int errcode = errno;
+				if (errcode == EINTR)
+					continue; // Retry.
+				SYSERROR (abstract->context, errcode);
+				status = syserror (errcode);
+				goto out;
+			} else if (rc == 0) {
+				break; // Timeout.
+			} else if (pfd[1].revents & POLLIN) {
+				status = DC_STATUS_CANCELLED;
+				goto out;
+			} else if (pfd[0].revents & POLLNVAL) {
+				SYSERROR (abstract->context, EBADF);
+				status = syserror (EBADF);
+				goto out;
+			}
 		}
 
+		ready = 0;
+
 		ssize_t n = read (device->fd, (char *) data + nbytes, size - nbytes);
 		if (n < 0) {
 			int errcode = errno;
@@ -795,11 +877,12 @@ dc_serial_write (dc_iostream_t *abstract, const void *data, size_t size, size_t
 	size_t nbytes = 0;
 
 	while (nbytes < size) {
-		fd_set fds;
-		FD_ZERO (&fds);
-		FD_SET (device->fd, &fds);
+		struct pollfd pfd;
+		pfd.fd = device->fd;
+		pfd.events = POLLOUT;
+		pfd.revents = 0;
 
-		int rc = select (device->fd + 1, NULL, &fds, NULL, NULL);
+		int rc = poll (&pfd, 1, -1);
 		if (rc < 0) {
 			int errcode = errno;
 			if (errcode == EINTR)
@@ -854,6 +937,16 @@ dc_serial_ioctl (dc_iostream_t *abstract, unsigned int request, void *data, size
 	switch (request) {
 	case DC_IOCTL_SERIAL_SET_LATENCY:
 		return dc_serial_set_latency (abstract, *(unsigned int *) data);
+	case DC_IOCTL_SET_LATENCY:
+		switch (*(unsigned int *) data) {
+		case DC_LATENCY_LOW:
+			return dc_serial_set_latency (abstract, 0);
+		case DC_LATENCY_DEFAULT:
+		case DC_LATENCY_THROUGHPUT:
+			return dc_serial_set_latency (abstract, DEFAULT_LATENCY);
+		default:
+			return DC_STATUS_INVALIDARGS;
+		}
 	default:
 		return DC_STATUS_UNSUPPORTED;
 	}
@@ -994,6 +1087,9 @@ dc_serial_get_lines (dc_iostream_t *abstract, unsigned int *value)
 static dc_status_t
 dc_serial_sleep (dc_iostream_t *abstract, unsigned int timeout)
 {
+	if (abstract->interrupt)
+		return dc_interrupt_sleep (abstract->interrupt, timeout);
+
 	if (dc_platform_sleep (timeout) != 0) {
 		int errcode = errno;
 		SYSERROR (abstract->context, errcode);
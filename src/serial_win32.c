@@ -20,6 +20,7 @@
  */
 
 #include <stdlib.h>
+#include <string.h>
 
 #define WIN32_LEAN_AND_MEAN
 #define NOGDI
@@ -32,6 +33,12 @@
 #include "iostream-private.h"
 #include "iterator-private.h"
 #include "platform.h"
+#include "serial-private.h"
+
+#define FTDIBUS "SYSTEM\\CurrentControlSet\\Enum\\FTDIBUS"
+
+#define LATENCY_MIN 1
+#define LATENCY_MAX 255
 
 static dc_status_t dc_serial_iterator_next (dc_iterator_t *iterator, void *item);
 static dc_status_t dc_serial_iterator_free (dc_iterator_t *iterator);
@@ -62,6 +69,12 @@ typedef struct dc_serial_iterator_t {
 	HKEY hKey;
 	DWORD count;
 	DWORD current;
+	/*
+	 * Ports where the descriptor succeeded before are returned in a
+	 * first pass over the registry values, and all the others in a second.
+	 */
+	unsigned int cached;
+	unsigned int pass;
 } dc_serial_iterator_t;
 
 typedef struct dc_serial_t {
@@ -70,6 +83,10 @@ typedef struct dc_serial_t {
 	 * The file descriptor corresponding to the serial port.
 	 */
 	HANDLE hFile;
+	/*
+	 * The device name, required to re-open the serial port.
+	 */
+	char name[MAX_PATH];
 	/*
 	 * Serial port settings are saved into this variables immediately
 	 * after the port is opened. These settings are restored when the
@@ -102,10 +119,14 @@ static const dc_iostream_vtable_t dc_serial_vtable = {
 	dc_serial_poll, /* poll */
 	dc_serial_read, /* read */
 	dc_serial_write, /* write */
+	NULL, /* read_async */
+	NULL, /* write_async */
+	NULL, /* writev */
 	dc_serial_ioctl, /* ioctl */
 	dc_serial_flush, /* flush */
 	dc_serial_purge, /* purge */
 	dc_serial_sleep, /* sleep */
+	NULL, /* set_interrupt */
 	dc_serial_close, /* close */
 };
 
@@ -126,6 +147,30 @@ syserror(DWORD errcode)
 	}
 }
 
+/*
+ * Windows assigns the COM port number per USB serial number, so the
+ * port name is already a stable identity.
+ */
+static const char *
+dc_serial_identity (const char *name)
+{
+	if (strncmp (name, "\\\\.\\", 4) == 0)
+		name += 4;
+
+	return name;
+}
+
+void
+dc_serial_remember (dc_iostream_t *abstract, dc_descriptor_t *descriptor)
+{
+	dc_serial_t *device = (dc_serial_t *) abstract;
+
+	if (!dc_iostream_isinstance (abstract, &dc_serial_vtable))
+		return;
+
+	dc_serial_cache_insert (dc_serial_identity (device->name), descriptor);
+}
+
 const char *
 dc_serial_device_get_name (dc_serial_device_t *device)
 {
@@ -185,6 +230,8 @@ dc_serial_iterator_new (dc_iterator_t **out, dc_context_t *context, dc_descripto
 	iterator->hKey = hKey;
 	iterator->count = count;
 	iterator->current = 0;
+	iterator->cached = dc_serial_cache_contains (descriptor);
+	iterator->pass = iterator->cached ? 0 : 1;
 
 	*out = (dc_iterator_t *) iterator;
 
@@ -203,6 +250,7 @@ dc_serial_iterator_next (dc_iterator_t *abstract, void *out)
 	dc_serial_iterator_t *iterator = (dc_serial_iterator_t *) abstract;
 	dc_serial_device_t *device = NULL;
 
+next:
 	while (iterator->current < iterator->count) {
 		// Get the value name, data and type.
 		char name[256], data[sizeof(device->name)];
@@ -231,6 +279,13 @@ dc_serial_iterator_next (dc_iterator_t *abstract, void *out)
 			continue;
 		}
 
+		if (iterator->cached) {
+			int match = dc_serial_cache_match (dc_serial_identity (data), iterator->descriptor);
+			if (match != (iterator->pass == 0)) {
+				continue;
+			}
+		}
+
 		device = (dc_serial_device_t *) malloc (sizeof(dc_serial_device_t));
 		if (device == NULL) {
 			SYSERROR (abstract->context, ERROR_OUTOFMEMORY);
@@ -244,6 +299,12 @@ dc_serial_iterator_next (dc_iterator_t *abstract, void *out)
 		return DC_STATUS_SUCCESS;
 	}
 
+	if (iterator->pass == 0) {
+		iterator->current = 0;
+		iterator->pass++;
+		goto next;
+	}
+
 	return DC_STATUS_DONE;
 }
 
@@ -280,6 +341,8 @@ dc_serial_open (dc_iostream_t **out, dc_context_t *context, const char *name)
 		memcpy (buffer + 4, name, length);
 		devname = buffer;
 	} else {
+		if (strlen (name) >= sizeof (buffer))
+			return DC_STATUS_NOMEMORY;
 		devname = name;
 	}
 
@@ -291,6 +354,7 @@ dc_serial_open (dc_iostream_t **out, dc_context_t *context, const char *name)
 	}
 
 	// Default values.
+	strncpy (device->name, devname, sizeof (device->name));
 	memset(&device->overlapped, 0, sizeof(device->overlapped));
 	device->events = 0;
 	device->pending = FALSE;
@@ -677,12 +741,208 @@ out:
 	return status;
 }
 
+static dc_status_t
+dc_serial_reopen (dc_serial_t *device)
+{
+	dc_context_t *context = device->base.context;
+	DCB dcb;
+	COMMTIMEOUTS timeouts;
+
+	// Retrieve the current communication settings and timeouts.
+	if (!GetCommState (device->hFile, &dcb) ||
+		!GetCommTimeouts (device->hFile, &timeouts)) {
+		DWORD errcode = GetLastError ();
+		SYSERROR (context, errcode);
+		return syserror (errcode);
+	}
+
+	// Disable event monitoring, and wait for the pending
+	// event to complete.
+	SetCommMask (device->hFile, 0);
+	if (device->pending) {
+		DWORD dummy = 0;
+		GetOverlappedResult (device->hFile, &device->overlapped, &dummy, TRUE);
+		device->pending = FALSE;
+	}
+
+	CloseHandle (device->hFile);
+
+	// Open the device again.
+	device->hFile = CreateFileA (device->name,
+			GENERIC_READ | GENERIC_WRITE, 0,
+			NULL, // No security attributes.
+			OPEN_EXISTING,
+			FILE_FLAG_OVERLAPPED,
+			NULL);
+	if (device->hFile == INVALID_HANDLE_VALUE) {
+		DWORD errcode = GetLastError ();
+		SYSERROR (context, errcode);
+		return syserror (errcode);
+	}
+
+	// Restore the communication settings and timeouts.
+	if (!SetCommState (device->hFile, &dcb) ||
+		!SetCommTimeouts (device->hFile, &timeouts) ||
+		!SetCommMask (device->hFile, EV_RXCHAR)) {
+		DWORD errcode = GetLastError ();
+		SYSERROR (context, errcode);
+		return syserror (errcode);
+	}
+
+	return DC_STATUS_SUCCESS;
+}
+
+static dc_status_t
+dc_serial_ftdi_parameters (dc_serial_t *device, HKEY hKey, const char *subkey, const char *portname, DWORD latency, int *changed)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	HKEY hParams = NULL;
+	char name[MAX_PATH];
+	DWORD name_len = sizeof (name) - 1;
+	DWORD value = 0, value_len = sizeof (value);
+	DWORD type = 0;
+	LONG rc = 0;
+
+	// Open the device parameters. Without administrator rights, the
+	// key can only be opened for reading.
+	rc = RegOpenKeyExA (hKey, subkey, 0, KEY_QUERY_VALUE | KEY_SET_VALUE, &hParams);
+	if (rc == ERROR_ACCESS_DENIED)
+		rc = RegOpenKeyExA (hKey, subkey, 0, KEY_QUERY_VALUE, &hParams);
+	if (rc != ERROR_SUCCESS)
+		return DC_STATUS_UNSUPPORTED;
+
+	// Check the port name.
+	rc = RegQueryValueExA (hParams, "PortName", NULL, &type, (LPBYTE) name, &name_len);
+	if (rc != ERROR_SUCCESS || type != REG_SZ) {
+		status = DC_STATUS_UNSUPPORTED;
+		goto out;
+	}
+	name[name_len] = 0;
+	if (strcasecmp (name, portname) != 0) {
+		status = DC_STATUS_UNSUPPORTED;
+		goto out;
+	}
+
+	// Check the current latency timer.
+	rc = RegQueryValueExA (hParams, "LatencyTimer", NULL, &type, (LPBYTE) &value, &value_len);
+	if (rc == ERROR_SUCCESS && type == REG_DWORD && value == latency) {
+		goto out;
+	}
+
+	// Update the latency timer.
+	rc = RegSetValueExA (hParams, "LatencyTimer", 0, REG_DWORD, (const BYTE *) &latency, sizeof (latency));
+	if (rc != ERROR_SUCCESS) {
+		if (rc != ERROR_ACCESS_DENIED)
+			SYSERROR (device->base.context, rc);
+		status = syserror (rc);
+		goto out;
+	}
+
+	*changed = 1;
+
+out:
+	RegCloseKey (hParams);
+	return status;
+}
+
+static dc_status_t
+dc_serial_ftdi_latency (dc_serial_t *device, DWORD latency, int *changed)
+{
+	dc_status_t status = DC_STATUS_UNSUPPORTED;
+	HKEY hBus = NULL;
+
+	// Strip the prefix from the device name.
+	const char *portname = device->name;
+	if (strncmp (portname, "\\\\.\\", 4) == 0)
+		portname += 4;
+
+	// The FTDI driver stores its settings in the device parameters of
+	// each instance: FTDIBUS\<hardware id>\<instance>\Device Parameters.
+	if (RegOpenKeyExA (HKEY_LOCAL_MACHINE, FTDIBUS, 0, KEY_ENUMERATE_SUB_KEYS, &hBus) != ERROR_SUCCESS)
+		return DC_STATUS_UNSUPPORTED;
+
+	for (DWORD i = 0; status == DC_STATUS_UNSUPPORTED; ++i) {
+		char id[MAX_PATH];
+		DWORD id_len = sizeof (id);
+		if (RegEnumKeyExA (hBus, i, id, &id_len, NULL, NULL, NULL, NULL) != ERROR_SUCCESS)
+			break;
+
+		HKEY hId = NULL;
+		if (RegOpenKeyExA (hBus, id, 0, KEY_ENUMERATE_SUB_KEYS, &hId) != ERROR_SUCCESS)
+			continue;
+
+		for (DWORD j = 0; status == DC_STATUS_UNSUPPORTED; ++j) {
+			static const char params[] = "\\Device Parameters";
+			char subkey[MAX_PATH];
+			DWORD subkey_len = sizeof (subkey) - sizeof (params);
+			if (RegEnumKeyExA (hId, j, subkey, &subkey_len, NULL, NULL, NULL, NULL) != ERROR_SUCCESS)
+				break;
+			memcpy (subkey + subkey_len, params, sizeof (params));
+
+			status = dc_serial_ftdi_parameters (device, hId, subkey, portname, latency, changed);
+		}
+
+		RegCloseKey (hId);
+	}
+
+	RegCloseKey (hBus);
+
+	return status;
+}
+
+static dc_status_t
+dc_serial_set_latency (dc_iostream_t *abstract, unsigned int milliseconds)
+{
+	dc_serial_t *device = (dc_serial_t *) abstract;
+	int changed = 0;
+
+	// The FTDI latency timer has a limited range.
+	DWORD latency = milliseconds;
+	if (latency < LATENCY_MIN)
+		latency = LATENCY_MIN;
+	if (latency > LATENCY_MAX)
+		latency = LATENCY_MAX;
+
+	dc_status_t status = dc_serial_ftdi_latency (device, latency, &changed);
+	if (status == DC_STATUS_UNSUPPORTED) {
+		// Not an FTDI device.
+		return DC_STATUS_SUCCESS;
+	} else if (status == DC_STATUS_NOACCESS) {
+		WARNING (abstract->context, "Insufficient permissions to change the latency timer.");
+		return DC_STATUS_SUCCESS;
+	} else if (status != DC_STATUS_SUCCESS) {
+		return status;
+	}
+
+	// The driver only applies the new latency timer when the
+	// serial port is opened.
+	if (changed) {
+		INFO (abstract->context, "Latency timer changed to %lu ms.", (unsigned long) latency);
+		status = dc_serial_reopen (device);
+	}
+
+	return status;
+}
+
 static dc_status_t
 dc_serial_ioctl (dc_iostream_t *abstract, unsigned int request, void *data, size_t size)
 {
 	switch (request) {
 	case DC_IOCTL_SERIAL_SET_LATENCY:
-		return DC_STATUS_SUCCESS;
+		return dc_serial_set_latency (abstract, *(unsigned int *) data);
+	case DC_IOCTL_SET_LATENCY:
+		// The latency timer is a persistent setting, and changing it
+		// requires re-opening the port. Therefore only low latency
+		// requests are applied, and the others leave it alone.
+		switch (*(unsigned int *) data) {
+		case DC_LATENCY_LOW:
+			return dc_serial_set_latency (abstract, 0);
+		case DC_LATENCY_DEFAULT:
+		case DC_LATENCY_THROUGHPUT:
+			return DC_STATUS_SUCCESS;
+		default:
+			return DC_STATUS_INVALIDARGS;
+		}
 	default:
 		return DC_STATUS_UNSUPPORTED;
 	}
@@ -836,6 +1096,9 @@ dc_serial_get_lines (dc_iostream_t *abstract, unsigned int *value)
 static dc_status_t
 dc_serial_sleep (dc_iostream_t *abstract, unsigned int timeout)
 {
+	if (abstract->interrupt)
+		return dc_interrupt_sleep (abstract->interrupt, timeout);
+
 	if (dc_platform_sleep (timeout) != 0) {
 		DWORD errcode = GetLastError ();
 		SYSERROR (abstract->context, errcode);
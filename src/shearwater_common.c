@@ -50,6 +50,10 @@ shearwater_common_setup (shearwater_common_device_t *device, dc_context_t *conte
 	dc_status_t status = DC_STATUS_SUCCESS;
 
 	device->iostream = iostream;
+	device->roffset = 0;
+	device->ravailable = 0;
+	device->pending = 0;
+	device->model = 0;
 
 	// Set the serial communication protocol (115200 8N1).
 	status = dc_iostream_configure (device->iostream, 115200, 8, DC_PARITY_NONE, DC_STOPBITS_ONE, DC_FLOWCONTROL_NONE);
@@ -74,17 +78,43 @@ shearwater_common_setup (shearwater_common_device_t *device, dc_context_t *conte
 
 
 static int
-shearwater_common_decompress_lre (unsigned char *data, unsigned int size, dc_buffer_t *buffer, unsigned int *isfinal)
+shearwater_common_decompress_lre (const unsigned char *data, unsigned int size, dc_buffer_t *buffer, unsigned int *isfinal)
 {
 	// The RLE decompression algorithm does interpret the binary data as a
 	// stream of 9 bit values. Therefore, the total number of bits needs to be
-	// a multiple of 9 bits.
+	// a multiple of 9 bits. Because each packet is a multiple of 9 bits as
+	// well, the packets can be decompressed one by one, without having to
+	// carry any state from one packet to the next.
 	unsigned int nbits = size * 8;
 	if (nbits % 9 != 0)
 		return -1;
 
+	// Calculate the size of the decompressed data first, to grow the
+	// output buffer only once per packet.
+	unsigned int length = 0;
+	unsigned int final = 0;
+	unsigned int end = 0;
+	while (end + 9 <= nbits) {
+		unsigned int value = (array_uint16_be (data + end / 8) >> (7 - end % 8)) & 0x1FF;
+		if (value & 0x100) {
+			length++;
+		} else if (value == 0) {
+			final = 1;
+			break;
+		} else {
+			length += value;
+		}
+		end += 9;
+	}
+
+	unsigned int previous = dc_buffer_get_size (buffer);
+	if (!dc_buffer_resize (buffer, previous + length))
+		return -1;
+
+	unsigned char *p = dc_buffer_get_data (buffer) + previous;
+
 	unsigned int offset = 0;
-	while (offset + 9 <= nbits) {
+	while (offset < end) {
 		// Extract the 9 bit value.
 		unsigned int byte = offset / 8;
 		unsigned int bit  = offset % 8;
@@ -96,128 +126,135 @@ shearwater_common_decompress_lre (unsigned char *data, unsigned int size, dc_buf
 		// not a run and doesn't need expansion. If the bit is not set,
 		// the value contains the number of zero bytes in the run. A
 		// zero-length run indicates the end of the compressed stream.
+		// The zero bytes are already present, because the buffer is
+		// zero filled when resized.
 		if (value & 0x100) {
-			// Append the data byte directly.
-			unsigned char c = value & 0xFF;
-			if (!dc_buffer_append (buffer, &c, 1))
-				return -1;
-		} else if (value == 0) {
-			// Reached the end of the compressed stream.
-			if (isfinal)
-				*isfinal = 1;
-			break;
+			*p++ = value & 0xFF;
 		} else {
-			// Expand the run with zero bytes.
-			if (!dc_buffer_resize (buffer, dc_buffer_get_size (buffer) + value))
-				return -1;
+			p += value;
 		}
 
 		offset += 9;
 	}
 
+	if (final && isfinal)
+		*isfinal = 1;
+
 	return 0;
 }
 
 
 static int
-shearwater_common_decompress_xor (unsigned char *data, unsigned int size)
+shearwater_common_decompress_xor (unsigned char *data, unsigned int size, unsigned int offset)
 {
 	// Each block of 32 bytes is XOR'ed (in-place) with the previous block,
-	// except for the first block, which is passed through unchanged.
-	for (unsigned int i = 32; i < size; ++i) {
+	// except for the first block, which is passed through unchanged. The
+	// bytes before the offset are already processed, which allows to
+	// decode the data incrementally as it arrives.
+	if (offset < 32)
+		offset = 32;
+
+	for (unsigned int i = offset; i < size; ++i) {
 		data[i] ^= data[i - 32];
 	}
 
 	return 0;
 }
 
+/*
+ * Get the length of the initial run of bytes that are neither END nor
+ * ESC. The data is scanned a word at a time for both characters, and
+ * only the words that contain one are checked byte by byte.
+ */
+static unsigned int
+shearwater_common_slip_span (const unsigned char data[], unsigned int size)
+{
+	const size_t ones = (size_t) -1 / 0xFF;
+	const size_t high = ones * 0x80;
+	unsigned int i = 0;
+
+	while (i < size) {
+		unsigned int n = size - i;
+		if (n >= sizeof (size_t)) {
+			size_t word = 0, end = 0, esc = 0;
+			memcpy (&word, data + i, sizeof (word));
+			end = word ^ (ones * END);
+			esc = word ^ (ones * ESC);
+			if (((((end - ones) & ~end) | ((esc - ones) & ~esc)) & high) == 0) {
+				i += sizeof (size_t);
+				continue;
+			}
+			n = sizeof (size_t);
+		}
+
+		for (unsigned int j = 0; j < n; ++j, ++i) {
+			if (data[i] == END || data[i] == ESC)
+				return i;
+		}
+	}
+
+	return size;
+}
+
 static dc_status_t
 shearwater_common_slip_write (shearwater_common_device_t *device, const unsigned char data[], unsigned int size)
 {
 	dc_status_t status = DC_STATUS_SUCCESS;
 	dc_transport_t transport = dc_iostream_get_transport(device->iostream);
-	unsigned char buffer[32];
+	unsigned char frame[2 * (SZ_PACKET + 4) + 1];
 	unsigned int nbytes = 0;
 
-	if (transport == DC_TRANSPORT_BLE) {
-		// Calculate the total number of bytes.
-		unsigned int count = 1;
-		for (unsigned int i = 0; i < size; ++i) {
-			unsigned char c = data[i];
-			if (c == END || c == ESC) {
-				count += 2;
-			} else {
-				count++;
-			}
-		}
-
-		// Calculate the total number of frames.
-		unsigned int nframes = (count + sizeof(buffer) - 1) / sizeof(buffer);
+	if (size > SZ_PACKET + 4)
+		return DC_STATUS_INVALIDARGS;
 
-		buffer[0] = nframes;
-		buffer[1] = 0;
-		nbytes = 2;
+	// Build the entire SLIP frame.
+	unsigned int i = 0;
+	while (i < size) {
+		unsigned int n = shearwater_common_slip_span (data + i, size - i);
+		memcpy (frame + nbytes, data + i, n);
+		nbytes += n;
+		i += n;
+
+		if (i < size) {
+			frame[nbytes++] = ESC;
+			frame[nbytes++] = (data[i] == END) ? ESC_END : ESC_ESC;
+			i++;
+		}
 	}
 
-	for (unsigned int i = 0; i < size; ++i) {
-		unsigned char c = data[i];
-
-		if (c == END || c == ESC) {
-			// Append the escape character.
-			buffer[nbytes++] = ESC;
-
-			// Flush the buffer if necessary.
-			if (nbytes >= sizeof(buffer)) {
-				status = dc_iostream_write (device->iostream, buffer, nbytes, NULL);
-				if (status != DC_STATUS_SUCCESS) {
-					ERROR (device->base.context, "Failed to send the packet.");
-					return status;
-				}
-
-				if (transport == DC_TRANSPORT_BLE) {
-					buffer[1]++;
-					nbytes = 2;
-				} else {
-					nbytes = 0;
-				}
-			}
+	// Append the END character to indicate the end of the packet.
+	frame[nbytes++] = END;
 
-			// Escape the character.
-			if (c == END) {
-				c = ESC_END;
-			} else {
-				c = ESC_ESC;
-			}
+	if (transport != DC_TRANSPORT_BLE) {
+		status = dc_iostream_write (device->iostream, frame, nbytes, NULL);
+		if (status != DC_STATUS_SUCCESS) {
+			ERROR (device->base.context, "Failed to send the packet.");
+			return status;
 		}
 
-		// Append the character.
-		buffer[nbytes++] = c;
+		return DC_STATUS_SUCCESS;
+	}
 
-		// Flush the buffer if necessary.
-		if (nbytes >= sizeof(buffer)) {
-			status = dc_iostream_write (device->iostream, buffer, nbytes, NULL);
-			if (status != DC_STATUS_SUCCESS) {
-				ERROR (device->base.context, "Failed to send the packet.");
-				return status;
-			}
+	// Over BLE, the frame is split into packets of at most 32 bytes,
+	// each starting with the total number of packets and the index.
+	unsigned char buffer[32];
+	unsigned int payload = sizeof(buffer) - 2;
+	unsigned int nframes = (nbytes + sizeof(buffer) - 1) / sizeof(buffer);
 
-			if (transport == DC_TRANSPORT_BLE) {
-				buffer[1]++;
-				nbytes = 2;
-			} else {
-				nbytes = 0;
-			}
-		}
-	}
+	for (unsigned int offset = 0, index = 0; offset < nbytes; offset += payload, index++) {
+		unsigned int len = nbytes - offset;
+		if (len > payload)
+			len = payload;
 
-	// Append the END character to indicate the end of the packet.
-	buffer[nbytes++] = END;
+		buffer[0] = nframes;
+		buffer[1] = index;
+		memcpy (buffer + 2, frame + offset, len);
 
-	// Flush the buffer.
-	status = dc_iostream_write (device->iostream, buffer, nbytes, NULL);
-	if (status != DC_STATUS_SUCCESS) {
-		ERROR (device->base.context, "Failed to send the packet.");
-		return status;
+		status = dc_iostream_write (device->iostream, buffer, len + 2, NULL);
+		if (status != DC_STATUS_SUCCESS) {
+			ERROR (device->base.context, "Failed to send the packet.");
+			return status;
+		}
 	}
 
 	return DC_STATUS_SUCCESS;
@@ -229,37 +266,69 @@ shearwater_common_slip_read (shearwater_common_device_t *device, unsigned char d
 {
 	dc_status_t status = DC_STATUS_SUCCESS;
 	dc_transport_t transport = dc_iostream_get_transport(device->iostream);
-	unsigned char buffer[256];
 	unsigned int escaped = 0;
 	unsigned int nbytes = 0;
 
-	// Get the packet size.
-	size_t packetsize = (transport == DC_TRANSPORT_BLE) ? sizeof(buffer) : 1;
-
 	// Read bytes until a complete packet has been received. If the
 	// buffer runs out of space, bytes are dropped. The caller can
 	// detect this condition because the return value will be larger
 	// than the supplied buffer size.
 	while (1) {
-		size_t transferred = 0;
-		status = dc_iostream_read (device->iostream, buffer, packetsize, &transferred);
-		if (status != DC_STATUS_SUCCESS) {
-			ERROR (device->base.context, "Failed to receive the packet.");
-			return status;
-		}
+		if (device->ravailable == 0) {
+			// Get the packet size. Over BLE, that's an entire packet.
+			// Otherwise, read everything that is already available, but
+			// at least one byte. Any data after the end of the frame is
+			// kept for the next frame.
+			size_t packetsize = sizeof(device->rbuf);
+			if (transport != DC_TRANSPORT_BLE) {
+				size_t available = 0;
+				status = dc_iostream_get_available (device->iostream, &available);
+				if (status != DC_STATUS_SUCCESS || available == 0)
+					available = 1;
+				if (packetsize > available)
+					packetsize = available;
+			}
 
-		size_t offset = 0;
-		if (transport == DC_TRANSPORT_BLE) {
-			if (transferred < 2) {
-				ERROR (device->base.context, "Invalid packet length (" DC_PRINTF_SIZE ").", transferred);
-				return DC_STATUS_PROTOCOL;
+			size_t transferred = 0;
+			status = dc_iostream_read (device->iostream, device->rbuf, packetsize, &transferred);
+			if (status != DC_STATUS_SUCCESS) {
+				ERROR (device->base.context, "Failed to receive the packet.");
+				return status;
+			}
+
+			size_t offset = 0;
+			if (transport == DC_TRANSPORT_BLE) {
+				if (transferred < 2) {
+					ERROR (device->base.context, "Invalid packet length (" DC_PRINTF_SIZE ").", transferred);
+					return DC_STATUS_PROTOCOL;
+				}
+
+				offset = 2;
 			}
 
-			offset = 2;
+			device->roffset = offset;
+			device->ravailable = transferred - offset;
 		}
 
-		for (size_t i = offset; i < transferred; ++i) {
-			unsigned char c = buffer[i];
+		while (device->ravailable) {
+			const unsigned char *p = device->rbuf + device->roffset;
+
+			if (!escaped) {
+				// Copy the run of regular characters at once.
+				unsigned int n = shearwater_common_slip_span (p, device->ravailable);
+				if (n) {
+					if (nbytes < size)
+						memcpy (data + nbytes, p, nbytes + n > size ? size - nbytes : n);
+					nbytes += n;
+					device->roffset += n;
+					device->ravailable -= n;
+					continue;
+				}
+			}
+
+			unsigned char c = *p;
+			device->roffset++;
+			device->ravailable--;
 
 			if (c == END || c == ESC) {
 				if (escaped) {
@@ -312,6 +381,9 @@ shearwater_common_slip_read (shearwater_common_device_t *device, unsigned char d
 	}
 
 done:
+	// The remainder of a BLE packet is never part of the next frame.
+	if (transport == DC_TRANSPORT_BLE)
+		device->ravailable = 0;
 
 	if (nbytes > size) {
 		ERROR (device->base.context, "Insufficient buffer space available.");
@@ -325,13 +397,78 @@ done:
 }
 
 
+static dc_status_t
+shearwater_common_receive (shearwater_common_device_t *device, unsigned char output[], unsigned int osize, unsigned int *actual)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	dc_device_t *abstract = (dc_device_t *) device;
+	unsigned char packet[SZ_PACKET + 4];
+	unsigned int n = 0;
+
+	// Receive the response packet.
+	status = shearwater_common_slip_read (device, packet, sizeof (packet), &n);
+	if (status != DC_STATUS_SUCCESS) {
+		ERROR (abstract->context, "Failed to receive the response packet.");
+		return status;
+	}
+
+	// Validate the packet header.
+	if (n < 4 || packet[0] != 0x01 || packet[1] != 0xFF || packet[3] != 0x00) {
+		ERROR (abstract->context, "Invalid packet header.");
+		return DC_STATUS_PROTOCOL;
+	}
+
+	// Validate the packet length.
+	unsigned int length = packet[2];
+	if (length < 1 || length - 1 + 4 != n || length - 1 > osize) {
+		ERROR (abstract->context, "Invalid packet header.");
+		return DC_STATUS_PROTOCOL;
+	}
+
+	memcpy (output, packet + 4, length - 1);
+	if (actual)
+		*actual = length - 1;
+
+	return DC_STATUS_SUCCESS;
+}
+
+
+dc_status_t
+shearwater_common_sync (shearwater_common_device_t *device)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	dc_device_t *abstract = (dc_device_t *) device;
+	unsigned char response[2];
+	unsigned int n = 0;
+
+	while (device->pending) {
+		device->pending--;
+
+		// Receive the quit response.
+		status = shearwater_common_receive (device, response, sizeof (response), &n);
+		if (status != DC_STATUS_SUCCESS) {
+			device->pending = 0;
+			return status;
+		}
+
+		// Verify the quit response.
+		if (n != 2 || response[0] != 0x77 || response[1] != 0x00) {
+			ERROR (abstract->context, "Unexpected response packet.");
+			device->pending = 0;
+			return DC_STATUS_PROTOCOL;
+		}
+	}
+
+	return DC_STATUS_SUCCESS;
+}
+
+
 dc_status_t
 shearwater_common_transfer (shearwater_common_device_t *device, const unsigned char input[], unsigned int isize, unsigned char output[], unsigned int osize, unsigned int *actual)
 {
 	dc_status_t status = DC_STATUS_SUCCESS;
 	dc_device_t *abstract = (dc_device_t *) device;
 	unsigned char packet[SZ_PACKET + 4];
-	unsigned int n = 0;
 
 	if (isize > SZ_PACKET || osize > SZ_PACKET)
 		return DC_STATUS_INVALIDARGS;
@@ -360,36 +497,18 @@ shearwater_common_transfer (shearwater_common_device_t *device, const unsigned c
 		return DC_STATUS_SUCCESS;
 	}
 
-	// Receive the response packet.
-	status = shearwater_common_slip_read (device, packet, sizeof (packet), &n);
+	// The responses to the pipelined requests arrive first.
+	status = shearwater_common_sync (device);
 	if (status != DC_STATUS_SUCCESS) {
-		ERROR (abstract->context, "Failed to receive the response packet.");
 		return status;
 	}
 
-	// Validate the packet header.
-	if (n < 4 || packet[0] != 0x01 || packet[1] != 0xFF || packet[3] != 0x00) {
-		ERROR (abstract->context, "Invalid packet header.");
-		return DC_STATUS_PROTOCOL;
-	}
-
-	// Validate the packet length.
-	unsigned int length = packet[2];
-	if (length < 1 || length - 1 + 4 != n || length - 1 > osize) {
-		ERROR (abstract->context, "Invalid packet header.");
-		return DC_STATUS_PROTOCOL;
-	}
-
-	memcpy (output, packet + 4, length - 1);
-	if (actual)
-		*actual = length - 1;
-
-	return DC_STATUS_SUCCESS;
+	return shearwater_common_receive (device, output, osize, actual);
 }
 
 
-dc_status_t
-shearwater_common_download (shearwater_common_device_t *device, dc_buffer_t *buffer, unsigned int address, unsigned int size, unsigned int compression, dc_event_progress_t *progress)
+static dc_status_t
+shearwater_common_download_internal (shearwater_common_device_t *device, dc_buffer_t *buffer, unsigned int address, unsigned int size, unsigned int compression, unsigned int pipelined, dc_event_progress_t *progress)
 {
 	dc_device_t *abstract = (dc_device_t *) device;
 	dc_status_t rc = DC_STATUS_SUCCESS;
@@ -474,10 +593,16 @@ shearwater_common_download (shearwater_common_device_t *device, dc_buffer_t *buf
 		}
 
 		if (compression) {
+			unsigned int previous = dc_buffer_get_size (buffer);
 			if (shearwater_common_decompress_lre (response + 2, length, buffer, &done) != 0) {
 				ERROR (abstract->context, "Decompression error (LRE phase).");
 				return DC_STATUS_PROTOCOL;
 			}
+
+			if (shearwater_common_decompress_xor (dc_buffer_get_data (buffer), dc_buffer_get_size (buffer), previous) != 0) {
+				ERROR (abstract->context, "Decompression error (XOR phase).");
+				return DC_STATUS_PROTOCOL;
+			}
 		} else {
 			if (!dc_buffer_append (buffer, response + 2, length)) {
 				ERROR (abstract->context, "Insufficient buffer space available.");
@@ -489,23 +614,26 @@ shearwater_common_download (shearwater_common_device_t *device, dc_buffer_t *buf
 		block++;
 	}
 
-	if (compression) {
-		if (shearwater_common_decompress_xor (dc_buffer_get_data (buffer), dc_buffer_get_size (buffer)) != 0) {
-			ERROR (abstract->context, "Decompression error (XOR phase).");
-			return DC_STATUS_PROTOCOL;
+	// Transfer the quit request. When pipelined, the response is only
+	// received after the next request has been sent.
+	if (pipelined) {
+		rc = shearwater_common_transfer (device, req_quit, sizeof (req_quit), NULL, 0, NULL);
+		if (rc != DC_STATUS_SUCCESS) {
+			return rc;
 		}
-	}
 
-	// Transfer the quit request.
-	rc = shearwater_common_transfer (device, req_quit, sizeof (req_quit), response, 2, &n);
-	if (rc != DC_STATUS_SUCCESS) {
-		return rc;
-	}
+		device->pending++;
+	} else {
+		rc = shearwater_common_transfer (device, req_quit, sizeof (req_quit), response, 2, &n);
+		if (rc != DC_STATUS_SUCCESS) {
+			return rc;
+		}
 
-	// Verify the quit response.
-	if (n != 2 || response[0] != 0x77 || response[1] != 0x00) {
-		ERROR (abstract->context, "Unexpected response packet.");
-		return DC_STATUS_PROTOCOL;
+		// Verify the quit response.
+		if (n != 2 || response[0] != 0x77 || response[1] != 0x00) {
+			ERROR (abstract->context, "Unexpected response packet.");
+			return DC_STATUS_PROTOCOL;
+		}
 	}
 
 	// Update and emit a progress event.
@@ -519,6 +647,20 @@ shearwater_common_download (shearwater_common_device_t *device, dc_buffer_t *buf
 }
 
 
+dc_status_t
+shearwater_common_download (shearwater_common_device_t *device, dc_buffer_t *buffer, unsigned int address, unsigned int size, unsigned int compression, dc_event_progress_t *progress)
+{
+	return shearwater_common_download_internal (device, buffer, address, size, compression, 0, progress);
+}
+
+
+dc_status_t
+shearwater_common_download_pipelined (shearwater_common_device_t *device, dc_buffer_t *buffer, unsigned int address, unsigned int size, unsigned int compression, dc_event_progress_t *progress)
+{
+	return shearwater_common_download_internal (device, buffer, address, size, compression, 1, progress);
+}
+
+
 dc_status_t
 shearwater_common_rdbi (shearwater_common_device_t *device, unsigned int id, unsigned char data[], unsigned int size)
 {
@@ -686,6 +828,12 @@ shearwater_common_timesync_utc (shearwater_common_device_t *device, const dc_dat
 
 dc_status_t shearwater_common_get_model(shearwater_common_device_t *device, unsigned int *model)
 {
+	// The hardware type doesn't change during the session.
+	if (device->model) {
+		*model = device->model;
+		return DC_STATUS_SUCCESS;
+	}
+
 	// Read the hardware type.
 	unsigned char rsp_hardware[2] = {0};
 	dc_status_t status = shearwater_common_rdbi (device, ID_HARDWARE, rsp_hardware, sizeof(rsp_hardware));
@@ -752,5 +900,7 @@ dc_status_t shearwater_common_get_model(shearwater_common_device_t *device, unsi
 		WARNING (device->base.context, "Unknown hardware type 0x%04x.", hardware);
 	}
 
+	device->model = *model;
+
 	return status;
 }
@@ -65,6 +65,11 @@ extern "C" {
 typedef struct shearwater_common_device_t {
 	dc_device_t base;
 	dc_iostream_t *iostream;
+	unsigned char rbuf[256];
+	unsigned int roffset;
+	unsigned int ravailable;
+	unsigned int pending;
+	unsigned int model;
 } shearwater_common_device_t;
 
 dc_status_t
@@ -76,6 +81,17 @@ shearwater_common_transfer (shearwater_common_device_t *device, const unsigned c
 dc_status_t
 shearwater_common_download (shearwater_common_device_t *device, dc_buffer_t *buffer, unsigned int address, unsigned int size, unsigned int compression, dc_event_progress_t *progress);
 
+/*
+ * Same as shearwater_common_download, but without waiting for the
+ * response to the quit request. It's verified before the response to
+ * the next request, or by shearwater_common_sync.
+ */
+dc_status_t
+shearwater_common_download_pipelined (shearwater_common_device_t *device, dc_buffer_t *buffer, unsigned int address, unsigned int size, unsigned int compression, dc_event_progress_t *progress);
+
+dc_status_t
+shearwater_common_sync (shearwater_common_device_t *device);
+
 dc_status_t
 shearwater_common_rdbi (shearwater_common_device_t *device, unsigned int id, unsigned char data[], unsigned int size);
 
@@ -27,6 +27,7 @@
 #include "context-private.h"
 #include "device-private.h"
 #include "platform.h"
+#include "thread.h"
 #include "array.h"
 
 #define ISINSTANCE(device) dc_device_isinstance((device), &shearwater_petrel_device_vtable)
@@ -39,25 +40,45 @@
 #define RECORD_SIZE   0x20
 #define RECORD_COUNT  (MANIFEST_SIZE / RECORD_SIZE)
 
+// The hardware type and logbook format are remembered for the most
+// recently seen devices, such that the next download of the same
+// device and firmware can skip those requests.
+#define CACHE_SIZE    8
+
 typedef struct shearwater_petrel_device_t {
 	shearwater_common_device_t base;
 	unsigned char fingerprint[4];
 } shearwater_petrel_device_t;
 
+typedef struct shearwater_petrel_cache_t {
+	unsigned int serial;
+	unsigned int firmware;
+	unsigned int model;
+	unsigned int logupload;
+	unsigned int sequence;
+} shearwater_petrel_cache_t;
+
 
 static dc_status_t shearwater_petrel_device_set_fingerprint (dc_device_t *abstract, const unsigned char data[], unsigned int size);
 static dc_status_t shearwater_petrel_device_foreach (dc_device_t *abstract, dc_dive_callback_t callback, void *userdata);
+static dc_status_t shearwater_petrel_device_foreach_header (dc_device_t *abstract, dc_dive_callback_t callback, void *userdata);
 static dc_status_t shearwater_petrel_device_timesync (dc_device_t *abstract, const dc_datetime_t *datetime);
 static dc_status_t shearwater_petrel_device_close (dc_device_t *abstract);
 
+static dc_mutex_t g_cache_mutex = DC_MUTEX_INIT;
+static shearwater_petrel_cache_t g_cache[CACHE_SIZE];
+static unsigned int g_cache_sequence = 0;
+
 static const dc_device_vtable_t shearwater_petrel_device_vtable = {
 	sizeof(shearwater_petrel_device_t),
 	DC_FAMILY_SHEARWATER_PETREL,
 	shearwater_petrel_device_set_fingerprint, /* set_fingerprint */
 	NULL, /* read */
+	NULL, /* read_range */
 	NULL, /* write */
 	NULL, /* dump */
 	shearwater_petrel_device_foreach, /* foreach */
+	shearwater_petrel_device_foreach_header, /* foreach_header */
 	shearwater_petrel_device_timesync,
 	shearwater_petrel_device_close /* close */
 };
@@ -78,6 +99,54 @@ str2num (unsigned char data[], unsigned int size, unsigned int offset)
 }
 
 
+static int
+shearwater_petrel_cache_lookup (unsigned int serial, unsigned int firmware, unsigned int *model, unsigned int *logupload)
+{
+	int found = 0;
+
+	dc_mutex_lock (&g_cache_mutex);
+	for (size_t i = 0; i < C_ARRAY_SIZE(g_cache); ++i) {
+		shearwater_petrel_cache_t *entry = &g_cache[i];
+		if (entry->sequence && entry->serial == serial && entry->firmware == firmware) {
+			entry->sequence = ++g_cache_sequence;
+			*model = entry->model;
+			*logupload = entry->logupload;
+			found = 1;
+			break;
+		}
+	}
+	dc_mutex_unlock (&g_cache_mutex);
+
+	return found;
+}
+
+
+static void
+shearwater_petrel_cache_insert (unsigned int serial, unsigned int firmware, unsigned int model, unsigned int logupload)
+{
+	dc_mutex_lock (&g_cache_mutex);
+
+	// Replace the matching or the least recently used entry.
+	shearwater_petrel_cache_t *entry = &g_cache[0];
+	for (size_t i = 0; i < C_ARRAY_SIZE(g_cache); ++i) {
+		if (g_cache[i].sequence && g_cache[i].serial == serial) {
+			entry = &g_cache[i];
+			break;
+		}
+		if (g_cache[i].sequence < entry->sequence)
+			entry = &g_cache[i];
+	}
+
+	entry->serial = serial;
+	entry->firmware = firmware;
+	entry->model = model;
+	entry->logupload = logupload;
+	entry->sequence = ++g_cache_sequence;
+
+	dc_mutex_unlock (&g_cache_mutex);
+}
+
+
 dc_status_t
 shearwater_petrel_device_open (dc_device_t **out, dc_context_t *context, dc_iostream_t *iostream)
 {
@@ -148,8 +217,12 @@ shearwater_petrel_device_set_fingerprint (dc_device_t *abstract, const unsigned
 }
 
 
+/*
+ * Download the manifests, and then either the dives or only the manifest
+ * records of the dives.
+ */
 static dc_status_t
-shearwater_petrel_device_foreach (dc_device_t *abstract, dc_dive_callback_t callback, void *userdata)
+shearwater_petrel_device_download (dc_device_t *abstract, dc_dive_callback_t callback, void *userdata, unsigned int headers)
 {
 	shearwater_petrel_device_t *device = (shearwater_petrel_device_t *) abstract;
 	dc_status_t rc = DC_STATUS_SUCCESS;
@@ -185,11 +258,17 @@ shearwater_petrel_device_foreach (dc_device_t *abstract, dc_dive_callback_t call
 	// Convert to a number.
 	unsigned int firmware = str2num (rsp_firmware, sizeof(rsp_firmware), 1);
 
-	unsigned int model = 0;
-	rc = shearwater_common_get_model (&device->base, &model);
-	if (rc != DC_STATUS_SUCCESS) {
-		ERROR (abstract->context, "Failed to read the hardware type.");
-		return rc;
+	// Lookup the hardware type and logbook type from a previous download.
+	unsigned int model = 0, base_addr = 0;
+	int cached = shearwater_petrel_cache_lookup (array_uint32_be (serial), firmware, &model, &base_addr);
+	if (cached) {
+		device->base.model = model;
+	} else {
+		rc = shearwater_common_get_model (&device->base, &model);
+		if (rc != DC_STATUS_SUCCESS) {
+			ERROR (abstract->context, "Failed to read the hardware type.");
+			return rc;
+		}
 	}
 
 	// Emit a device info event.
@@ -200,14 +279,17 @@ shearwater_petrel_device_foreach (dc_device_t *abstract, dc_dive_callback_t call
 	device_event_emit (abstract, DC_EVENT_DEVINFO, &devinfo);
 
 	// Read the logbook type
-	unsigned char rsp_logupload[9] = {0};
-	rc = shearwater_common_rdbi (&device->base, ID_LOGUPLOAD, rsp_logupload, sizeof(rsp_logupload));
-	if (rc != DC_STATUS_SUCCESS) {
-		ERROR (abstract->context, "Failed to read the logbook type.");
-		return rc;
+	if (!cached) {
+		unsigned char rsp_logupload[9] = {0};
+		rc = shearwater_common_rdbi (&device->base, ID_LOGUPLOAD, rsp_logupload, sizeof(rsp_logupload));
+		if (rc != DC_STATUS_SUCCESS) {
+			ERROR (abstract->context, "Failed to read the logbook type.");
+			return rc;
+		}
+
+		base_addr = array_uint32_be (rsp_logupload + 1);
 	}
 
-	unsigned int base_addr = array_uint32_be (rsp_logupload + 1);
 	switch (base_addr) {
 	case 0xDD000000: // Predator - we shouldn't get here, we could give up or we can try 0xC0000000
 	case 0xC0000000: // Predator-Like Format (what we used to call the Petrel format)
@@ -223,9 +305,13 @@ shearwater_petrel_device_foreach (dc_device_t *abstract, dc_dive_callback_t call
 		return DC_STATUS_DATAFORMAT;
 	}
 
+	if (!cached && model) {
+		shearwater_petrel_cache_insert (devinfo.serial, firmware, model, base_addr);
+	}
+
 	// Allocate memory buffers for the manifests.
-	dc_buffer_t *buffer = dc_buffer_new (MANIFEST_SIZE);
-	dc_buffer_t *manifests = dc_buffer_new (MANIFEST_SIZE);
+	dc_buffer_t *buffer = dc_buffer_new_context (abstract->context, MANIFEST_SIZE);
+	dc_buffer_t *manifests = dc_buffer_new_context (abstract->context, MANIFEST_SIZE);
 	if (buffer == NULL || manifests == NULL) {
 		ERROR (abstract->context, "Insufficient buffer space available.");
 		dc_buffer_free (buffer);
@@ -239,12 +325,12 @@ shearwater_petrel_device_foreach (dc_device_t *abstract, dc_dive_callback_t call
 		// Assume the worst case scenario of a full manifest, and adjust the
 		// value with the actual number of dives after the manifest has been
 		// processed.
-		maximum += 1 + RECORD_COUNT;
+		maximum += 1 + (headers ? 0 : RECORD_COUNT);
 
 		// Download a manifest.
 		progress.current = NSTEPS * current;
 		progress.maximum = NSTEPS * maximum;
-		rc = shearwater_common_download (&device->base, buffer, MANIFEST_ADDR, MANIFEST_SIZE, 0, &progress);
+		rc = shearwater_common_download_pipelined (&device->base, buffer, MANIFEST_ADDR, MANIFEST_SIZE, 0, &progress);
 		if (rc != DC_STATUS_SUCCESS) {
 			ERROR (abstract->context, "Failed to download the manifest.");
 			dc_buffer_free (buffer);
@@ -281,7 +367,8 @@ shearwater_petrel_device_foreach (dc_device_t *abstract, dc_dive_callback_t call
 
 		// Update the progress state.
 		current += 1;
-		maximum -= RECORD_COUNT - count - deleted;
+		if (!headers)
+			maximum -= RECORD_COUNT - count - deleted;
 
 		// Append the manifest records to the main buffer.
 		if (!dc_buffer_append (manifests, data, count * RECORD_SIZE)) {
@@ -296,29 +383,92 @@ shearwater_petrel_device_foreach (dc_device_t *abstract, dc_dive_callback_t call
 			break;
 	}
 
-	// Update and emit a progress event.
-	progress.current = NSTEPS * current;
-	progress.maximum = NSTEPS * maximum;
-	device_event_emit (abstract, DC_EVENT_PROGRESS, &progress);
-
 	// Cache the buffer pointer and size.
 	unsigned char *data = dc_buffer_get_data (manifests);
 	unsigned int size = dc_buffer_get_size (manifests);
 
+	// Locate the most recent dive.
+	unsigned int newest = 0;
+	while (newest < size && array_uint16_be (data + newest) == 0x5A23)
+		newest += RECORD_SIZE;
+
+	if (headers) {
+		for (unsigned int i = newest; i < size; i += RECORD_SIZE) {
+			// skip deleted dives
+			if (array_uint16_be (data + i) == 0x5A23)
+				continue;
+
+			if (callback && !callback (data + i, RECORD_SIZE, data + i + 4, sizeof (device->fingerprint), userdata))
+				break;
+		}
+
+		// Update and emit a progress event.
+		progress.current = NSTEPS * current;
+		progress.maximum = NSTEPS * maximum;
+		device_event_emit (abstract, DC_EVENT_PROGRESS, &progress);
+
+		dc_buffer_free (manifests);
+		dc_buffer_free (buffer);
+
+		return DC_STATUS_SUCCESS;
+	}
+
 	unsigned int offset = 0;
+
+	// Skip the dives already delivered by an interrupted download. The
+	// checkpoint is only valid if no new dives have been recorded since.
+	unsigned char cp_first[sizeof (device->fingerprint)] = {0}, cp_last[sizeof (device->fingerprint)] = {0};
+	unsigned int cp_address = 0;
+	if (newest < size && device_checkpoint_get (abstract, &cp_address, cp_first, cp_last, sizeof (device->fingerprint))) {
+		unsigned int skip = 0, skipped = 0;
+		if (memcmp (data + newest + 4, cp_first, sizeof (cp_first)) == 0) {
+			for (unsigned int i = newest; i < size; i += RECORD_SIZE) {
+				if (array_uint16_be (data + i) == 0x5A23)
+					continue;
+				skipped++;
+				if (array_uint32_be (data + i + 20) == cp_address &&
+					memcmp (data + i + 4, cp_last, sizeof (cp_last)) == 0) {
+					skip = i + RECORD_SIZE;
+					break;
+				}
+			}
+		}
+
+		if (skip) {
+			DEBUG (abstract->context, "Resuming the download after %u dives.", skipped);
+			offset = skip;
+			maximum -= skipped;
+		} else {
+			WARNING (abstract->context, "Ignoring outdated checkpoint.");
+		}
+	}
+
+	// Update and emit a progress event.
+	progress.current = NSTEPS * current;
+	progress.maximum = NSTEPS * maximum;
+	device_event_emit (abstract, DC_EVENT_PROGRESS, &progress);
+
 	while (offset < size) {
 		// skip deleted dives
 		if (array_uint16_be(data + offset) == 0x5A23) {
 			offset += RECORD_SIZE;
 			continue;
 		}
+
+		// Skip dives left out by a selective download.
+		if (device_is_excluded (abstract, data + offset + 4, sizeof (device->fingerprint))) {
+			offset += RECORD_SIZE;
+			maximum -= 1;
+			continue;
+		}
+
 		// Get the address of the dive.
 		unsigned int address = array_uint32_be (data + offset + 20);
 
 		// Download the dive.
 		progress.current = NSTEPS * current;
 		progress.maximum = NSTEPS * maximum;
-		rc = shearwater_common_download (&device->base, buffer, base_addr + address, DIVE_SIZE, 1, &progress);
+		rc = shearwater_common_download_pipelined (&device->base, buffer, base_addr + address, DIVE_SIZE, 1, &progress);
 		if (rc != DC_STATUS_SUCCESS) {
 			ERROR (abstract->context, "Failed to download the dive.");
 			dc_buffer_free (buffer);
@@ -331,12 +481,30 @@ shearwater_petrel_device_foreach (dc_device_t *abstract, dc_dive_callback_t call
 
 		unsigned char *buf = dc_buffer_get_data (buffer);
 		unsigned int len = dc_buffer_get_size (buffer);
-		if (callback && !callback (buf, len, buf + 12, sizeof (device->fingerprint), userdata))
+		int more = callback ? callback (buf, len, buf + 12, sizeof (device->fingerprint), userdata) : 1;
+
+		// Update the checkpoint with the last delivered dive.
+		device_checkpoint_set (abstract, address, data + newest + 4, data + offset + 4, sizeof (device->fingerprint));
+
+		if (!more)
 			break;
 
 		offset += RECORD_SIZE;
 	}
 
+	// Verify the response to the last quit request.
+	rc = shearwater_common_sync (&device->base);
+	if (rc != DC_STATUS_SUCCESS) {
+		ERROR (abstract->context, "Failed to download the dive.");
+		dc_buffer_free (buffer);
+		dc_buffer_free (manifests);
+		return rc;
+	}
+
+	// Discard the checkpoint once all dives have been delivered.
+	if (offset >= size && rc == DC_STATUS_SUCCESS)
+		device_checkpoint_clear (abstract);
+
 	// Update and emit a progress event.
 	progress.current = NSTEPS * current;
 	progress.maximum = NSTEPS * maximum;
@@ -348,6 +516,18 @@ shearwater_petrel_device_foreach (dc_device_t *abstract, dc_dive_callback_t call
 	return rc;
 }
 
+static dc_status_t
+shearwater_petrel_device_foreach (dc_device_t *abstract, dc_dive_callback_t callback, void *userdata)
+{
+	return shearwater_petrel_device_download (abstract, callback, userdata, 0);
+}
+
+static dc_status_t
+shearwater_petrel_device_foreach_header (dc_device_t *abstract, dc_dive_callback_t callback, void *userdata)
+{
+	return shearwater_petrel_device_download (abstract, callback, userdata, 1);
+}
+
 static dc_status_t
 shearwater_petrel_device_timesync (dc_device_t *abstract, const dc_datetime_t *datetime)
 {
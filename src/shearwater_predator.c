@@ -51,16 +51,15 @@ static const dc_device_vtable_t shearwater_predator_device_vtable = {
 	DC_FAMILY_SHEARWATER_PREDATOR,
 	shearwater_predator_device_set_fingerprint, /* set_fingerprint */
 	NULL, /* read */
+	NULL, /* read_range */
 	NULL, /* write */
 	shearwater_predator_device_dump, /* dump */
 	shearwater_predator_device_foreach, /* foreach */
+	NULL, /* foreach_header */
 	shearwater_predator_device_timesync,
 	NULL /* close */
 };
 
-static dc_status_t
-shearwater_predator_extract_dives (dc_device_t *device, const unsigned char data[], unsigned int size, dc_dive_callback_t callback, void *userdata);
-
 dc_status_t
 shearwater_predator_device_open (dc_device_t **out, dc_context_t *context, dc_iostream_t *iostream)
 {
@@ -151,7 +150,7 @@ shearwater_predator_device_dump (dc_device_t *abstract, dc_buffer_t *buffer)
 static dc_status_t
 shearwater_predator_device_foreach (dc_device_t *abstract, dc_dive_callback_t callback, void *userdata)
 {
-	dc_buffer_t *buffer = dc_buffer_new (SZ_MEMORY);
+	dc_buffer_t *buffer = dc_buffer_new_context (abstract->context, SZ_MEMORY);
 	if (buffer == NULL)
 		return DC_STATUS_NOMEMORY;
 
@@ -341,7 +340,7 @@ shearwater_predator_extract_petrel (dc_device_t *abstract, const unsigned char d
 }
 
 
-static dc_status_t
+dc_status_t
 shearwater_predator_extract_dives (dc_device_t *abstract, const unsigned char data[], unsigned int size, dc_dive_callback_t callback, void *userdata)
 {
 	if (abstract && !ISINSTANCE (abstract))
@@ -140,9 +140,14 @@ struct shearwater_predator_parser_t {
 	unsigned int opening[NRECORDS];
 	unsigned int closing[NRECORDS];
 	unsigned int final;
+	// Offsets of the records with sample data.
+	unsigned int *records;
+	unsigned int nrecords;
+	unsigned int capacity;
 	unsigned int ngasmixes;
 	unsigned int ntanks;
 	shearwater_predator_gasmix_t gasmix[NGASMIXES];
+	dc_gasmix_map_t gasmap;
 	shearwater_predator_tank_t tank[NTANKS];
 	unsigned int tankidx[NTANKS];
 	unsigned int aimode;
@@ -164,6 +169,8 @@ static dc_status_t shearwater_predator_parser_get_field (dc_parser_t *abstract,
 static dc_status_t shearwater_predator_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_t callback, void *userdata);
 
 static dc_status_t shearwater_predator_parser_cache (shearwater_predator_parser_t *parser);
+static dc_status_t shearwater_predator_parser_reset (dc_parser_t *abstract);
+static dc_status_t shearwater_predator_parser_destroy (dc_parser_t *abstract);
 
 static const dc_parser_vtable_t shearwater_predator_parser_vtable = {
 	sizeof(shearwater_predator_parser_t),
@@ -173,8 +180,14 @@ static const dc_parser_vtable_t shearwater_predator_parser_vtable = {
 	NULL, /* set_density */
 	shearwater_predator_parser_get_datetime, /* datetime */
 	shearwater_predator_parser_get_field, /* fields */
+	NULL, /* summary */
 	shearwater_predator_parser_samples_foreach, /* samples_foreach */
-	NULL /* destroy */
+	NULL, /* samples_batch */
+	NULL, /* samples_fixed */
+	NULL, /* samples_append */
+	NULL, /* samples_range */
+	shearwater_predator_parser_reset, /* reset */
+	shearwater_predator_parser_destroy /* destroy */
 };
 
 static const dc_parser_vtable_t shearwater_petrel_parser_vtable = {
@@ -185,8 +198,14 @@ static const dc_parser_vtable_t shearwater_petrel_parser_vtable = {
 	NULL, /* set_density */
 	shearwater_predator_parser_get_datetime, /* datetime */
 	shearwater_predator_parser_get_field, /* fields */
+	NULL, /* summary */
 	shearwater_predator_parser_samples_foreach, /* samples_foreach */
-	NULL /* destroy */
+	NULL, /* samples_batch */
+	NULL, /* samples_fixed */
+	NULL, /* samples_append */
+	NULL, /* samples_range */
+	shearwater_predator_parser_reset, /* reset */
+	shearwater_predator_parser_destroy /* destroy */
 };
 
 
@@ -199,14 +218,7 @@ shearwater_predator_is_ccr (unsigned int divemode)
 static unsigned int
 shearwater_predator_find_gasmix (shearwater_predator_parser_t *parser, unsigned int o2, unsigned int he, unsigned int dil)
 {
-	unsigned int i = 0;
-	while (i < parser->ngasmixes) {
-		if (o2 == parser->gasmix[i].oxygen && he == parser->gasmix[i].helium && dil == parser->gasmix[i].diluent)
-			break;
-		i++;
-	}
-
-	return i;
+	return dc_gasmix_map_find (&parser->gasmap, o2, he, dil);
 }
 
 
@@ -240,8 +252,24 @@ shearwater_common_parser_create (dc_parser_t **out, dc_context_t *context, const
 	parser->petrel = petrel;
 	parser->samplesize = samplesize;
 	parser->serial = serial;
+	parser->records = NULL;
+	parser->capacity = 0;
+	dc_field_init (&parser->cache, context);
+
+	// Reset the per-dive state.
+	shearwater_predator_parser_reset ((dc_parser_t *) parser);
+
+	*out = (dc_parser_t *) parser;
+
+	return DC_STATUS_SUCCESS;
+}
+
+
+static dc_status_t
+shearwater_predator_parser_reset (dc_parser_t *abstract)
+{
+	shearwater_predator_parser_t *parser = (shearwater_predator_parser_t *) abstract;
 
-	// Set the default values.
 	parser->cached = 0;
 	parser->pnf = 0;
 	parser->logversion = 0;
@@ -252,6 +280,7 @@ shearwater_common_parser_create (dc_parser_t **out, dc_context_t *context, const
 		parser->closing[i] = UNDEFINED;
 	}
 	parser->final = UNDEFINED;
+	parser->nrecords = 0;
 	parser->ngasmixes = 0;
 	for (unsigned int i = 0; i < NGASMIXES; ++i) {
 		parser->gasmix[i].oxygen = 0;
@@ -260,6 +289,7 @@ shearwater_common_parser_create (dc_parser_t **out, dc_context_t *context, const
 		parser->gasmix[i].enabled = 0;
 		parser->gasmix[i].active = 0;
 	}
+	dc_gasmix_map_clear (&parser->gasmap);
 	parser->ntanks = 0;
 	for (unsigned int i = 0; i < NTANKS; ++i) {
 		parser->tank[i].enabled = 0;
@@ -284,9 +314,20 @@ shearwater_common_parser_create (dc_parser_t **out, dc_context_t *context, const
 	parser->density = DEF_DENSITY_SALT;
 	parser->atmospheric = DEF_ATMOSPHERIC / (BAR / 1000);
 
+	dc_field_clear (&parser->cache);
 	DC_ASSIGN_FIELD(parser->cache, DIVEMODE, DC_DIVEMODE_OC);
 
-	*out = (dc_parser_t *) parser;
+	return DC_STATUS_SUCCESS;
+}
+
+
+static dc_status_t
+shearwater_predator_parser_destroy (dc_parser_t *abstract)
+{
+	shearwater_predator_parser_t *parser = (shearwater_predator_parser_t *) abstract;
+
+	free (parser->records);
+	dc_field_free (&parser->cache);
 
 	return DC_STATUS_SUCCESS;
 }
@@ -423,7 +464,7 @@ shearwater_predator_parser_cache (shearwater_predator_parser_t *parser)
 	if (parser->cached) {
 		return DC_STATUS_SUCCESS;
 	}
-	memset(&parser->cache, 0, sizeof(parser->cache));
+	dc_field_clear(&parser->cache);
 
 	// Log versions before 6 weren't reliably stored in the data, but
 	// 6 is also the oldest version that we assume in our code
@@ -497,6 +538,22 @@ shearwater_predator_parser_cache (shearwater_predator_parser_t *parser)
 
 	unsigned int offset = headersize;
 	unsigned int length = size - footersize;
+
+	// Allocate the index of the sample records. The buffer is kept
+	// for the next dive after a reset.
+	unsigned int maxrecords = (length - headersize) / parser->samplesize;
+	if (maxrecords > parser->capacity) {
+		unsigned int *records = (unsigned int *) realloc (parser->records, maxrecords * sizeof (unsigned int));
+		if (records == NULL) {
+			ERROR (abstract->context, "Failed to allocate memory.");
+			return DC_STATUS_NOMEMORY;
+		}
+		parser->records = records;
+		parser->capacity = maxrecords;
+	}
+	parser->nrecords = 0;
+
+	unsigned int end = 0;
 	while (offset + parser->samplesize <= length) {
 		// Ignore empty samples.
 		if (array_isequal (data + offset, parser->samplesize, 0x00)) {
@@ -507,6 +564,17 @@ shearwater_predator_parser_cache (shearwater_predator_parser_t *parser)
 		// Get the record type.
 		unsigned int type = pnf ? data[offset] : LOG_RECORD_DIVE_SAMPLE;
 
+		// Add the records with sample data to the index, up to the
+		// end block.
+		if (type == LOG_RECORD_FINAL && data[offset + 1] == 0xFD)
+			end = 1;
+		if (!end && (type == LOG_RECORD_DIVE_SAMPLE ||
+			type == LOG_RECORD_DIVE_SAMPLE_EXT ||
+			type == LOG_RECORD_FREEDIVE_SAMPLE ||
+			type == LOG_RECORD_INFO_EVENT)) {
+			parser->records[parser->nrecords++] = offset;
+		}
+
 		if (type == LOG_RECORD_DIVE_SAMPLE) {
 			// Status flags.
 			unsigned int status = data[offset + 11 + pnf];
@@ -787,6 +855,7 @@ shearwater_predator_parser_cache (shearwater_predator_parser_t *parser)
 	parser->headersize = headersize;
 	parser->footersize = footersize;
 	parser->ngasmixes = 0;
+	dc_gasmix_map_clear (&parser->gasmap);
 	if (divemode != M_FREEDIVE) {
 		for (unsigned int i = 0; i < ngasmixes; ++i) {
 			if (gasmix[i].oxygen == 0 && gasmix[i].helium == 0)
@@ -796,6 +865,7 @@ shearwater_predator_parser_cache (shearwater_predator_parser_t *parser)
 			if (gasmix[i].diluent && !shearwater_predator_is_ccr (divemode))
 				continue;
 			parser->gasmix[parser->ngasmixes] = gasmix[i];
+			dc_gasmix_map_insert (&parser->gasmap, gasmix[i].oxygen, gasmix[i].helium, gasmix[i].diluent, parser->ngasmixes);
 			parser->ngasmixes++;
 		}
 	}
@@ -947,6 +1017,19 @@ shearwater_predator_parser_get_field (dc_parser_t *abstract, dc_field_type_t typ
 			break;
 		case DC_FIELD_STRING:
 			return dc_field_get_string(&parser->cache, flags, string);
+		case DC_FIELD_SAMPLE_COUNT:
+			if (flags != DC_SAMPLE_TIME && flags != DC_SAMPLE_DEPTH)
+				return DC_STATUS_UNSUPPORTED;
+			// A freedive record packs up to 4 samples.
+			*((unsigned int *) value) = 0;
+			for (unsigned int i = 0; i < parser->nrecords; ++i) {
+				unsigned int record = parser->pnf ? data[parser->records[i]] : LOG_RECORD_DIVE_SAMPLE;
+				if (record == LOG_RECORD_DIVE_SAMPLE)
+					*((unsigned int *) value) += 1;
+				else if (record == LOG_RECORD_FREEDIVE_SAMPLE)
+					*((unsigned int *) value) += 4;
+			}
+			break;
 		default:
 			return DC_STATUS_UNSUPPORTED;
 		}
@@ -962,7 +1045,6 @@ shearwater_predator_parser_samples_foreach (dc_parser_t *abstract, dc_sample_cal
 	shearwater_predator_parser_t *parser = (shearwater_predator_parser_t *) abstract;
 
 	const unsigned char *data = abstract->data;
-	unsigned int size = abstract->size;
 
 	// Cache the parser data.
 	dc_status_t rc = shearwater_predator_parser_cache (parser);
@@ -979,25 +1061,20 @@ shearwater_predator_parser_samples_foreach (dc_parser_t *abstract, dc_sample_cal
 		interval = array_uint16_be (data + parser->opening[5] + 23);
 	}
 
+	// Walk the sample records from the index, which excludes the empty
+	// records, the header and footer records, and everything after the
+	// end block.
 	unsigned int pnf = parser->pnf;
-	unsigned int offset = parser->headersize;
-	unsigned int length = size - parser->footersize;
-	while (offset + parser->samplesize <= length) {
+	for (unsigned int i = 0; i < parser->nrecords; ++i) {
 		dc_sample_value_t sample = {0};
+		unsigned int offset = parser->records[i];
 
-		// Ignore empty samples.
-		if (array_isequal (data + offset, parser->samplesize, 0x00)) {
-			offset += parser->samplesize;
-			continue;
-		}
+		if (dc_parser_stopped (parser, callback))
+			break;
 
 		// Get the record type.
 		unsigned int type = pnf ? data[offset] : LOG_RECORD_DIVE_SAMPLE;
 
-		// stop parsing if we see the end block
-		if (type == LOG_RECORD_FINAL && data[offset + 1] == 0xFD)
-			break;
-
 		if (type == LOG_RECORD_DIVE_SAMPLE) {
 			// Time (seconds).
 			time += interval;
@@ -1215,8 +1292,6 @@ shearwater_predator_parser_samples_foreach (dc_parser_t *abstract, dc_sample_cal
 				if (callback) callback (DC_SAMPLE_EVENT, &sample, userdata);
 			}
 		}
-
-		offset += parser->samplesize;
 	}
 
 	return DC_STATUS_SUCCESS;
@@ -0,0 +1,413 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2026 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h> // malloc, free
+#include <string.h> // memcpy, memmove, memset
+
+#include <libdivecomputer/simulator.h>
+#include <libdivecomputer/buffer.h>
+
+#include "iostream-private.h"
+#include "common-private.h"
+#include "context-private.h"
+#include "platform.h"
+#include "checksum.h"
+#include "array.h"
+
+#define SZ_INPUT 64
+
+typedef struct dc_simulator_t dc_simulator_t;
+
+/*
+ * Handle the command at the start of the input, and queue the response.
+ * Returns the number of bytes consumed, or zero if the command is not
+ * complete yet.
+ */
+typedef size_t (*dc_simulator_func_t) (dc_simulator_t *simulator, const unsigned char data[], size_t size);
+
+typedef struct dc_simulator_protocol_t {
+	dc_family_t family;
+	dc_transport_t transport;
+	dc_simulator_func_t command;
+} dc_simulator_protocol_t;
+
+static dc_status_t dc_simulator_set_timeout (dc_iostream_t *abstract, int timeout);
+static dc_status_t dc_simulator_get_available (dc_iostream_t *abstract, size_t *value);
+static dc_status_t dc_simulator_read (dc_iostream_t *abstract, void *data, size_t size, size_t *actual);
+static dc_status_t dc_simulator_write (dc_iostream_t *abstract, const void *data, size_t size, size_t *actual);
+static dc_status_t dc_simulator_purge (dc_iostream_t *abstract, dc_direction_t direction);
+static dc_status_t dc_simulator_sleep (dc_iostream_t *abstract, unsigned int milliseconds);
+static dc_status_t dc_simulator_close (dc_iostream_t *abstract);
+
+static size_t dc_simulator_oceanic_atom2 (dc_simulator_t *simulator, const unsigned char data[], size_t size);
+
+struct dc_simulator_t {
+	/* Base class. */
+	dc_iostream_t base;
+	/* Internal state. */
+	dc_context_t *context;
+	const dc_simulator_protocol_t *protocol;
+	dc_buffer_t *image;
+	int timeout;
+	/* Link parameters. */
+	unsigned int latency;
+	unsigned int bandwidth;
+	/* Pending delay (microseconds). */
+	unsigned long long delay;
+	/* Received command bytes. */
+	unsigned char input[SZ_INPUT];
+	size_t ninput;
+	/* Queued response bytes. */
+	dc_buffer_t *output;
+	size_t offset;
+};
+
+static const dc_iostream_vtable_t dc_simulator_vtable = {
+	sizeof(dc_simulator_t),
+	dc_simulator_set_timeout, /* set_timeout */
+	NULL, /* set_break */
+	NULL, /* set_dtr */
+	NULL, /* set_rts */
+	NULL, /* get_lines */
+	dc_simulator_get_available, /* get_available */
+	NULL, /* configure */
+	NULL, /* poll */
+	dc_simulator_read, /* read */
+	dc_simulator_write, /* write */
+	NULL, /* read_async */
+	NULL, /* write_async */
+	NULL, /* writev */
+	NULL, /* ioctl */
+	NULL, /* flush */
+	dc_simulator_purge, /* purge */
+	dc_simulator_sleep, /* sleep */
+	NULL, /* set_interrupt */
+	dc_simulator_close, /* close */
+};
+
+static const dc_simulator_protocol_t g_protocols[] = {
+	{DC_FAMILY_OCEANIC_ATOM2, DC_TRANSPORT_SERIAL, dc_simulator_oceanic_atom2},
+};
+
+static int
+dc_simulator_realtime (dc_simulator_t *simulator)
+{
+	return simulator->latency || simulator->bandwidth;
+}
+
+/*
+ * Queue a response, and account for the time it takes on the link.
+ */
+static void
+dc_simulator_respond (dc_simulator_t *simulator, const unsigned char data[], size_t size)
+{
+	if (!dc_buffer_append (simulator->output, data, size)) {
+		ERROR (simulator->context, "Insufficient buffer space available.");
+		return;
+	}
+
+	simulator->delay += simulator->latency * 1000ULL;
+	if (simulator->bandwidth)
+		simulator->delay += size * 1000000ULL / simulator->bandwidth;
+}
+
+/*
+ * Copy a block of the memory image. Addresses outside the image read
+ * as erased memory.
+ */
+static void
+dc_simulator_memory (dc_simulator_t *simulator, size_t offset, unsigned char data[], size_t size)
+{
+	const unsigned char *image = dc_buffer_get_data (simulator->image);
+	size_t length = dc_buffer_get_size (simulator->image);
+
+	memset (data, 0xFF, size);
+	if (offset < length) {
+		size_t n = length - offset < size ? length - offset : size;
+		memcpy (data, image + offset, n);
+	}
+}
+
+dc_status_t
+dc_simulator_open (dc_iostream_t **out, dc_context_t *context, dc_descriptor_t *descriptor, const unsigned char data[], size_t size, unsigned int latency, unsigned int bandwidth)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	dc_simulator_t *simulator = NULL;
+
+	if (out == NULL || descriptor == NULL || (data == NULL && size))
+		return DC_STATUS_INVALIDARGS;
+
+	const dc_simulator_protocol_t *protocol = NULL;
+	for (unsigned int i = 0; i < C_ARRAY_SIZE (g_protocols); ++i) {
+		if (g_protocols[i].family == dc_descriptor_get_type (descriptor)) {
+			protocol = g_protocols + i;
+			break;
+		}
+	}
+
+	if (protocol == NULL) {
+		ERROR (context, "No simulator available for the %s %s.",
+			dc_descriptor_get_vendor (descriptor), dc_descriptor_get_product (descriptor));
+		return DC_STATUS_UNSUPPORTED;
+	}
+
+	// Allocate memory.
+	simulator = (dc_simulator_t *) dc_iostream_allocate (context, &dc_simulator_vtable, protocol->transport);
+	if (simulator == NULL) {
+		ERROR (context, "Failed to allocate memory.");
+		return DC_STATUS_NOMEMORY;
+	}
+
+	simulator->context = context;
+	simulator->protocol = protocol;
+	simulator->timeout = -1;
+	simulator->latency = latency;
+	simulator->bandwidth = bandwidth;
+	simulator->delay = 0;
+	simulator->ninput = 0;
+	simulator->offset = 0;
+	simulator->image = dc_buffer_new_context (context, size);
+	simulator->output = dc_buffer_new_context (context, 0);
+	if (simulator->image == NULL || simulator->output == NULL ||
+		!dc_buffer_append (simulator->image, data, size)) {
+		ERROR (context, "Failed to allocate memory.");
+		status = DC_STATUS_NOMEMORY;
+		goto error_free;
+	}
+
+	*out = (dc_iostream_t *) simulator;
+
+	return DC_STATUS_SUCCESS;
+
+error_free:
+	dc_simulator_close ((dc_iostream_t *) simulator);
+	dc_iostream_deallocate ((dc_iostream_t *) simulator);
+	return status;
+}
+
+static dc_status_t
+dc_simulator_set_timeout (dc_iostream_t *abstract, int timeout)
+{
+	dc_simulator_t *simulator = (dc_simulator_t *) abstract;
+
+	simulator->timeout = timeout;
+
+	return DC_STATUS_SUCCESS;
+}
+
+static dc_status_t
+dc_simulator_get_available (dc_iostream_t *abstract, size_t *value)
+{
+	dc_simulator_t *simulator = (dc_simulator_t *) abstract;
+
+	*value = dc_buffer_get_size (simulator->output) - simulator->offset;
+
+	return DC_STATUS_SUCCESS;
+}
+
+static dc_status_t
+dc_simulator_read (dc_iostream_t *abstract, void *data, size_t size, size_t *actual)
+{
+	dc_simulator_t *simulator = (dc_simulator_t *) abstract;
+
+	size_t available = dc_buffer_get_size (simulator->output) - simulator->offset;
+	if (available == 0) {
+		// Nothing to answer, so the read times out.
+		if (dc_simulator_realtime (simulator) && simulator->timeout > 0)
+			dc_platform_sleep (simulator->timeout);
+		*actual = 0;
+		return DC_STATUS_TIMEOUT;
+	}
+
+	// Wait until the response has crossed the link. Short delays are
+	// accumulated, because the sleep function only has millisecond
+	// resolution.
+	if (simulator->delay >= 1000) {
+		dc_platform_sleep (simulator->delay / 1000);
+		simulator->delay %= 1000;
+	}
+
+	size_t nbytes = available < size ? available : size;
+	memcpy (data, dc_buffer_get_data (simulator->output) + simulator->offset, nbytes);
+	simulator->offset += nbytes;
+
+	if (simulator->offset == dc_buffer_get_size (simulator->output)) {
+		dc_buffer_clear (simulator->output);
+		simulator->offset = 0;
+	}
+
+	*actual = nbytes;
+
+	return DC_STATUS_SUCCESS;
+}
+
+static dc_status_t
+dc_simulator_write (dc_iostream_t *abstract, const void *data, size_t size, size_t *actual)
+{
+	dc_simulator_t *simulator = (dc_simulator_t *) abstract;
+	const unsigned char *p = (const unsigned char *) data;
+
+	size_t nbytes = 0;
+	while (nbytes < size) {
+		size_t length = SZ_INPUT - simulator->ninput;
+		if (length > size - nbytes)
+			length = size - nbytes;
+
+		memcpy (simulator->input + simulator->ninput, p + nbytes, length);
+		simulator->ninput += length;
+		nbytes += length;
+
+		// Handle all complete commands.
+		while (simulator->ninput) {
+			size_t n = simulator->protocol->command (simulator, simulator->input, simulator->ninput);
+			if (n == 0)
+				break;
+
+			memmove (simulator->input, simulator->input + n, simulator->ninput - n);
+			simulator->ninput -= n;
+		}
+
+		// Discard a command that doesn't fit.
+		if (simulator->ninput == SZ_INPUT) {
+			WARNING (simulator->context, "Discarding an unknown command.");
+			simulator->ninput = 0;
+		}
+	}
+
+	if (simulator->bandwidth)
+		simulator->delay += size * 1000000ULL / simulator->bandwidth;
+
+	*actual = size;
+
+	return DC_STATUS_SUCCESS;
+}
+
+static dc_status_t
+dc_simulator_purge (dc_iostream_t *abstract, dc_direction_t direction)
+{
+	dc_simulator_t *simulator = (dc_simulator_t *) abstract;
+
+	if (direction & DC_DIRECTION_INPUT) {
+		dc_buffer_clear (simulator->output);
+		simulator->offset = 0;
+	}
+
+	if (direction & DC_DIRECTION_OUTPUT) {
+		simulator->ninput = 0;
+	}
+
+	return DC_STATUS_SUCCESS;
+}
+
+static dc_status_t
+dc_simulator_sleep (dc_iostream_t *abstract, unsigned int milliseconds)
+{
+	dc_simulator_t *simulator = (dc_simulator_t *) abstract;
+
+	if (dc_simulator_realtime (simulator))
+		dc_platform_sleep (milliseconds);
+
+	return DC_STATUS_SUCCESS;
+}
+
+static dc_status_t
+dc_simulator_close (dc_iostream_t *abstract)
+{
+	dc_simulator_t *simulator = (dc_simulator_t *) abstract;
+
+	dc_buffer_free (simulator->output);
+	dc_buffer_free (simulator->image);
+
+	return DC_STATUS_SUCCESS;
+}
+
+/*
+ * Oceanic Atom 2
+ *
+ * Every command is answered with an ACK byte, followed by the data and
+ * its checksum for the read commands. The memory is addressed in pages
+ * of 16 bytes. Commands that are not supported, like writing or the high
+ * memory area, are answered with a NAK byte.
+ */
+#define ATOM2_ACK      0x5A
+#define ATOM2_NAK      0xA5
+#define ATOM2_PAGESIZE 16
+#define ATOM2_VERSION  16
+
+static size_t
+dc_simulator_oceanic_atom2 (dc_simulator_t *simulator, const unsigned char data[], size_t size)
+{
+	unsigned char answer[1 + 16 * ATOM2_PAGESIZE + 2] = {ATOM2_ACK};
+	unsigned int npages = 0, crc_size = 1;
+
+	switch (data[0]) {
+	case 0x84: /* Version */
+		dc_simulator_memory (simulator, 0, answer + 1, ATOM2_VERSION);
+		answer[1 + ATOM2_VERSION] = checksum_add_uint8 (answer + 1, ATOM2_VERSION, 0x00);
+		dc_simulator_respond (simulator, answer, 1 + ATOM2_VERSION + 1);
+		return 1;
+	case 0xB1: /* Read 1 page */
+		npages = 1;
+		break;
+	case 0xB4: /* Read 8 pages */
+		npages = 8;
+		break;
+	case 0xB8: /* Read 16 pages */
+		npages = 16;
+		crc_size = 2;
+		break;
+	case 0x91: /* Keepalive */
+		if (size < 3)
+			return 0;
+		dc_simulator_respond (simulator, answer, 1);
+		return 3;
+	case 0x6A: /* Quit */
+		if (size < 4)
+			return 0;
+		answer[0] = ATOM2_NAK;
+		dc_simulator_respond (simulator, answer, 1);
+		return 4;
+	default:
+		answer[0] = ATOM2_NAK;
+		dc_simulator_respond (simulator, answer, 1);
+		return size;
+	}
+
+	if (size < 3)
+		return 0;
+
+	unsigned int number = array_uint16_be (data + 1);
+	unsigned int length = npages * ATOM2_PAGESIZE;
+	dc_simulator_memory (simulator, ATOM2_VERSION + (size_t) number * ATOM2_PAGESIZE, answer + 1, length);
+	if (crc_size == 2) {
+		array_uint16_le_set (answer + 1 + length, checksum_add_uint16 (answer + 1, length, 0x0000));
+	} else {
+		answer[1 + length] = checksum_add_uint8 (answer + 1, length, 0x00);
+	}
+	dc_simulator_respond (simulator, answer, 1 + length + crc_size);
+
+	return 3;
+}
@@ -19,8 +19,21 @@
  * MA 02110-1301 USA
  */
 
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <poll.h>
+#endif
+
 #include "socket.h"
 #include "platform.h"
+#include "thread.h"
 
 #include "common-private.h"
 #include "context-private.h"
@@ -29,6 +42,38 @@
 #define MSG_NOSIGNAL 0
 #endif
 
+#ifndef MSG_DONTWAIT
+#define MSG_DONTWAIT 0
+#endif
+
+#ifdef _WIN32
+typedef WSAPOLLFD s_pollfd_t;
+#define S_POLL WSAPoll
+#else
+typedef struct pollfd s_pollfd_t;
+#define S_POLL poll
+#endif
+
+// Initial number of entries in the poll set of the reactor.
+#define NFDS 8
+
+typedef struct dc_socket_reactor_t {
+	dc_thread_t *thread;
+	dc_socket_t *sockets;
+	unsigned int count;
+	unsigned int generation;
+	int running;
+	/* Wakes the thread up from the poll call. On Windows, a UDP
+	 * socket connected to itself, and a pipe elsewhere. */
+	s_socket_t wakeup[2];
+	s_pollfd_t *fds;
+	dc_socket_t **owners;
+	size_t capacity;
+} dc_socket_reactor_t;
+
+static dc_mutex_t g_mutex = DC_MUTEX_INIT;
+static dc_socket_reactor_t *g_reactor = NULL;
+
 dc_status_t
 dc_socket_syserror (s_errcode_t errcode)
 {
@@ -87,6 +132,370 @@ dc_socket_exit (dc_context_t *context)
 	return DC_STATUS_SUCCESS;
 }
 
+static int
+dc_socket_wakeup_new (s_socket_t wakeup[2])
+{
+#ifdef _WIN32
+	struct sockaddr_in addr;
+	int addrlen = sizeof (addr);
+
+	wakeup[0] = wakeup[1] = socket (AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	if (wakeup[0] == S_INVALID)
+		return -1;
+
+	// Bind to a free port on the loopback interface, and connect the
+	// socket to itself.
+	memset (&addr, 0, sizeof (addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+	addr.sin_port = 0;
+
+	u_long nonblocking = 1;
+	if (bind (wakeup[0], (struct sockaddr *) &addr, sizeof (addr)) != 0 ||
+		getsockname (wakeup[0], (struct sockaddr *) &addr, &addrlen) != 0 ||
+		connect (wakeup[0], (struct sockaddr *) &addr, addrlen) != 0 ||
+		ioctlsocket (wakeup[0], FIONBIO, &nonblocking) != 0) {
+		closesocket (wakeup[0]);
+		return -1;
+	}
+#else
+	if (pipe (wakeup) != 0)
+		return -1;
+
+	for (unsigned int i = 0; i < 2; ++i) {
+		int flags = fcntl (wakeup[i], F_GETFL);
+		if (flags < 0 || fcntl (wakeup[i], F_SETFL, flags | O_NONBLOCK) != 0) {
+			close (wakeup[0]);
+			close (wakeup[1]);
+			return -1;
+		}
+	}
+#endif
+
+	return 0;
+}
+
+static void
+dc_socket_wakeup_free (s_socket_t wakeup[2])
+{
+	S_CLOSE (wakeup[0]);
+	if (wakeup[1] != wakeup[0])
+		S_CLOSE (wakeup[1]);
+}
+
+static void
+dc_socket_wakeup_signal (s_socket_t wakeup[2])
+{
+	// If the buffer is full, the thread is already woken up.
+	char c = 0;
+#ifdef _WIN32
+	send (wakeup[1], &c, 1, 0);
+#else
+	if (write (wakeup[1], &c, 1) < 0) {
+		// The pipe is full, so the thread is awake already.
+	}
+#endif
+}
+
+static void
+dc_socket_wakeup_drain (s_socket_t wakeup[2])
+{
+	char buffer[64];
+#ifdef _WIN32
+	while (recv (wakeup[0], buffer, sizeof (buffer), 0) > 0)
+		;
+#else
+	while (read (wakeup[0], buffer, sizeof (buffer)) > 0)
+		;
+#endif
+}
+
+/*
+ * Take the first request of a queue, and hand it back to the event loop.
+ */
+static void
+dc_socket_complete (dc_iostream_request_t **queue, dc_status_t status)
+{
+	dc_iostream_request_t *request = *queue;
+	*queue = request->next;
+	dc_iostream_request_complete (request, status);
+}
+
+static void
+dc_socket_service (dc_socket_t *socket, short revents)
+{
+	if (revents & POLLNVAL) {
+		while (socket->input)
+			dc_socket_complete (&socket->input, DC_STATUS_IO);
+		while (socket->output)
+			dc_socket_complete (&socket->output, DC_STATUS_IO);
+		return;
+	}
+
+	if (socket->input && (revents & (POLLIN | POLLHUP | POLLERR))) {
+		dc_iostream_request_t *request = socket->input;
+		s_ssize_t n = recv (socket->fd, (char *) request->data + request->actual, request->size - request->actual, 0);
+		if (n < 0) {
+			s_errcode_t errcode = S_ERRNO;
+			if (errcode != S_EINTR && errcode != S_EAGAIN)
+				dc_socket_complete (&socket->input, dc_socket_syserror (errcode));
+		} else if (n == 0) {
+			// End of file, reported as a timeout like a
+			// synchronous read.
+			dc_socket_complete (&socket->input, DC_STATUS_TIMEOUT);
+		} else {
+			// Return the data that is available, like the requests
+			// emulated by the event loop.
+			request->actual += n;
+			dc_socket_complete (&socket->input, DC_STATUS_SUCCESS);
+		}
+	}
+
+	if (socket->output && (revents & (POLLOUT | POLLHUP | POLLERR))) {
+		dc_iostream_request_t *request = socket->output;
+		s_ssize_t n = send (socket->fd, (const char *) request->data + request->actual, request->size - request->actual, MSG_NOSIGNAL | MSG_DONTWAIT);
+		if (n < 0) {
+			s_errcode_t errcode = S_ERRNO;
+			if (errcode != S_EINTR && errcode != S_EAGAIN)
+				dc_socket_complete (&socket->output, dc_socket_syserror (errcode));
+		} else if (n == 0) {
+			dc_socket_complete (&socket->output, DC_STATUS_TIMEOUT);
+		} else {
+			request->actual += n;
+			if (request->actual == request->size)
+				dc_socket_complete (&socket->output, DC_STATUS_SUCCESS);
+		}
+	}
+}
+
+static void
+dc_socket_reactor_run (void *userdata)
+{
+	dc_socket_reactor_t *reactor = (dc_socket_reactor_t *) userdata;
+
+	dc_mutex_lock (&g_mutex);
+
+	while (reactor->running) {
+		// Grow the poll set if necessary. If that fails, the
+		// remaining sockets are serviced once there is room again.
+		if (reactor->count + 1 > reactor->capacity) {
+			size_t capacity = reactor->count + 1;
+			s_pollfd_t *fds = (s_pollfd_t *) realloc (reactor->fds, capacity * sizeof (s_pollfd_t));
+			if (fds)
+				reactor->fds = fds;
+			dc_socket_t **owners = (dc_socket_t **) realloc (reactor->owners, capacity * sizeof (dc_socket_t *));
+			if (owners)
+				reactor->owners = owners;
+			if (fds && owners)
+				reactor->capacity = capacity;
+		}
+
+		// Build the poll set.
+		s_pollfd_t *fds = reactor->fds;
+		size_t nfds = 0;
+		fds[nfds].fd = reactor->wakeup[0];
+		fds[nfds].events = POLLIN;
+		fds[nfds].revents = 0;
+		nfds++;
+		for (dc_socket_t *s = reactor->sockets; s && nfds < reactor->capacity; s = s->next) {
+			short events = 0;
+			if (s->input)
+				events |= POLLIN;
+			if (s->output)
+				events |= POLLOUT;
+			if (events == 0)
+				continue;
+
+			fds[nfds].fd = s->fd;
+			fds[nfds].events = events;
+			fds[nfds].revents = 0;
+			reactor->owners[nfds] = s;
+			nfds++;
+		}
+
+		unsigned int generation = reactor->generation;
+
+		dc_mutex_unlock (&g_mutex);
+		int rc = S_POLL (fds, nfds, -1);
+		dc_mutex_lock (&g_mutex);
+
+		if (rc < 0) {
+			s_errcode_t errcode = S_ERRNO;
+			if (errcode == S_EINTR)
+				continue;
+
+			// Fail all outstanding requests, rather than spinning.
+			for (dc_socket_t *s = reactor->sockets; s; s = s->next)
+				dc_socket_service (s, POLLNVAL);
+			continue;
+		}
+
+		if (fds[0].revents)
+			dc_socket_wakeup_drain (reactor->wakeup);
+
+		// After the set of sockets or requests has changed, the
+		// results can refer to sockets that are already closed.
+		if (reactor->generation != generation)
+			continue;
+
+		for (size_t i = 1; i < nfds; ++i) {
+			if (fds[i].revents)
+				dc_socket_service (reactor->owners[i], fds[i].revents);
+		}
+	}
+
+	dc_mutex_unlock (&g_mutex);
+}
+
+/*
+ * Get the reactor, and start it if necessary. Called with the global
+ * mutex held.
+ */
+static dc_status_t
+dc_socket_reactor_get (dc_context_t *context, dc_socket_reactor_t **out)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	dc_socket_reactor_t *reactor = g_reactor;
+
+	if (reactor) {
+		*out = reactor;
+		return DC_STATUS_SUCCESS;
+	}
+
+	reactor = (dc_socket_reactor_t *) malloc (sizeof (dc_socket_reactor_t));
+	if (reactor == NULL) {
+		ERROR (context, "Failed to allocate memory.");
+		return DC_STATUS_NOMEMORY;
+	}
+
+	reactor->thread = NULL;
+	reactor->sockets = NULL;
+	reactor->count = 0;
+	reactor->generation = 0;
+	reactor->running = 1;
+	reactor->capacity = NFDS;
+	reactor->fds = (s_pollfd_t *) malloc (NFDS * sizeof (s_pollfd_t));
+	reactor->owners = (dc_socket_t **) malloc (NFDS * sizeof (dc_socket_t *));
+	if (reactor->fds == NULL || reactor->owners == NULL) {
+		ERROR (context, "Failed to allocate memory.");
+		status = DC_STATUS_NOMEMORY;
+		goto error_free;
+	}
+
+	if (dc_socket_wakeup_new (reactor->wakeup) != 0) {
+		s_errcode_t errcode = S_ERRNO;
+		SYSERROR (context, errcode);
+		status = dc_socket_syserror (errcode);
+		goto error_free;
+	}
+
+	// Without thread support, the requests are emulated by the event
+	// loop instead.
+	status = dc_thread_new (&reactor->thread, dc_socket_reactor_run, reactor);
+	if (status != DC_STATUS_SUCCESS) {
+		if (status != DC_STATUS_UNSUPPORTED)
+			ERROR (context, "Failed to start the reactor thread.");
+		goto error_wakeup_free;
+	}
+
+	g_reactor = reactor;
+	*out = reactor;
+
+	return DC_STATUS_SUCCESS;
+
+error_wakeup_free:
+	dc_socket_wakeup_free (reactor->wakeup);
+error_free:
+	free (reactor->owners);
+	free (reactor->fds);
+	free (reactor);
+	return status;
+}
+
+static dc_status_t
+dc_socket_submit (dc_iostream_t *abstract, dc_iostream_request_t *request)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	dc_socket_t *socket = (dc_socket_t *) abstract;
+	dc_socket_reactor_t *reactor = NULL;
+
+	dc_mutex_lock (&g_mutex);
+
+	status = dc_socket_reactor_get (abstract->context, &reactor);
+	if (status != DC_STATUS_SUCCESS)
+		goto out;
+
+	if (!socket->registered) {
+		socket->next = reactor->sockets;
+		reactor->sockets = socket;
+		reactor->count++;
+		socket->registered = 1;
+	}
+
+	// Append the request to the queue.
+	dc_iostream_request_t **link = request->direction == DC_DIRECTION_INPUT ?
+		&socket->input : &socket->output;
+	while (*link)
+		link = &(*link)->next;
+	request->next = NULL;
+	*link = request;
+
+	reactor->generation++;
+	dc_socket_wakeup_signal (reactor->wakeup);
+
+out:
+	dc_mutex_unlock (&g_mutex);
+	return status;
+}
+
+/*
+ * Remove the socket from the reactor, and cancel its outstanding
+ * requests. The reactor is stopped after the last socket is removed.
+ */
+static void
+dc_socket_unregister (dc_socket_t *socket)
+{
+	dc_socket_reactor_t *stopped = NULL;
+
+	dc_mutex_lock (&g_mutex);
+
+	if (socket->registered) {
+		dc_socket_reactor_t *reactor = g_reactor;
+
+		dc_socket_t **link = &reactor->sockets;
+		while (*link != socket)
+			link = &(*link)->next;
+		*link = socket->next;
+		reactor->count--;
+		reactor->generation++;
+		socket->next = NULL;
+		socket->registered = 0;
+
+		while (socket->input)
+			dc_socket_complete (&socket->input, DC_STATUS_CANCELLED);
+		while (socket->output)
+			dc_socket_complete (&socket->output, DC_STATUS_CANCELLED);
+
+		if (reactor->count == 0) {
+			reactor->running = 0;
+			g_reactor = NULL;
+			stopped = reactor;
+		}
+
+		dc_socket_wakeup_signal (reactor->wakeup);
+	}
+
+	dc_mutex_unlock (&g_mutex);
+
+	if (stopped) {
+		dc_thread_join (stopped->thread);
+		dc_socket_wakeup_free (stopped->wakeup);
+		free (stopped->owners);
+		free (stopped->fds);
+		free (stopped);
+	}
+}
+
 dc_status_t
 dc_socket_open (dc_iostream_t *abstract, int family, int type, int protocol)
 {
@@ -95,6 +504,10 @@ dc_socket_open (dc_iostream_t *abstract, int family, int type, int protocol)
 
 	// Default to blocking reads.
 	device->timeout = -1;
+	device->next = NULL;
+	device->input = NULL;
+	device->output = NULL;
+	device->registered = 0;
 
 	// Initialize the socket library.
 	status = dc_socket_init (abstract->context);
@@ -139,6 +552,9 @@ dc_socket_close (dc_iostream_t *abstract)
 	dc_socket_t *socket = (dc_socket_t *) abstract;
 	dc_status_t rc = DC_STATUS_SUCCESS;
 
+	// Remove the socket from the reactor.
+	dc_socket_unregister (socket);
+
 	// Terminate all send and receive operations.
 	shutdown (socket->fd, 0);
 
@@ -172,6 +588,43 @@ dc_socket_connect (dc_iostream_t *abstract, const struct sockaddr *addr, s_sockl
 	return DC_STATUS_SUCCESS;
 }
 
+/*
+ * Wait for, and accept, a single incoming connection. The listening
+ * socket is replaced with the connected socket.
+ */
+dc_status_t
+dc_socket_listen (dc_iostream_t *abstract, const struct sockaddr *addr, s_socklen_t addrlen)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	dc_socket_t *socket = (dc_socket_t *) abstract;
+
+	int optval = 1;
+	if (setsockopt (socket->fd, SOL_SOCKET, SO_REUSEADDR, (const char *) &optval, sizeof(optval)) != 0 ||
+		bind (socket->fd, addr, addrlen) != 0 ||
+		listen (socket->fd, 1) != 0) {
+		s_errcode_t errcode = S_ERRNO;
+		SYSERROR (abstract->context, errcode);
+		return dc_socket_syserror(errcode);
+	}
+
+	// Wait for the connection, without blocking a cancellation.
+	status = dc_socket_poll (abstract, -1);
+	if (status != DC_STATUS_SUCCESS)
+		return status;
+
+	s_socket_t fd = accept (socket->fd, NULL, NULL);
+	if (fd == S_INVALID) {
+		s_errcode_t errcode = S_ERRNO;
+		SYSERROR (abstract->context, errcode);
+		return dc_socket_syserror(errcode);
+	}
+
+	S_CLOSE (socket->fd);
+	socket->fd = fd;
+
+	return DC_STATUS_SUCCESS;
+}
+
 dc_status_t
 dc_socket_set_timeout (dc_iostream_t *abstract, int timeout)
 {
@@ -205,29 +658,59 @@ dc_socket_get_available (dc_iostream_t *abstract, size_t *value)
 	return DC_STATUS_SUCCESS;
 }
 
+/*
+ * Wait until the socket becomes readable, or the cancellation event is
+ * set. On Windows, the event can't be passed to select, and only the
+ * socket is waited on.
+ */
+static int
+dc_socket_select (dc_socket_t *socket, int timeout, int *cancelled)
+{
+	fd_set fds;
+	FD_ZERO (&fds);
+	FD_SET (socket->fd, &fds);
+
+	s_socket_t nfds = socket->fd;
+#ifndef _WIN32
+	int interrupt = dc_interrupt_fd (socket->base.interrupt);
+	if (interrupt >= 0) {
+		FD_SET (interrupt, &fds);
+		if (interrupt > nfds)
+			nfds = interrupt;
+	}
+#endif
+
+	struct timeval tv, *ptv = NULL;
+	if (timeout > 0) {
+		tv.tv_sec  = (timeout / 1000);
+		tv.tv_usec = (timeout % 1000) * 1000;
+		ptv = &tv;
+	} else if (timeout == 0) {
+		tv.tv_sec  = 0;
+		tv.tv_usec = 0;
+		ptv = &tv;
+	}
+
+	int rc = select (nfds + 1, &fds, NULL, NULL, ptv);
+
+#ifndef _WIN32
+	*cancelled = rc > 0 && interrupt >= 0 && FD_ISSET (interrupt, &fds);
+#else
+	*cancelled = 0;
+#endif
+
+	return rc;
+}
+
 dc_status_t
 dc_socket_poll (dc_iostream_t *abstract, int timeout)
 {
 	dc_socket_t *socket = (dc_socket_t *) abstract;
+	int cancelled = 0;
 	int rc = 0;
 
 	do {
-		fd_set fds;
-		FD_ZERO (&fds);
-		FD_SET (socket->fd, &fds);
-
-		struct timeval tv, *ptv = NULL;
-		if (timeout > 0) {
-			tv.tv_sec  = (timeout / 1000);
-			tv.tv_usec = (timeout % 1000) * 1000;
-			ptv = &tv;
-		} else if (timeout == 0) {
-			tv.tv_sec  = 0;
-			tv.tv_usec = 0;
-			ptv = &tv;
-		}
-
-		rc = select (socket->fd + 1, &fds, NULL, NULL, ptv);
+		rc = dc_socket_select (socket, timeout, &cancelled);
 	} while (rc < 0 && S_ERRNO == S_EINTR);
 
 	if (rc < 0) {
@@ -236,6 +719,8 @@ dc_socket_poll (dc_iostream_t *abstract, int timeout)
 		return dc_socket_syserror(errcode);
 	} else if (rc == 0) {
 		return DC_STATUS_TIMEOUT;
+	} else if (cancelled) {
+		return DC_STATUS_CANCELLED;
 	} else {
 		return DC_STATUS_SUCCESS;
 	}
@@ -249,19 +734,8 @@ dc_socket_read (dc_iostream_t *abstract, void *data, size_t size, size_t *actual
 	size_t nbytes = 0;
 
 	while (nbytes < size) {
-		fd_set fds;
-		FD_ZERO (&fds);
-		FD_SET (socket->fd, &fds);
-
-		struct timeval tvt;
-		if (socket->timeout > 0) {
-			tvt.tv_sec  = (socket->timeout / 1000);
-			tvt.tv_usec = (socket->timeout % 1000) * 1000;
-		} else if (socket->timeout == 0) {
-			timerclear (&tvt);
-		}
-
-		int rc = select (socket->fd + 1, &fds, NULL, NULL, socket->timeout >= 0 ? &tvt : NULL);
+		int cancelled = 0;
+		int rc = dc_socket_select (socket, socket->timeout, &cancelled);
 		if (rc < 0) {
 			s_errcode_t errcode = S_ERRNO;
 			if (errcode == S_EINTR)
@@ -271,6 +745,9 @@ dc_socket_read (dc_iostream_t *abstract, void *data, size_t size, size_t *actual
 			goto out;
 		} else if (rc == 0) {
 			break; // Timeout.
+		} else if (cancelled) {
+			status = DC_STATUS_CANCELLED;
+			goto out;
 		}
 
 		s_ssize_t n = recv (socket->fd, (char *) data + nbytes, size - nbytes, 0);
@@ -349,6 +826,18 @@ out:
 	return status;
 }
 
+dc_status_t
+dc_socket_read_async (dc_iostream_t *abstract, dc_iostream_request_t *request)
+{
+	return dc_socket_submit (abstract, request);
+}
+
+dc_status_t
+dc_socket_write_async (dc_iostream_t *abstract, dc_iostream_request_t *request)
+{
+	return dc_socket_submit (abstract, request);
+}
+
 dc_status_t
 dc_socket_ioctl (dc_iostream_t *abstract, unsigned int request, void *data, size_t size)
 {
@@ -358,6 +847,9 @@ dc_socket_ioctl (dc_iostream_t *abstract, unsigned int request, void *data, size
 dc_status_t
 dc_socket_sleep (dc_iostream_t *abstract, unsigned int timeout)
 {
+	if (abstract->interrupt)
+		return dc_interrupt_sleep (abstract->interrupt, timeout);
+
 	if (dc_platform_sleep (timeout) != 0) {
 		s_errcode_t errcode = S_ERRNO;
 		SYSERROR (abstract->context, errcode);
@@ -83,6 +83,11 @@ typedef struct dc_socket_t {
 	dc_iostream_t base;
 	s_socket_t fd;
 	int timeout;
+	/* Asynchronous requests, serviced by the shared reactor. */
+	struct dc_socket_t *next;
+	dc_iostream_request_t *input;
+	dc_iostream_request_t *output;
+	int registered;
 } dc_socket_t;
 
 dc_status_t
@@ -103,6 +108,9 @@ dc_socket_close (dc_iostream_t *iostream);
 dc_status_t
 dc_socket_connect (dc_iostream_t *iostream, const struct sockaddr *addr, s_socklen_t addrlen);
 
+dc_status_t
+dc_socket_listen (dc_iostream_t *iostream, const struct sockaddr *addr, s_socklen_t addrlen);
+
 dc_status_t
 dc_socket_set_timeout (dc_iostream_t *iostream, int timeout);
 
@@ -118,6 +126,16 @@ dc_socket_read (dc_iostream_t *iostream, void *data, size_t size, size_t *actual
 dc_status_t
 dc_socket_write (dc_iostream_t *iostream, const void *data, size_t size, size_t *actual);
 
+/*
+ * Asynchronous requests are handed to a reactor thread, which is shared
+ * by all sockets, and waits for all of them at once.
+ */
+dc_status_t
+dc_socket_read_async (dc_iostream_t *iostream, dc_iostream_request_t *request);
+
+dc_status_t
+dc_socket_write_async (dc_iostream_t *iostream, dc_iostream_request_t *request);
+
 dc_status_t
 dc_socket_ioctl (dc_iostream_t *iostream, unsigned int request, void *data, size_t size);
 
@@ -71,9 +71,11 @@ static const dc_device_vtable_t sporasub_sp2_device_vtable = {
 	DC_FAMILY_SPORASUB_SP2,
 	sporasub_sp2_device_set_fingerprint, /* set_fingerprint */
 	sporasub_sp2_device_read, /* read */
+	NULL, /* read_range */
 	NULL, /* write */
 	sporasub_sp2_device_dump, /* dump */
 	sporasub_sp2_device_foreach, /* foreach */
+	NULL, /* foreach_header */
 	sporasub_sp2_device_timesync, /* timesync */
 	NULL /* close */
 };
@@ -216,6 +218,8 @@ sporasub_sp2_transfer (sporasub_sp2_device_t *device, unsigned char cmd, const u
 		if (nretries++ >= MAXRETRIES)
 			return rc;
 
+		device_stats_retry ((dc_device_t *) device);
+
 		// Discard any garbage bytes.
 		dc_iostream_sleep (device->iostream, 100);
 		dc_iostream_purge (device->iostream, DC_DIRECTION_INPUT);
@@ -373,7 +377,7 @@ sporasub_sp2_device_foreach (dc_device_t *abstract, dc_dive_callback_t callback,
 	dc_status_t status = DC_STATUS_SUCCESS;
 	sporasub_sp2_device_t *device = (sporasub_sp2_device_t *) abstract;
 
-	dc_buffer_t *buffer = dc_buffer_new (SZ_MEMORY);
+	dc_buffer_t *buffer = dc_buffer_new_context (abstract->context, SZ_MEMORY);
 	if (buffer == NULL) {
 		status = DC_STATUS_NOMEMORY;
 		goto error_exit;
@@ -49,7 +49,13 @@ static const dc_parser_vtable_t sporasub_sp2_parser_vtable = {
 	NULL, /* set_density */
 	sporasub_sp2_parser_get_datetime, /* datetime */
 	sporasub_sp2_parser_get_field, /* fields */
+	NULL, /* summary */
 	sporasub_sp2_parser_samples_foreach, /* samples_foreach */
+	NULL, /* samples_batch */
+	NULL, /* samples_fixed */
+	NULL, /* samples_append */
+	NULL, /* samples_range */
+	NULL, /* reset */
 	NULL /* destroy */
 };
 
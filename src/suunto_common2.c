@@ -31,9 +31,12 @@
 #include "array.h"
 
 #define MAXRETRIES 2
+#define MINTIMEOUT 1000
+#define MAXTIMEOUT 3000
 
 #define SZ_VERSION    0x04
 #define SZ_PACKET     0x78
+#define SZ_PACKET_MAX 0xFF
 #define SZ_MINIMUM    8
 
 #define RB_PROFILE_DISTANCE(l,a,b,m)  ringbuffer_distance (a, b, m, l->rb_profile_begin, l->rb_profile_end)
@@ -49,6 +52,25 @@ suunto_common2_device_init (suunto_common2_device_t *device)
 	device->layout = NULL;
 	memset (device->version, 0, sizeof (device->version));
 	memset (device->fingerprint, 0, sizeof (device->fingerprint));
+	device->packetsize = SZ_PACKET;
+	device->probed = 0;
+}
+
+
+typedef struct suunto_common2_transfer_t {
+	const unsigned char *command;
+	unsigned int csize;
+	unsigned char *answer;
+	unsigned int asize;
+	unsigned int size;
+} suunto_common2_transfer_t;
+
+static dc_status_t
+suunto_common2_attempt (dc_device_t *abstract, unsigned int attempt, void *userdata)
+{
+	suunto_common2_transfer_t *transfer = (suunto_common2_transfer_t *) userdata;
+
+	return VTABLE (abstract)->packet (abstract, transfer->command, transfer->csize, transfer->answer, transfer->asize, transfer->size);
 }
 
 
@@ -65,20 +87,10 @@ suunto_common2_transfer (dc_device_t *abstract, const unsigned char command[], u
 	// returning an error. Usually the dive computer will respond
 	// again during one of the retries.
 
-	unsigned int nretries = 0;
-	dc_status_t rc = DC_STATUS_SUCCESS;
-	while ((rc = VTABLE (abstract)->packet (abstract, command, csize, answer, asize, size)) != DC_STATUS_SUCCESS) {
-		// Automatically discard a corrupted packet,
-		// and request a new one.
-		if (rc != DC_STATUS_TIMEOUT && rc != DC_STATUS_PROTOCOL)
-			return rc;
-
-		// Abort if the maximum number of retries is reached.
-		if (nretries++ >= MAXRETRIES)
-			return rc;
-	}
+	const device_retry_t policy = {MAXRETRIES, 0, 0, MINTIMEOUT, MAXTIMEOUT};
+	suunto_common2_transfer_t transfer = {command, csize, answer, asize, size};
 
-	return rc;
+	return device_transfer_retry (abstract, abstract->iostream, &policy, suunto_common2_attempt, &transfer);
 }
 
 
@@ -132,30 +144,58 @@ suunto_common2_device_reset_maxdepth (dc_device_t *abstract)
 }
 
 
+static dc_status_t
+suunto_common2_read_packet (dc_device_t *abstract, unsigned int address, unsigned char data[], unsigned int len, unsigned int retry)
+{
+	dc_status_t rc = DC_STATUS_SUCCESS;
+
+	assert (len <= SZ_PACKET_MAX - 3);
+
+	unsigned char answer[SZ_PACKET_MAX + 4] = {0};
+	unsigned char command[7] = {0x05, 0x00, 0x03,
+			(address >> 8) & 0xFF, // high
+			(address     ) & 0xFF, // low
+			len, // count
+			0};  // CRC
+	command[6] = checksum_xor_uint8 (command, 6, 0x00);
+	if (retry)
+		rc = suunto_common2_transfer (abstract, command, sizeof (command), answer, len + 7, len);
+	else
+		rc = VTABLE (abstract)->packet (abstract, command, sizeof (command), answer, len + 7, len);
+	if (rc != DC_STATUS_SUCCESS)
+		return rc;
+
+	memcpy (data, answer + 6, len);
+
+	return DC_STATUS_SUCCESS;
+}
+
+
 dc_status_t
 suunto_common2_device_read (dc_device_t *abstract, unsigned int address, unsigned char data[], unsigned int size)
 {
+	suunto_common2_device_t *device = (suunto_common2_device_t *) abstract;
+
 	unsigned int nbytes = 0;
 	while (nbytes < size) {
 		// Calculate the package size.
 		unsigned int len = size - nbytes;
-		if (len > SZ_PACKET)
-			len = SZ_PACKET;
+		if (len > device->packetsize)
+			len = device->packetsize;
 
 		// Read the package.
-		unsigned char answer[SZ_PACKET + 7] = {0};
-		unsigned char command[7] = {0x05, 0x00, 0x03,
-				(address >> 8) & 0xFF, // high
-				(address     ) & 0xFF, // low
-				len, // count
-				0};  // CRC
-		command[6] = checksum_xor_uint8 (command, 6, 0x00);
-		dc_status_t rc = suunto_common2_transfer (abstract, command, sizeof (command), answer, len + 7, len);
+		dc_status_t rc = suunto_common2_read_packet (abstract, address, data, len, 1);
+		if (rc != DC_STATUS_SUCCESS && rc != DC_STATUS_CANCELLED && len > SZ_PACKET) {
+			// The larger packets are not reliable after all.
+			WARNING (abstract->context, "Falling back to the default packet size.");
+			device->packetsize = SZ_PACKET;
+			dc_iostream_sleep (abstract->iostream, 100);
+			dc_iostream_purge (abstract->iostream, DC_DIRECTION_INPUT);
+			continue;
+		}
 		if (rc != DC_STATUS_SUCCESS)
 			return rc;
 
-		memcpy (data, answer + 6, len);
-
 		nbytes += len;
 		address += len;
 		data += len;
@@ -197,13 +237,80 @@ suunto_common2_device_write (dc_device_t *abstract, unsigned int address, const
 }
 
 
+static dc_status_t
+suunto_common2_device_identify (dc_device_t *abstract)
+{
+	suunto_common2_device_t *device = (suunto_common2_device_t *) abstract;
+
+	if (device->layout != NULL)
+		return DC_STATUS_SUCCESS;
+
+	// Identify the device on first use, when the backend postponed it
+	// during the open.
+	if (VTABLE(abstract)->identify == NULL)
+		return DC_STATUS_UNSUPPORTED;
+
+	dc_status_t status = VTABLE(abstract)->identify (abstract);
+	if (status != DC_STATUS_SUCCESS)
+		return status;
+
+	assert (device->layout != NULL);
+
+	return DC_STATUS_SUCCESS;
+}
+
+
+/*
+ * Switch to the maximum packet size of the model, if the data of such a
+ * packet matches a packet with the default size. A failed probe keeps
+ * the default size.
+ */
+static void
+suunto_common2_device_probe (dc_device_t *abstract)
+{
+	suunto_common2_device_t *device = (suunto_common2_device_t *) abstract;
+
+	if (device->probed || device->layout->packetsize <= SZ_PACKET)
+		return;
+
+	device->probed = 1;
+
+	unsigned int size = device->layout->packetsize;
+	if (size > SZ_PACKET_MAX - 3)
+		size = SZ_PACKET_MAX - 3;
+
+	unsigned char reference[SZ_PACKET] = {0};
+	if (suunto_common2_read_packet (abstract, 0, reference, sizeof (reference), 1) != DC_STATUS_SUCCESS)
+		return;
+
+	DEBUG (abstract->context, "Probing a packet size of %u bytes.", size);
+
+	unsigned char data[SZ_PACKET_MAX] = {0};
+	dc_status_t rc = suunto_common2_read_packet (abstract, 0, data, size, 0);
+	if (rc == DC_STATUS_SUCCESS && memcmp (data, reference, sizeof (reference)) == 0) {
+		device->packetsize = size;
+	} else if (rc != DC_STATUS_CANCELLED) {
+		// Discard the remainder of the answer.
+		dc_iostream_sleep (abstract->iostream, 100);
+		dc_iostream_purge (abstract->iostream, DC_DIRECTION_INPUT);
+	}
+
+	DEBUG (abstract->context, "Packet size: %u bytes.", device->packetsize);
+}
+
+
 dc_status_t
 suunto_common2_device_dump (dc_device_t *abstract, dc_buffer_t *buffer)
 {
 	suunto_common2_device_t *device = (suunto_common2_device_t *) abstract;
 
 	assert (device != NULL);
-	assert (device->layout != NULL);
+
+	dc_status_t status = suunto_common2_device_identify (abstract);
+	if (status != DC_STATUS_SUCCESS) {
+		ERROR (abstract->context, "Failed to identify the device.");
+		return status;
+	}
 
 	// Erase the current contents of the buffer and
 	// allocate the required amount of memory.
@@ -218,8 +325,11 @@ suunto_common2_device_dump (dc_device_t *abstract, dc_buffer_t *buffer)
 	vendor.size = sizeof (device->version);
 	device_event_emit (abstract, DC_EVENT_VENDOR, &vendor);
 
+	// Use larger packets if the model supports them.
+	suunto_common2_device_probe (abstract);
+
 	return device_dump_read (abstract, 0, dc_buffer_get_data (buffer),
-		dc_buffer_get_size (buffer), SZ_PACKET);
+		dc_buffer_get_size (buffer), device->packetsize);
 }
 
 
@@ -229,12 +339,18 @@ suunto_common2_device_foreach (dc_device_t *abstract, dc_dive_callback_t callbac
 	suunto_common2_device_t *device = (suunto_common2_device_t*) abstract;
 
 	assert (device != NULL);
-	assert (device->layout != NULL);
+
+	// Error status for delayed errors.
+	dc_status_t status = suunto_common2_device_identify (abstract);
+	if (status != DC_STATUS_SUCCESS) {
+		ERROR (abstract->context, "Failed to identify the device.");
+		return status;
+	}
 
 	const suunto_common2_layout_t *layout = device->layout;
 
-	// Error status for delayed errors.
-	dc_status_t status = DC_STATUS_SUCCESS;
+	// Use larger packets if the model supports them.
+	suunto_common2_device_probe (abstract);
 
 	// Enable progress notifications.
 	dc_event_progress_t progress = EVENT_PROGRESS_INITIALIZER;
@@ -307,20 +423,26 @@ suunto_common2_device_foreach (dc_device_t *abstract, dc_dive_callback_t callbac
 
 	// Create the ringbuffer stream.
 	dc_rbstream_t *rbstream = NULL;
-	rc = dc_rbstream_new (&rbstream, abstract, 1, SZ_PACKET, layout->rb_profile_begin, layout->rb_profile_end, end);
+	rc = dc_rbstream_new (&rbstream, abstract, 1, device->packetsize, layout->rb_profile_begin, layout->rb_profile_end, end);
 	if (rc != DC_STATUS_SUCCESS) {
 		ERROR (abstract->context, "Failed to create the ringbuffer stream.");
 		return rc;
 	}
 
-	// Memory buffer to store all the dives.
-	unsigned char *data = (unsigned char *) malloc (layout->rb_profile_end - layout->rb_profile_begin);
-	if (data == NULL) {
+	// Memory buffer for a single dive. Each dive is delivered as soon as it
+	// has been read, so only the largest dive needs to fit in memory.
+	dc_buffer_t *buffer = dc_buffer_new_context (abstract->context, 0);
+	if (buffer == NULL) {
 		ERROR (abstract->context, "Failed to allocate memory.");
 		dc_rbstream_free (rbstream);
 		return DC_STATUS_NOMEMORY;
 	}
 
+	// The dive header is only needed in advance to check the fingerprint,
+	// or the selection of a selective download.
+	int lookahead = !array_isequal (device->fingerprint, sizeof (device->fingerprint), 0) ||
+		abstract->selection != NULL;
+
 	// The ring buffer is traversed backwards to retrieve the most recent
 	// dives first. This allows us to download only the new dives.
 	unsigned int current = last;
@@ -333,23 +455,82 @@ suunto_common2_device_foreach (dc_device_t *abstract, dc_dive_callback_t callbac
 		if (size < 4 || size > offset) {
 			ERROR (abstract->context, "Unexpected profile size (%u %u).", size, offset);
 			dc_rbstream_free (rbstream);
-			free (data);
+			dc_buffer_free (buffer);
 			return DC_STATUS_DATAFORMAT;
 		}
 
+		// The fingerprint is located at the start of the dive, which is
+		// only reached after reading the entire dive backwards. For a dive
+		// that spans several packets, check the fingerprint with a single
+		// small read first, to stop at an already downloaded dive early.
+		// If the entire dive is already cached, or there is nothing to
+		// check, the extra read is avoided.
+		unsigned int fp_offset = layout->fingerprint + 4;
+		unsigned char head[SZ_PACKET];
+		if (lookahead && size > SZ_PACKET &&
+			!dc_rbstream_is_cached (rbstream, size) &&
+			fp_offset + sizeof (device->fingerprint) <= sizeof (head) &&
+			current + fp_offset + sizeof (device->fingerprint) <= layout->rb_profile_end)
+		{
+			rc = dc_device_read (abstract, current, head, fp_offset + sizeof (device->fingerprint));
+			if (rc != DC_STATUS_SUCCESS) {
+				ERROR (abstract->context, "Failed to read the dive header.");
+				dc_rbstream_free (rbstream);
+				dc_buffer_free (buffer);
+				return rc;
+			}
+
+			if (array_uint16_le (head + 2) == previous &&
+				memcmp (head + fp_offset, device->fingerprint, sizeof (device->fingerprint)) == 0) {
+				dc_rbstream_free (rbstream);
+				dc_buffer_free (buffer);
+				return DC_STATUS_SUCCESS;
+			}
+
+			// Skip dives left out by a selective download, without
+			// reading the rest of the dive.
+			unsigned int prev = array_uint16_le (head + 0);
+			if (array_uint16_le (head + 2) == previous &&
+				prev >= layout->rb_profile_begin && prev < layout->rb_profile_end &&
+				device_is_excluded (abstract, head + fp_offset, sizeof (device->fingerprint)))
+			{
+				rc = dc_rbstream_skip (rbstream, &progress, size);
+				if (rc != DC_STATUS_SUCCESS) {
+					ERROR (abstract->context, "Failed to skip the dive.");
+					dc_rbstream_free (rbstream);
+					dc_buffer_free (buffer);
+					return rc;
+				}
+				offset -= size;
+				previous = current;
+				current = prev;
+				continue;
+			}
+		}
+
 		// Move to the begin of the current dive.
 		offset -= size;
 
+		// Allocate memory for the dive.
+		dc_buffer_clear (buffer);
+		if (!dc_buffer_resize (buffer, size)) {
+			ERROR (abstract->context, "Failed to allocate memory.");
+			dc_rbstream_free (rbstream);
+			dc_buffer_free (buffer);
+			return DC_STATUS_NOMEMORY;
+		}
+
+		unsigned char *p = dc_buffer_get_data (buffer);
+
 		// Read the dive.
-		rc = dc_rbstream_read (rbstream, &progress, data + offset, size);
+		rc = dc_rbstream_read (rbstream, &progress, p, size);
 		if (rc != DC_STATUS_SUCCESS) {
 			ERROR (abstract->context, "Failed to read the dive.");
 			dc_rbstream_free (rbstream);
-			free (data);
+			dc_buffer_free (buffer);
 			return rc;
 		}
 
-		unsigned char *p = data + offset;
 		unsigned int prev = array_uint16_le (p + 0);
 		unsigned int next = array_uint16_le (p + 2);
 		if (prev < layout->rb_profile_begin ||
@@ -359,27 +540,26 @@ suunto_common2_device_foreach (dc_device_t *abstract, dc_dive_callback_t callbac
 		{
 			ERROR (abstract->context, "Invalid ringbuffer pointer detected (0x%04x 0x%04x).", prev, next);
 			dc_rbstream_free (rbstream);
-			free (data);
+			dc_buffer_free (buffer);
 			return DC_STATUS_DATAFORMAT;
 		}
 		if (next != previous && next != current) {
 			ERROR (abstract->context, "Profiles are not continuous (0x%04x 0x%04x 0x%04x).", current, next, previous);
 			dc_rbstream_free (rbstream);
-			free (data);
+			dc_buffer_free (buffer);
 			return DC_STATUS_DATAFORMAT;
 		}
 
 		if (next != current) {
-			unsigned int fp_offset = layout->fingerprint + 4;
 			if (memcmp (p + fp_offset, device->fingerprint, sizeof (device->fingerprint)) == 0) {
 				dc_rbstream_free (rbstream);
-				free (data);
+				dc_buffer_free (buffer);
 				return DC_STATUS_SUCCESS;
 			}
 
 			if (callback && !callback (p + 4, size - 4, p + fp_offset, sizeof (device->fingerprint), userdata)) {
 				dc_rbstream_free (rbstream);
-				free (data);
+				dc_buffer_free (buffer);
 				return DC_STATUS_SUCCESS;
 			}
 		} else {
@@ -393,7 +573,7 @@ suunto_common2_device_foreach (dc_device_t *abstract, dc_dive_callback_t callbac
 	}
 
 	dc_rbstream_free (rbstream);
-	free (data);
+	dc_buffer_free (buffer);
 
 	return status;
 }
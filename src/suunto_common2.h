@@ -38,6 +38,8 @@ typedef struct suunto_common2_layout_t {
 	// Profile ringbuffer
 	unsigned int rb_profile_begin;
 	unsigned int rb_profile_end;
+	// Maximum packet size.
+	unsigned int packetsize;
 } suunto_common2_layout_t;
 
 typedef struct suunto_common2_device_t {
@@ -45,11 +47,14 @@ typedef struct suunto_common2_device_t {
 	const suunto_common2_layout_t *layout;
 	unsigned char version[4];
 	unsigned char fingerprint[7];
+	unsigned int packetsize;
+	unsigned int probed;
 } suunto_common2_device_t;
 
 typedef struct suunto_common2_device_vtable_t {
 	dc_device_vtable_t base;
 	dc_status_t (*packet) (dc_device_t *device, const unsigned char command[], unsigned int csize, unsigned char answer[], unsigned int asize, unsigned int size);
+	dc_status_t (*identify) (dc_device_t *device);
 } suunto_common2_device_vtable_t;
 
 void
@@ -53,13 +53,16 @@ static const suunto_common2_device_vtable_t suunto_d9_device_vtable = {
 		DC_FAMILY_SUUNTO_D9,
 		suunto_common2_device_set_fingerprint, /* set_fingerprint */
 		suunto_common2_device_read, /* read */
+		NULL, /* read_range */
 		suunto_common2_device_write, /* write */
 		suunto_common2_device_dump, /* dump */
 		suunto_common2_device_foreach, /* foreach */
+		NULL, /* foreach_header */
 		NULL, /* timesync */
 		NULL /* close */
 	},
-	suunto_d9_device_packet
+	suunto_d9_device_packet,
+	NULL /* identify */
 };
 
 static const suunto_common2_layout_t suunto_d9_layout = {
@@ -67,7 +70,8 @@ static const suunto_common2_layout_t suunto_d9_layout = {
 	0x0011, /* fingerprint */
 	0x0023, /* serial */
 	0x019A, /* rb_profile_begin */
-	0x7FFE /* rb_profile_end */
+	0x7FFE, /* rb_profile_end */
+	0x0078 /* packetsize */
 };
 
 static const suunto_common2_layout_t suunto_d9tx_layout = {
@@ -75,7 +79,8 @@ static const suunto_common2_layout_t suunto_d9tx_layout = {
 	0x0013, /* fingerprint */
 	0x0024, /* serial */
 	0x019A, /* rb_profile_begin */
-	0xEBF0 /* rb_profile_end */
+	0xEBF0, /* rb_profile_end */
+	0x00F0 /* packetsize */
 };
 
 static const suunto_common2_layout_t suunto_dx_layout = {
@@ -83,44 +88,34 @@ static const suunto_common2_layout_t suunto_dx_layout = {
 	0x0017, /* fingerprint */
 	0x0024, /* serial */
 	0x019A, /* rb_profile_begin */
-	0xEBF0 /* rb_profile_end */
+	0xEBF0, /* rb_profile_end */
+	0x00F0 /* packetsize */
 };
 
 
 static dc_status_t
-suunto_d9_device_autodetect (suunto_d9_device_t *device, unsigned int model)
+suunto_d9_device_probe (dc_device_t *abstract, void *userdata)
 {
-	dc_status_t status = DC_STATUS_SUCCESS;
-	dc_device_t *abstract = (dc_device_t *) device;
+	suunto_d9_device_t *device = (suunto_d9_device_t *) abstract;
+
+	// Try reading the version info.
+	return suunto_common2_device_version (abstract, device->base.version, sizeof (device->base.version));
+}
 
-	// The list with possible baudrates.
-	const int baudrates[] = {9600, 115200};
 
+static dc_status_t
+suunto_d9_device_autodetect (suunto_d9_device_t *device, unsigned int model)
+{
 	// Use the model number as a hint to speedup the detection.
-	unsigned int hint = 0;
+	unsigned int hint = 9600;
 	if (model == D4i || model == D6i || model == D9tx ||
 		model == DX || model == VYPERNOVO || model == ZOOPNOVO_A || model == ZOOPNOVO_B ||
 		model == D4F)
-		hint = 1;
-
-	for (unsigned int i = 0; i < C_ARRAY_SIZE(baudrates); ++i) {
-		// Use the baudrate array as circular array, starting from the hint.
-		unsigned int idx = (hint + i) % C_ARRAY_SIZE(baudrates);
-
-		// Adjust the baudrate.
-		status = dc_iostream_configure (device->iostream, baudrates[idx], 8, DC_PARITY_NONE, DC_STOPBITS_ONE, DC_FLOWCONTROL_NONE);
-		if (status != DC_STATUS_SUCCESS) {
-			ERROR (abstract->context, "Failed to set the terminal attributes.");
-			return status;
-		}
-
-		// Try reading the version info.
-		status = suunto_common2_device_version ((dc_device_t *) device, device->base.version, sizeof (device->base.version));
-		if (status == DC_STATUS_SUCCESS)
-			break;
-	}
+		hint = 115200;
 
-	return status;
+	return device_baudrate_negotiate ((dc_device_t *) device, device->iostream, hint,
+		8, DC_PARITY_NONE, DC_STOPBITS_ONE, DC_FLOWCONTROL_NONE,
+		suunto_d9_device_probe, NULL);
 }
 
 
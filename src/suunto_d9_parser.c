@@ -27,10 +27,12 @@
 #include "context-private.h"
 #include "parser-private.h"
 #include "array.h"
+#include "field-cache.h"
 
 #define ISINSTANCE(parser) dc_parser_isinstance((parser), &suunto_d9_parser_vtable)
 
 #define MAXPARAMS 3
+#define MAXCYCLE  240
 #define NGASMIXES 11
 
 #define D9          0x0E
@@ -71,6 +73,13 @@
 
 typedef struct suunto_d9_parser_t suunto_d9_parser_t;
 
+typedef struct sample_info_t {
+	unsigned int type;
+	unsigned int size;
+	unsigned int interval;
+	unsigned int divisor;
+} sample_info_t;
+
 struct suunto_d9_parser_t {
 	dc_parser_t base;
 	unsigned int model;
@@ -83,20 +92,21 @@ struct suunto_d9_parser_t {
 	unsigned int nccr;
 	unsigned int oxygen[NGASMIXES];
 	unsigned int helium[NGASMIXES];
+	dc_gasmix_map_t gasmap;
 	unsigned int gasmix;
 	unsigned int config;
+	// Sample schedule.
+	unsigned int scheduled;
+	unsigned int nparams;
+	sample_info_t info[MAXPARAMS];
+	unsigned int ncycle;
+	unsigned char cycle[MAXCYCLE];
 };
 
-typedef struct sample_info_t {
-	unsigned int type;
-	unsigned int size;
-	unsigned int interval;
-	unsigned int divisor;
-} sample_info_t;
-
 static dc_status_t suunto_d9_parser_get_datetime (dc_parser_t *abstract, dc_datetime_t *datetime);
 static dc_status_t suunto_d9_parser_get_field (dc_parser_t *abstract, dc_field_type_t type, unsigned int flags, void *value);
 static dc_status_t suunto_d9_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_t callback, void *userdata);
+static dc_status_t suunto_d9_parser_reset (dc_parser_t *abstract);
 
 static const dc_parser_vtable_t suunto_d9_parser_vtable = {
 	sizeof(suunto_d9_parser_t),
@@ -106,22 +116,22 @@ static const dc_parser_vtable_t suunto_d9_parser_vtable = {
 	NULL, /* set_density */
 	suunto_d9_parser_get_datetime, /* datetime */
 	suunto_d9_parser_get_field, /* fields */
+	NULL, /* summary */
 	suunto_d9_parser_samples_foreach, /* samples_foreach */
+	NULL, /* samples_batch */
+	NULL, /* samples_fixed */
+	NULL, /* samples_append */
+	NULL, /* samples_range */
+	suunto_d9_parser_reset, /* reset */
 	NULL /* destroy */
 };
 
 static unsigned int
 suunto_d9_parser_find_gasmix (suunto_d9_parser_t *parser, unsigned int o2, unsigned int he)
 {
-	// Find the gasmix in the list.
-	unsigned int i = parser->nccr;
-	while (i < parser->ngasmixes) {
-		if (o2 == parser->oxygen[i] && he == parser->helium[i])
-			break;
-		i++;
-	}
-
-	return i;
+	// Find the gasmix in the list. Only the open circuit gas mixes
+	// are indexed, because the diluents are not used for gas switches.
+	return dc_gasmix_map_find (&parser->gasmap, o2, he, 0);
 }
 
 static dc_status_t
@@ -243,6 +253,10 @@ suunto_d9_parser_cache (suunto_d9_parser_t *parser)
 			}
 		}
 	}
+	dc_gasmix_map_clear (&parser->gasmap);
+	for (unsigned int i = parser->nccr; i < parser->ngasmixes; ++i) {
+		dc_gasmix_map_insert (&parser->gasmap, parser->oxygen[i], parser->helium[i], 0, i);
+	}
 	parser->config = config;
 	parser->id = id;
 	parser->cached = 1;
@@ -268,6 +282,19 @@ suunto_d9_parser_create (dc_parser_t **out, dc_context_t *context, const unsigne
 	// Set the default values.
 	parser->model = model;
 	parser->serial = serial;
+	suunto_d9_parser_reset ((dc_parser_t *) parser);
+
+	*out = (dc_parser_t*) parser;
+
+	return DC_STATUS_SUCCESS;
+}
+
+
+static dc_status_t
+suunto_d9_parser_reset (dc_parser_t *abstract)
+{
+	suunto_d9_parser_t *parser = (suunto_d9_parser_t *) abstract;
+
 	parser->cached = 0;
 	parser->id = 0;
 	parser->mode = AIR;
@@ -277,10 +304,12 @@ suunto_d9_parser_create (dc_parser_t **out, dc_context_t *context, const unsigne
 		parser->oxygen[i] = 0;
 		parser->helium[i] = 0;
 	}
+	dc_gasmix_map_clear (&parser->gasmap);
 	parser->gasmix = 0;
 	parser->config = 0;
-
-	*out = (dc_parser_t*) parser;
+	parser->scheduled = 0;
+	parser->nparams = 0;
+	parser->ncycle = 0;
 
 	return DC_STATUS_SUCCESS;
 }
@@ -332,6 +361,21 @@ suunto_d9_parser_get_datetime (dc_parser_t *abstract, dc_datetime_t *datetime)
 
 #define BUFLEN 16
 
+static unsigned int
+suunto_d9_parser_interval (suunto_d9_parser_t *parser)
+{
+	unsigned int offset = 0x18;
+	if (parser->model == HELO2 || parser->model == D4i ||
+		parser->model == D6i || parser->model == D9tx ||
+		parser->model == ZOOPNOVO_A || parser->model == ZOOPNOVO_B ||
+		parser->model == VYPERNOVO || parser->model == D4F)
+		offset = 0x1E;
+	else if (parser->model == DX)
+		offset = 0x22;
+
+	return parser->base.data[offset];
+}
+
 static dc_status_t
 suunto_d9_parser_get_field (dc_parser_t *abstract, dc_field_type_t type, unsigned int flags, void *value)
 {
@@ -346,6 +390,7 @@ suunto_d9_parser_get_field (dc_parser_t *abstract, dc_field_type_t type, unsigne
 	dc_gasmix_t *gasmix = (dc_gasmix_t *) value;
 	dc_decomodel_t *decomodel = (dc_decomodel_t *) value;
 	dc_field_string_t *string = (dc_field_string_t *) value;
+	dc_sample_interval_t *interval = (dc_sample_interval_t *) value;
 
 	char buf[BUFLEN];
 
@@ -421,6 +466,12 @@ suunto_d9_parser_get_field (dc_parser_t *abstract, dc_field_type_t type, unsigne
 			}
 			string->value = strdup(buf);
 			break;
+		case DC_FIELD_SAMPLE_INTERVAL:
+			interval->interval = suunto_d9_parser_interval (parser) * 1000;
+			interval->regular = 1;
+			if (interval->interval == 0)
+				return DC_STATUS_DATAFORMAT;
+			break;
 		default:
 			return DC_STATUS_UNSUPPORTED;
 		}
@@ -430,18 +481,34 @@ suunto_d9_parser_get_field (dc_parser_t *abstract, dc_field_type_t type, unsigne
 }
 
 
-static dc_status_t
-suunto_d9_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_t callback, void *userdata)
+static unsigned int
+suunto_d9_parser_mask (const sample_info_t info[], unsigned int nparams, unsigned int nsamples)
 {
-	suunto_d9_parser_t *parser = (suunto_d9_parser_t*) abstract;
+	unsigned int mask = 0;
+	for (unsigned int i = 0; i < nparams; ++i) {
+		if (info[i].interval && (nsamples % info[i].interval) == 0)
+			mask |= 1 << i;
+	}
 
+	return mask;
+}
+
+
+/*
+ * Parse the sample configuration, and compile it into a schedule with
+ * the parameters present in each sample. The schedule repeats after
+ * the least common multiple of the intervals. Schedules that don't
+ * fit are not compiled, and the parameters are checked per sample.
+ */
+static dc_status_t
+suunto_d9_parser_schedule (suunto_d9_parser_t *parser)
+{
+	dc_parser_t *abstract = (dc_parser_t *) parser;
 	const unsigned char *data = abstract->data;
-	unsigned int size = abstract->size;
 
-	// Cache the gas mix data.
-	dc_status_t rc = suunto_d9_parser_cache (parser);
-	if (rc != DC_STATUS_SUCCESS)
-		return rc;
+	if (parser->scheduled) {
+		return DC_STATUS_SUCCESS;
+	}
 
 	// Number of parameters in the configuration data.
 	unsigned int nparams = data[parser->config];
@@ -454,7 +521,7 @@ suunto_d9_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_t ca
 	const unsigned int divisors[] = {1, 2, 4, 5, 10, 50, 100, 1000};
 
 	// Get the sample configuration.
-	sample_info_t info[MAXPARAMS] = {{0}};
+	sample_info_t *info = parser->info;
 	for (unsigned int i = 0; i < nparams; ++i) {
 		unsigned int idx = parser->config + 2 + i * 3;
 		info[i].type     = data[idx + 0];
@@ -474,6 +541,55 @@ suunto_d9_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_t ca
 		}
 	}
 
+	// Length of the schedule.
+	unsigned int ncycle = 1;
+	for (unsigned int i = 0; i < nparams && ncycle; ++i) {
+		unsigned int a = ncycle, b = info[i].interval;
+		if (b == 0)
+			continue;
+		while (b) {
+			unsigned int t = a % b;
+			a = b;
+			b = t;
+		}
+		ncycle = ncycle / a * info[i].interval;
+		if (ncycle > MAXCYCLE)
+			ncycle = 0;
+	}
+
+	for (unsigned int i = 0; i < ncycle; ++i) {
+		parser->cycle[i] = suunto_d9_parser_mask (info, nparams, i);
+	}
+
+	parser->nparams = nparams;
+	parser->ncycle = ncycle;
+	parser->scheduled = 1;
+
+	return DC_STATUS_SUCCESS;
+}
+
+
+static dc_status_t
+suunto_d9_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_t callback, void *userdata)
+{
+	suunto_d9_parser_t *parser = (suunto_d9_parser_t*) abstract;
+
+	const unsigned char *data = abstract->data;
+	unsigned int size = abstract->size;
+
+	// Cache the gas mix data.
+	dc_status_t rc = suunto_d9_parser_cache (parser);
+	if (rc != DC_STATUS_SUCCESS)
+		return rc;
+
+	// Cache the sample configuration.
+	rc = suunto_d9_parser_schedule (parser);
+	if (rc != DC_STATUS_SUCCESS)
+		return rc;
+
+	unsigned int nparams = parser->nparams;
+	const sample_info_t *info = parser->info;
+
 	// Offset to the profile data.
 	unsigned int profile = parser->config + 2 + nparams * 3;
 	if (profile + 5 > size) {
@@ -491,15 +607,7 @@ suunto_d9_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_t ca
 	}
 
 	// Sample recording interval.
-	unsigned int interval_sample_offset = 0x18;
-	if (parser->model == HELO2 || parser->model == D4i ||
-		parser->model == D6i || parser->model == D9tx ||
-		parser->model == ZOOPNOVO_A || parser->model == ZOOPNOVO_B ||
-		parser->model == VYPERNOVO || parser->model == D4F)
-		interval_sample_offset = 0x1E;
-	else if (parser->model == DX)
-		interval_sample_offset = 0x22;
-	unsigned int interval_sample = data[interval_sample_offset];
+	unsigned int interval_sample = suunto_d9_parser_interval (parser);
 	if (interval_sample == 0) {
 		ERROR (abstract->context, "Invalid sample interval.");
 		return DC_STATUS_DATAFORMAT;
@@ -511,17 +619,24 @@ suunto_d9_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_t ca
 	unsigned int in_deco = 0;
 	unsigned int time = 0;
 	unsigned int nsamples = 0;
+	unsigned int tick = 0;
 	unsigned int offset = profile + 5;
 	while (offset < size) {
 		dc_sample_value_t sample = {0};
 
+		if (dc_parser_stopped (parser, callback))
+			break;
+
 		// Time (seconds).
 		sample.time = time * 1000;
 		if (callback) callback (DC_SAMPLE_TIME, &sample, userdata);
 
 		// Sample data.
+		unsigned int mask = parser->ncycle ?
+			parser->cycle[tick] :
+			suunto_d9_parser_mask (info, nparams, nsamples);
 		for (unsigned int i = 0; i < nparams; ++i) {
-			if (info[i].interval && (nsamples % info[i].interval) == 0) {
+			if (mask & (1 << i)) {
 				if (offset + info[i].size > size) {
 					ERROR (abstract->context, "Buffer overflow detected!");
 					return DC_STATUS_DATAFORMAT;
@@ -811,6 +926,8 @@ suunto_d9_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_t ca
 
 		time += interval_sample;
 		nsamples++;
+		if (++tick == parser->ncycle)
+			tick = 0;
 	}
 
 	return DC_STATUS_SUCCESS;
@@ -40,6 +40,7 @@ typedef struct suunto_eonsteel_device_t {
 	unsigned int model;
 	unsigned int magic;
 	unsigned short seq;
+	unsigned int readsize;
 	unsigned char version[0x30];
 	unsigned char fingerprint[4];
 } suunto_eonsteel_device_t;
@@ -81,8 +82,13 @@ struct directory_entry {
 #define MAXDATA_SIZE 2048
 #define CRC_SIZE    4
 
+// The file read reply contains an 8 byte header, followed by the data.
+#define READSIZE_MIN 1024
+#define READSIZE_MAX (MAXDATA_SIZE - 8)
+
 static dc_status_t suunto_eonsteel_device_set_fingerprint (dc_device_t *abstract, const unsigned char data[], unsigned int size);
 static dc_status_t suunto_eonsteel_device_foreach(dc_device_t *abstract, dc_dive_callback_t callback, void *userdata);
+static dc_status_t suunto_eonsteel_device_foreach_header(dc_device_t *abstract, dc_dive_callback_t callback, void *userdata);
 static dc_status_t suunto_eonsteel_device_timesync(dc_device_t *abstract, const dc_datetime_t *datetime);
 static dc_status_t suunto_eonsteel_device_close (dc_device_t *abstract);
 
@@ -91,9 +97,11 @@ static const dc_device_vtable_t suunto_eonsteel_device_vtable = {
 	DC_FAMILY_SUUNTO_EONSTEEL,
 	suunto_eonsteel_device_set_fingerprint, /* set_fingerprint */
 	NULL, /* read */
+	NULL, /* read_range */
 	NULL, /* write */
 	NULL, /* dump */
 	suunto_eonsteel_device_foreach, /* foreach */
+	suunto_eonsteel_device_foreach_header, /* foreach_header */
 	suunto_eonsteel_device_timesync, /* timesync */
 	suunto_eonsteel_device_close /* close */
 };
@@ -277,7 +285,7 @@ suunto_eonsteel_send(suunto_eonsteel_device_t *device,
 }
 
 /*
- * Send a command, receive a reply
+ * Receive the reply to a command
  *
  * This carefully checks the data fields in the reply for a match
  * against the command, and then only returns the actual reply
@@ -290,9 +298,8 @@ suunto_eonsteel_send(suunto_eonsteel_device_t *device,
  * send() side. The offsets are the same in the actual raw packet.
  */
 static dc_status_t
-suunto_eonsteel_transfer(suunto_eonsteel_device_t *device,
+suunto_eonsteel_receive(suunto_eonsteel_device_t *device,
 	unsigned short cmd,
-	const unsigned char data[], unsigned int size,
 	unsigned char answer[], unsigned int asize,
 	unsigned int *actual)
 {
@@ -300,11 +307,6 @@ suunto_eonsteel_transfer(suunto_eonsteel_device_t *device,
 	unsigned char header[HEADER_SIZE + MAXDATA_SIZE];
 	unsigned int len = 0;
 
-	// Send the command.
-	rc = suunto_eonsteel_send(device, cmd, data, size);
-	if (rc != DC_STATUS_SUCCESS)
-		return rc;
-
 	if (dc_iostream_get_transport(device->iostream) == DC_TRANSPORT_BLE) {
 		// Receive the entire data packet.
 		rc = suunto_eonsteel_receive_ble(device, header, sizeof(header), &len);
@@ -397,14 +399,36 @@ suunto_eonsteel_transfer(suunto_eonsteel_device_t *device,
 	return DC_STATUS_SUCCESS;
 }
 
+/*
+ * Send a command, receive a reply
+ */
 static dc_status_t
-read_file(suunto_eonsteel_device_t *eon, const char *filename, dc_buffer_t *buf)
+suunto_eonsteel_transfer(suunto_eonsteel_device_t *device,
+	unsigned short cmd,
+	const unsigned char data[], unsigned int size,
+	unsigned char answer[], unsigned int asize,
+	unsigned int *actual)
 {
 	dc_status_t rc = DC_STATUS_SUCCESS;
-	unsigned char result[2560];
+
+	// Send the command.
+	rc = suunto_eonsteel_send(device, cmd, data, size);
+	if (rc != DC_STATUS_SUCCESS)
+		return rc;
+
+	return suunto_eonsteel_receive(device, cmd, answer, asize, actual);
+}
+
+/*
+ * Send the request to open a file, without waiting for the reply.
+ * That's left to read_file(), such that the device can look up the
+ * next file while the previous one is still being processed.
+ */
+static dc_status_t
+open_file(suunto_eonsteel_device_t *eon, const char *filename)
+{
 	unsigned char cmdbuf[64];
-	unsigned int size, offset, len;
-	unsigned int n = 0;
+	unsigned int len;
 
 	memset(cmdbuf, 0, sizeof(cmdbuf));
 	len = strlen(filename) + 1;
@@ -413,8 +437,40 @@ read_file(suunto_eonsteel_device_t *eon, const char *filename, dc_buffer_t *buf)
 		return DC_STATUS_PROTOCOL;
 	}
 	memcpy(cmdbuf+4, filename, len);
-	rc = suunto_eonsteel_transfer(eon, CMD_FILE_OPEN,
-		cmdbuf, len + 4, result, sizeof(result), &n);
+
+	return suunto_eonsteel_send(eon, CMD_FILE_OPEN, cmdbuf, len + 4);
+}
+
+/*
+ * Close a file that was opened with open_file(), but isn't needed
+ * anymore.
+ */
+static dc_status_t
+close_file(suunto_eonsteel_device_t *eon)
+{
+	dc_status_t rc = DC_STATUS_SUCCESS;
+	unsigned char result[2560];
+
+	rc = suunto_eonsteel_receive(eon, CMD_FILE_OPEN, result, sizeof(result), NULL);
+	if (rc != DC_STATUS_SUCCESS)
+		return rc;
+
+	return suunto_eonsteel_transfer(eon, CMD_FILE_CLOSE,
+		NULL, 0, result, sizeof(result), NULL);
+}
+
+static dc_status_t
+read_file(suunto_eonsteel_device_t *eon, const char *filename, dc_buffer_t *buf)
+{
+	dc_status_t rc = DC_STATUS_SUCCESS;
+	unsigned char result[2560];
+	unsigned char cmdbuf[64];
+	unsigned int size, offset;
+	unsigned int n = 0;
+
+	memset(cmdbuf, 0, sizeof(cmdbuf));
+	rc = suunto_eonsteel_receive(eon, CMD_FILE_OPEN,
+		result, sizeof(result), &n);
 	if (rc != DC_STATUS_SUCCESS) {
 		ERROR(eon->base.context, "unable to look up %s", filename);
 		return rc;
@@ -432,12 +488,18 @@ read_file(suunto_eonsteel_device_t *eon, const char *filename, dc_buffer_t *buf)
 	size = array_uint32_le(result+4);
 	offset = 0;
 
+	// Allocate the memory for the entire file at once.
+	if (!dc_buffer_reserve (buf, dc_buffer_get_size (buf) + size)) {
+		ERROR (eon->base.context, "Insufficient buffer space available.");
+		return DC_STATUS_NOMEMORY;
+	}
+
 	while (size > 0) {
 		unsigned int ask, got, at;
 
 		ask = size;
-		if (ask > 1024)
-			ask = 1024;
+		if (ask > eon->readsize)
+			ask = eon->readsize;
 		array_uint32_le_set(cmdbuf + 0, 1234);	// Not file offset, after all
 		array_uint32_le_set(cmdbuf + 4, ask);	// Size of read
 		rc = suunto_eonsteel_transfer(eon, CMD_FILE_READ,
@@ -469,6 +531,15 @@ read_file(suunto_eonsteel_device_t *eon, const char *filename, dc_buffer_t *buf)
 
 		if (got > size)
 			got = size;
+
+		// A short read, while more data remains, reveals the maximum
+		// amount of data the device returns per request. Use that size
+		// from now on, so the requests match what the device returns.
+		if (got < ask && got < size && got >= READSIZE_MIN) {
+			DEBUG (eon->base.context, "Reducing the read size from %u to %u bytes.", eon->readsize, got);
+			eon->readsize = got;
+		}
+
 		if (!dc_buffer_append (buf, result + 8, got)) {
 			ERROR (eon->base.context, "Insufficient buffer space available.");
 			return DC_STATUS_NOMEMORY;
@@ -631,6 +702,7 @@ suunto_eonsteel_device_open(dc_device_t **out, dc_context_t *context, dc_iostrea
 	eon->model = model;
 	eon->magic = INIT_MAGIC;
 	eon->seq = INIT_SEQ;
+	eon->readsize = READSIZE_MAX;
 	memset (eon->version, 0, sizeof (eon->version));
 	memset (eon->fingerprint, 0, sizeof (eon->fingerprint));
 
@@ -699,13 +771,67 @@ suunto_eonsteel_device_set_fingerprint (dc_device_t *abstract, const unsigned ch
 	return DC_STATUS_SUCCESS;
 }
 
+/*
+ * Open the dive file that comes after the directory entry, if there is
+ * one that needs to be downloaded. Returns the entry of the file that
+ * is being opened, or NULL if nothing was sent.
+ */
+static struct directory_entry *
+open_next_dive(suunto_eonsteel_device_t *eon, struct directory_entry *de)
+{
+	char pathname[64];
+	unsigned char buf[4];
+	unsigned int time;
+	int len;
+
+	for (; de; de = de->next) {
+		if (de->type == DIRTYPE_DIR)
+			continue;
+
+		if (de->type != DIRTYPE_FILE)
+			return NULL;
+
+		if (sscanf(de->name, "%x.LOG", &time) != 1)
+			return NULL;
+
+		array_uint32_le_set(buf, time);
+		if (memcmp (buf, eon->fingerprint, sizeof (eon->fingerprint)) == 0)
+			return NULL;
+
+		if (!device_is_excluded((dc_device_t *) eon, buf, sizeof (buf)))
+			break;
+	}
+
+	if (de == NULL)
+		return NULL;
+
+	len = dc_platform_snprintf(pathname, sizeof(pathname), "%s/%s", dive_directory, de->name);
+	if (len < 0 || (unsigned int) len >= sizeof(pathname))
+		return NULL;
+
+	if (open_file(eon, pathname) != DC_STATUS_SUCCESS)
+		return NULL;
+
+	return de;
+}
+
+static void
+suunto_eonsteel_devinfo(suunto_eonsteel_device_t *eon)
+{
+	dc_event_devinfo_t devinfo;
+	devinfo.model = eon->model;
+	devinfo.firmware = array_uint32_be (eon->version + 0x20);
+	devinfo.serial = array_convert_str2num(eon->version + 0x10, 16);
+	device_event_emit ((dc_device_t *) eon, DC_EVENT_DEVINFO, &devinfo);
+}
+
 static dc_status_t
 suunto_eonsteel_device_foreach(dc_device_t *abstract, dc_dive_callback_t callback, void *userdata)
 {
 	dc_status_t status = DC_STATUS_SUCCESS;
 	dc_status_t rc = DC_STATUS_SUCCESS;
 	int skip = 0;
-	struct directory_entry *de;
+	struct directory_entry *de, *pending = NULL;
 	suunto_eonsteel_device_t *eon = (suunto_eonsteel_device_t *) abstract;
 	dc_buffer_t *file;
 	char pathname[64];
@@ -713,11 +839,7 @@ suunto_eonsteel_device_foreach(dc_device_t *abstract, dc_dive_callback_t callbac
 	dc_event_progress_t progress = EVENT_PROGRESS_INITIALIZER;
 
 	// Emit a device info event.
-	dc_event_devinfo_t devinfo;
-	devinfo.model = eon->model;
-	devinfo.firmware = array_uint32_be (eon->version + 0x20);
-	devinfo.serial = array_convert_str2num(eon->version + 0x10, 16);
-	device_event_emit (abstract, DC_EVENT_DEVINFO, &devinfo);
+	suunto_eonsteel_devinfo(eon);
 
 	rc = get_file_list(eon, &de);
 	if (rc != DC_STATUS_SUCCESS)
@@ -727,7 +849,7 @@ suunto_eonsteel_device_foreach(dc_device_t *abstract, dc_dive_callback_t callbac
 		return DC_STATUS_SUCCESS;
 	}
 
-	file = dc_buffer_new (16384);
+	file = dc_buffer_new_context (abstract->context, 16384);
 	if (file == NULL) {
 		ERROR (abstract->context, "Insufficient buffer space available.");
 		file_list_free(de);
@@ -770,12 +892,26 @@ suunto_eonsteel_device_foreach(dc_device_t *abstract, dc_dive_callback_t callbac
 				break;
 			}
 
+			// Skip dives left out by a selective download.
+			if (device_is_excluded(abstract, buf, sizeof (buf)))
+				break;
+
 			len = dc_platform_snprintf(pathname, sizeof(pathname), "%s/%s", dive_directory, de->name);
 			if (len < 0 || (unsigned int) len >= sizeof(pathname)) {
 				dc_status_set_error(&status, DC_STATUS_PROTOCOL);
 				break;
 			}
 
+			// The file may have been opened already.
+			if (pending != de) {
+				rc = open_file(eon, pathname);
+				if (rc != DC_STATUS_SUCCESS) {
+					dc_status_set_error(&status, rc);
+					break;
+				}
+			}
+			pending = NULL;
+
 			// Reset the membuffer, put the 4-byte length at the head.
 			dc_buffer_clear(file);
 			dc_buffer_append(file, buf, 4);
@@ -787,6 +923,11 @@ suunto_eonsteel_device_foreach(dc_device_t *abstract, dc_dive_callback_t callbac
 				break;
 			}
 
+			// Let the device open the next file, while the
+			// application is processing this one.
+			if (!device_is_cancelled(abstract))
+				pending = open_next_dive(eon, next);
+
 			data = dc_buffer_get_data(file);
 			size = dc_buffer_get_size(file);
 
@@ -801,9 +942,62 @@ suunto_eonsteel_device_foreach(dc_device_t *abstract, dc_dive_callback_t callbac
 	}
 	dc_buffer_free(file);
 
+	// Close the next file, if the download stopped before it.
+	if (pending) {
+		rc = close_file(eon);
+		if (rc != DC_STATUS_SUCCESS) {
+			ERROR(abstract->context, "cmd CMD_FILE_CLOSE failed");
+			dc_status_set_error(&status, rc);
+		}
+	}
+
 	return status;
 }
 
+/*
+ * The directory entries only contain the dive time, which is also the
+ * fingerprint, so that's all that is passed for each dive.
+ */
+static dc_status_t
+suunto_eonsteel_device_foreach_header(dc_device_t *abstract, dc_dive_callback_t callback, void *userdata)
+{
+	dc_status_t rc = DC_STATUS_SUCCESS;
+	struct directory_entry *list, *de;
+	suunto_eonsteel_device_t *eon = (suunto_eonsteel_device_t *) abstract;
+	unsigned int time;
+
+	// Emit a device info event.
+	suunto_eonsteel_devinfo(eon);
+
+	rc = get_file_list(eon, &list);
+	if (rc != DC_STATUS_SUCCESS)
+		return rc;
+
+	for (de = list; de; de = de->next) {
+		unsigned char buf[4];
+
+		if (de->type != DIRTYPE_FILE)
+			continue;
+
+		if (sscanf(de->name, "%x.LOG", &time) != 1) {
+			rc = DC_STATUS_PROTOCOL;
+			break;
+		}
+
+		array_uint32_le_set(buf, time);
+
+		if (memcmp (buf, eon->fingerprint, sizeof (eon->fingerprint)) == 0)
+			break;
+
+		if (callback && !callback(buf, sizeof(buf), buf, sizeof(eon->fingerprint), userdata))
+			break;
+	}
+
+	file_list_free(list);
+
+	return rc;
+}
+
 static dc_status_t suunto_eonsteel_device_timesync(dc_device_t *abstract, const dc_datetime_t *datetime)
 {
 	suunto_eonsteel_device_t *eon = (suunto_eonsteel_device_t *) abstract;
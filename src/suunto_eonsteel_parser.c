@@ -63,22 +63,76 @@ enum eon_sample {
 	ES_removegas,		// uint16
 };
 
+// Decode size of each sample type, in bytes
+static const unsigned char sample_size[] = {
+	[ES_dtime]		= 2,
+	[ES_depth]		= 2,
+	[ES_temp]		= 2,
+	[ES_ndl]		= 2,
+	[ES_ceiling]		= 2,
+	[ES_tts]		= 2,
+	[ES_heading]		= 2,
+	[ES_abspressure]	= 2,
+	[ES_gastime]		= 2,
+	[ES_ventilation]	= 2,
+	[ES_gasnr]		= 1,
+	[ES_pressure]		= 2,
+	[ES_state]		= 1,
+	[ES_state_active]	= 1,
+	[ES_notify]		= 1,
+	[ES_notify_active]	= 1,
+	[ES_warning]		= 1,
+	[ES_warning_active]	= 1,
+	[ES_alarm]		= 1,
+	[ES_alarm_active]	= 1,
+	[ES_gasswitch]		= 2,
+	[ES_setpoint_type]	= 1,
+	[ES_setpoint_po2]	= 4,
+	[ES_setpoint_automatic]	= 1,
+	[ES_bookmark]		= 2,
+	[ES_insertgas]		= 2,
+	[ES_removegas]		= 2,
+};
+
+// Which traverse function handles a descriptor
+enum eon_kind {
+	EK_none = 0,
+	EK_sample,
+	EK_device,
+	EK_header,
+};
+
 #define EON_MAX_GROUP 16
 
+// The strings of a descriptor all point into one allocation.
 struct type_desc {
+	char *text;
 	char *desc, *format, *mod;
+	unsigned int length;	// of the text in the dive data
+	unsigned char stale;	// recorded for a previous dive
 	unsigned int size;
-	enum eon_sample type[EON_MAX_GROUP];
+	unsigned char kind;		// enum eon_kind
+	unsigned char ntypes;
+	unsigned char type[EON_MAX_GROUP];	// enum eon_sample
 };
 
 #define MAXTYPE 512
 
 typedef struct suunto_eonsteel_parser_t {
 	dc_parser_t base;
-	struct type_desc type_desc[MAXTYPE];
+	// Indexed by type, and grown up to the highest type in use
+	struct type_desc *type_desc;
+	unsigned int ndescs;
 	struct dc_field_cache cache;
+	unsigned int cached;
+	dc_string_table_t strings;
 } suunto_eonsteel_parser_t;
 
+// Keys for the interned event strings
+#define KEY_ENUM(type, value)	(((type) << 8) | (value))
+#define KEY_GAS_INSERT(idx)	(0x80000000u | (idx))
+#define KEY_GAS_REMOVE(idx)	(0x80010000u | (idx))
+
 typedef int (*eon_data_cb_t)(unsigned short type, const struct type_desc *desc, const unsigned char *data, unsigned int len, void *user);
 
 static const struct {
@@ -192,12 +246,12 @@ static int fill_in_group_details(suunto_eonsteel_parser_t *eon, struct type_desc
 		long index;
 
 		index = strtol(grp, &end, 10);
-		if (index < 0 || index >= MAXTYPE || end == grp) {
+		if (index < 0 || index >= eon->ndescs || end == grp) {
 			ERROR(eon->base.context, "Group type descriptor '%s' does not parse", desc->desc);
 			break;
 		}
 		base = eon->type_desc + index;
-		if (!base->desc) {
+		if (!base->desc || base->stale) {
 			ERROR(eon->base.context, "Group type descriptor '%s' has undescribed index %ld", desc->desc, index);
 			break;
 		}
@@ -243,81 +297,183 @@ static int fill_in_group_details(suunto_eonsteel_parser_t *eon, struct type_desc
  * base types) or are "GRP" types that are a group of said
  * types and are a set of numbers.
  */
+static enum eon_kind lookup_descriptor_kind(suunto_eonsteel_parser_t *eon, struct type_desc *desc)
+{
+	const char *name = desc->desc;
+
+	if (desc->type[0])
+		return EK_sample;
+
+	if (!strncmp(name, "sml.DeviceLog.Device.", 21))
+		return EK_device;
+	if (!strncmp(name, "sml.DeviceLog.Header.", 21))
+		return EK_header;
+
+	return EK_none;
+}
+
+/*
+ * The sample types are decoded in order, up to the first one
+ * we don't know the size of.
+ */
+static unsigned int count_descriptor_types(suunto_eonsteel_parser_t *eon, struct type_desc *desc)
+{
+	unsigned int i;
+
+	for (i = 0; i < EON_MAX_GROUP; i++) {
+		enum eon_sample type = desc->type[i];
+
+		if (type >= C_ARRAY_SIZE(sample_size) || !sample_size[type])
+			break;
+	}
+	return i;
+}
+
 static int fill_in_desc_details(suunto_eonsteel_parser_t *eon, struct type_desc *desc)
 {
+	int rc = 0;
+
 	if (!desc->desc)
 		return 0;
 
-	if (isdigit(desc->desc[0]))
-		return fill_in_group_details(eon, desc);
+	if (isdigit(desc->desc[0])) {
+		rc = fill_in_group_details(eon, desc);
+	} else {
+		desc->size = lookup_descriptor_size(eon, desc);
+		desc->type[0] = lookup_descriptor_type(eon, desc);
+	}
 
-	desc->size = lookup_descriptor_size(eon, desc);
-	desc->type[0] = lookup_descriptor_type(eon, desc);
-	return 0;
+	desc->kind = lookup_descriptor_kind(eon, desc);
+	desc->ntypes = count_descriptor_types(eon, desc);
+	return rc;
 }
 
 static void
 desc_free (struct type_desc desc[], unsigned int count)
 {
-	for (unsigned int i = 0; i < count; ++i) {
-		free(desc[i].desc);
-		free(desc[i].format);
-		free(desc[i].mod);
+	for (unsigned int i = 0; i < count; ++i)
+		free(desc[i].text);
+}
+
+/*
+ * Check whether the text of a descriptor is the same as the one in the
+ * dive data, apart from the newlines that were turned into terminators.
+ */
+static int desc_equal(const struct type_desc *desc, const char *name, unsigned int namelen)
+{
+	if (!desc->text || desc->length != namelen)
+		return 0;
+
+	for (unsigned int i = 0; i < namelen; i++) {
+		char c = name[i] == '\n' ? 0 : name[i];
+		if (desc->text[i] != c)
+			return 0;
+	}
+	return 1;
+}
+
+static int desc_reserve(suunto_eonsteel_parser_t *eon, unsigned int type)
+{
+	struct type_desc *table;
+	unsigned int count;
+
+	if (type < eon->ndescs)
+		return 0;
+
+	count = eon->ndescs ? eon->ndescs : 64;
+	while (count <= type)
+		count *= 2;
+	if (count > MAXTYPE)
+		count = MAXTYPE;
+
+	table = (struct type_desc *) realloc(eon->type_desc, count * sizeof(*table));
+	if (!table) {
+		ERROR(eon->base.context, "out of memory");
+		return -1;
 	}
+	memset(table + eon->ndescs, 0, (count - eon->ndescs) * sizeof(*table));
+
+	eon->type_desc = table;
+	eon->ndescs = count;
+	return 0;
 }
 
 static int record_type(suunto_eonsteel_parser_t *eon, unsigned short type, const char *name, int namelen)
 {
 	struct type_desc desc;
-	const char *next;
+	const char *nul;
+	char *text, *line, *next;
+
+	if (namelen < 0)
+		namelen = 0;
+	nul = (const char *) memchr(name, 0, namelen);
+	if (nul)
+		namelen = nul - name;
+
+	// Every traversal of the dive records the descriptors again, and
+	// dives from the same firmware share them. An unchanged descriptor
+	// only needs its group details refreshed, in case the sub-entries
+	// have changed.
+	if (type < eon->ndescs && desc_equal(eon->type_desc + type, name, namelen)) {
+		struct type_desc *cached = eon->type_desc + type;
+
+		cached->stale = 0;
+		if (cached->desc && isdigit(cached->desc[0])) {
+			cached->size = 0;
+			memset(cached->type, 0, sizeof(cached->type));
+			fill_in_desc_details(eon, cached);
+		}
+		return 0;
+	}
+
+	// One copy of the whole description, with the
+	// newlines turned into string terminators.
+	text = (char *) malloc(namelen + 1);
+	if (!text) {
+		ERROR(eon->base.context, "out of memory");
+		return -1;
+	}
+	memcpy(text, name, namelen);
+	text[namelen] = 0;
 
 	memset(&desc, 0, sizeof(desc));
-	do {
-		int len;
-		char *p;
-
-		next = strchr(name, '\n');
-		if (next) {
-			len = next - name;
-			next++;
-		} else {
-			len = strlen(name);
-			if (!len)
-				break;
-		}
+	desc.text = text;
+	desc.length = namelen;
+	for (line = text; line; line = next) {
+		size_t len;
 
-		if (len < 5 || name[0] != '<' || name[4] != '>') {
-			ERROR(eon->base.context, "Unexpected type description: %.*s", len, name);
-			return -1;
-		}
-		p = (char *) malloc(len-4);
-		if (!p) {
-			ERROR(eon->base.context, "out of memory");
-			desc_free(&desc, 1);
+		next = strchr(line, '\n');
+		if (next)
+			*next++ = 0;
+
+		len = strlen(line);
+		if (!len && !next)
+			break;
+
+		if (len < 5 || line[0] != '<' || line[4] != '>') {
+			ERROR(eon->base.context, "Unexpected type description: %s", line);
+			free(text);
 			return -1;
 		}
-		memcpy(p, name+5, len-5);
-		p[len-5] = 0;
 
 		// PTH, GRP, FRM, MOD
-		switch (name[1]) {
+		switch (line[1]) {
 		case 'P':
 		case 'G':
-			desc.desc = p;
+			desc.desc = line + 5;
 			break;
 		case 'F':
-			desc.format = p;
+			desc.format = line + 5;
 			break;
 		case 'M':
-			desc.mod = p;
+			desc.mod = line + 5;
 			break;
 		default:
-			ERROR(eon->base.context, "Unknown type descriptor: %.*s", len, name);
-			desc_free(&desc, 1);
-			free(p);
+			ERROR(eon->base.context, "Unknown type descriptor: %s", line);
+			free(text);
 			return -1;
 		}
-	} while ((name = next) != NULL);
+	}
 
 	if (type >= MAXTYPE) {
 		ERROR(eon->base.context, "Type out of range (%04x: '%s' '%s' '%s')",
@@ -325,7 +481,12 @@ static int record_type(suunto_eonsteel_parser_t *eon, unsigned short type, const
 			desc.desc ? desc.desc : "",
 			desc.format ? desc.format : "",
 			desc.mod ? desc.mod : "");
-		desc_free(&desc, 1);
+		free(text);
+		return -1;
+	}
+
+	if (desc_reserve(eon, type) < 0) {
+		free(text);
 		return -1;
 	}
 
@@ -388,7 +549,7 @@ static int traverse_entry(suunto_eonsteel_parser_t *eon, const unsigned char *p,
 			end += 4;
 		}
 
-		if (type >= MAXTYPE || !eon->type_desc[type].desc) {
+		if (type >= eon->ndescs || !eon->type_desc[type].desc || eon->type_desc[type].stale) {
 			HEXDUMP(eon->base.context, DC_LOGLEVEL_DEBUG, "last", last, 16);
 			HEXDUMP(eon->base.context, DC_LOGLEVEL_DEBUG, "this", begin, 16);
 		} else {
@@ -433,20 +594,43 @@ struct sample_data {
 	dc_sample_callback_t callback;
 	void *userdata;
 	unsigned int time;
-	char *state_type, *notify_type;
-	char *warning_type, *alarm_type;
+	const char *state_type, *notify_type;
+	const char *warning_type, *alarm_type;
 
 	/* We gather up deco and cylinder pressure information */
 	int gasnr;
+
+	/* Fixed point samples, instead of the regular callback */
+	dc_sample_fixed_callback_t fixed;
 };
 
+/*
+ * Emit a sample to whichever callback is set. The samples that have
+ * no native fixed point form are converted here.
+ */
+static void sample_emit(struct sample_data *info, dc_sample_type_t type, const dc_sample_value_t *sample)
+{
+	if (info->callback) {
+		info->callback(type, sample, info->userdata);
+	} else if (info->fixed) {
+		dc_sample_value_fixed_t fixed;
+		dc_sample_fixed_convert(type, sample, &fixed);
+		info->fixed(type, &fixed, info->userdata);
+	}
+}
+
+static void sample_emit_fixed(struct sample_data *info, dc_sample_type_t type, const dc_sample_value_fixed_t *sample)
+{
+	info->fixed(type, sample, info->userdata);
+}
+
 static void sample_time(struct sample_data *info, unsigned short time_delta)
 {
 	dc_sample_value_t sample = {0};
 
 	info->time += time_delta;
 	sample.time = info->time;
-	if (info->callback) info->callback(DC_SAMPLE_TIME, &sample, info->userdata);
+	sample_emit(info, DC_SAMPLE_TIME, &sample);
 }
 
 static void sample_depth(struct sample_data *info, unsigned short depth)
@@ -456,8 +640,15 @@ static void sample_depth(struct sample_data *info, unsigned short depth)
 	if (depth == 0xffff)
 		return;
 
+	if (info->fixed) {
+		dc_sample_value_fixed_t fixed = {0};
+		fixed.depth = depth * 10;
+		sample_emit_fixed(info, DC_SAMPLE_DEPTH, &fixed);
+		return;
+	}
+
 	sample.depth = depth / 100.0;
-	if (info->callback) info->callback(DC_SAMPLE_DEPTH, &sample, info->userdata);
+	sample_emit(info, DC_SAMPLE_DEPTH, &sample);
 }
 
 static void sample_temp(struct sample_data *info, short temp)
@@ -467,8 +658,15 @@ static void sample_temp(struct sample_data *info, short temp)
 	if (temp <= -3000)
 		return;
 
+	if (info->fixed) {
+		dc_sample_value_fixed_t fixed = {0};
+		fixed.temperature = temp > -2731 ? temp * 100 + 273150 : 0;
+		sample_emit_fixed(info, DC_SAMPLE_TEMPERATURE, &fixed);
+		return;
+	}
+
 	sample.temperature = temp / 10.0;
-	if (info->callback) info->callback(DC_SAMPLE_TEMPERATURE, &sample, info->userdata);
+	sample_emit(info, DC_SAMPLE_TEMPERATURE, &sample);
 }
 
 static void sample_ndl(struct sample_data *info, short ndl)
@@ -481,7 +679,7 @@ static void sample_ndl(struct sample_data *info, short ndl)
 	sample.deco.type = DC_DECO_NDL;
 	sample.deco.time = ndl;
 	sample.deco.tts = 0;
-	if (info->callback) info->callback(DC_SAMPLE_DECO, &sample, info->userdata);
+	sample_emit(info, DC_SAMPLE_DECO, &sample);
 }
 
 static void sample_tts(struct sample_data *info, unsigned short tts)
@@ -489,7 +687,7 @@ static void sample_tts(struct sample_data *info, unsigned short tts)
 	if (tts != 0xffff) {
 		dc_sample_value_t sample = {0};
 		sample.time = tts;
-		if (info->callback) info->callback(DC_SAMPLE_TTS, &sample, info->userdata);
+		sample_emit(info, DC_SAMPLE_TTS, &sample);
 	}
 }
 
@@ -502,11 +700,20 @@ static void sample_ceiling(struct sample_data *info, unsigned short ceiling)
 		// deco stop, we just have a ceiling.
 		//
 		// We'll just say it's one minute.
+		if (info->fixed) {
+			dc_sample_value_fixed_t fixed = {0};
+			fixed.deco.type = DC_DECO_DECOSTOP;
+			fixed.deco.time = ceiling ? 60 : 0;
+			fixed.deco.depth = ceiling * 10;
+			sample_emit_fixed(info, DC_SAMPLE_DECO, &fixed);
+			return;
+		}
+
 		sample.deco.type = DC_DECO_DECOSTOP;
 		sample.deco.time = ceiling ? 60 : 0;
 		sample.deco.depth = ceiling / 100.0;
 		sample.deco.tts = 0;    // Fixme? DC_SAMPLE_TTS?
-		if (info->callback) info->callback(DC_SAMPLE_DECO, &sample, info->userdata);
+		sample_emit(info, DC_SAMPLE_DECO, &sample);
 	}
 }
 
@@ -519,7 +726,7 @@ static void sample_heading(struct sample_data *info, unsigned short heading)
 
 	sample.event.type = SAMPLE_EVENT_HEADING;
 	sample.event.value = heading;
-	if (info->callback) info->callback(DC_SAMPLE_EVENT, &sample, info->userdata);
+	sample_emit(info, DC_SAMPLE_EVENT, &sample);
 }
 
 static void sample_abspressure(struct sample_data *info, unsigned short pressure)
@@ -534,7 +741,7 @@ static void sample_gastime(struct sample_data *info, short gastime)
 		return;
 
 	sample.rbt = gastime / 60;
-	if (info->callback) info->callback (DC_SAMPLE_RBT, &sample, info->userdata);
+	sample_emit(info, DC_SAMPLE_RBT, &sample);
 }
 
 /*
@@ -560,9 +767,17 @@ static void sample_pressure(struct sample_data *info, unsigned short pressure)
 	if (pressure == 0xffff)
 		return;
 
+	if (info->fixed) {
+		dc_sample_value_fixed_t fixed = {0};
+		fixed.pressure.tank = info->gasnr-1;
+		fixed.pressure.value = pressure * 10;
+		sample_emit_fixed(info, DC_SAMPLE_PRESSURE, &fixed);
+		return;
+	}
+
 	sample.pressure.tank = info->gasnr-1;
 	sample.pressure.value = pressure / 100.0;
-	if (info->callback) info->callback(DC_SAMPLE_PRESSURE, &sample, info->userdata);
+	sample_emit(info, DC_SAMPLE_PRESSURE, &sample);
 }
 
 static void sample_bookmark_event(struct sample_data *info, unsigned short idx)
@@ -572,7 +787,7 @@ static void sample_bookmark_event(struct sample_data *info, unsigned short idx)
 	sample.event.type = SAMPLE_EVENT_BOOKMARK;
 	sample.event.value = idx;
 
-	if (info->callback) info->callback(DC_SAMPLE_EVENT, &sample, info->userdata);
+	sample_emit(info, DC_SAMPLE_EVENT, &sample);
 }
 
 static void sample_gas_switch_event(struct sample_data *info, unsigned short idx)
@@ -584,7 +799,7 @@ static void sample_gas_switch_event(struct sample_data *info, unsigned short idx
 		return;
 
 	sample.gasmix = idx - 1;
-	if (info->callback) info->callback(DC_SAMPLE_GASMIX, &sample, info->userdata);
+	sample_emit(info, DC_SAMPLE_GASMIX, &sample);
 }
 
 static const char *mixname(suunto_eonsteel_parser_t *eon, int idx)
@@ -616,15 +831,22 @@ static void sample_insert_gas_event(struct sample_data *info, unsigned short idx
 	dc_sample_value_t sample = {0};
 	char event[32];
 
-	if (!info->callback)
+	if (!info->callback && !info->fixed)
 		return;
 
-	snprintf(event, sizeof(event), "Create gas %d (%s)", idx, mixname(eon, idx));
+	sample.event.name = dc_string_lookup(&eon->strings, KEY_GAS_INSERT(idx));
+	if (!sample.event.name) {
+		int len = snprintf(event, sizeof(event), "Create gas %d (%s)", idx, mixname(eon, idx));
+		if (len < 0 || len >= (int) sizeof(event))
+			len = strlen(event);
+		sample.event.name = dc_string_intern(&eon->strings, KEY_GAS_INSERT(idx), event, len);
+		if (!sample.event.name)
+			return;
+	}
 	sample.event.type = SAMPLE_EVENT_STRING;
-	sample.event.name = strdup(event);
 	sample.event.flags = SAMPLE_FLAGS_SEVERITY_INFO;
 
-	info->callback(DC_SAMPLE_EVENT, &sample, info->userdata);
+	sample_emit(info, DC_SAMPLE_EVENT, &sample);
 }
 
 static void sample_remove_gas_event(struct sample_data *info, unsigned short idx)
@@ -633,15 +855,22 @@ static void sample_remove_gas_event(struct sample_data *info, unsigned short idx
 	dc_sample_value_t sample = {0};
 	char event[32];
 
-	if (!info->callback)
+	if (!info->callback && !info->fixed)
 		return;
 
-	snprintf(event, sizeof(event), "Remove gas %d (%s)", idx, mixname(eon, idx));
+	sample.event.name = dc_string_lookup(&eon->strings, KEY_GAS_REMOVE(idx));
+	if (!sample.event.name) {
+		int len = snprintf(event, sizeof(event), "Remove gas %d (%s)", idx, mixname(eon, idx));
+		if (len < 0 || len >= (int) sizeof(event))
+			len = strlen(event);
+		sample.event.name = dc_string_intern(&eon->strings, KEY_GAS_REMOVE(idx), event, len);
+		if (!sample.event.name)
+			return;
+	}
 	sample.event.type = SAMPLE_EVENT_STRING;
-	sample.event.name = strdup(event);
 	sample.event.flags = SAMPLE_FLAGS_SEVERITY_INFO;
 
-	info->callback(DC_SAMPLE_EVENT, &sample, info->userdata);
+	sample_emit(info, DC_SAMPLE_EVENT, &sample);
 }
 
 /*
@@ -652,12 +881,21 @@ static void sample_remove_gas_event(struct sample_data *info, unsigned short idx
  * of enumeration values and strings. Example:
  *
  * "enum:0=NoFly Time,1=Depth,2=Surface Time,3=..."
+ *
+ * The result is interned in the parser string table, so
+ * every enumeration value is only decoded once per dive.
  */
-static char *lookup_enum(const struct type_desc *desc, unsigned char value)
+static const char *lookup_enum(suunto_eonsteel_parser_t *eon, const struct type_desc *desc, unsigned char value)
 {
+	unsigned int key = KEY_ENUM((unsigned int) (desc - eon->type_desc), value);
 	const char *str = desc->format;
+	const char *ret;
 	unsigned char c;
 
+	ret = dc_string_lookup(&eon->strings, key);
+	if (ret)
+		return ret;
+
 	if (!str)
 		return NULL;
 	if (strncmp(str, "enum:", 5))
@@ -667,7 +905,6 @@ static char *lookup_enum(const struct type_desc *desc, unsigned char value)
 	while ((c = *str) != 0) {
 		unsigned char n;
 		const char *begin, *end;
-		char *ret;
 
 		str++;
 		if (!isdigit(c))
@@ -697,13 +934,7 @@ static char *lookup_enum(const struct type_desc *desc, unsigned char value)
 		if (n != value)
 			continue;
 
-		ret = (char *)malloc(end - begin + 1);
-		if (!ret)
-			break;
-
-		memcpy(ret, begin, end-begin);
-		ret[end-begin] = 0;
-		return ret;
+		return dc_string_intern(&eon->strings, key, begin, end - begin);
 	}
 	return NULL;
 }
@@ -714,8 +945,7 @@ static char *lookup_enum(const struct type_desc *desc, unsigned char value)
  */
 static void sample_event_state_type(const struct type_desc *desc, struct sample_data *info, unsigned char type)
 {
-	free(info->state_type);
-	info->state_type = lookup_enum(desc, type);
+	info->state_type = lookup_enum(info->eon, desc, type);
 }
 
 static void sample_event_state_value(const struct type_desc *desc, struct sample_data *info, unsigned char value)
@@ -732,13 +962,12 @@ static void sample_event_state_value(const struct type_desc *desc, struct sample
 	sample.event.flags = value ? SAMPLE_FLAGS_BEGIN : SAMPLE_FLAGS_END;
 	sample.event.flags |= 1 << SAMPLE_FLAGS_SEVERITY_SHIFT;
 
-	if (info->callback) info->callback(DC_SAMPLE_EVENT, &sample, info->userdata);
+	sample_emit(info, DC_SAMPLE_EVENT, &sample);
 }
 
 static void sample_event_notify_type(const struct type_desc *desc, struct sample_data *info, unsigned char type)
 {
-	free(info->notify_type);
-	info->notify_type = lookup_enum(desc, type);
+	info->notify_type = lookup_enum(info->eon, desc, type);
 }
 
 static void sample_event_notify_value(const struct type_desc *desc, struct sample_data *info, unsigned char value)
@@ -755,14 +984,13 @@ static void sample_event_notify_value(const struct type_desc *desc, struct sampl
 	sample.event.flags = value ? SAMPLE_FLAGS_BEGIN : SAMPLE_FLAGS_END;
 	sample.event.flags |= 2 << SAMPLE_FLAGS_SEVERITY_SHIFT;
 
-	if (info->callback) info->callback(DC_SAMPLE_EVENT, &sample, info->userdata);
+	sample_emit(info, DC_SAMPLE_EVENT, &sample);
 }
 
 
 static void sample_event_warning_type(const struct type_desc *desc, struct sample_data *info, unsigned char type)
 {
-	free(info->warning_type);
-	info->warning_type = lookup_enum(desc, type);
+	info->warning_type = lookup_enum(info->eon, desc, type);
 }
 
 static void sample_event_warning_value(const struct type_desc *desc, struct sample_data *info, unsigned char value)
@@ -779,13 +1007,12 @@ static void sample_event_warning_value(const struct type_desc *desc, struct samp
 	sample.event.flags = value ? SAMPLE_FLAGS_BEGIN : SAMPLE_FLAGS_END;
 	sample.event.flags |= 3 << SAMPLE_FLAGS_SEVERITY_SHIFT;
 
-	if (info->callback) info->callback(DC_SAMPLE_EVENT, &sample, info->userdata);
+	sample_emit(info, DC_SAMPLE_EVENT, &sample);
 }
 
 static void sample_event_alarm_type(const struct type_desc *desc, struct sample_data *info, unsigned char type)
 {
-	free(info->alarm_type);
-	info->alarm_type = lookup_enum(desc, type);
+	info->alarm_type = lookup_enum(info->eon, desc, type);
 }
 
 
@@ -803,14 +1030,14 @@ static void sample_event_alarm_value(const struct type_desc *desc, struct sample
 	sample.event.flags = value ? SAMPLE_FLAGS_BEGIN : SAMPLE_FLAGS_END;
 	sample.event.flags |= 4 << SAMPLE_FLAGS_SEVERITY_SHIFT;
 
-	if (info->callback) info->callback(DC_SAMPLE_EVENT, &sample, info->userdata);
+	sample_emit(info, DC_SAMPLE_EVENT, &sample);
 }
 
 // enum:0=Low,1=High,2=Custom
 static void sample_setpoint_type(const struct type_desc *desc, struct sample_data *info, unsigned char value)
 {
 	dc_sample_value_t sample = {0};
-	char *type = lookup_enum(desc, value);
+	const char *type = lookup_enum(info->eon, desc, value);
 
 	if (!type) {
 		DEBUG(info->eon->base.context, "sample_setpoint_type(%u) did not match anything in %s", value, desc->format);
@@ -825,12 +1052,10 @@ static void sample_setpoint_type(const struct type_desc *desc, struct sample_dat
 		sample.setpoint = info->eon->cache.customsetpoint;
 	else {
 		DEBUG(info->eon->base.context, "sample_setpoint_type(%u) unknown type '%s'", value, type);
-		free(type);
 		return;
 	}
 
-	if (info->callback) info->callback(DC_SAMPLE_SETPOINT, &sample, info->userdata);
-	free(type);
+	sample_emit(info, DC_SAMPLE_SETPOINT, &sample);
 }
 
 // uint32
@@ -846,119 +1071,119 @@ static void sample_setpoint_automatic(struct sample_data *info, unsigned char va
 	DEBUG(info->eon->base.context, "sample_setpoint_automatic(%u)", value);
 }
 
-static unsigned int handle_sample_type(const struct type_desc *desc, struct sample_data *info, enum eon_sample type, const unsigned char *data)
+static void handle_sample_type(const struct type_desc *desc, struct sample_data *info, enum eon_sample type, const unsigned char *data)
 {
 	switch (type) {
 	case ES_dtime:
 		sample_time(info, array_uint16_le(data));
-		return 2;
+		break;
 
 	case ES_depth:
 		sample_depth(info, array_uint16_le(data));
-		return 2;
+		break;
 
 	case ES_temp:
 		sample_temp(info, array_uint16_le(data));
-		return 2;
+		break;
 
 	case ES_ndl:
 		sample_ndl(info, array_uint16_le(data));
-		return 2;
+		break;
 
 	case ES_ceiling:
 		sample_ceiling(info, array_uint16_le(data));
-		return 2;
+		break;
 
 	case ES_tts:
 		sample_tts(info, array_uint16_le(data));
-		return 2;
+		break;
 
 	case ES_heading:
 		sample_heading(info, array_uint16_le(data));
-		return 2;
+		break;
 
 	case ES_abspressure:
 		sample_abspressure(info, array_uint16_le(data));
-		return 2;
+		break;
 
 	case ES_gastime:
 		sample_gastime(info, array_uint16_le(data));
-		return 2;
+		break;
 
 	case ES_ventilation:
 		sample_ventilation(info, array_uint16_le(data));
-		return 2;
+		break;
 
 	case ES_gasnr:
 		sample_gasnr(info, *data);
-		return 1;
+		break;
 
 	case ES_pressure:
 		sample_pressure(info, array_uint16_le(data));
-		return 2;
+		break;
 
 	case ES_state:
 		sample_event_state_type(desc, info, data[0]);
-		return 1;
+		break;
 
 	case ES_state_active:
 		sample_event_state_value(desc, info, data[0]);
-		return 1;
+		break;
 
 	case ES_notify:
 		sample_event_notify_type(desc, info, data[0]);
-		return 1;
+		break;
 
 	case ES_notify_active:
 		sample_event_notify_value(desc, info, data[0]);
-		return 1;
+		break;
 
 	case ES_warning:
 		sample_event_warning_type(desc, info, data[0]);
-		return 1;
+		break;
 
 	case ES_warning_active:
 		sample_event_warning_value(desc, info, data[0]);
-		return 1;
+		break;
 
 	case ES_alarm:
 		sample_event_alarm_type(desc, info, data[0]);
-		return 1;
+		break;
 
 	case ES_alarm_active:
 		sample_event_alarm_value(desc, info, data[0]);
-		return 1;
+		break;
 
 	case ES_bookmark:
 		sample_bookmark_event(info, array_uint16_le(data));
-		return 2;
+		break;
 
 	case ES_gasswitch:
 		sample_gas_switch_event(info, array_uint16_le(data));
-		return 2;
+		break;
 
 	case ES_setpoint_type:
 		sample_setpoint_type(desc, info, data[0]);
-		return 1;
+		break;
 
 	case ES_setpoint_po2:
 		sample_setpoint_po2(info, array_uint32_le(data));
-		return 4;
+		break;
 
 	case ES_setpoint_automatic:	// bool
 		sample_setpoint_automatic(info, data[0]);
-		return 1;
+		break;
 
 	case ES_insertgas:
 		sample_insert_gas_event(info, array_uint16_le(data));
-		return 2;
+		break;
 
 	case ES_removegas:
 		sample_remove_gas_event(info, array_uint16_le(data));
-		return 2;
+		break;
 
 	default:
-		return 0;
+		break;
 	}
 }
 
@@ -966,20 +1191,20 @@ static int traverse_samples(unsigned short type, const struct type_desc *desc, c
 {
 	struct sample_data *info = (struct sample_data *) user;
 	suunto_eonsteel_parser_t *eon = info->eon;
-	int i, used = 0;
+	unsigned int i, used = 0;
 
 	if (desc->size > len)
 		ERROR(eon->base.context, "Got %d bytes of data for '%s' that wants %d bytes", len, desc->desc, desc->size);
 
-	for (i = 0; i < EON_MAX_GROUP; i++) {
-		unsigned int bytes = handle_sample_type(desc, info, desc->type[i], data);
+	for (i = 0; i < desc->ntypes; i++) {
+		enum eon_sample sample = desc->type[i];
+		unsigned int bytes = sample_size[sample];
 
-		if (!bytes)
-			break;
 		if (bytes > len) {
 			ERROR(eon->base.context, "Wanted %d bytes of data, only had %d bytes ('%s' idx %d)", bytes, len, desc->desc, i);
 			break;
 		}
+		handle_sample_type(desc, info, sample, data);
 		data += bytes;
 		len -= bytes;
 		used += bytes;
@@ -991,18 +1216,36 @@ static int traverse_samples(unsigned short type, const struct type_desc *desc, c
 	return 0;
 }
 
+static void initialize_field_caches(suunto_eonsteel_parser_t *eon);
+
 static dc_status_t
 suunto_eonsteel_parser_samples_foreach(dc_parser_t *abstract, dc_sample_callback_t callback, void *userdata)
 {
 	suunto_eonsteel_parser_t *eon = (suunto_eonsteel_parser_t *) abstract;
 	struct sample_data data = { eon, callback, userdata, 0 };
 
+	// The gas mixes and setpoints are needed for the samples.
+	if (!eon->cached)
+		initialize_field_caches(eon);
+
 	traverse_data(eon, traverse_samples, &data);
 
-	free(data.state_type);
-	free(data.notify_type);
-	free(data.warning_type);
-	free(data.alarm_type);
+	return DC_STATUS_SUCCESS;
+}
+
+static dc_status_t
+suunto_eonsteel_parser_samples_fixed(dc_parser_t *abstract, dc_sample_fixed_callback_t callback, void *userdata)
+{
+	suunto_eonsteel_parser_t *eon = (suunto_eonsteel_parser_t *) abstract;
+	struct sample_data data = { eon, NULL, userdata, 0 };
+
+	data.fixed = callback;
+
+	// The gas mixes and setpoints are needed for the samples.
+	if (!eon->cached)
+		initialize_field_caches(eon);
+
+	traverse_data(eon, traverse_samples, &data);
 
 	return DC_STATUS_SUCCESS;
 }
@@ -1012,6 +1255,9 @@ suunto_eonsteel_parser_get_field(dc_parser_t *parser, dc_field_type_t type, unsi
 {
 	suunto_eonsteel_parser_t *eon = (suunto_eonsteel_parser_t *)parser;
 
+	if (!eon->cached)
+		initialize_field_caches(eon);
+
 	if (!(eon->cache.initialized & (1 << type)))
 		return DC_STATUS_UNSUPPORTED;
 
@@ -1056,6 +1302,25 @@ suunto_eonsteel_parser_get_field(dc_parser_t *parser, dc_field_type_t type, unsi
 	return dc_field_get(&eon->cache, type, flags, value);
 }
 
+static dc_status_t
+suunto_eonsteel_parser_get_summary(dc_parser_t *parser, dc_parser_summary_t *summary)
+{
+	suunto_eonsteel_parser_t *eon = (suunto_eonsteel_parser_t *)parser;
+
+	if (!eon->cached)
+		initialize_field_caches(eon);
+
+	dc_field_summary(&eon->cache, summary);
+
+	/* The tank usage is the only part dc_field_get() leaves alone */
+	if (summary->fields & DC_FIELD_MASK(DC_FIELD_TANK)) {
+		for (unsigned int i = 0; i < summary->tank_count && i < DC_SUMMARY_TANKS && i < MAXGASES; i++)
+			summary->tank[i].usage = eon->cache.tankusage[i];
+	}
+
+	return DC_STATUS_SUCCESS;
+}
+
 /*
  * The time of the dive is encoded in the filename,
  * and we've saved it off as the four first bytes
@@ -1110,13 +1375,13 @@ static dc_status_t add_gas_type(suunto_eonsteel_parser_t *eon, const struct type
 	int idx = eon->cache.GASMIX_COUNT;
 	dc_tankinfo_t tankinfo = DC_TANKINFO_METRIC;
 	dc_usage_t usage = DC_USAGE_NONE;
-	char *name;
+	const char *name;
 
 	if (idx >= MAXGASES)
 		return DC_STATUS_SUCCESS;
 
 	eon->cache.GASMIX_COUNT = idx+1;
-	name = lookup_enum(desc, type);
+	name = lookup_enum(eon, desc, type);
 	if (!name)
 		DEBUG(eon->base.context, "Unable to look up gas type %u in %s", type, desc->format);
 	else if (!strcasecmp(name, "Diluent"))
@@ -1136,7 +1401,6 @@ static dc_status_t add_gas_type(suunto_eonsteel_parser_t *eon, const struct type
 
 	eon->cache.initialized |= 1 << DC_FIELD_GASMIX_COUNT;
 	eon->cache.initialized |= 1 << DC_FIELD_TANK_COUNT;
-	free(name);
 	return DC_STATUS_SUCCESS;
 }
 
@@ -1395,25 +1659,26 @@ static dc_status_t traverse_header_fields(suunto_eonsteel_parser_t *eon,
 	if (!strcmp(name, "DateTime"))
 		return dc_field_add_string(&eon->cache, "Dive ID", data);
 
+	// In summary mode the samples are skipped, and the dive
+	// time is taken from the header instead (in seconds).
+	if (!strcmp(name, "Duration") && (eon->base.flags & DC_PARSER_FLAG_SUMMARY)) {
+		eon->cache.DIVETIME = array_uint32_le(data) * 1000;
+		return DC_STATUS_SUCCESS;
+	}
+
 	return DC_STATUS_SUCCESS;
 }
 
 static dc_status_t traverse_dynamic_fields(suunto_eonsteel_parser_t *eon, const struct type_desc *desc, const unsigned char *data, int len)
 {
-	const char *name = desc->desc;
-
-	if (!strncmp(name, "sml.", 4)) {
-		name += 4;
-		if (!strncmp(name, "DeviceLog.", 10)) {
-			name += 10;
-			if (!strncmp(name, "Device.", 7))
-				return traverse_device_fields(eon, desc, data, len);
-			if (!strncmp(name, "Header.", 7)) {
-				return traverse_header_fields(eon, desc, data, len);
-			}
-		}
+	switch (desc->kind) {
+	case EK_device:
+		return traverse_device_fields(eon, desc, data, len);
+	case EK_header:
+		return traverse_header_fields(eon, desc, data, len);
+	default:
+		return DC_STATUS_SUCCESS;
 	}
-	return DC_STATUS_SUCCESS;
 }
 
 /*
@@ -1423,9 +1688,9 @@ static dc_status_t traverse_dynamic_fields(suunto_eonsteel_parser_t *eon, const
  */
 static int traverse_sample_fields(suunto_eonsteel_parser_t *eon, const struct type_desc *desc, const unsigned char *data, int len)
 {
-	int i;
+	unsigned int i;
 
-	for (i = 0; i < EON_MAX_GROUP; i++) {
+	for (i = 0; i < desc->ntypes; i++) {
 		enum eon_sample type = desc->type[i];
 
 		switch (type) {
@@ -1449,33 +1714,23 @@ static int traverse_fields(unsigned short type, const struct type_desc *desc, co
 {
 	suunto_eonsteel_parser_t *eon = (suunto_eonsteel_parser_t *) user;
 
-	// Sample type? Do basic maxdepth and time parsing
-	if (desc->type[0])
-		traverse_sample_fields(eon, desc, data, len);
-	else
+	// Sample type? Do basic maxdepth and time parsing,
+	// unless only the header summary was requested.
+	if (desc->kind == EK_sample) {
+		if (!(eon->base.flags & DC_PARSER_FLAG_SUMMARY))
+			traverse_sample_fields(eon, desc, data, len);
+	} else
 		traverse_dynamic_fields(eon, desc, data, len);
 
 	return 0;
 }
 
 
-static void initialize_field_caches(suunto_eonsteel_parser_t *eon)
-{
-	memset(&eon->cache, 0, sizeof(eon->cache));
-	eon->cache.initialized = 1 << DC_FIELD_DIVETIME;
-
-	traverse_data(eon, traverse_fields, eon);
-
-	// The internal time fields are in ms and have to be added up
-	// like that. At the end, we translate it back to seconds.
-	eon->cache.DIVETIME /= 1000;
-}
-
 static void show_descriptor(suunto_eonsteel_parser_t *eon, int nr, struct type_desc *desc)
 {
 	int i;
 
-	if (!desc->desc)
+	if (!desc->desc || desc->stale)
 		return;
 	DEBUG(eon->base.context, "Descriptor %d: '%s', size %d bytes", nr, desc->desc, desc->size);
 	if (desc->format)
@@ -1492,16 +1747,51 @@ static void show_descriptor(suunto_eonsteel_parser_t *eon, int nr, struct type_d
 
 static void show_all_descriptors(suunto_eonsteel_parser_t *eon)
 {
-	for (unsigned int i = 0; i < MAXTYPE; ++i)
+	for (unsigned int i = 0; i < eon->ndescs; ++i)
 		show_descriptor(eon, i, eon->type_desc+i);
 }
 
+static void initialize_field_caches(suunto_eonsteel_parser_t *eon)
+{
+	dc_field_clear(&eon->cache);
+	eon->cache.initialized = 1 << DC_FIELD_DIVETIME;
+
+	traverse_data(eon, traverse_fields, eon);
+	show_all_descriptors(eon);
+
+	// The internal time fields are in ms and have to be added up
+	// like that. At the end, we translate it back to seconds.
+	eon->cache.DIVETIME /= 1000;
+
+	eon->cached = 1;
+}
+
 static dc_status_t
 suunto_eonsteel_parser_destroy(dc_parser_t *parser)
 {
 	suunto_eonsteel_parser_t *eon = (suunto_eonsteel_parser_t *) parser;
 
-	desc_free(eon->type_desc, MAXTYPE);
+	desc_free(eon->type_desc, eon->ndescs);
+	free(eon->type_desc);
+	dc_field_free(&eon->cache);
+	dc_string_clear(&eon->strings);
+
+	return DC_STATUS_SUCCESS;
+}
+
+static dc_status_t
+suunto_eonsteel_parser_reset(dc_parser_t *parser)
+{
+	suunto_eonsteel_parser_t *eon = (suunto_eonsteel_parser_t *) parser;
+
+	// The type descriptors are part of the dive data too, but
+	// they are kept around for the next dive, such that the ones
+	// that are recorded again don't have to be parsed.
+	for (unsigned int i = 0; i < eon->ndescs; i++)
+		eon->type_desc[i].stale = 1;
+	dc_field_clear(&eon->cache);
+	dc_string_clear(&eon->strings);
+	eon->cached = 0;
 
 	return DC_STATUS_SUCCESS;
 }
@@ -1514,7 +1804,13 @@ static const dc_parser_vtable_t suunto_eonsteel_parser_vtable = {
 	NULL, /* set_density */
 	suunto_eonsteel_parser_get_datetime, /* datetime */
 	suunto_eonsteel_parser_get_field, /* fields */
+	suunto_eonsteel_parser_get_summary, /* summary */
 	suunto_eonsteel_parser_samples_foreach, /* samples_foreach */
+	NULL, /* samples_batch */
+	suunto_eonsteel_parser_samples_fixed, /* samples_fixed */
+	NULL, /* samples_append */
+	NULL, /* samples_range */
+	suunto_eonsteel_parser_reset, /* reset */
 	suunto_eonsteel_parser_destroy /* destroy */
 };
 
@@ -1532,11 +1828,14 @@ suunto_eonsteel_parser_create(dc_parser_t **out, dc_context_t *context, const un
 		return DC_STATUS_NOMEMORY;
 	}
 
-	memset(&parser->type_desc, 0, sizeof(parser->type_desc));
-	memset(&parser->cache, 0, sizeof(parser->cache));
+	parser->type_desc = NULL;
+	parser->ndescs = 0;
+	dc_field_init(&parser->cache, context);
+	dc_string_init(&parser->strings, context);
+	parser->cached = 0;
 
-	initialize_field_caches(parser);
-	show_all_descriptors(parser);
+	// The field cache is initialized on first use, such that
+	// parsers created in summary mode can skip the samples.
 
 	*out = (dc_parser_t *) parser;
 
@@ -49,16 +49,15 @@ static const dc_device_vtable_t suunto_solution_device_vtable = {
 	DC_FAMILY_SUUNTO_SOLUTION,
 	NULL, /* set_fingerprint */
 	NULL, /* read */
+	NULL, /* read_range */
 	NULL, /* write */
 	suunto_solution_device_dump, /* dump */
 	suunto_solution_device_foreach, /* foreach */
+	NULL, /* foreach_header */
 	NULL, /* timesync */
 	NULL /* close */
 };
 
-static dc_status_t
-suunto_solution_extract_dives (dc_device_t *device, const unsigned char data[], unsigned int size, dc_dive_callback_t callback, void *userdata);
-
 dc_status_t
 suunto_solution_device_open (dc_device_t **out, dc_context_t *context, dc_iostream_t *iostream)
 {
@@ -235,7 +234,7 @@ suunto_solution_device_dump (dc_device_t *abstract, dc_buffer_t *buffer)
 static dc_status_t
 suunto_solution_device_foreach (dc_device_t *abstract, dc_dive_callback_t callback, void *userdata)
 {
-	dc_buffer_t *buffer = dc_buffer_new (SZ_MEMORY);
+	dc_buffer_t *buffer = dc_buffer_new_context (abstract->context, SZ_MEMORY);
 	if (buffer == NULL)
 		return DC_STATUS_NOMEMORY;
 
@@ -254,7 +253,7 @@ suunto_solution_device_foreach (dc_device_t *abstract, dc_dive_callback_t callba
 }
 
 
-static dc_status_t
+dc_status_t
 suunto_solution_extract_dives (dc_device_t *abstract, const unsigned char data[], unsigned int size, dc_dive_callback_t callback, void *userdata)
 {
 	if (abstract && !ISINSTANCE (abstract))
@@ -41,6 +41,7 @@ struct suunto_solution_parser_t {
 
 static dc_status_t suunto_solution_parser_get_field (dc_parser_t *abstract, dc_field_type_t type, unsigned int flags, void *value);
 static dc_status_t suunto_solution_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_t callback, void *userdata);
+static dc_status_t suunto_solution_parser_reset (dc_parser_t *abstract);
 
 static const dc_parser_vtable_t suunto_solution_parser_vtable = {
 	sizeof(suunto_solution_parser_t),
@@ -50,7 +51,13 @@ static const dc_parser_vtable_t suunto_solution_parser_vtable = {
 	NULL, /* set_density */
 	NULL, /* datetime */
 	suunto_solution_parser_get_field, /* fields */
+	NULL, /* summary */
 	suunto_solution_parser_samples_foreach, /* samples_foreach */
+	NULL, /* samples_batch */
+	NULL, /* samples_fixed */
+	NULL, /* samples_append */
+	NULL, /* samples_range */
+	suunto_solution_parser_reset, /* reset */
 	NULL /* destroy */
 };
 
@@ -71,12 +78,23 @@ suunto_solution_parser_create (dc_parser_t **out, dc_context_t *context, const u
 	}
 
 	// Set the default values.
+	suunto_solution_parser_reset ((dc_parser_t *) parser);
+
+	*out = (dc_parser_t*) parser;
+
+	return DC_STATUS_SUCCESS;
+}
+
+
+static dc_status_t
+suunto_solution_parser_reset (dc_parser_t *abstract)
+{
+	suunto_solution_parser_t *parser = (suunto_solution_parser_t *) abstract;
+
 	parser->cached = 0;
 	parser->divetime = 0;
 	parser->maxdepth = 0;
 
-	*out = (dc_parser_t*) parser;
-
 	return DC_STATUS_SUCCESS;
 }
 
@@ -23,6 +23,8 @@
 #include <stdlib.h> // malloc, free
 #include <assert.h>	// assert
 
+#include <libdivecomputer/ioctl.h>
+
 #include "suunto_vyper.h"
 #include "suunto_common.h"
 #include "context-private.h"
@@ -38,6 +40,10 @@
 #define SZ_MEMORY 0x2000
 #define SZ_PACKET 32
 
+#define MAXRETRIES 2
+#define MINDELAY   500
+#define MAXDELAY   1000
+
 #define HDR_DEVINFO_VYPER   0x24
 #define HDR_DEVINFO_SPYDER  0x16
 #define HDR_DEVINFO_BEGIN   (HDR_DEVINFO_SPYDER)
@@ -46,6 +52,7 @@
 typedef struct suunto_vyper_device_t {
 	suunto_common_device_t base;
 	dc_iostream_t *iostream;
+	device_delay_t delay;
 } suunto_vyper_device_t;
 
 static dc_status_t suunto_vyper_device_read (dc_device_t *abstract, unsigned int address, unsigned char data[], unsigned int size);
@@ -58,9 +65,11 @@ static const dc_device_vtable_t suunto_vyper_device_vtable = {
 	DC_FAMILY_SUUNTO_VYPER,
 	suunto_common_device_set_fingerprint, /* set_fingerprint */
 	suunto_vyper_device_read, /* read */
+	NULL, /* read_range */
 	suunto_vyper_device_write, /* write */
 	suunto_vyper_device_dump, /* dump */
 	suunto_vyper_device_foreach, /* foreach */
+	NULL, /* foreach_header */
 	NULL, /* timesync */
 	NULL /* close */
 };
@@ -103,6 +112,16 @@ suunto_vyper_device_open (dc_device_t **out, dc_context_t *context, dc_iostream_
 
 	// Set the default values.
 	device->iostream = iostream;
+	device_delay_init (&device->delay, MINDELAY, MAXDELAY);
+
+	// Request a low latency, because the protocol consists of many
+	// small packets. This is done first, because on some platforms
+	// it re-opens the serial port.
+	unsigned int latency = DC_LATENCY_LOW;
+	status = dc_iostream_ioctl (device->iostream, DC_IOCTL_SET_LATENCY, &latency, sizeof(latency));
+	if (status != DC_STATUS_SUCCESS && status != DC_STATUS_UNSUPPORTED) {
+		WARNING (context, "Failed to set the latency.");
+	}
 
 	// Set the serial communication protocol (2400 8O1).
 	status = dc_iostream_configure (device->iostream, 2400, 8, DC_PARITY_ODD, DC_STOPBITS_ONE, DC_FLOWCONTROL_NONE);
@@ -147,7 +166,7 @@ suunto_vyper_send (suunto_vyper_device_t *device, const unsigned char command[],
 	dc_status_t status = DC_STATUS_SUCCESS;
 	dc_device_t *abstract = (dc_device_t *) device;
 
-	dc_iostream_sleep (device->iostream, 500);
+	device_delay_wait (&device->delay, device->iostream);
 
 	// Set RTS to send the command.
 	status = dc_iostream_set_rts (device->iostream, 1);
@@ -231,6 +250,28 @@ suunto_vyper_transfer (suunto_vyper_device_t *device, const unsigned char comman
 }
 
 
+typedef struct suunto_vyper_request_t {
+	const unsigned char *command;
+	unsigned int csize;
+	unsigned char *answer;
+	unsigned int asize;
+	unsigned int size;
+} suunto_vyper_request_t;
+
+static dc_status_t
+suunto_vyper_attempt (dc_device_t *abstract, unsigned int attempt, void *userdata)
+{
+	suunto_vyper_device_t *device = (suunto_vyper_device_t *) abstract;
+	suunto_vyper_request_t *request = (suunto_vyper_request_t *) userdata;
+
+	// Increase the delay between the commands.
+	if (attempt)
+		device_delay_failure (&device->delay);
+
+	return suunto_vyper_transfer (device, request->command, request->csize, request->answer, request->asize, request->size);
+}
+
+
 static dc_status_t
 suunto_vyper_device_read (dc_device_t *abstract, unsigned int address, unsigned char data[], unsigned int size)
 {
@@ -249,10 +290,19 @@ suunto_vyper_device_read (dc_device_t *abstract, unsigned int address, unsigned
 				len, // count
 				0};  // CRC
 		command[4] = checksum_xor_uint8 (command, 4, 0x00);
-		dc_status_t rc = suunto_vyper_transfer (device, command, sizeof (command), answer, len + 5, len);
+
+		// Reading is idempotent, so a corrupted answer can safely be
+		// requested again. The delay before the command already gives
+		// the interface time to recover, and the timeout is left
+		// unchanged, because the dive download relies on it.
+		const device_retry_t policy = {MAXRETRIES, 0, 1, 0, 0};
+		suunto_vyper_request_t request = {command, sizeof (command), answer, len + 5, len};
+		dc_status_t rc = device_transfer_retry (abstract, device->iostream, &policy, suunto_vyper_attempt, &request);
 		if (rc != DC_STATUS_SUCCESS)
 			return rc;
 
+		device_delay_success (&device->delay);
+
 		memcpy (data, answer + 4, len);
 
 		nbytes += len;
@@ -505,7 +555,7 @@ suunto_vyper_device_foreach (dc_device_t *abstract, dc_dive_callback_t callback,
 	device_event_emit (abstract, DC_EVENT_DEVINFO, &devinfo);
 
 	// Allocate a memory buffer.
-	dc_buffer_t *buffer = dc_buffer_new (layout->rb_profile_end - layout->rb_profile_begin);
+	dc_buffer_t *buffer = dc_buffer_new_context (abstract->context, layout->rb_profile_end - layout->rb_profile_begin);
 	if (buffer == NULL)
 		return DC_STATUS_NOMEMORY;
 
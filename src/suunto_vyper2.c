@@ -40,6 +40,7 @@ typedef struct suunto_vyper2_device_t {
 } suunto_vyper2_device_t;
 
 static dc_status_t suunto_vyper2_device_packet (dc_device_t *abstract, const unsigned char command[], unsigned int csize, unsigned char answer[], unsigned int asize, unsigned int size);
+static dc_status_t suunto_vyper2_device_identify (dc_device_t *abstract);
 static dc_status_t suunto_vyper2_device_close (dc_device_t *abstract);
 
 static const suunto_common2_device_vtable_t suunto_vyper2_device_vtable = {
@@ -48,13 +49,16 @@ static const suunto_common2_device_vtable_t suunto_vyper2_device_vtable = {
 		DC_FAMILY_SUUNTO_VYPER2,
 		suunto_common2_device_set_fingerprint, /* set_fingerprint */
 		suunto_common2_device_read, /* read */
+		NULL, /* read_range */
 		suunto_common2_device_write, /* write */
 		suunto_common2_device_dump, /* dump */
 		suunto_common2_device_foreach, /* foreach */
+		NULL, /* foreach_header */
 		NULL, /* timesync */
 		suunto_vyper2_device_close /* close */
 	},
-	suunto_vyper2_device_packet
+	suunto_vyper2_device_packet,
+	suunto_vyper2_device_identify /* identify */
 };
 
 static const suunto_common2_layout_t suunto_vyper2_layout = {
@@ -62,7 +66,8 @@ static const suunto_common2_layout_t suunto_vyper2_layout = {
 	0x0011, /* fingerprint */
 	0x0023, /* serial */
 	0x019A, /* rb_profile_begin */
-	0x7FFE /* rb_profile_end */
+	0x7FFE, /* rb_profile_end */
+	0x0078 /* packetsize */
 };
 
 static const suunto_common2_layout_t suunto_helo2_layout = {
@@ -70,7 +75,8 @@ static const suunto_common2_layout_t suunto_helo2_layout = {
 	0x0017, /* fingerprint */
 	0x0023, /* serial */
 	0x019A, /* rb_profile_begin */
-	0x7FFE /* rb_profile_end */
+	0x7FFE, /* rb_profile_end */
+	0x0078 /* packetsize */
 };
 
 
@@ -134,11 +140,32 @@ suunto_vyper2_device_open (dc_device_t **out, dc_context_t *context, dc_iostream
 		goto error_timer_free;
 	}
 
+	// The version info is only read when the memory layout is needed,
+	// such that plain memory reads and writes avoid the round trip.
+
+	*out = (dc_device_t*) device;
+
+	return DC_STATUS_SUCCESS;
+
+error_timer_free:
+	dc_timer_free (device->timer);
+error_free:
+	dc_device_deallocate ((dc_device_t *) device);
+	return status;
+}
+
+
+static dc_status_t
+suunto_vyper2_device_identify (dc_device_t *abstract)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	suunto_vyper2_device_t *device = (suunto_vyper2_device_t *) abstract;
+
 	// Read the version info.
-	status = suunto_common2_device_version ((dc_device_t *) device, device->base.version, sizeof (device->base.version));
+	status = suunto_common2_device_version (abstract, device->base.version, sizeof (device->base.version));
 	if (status != DC_STATUS_SUCCESS) {
-		ERROR (context, "Failed to read the version info.");
-		goto error_timer_free;
+		ERROR (abstract->context, "Failed to read the version info.");
+		return status;
 	}
 
 	// Override the base class values.
@@ -148,15 +175,7 @@ suunto_vyper2_device_open (dc_device_t **out, dc_context_t *context, dc_iostream
 	else
 		device->base.layout = &suunto_vyper2_layout;
 
-	*out = (dc_device_t*) device;
-
 	return DC_STATUS_SUCCESS;
-
-error_timer_free:
-	dc_timer_free (device->timer);
-error_free:
-	dc_device_deallocate ((dc_device_t *) device);
-	return status;
 }
 
 
@@ -50,6 +50,7 @@ struct suunto_vyper_parser_t {
 static dc_status_t suunto_vyper_parser_get_datetime (dc_parser_t *abstract, dc_datetime_t *datetime);
 static dc_status_t suunto_vyper_parser_get_field (dc_parser_t *abstract, dc_field_type_t type, unsigned int flags, void *value);
 static dc_status_t suunto_vyper_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_t callback, void *userdata);
+static dc_status_t suunto_vyper_parser_reset (dc_parser_t *abstract);
 
 static const dc_parser_vtable_t suunto_vyper_parser_vtable = {
 	sizeof(suunto_vyper_parser_t),
@@ -59,7 +60,13 @@ static const dc_parser_vtable_t suunto_vyper_parser_vtable = {
 	NULL, /* set_density */
 	suunto_vyper_parser_get_datetime, /* datetime */
 	suunto_vyper_parser_get_field, /* fields */
+	NULL, /* summary */
 	suunto_vyper_parser_samples_foreach, /* samples_foreach */
+	NULL, /* samples_batch */
+	NULL, /* samples_fixed */
+	NULL, /* samples_append */
+	NULL, /* samples_range */
+	suunto_vyper_parser_reset, /* reset */
 	NULL /* destroy */
 };
 
@@ -178,18 +185,29 @@ suunto_vyper_parser_create (dc_parser_t **out, dc_context_t *context, const unsi
 	}
 
 	// Set the default values.
+	parser->serial = serial;
+	suunto_vyper_parser_reset ((dc_parser_t *) parser);
+
+	*out = (dc_parser_t*) parser;
+
+	return DC_STATUS_SUCCESS;
+}
+
+
+static dc_status_t
+suunto_vyper_parser_reset (dc_parser_t *abstract)
+{
+	suunto_vyper_parser_t *parser = (suunto_vyper_parser_t *) abstract;
+
 	parser->cached = 0;
 	parser->divetime = 0;
 	parser->maxdepth = 0;
 	parser->marker = 0;
 	parser->ngasmixes = 0;
-	parser->serial = serial;
 	for (unsigned int i = 0; i < NGASMIXES; ++i) {
 		parser->oxygen[i] = 0;
 	}
 
-	*out = (dc_parser_t*) parser;
-
 	return DC_STATUS_SUCCESS;
 }
 
@@ -227,6 +245,7 @@ suunto_vyper_parser_get_field (dc_parser_t *abstract, dc_field_type_t type, unsi
 	dc_tank_t *tank = (dc_tank_t *) value;
 	dc_decomodel_t *decomodel = (dc_decomodel_t *) value;
 	dc_field_string_t *string = (dc_field_string_t *) value;
+	dc_sample_interval_t *interval = (dc_sample_interval_t *) value;
 	char buf[BUFLEN];
 
 	// Cache the data.
@@ -304,6 +323,12 @@ suunto_vyper_parser_get_field (dc_parser_t *abstract, dc_field_type_t type, unsi
 			}
 			string->value = strdup(buf);
 			break;
+		case DC_FIELD_SAMPLE_INTERVAL:
+			if (data[3] == 0)
+				return DC_STATUS_DATAFORMAT;
+			interval->interval = data[3] * 1000;
+			interval->regular = 1;
+			break;
 		default:
 			return DC_STATUS_UNSUPPORTED;
 		}
@@ -26,6 +26,7 @@
 #include "context-private.h"
 #include "device-private.h"
 #include "array.h"
+#include "checksum.h"
 
 #define ISINSTANCE(device) dc_device_isinstance((device), &tecdiving_divecomputereu_device_vtable)
 
@@ -70,30 +71,15 @@ static const dc_device_vtable_t tecdiving_divecomputereu_device_vtable = {
 	DC_FAMILY_TECDIVING_DIVECOMPUTEREU,
 	tecdiving_divecomputereu_device_set_fingerprint, /* set_fingerprint */
 	NULL, /* read */
+	NULL, /* read_range */
 	NULL, /* write */
 	NULL, /* dump */
 	tecdiving_divecomputereu_device_foreach, /* foreach */
+	NULL, /* foreach_header */
 	NULL, /* timesync */
 	tecdiving_divecomputereu_device_close, /* close */
 };
 
-static unsigned short
-checksum_crc (const unsigned char data[], unsigned int size, unsigned short init)
-{
-	unsigned short crc = init;
-	for (unsigned int i = 0; i < size; ++i) {
-		crc ^= data[i] << 8;
-		if (crc & 0x8000) {
-			crc <<= 1;
-			crc ^= 0x1021;
-		} else {
-			crc <<= 1;
-		}
-	}
-
-	return crc;
-}
-
 static dc_status_t
 tecdiving_divecomputereu_send (tecdiving_divecomputereu_device_t *device, unsigned char cmd, const unsigned char data[], size_t size)
 {
@@ -120,7 +106,7 @@ tecdiving_divecomputereu_send (tecdiving_divecomputereu_device_t *device, unsign
 	if (size) {
 		memcpy(packet + 7, data, size);
 	}
-	crc = checksum_crc (packet + 1, size + 6, 0);
+	crc = checksum_crc16_ccitt_1bit (packet + 1, size + 6, 0);
 	packet[size +  7] = (crc >> 8) & 0xFF;
 	packet[size +  8] = (crc     ) & 0xFF;
 	packet[size +  9] = 0x00;
@@ -166,6 +152,8 @@ tecdiving_divecomputereu_receive (tecdiving_divecomputereu_device_t *device, uns
 			if (nretries++ >= MAXRETRIES)
 				return status;
 
+			device_stats_retry (abstract);
+
 			// Cancel if requested by the user.
 			if (device_is_cancelled (abstract))
 				return DC_STATUS_CANCELLED;
@@ -239,8 +227,8 @@ tecdiving_divecomputereu_receive (tecdiving_divecomputereu_device_t *device, uns
 	// Verify the checksum.
 	unsigned short crc = array_uint16_be (checksum);
 	unsigned short ccrc = 0;
-	ccrc = checksum_crc (header + 1, sizeof(header) - 1, ccrc);
-	ccrc = checksum_crc (data, length, ccrc);
+	ccrc = checksum_crc16_ccitt_1bit (header + 1, sizeof(header) - 1, ccrc);
+	ccrc = checksum_crc16_ccitt_1bit (data, length, ccrc);
 	if (crc != ccrc || checksum[2] != 0x00 || checksum[3] != 0) {
 		ERROR (abstract->context, "Unexpected packet checksum.");
 		return DC_STATUS_PROTOCOL;
@@ -48,7 +48,13 @@ static const dc_parser_vtable_t tecdiving_divecomputereu_parser_vtable = {
 	NULL, /* set_density */
 	tecdiving_divecomputereu_parser_get_datetime, /* datetime */
 	tecdiving_divecomputereu_parser_get_field, /* fields */
+	NULL, /* summary */
 	tecdiving_divecomputereu_parser_samples_foreach, /* samples_foreach */
+	NULL, /* samples_batch */
+	NULL, /* samples_fixed */
+	NULL, /* samples_append */
+	NULL, /* samples_range */
+	NULL, /* reset */
 	NULL /* destroy */
 };
 
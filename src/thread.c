@@ -0,0 +1,351 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2026 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <errno.h>
+#include <time.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOGDI
+#include <windows.h>
+#include <process.h>
+#else
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#endif
+
+#include "thread.h"
+
+struct dc_thread_t {
+	dc_thread_func_t func;
+	void *userdata;
+#if defined(_WIN32)
+	HANDLE handle;
+#elif defined(HAVE_PTHREAD_H)
+	pthread_t handle;
+#endif
+};
+
+struct dc_cond_t {
+#if defined(_WIN32)
+	HANDLE handle;
+#elif defined(HAVE_PTHREAD_H)
+	pthread_cond_t handle;
+#else
+	int dummy;
+#endif
+};
+
+void
+dc_mutex_lock (dc_mutex_t *mutex)
+{
+#if defined(_WIN32)
+	while (InterlockedCompareExchange (mutex, 1, 0) == 1) {
+		SleepEx (0, TRUE);
+	}
+#elif defined(HAVE_PTHREAD_H)
+	pthread_mutex_lock (mutex);
+#endif
+}
+
+void
+dc_mutex_unlock (dc_mutex_t *mutex)
+{
+#if defined(_WIN32)
+	InterlockedExchange (mutex, 0);
+#elif defined(HAVE_PTHREAD_H)
+	pthread_mutex_unlock (mutex);
+#endif
+}
+
+long
+dc_atomic_load (dc_atomic_t *atomic)
+{
+#if defined(_WIN32)
+	return InterlockedCompareExchange (atomic, 0, 0);
+#elif defined(__GNUC__)
+	return __atomic_load_n (atomic, __ATOMIC_SEQ_CST);
+#else
+	return *atomic;
+#endif
+}
+
+void
+dc_atomic_store (dc_atomic_t *atomic, long value)
+{
+#if defined(_WIN32)
+	InterlockedExchange (atomic, value);
+#elif defined(__GNUC__)
+	__atomic_store_n (atomic, value, __ATOMIC_SEQ_CST);
+#else
+	*atomic = value;
+#endif
+}
+
+long
+dc_atomic_add (dc_atomic_t *atomic, long value)
+{
+#if defined(_WIN32)
+	return InterlockedExchangeAdd (atomic, value);
+#elif defined(__GNUC__)
+	return __atomic_fetch_add (atomic, value, __ATOMIC_SEQ_CST);
+#else
+	long previous = *atomic;
+	*atomic += value;
+	return previous;
+#endif
+}
+
+dc_status_t
+dc_cond_new (dc_cond_t **out)
+{
+#if defined(_WIN32) || defined(HAVE_PTHREAD_H)
+	dc_cond_t *cond = NULL;
+
+	if (out == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	cond = (dc_cond_t *) malloc (sizeof (dc_cond_t));
+	if (cond == NULL)
+		return DC_STATUS_NOMEMORY;
+
+#if defined(_WIN32)
+	cond->handle = CreateEvent (NULL, FALSE, FALSE, NULL);
+	if (cond->handle == NULL) {
+		free (cond);
+		return DC_STATUS_IO;
+	}
+#else
+	if (pthread_cond_init (&cond->handle, NULL) != 0) {
+		free (cond);
+		return DC_STATUS_IO;
+	}
+#endif
+
+	*out = cond;
+
+	return DC_STATUS_SUCCESS;
+#else
+	return DC_STATUS_UNSUPPORTED;
+#endif
+}
+
+void
+dc_cond_free (dc_cond_t *cond)
+{
+	if (cond == NULL)
+		return;
+
+#if defined(_WIN32)
+	CloseHandle (cond->handle);
+#elif defined(HAVE_PTHREAD_H)
+	pthread_cond_destroy (&cond->handle);
+#endif
+
+	free (cond);
+}
+
+void
+dc_cond_wait (dc_cond_t *cond, dc_mutex_t *mutex)
+{
+#if defined(_WIN32)
+	dc_mutex_unlock (mutex);
+	WaitForSingleObject (cond->handle, INFINITE);
+	dc_mutex_lock (mutex);
+#elif defined(HAVE_PTHREAD_H)
+	pthread_cond_wait (&cond->handle, mutex);
+#endif
+}
+
+dc_status_t
+dc_cond_timedwait (dc_cond_t *cond, dc_mutex_t *mutex, unsigned int timeout)
+{
+#if defined(_WIN32)
+	DWORD rc = 0;
+
+	dc_mutex_unlock (mutex);
+	rc = WaitForSingleObject (cond->handle, timeout);
+	dc_mutex_lock (mutex);
+
+	return rc == WAIT_TIMEOUT ? DC_STATUS_TIMEOUT : DC_STATUS_SUCCESS;
+#elif defined(HAVE_PTHREAD_H)
+	struct timespec ts;
+	int rc = 0;
+
+	clock_gettime (CLOCK_REALTIME, &ts);
+	ts.tv_sec += timeout / 1000;
+	ts.tv_nsec += (timeout % 1000) * 1000000L;
+	if (ts.tv_nsec >= 1000000000L) {
+		ts.tv_sec++;
+		ts.tv_nsec -= 1000000000L;
+	}
+
+	rc = pthread_cond_timedwait (&cond->handle, mutex, &ts);
+
+	return rc == ETIMEDOUT ? DC_STATUS_TIMEOUT : DC_STATUS_SUCCESS;
+#else
+	return DC_STATUS_UNSUPPORTED;
+#endif
+}
+
+void
+dc_cond_signal (dc_cond_t *cond)
+{
+#if defined(_WIN32)
+	SetEvent (cond->handle);
+#elif defined(HAVE_PTHREAD_H)
+	pthread_cond_signal (&cond->handle);
+#endif
+}
+
+#if defined(_WIN32)
+static unsigned int __stdcall
+dc_thread_main (void *arg)
+{
+	dc_thread_t *thread = (dc_thread_t *) arg;
+
+	thread->func (thread->userdata);
+
+	return 0;
+}
+#elif defined(HAVE_PTHREAD_H)
+static void *
+dc_thread_main (void *arg)
+{
+	dc_thread_t *thread = (dc_thread_t *) arg;
+
+	thread->func (thread->userdata);
+
+	return NULL;
+}
+#endif
+
+dc_status_t
+dc_thread_new (dc_thread_t **out, dc_thread_func_t func, void *userdata)
+{
+#if defined(_WIN32) || defined(HAVE_PTHREAD_H)
+	dc_thread_t *thread = NULL;
+
+	if (out == NULL || func == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	thread = (dc_thread_t *) malloc (sizeof (dc_thread_t));
+	if (thread == NULL)
+		return DC_STATUS_NOMEMORY;
+
+	thread->func = func;
+	thread->userdata = userdata;
+
+#if defined(_WIN32)
+	thread->handle = (HANDLE) _beginthreadex (NULL, 0, dc_thread_main, thread, 0, NULL);
+	if (thread->handle == NULL) {
+		free (thread);
+		return DC_STATUS_IO;
+	}
+#else
+	if (pthread_create (&thread->handle, NULL, dc_thread_main, thread) != 0) {
+		free (thread);
+		return DC_STATUS_IO;
+	}
+#endif
+
+	*out = thread;
+
+	return DC_STATUS_SUCCESS;
+#else
+	return DC_STATUS_UNSUPPORTED;
+#endif
+}
+
+dc_status_t
+dc_thread_join (dc_thread_t *thread)
+{
+	if (thread == NULL)
+		return DC_STATUS_SUCCESS;
+
+#if defined(_WIN32)
+	WaitForSingleObject (thread->handle, INFINITE);
+	CloseHandle (thread->handle);
+#elif defined(HAVE_PTHREAD_H)
+	pthread_join (thread->handle, NULL);
+#endif
+
+	free (thread);
+
+	return DC_STATUS_SUCCESS;
+}
+
+unsigned int
+dc_thread_get_concurrency (void)
+{
+	long n = 1;
+
+#if defined(_WIN32)
+	SYSTEM_INFO info;
+	GetSystemInfo (&info);
+	n = info.dwNumberOfProcessors;
+#elif defined(_SC_NPROCESSORS_ONLN)
+	n = sysconf (_SC_NPROCESSORS_ONLN);
+#endif
+
+	if (n < 1)
+		n = 1;
+
+	return n;
+}
+
+unsigned int
+dc_thread_pool_run (unsigned int nthreads, dc_thread_func_t func, void *userdata)
+{
+	dc_thread_t **threads = NULL;
+	unsigned int n = 1;
+
+	if (nthreads == 0)
+		nthreads = dc_thread_get_concurrency ();
+
+	if (nthreads > 1) {
+		threads = (dc_thread_t **) malloc ((nthreads - 1) * sizeof (dc_thread_t *));
+	}
+
+	if (threads != NULL) {
+		while (n < nthreads) {
+			if (dc_thread_new (&threads[n - 1], func, userdata) != DC_STATUS_SUCCESS)
+				break;
+			n++;
+		}
+	}
+
+	func (userdata);
+
+	for (unsigned int i = 1; i < n; ++i) {
+		dc_thread_join (threads[i - 1]);
+	}
+
+	free (threads);
+
+	return n;
+}
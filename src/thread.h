@@ -0,0 +1,151 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2026 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+#ifndef DC_THREAD_H
+#define DC_THREAD_H
+
+/*
+ * The layout of dc_mutex_t depends on HAVE_PTHREAD_H, so the header
+ * pulls in config.h itself rather than relying on every includer to
+ * have done so first.
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
+
+#include <libdivecomputer/common.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/*
+ * A mutex that can be initialized statically with DC_MUTEX_INIT. On
+ * Windows, it's implemented as a simple spinlock, so it should only be
+ * held for short periods of time.
+ */
+#if defined(_WIN32)
+typedef long dc_mutex_t;
+#define DC_MUTEX_INIT 0
+#elif defined(HAVE_PTHREAD_H)
+typedef pthread_mutex_t dc_mutex_t;
+#define DC_MUTEX_INIT PTHREAD_MUTEX_INITIALIZER
+#else
+typedef int dc_mutex_t;
+#define DC_MUTEX_INIT 0
+#endif
+
+/*
+ * An integer that can be updated atomically from multiple threads.
+ */
+typedef volatile long dc_atomic_t;
+
+typedef struct dc_thread_t dc_thread_t;
+
+typedef struct dc_cond_t dc_cond_t;
+
+typedef void (*dc_thread_func_t) (void *userdata);
+
+void
+dc_mutex_lock (dc_mutex_t *mutex);
+
+void
+dc_mutex_unlock (dc_mutex_t *mutex);
+
+long
+dc_atomic_load (dc_atomic_t *atomic);
+
+void
+dc_atomic_store (dc_atomic_t *atomic, long value);
+
+/*
+ * Add the value, and return the previous value.
+ */
+long
+dc_atomic_add (dc_atomic_t *atomic, long value);
+
+/*
+ * Create a condition variable. Returns DC_STATUS_UNSUPPORTED on
+ * platforms without thread support. On Windows, a signal wakes up at
+ * most one thread, and is remembered if no thread is waiting, so each
+ * condition variable should have only a single waiting thread.
+ */
+dc_status_t
+dc_cond_new (dc_cond_t **cond);
+
+void
+dc_cond_free (dc_cond_t *cond);
+
+/*
+ * Atomically release the mutex and wait for a signal. The mutex is
+ * locked again before returning. Spurious wakeups are possible, so the
+ * caller should always re-check its condition.
+ */
+void
+dc_cond_wait (dc_cond_t *cond, dc_mutex_t *mutex);
+
+/*
+ * Same as dc_cond_wait, but give up after the specified number of
+ * milliseconds. Returns DC_STATUS_TIMEOUT if no signal was received.
+ */
+dc_status_t
+dc_cond_timedwait (dc_cond_t *cond, dc_mutex_t *mutex, unsigned int timeout);
+
+void
+dc_cond_signal (dc_cond_t *cond);
+
+/*
+ * Start a new thread. Returns DC_STATUS_UNSUPPORTED on platforms
+ * without thread support.
+ */
+dc_status_t
+dc_thread_new (dc_thread_t **thread, dc_thread_func_t func, void *userdata);
+
+/*
+ * Wait for the thread to finish, and free it.
+ */
+dc_status_t
+dc_thread_join (dc_thread_t *thread);
+
+/*
+ * Get the number of processors that are available to run threads.
+ */
+unsigned int
+dc_thread_get_concurrency (void);
+
+/*
+ * Run the function on a pool of worker threads, and wait for all of
+ * them to finish. The calling thread acts as the first worker, so the
+ * function runs at least once, even when no threads can be started.
+ * With zero threads, the number of processors is used. Returns the
+ * number of workers that did run.
+ */
+unsigned int
+dc_thread_pool_run (unsigned int nthreads, dc_thread_func_t func, void *userdata);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+#endif /* DC_THREAD_H */
@@ -40,18 +40,57 @@
 #include "timer.h"
 
 struct dc_timer_t {
+	dc_nsecs_t timestamp;
+};
+
 #if defined (_WIN32)
-	LARGE_INTEGER timestamp;
-	LARGE_INTEGER frequency;
+static LONGLONG g_frequency = 0;
+#elif defined (HAVE_CLOCK_GETTIME)
+#elif defined (HAVE_MACH_ABSOLUTE_TIME)
+static mach_timebase_info_data_t g_timebase = {0, 0};
+#endif
+
+dc_nsecs_t
+dc_clock_monotonic (void)
+{
+#if defined (_WIN32)
+	LARGE_INTEGER now;
+	LONGLONG frequency = g_frequency;
+	if (frequency == 0) {
+		// The frequency is fixed at system boot, so it only needs to be
+		// queried once. Concurrent callers store the same value.
+		LARGE_INTEGER value;
+		if (!QueryPerformanceFrequency (&value))
+			return 0;
+		frequency = g_frequency = value.QuadPart;
+	}
+
+	QueryPerformanceCounter (&now);
+
+	// Split the conversion to avoid overflowing the intermediate result.
+	return (dc_nsecs_t) (now.QuadPart / frequency) * 1000000000 +
+		(dc_nsecs_t) (now.QuadPart % frequency) * 1000000000 / frequency;
 #elif defined (HAVE_CLOCK_GETTIME)
-	struct timespec timestamp;
+	struct timespec now;
+	clock_gettime (CLOCK_MONOTONIC, &now);
+	return (dc_nsecs_t) now.tv_sec * 1000000000 + now.tv_nsec;
 #elif defined (HAVE_MACH_ABSOLUTE_TIME)
-	uint64_t timestamp;
-	mach_timebase_info_data_t info;
+	mach_timebase_info_data_t timebase = g_timebase;
+	if (timebase.denom == 0) {
+		if (mach_timebase_info (&timebase) != KERN_SUCCESS)
+			return 0;
+		g_timebase = timebase;
+	}
+
+	uint64_t now = mach_absolute_time ();
+	return (dc_nsecs_t) (now / timebase.denom) * timebase.numer +
+		(dc_nsecs_t) (now % timebase.denom) * timebase.numer / timebase.denom;
 #else
-	struct timeval timestamp;
+	struct timeval now;
+	gettimeofday (&now, NULL);
+	return (dc_nsecs_t) now.tv_sec * 1000000000 + (dc_nsecs_t) now.tv_usec * 1000;
 #endif
-};
+}
 
 dc_status_t
 dc_timer_new (dc_timer_t **out)
@@ -66,30 +105,7 @@ dc_timer_new (dc_timer_t **out)
 		return DC_STATUS_NOMEMORY;
 	}
 
-#if defined (_WIN32)
-	if (!QueryPerformanceFrequency(&timer->frequency) ||
-		!QueryPerformanceCounter(&timer->timestamp)) {
-		free(timer);
-		return DC_STATUS_IO;
-	}
-#elif defined (HAVE_CLOCK_GETTIME)
-	if (clock_gettime(CLOCK_MONOTONIC, &timer->timestamp) != 0) {
-		free(timer);
-		return DC_STATUS_IO;
-	}
-#elif defined (HAVE_MACH_ABSOLUTE_TIME)
-	if (mach_timebase_info(&timer->info) != KERN_SUCCESS) {
-		free(timer);
-		return DC_STATUS_IO;
-	}
-
-	timer->timestamp = mach_absolute_time();
-#else
-	if (gettimeofday (&timer->timestamp, NULL) != 0) {
-		free(timer);
-		return DC_STATUS_IO;
-	}
-#endif
+	timer->timestamp = dc_clock_now ();
 
 	*out = timer;
 
@@ -107,44 +123,7 @@ dc_timer_now (dc_timer_t *timer, dc_usecs_t *usecs)
 		goto out;
 	}
 
-#if defined (_WIN32)
-	LARGE_INTEGER now;
-	if (!QueryPerformanceCounter(&now)) {
-		status = DC_STATUS_IO;
-		goto out;
-	}
-
-	value = (now.QuadPart - timer->timestamp.QuadPart) * 1000000 / timer->frequency.QuadPart;
-#elif defined (HAVE_CLOCK_GETTIME)
-	struct timespec now, delta;
-	if (clock_gettime(CLOCK_MONOTONIC, &now) != 0) {
-		status = DC_STATUS_IO;
-		goto out;
-	}
-
-	if (now.tv_nsec < timer->timestamp.tv_nsec) {
-		delta.tv_nsec = 1000000000 + now.tv_nsec - timer->timestamp.tv_nsec;
-		delta.tv_sec = now.tv_sec - timer->timestamp.tv_sec - 1;
-	} else {
-		delta.tv_nsec = now.tv_nsec - timer->timestamp.tv_nsec;
-		delta.tv_sec = now.tv_sec - timer->timestamp.tv_sec;
-	}
-
-	value = (dc_usecs_t) delta.tv_sec * 1000000 + delta.tv_nsec / 1000;
-#elif defined (HAVE_MACH_ABSOLUTE_TIME)
-	uint64_t now = mach_absolute_time();
-	value = (now - timer->timestamp) * timer->info.numer / (timer->info.denom * 1000);
-#else
-	struct timeval now, delta;
-	if (gettimeofday (&now, NULL) != 0) {
-		status = DC_STATUS_IO;
-		goto out;
-	}
-
-	timersub (&now, &timer->timestamp, &delta);
-
-	value = (dc_usecs_t) delta.tv_sec * 1000000 + delta.tv_usec;
-#endif
+	value = (dc_clock_now () - timer->timestamp) / 1000;
 
 out:
 	if (usecs)
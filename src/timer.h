@@ -24,6 +24,10 @@
 
 #include <libdivecomputer/common.h>
 
+#if defined (HAVE_CLOCK_GETTIME) && !defined (_WIN32)
+#include <time.h>
+#endif
+
 #ifdef __cplusplus
 extern "C" {
 #endif /* __cplusplus */
@@ -34,8 +38,30 @@ typedef unsigned __int64 dc_usecs_t;
 typedef unsigned long long dc_usecs_t;
 #endif
 
+typedef unsigned long long dc_nsecs_t;
+
 typedef struct dc_timer_t dc_timer_t;
 
+/*
+ * Monotonic timestamp in nanoseconds, relative to an unspecified
+ * starting point. Unlike the timer object, this requires no allocation
+ * and is cheap enough to call for every packet.
+ */
+dc_nsecs_t
+dc_clock_monotonic (void);
+
+#if defined (HAVE_CLOCK_GETTIME) && !defined (_WIN32)
+static inline dc_nsecs_t
+dc_clock_now (void)
+{
+	struct timespec ts;
+	clock_gettime (CLOCK_MONOTONIC, &ts);
+	return (dc_nsecs_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+#else
+#define dc_clock_now dc_clock_monotonic
+#endif
+
 dc_status_t
 dc_timer_new (dc_timer_t **timer);
 
@@ -42,9 +42,19 @@
 #include "iterator-private.h"
 #include "platform.h"
 #include "array.h"
+#include "thread.h"
+#include "timer.h"
 
 #define ISINSTANCE(device) dc_iostream_isinstance((device), &dc_usb_vtable)
 
+// Time (in milliseconds) between two scans of the bus, for monitors
+// without hotplug support.
+#define SCAN_INTERVAL 1000
+
+#if defined(HAVE_LIBUSB) && defined(LIBUSB_API_VERSION) && (LIBUSB_API_VERSION >= 0x01000102)
+#define USE_HOTPLUG
+#endif
+
 typedef struct dc_usb_params_t {
 	unsigned int interface;
 	unsigned char endpoint_in;
@@ -94,6 +104,36 @@ typedef struct dc_usb_iterator_t {
 	size_t current;
 } dc_usb_iterator_t;
 
+#ifdef USE_HOTPLUG
+typedef struct dc_usb_event_t {
+	struct libusb_device *handle;
+	dc_hotplug_t event;
+} dc_usb_event_t;
+#endif
+
+struct dc_usb_monitor_t {
+	dc_context_t *context;
+	dc_descriptor_t *descriptor;
+	dc_usb_session_t *session;
+	dc_usb_monitor_callback_t callback;
+	void *userdata;
+	dc_timer_t *timer;
+	/* The devices that are currently present. */
+	dc_usb_device_t **devices;
+	size_t count;
+	size_t capacity;
+#ifdef USE_HOTPLUG
+	/* The hotplug notifications that are not processed yet. They
+	 * can arrive on any thread that handles the usb events. */
+	int hotplug;
+	libusb_hotplug_callback_handle handle;
+	dc_mutex_t mutex;
+	dc_usb_event_t *events;
+	size_t nevents;
+	size_t maxevents;
+#endif
+};
+
 typedef struct dc_usb_t {
 	/* Base class. */
 	dc_iostream_t base;
@@ -124,10 +164,14 @@ static const dc_iostream_vtable_t dc_usb_vtable = {
 	dc_usb_poll, /* poll */
 	dc_usb_read, /* read */
 	dc_usb_write, /* write */
+	NULL, /* read_async */
+	NULL, /* write_async */
+	NULL, /* writev */
 	dc_usb_ioctl, /* ioctl */
 	NULL, /* flush */
 	NULL, /* purge */
 	NULL, /* sleep */
+	NULL, /* set_interrupt */
 	dc_usb_close, /* close */
 };
 
@@ -172,6 +216,17 @@ syserror(int errcode)
 	}
 }
 
+#ifdef USE_HOTPLUG
+static const dc_mutex_t mutex_init = DC_MUTEX_INIT;
+#endif
+
+static dc_mutex_t g_usb_mutex = DC_MUTEX_INIT;
+static dc_usb_session_t *g_usb_session = NULL;
+
+/*
+ * The session is shared by all iterators, monitors and connections, to
+ * avoid initializing the usb library again for every scan.
+ */
 static dc_status_t
 dc_usb_session_new (dc_usb_session_t **out, dc_context_t *context)
 {
@@ -181,6 +236,15 @@ dc_usb_session_new (dc_usb_session_t **out, dc_context_t *context)
 	if (out == NULL)
 		return DC_STATUS_INVALIDARGS;
 
+	dc_mutex_lock (&g_usb_mutex);
+
+	if (g_usb_session) {
+		g_usb_session->refcount++;
+		*out = g_usb_session;
+		dc_mutex_unlock (&g_usb_mutex);
+		return DC_STATUS_SUCCESS;
+	}
+
 	session = (dc_usb_session_t *) malloc (sizeof(dc_usb_session_t));
 	if (session == NULL) {
 		ERROR (context, "Failed to allocate memory.");
@@ -198,6 +262,10 @@ dc_usb_session_new (dc_usb_session_t **out, dc_context_t *context)
 		goto error_free;
 	}
 
+	g_usb_session = session;
+
+	dc_mutex_unlock (&g_usb_mutex);
+
 	*out = session;
 
 	return status;
@@ -205,6 +273,7 @@ dc_usb_session_new (dc_usb_session_t **out, dc_context_t *context)
 error_free:
 	free (session);
 error_unlock:
+	dc_mutex_unlock (&g_usb_mutex);
 	return status;
 }
 
@@ -214,8 +283,12 @@ dc_usb_session_ref (dc_usb_session_t *session)
 	if (session == NULL)
 		return NULL;
 
+	dc_mutex_lock (&g_usb_mutex);
+
 	session->refcount++;
 
+	dc_mutex_unlock (&g_usb_mutex);
+
 	return session;
 }
 
@@ -225,11 +298,16 @@ dc_usb_session_unref (dc_usb_session_t *session)
 	if (session == NULL)
 		return DC_STATUS_SUCCESS;
 
+	dc_mutex_lock (&g_usb_mutex);
+
 	if (--session->refcount == 0) {
 		libusb_exit (session->handle);
+		g_usb_session = NULL;
 		free (session);
 	}
 
+	dc_mutex_unlock (&g_usb_mutex);
+
 	return DC_STATUS_SUCCESS;
 }
 #endif
@@ -317,105 +395,139 @@ error_free:
 }
 
 #ifdef HAVE_LIBUSB
+/*
+ * Create a new device for the USB device, if it matches the device
+ * descriptor and has the necessary interface and endpoints. Otherwise
+ * no device is returned.
+ */
 static dc_status_t
-dc_usb_iterator_next (dc_iterator_t *abstract, void *out)
+dc_usb_device_new (dc_usb_device_t **out, dc_context_t *context, dc_usb_session_t *session, dc_descriptor_t *descriptor, struct libusb_device *current)
 {
-	dc_usb_iterator_t *iterator = (dc_usb_iterator_t *) abstract;
 	dc_usb_device_t *device = NULL;
 
-	while (iterator->current < iterator->count) {
-		struct libusb_device *current = iterator->devices[iterator->current++];
+	*out = NULL;
 
-		// Get the device descriptor.
-		struct libusb_device_descriptor dev;
-		int rc = libusb_get_device_descriptor (current, &dev);
-		if (rc < 0) {
-			ERROR (abstract->context, "Failed to get the device descriptor (%s).",
-				libusb_error_name (rc));
-			return syserror (rc);
-		}
+	// Get the device descriptor.
+	struct libusb_device_descriptor dev;
+	int rc = libusb_get_device_descriptor (current, &dev);
+	if (rc < 0) {
+		ERROR (context, "Failed to get the device descriptor (%s).",
+			libusb_error_name (rc));
+		return syserror (rc);
+	}
 
-		dc_usb_desc_t usb = {dev.idVendor, dev.idProduct};
-		if (!dc_descriptor_filter (iterator->descriptor, DC_TRANSPORT_USB, &usb)) {
-			continue;
-		}
+	dc_usb_desc_t usb = {dev.idVendor, dev.idProduct};
+	if (!dc_descriptor_filter (descriptor, DC_TRANSPORT_USB, &usb)) {
+		return DC_STATUS_SUCCESS;
+	}
 
-		// Check for known USB parameters.
-		const dc_usb_params_t *params = dc_usb_params_find (&usb);
+	// Check for known USB parameters.
+	const dc_usb_params_t *params = dc_usb_params_find (&usb);
 
-		// Get the active configuration descriptor.
-		struct libusb_config_descriptor *config = NULL;
-		rc = libusb_get_active_config_descriptor (current, &config);
-		if (rc != LIBUSB_SUCCESS) {
-			ERROR (abstract->context, "Failed to get the configuration descriptor (%s).",
-				libusb_error_name (rc));
-			return syserror (rc);
-		}
+	// Get the active configuration descriptor.
+	struct libusb_config_descriptor *config = NULL;
+	rc = libusb_get_active_config_descriptor (current, &config);
+	if (rc != LIBUSB_SUCCESS) {
+		ERROR (context, "Failed to get the configuration descriptor (%s).",
+			libusb_error_name (rc));
+		return syserror (rc);
+	}
 
-		// Find the first matching interface.
-		const struct libusb_interface_descriptor *interface = NULL;
-		for (unsigned int i = 0; i < config->bNumInterfaces; i++) {
-			const struct libusb_interface *iface = &config->interface[i];
-			for (int j = 0; j < iface->num_altsetting; j++) {
-				const struct libusb_interface_descriptor *desc = &iface->altsetting[j];
-				if (interface == NULL &&
-					(params == NULL || params->interface == desc->bInterfaceNumber)) {
-					interface = desc;
-				}
+	// Find the first matching interface.
+	const struct libusb_interface_descriptor *interface = NULL;
+	for (unsigned int i = 0; i < config->bNumInterfaces; i++) {
+		const struct libusb_interface *iface = &config->interface[i];
+		for (int j = 0; j < iface->num_altsetting; j++) {
+			const struct libusb_interface_descriptor *desc = &iface->altsetting[j];
+			if (interface == NULL &&
+				(params == NULL || params->interface == desc->bInterfaceNumber)) {
+				interface = desc;
 			}
 		}
+	}
 
-		if (interface == NULL) {
-			libusb_free_config_descriptor (config);
+	if (interface == NULL) {
+		libusb_free_config_descriptor (config);
+		return DC_STATUS_SUCCESS;
+	}
+
+	// Find the first matching input and output bulk endpoints.
+	const struct libusb_endpoint_descriptor *ep_in = NULL, *ep_out = NULL;
+	for (unsigned int i = 0; i < interface->bNumEndpoints; i++) {
+		const struct libusb_endpoint_descriptor *desc = &interface->endpoint[i];
+
+		unsigned int type = desc->bmAttributes & LIBUSB_TRANSFER_TYPE_MASK;
+		unsigned int direction = desc->bEndpointAddress & LIBUSB_ENDPOINT_DIR_MASK;
+
+		if (type != LIBUSB_TRANSFER_TYPE_BULK) {
 			continue;
 		}
 
-		// Find the first matching input and output bulk endpoints.
-		const struct libusb_endpoint_descriptor *ep_in = NULL, *ep_out = NULL;
-		for (unsigned int i = 0; i < interface->bNumEndpoints; i++) {
-			const struct libusb_endpoint_descriptor *desc = &interface->endpoint[i];
+		if (ep_in == NULL && direction == LIBUSB_ENDPOINT_IN &&
+			(params == NULL || params->endpoint_in == desc->bEndpointAddress)) {
+			ep_in = desc;
+		}
 
-			unsigned int type = desc->bmAttributes & LIBUSB_TRANSFER_TYPE_MASK;
-			unsigned int direction = desc->bEndpointAddress & LIBUSB_ENDPOINT_DIR_MASK;
+		if (ep_out == NULL && direction == LIBUSB_ENDPOINT_OUT &&
+			(params == NULL || params->endpoint_out == desc->bEndpointAddress)) {
+			ep_out = desc;
+		}
+	}
 
-			if (type != LIBUSB_TRANSFER_TYPE_BULK) {
-				continue;
-			}
+	if (ep_in == NULL || ep_out == NULL) {
+		libusb_free_config_descriptor (config);
+		return DC_STATUS_SUCCESS;
+	}
 
-			if (ep_in == NULL && direction == LIBUSB_ENDPOINT_IN &&
-				(params == NULL || params->endpoint_in == desc->bEndpointAddress)) {
-				ep_in = desc;
-			}
+	device = (dc_usb_device_t *) malloc (sizeof(dc_usb_device_t));
+	if (device == NULL) {
+		ERROR (context, "Failed to allocate memory.");
+		libusb_free_config_descriptor (config);
+		return DC_STATUS_NOMEMORY;
+	}
 
-			if (ep_out == NULL && direction == LIBUSB_ENDPOINT_OUT &&
-				(params == NULL || params->endpoint_out == desc->bEndpointAddress)) {
-				ep_out = desc;
-			}
-		}
+	device->session = dc_usb_session_ref (session);
+	device->vid = dev.idVendor;
+	device->pid = dev.idProduct;
+	device->handle = libusb_ref_device (current);
+	device->interface = interface->bInterfaceNumber;
+	device->endpoint_in = ep_in->bEndpointAddress;
+	device->endpoint_out = ep_out->bEndpointAddress;
 
-		if (ep_in == NULL || ep_out == NULL) {
-			libusb_free_config_descriptor (config);
-			continue;
-		}
+	*out = device;
 
-		device = (dc_usb_device_t *) malloc (sizeof(dc_usb_device_t));
-		if (device == NULL) {
-			ERROR (abstract->context, "Failed to allocate memory.");
-			libusb_free_config_descriptor (config);
-			return DC_STATUS_NOMEMORY;
-		}
+	libusb_free_config_descriptor (config);
 
-		device->session = dc_usb_session_ref (iterator->session);
-		device->vid = dev.idVendor;
-		device->pid = dev.idProduct;
-		device->handle = libusb_ref_device (current);
-		device->interface = interface->bInterfaceNumber;
-		device->endpoint_in = ep_in->bEndpointAddress;
-		device->endpoint_out = ep_out->bEndpointAddress;
+	return DC_STATUS_SUCCESS;
+}
 
-		*(dc_usb_device_t **) out = device;
+/*
+ * Check whether the device was created from the enumerated device.
+ */
+static int
+dc_usb_device_match (dc_usb_device_t *device, struct libusb_device *current)
+{
+	return device->handle == current;
+}
 
-		libusb_free_config_descriptor (config);
+static dc_status_t
+dc_usb_iterator_next (dc_iterator_t *abstract, void *out)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	dc_usb_iterator_t *iterator = (dc_usb_iterator_t *) abstract;
+	dc_usb_device_t *device = NULL;
+
+	while (iterator->current < iterator->count) {
+		struct libusb_device *current = iterator->devices[iterator->current++];
+
+		status = dc_usb_device_new (&device, abstract->context, iterator->session, iterator->descriptor, current);
+		if (status != DC_STATUS_SUCCESS)
+			return status;
+
+		if (device == NULL)
+			continue;
+
+		*(dc_usb_device_t **) out = device;
 
 		return DC_STATUS_SUCCESS;
 	}
@@ -433,7 +545,372 @@ dc_usb_iterator_free (dc_iterator_t *abstract)
 
 	return DC_STATUS_SUCCESS;
 }
+
+static dc_status_t
+dc_usb_monitor_add (dc_usb_monitor_t *monitor, dc_usb_device_t *device)
+{
+	if (monitor->count == monitor->capacity) {
+		size_t capacity = monitor->capacity ? monitor->capacity * 2 : 8;
+		dc_usb_device_t **devices = (dc_usb_device_t **) realloc (monitor->devices, capacity * sizeof (dc_usb_device_t *));
+		if (devices == NULL) {
+			ERROR (monitor->context, "Failed to allocate memory.");
+			dc_usb_device_free (device);
+			return DC_STATUS_NOMEMORY;
+		}
+
+		monitor->devices = devices;
+		monitor->capacity = capacity;
+	}
+
+	monitor->devices[monitor->count++] = device;
+
+	monitor->callback (device, DC_HOTPLUG_ARRIVED, monitor->userdata);
+
+	return DC_STATUS_SUCCESS;
+}
+
+static void
+dc_usb_monitor_remove (dc_usb_monitor_t *monitor, size_t index)
+{
+	dc_usb_device_t *device = monitor->devices[index];
+
+	monitor->callback (device, DC_HOTPLUG_LEFT, monitor->userdata);
+
+	memmove (monitor->devices + index, monitor->devices + index + 1,
+		(monitor->count - index - 1) * sizeof (dc_usb_device_t *));
+	monitor->count--;
+
+	dc_usb_device_free (device);
+}
+
+static size_t
+dc_usb_monitor_find (dc_usb_monitor_t *monitor, struct libusb_device *current)
+{
+	for (size_t i = 0; i < monitor->count; ++i) {
+		if (dc_usb_device_match (monitor->devices[i], current))
+			return i;
+	}
+
+	return monitor->count;
+}
+
+/*
+ * Compare the enumerated devices with the current list of devices.
+ */
+static dc_status_t
+dc_usb_monitor_update (dc_usb_monitor_t *monitor, struct libusb_device **devices, size_t ndevices, unsigned int *changes)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+
+	// Remove the devices that are gone.
+	size_t i = 0;
+	while (i < monitor->count) {
+		size_t j = 0;
+		while (j < ndevices && !dc_usb_device_match (monitor->devices[i], devices[j]))
+			j++;
+
+		if (j == ndevices) {
+			dc_usb_monitor_remove (monitor, i);
+			(*changes)++;
+		} else {
+			i++;
+		}
+	}
+
+	// Add the new devices.
+	for (size_t j = 0; j < ndevices; ++j) {
+		if (dc_usb_monitor_find (monitor, devices[j]) != monitor->count)
+			continue;
+
+		dc_usb_device_t *device = NULL;
+		status = dc_usb_device_new (&device, monitor->context, monitor->session, monitor->descriptor, devices[j]);
+		if (status != DC_STATUS_SUCCESS)
+			return status;
+
+		if (device == NULL)
+			continue;
+
+		status = dc_usb_monitor_add (monitor, device);
+		if (status != DC_STATUS_SUCCESS)
+			return status;
+
+		(*changes)++;
+	}
+
+	return DC_STATUS_SUCCESS;
+}
+
+static dc_status_t
+dc_usb_monitor_scan (dc_usb_monitor_t *monitor, unsigned int *changes)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+
+	struct libusb_device **devices = NULL;
+	ssize_t ndevices = libusb_get_device_list (monitor->session->handle, &devices);
+	if (ndevices < 0) {
+		ERROR (monitor->context, "Failed to enumerate the usb devices (%s).",
+			libusb_error_name (ndevices));
+		return syserror (ndevices);
+	}
+
+	status = dc_usb_monitor_update (monitor, devices, ndevices, changes);
+
+	libusb_free_device_list (devices, 1);
+
+	return status;
+}
+
+#ifdef USE_HOTPLUG
+static int LIBUSB_CALL
+dc_usb_monitor_hotplug (libusb_context *context, libusb_device *handle, libusb_hotplug_event event, void *userdata)
+{
+	dc_usb_monitor_t *monitor = (dc_usb_monitor_t *) userdata;
+
+	// The device descriptors can't be retrieved safely from within the
+	// callback, so the notifications are only queued here.
+	dc_mutex_lock (&monitor->mutex);
+
+	if (monitor->nevents == monitor->maxevents) {
+		size_t maxevents = monitor->maxevents ? monitor->maxevents * 2 : 8;
+		dc_usb_event_t *events = (dc_usb_event_t *) realloc (monitor->events, maxevents * sizeof (dc_usb_event_t));
+		if (events == NULL) {
+			dc_mutex_unlock (&monitor->mutex);
+			ERROR (monitor->context, "Failed to allocate memory.");
+			return 0;
+		}
+
+		monitor->events = events;
+		monitor->maxevents = maxevents;
+	}
+
+	monitor->events[monitor->nevents].handle = libusb_ref_device (handle);
+	monitor->events[monitor->nevents].event =
+		event == LIBUSB_HOTPLUG_EVENT_DEVICE_ARRIVED ?
+		DC_HOTPLUG_ARRIVED : DC_HOTPLUG_LEFT;
+	monitor->nevents++;
+
+	dc_mutex_unlock (&monitor->mutex);
+
+	return 0;
+}
+
+static dc_status_t
+dc_usb_monitor_process (dc_usb_monitor_t *monitor, unsigned int *changes)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+
+	dc_mutex_lock (&monitor->mutex);
+	dc_usb_event_t *events = monitor->events;
+	size_t nevents = monitor->nevents;
+	monitor->events = NULL;
+	monitor->nevents = 0;
+	monitor->maxevents = 0;
+	dc_mutex_unlock (&monitor->mutex);
+
+	for (size_t i = 0; i < nevents; ++i) {
+		size_t index = dc_usb_monitor_find (monitor, events[i].handle);
+
+		if (events[i].event == DC_HOTPLUG_ARRIVED && index == monitor->count && status == DC_STATUS_SUCCESS) {
+			dc_usb_device_t *device = NULL;
+			status = dc_usb_device_new (&device, monitor->context, monitor->session, monitor->descriptor, events[i].handle);
+			if (status == DC_STATUS_SUCCESS && device) {
+				status = dc_usb_monitor_add (monitor, device);
+				if (status == DC_STATUS_SUCCESS)
+					(*changes)++;
+			}
+		} else if (events[i].event == DC_HOTPLUG_LEFT && index != monitor->count) {
+			dc_usb_monitor_remove (monitor, index);
+			(*changes)++;
+		}
+
+		libusb_unref_device (events[i].handle);
+	}
+
+	free (events);
+
+	return status;
+}
 #endif
+#endif
+
+dc_status_t
+dc_usb_monitor_new (dc_usb_monitor_t **out, dc_context_t *context, dc_descriptor_t *descriptor, dc_usb_monitor_callback_t callback, void *userdata)
+{
+#ifdef HAVE_LIBUSB
+	dc_status_t status = DC_STATUS_SUCCESS;
+	dc_usb_monitor_t *monitor = NULL;
+
+	if (out == NULL || callback == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	monitor = (dc_usb_monitor_t *) malloc (sizeof (dc_usb_monitor_t));
+	if (monitor == NULL) {
+		ERROR (context, "Failed to allocate memory.");
+		return DC_STATUS_NOMEMORY;
+	}
+
+	monitor->context = context;
+	monitor->descriptor = descriptor;
+	monitor->callback = callback;
+	monitor->userdata = userdata;
+	monitor->devices = NULL;
+	monitor->count = 0;
+	monitor->capacity = 0;
+
+	status = dc_timer_new (&monitor->timer);
+	if (status != DC_STATUS_SUCCESS) {
+		ERROR (context, "Failed to create a high resolution timer.");
+		goto error_free;
+	}
+
+	// Initialize the usb library.
+	status = dc_usb_session_new (&monitor->session, context);
+	if (status != DC_STATUS_SUCCESS) {
+		goto error_timer_free;
+	}
+
+#ifdef USE_HOTPLUG
+	monitor->hotplug = 0;
+	monitor->mutex = mutex_init;
+	monitor->events = NULL;
+	monitor->nevents = 0;
+	monitor->maxevents = 0;
+
+	// Register for hotplug notifications, including the devices that
+	// are already present. Without hotplug support, the bus is scanned.
+	if (libusb_has_capability (LIBUSB_CAP_HAS_HOTPLUG)) {
+		int rc = libusb_hotplug_register_callback (monitor->session->handle,
+			LIBUSB_HOTPLUG_EVENT_DEVICE_ARRIVED | LIBUSB_HOTPLUG_EVENT_DEVICE_LEFT,
+			LIBUSB_HOTPLUG_ENUMERATE,
+			LIBUSB_HOTPLUG_MATCH_ANY, LIBUSB_HOTPLUG_MATCH_ANY, LIBUSB_HOTPLUG_MATCH_ANY,
+			dc_usb_monitor_hotplug, monitor, &monitor->handle);
+		if (rc == LIBUSB_SUCCESS) {
+			monitor->hotplug = 1;
+		} else {
+			WARNING (context, "Failed to register the hotplug callback (%s).",
+				libusb_error_name (rc));
+		}
+	}
+#endif
+
+	*out = monitor;
+
+	return DC_STATUS_SUCCESS;
+
+error_timer_free:
+	dc_timer_free (monitor->timer);
+error_free:
+	free (monitor);
+	return status;
+#else
+	return DC_STATUS_UNSUPPORTED;
+#endif
+}
+
+dc_status_t
+dc_usb_monitor_poll (dc_usb_monitor_t *monitor, int timeout)
+{
+#ifdef HAVE_LIBUSB
+	dc_status_t status = DC_STATUS_SUCCESS;
+	dc_usecs_t start = 0, now = 0;
+
+	if (monitor == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	if (timeout > 0) {
+		status = dc_timer_now (monitor->timer, &start);
+		if (status != DC_STATUS_SUCCESS)
+			return status;
+	}
+
+	while (1) {
+		unsigned int changes = 0;
+
+#ifdef USE_HOTPLUG
+		if (monitor->hotplug) {
+			status = dc_usb_monitor_process (monitor, &changes);
+		} else
+#endif
+		{
+			status = dc_usb_monitor_scan (monitor, &changes);
+		}
+		if (status != DC_STATUS_SUCCESS)
+			return status;
+
+		if (changes)
+			return DC_STATUS_SUCCESS;
+
+		// Get the remaining time.
+		int remaining = timeout;
+		if (timeout > 0) {
+			status = dc_timer_now (monitor->timer, &now);
+			if (status != DC_STATUS_SUCCESS)
+				return status;
+
+			dc_usecs_t elapsed = (now - start) / 1000;
+			remaining = elapsed >= (dc_usecs_t) timeout ? 0 : timeout - (int) elapsed;
+		}
+
+		if (remaining == 0)
+			return DC_STATUS_TIMEOUT;
+
+#ifdef USE_HOTPLUG
+		if (monitor->hotplug) {
+			int rc = LIBUSB_SUCCESS;
+			if (remaining < 0) {
+				rc = libusb_handle_events_completed (monitor->session->handle, NULL);
+			} else {
+				struct timeval tv = {remaining / 1000, (remaining % 1000) * 1000};
+				rc = libusb_handle_events_timeout_completed (monitor->session->handle, &tv, NULL);
+			}
+			if (rc != LIBUSB_SUCCESS && rc != LIBUSB_ERROR_INTERRUPTED) {
+				ERROR (monitor->context, "Failed to handle the usb events (%s).",
+					libusb_error_name (rc));
+				return syserror (rc);
+			}
+			continue;
+		}
+#endif
+
+		dc_platform_sleep (remaining < 0 || remaining > SCAN_INTERVAL ? SCAN_INTERVAL : remaining);
+	}
+#else
+	return DC_STATUS_UNSUPPORTED;
+#endif
+}
+
+dc_status_t
+dc_usb_monitor_free (dc_usb_monitor_t *monitor)
+{
+#ifdef HAVE_LIBUSB
+	if (monitor == NULL)
+		return DC_STATUS_SUCCESS;
+
+#ifdef USE_HOTPLUG
+	if (monitor->hotplug) {
+		libusb_hotplug_deregister_callback (monitor->session->handle, monitor->handle);
+	}
+
+	for (size_t i = 0; i < monitor->nevents; ++i) {
+		libusb_unref_device (monitor->events[i].handle);
+	}
+	free (monitor->events);
+#endif
+
+	for (size_t i = 0; i < monitor->count; ++i) {
+		dc_usb_device_free (monitor->devices[i]);
+	}
+	free (monitor->devices);
+
+	dc_usb_session_unref (monitor->session);
+	dc_timer_free (monitor->timer);
+	free (monitor);
+
+	return DC_STATUS_SUCCESS;
+#else
+	return DC_STATUS_UNSUPPORTED;
+#endif
+}
 
 dc_status_t
 dc_usb_open (dc_iostream_t **out, dc_context_t *context, dc_usb_device_t *device)
@@ -60,9 +60,13 @@ static const dc_iostream_vtable_t dc_usbstorage_vtable = {
 	NULL, /* configure */
 	dc_usb_storage_read, /* read */
 	NULL, /* write */
+	NULL, /* read_async */
+	NULL, /* write_async */
+	NULL, /* writev */
 	NULL, /* flush */
 	NULL, /* purge */
 	NULL, /* sleep */
+	NULL, /* set_interrupt */
 	NULL, /* close */
 };
 
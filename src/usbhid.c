@@ -25,9 +25,6 @@
 
 #include <stdlib.h>
 #include <string.h>
-#ifdef HAVE_PTHREAD_H
-#include <pthread.h>
-#endif
 #ifdef _WIN32
 #define WIN32_LEAN_AND_MEAN
 #define NOGDI
@@ -59,17 +56,27 @@
 #include "iostream-private.h"
 #include "iterator-private.h"
 #include "platform.h"
-
-#ifdef _WIN32
-typedef LONG dc_mutex_t;
-#define DC_MUTEX_INIT 0
-#else
-typedef pthread_mutex_t dc_mutex_t;
-#define DC_MUTEX_INIT PTHREAD_MUTEX_INITIALIZER
-#endif
+#include "thread.h"
+#include "timer.h"
 
 #define ISINSTANCE(device) dc_iostream_isinstance((device), &dc_usbhid_vtable)
 
+// Number of interrupt IN transfers kept queued.
+#define NTRANSFERS 4
+
+// Time (in milliseconds) between two scans of the bus, for monitors
+// without hotplug support.
+#define SCAN_INTERVAL 1000
+
+// Maximum time (in milliseconds) of a blocking wait, before checking for
+// a cancellation again. Neither libusb nor hidapi can wait on the
+// cancellation event directly.
+#define CANCEL_INTERVAL 100
+
+#if defined(USE_LIBUSB) && defined(LIBUSB_API_VERSION) && (LIBUSB_API_VERSION >= 0x01000102)
+#define USE_HOTPLUG
+#endif
+
 typedef struct dc_usbhid_session_t {
 	size_t refcount;
 #if defined(USE_LIBUSB)
@@ -115,6 +122,42 @@ typedef struct dc_usbhid_iterator_t {
 #endif
 } dc_usbhid_iterator_t;
 
+#if defined(USE_LIBUSB)
+typedef struct libusb_device dc_usbhid_info_t;
+#elif defined(USE_HIDAPI)
+typedef struct hid_device_info dc_usbhid_info_t;
+#endif
+
+#ifdef USE_HOTPLUG
+typedef struct dc_usbhid_event_t {
+	struct libusb_device *handle;
+	dc_hotplug_t event;
+} dc_usbhid_event_t;
+#endif
+
+struct dc_usbhid_monitor_t {
+	dc_context_t *context;
+	dc_descriptor_t *descriptor;
+	dc_usbhid_session_t *session;
+	dc_usbhid_monitor_callback_t callback;
+	void *userdata;
+	dc_timer_t *timer;
+	/* The devices that are currently present. */
+	dc_usbhid_device_t **devices;
+	size_t count;
+	size_t capacity;
+#ifdef USE_HOTPLUG
+	/* The hotplug notifications that are not processed yet. They
+	 * can arrive on any thread that handles the usb events. */
+	int hotplug;
+	libusb_hotplug_callback_handle handle;
+	dc_mutex_t mutex;
+	dc_usbhid_event_t *events;
+	size_t nevents;
+	size_t maxevents;
+#endif
+};
+
 typedef struct dc_usbhid_t {
 	/* Base class. */
 	dc_iostream_t base;
@@ -127,6 +170,18 @@ typedef struct dc_usbhid_t {
 	unsigned char endpoint_out;
 	unsigned short packetsize;
 	unsigned int timeout;
+	/* Queued interrupt IN transfers. The completed ones are
+	 * kept in a ring buffer, in the order they were received. */
+	dc_mutex_t mutex;
+	dc_timer_t *timer;
+	unsigned char *buffer;
+	struct libusb_transfer *transfers[NTRANSFERS];
+	struct libusb_transfer *completed[NTRANSFERS];
+	unsigned int ntransfers;
+	unsigned int nactive;
+	unsigned int head;
+	unsigned int count;
+	int done;
 #elif defined(USE_HIDAPI)
 	hid_device *handle;
 	int timeout;
@@ -151,17 +206,19 @@ static const dc_iostream_vtable_t dc_usbhid_vtable = {
 	dc_usbhid_poll, /* poll */
 	dc_usbhid_read, /* read */
 	dc_usbhid_write, /* write */
+	NULL, /* read_async */
+	NULL, /* write_async */
+	NULL, /* writev */
 	dc_usbhid_ioctl, /* ioctl */
 	NULL, /* flush */
 	NULL, /* purge */
 	NULL, /* sleep */
+	NULL, /* set_interrupt */
 	dc_usbhid_close, /* close */
 };
 
-#ifdef USE_HIDAPI
 static dc_mutex_t g_usbhid_mutex = DC_MUTEX_INIT;
 static dc_usbhid_session_t *g_usbhid_session = NULL;
-#endif
 
 #if defined(USE_LIBUSB)
 static dc_status_t
@@ -184,32 +241,31 @@ syserror(int errcode)
 		return DC_STATUS_IO;
 	}
 }
-#endif
 
-#ifdef USE_HIDAPI
-static void
-dc_mutex_lock (dc_mutex_t *mutex)
+static dc_status_t
+transfer_error (enum libusb_transfer_status status)
 {
-#ifdef _WIN32
-	while (InterlockedCompareExchange (mutex, 1, 0) == 1) {
-		SleepEx (0, TRUE);
+	switch (status) {
+	case LIBUSB_TRANSFER_COMPLETED:
+		return DC_STATUS_SUCCESS;
+	case LIBUSB_TRANSFER_TIMED_OUT:
+		return DC_STATUS_TIMEOUT;
+	case LIBUSB_TRANSFER_CANCELLED:
+		return DC_STATUS_CANCELLED;
+	case LIBUSB_TRANSFER_NO_DEVICE:
+		return DC_STATUS_NODEVICE;
+	default:
+		return DC_STATUS_IO;
 	}
-#else
-	pthread_mutex_lock (mutex);
-#endif
 }
 
-static void
-dc_mutex_unlock (dc_mutex_t *mutex)
-{
-#ifdef _WIN32
-	InterlockedExchange (mutex, 0);
-#else
-	pthread_mutex_unlock (mutex);
-#endif
-}
+static const dc_mutex_t mutex_init = DC_MUTEX_INIT;
 #endif
 
+/*
+ * The session is shared by all iterators, monitors and connections, to
+ * avoid initializing the usb library again for every scan.
+ */
 static dc_status_t
 dc_usbhid_session_new (dc_usbhid_session_t **out, dc_context_t *context)
 {
@@ -219,7 +275,6 @@ dc_usbhid_session_new (dc_usbhid_session_t **out, dc_context_t *context)
 	if (out == NULL)
 		return DC_STATUS_INVALIDARGS;
 
-#ifdef USE_HIDAPI
 	dc_mutex_lock (&g_usbhid_mutex);
 
 	if (g_usbhid_session) {
@@ -228,7 +283,6 @@ dc_usbhid_session_new (dc_usbhid_session_t **out, dc_context_t *context)
 		dc_mutex_unlock (&g_usbhid_mutex);
 		return DC_STATUS_SUCCESS;
 	}
-#endif
 
 	session = (dc_usbhid_session_t *) malloc (sizeof(dc_usbhid_session_t));
 	if (session == NULL) {
@@ -254,11 +308,11 @@ dc_usbhid_session_new (dc_usbhid_session_t **out, dc_context_t *context)
 		status = DC_STATUS_IO;
 		goto error_free;
 	}
+#endif
 
 	g_usbhid_session = session;
 
 	dc_mutex_unlock (&g_usbhid_mutex);
-#endif
 
 	*out = session;
 
@@ -267,9 +321,7 @@ dc_usbhid_session_new (dc_usbhid_session_t **out, dc_context_t *context)
 error_free:
 	free (session);
 error_unlock:
-#ifdef USE_HIDAPI
 	dc_mutex_unlock (&g_usbhid_mutex);
-#endif
 	return status;
 }
 
@@ -279,15 +331,11 @@ dc_usbhid_session_ref (dc_usbhid_session_t *session)
 	if (session == NULL)
 		return NULL;
 
-#ifdef USE_HIDAPI
 	dc_mutex_lock (&g_usbhid_mutex);
-#endif
 
 	session->refcount++;
 
-#ifdef USE_HIDAPI
 	dc_mutex_unlock (&g_usbhid_mutex);
-#endif
 
 	return session;
 }
@@ -298,23 +346,19 @@ dc_usbhid_session_unref (dc_usbhid_session_t *session)
 	if (session == NULL)
 		return DC_STATUS_SUCCESS;
 
-#ifdef USE_HIDAPI
 	dc_mutex_lock (&g_usbhid_mutex);
-#endif
 
 	if (--session->refcount == 0) {
 #if defined(USE_LIBUSB)
 		libusb_exit (session->handle);
 #elif defined(USE_HIDAPI)
 		hid_exit ();
-		g_usbhid_session = NULL;
 #endif
+		g_usbhid_session = NULL;
 		free (session);
 	}
 
-#ifdef USE_HIDAPI
 	dc_mutex_unlock (&g_usbhid_mutex);
-#endif
 
 	return DC_STATUS_SUCCESS;
 }
@@ -418,130 +462,180 @@ error_free:
 }
 
 #ifdef USBHID
+/*
+ * Create a new device for the USB HID device, if it matches the device
+ * descriptor and has the necessary interface and endpoints. Otherwise
+ * no device is returned.
+ */
+#if defined(USE_LIBUSB)
 static dc_status_t
-dc_usbhid_iterator_next (dc_iterator_t *abstract, void *out)
+dc_usbhid_device_new (dc_usbhid_device_t **out, dc_context_t *context, dc_usbhid_session_t *session, dc_descriptor_t *descriptor, dc_usbhid_info_t *current)
 {
-	dc_usbhid_iterator_t *iterator = (dc_usbhid_iterator_t *) abstract;
 	dc_usbhid_device_t *device = NULL;
 
-#if defined(USE_LIBUSB)
-	while (iterator->current < iterator->count) {
-		struct libusb_device *current = iterator->devices[iterator->current++];
-
-		// Get the device descriptor.
-		struct libusb_device_descriptor dev;
-		int rc = libusb_get_device_descriptor (current, &dev);
-		if (rc < 0) {
-			ERROR (abstract->context, "Failed to get the device descriptor (%s).",
-				libusb_error_name (rc));
-			return syserror (rc);
-		}
+	*out = NULL;
 
-		dc_usbhid_desc_t usb = {dev.idVendor, dev.idProduct};
-		if (!dc_descriptor_filter (iterator->descriptor, DC_TRANSPORT_USBHID, &usb)) {
-			continue;
-		}
+	// Get the device descriptor.
+	struct libusb_device_descriptor dev;
+	int rc = libusb_get_device_descriptor (current, &dev);
+	if (rc < 0) {
+		ERROR (context, "Failed to get the device descriptor (%s).",
+			libusb_error_name (rc));
+		return syserror (rc);
+	}
 
-		// Get the active configuration descriptor.
-		struct libusb_config_descriptor *config = NULL;
-		rc = libusb_get_active_config_descriptor (current, &config);
-		if (rc != LIBUSB_SUCCESS) {
-			ERROR (abstract->context, "Failed to get the configuration descriptor (%s).",
-				libusb_error_name (rc));
-			return syserror (rc);
-		}
+	dc_usbhid_desc_t usb = {dev.idVendor, dev.idProduct};
+	if (!dc_descriptor_filter (descriptor, DC_TRANSPORT_USBHID, &usb)) {
+		return DC_STATUS_SUCCESS;
+	}
 
-		// Find the first HID interface.
-		const struct libusb_interface_descriptor *interface = NULL;
-		for (unsigned int i = 0; i < config->bNumInterfaces; i++) {
-			const struct libusb_interface *iface = &config->interface[i];
-			for (int j = 0; j < iface->num_altsetting; j++) {
-				const struct libusb_interface_descriptor *desc = &iface->altsetting[j];
-				if (desc->bInterfaceClass == LIBUSB_CLASS_HID && interface == NULL) {
-					interface = desc;
-				}
-			}
-		}
+	// Get the active configuration descriptor.
+	struct libusb_config_descriptor *config = NULL;
+	rc = libusb_get_active_config_descriptor (current, &config);
+	if (rc != LIBUSB_SUCCESS) {
+		ERROR (context, "Failed to get the configuration descriptor (%s).",
+			libusb_error_name (rc));
+		return syserror (rc);
+	}
 
-		if (interface == NULL) {
-			libusb_free_config_descriptor (config);
-			continue;
+	// Find the first HID interface.
+	const struct libusb_interface_descriptor *interface = NULL;
+	for (unsigned int i = 0; i < config->bNumInterfaces; i++) {
+		const struct libusb_interface *iface = &config->interface[i];
+		for (int j = 0; j < iface->num_altsetting; j++) {
+			const struct libusb_interface_descriptor *desc = &iface->altsetting[j];
+			if (desc->bInterfaceClass == LIBUSB_CLASS_HID && interface == NULL) {
+				interface = desc;
+			}
 		}
+	}
 
-		// Find the first input and output interrupt endpoints.
-		const struct libusb_endpoint_descriptor *ep_in = NULL, *ep_out = NULL;
-		for (unsigned int i = 0; i < interface->bNumEndpoints; i++) {
-			const struct libusb_endpoint_descriptor *desc = &interface->endpoint[i];
-
-			unsigned int type = desc->bmAttributes & LIBUSB_TRANSFER_TYPE_MASK;
-			unsigned int direction = desc->bEndpointAddress & LIBUSB_ENDPOINT_DIR_MASK;
-
-			if (type != LIBUSB_TRANSFER_TYPE_INTERRUPT) {
-				continue;
-			}
+	if (interface == NULL) {
+		libusb_free_config_descriptor (config);
+		return DC_STATUS_SUCCESS;
+	}
 
-			if (direction == LIBUSB_ENDPOINT_IN && ep_in == NULL) {
-				ep_in = desc;
-			}
+	// Find the first input and output interrupt endpoints.
+	const struct libusb_endpoint_descriptor *ep_in = NULL, *ep_out = NULL;
+	for (unsigned int i = 0; i < interface->bNumEndpoints; i++) {
+		const struct libusb_endpoint_descriptor *desc = &interface->endpoint[i];
 
-			if (direction == LIBUSB_ENDPOINT_OUT && ep_out == NULL) {
-				ep_out = desc;
-			}
-		}
+		unsigned int type = desc->bmAttributes & LIBUSB_TRANSFER_TYPE_MASK;
+		unsigned int direction = desc->bEndpointAddress & LIBUSB_ENDPOINT_DIR_MASK;
 
-		if (ep_in == NULL || ep_out == NULL) {
-			libusb_free_config_descriptor (config);
+		if (type != LIBUSB_TRANSFER_TYPE_INTERRUPT) {
 			continue;
 		}
 
-		device = (dc_usbhid_device_t *) malloc (sizeof(dc_usbhid_device_t));
-		if (device == NULL) {
-			ERROR (abstract->context, "Failed to allocate memory.");
-			libusb_free_config_descriptor (config);
-			return DC_STATUS_NOMEMORY;
+		if (direction == LIBUSB_ENDPOINT_IN && ep_in == NULL) {
+			ep_in = desc;
 		}
 
-		device->session = dc_usbhid_session_ref (iterator->session);
-		device->vid = dev.idVendor;
-		device->pid = dev.idProduct;
-		device->handle = libusb_ref_device (current);
-		device->interface = interface->bInterfaceNumber;
-		device->endpoint_in = ep_in->bEndpointAddress;
-		device->endpoint_out = ep_out->bEndpointAddress;
-		device->packetsize = ep_in->wMaxPacketSize;
+		if (direction == LIBUSB_ENDPOINT_OUT && ep_out == NULL) {
+			ep_out = desc;
+		}
+	}
 
-		*(dc_usbhid_device_t **) out = device;
+	if (ep_in == NULL || ep_out == NULL) {
+		libusb_free_config_descriptor (config);
+		return DC_STATUS_SUCCESS;
+	}
 
+	device = (dc_usbhid_device_t *) malloc (sizeof(dc_usbhid_device_t));
+	if (device == NULL) {
+		ERROR (context, "Failed to allocate memory.");
 		libusb_free_config_descriptor (config);
+		return DC_STATUS_NOMEMORY;
+	}
+
+	device->session = dc_usbhid_session_ref (session);
+	device->vid = dev.idVendor;
+	device->pid = dev.idProduct;
+	device->handle = libusb_ref_device (current);
+	device->interface = interface->bInterfaceNumber;
+	device->endpoint_in = ep_in->bEndpointAddress;
+	device->endpoint_out = ep_out->bEndpointAddress;
+	device->packetsize = ep_in->wMaxPacketSize;
+
+	*out = device;
 
+	libusb_free_config_descriptor (config);
+
+	return DC_STATUS_SUCCESS;
+}
+#elif defined(USE_HIDAPI)
+static dc_status_t
+dc_usbhid_device_new (dc_usbhid_device_t **out, dc_context_t *context, dc_usbhid_session_t *session, dc_descriptor_t *descriptor, dc_usbhid_info_t *current)
+{
+	dc_usbhid_device_t *device = NULL;
+
+	*out = NULL;
+
+	dc_usbhid_desc_t usb = {current->vendor_id, current->product_id};
+	if (!dc_descriptor_filter (descriptor, DC_TRANSPORT_USBHID, &usb)) {
 		return DC_STATUS_SUCCESS;
 	}
+
+	device = (dc_usbhid_device_t *) malloc (sizeof(dc_usbhid_device_t));
+	if (device == NULL) {
+		ERROR (context, "Failed to allocate memory.");
+		return DC_STATUS_NOMEMORY;
+	}
+
+	device->session = dc_usbhid_session_ref (session);
+	device->vid = current->vendor_id;
+	device->pid = current->product_id;
+	device->path = strdup (current->path);
+
+	*out = device;
+
+	return DC_STATUS_SUCCESS;
+}
+#endif
+
+/*
+ * Check whether the device was created from the enumerated device.
+ */
+static int
+dc_usbhid_device_match (dc_usbhid_device_t *device, dc_usbhid_info_t *current)
+{
+#if defined(USE_LIBUSB)
+	return device->handle == current;
 #elif defined(USE_HIDAPI)
-	while (iterator->current) {
-		struct hid_device_info *current = iterator->current;
-		iterator->current = current->next;
+	return device->path && current->path && strcmp (device->path, current->path) == 0;
+#endif
+}
 
-		dc_usbhid_desc_t usb = {current->vendor_id, current->product_id};
-		if (!dc_descriptor_filter (iterator->descriptor, DC_TRANSPORT_USBHID, &usb)) {
-			continue;
-		}
+static dc_status_t
+dc_usbhid_iterator_next (dc_iterator_t *abstract, void *out)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	dc_usbhid_iterator_t *iterator = (dc_usbhid_iterator_t *) abstract;
+	dc_usbhid_device_t *device = NULL;
 
-		device = (dc_usbhid_device_t *) malloc (sizeof(dc_usbhid_device_t));
-		if (device == NULL) {
-			ERROR (abstract->context, "Failed to allocate memory.");
-			return DC_STATUS_NOMEMORY;
-		}
+	while (1) {
+#if defined(USE_LIBUSB)
+		if (iterator->current >= iterator->count)
+			break;
+		dc_usbhid_info_t *current = iterator->devices[iterator->current++];
+#elif defined(USE_HIDAPI)
+		if (iterator->current == NULL)
+			break;
+		dc_usbhid_info_t *current = iterator->current;
+		iterator->current = current->next;
+#endif
+
+		status = dc_usbhid_device_new (&device, abstract->context, iterator->session, iterator->descriptor, current);
+		if (status != DC_STATUS_SUCCESS)
+			return status;
 
-		device->session = dc_usbhid_session_ref (iterator->session);
-		device->vid = current->vendor_id;
-		device->pid = current->product_id;
-		device->path = strdup (current->path);
+		if (device == NULL)
+			continue;
 
 		*(dc_usbhid_device_t **) out = device;
 
 		return DC_STATUS_SUCCESS;
 	}
-#endif
 
 	return DC_STATUS_DONE;
 }
@@ -560,6 +654,607 @@ dc_usbhid_iterator_free (dc_iterator_t *abstract)
 
 	return DC_STATUS_SUCCESS;
 }
+
+static dc_status_t
+dc_usbhid_monitor_add (dc_usbhid_monitor_t *monitor, dc_usbhid_device_t *device)
+{
+	if (monitor->count == monitor->capacity) {
+		size_t capacity = monitor->capacity ? monitor->capacity * 2 : 8;
+		dc_usbhid_device_t **devices = (dc_usbhid_device_t **) realloc (monitor->devices, capacity * sizeof (dc_usbhid_device_t *));
+		if (devices == NULL) {
+			ERROR (monitor->context, "Failed to allocate memory.");
+			dc_usbhid_device_free (device);
+			return DC_STATUS_NOMEMORY;
+		}
+
+		monitor->devices = devices;
+		monitor->capacity = capacity;
+	}
+
+	monitor->devices[monitor->count++] = device;
+
+	monitor->callback (device, DC_HOTPLUG_ARRIVED, monitor->userdata);
+
+	return DC_STATUS_SUCCESS;
+}
+
+static void
+dc_usbhid_monitor_remove (dc_usbhid_monitor_t *monitor, size_t index)
+{
+	dc_usbhid_device_t *device = monitor->devices[index];
+
+	monitor->callback (device, DC_HOTPLUG_LEFT, monitor->userdata);
+
+	memmove (monitor->devices + index, monitor->devices + index + 1,
+		(monitor->count - index - 1) * sizeof (dc_usbhid_device_t *));
+	monitor->count--;
+
+	dc_usbhid_device_free (device);
+}
+
+static size_t
+dc_usbhid_monitor_find (dc_usbhid_monitor_t *monitor, dc_usbhid_info_t *current)
+{
+	for (size_t i = 0; i < monitor->count; ++i) {
+		if (dc_usbhid_device_match (monitor->devices[i], current))
+			return i;
+	}
+
+	return monitor->count;
+}
+
+/*
+ * Compare the enumerated devices with the current list of devices.
+ */
+static dc_status_t
+dc_usbhid_monitor_update (dc_usbhid_monitor_t *monitor, dc_usbhid_info_t **devices, size_t ndevices, unsigned int *changes)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+
+	// Remove the devices that are gone.
+	size_t i = 0;
+	while (i < monitor->count) {
+		size_t j = 0;
+		while (j < ndevices && !dc_usbhid_device_match (monitor->devices[i], devices[j]))
+			j++;
+
+		if (j == ndevices) {
+			dc_usbhid_monitor_remove (monitor, i);
+			(*changes)++;
+		} else {
+			i++;
+		}
+	}
+
+	// Add the new devices.
+	for (size_t j = 0; j < ndevices; ++j) {
+		if (dc_usbhid_monitor_find (monitor, devices[j]) != monitor->count)
+			continue;
+
+		dc_usbhid_device_t *device = NULL;
+		status = dc_usbhid_device_new (&device, monitor->context, monitor->session, monitor->descriptor, devices[j]);
+		if (status != DC_STATUS_SUCCESS)
+			return status;
+
+		if (device == NULL)
+			continue;
+
+		status = dc_usbhid_monitor_add (monitor, device);
+		if (status != DC_STATUS_SUCCESS)
+			return status;
+
+		(*changes)++;
+	}
+
+	return DC_STATUS_SUCCESS;
+}
+
+static dc_status_t
+dc_usbhid_monitor_scan (dc_usbhid_monitor_t *monitor, unsigned int *changes)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+
+#if defined(USE_LIBUSB)
+	struct libusb_device **devices = NULL;
+	ssize_t ndevices = libusb_get_device_list (monitor->session->handle, &devices);
+	if (ndevices < 0) {
+		ERROR (monitor->context, "Failed to enumerate the usb devices (%s).",
+			libusb_error_name (ndevices));
+		return syserror (ndevices);
+	}
+
+	status = dc_usbhid_monitor_update (monitor, devices, ndevices, changes);
+
+	libusb_free_device_list (devices, 1);
+#elif defined(USE_HIDAPI)
+	// An empty list can't be distinguished from an error.
+	struct hid_device_info *list = hid_enumerate (0x0, 0x0);
+
+	size_t ndevices = 0;
+	for (struct hid_device_info *current = list; current; current = current->next)
+		ndevices++;
+
+	struct hid_device_info **devices = NULL;
+	if (ndevices) {
+		devices = (struct hid_device_info **) malloc (ndevices * sizeof (struct hid_device_info *));
+		if (devices == NULL) {
+			ERROR (monitor->context, "Failed to allocate memory.");
+			hid_free_enumeration (list);
+			return DC_STATUS_NOMEMORY;
+		}
+
+		size_t n = 0;
+		for (struct hid_device_info *current = list; current; current = current->next)
+			devices[n++] = current;
+	}
+
+	status = dc_usbhid_monitor_update (monitor, devices, ndevices, changes);
+
+	free (devices);
+	hid_free_enumeration (list);
+#endif
+
+	return status;
+}
+
+#ifdef USE_HOTPLUG
+static int LIBUSB_CALL
+dc_usbhid_monitor_hotplug (libusb_context *context, libusb_device *handle, libusb_hotplug_event event, void *userdata)
+{
+	dc_usbhid_monitor_t *monitor = (dc_usbhid_monitor_t *) userdata;
+
+	// The device descriptors can't be retrieved safely from within the
+	// callback, so the notifications are only queued here.
+	dc_mutex_lock (&monitor->mutex);
+
+	if (monitor->nevents == monitor->maxevents) {
+		size_t maxevents = monitor->maxevents ? monitor->maxevents * 2 : 8;
+		dc_usbhid_event_t *events = (dc_usbhid_event_t *) realloc (monitor->events, maxevents * sizeof (dc_usbhid_event_t));
+		if (events == NULL) {
+			dc_mutex_unlock (&monitor->mutex);
+			ERROR (monitor->context, "Failed to allocate memory.");
+			return 0;
+		}
+
+		monitor->events = events;
+		monitor->maxevents = maxevents;
+	}
+
+	monitor->events[monitor->nevents].handle = libusb_ref_device (handle);
+	monitor->events[monitor->nevents].event =
+		event == LIBUSB_HOTPLUG_EVENT_DEVICE_ARRIVED ?
+		DC_HOTPLUG_ARRIVED : DC_HOTPLUG_LEFT;
+	monitor->nevents++;
+
+	dc_mutex_unlock (&monitor->mutex);
+
+	return 0;
+}
+
+static dc_status_t
+dc_usbhid_monitor_process (dc_usbhid_monitor_t *monitor, unsigned int *changes)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+
+	dc_mutex_lock (&monitor->mutex);
+	dc_usbhid_event_t *events = monitor->events;
+	size_t nevents = monitor->nevents;
+	monitor->events = NULL;
+	monitor->nevents = 0;
+	monitor->maxevents = 0;
+	dc_mutex_unlock (&monitor->mutex);
+
+	for (size_t i = 0; i < nevents; ++i) {
+		size_t index = dc_usbhid_monitor_find (monitor, events[i].handle);
+
+		if (events[i].event == DC_HOTPLUG_ARRIVED && index == monitor->count && status == DC_STATUS_SUCCESS) {
+			dc_usbhid_device_t *device = NULL;
+			status = dc_usbhid_device_new (&device, monitor->context, monitor->session, monitor->descriptor, events[i].handle);
+			if (status == DC_STATUS_SUCCESS && device) {
+				status = dc_usbhid_monitor_add (monitor, device);
+				if (status == DC_STATUS_SUCCESS)
+					(*changes)++;
+			}
+		} else if (events[i].event == DC_HOTPLUG_LEFT && index != monitor->count) {
+			dc_usbhid_monitor_remove (monitor, index);
+			(*changes)++;
+		}
+
+		libusb_unref_device (events[i].handle);
+	}
+
+	free (events);
+
+	return status;
+}
+#endif
+#endif
+
+dc_status_t
+dc_usbhid_monitor_new (dc_usbhid_monitor_t **out, dc_context_t *context, dc_descriptor_t *descriptor, dc_usbhid_monitor_callback_t callback, void *userdata)
+{
+#ifdef USBHID
+	dc_status_t status = DC_STATUS_SUCCESS;
+	dc_usbhid_monitor_t *monitor = NULL;
+
+	if (out == NULL || callback == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	monitor = (dc_usbhid_monitor_t *) malloc (sizeof (dc_usbhid_monitor_t));
+	if (monitor == NULL) {
+		ERROR (context, "Failed to allocate memory.");
+		return DC_STATUS_NOMEMORY;
+	}
+
+	monitor->context = context;
+	monitor->descriptor = descriptor;
+	monitor->callback = callback;
+	monitor->userdata = userdata;
+	monitor->devices = NULL;
+	monitor->count = 0;
+	monitor->capacity = 0;
+
+	status = dc_timer_new (&monitor->timer);
+	if (status != DC_STATUS_SUCCESS) {
+		ERROR (context, "Failed to create a high resolution timer.");
+		goto error_free;
+	}
+
+	// Initialize the usb library.
+	status = dc_usbhid_session_new (&monitor->session, context);
+	if (status != DC_STATUS_SUCCESS) {
+		goto error_timer_free;
+	}
+
+#ifdef USE_HOTPLUG
+	monitor->hotplug = 0;
+	monitor->mutex = mutex_init;
+	monitor->events = NULL;
+	monitor->nevents = 0;
+	monitor->maxevents = 0;
+
+	// Register for hotplug notifications, including the devices that
+	// are already present. Without hotplug support, the bus is scanned.
+	if (libusb_has_capability (LIBUSB_CAP_HAS_HOTPLUG)) {
+		int rc = libusb_hotplug_register_callback (monitor->session->handle,
+			LIBUSB_HOTPLUG_EVENT_DEVICE_ARRIVED | LIBUSB_HOTPLUG_EVENT_DEVICE_LEFT,
+			LIBUSB_HOTPLUG_ENUMERATE,
+			LIBUSB_HOTPLUG_MATCH_ANY, LIBUSB_HOTPLUG_MATCH_ANY, LIBUSB_HOTPLUG_MATCH_ANY,
+			dc_usbhid_monitor_hotplug, monitor, &monitor->handle);
+		if (rc == LIBUSB_SUCCESS) {
+			monitor->hotplug = 1;
+		} else {
+			WARNING (context, "Failed to register the hotplug callback (%s).",
+				libusb_error_name (rc));
+		}
+	}
+#endif
+
+	*out = monitor;
+
+	return DC_STATUS_SUCCESS;
+
+error_timer_free:
+	dc_timer_free (monitor->timer);
+error_free:
+	free (monitor);
+	return status;
+#else
+	return DC_STATUS_UNSUPPORTED;
+#endif
+}
+
+dc_status_t
+dc_usbhid_monitor_poll (dc_usbhid_monitor_t *monitor, int timeout)
+{
+#ifdef USBHID
+	dc_status_t status = DC_STATUS_SUCCESS;
+	dc_usecs_t start = 0, now = 0;
+
+	if (monitor == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	if (timeout > 0) {
+		status = dc_timer_now (monitor->timer, &start);
+		if (status != DC_STATUS_SUCCESS)
+			return status;
+	}
+
+	while (1) {
+		unsigned int changes = 0;
+
+#ifdef USE_HOTPLUG
+		if (monitor->hotplug) {
+			status = dc_usbhid_monitor_process (monitor, &changes);
+		} else
+#endif
+		{
+			status = dc_usbhid_monitor_scan (monitor, &changes);
+		}
+		if (status != DC_STATUS_SUCCESS)
+			return status;
+
+		if (changes)
+			return DC_STATUS_SUCCESS;
+
+		// Get the remaining time.
+		int remaining = timeout;
+		if (timeout > 0) {
+			status = dc_timer_now (monitor->timer, &now);
+			if (status != DC_STATUS_SUCCESS)
+				return status;
+
+			dc_usecs_t elapsed = (now - start) / 1000;
+			remaining = elapsed >= (dc_usecs_t) timeout ? 0 : timeout - (int) elapsed;
+		}
+
+		if (remaining == 0)
+			return DC_STATUS_TIMEOUT;
+
+#ifdef USE_HOTPLUG
+		if (monitor->hotplug) {
+			int rc = LIBUSB_SUCCESS;
+			if (remaining < 0) {
+				rc = libusb_handle_events_completed (monitor->session->handle, NULL);
+			} else {
+				struct timeval tv = {remaining / 1000, (remaining % 1000) * 1000};
+				rc = libusb_handle_events_timeout_completed (monitor->session->handle, &tv, NULL);
+			}
+			if (rc != LIBUSB_SUCCESS && rc != LIBUSB_ERROR_INTERRUPTED) {
+				ERROR (monitor->context, "Failed to handle the usb events (%s).",
+					libusb_error_name (rc));
+				return syserror (rc);
+			}
+			continue;
+		}
+#endif
+
+		dc_platform_sleep (remaining < 0 || remaining > SCAN_INTERVAL ? SCAN_INTERVAL : remaining);
+	}
+#else
+	return DC_STATUS_UNSUPPORTED;
+#endif
+}
+
+dc_status_t
+dc_usbhid_monitor_free (dc_usbhid_monitor_t *monitor)
+{
+#ifdef USBHID
+	if (monitor == NULL)
+		return DC_STATUS_SUCCESS;
+
+#ifdef USE_HOTPLUG
+	if (monitor->hotplug) {
+		libusb_hotplug_deregister_callback (monitor->session->handle, monitor->handle);
+	}
+
+	for (size_t i = 0; i < monitor->nevents; ++i) {
+		libusb_unref_device (monitor->events[i].handle);
+	}
+	free (monitor->events);
+#endif
+
+	for (size_t i = 0; i < monitor->count; ++i) {
+		dc_usbhid_device_free (monitor->devices[i]);
+	}
+	free (monitor->devices);
+
+	dc_usbhid_session_unref (monitor->session);
+	dc_timer_free (monitor->timer);
+	free (monitor);
+
+	return DC_STATUS_SUCCESS;
+#else
+	return DC_STATUS_UNSUPPORTED;
+#endif
+}
+
+#ifdef USE_LIBUSB
+static void LIBUSB_CALL
+dc_usbhid_transfer_callback (struct libusb_transfer *transfer)
+{
+	dc_usbhid_t *usbhid = (dc_usbhid_t *) transfer->user_data;
+
+	dc_mutex_lock (&usbhid->mutex);
+	usbhid->completed[(usbhid->head + usbhid->count) % NTRANSFERS] = transfer;
+	usbhid->count++;
+	usbhid->nactive--;
+	usbhid->done = 1;
+	dc_mutex_unlock (&usbhid->mutex);
+}
+
+static dc_status_t
+dc_usbhid_transfer_submit (dc_usbhid_t *usbhid, struct libusb_transfer *transfer)
+{
+	dc_mutex_lock (&usbhid->mutex);
+	usbhid->nactive++;
+	dc_mutex_unlock (&usbhid->mutex);
+
+	int rc = libusb_submit_transfer (transfer);
+	if (rc != LIBUSB_SUCCESS) {
+		ERROR (usbhid->base.context, "Failed to submit the interrupt transfer (%s).",
+			libusb_error_name (rc));
+		dc_mutex_lock (&usbhid->mutex);
+		usbhid->nactive--;
+		dc_mutex_unlock (&usbhid->mutex);
+		return syserror (rc);
+	}
+
+	return DC_STATUS_SUCCESS;
+}
+
+static void
+dc_usbhid_transfer_setup (dc_usbhid_t *usbhid)
+{
+	dc_context_t *context = usbhid->base.context;
+
+	usbhid->mutex = mutex_init;
+	usbhid->timer = NULL;
+	usbhid->buffer = NULL;
+	usbhid->ntransfers = 0;
+	usbhid->nactive = 0;
+	usbhid->head = 0;
+	usbhid->count = 0;
+	usbhid->done = 0;
+
+	if (usbhid->packetsize == 0)
+		return;
+
+	usbhid->buffer = (unsigned char *) malloc (NTRANSFERS * usbhid->packetsize);
+	if (usbhid->buffer == NULL) {
+		WARNING (context, "Failed to allocate memory.");
+		goto error;
+	}
+
+	if (dc_timer_new (&usbhid->timer) != DC_STATUS_SUCCESS) {
+		WARNING (context, "Failed to create a high resolution timer.");
+		goto error;
+	}
+
+	for (unsigned int i = 0; i < NTRANSFERS; ++i) {
+		usbhid->transfers[i] = libusb_alloc_transfer (0);
+		if (usbhid->transfers[i] == NULL) {
+			WARNING (context, "Failed to allocate the interrupt transfer.");
+			for (unsigned int j = 0; j < i; ++j)
+				libusb_free_transfer (usbhid->transfers[j]);
+			goto error;
+		}
+
+		libusb_fill_interrupt_transfer (usbhid->transfers[i],
+			usbhid->handle, usbhid->endpoint_in,
+			usbhid->buffer + i * usbhid->packetsize, usbhid->packetsize,
+			dc_usbhid_transfer_callback, usbhid, 0);
+	}
+
+	for (unsigned int i = 0; i < NTRANSFERS; ++i) {
+		if (dc_usbhid_transfer_submit (usbhid, usbhid->transfers[i]) != DC_STATUS_SUCCESS) {
+			for (unsigned int j = i; j < NTRANSFERS; ++j)
+				libusb_free_transfer (usbhid->transfers[j]);
+			break;
+		}
+		usbhid->ntransfers++;
+	}
+
+	if (usbhid->ntransfers == 0)
+		goto error;
+
+	return;
+
+error:
+	WARNING (context, "Using synchronous interrupt transfers.");
+	dc_timer_free (usbhid->timer);
+	free (usbhid->buffer);
+	usbhid->timer = NULL;
+	usbhid->buffer = NULL;
+}
+
+static void
+dc_usbhid_transfer_cleanup (dc_usbhid_t *usbhid)
+{
+	if (usbhid->ntransfers == 0)
+		return;
+
+	for (unsigned int i = 0; i < usbhid->ntransfers; ++i) {
+		libusb_cancel_transfer (usbhid->transfers[i]);
+	}
+
+	// Wait for the cancelled transfers to finish.
+	while (1) {
+		dc_mutex_lock (&usbhid->mutex);
+		unsigned int nactive = usbhid->nactive;
+		usbhid->done = 0;
+		dc_mutex_unlock (&usbhid->mutex);
+
+		if (nactive == 0)
+			break;
+
+		struct timeval tv = {1, 0};
+		int rc = libusb_handle_events_timeout_completed (usbhid->session->handle, &tv, &usbhid->done);
+		if (rc != LIBUSB_SUCCESS) {
+			ERROR (usbhid->base.context, "Failed to handle the usb events (%s).",
+				libusb_error_name (rc));
+			return;
+		}
+	}
+
+	for (unsigned int i = 0; i < usbhid->ntransfers; ++i) {
+		libusb_free_transfer (usbhid->transfers[i]);
+	}
+
+	dc_timer_free (usbhid->timer);
+	free (usbhid->buffer);
+	usbhid->ntransfers = 0;
+}
+
+/*
+ * Wait until a queued transfer has completed. A negative timeout waits
+ * forever, and zero only handles the pending events.
+ */
+static dc_status_t
+dc_usbhid_transfer_wait (dc_usbhid_t *usbhid, int timeout)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	dc_usecs_t start = 0, now = 0;
+
+	if (timeout > 0) {
+		status = dc_timer_now (usbhid->timer, &start);
+		if (status != DC_STATUS_SUCCESS)
+			return status;
+	}
+
+	while (1) {
+		dc_mutex_lock (&usbhid->mutex);
+		unsigned int count = usbhid->count;
+		unsigned int nactive = usbhid->nactive;
+		usbhid->done = 0;
+		dc_mutex_unlock (&usbhid->mutex);
+
+		if (count)
+			return DC_STATUS_SUCCESS;
+
+		if (nactive == 0)
+			return DC_STATUS_IO;
+
+		if (dc_interrupt_isset (usbhid->base.interrupt))
+			return DC_STATUS_CANCELLED;
+
+		int remaining = timeout;
+		if (timeout > 0) {
+			status = dc_timer_now (usbhid->timer, &now);
+			if (status != DC_STATUS_SUCCESS)
+				return status;
+
+			dc_usecs_t elapsed = (now - start) / 1000;
+			if (elapsed >= (dc_usecs_t) timeout)
+				return DC_STATUS_TIMEOUT;
+
+			remaining = timeout - (int) elapsed;
+		}
+
+		if (usbhid->base.interrupt && (remaining < 0 || remaining > CANCEL_INTERVAL))
+			remaining = CANCEL_INTERVAL;
+
+		int rc = LIBUSB_SUCCESS;
+		if (remaining < 0) {
+			rc = libusb_handle_events_completed (usbhid->session->handle, &usbhid->done);
+		} else {
+			struct timeval tv = {remaining / 1000, (remaining % 1000) * 1000};
+			rc = libusb_handle_events_timeout_completed (usbhid->session->handle, &tv, &usbhid->done);
+		}
+		if (rc != LIBUSB_SUCCESS) {
+			ERROR (usbhid->base.context, "Failed to handle the usb events (%s).",
+				libusb_error_name (rc));
+			return syserror (rc);
+		}
+
+		if (timeout == 0) {
+			dc_mutex_lock (&usbhid->mutex);
+			count = usbhid->count;
+			dc_mutex_unlock (&usbhid->mutex);
+			return count ? DC_STATUS_SUCCESS : DC_STATUS_TIMEOUT;
+		}
+	}
+}
 #endif
 
 dc_status_t
@@ -619,6 +1314,11 @@ dc_usbhid_open (dc_iostream_t **out, dc_context_t *context, dc_usbhid_device_t *
 	usbhid->packetsize = device->packetsize;
 	usbhid->timeout = 0;
 
+	// Keep a number of interrupt IN transfers queued, such that the
+	// reports are received as soon as the device sends them. If that
+	// fails, the synchronous transfers are used instead.
+	dc_usbhid_transfer_setup (usbhid);
+
 #elif defined(USE_HIDAPI)
 	INFO (context, "Open: path=%s", device->path);
 
@@ -659,6 +1359,7 @@ dc_usbhid_close (dc_iostream_t *abstract)
 	dc_usbhid_t *usbhid = (dc_usbhid_t *) abstract;
 
 #if defined(USE_LIBUSB)
+	dc_usbhid_transfer_cleanup (usbhid);
 	libusb_release_interface (usbhid->handle, usbhid->interface);
 	libusb_close (usbhid->handle);
 #elif defined(USE_HIDAPI)
@@ -696,6 +1397,13 @@ dc_usbhid_set_timeout (dc_iostream_t *abstract, int timeout)
 static dc_status_t
 dc_usbhid_poll (dc_iostream_t *abstract, int timeout)
 {
+#if defined(USE_LIBUSB)
+	dc_usbhid_t *usbhid = (dc_usbhid_t *) abstract;
+
+	if (usbhid->ntransfers)
+		return dc_usbhid_transfer_wait (usbhid, timeout);
+#endif
+
 	return DC_STATUS_UNSUPPORTED;
 }
 
@@ -707,6 +1415,38 @@ dc_usbhid_read (dc_iostream_t *abstract, void *data, size_t size, size_t *actual
 	int nbytes = 0;
 
 #if defined(USE_LIBUSB)
+	if (usbhid->ntransfers) {
+		status = dc_usbhid_transfer_wait (usbhid, usbhid->timeout ? (int) usbhid->timeout : -1);
+		if (status != DC_STATUS_SUCCESS) {
+			ERROR (abstract->context, "Usb read interrupt transfer failed.");
+			goto out;
+		}
+
+		dc_mutex_lock (&usbhid->mutex);
+		struct libusb_transfer *transfer = usbhid->completed[usbhid->head];
+		usbhid->head = (usbhid->head + 1) % NTRANSFERS;
+		usbhid->count--;
+		dc_mutex_unlock (&usbhid->mutex);
+
+		if (transfer->status == LIBUSB_TRANSFER_COMPLETED) {
+			nbytes = transfer->actual_length;
+			if ((size_t) nbytes > size)
+				nbytes = size;
+			memcpy (data, transfer->buffer, nbytes);
+		} else {
+			ERROR (abstract->context, "Usb read interrupt transfer failed (%i).",
+				transfer->status);
+			status = transfer_error (transfer->status);
+		}
+
+		// Queue the transfer again for the next report.
+		if (transfer->status != LIBUSB_TRANSFER_NO_DEVICE) {
+			dc_usbhid_transfer_submit (usbhid, transfer);
+		}
+
+		goto out;
+	}
+
 	if (size > usbhid->packetsize) {
 		size = usbhid->packetsize;
 	}
@@ -721,7 +1461,30 @@ dc_usbhid_read (dc_iostream_t *abstract, void *data, size_t size, size_t *actual
 		goto out;
 	}
 #elif defined(USE_HIDAPI)
-	nbytes = hid_read_timeout(usbhid->handle, data, size, usbhid->timeout);
+	if (abstract->interrupt) {
+		// Wait in short slices, to check for a cancellation in between.
+		dc_nsecs_t target = dc_clock_now () + (dc_nsecs_t) usbhid->timeout * 1000000;
+		while (1) {
+			if (dc_interrupt_isset (abstract->interrupt)) {
+				status = DC_STATUS_CANCELLED;
+				goto out;
+			}
+
+			int timeout = CANCEL_INTERVAL;
+			if (usbhid->timeout >= 0) {
+				dc_nsecs_t now = dc_clock_now ();
+				timeout = now < target ? (int) ((target - now + 999999) / 1000000) : 0;
+				if (timeout > CANCEL_INTERVAL)
+					timeout = CANCEL_INTERVAL;
+			}
+
+			nbytes = hid_read_timeout (usbhid->handle, data, size, timeout);
+			if (nbytes != 0 || (usbhid->timeout >= 0 && dc_clock_now () >= target))
+				break;
+		}
+	} else {
+		nbytes = hid_read_timeout(usbhid->handle, data, size, usbhid->timeout);
+	}
 	if (nbytes < 0) {
 		ERROR (abstract->context, "Usb read interrupt transfer failed.");
 		status = DC_STATUS_IO;
@@ -0,0 +1,1233 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2026 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_LIBUSB
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOGDI
+#endif
+#include <libusb.h>
+#endif
+
+#include <libdivecomputer/usbserial.h>
+#include <libdivecomputer/serial.h>
+
+#include "common-private.h"
+#include "context-private.h"
+#include "iostream-private.h"
+#include "interrupt.h"
+#include "platform.h"
+#include "array.h"
+#include "timer.h"
+
+// Wrapping a file descriptor requires libusb 1.0.23 or newer.
+#if defined(HAVE_LIBUSB) && defined(LIBUSB_API_VERSION) && (LIBUSB_API_VERSION >= 0x01000107)
+#define USE_USBSERIAL
+#endif
+
+#ifdef USE_USBSERIAL
+
+// Number of bulk IN transfers kept queued, and their size in packets.
+#define NTRANSFERS 4
+#define NPACKETS   16
+
+// Size of the receive ring.
+#define RINGSIZE   (64 * 1024)
+
+// Maximum time (in milliseconds) to wait for the usb events at once,
+// such that a cancellation request is noticed quickly.
+#define SLICE      100
+
+#define FTDI_VID   0x0403
+#define CP210X_VID 0x10C4
+#define PL2303_VID 0x067B
+
+// FTDI requests.
+#define FTDI_RESET          0x00
+#define FTDI_MODEM_CTRL     0x01
+#define FTDI_SET_FLOW_CTRL  0x02
+#define FTDI_SET_BAUDRATE   0x03
+#define FTDI_SET_DATA       0x04
+#define FTDI_SET_LATENCY    0x09
+
+#define FTDI_RESET_SIO      0
+#define FTDI_PURGE_RX       1
+#define FTDI_PURGE_TX       2
+
+#define FTDI_LATENCY        16
+
+// CP210x requests.
+#define CP210X_IFC_ENABLE   0x00
+#define CP210X_SET_LINE_CTL 0x03
+#define CP210X_SET_BREAK    0x05
+#define CP210X_SET_MHS      0x07
+#define CP210X_GET_MDMSTS   0x08
+#define CP210X_PURGE        0x12
+#define CP210X_SET_BAUDRATE 0x1E
+
+// CDC ACM requests, also used by the PL2303.
+#define CDC_SET_LINE_CODING        0x20
+#define CDC_SET_CONTROL_LINE_STATE 0x22
+#define CDC_SEND_BREAK             0x23
+
+// PL2303 vendor requests.
+#define PL2303_VENDOR       0x01
+
+#define LINE_DTR 0x01
+#define LINE_RTS 0x02
+
+typedef enum dc_usbserial_chip_t {
+	DC_USBSERIAL_CDC,
+	DC_USBSERIAL_FTDI,
+	DC_USBSERIAL_CP210X,
+	DC_USBSERIAL_PL2303,
+} dc_usbserial_chip_t;
+
+static dc_status_t dc_usbserial_set_timeout (dc_iostream_t *iostream, int timeout);
+static dc_status_t dc_usbserial_set_break (dc_iostream_t *iostream, unsigned int value);
+static dc_status_t dc_usbserial_set_dtr (dc_iostream_t *iostream, unsigned int value);
+static dc_status_t dc_usbserial_set_rts (dc_iostream_t *iostream, unsigned int value);
+static dc_status_t dc_usbserial_get_lines (dc_iostream_t *iostream, unsigned int *value);
+static dc_status_t dc_usbserial_get_available (dc_iostream_t *iostream, size_t *value);
+static dc_status_t dc_usbserial_configure (dc_iostream_t *iostream, unsigned int baudrate, unsigned int databits, dc_parity_t parity, dc_stopbits_t stopbits, dc_flowcontrol_t flowcontrol);
+static dc_status_t dc_usbserial_poll (dc_iostream_t *iostream, int timeout);
+static dc_status_t dc_usbserial_read (dc_iostream_t *iostream, void *data, size_t size, size_t *actual);
+static dc_status_t dc_usbserial_write (dc_iostream_t *iostream, const void *data, size_t size, size_t *actual);
+static dc_status_t dc_usbserial_ioctl (dc_iostream_t *iostream, unsigned int request, void *data, size_t size);
+static dc_status_t dc_usbserial_purge (dc_iostream_t *iostream, dc_direction_t direction);
+static dc_status_t dc_usbserial_sleep (dc_iostream_t *iostream, unsigned int milliseconds);
+static dc_status_t dc_usbserial_close (dc_iostream_t *iostream);
+
+typedef struct dc_usbserial_t {
+	/* Base class. */
+	dc_iostream_t base;
+	/* Internal state. */
+	libusb_context *session;
+	libusb_device_handle *handle;
+	dc_usbserial_chip_t chip;
+	int interface;
+	int control;
+	unsigned int port;
+	unsigned int multiport;
+	unsigned char endpoint_in;
+	unsigned char endpoint_out;
+	unsigned int packetsize;
+	int timeout;
+	/* Output lines (DTR and RTS), line settings and the modem status
+	 * reported by the FTDI chips. */
+	unsigned int lines;
+	unsigned int lineprop;
+	unsigned int status;
+	/* The queued bulk IN transfers. A transfer is only submitted if
+	 * the ring has room for all the data of the pending transfers, so
+	 * the received data never has to be dropped. */
+	struct libusb_transfer *transfers[NTRANSFERS];
+	unsigned int pending[NTRANSFERS];
+	unsigned int npending;
+	unsigned int length;
+	unsigned int stopped;
+	dc_status_t error;
+	/* The receive ring. */
+	unsigned char *ring;
+	size_t head;
+	size_t count;
+	dc_timer_t *timer;
+} dc_usbserial_t;
+
+static const dc_iostream_vtable_t dc_usbserial_vtable = {
+	sizeof(dc_usbserial_t),
+	dc_usbserial_set_timeout, /* set_timeout */
+	dc_usbserial_set_break, /* set_break */
+	dc_usbserial_set_dtr, /* set_dtr */
+	dc_usbserial_set_rts, /* set_rts */
+	dc_usbserial_get_lines, /* get_lines */
+	dc_usbserial_get_available, /* get_available */
+	dc_usbserial_configure, /* configure */
+	dc_usbserial_poll, /* poll */
+	dc_usbserial_read, /* read */
+	dc_usbserial_write, /* write */
+	NULL, /* read_async */
+	NULL, /* write_async */
+	NULL, /* writev */
+	dc_usbserial_ioctl, /* ioctl */
+	NULL, /* flush */
+	dc_usbserial_purge, /* purge */
+	dc_usbserial_sleep, /* sleep */
+	NULL, /* set_interrupt */
+	dc_usbserial_close, /* close */
+};
+
+static dc_status_t
+syserror(int errcode)
+{
+	switch (errcode) {
+	case LIBUSB_ERROR_INVALID_PARAM:
+		return DC_STATUS_INVALIDARGS;
+	case LIBUSB_ERROR_NO_MEM:
+		return DC_STATUS_NOMEMORY;
+	case LIBUSB_ERROR_NO_DEVICE:
+	case LIBUSB_ERROR_NOT_FOUND:
+		return DC_STATUS_NODEVICE;
+	case LIBUSB_ERROR_ACCESS:
+	case LIBUSB_ERROR_BUSY:
+		return DC_STATUS_NOACCESS;
+	case LIBUSB_ERROR_TIMEOUT:
+		return DC_STATUS_TIMEOUT;
+	case LIBUSB_ERROR_NOT_SUPPORTED:
+		return DC_STATUS_UNSUPPORTED;
+	default:
+		return DC_STATUS_IO;
+	}
+}
+
+static dc_status_t
+dc_usbserial_control (dc_usbserial_t *device, unsigned int type, unsigned int request, unsigned int value, unsigned int index, unsigned char data[], unsigned int size)
+{
+	int rc = libusb_control_transfer (device->handle, type, request, value, index, data, size, 1000);
+	if (rc < 0) {
+		ERROR (device->base.context, "Usb control transfer failed (%s).",
+			libusb_error_name (rc));
+		return syserror (rc);
+	}
+
+	if ((unsigned int) rc != size) {
+		ERROR (device->base.context, "Unexpected size of the usb control transfer.");
+		return DC_STATUS_IO;
+	}
+
+	return DC_STATUS_SUCCESS;
+}
+
+static dc_status_t
+dc_usbserial_vendor_out (dc_usbserial_t *device, unsigned int request, unsigned int value, unsigned int index)
+{
+	unsigned int type = LIBUSB_ENDPOINT_OUT | LIBUSB_REQUEST_TYPE_VENDOR |
+		(device->chip == DC_USBSERIAL_CP210X ? LIBUSB_RECIPIENT_INTERFACE : LIBUSB_RECIPIENT_DEVICE);
+
+	return dc_usbserial_control (device, type, request, value, index, NULL, 0);
+}
+
+static dc_status_t
+dc_usbserial_class_out (dc_usbserial_t *device, unsigned int request, unsigned int value, unsigned char data[], unsigned int size)
+{
+	return dc_usbserial_control (device,
+		LIBUSB_ENDPOINT_OUT | LIBUSB_REQUEST_TYPE_CLASS | LIBUSB_RECIPIENT_INTERFACE,
+		request, value, device->control, data, size);
+}
+
+/*
+ * The port index used by the FTDI requests. For the chips with more
+ * than one port, the high byte holds additional request parameters.
+ */
+static unsigned int
+dc_usbserial_ftdi_index (dc_usbserial_t *device, unsigned int value)
+{
+	if (device->multiport)
+		return (value << 8) | device->port;
+	else
+		return value;
+}
+
+/*
+ * Baudrate divisor of the FTDI chips, relative to a 3 MHz clock and
+ * with a fractional part in steps of 1/8.
+ */
+static unsigned int
+dc_usbserial_ftdi_divisor (unsigned int baudrate)
+{
+	static const unsigned char fraction[8] = {0, 3, 2, 4, 1, 5, 6, 7};
+
+	unsigned int divisor = (3000000 * 8 + baudrate / 2) / baudrate;
+	if (divisor < 8)
+		divisor = 8;
+	if (divisor > 0x1FFFF)
+		divisor = 0x1FFFF;
+
+	unsigned int encoded = (divisor >> 3) | (fraction[divisor & 0x07] << 14);
+
+	// The divisors of 1 and 1.5 have a special encoding.
+	if (encoded == 1)
+		encoded = 0;
+	else if (encoded == 0x4001)
+		encoded = 1;
+
+	return encoded;
+}
+
+static dc_status_t
+dc_usbserial_set_lines (dc_usbserial_t *device)
+{
+	switch (device->chip) {
+	case DC_USBSERIAL_FTDI:
+		return dc_usbserial_vendor_out (device, FTDI_MODEM_CTRL,
+			0x0300 | device->lines, dc_usbserial_ftdi_index (device, 0));
+	case DC_USBSERIAL_CP210X:
+		return dc_usbserial_vendor_out (device, CP210X_SET_MHS,
+			0x0300 | device->lines, device->interface);
+	default:
+		return dc_usbserial_class_out (device, CDC_SET_CONTROL_LINE_STATE,
+			device->lines, NULL, 0);
+	}
+}
+
+/*
+ * Append the received data to the ring. The FTDI chips prefix every
+ * packet with two modem status bytes, which are removed here.
+ */
+static void
+dc_usbserial_append (dc_usbserial_t *device, const unsigned char data[], size_t size)
+{
+	size_t offset = 0;
+	while (offset < size) {
+		size_t length = size - offset;
+
+		if (device->chip == DC_USBSERIAL_FTDI) {
+			if (length > device->packetsize)
+				length = device->packetsize;
+			if (length < 2)
+				break;
+
+			unsigned int modem = data[offset];
+			device->status =
+				((modem & 0x10) ? DC_LINE_CTS : 0) |
+				((modem & 0x20) ? DC_LINE_DSR : 0) |
+				((modem & 0x40) ? DC_LINE_RNG : 0) |
+				((modem & 0x80) ? DC_LINE_DCD : 0);
+
+			offset += 2;
+			length -= 2;
+		}
+
+		for (size_t i = 0; i < length; ++i) {
+			device->ring[(device->head + device->count) % RINGSIZE] = data[offset + i];
+			device->count++;
+		}
+
+		offset += length;
+	}
+}
+
+static void LIBUSB_CALL
+dc_usbserial_receive_cb (struct libusb_transfer *transfer)
+{
+	dc_usbserial_t *device = (dc_usbserial_t *) transfer->user_data;
+
+	for (unsigned int i = 0; i < NTRANSFERS; ++i) {
+		if (device->transfers[i] == transfer) {
+			device->pending[i] = 0;
+			device->npending--;
+			break;
+		}
+	}
+
+	switch (transfer->status) {
+	case LIBUSB_TRANSFER_COMPLETED:
+	case LIBUSB_TRANSFER_TIMED_OUT:
+	case LIBUSB_TRANSFER_CANCELLED:
+		if (transfer->actual_length > 0)
+			dc_usbserial_append (device, transfer->buffer, transfer->actual_length);
+		break;
+	case LIBUSB_TRANSFER_NO_DEVICE:
+		device->error = DC_STATUS_NODEVICE;
+		break;
+	default:
+		device->error = DC_STATUS_IO;
+		break;
+	}
+}
+
+/*
+ * Submit the idle transfers, as far as the ring has room for them.
+ */
+static dc_status_t
+dc_usbserial_submit (dc_usbserial_t *device)
+{
+	if (device->stopped || device->error != DC_STATUS_SUCCESS)
+		return device->error;
+
+	for (unsigned int i = 0; i < NTRANSFERS; ++i) {
+		if (device->pending[i])
+			continue;
+
+		size_t reserved = device->count + (size_t) (device->npending + 1) * device->length;
+		if (reserved > RINGSIZE)
+			break;
+
+		int rc = libusb_submit_transfer (device->transfers[i]);
+		if (rc != LIBUSB_SUCCESS) {
+			ERROR (device->base.context, "Failed to submit the usb transfer (%s).",
+				libusb_error_name (rc));
+			device->error = syserror (rc);
+			return device->error;
+		}
+
+		device->pending[i] = 1;
+		device->npending++;
+	}
+
+	return DC_STATUS_SUCCESS;
+}
+
+/*
+ * Handle the usb events for at most the timeout, or until a transfer
+ * completes. A negative timeout waits forever.
+ */
+static dc_status_t
+dc_usbserial_events (dc_usbserial_t *device, int timeout)
+{
+	if (device->base.interrupt && dc_interrupt_isset (device->base.interrupt))
+		return DC_STATUS_CANCELLED;
+
+	if (timeout < 0 || timeout > SLICE)
+		timeout = SLICE;
+
+	struct timeval tv = {timeout / 1000, (timeout % 1000) * 1000};
+	int rc = libusb_handle_events_timeout_completed (device->session, &tv, NULL);
+	if (rc != LIBUSB_SUCCESS && rc != LIBUSB_ERROR_INTERRUPTED) {
+		ERROR (device->base.context, "Failed to handle the usb events (%s).",
+			libusb_error_name (rc));
+		return syserror (rc);
+	}
+
+	return DC_STATUS_SUCCESS;
+}
+
+/*
+ * Wait until at least the requested amount of data is available in the
+ * ring, or the timeout expires.
+ */
+static dc_status_t
+dc_usbserial_wait (dc_usbserial_t *device, size_t size, int timeout)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	dc_usecs_t start = 0, now = 0;
+
+	if (size > RINGSIZE)
+		size = RINGSIZE;
+
+	if (timeout > 0) {
+		status = dc_timer_now (device->timer, &start);
+		if (status != DC_STATUS_SUCCESS)
+			return status;
+	}
+
+	while (device->count < size) {
+		status = dc_usbserial_submit (device);
+		if (status != DC_STATUS_SUCCESS)
+			return status;
+
+		int remaining = timeout;
+		if (timeout > 0) {
+			status = dc_timer_now (device->timer, &now);
+			if (status != DC_STATUS_SUCCESS)
+				return status;
+
+			dc_usecs_t elapsed = (now - start) / 1000;
+			remaining = elapsed >= (dc_usecs_t) timeout ? 0 : timeout - (int) elapsed;
+		}
+
+		status = dc_usbserial_events (device, remaining);
+		if (status != DC_STATUS_SUCCESS)
+			return status;
+
+		if (remaining == 0)
+			break;
+	}
+
+	if (device->count == 0 && device->error != DC_STATUS_SUCCESS)
+		return device->error;
+
+	return device->count < size ? DC_STATUS_TIMEOUT : DC_STATUS_SUCCESS;
+}
+
+/*
+ * Cancel the pending transfers, and wait until libusb returns them.
+ * The data they received is kept in the ring.
+ */
+static void
+dc_usbserial_stop (dc_usbserial_t *device)
+{
+	device->stopped = 1;
+
+	for (unsigned int i = 0; i < NTRANSFERS; ++i) {
+		if (device->pending[i])
+			libusb_cancel_transfer (device->transfers[i]);
+	}
+
+	while (device->npending) {
+		int rc = libusb_handle_events (device->session);
+		if (rc != LIBUSB_SUCCESS && rc != LIBUSB_ERROR_INTERRUPTED)
+			break;
+	}
+}
+
+static dc_status_t
+dc_usbserial_start (dc_usbserial_t *device)
+{
+	device->stopped = 0;
+
+	return dc_usbserial_submit (device);
+}
+
+/*
+ * Find the interface with the bulk endpoints, and the control interface
+ * of the CDC ACM devices.
+ */
+static dc_status_t
+dc_usbserial_endpoints (dc_usbserial_t *device, const struct libusb_config_descriptor *config)
+{
+	device->interface = -1;
+	device->control = -1;
+
+	for (unsigned int i = 0; i < config->bNumInterfaces; ++i) {
+		const struct libusb_interface *iface = &config->interface[i];
+		if (iface->num_altsetting < 1)
+			continue;
+
+		const struct libusb_interface_descriptor *desc = &iface->altsetting[0];
+		if (desc->bInterfaceClass == LIBUSB_CLASS_COMM && device->control < 0)
+			device->control = desc->bInterfaceNumber;
+
+		if (device->interface >= 0)
+			continue;
+
+		const struct libusb_endpoint_descriptor *ep_in = NULL, *ep_out = NULL;
+		for (unsigned int j = 0; j < desc->bNumEndpoints; ++j) {
+			const struct libusb_endpoint_descriptor *ep = &desc->endpoint[j];
+			if ((ep->bmAttributes & LIBUSB_TRANSFER_TYPE_MASK) != LIBUSB_TRANSFER_TYPE_BULK)
+				continue;
+			if ((ep->bEndpointAddress & LIBUSB_ENDPOINT_DIR_MASK) == LIBUSB_ENDPOINT_IN) {
+				if (ep_in == NULL)
+					ep_in = ep;
+			} else {
+				if (ep_out == NULL)
+					ep_out = ep;
+			}
+		}
+
+		if (ep_in && ep_out) {
+			device->interface = desc->bInterfaceNumber;
+			device->endpoint_in = ep_in->bEndpointAddress;
+			device->endpoint_out = ep_out->bEndpointAddress;
+			device->packetsize = ep_in->wMaxPacketSize;
+		}
+	}
+
+	if (device->interface < 0) {
+		ERROR (device->base.context, "No bulk endpoints found.");
+		return DC_STATUS_NODEVICE;
+	}
+
+	if (device->packetsize == 0)
+		device->packetsize = 64;
+
+	device->multiport = config->bNumInterfaces > 1;
+	device->port = device->interface + 1;
+	if (device->chip != DC_USBSERIAL_CDC || device->control < 0)
+		device->control = device->interface;
+
+	return DC_STATUS_SUCCESS;
+}
+
+/*
+ * Initialization sequence of the PL2303 chips, as used by the vendor
+ * drivers.
+ */
+static dc_status_t
+dc_usbserial_pl2303_init (dc_usbserial_t *device)
+{
+	static const struct {
+		unsigned int read;
+		unsigned int value;
+		unsigned int index;
+	} sequence[] = {
+		{1, 0x8484, 0}, {0, 0x0404, 0}, {1, 0x8484, 0}, {1, 0x8383, 0},
+		{1, 0x8484, 0}, {0, 0x0404, 1}, {1, 0x8484, 0}, {1, 0x8383, 0},
+		{0, 0x0000, 1}, {0, 0x0001, 0}, {0, 0x0002, 0x44},
+	};
+
+	for (unsigned int i = 0; i < C_ARRAY_SIZE(sequence); ++i) {
+		dc_status_t status = DC_STATUS_SUCCESS;
+		if (sequence[i].read) {
+			unsigned char value = 0;
+			status = dc_usbserial_control (device,
+				LIBUSB_ENDPOINT_IN | LIBUSB_REQUEST_TYPE_VENDOR | LIBUSB_RECIPIENT_DEVICE,
+				PL2303_VENDOR, sequence[i].value, sequence[i].index, &value, 1);
+		} else {
+			status = dc_usbserial_vendor_out (device, PL2303_VENDOR,
+				sequence[i].value, sequence[i].index);
+		}
+		if (status != DC_STATUS_SUCCESS)
+			return status;
+	}
+
+	return DC_STATUS_SUCCESS;
+}
+
+static dc_status_t
+dc_usbserial_init (dc_usbserial_t *device)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+
+	switch (device->chip) {
+	case DC_USBSERIAL_FTDI:
+		status = dc_usbserial_vendor_out (device, FTDI_RESET, FTDI_RESET_SIO,
+			dc_usbserial_ftdi_index (device, 0));
+		if (status != DC_STATUS_SUCCESS)
+			return status;
+		return dc_usbserial_vendor_out (device, FTDI_SET_LATENCY, FTDI_LATENCY,
+			dc_usbserial_ftdi_index (device, 0));
+	case DC_USBSERIAL_CP210X:
+		return dc_usbserial_vendor_out (device, CP210X_IFC_ENABLE, 1, device->interface);
+	case DC_USBSERIAL_PL2303:
+		return dc_usbserial_pl2303_init (device);
+	default:
+		return DC_STATUS_SUCCESS;
+	}
+}
+
+static dc_status_t
+dc_usbserial_session_new (libusb_context **session, dc_context_t *context)
+{
+	int rc = LIBUSB_SUCCESS;
+
+	// Device discovery is not needed for a wrapped file descriptor,
+	// and not permitted for regular applications on Android.
+#if LIBUSB_API_VERSION >= 0x0100010A
+	struct libusb_init_option options[] = {
+		{LIBUSB_OPTION_NO_DEVICE_DISCOVERY, {0}},
+	};
+	rc = libusb_init_context (session, options, C_ARRAY_SIZE(options));
+#else
+#if defined(__ANDROID__) && (LIBUSB_API_VERSION >= 0x01000108)
+	// The option is only available since libusb 1.0.24.
+	libusb_set_option (NULL, LIBUSB_OPTION_WEAK_AUTHORITY);
+#endif
+	rc = libusb_init (session);
+#endif
+	if (rc != LIBUSB_SUCCESS) {
+		ERROR (context, "Failed to initialize usb support (%s).",
+			libusb_error_name (rc));
+		return syserror (rc);
+	}
+
+	return DC_STATUS_SUCCESS;
+}
+#endif
+
+dc_status_t
+dc_usbserial_open (dc_iostream_t **out, dc_context_t *context, int fd)
+{
+#ifdef USE_USBSERIAL
+	dc_status_t status = DC_STATUS_SUCCESS;
+	dc_usbserial_t *device = NULL;
+	struct libusb_config_descriptor *config = NULL;
+
+	if (out == NULL || fd < 0)
+		return DC_STATUS_INVALIDARGS;
+
+	// Allocate memory.
+	device = (dc_usbserial_t *) dc_iostream_allocate (context, &dc_usbserial_vtable, DC_TRANSPORT_SERIAL);
+	if (device == NULL) {
+		ERROR (context, "Out of memory.");
+		return DC_STATUS_NOMEMORY;
+	}
+
+	device->handle = NULL;
+	device->timeout = -1;
+	device->lines = 0;
+	device->lineprop = 8;
+	device->status = 0;
+	device->npending = 0;
+	device->stopped = 0;
+	device->error = DC_STATUS_SUCCESS;
+	device->head = 0;
+	device->count = 0;
+	for (unsigned int i = 0; i < NTRANSFERS; ++i) {
+		device->transfers[i] = NULL;
+		device->pending[i] = 0;
+	}
+
+	device->ring = (unsigned char *) malloc (RINGSIZE);
+	if (device->ring == NULL) {
+		ERROR (context, "Out of memory.");
+		status = DC_STATUS_NOMEMORY;
+		goto error_free;
+	}
+
+	status = dc_timer_new (&device->timer);
+	if (status != DC_STATUS_SUCCESS) {
+		ERROR (context, "Failed to create a high resolution timer.");
+		goto error_free_ring;
+	}
+
+	// Initialize the usb library.
+	status = dc_usbserial_session_new (&device->session, context);
+	if (status != DC_STATUS_SUCCESS) {
+		goto error_timer_free;
+	}
+
+	// Open the USB device.
+	int rc = libusb_wrap_sys_device (device->session, (intptr_t) fd, &device->handle);
+	if (rc != LIBUSB_SUCCESS) {
+		ERROR (context, "Failed to open the usb device (%s).",
+			libusb_error_name (rc));
+		status = syserror (rc);
+		goto error_session_free;
+	}
+
+	// Identify the chip.
+	struct libusb_device_descriptor desc;
+	rc = libusb_get_device_descriptor (libusb_get_device (device->handle), &desc);
+	if (rc != LIBUSB_SUCCESS) {
+		ERROR (context, "Failed to get the device descriptor (%s).",
+			libusb_error_name (rc));
+		status = syserror (rc);
+		goto error_usb_close;
+	}
+
+	switch (desc.idVendor) {
+	case FTDI_VID:
+		device->chip = DC_USBSERIAL_FTDI;
+		break;
+	case CP210X_VID:
+		device->chip = DC_USBSERIAL_CP210X;
+		break;
+	case PL2303_VID:
+		device->chip = DC_USBSERIAL_PL2303;
+		break;
+	default:
+		device->chip = DC_USBSERIAL_CDC;
+		break;
+	}
+
+	// Find the endpoints.
+	rc = libusb_get_active_config_descriptor (libusb_get_device (device->handle), &config);
+	if (rc != LIBUSB_SUCCESS) {
+		ERROR (context, "Failed to get the configuration descriptor (%s).",
+			libusb_error_name (rc));
+		status = syserror (rc);
+		goto error_usb_close;
+	}
+
+	status = dc_usbserial_endpoints (device, config);
+	libusb_free_config_descriptor (config);
+	if (status != DC_STATUS_SUCCESS) {
+		goto error_usb_close;
+	}
+
+	INFO (context, "Open: vid=%04x, pid=%04x, chip=%u, interface=%u, endpoints=%02x,%02x",
+		desc.idVendor, desc.idProduct, device->chip, device->interface,
+		device->endpoint_in, device->endpoint_out);
+
+	libusb_set_auto_detach_kernel_driver (device->handle, 1);
+
+	// Claim the interfaces.
+	rc = libusb_claim_interface (device->handle, device->interface);
+	if (rc != LIBUSB_SUCCESS) {
+		ERROR (context, "Failed to claim the usb interface (%s).",
+			libusb_error_name (rc));
+		status = syserror (rc);
+		goto error_usb_close;
+	}
+
+	if (device->control != device->interface) {
+		rc = libusb_claim_interface (device->handle, device->control);
+		if (rc != LIBUSB_SUCCESS) {
+			ERROR (context, "Failed to claim the usb interface (%s).",
+				libusb_error_name (rc));
+			status = syserror (rc);
+			goto error_release;
+		}
+	}
+
+	// Initialize the chip.
+	status = dc_usbserial_init (device);
+	if (status != DC_STATUS_SUCCESS) {
+		ERROR (context, "Failed to initialize the usb serial chip.");
+		goto error_release;
+	}
+
+	// Allocate the bulk IN transfers.
+	device->length = NPACKETS * device->packetsize;
+	for (unsigned int i = 0; i < NTRANSFERS; ++i) {
+		unsigned char *buffer = (unsigned char *) malloc (device->length);
+		device->transfers[i] = libusb_alloc_transfer (0);
+		if (buffer == NULL || device->transfers[i] == NULL) {
+			ERROR (context, "Out of memory.");
+			free (buffer);
+			status = DC_STATUS_NOMEMORY;
+			goto error_transfers_free;
+		}
+
+		libusb_fill_bulk_transfer (device->transfers[i], device->handle, device->endpoint_in,
+			buffer, device->length, dc_usbserial_receive_cb, device, 0);
+		device->transfers[i]->flags = LIBUSB_TRANSFER_FREE_BUFFER;
+	}
+
+	// Start receiving.
+	status = dc_usbserial_start (device);
+	if (status != DC_STATUS_SUCCESS) {
+		goto error_transfers_free;
+	}
+
+	*out = (dc_iostream_t *) device;
+
+	return DC_STATUS_SUCCESS;
+
+error_transfers_free:
+	dc_usbserial_stop (device);
+	for (unsigned int i = 0; i < NTRANSFERS; ++i) {
+		libusb_free_transfer (device->transfers[i]);
+	}
+error_release:
+	if (device->control != device->interface)
+		libusb_release_interface (device->handle, device->control);
+	libusb_release_interface (device->handle, device->interface);
+error_usb_close:
+	libusb_close (device->handle);
+error_session_free:
+	libusb_exit (device->session);
+error_timer_free:
+	dc_timer_free (device->timer);
+error_free_ring:
+	free (device->ring);
+error_free:
+	dc_iostream_deallocate ((dc_iostream_t *) device);
+	return status;
+#else
+	return DC_STATUS_UNSUPPORTED;
+#endif
+}
+
+#ifdef USE_USBSERIAL
+static dc_status_t
+dc_usbserial_close (dc_iostream_t *abstract)
+{
+	dc_usbserial_t *device = (dc_usbserial_t *) abstract;
+
+	dc_usbserial_stop (device);
+	for (unsigned int i = 0; i < NTRANSFERS; ++i) {
+		libusb_free_transfer (device->transfers[i]);
+	}
+
+	if (device->control != device->interface)
+		libusb_release_interface (device->handle, device->control);
+	libusb_release_interface (device->handle, device->interface);
+	libusb_close (device->handle);
+	libusb_exit (device->session);
+	dc_timer_free (device->timer);
+	free (device->ring);
+
+	return DC_STATUS_SUCCESS;
+}
+
+static dc_status_t
+dc_usbserial_set_timeout (dc_iostream_t *abstract, int timeout)
+{
+	dc_usbserial_t *device = (dc_usbserial_t *) abstract;
+
+	device->timeout = timeout;
+
+	return DC_STATUS_SUCCESS;
+}
+
+static dc_status_t
+dc_usbserial_set_break (dc_iostream_t *abstract, unsigned int value)
+{
+	dc_usbserial_t *device = (dc_usbserial_t *) abstract;
+
+	switch (device->chip) {
+	case DC_USBSERIAL_FTDI:
+		return dc_usbserial_vendor_out (device, FTDI_SET_DATA,
+			device->lineprop | (value ? 0x4000 : 0), dc_usbserial_ftdi_index (device, 0));
+	case DC_USBSERIAL_CP210X:
+		return dc_usbserial_vendor_out (device, CP210X_SET_BREAK, value ? 1 : 0, device->interface);
+	default:
+		return dc_usbserial_class_out (device, CDC_SEND_BREAK, value ? 0xFFFF : 0, NULL, 0);
+	}
+}
+
+static dc_status_t
+dc_usbserial_set_dtr (dc_iostream_t *abstract, unsigned int value)
+{
+	dc_usbserial_t *device = (dc_usbserial_t *) abstract;
+
+	if (value)
+		device->lines |= LINE_DTR;
+	else
+		device->lines &= ~LINE_DTR;
+
+	return dc_usbserial_set_lines (device);
+}
+
+static dc_status_t
+dc_usbserial_set_rts (dc_iostream_t *abstract, unsigned int value)
+{
+	dc_usbserial_t *device = (dc_usbserial_t *) abstract;
+
+	if (value)
+		device->lines |= LINE_RTS;
+	else
+		device->lines &= ~LINE_RTS;
+
+	return dc_usbserial_set_lines (device);
+}
+
+static dc_status_t
+dc_usbserial_get_lines (dc_iostream_t *abstract, unsigned int *value)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	dc_usbserial_t *device = (dc_usbserial_t *) abstract;
+	unsigned int lines = 0;
+
+	switch (device->chip) {
+	case DC_USBSERIAL_FTDI:
+		// Reported in every packet.
+		lines = device->status;
+		break;
+	case DC_USBSERIAL_CP210X:
+		{
+			unsigned char modem = 0;
+			status = dc_usbserial_control (device,
+				LIBUSB_ENDPOINT_IN | LIBUSB_REQUEST_TYPE_VENDOR | LIBUSB_RECIPIENT_INTERFACE,
+				CP210X_GET_MDMSTS, 0, device->interface, &modem, 1);
+			if (status != DC_STATUS_SUCCESS)
+				return status;
+
+			lines =
+				((modem & 0x10) ? DC_LINE_CTS : 0) |
+				((modem & 0x20) ? DC_LINE_DSR : 0) |
+				((modem & 0x40) ? DC_LINE_RNG : 0) |
+				((modem & 0x80) ? DC_LINE_DCD : 0);
+		}
+		break;
+	default:
+		// Only reported on the interrupt endpoint.
+		return DC_STATUS_UNSUPPORTED;
+	}
+
+	if (value)
+		*value = lines;
+
+	return DC_STATUS_SUCCESS;
+}
+
+static dc_status_t
+dc_usbserial_get_available (dc_iostream_t *abstract, size_t *value)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	dc_usbserial_t *device = (dc_usbserial_t *) abstract;
+
+	// Collect the transfers that already completed.
+	status = dc_usbserial_submit (device);
+	if (status == DC_STATUS_SUCCESS)
+		status = dc_usbserial_events (device, 0);
+	if (status != DC_STATUS_SUCCESS && device->count == 0)
+		return status;
+
+	if (value)
+		*value = device->count;
+
+	return DC_STATUS_SUCCESS;
+}
+
+static dc_status_t
+dc_usbserial_configure (dc_iostream_t *abstract, unsigned int baudrate, unsigned int databits, dc_parity_t parity, dc_stopbits_t stopbits, dc_flowcontrol_t flowcontrol)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	dc_usbserial_t *device = (dc_usbserial_t *) abstract;
+
+	if (baudrate == 0 || databits < 5 || databits > 8)
+		return DC_STATUS_INVALIDARGS;
+
+	// The parity and stop bits use the same values for all chips.
+	unsigned int nparity = 0, nstopbits = 0;
+	switch (parity) {
+	case DC_PARITY_NONE:  nparity = 0; break;
+	case DC_PARITY_ODD:   nparity = 1; break;
+	case DC_PARITY_EVEN:  nparity = 2; break;
+	case DC_PARITY_MARK:  nparity = 3; break;
+	case DC_PARITY_SPACE: nparity = 4; break;
+	default:
+		return DC_STATUS_INVALIDARGS;
+	}
+
+	switch (stopbits) {
+	case DC_STOPBITS_ONE:          nstopbits = 0; break;
+	case DC_STOPBITS_ONEPOINTFIVE: nstopbits = 1; break;
+	case DC_STOPBITS_TWO:          nstopbits = 2; break;
+	default:
+		return DC_STATUS_INVALIDARGS;
+	}
+
+	if (flowcontrol != DC_FLOWCONTROL_NONE && device->chip != DC_USBSERIAL_FTDI)
+		return DC_STATUS_UNSUPPORTED;
+
+	switch (device->chip) {
+	case DC_USBSERIAL_FTDI:
+		{
+			unsigned int divisor = dc_usbserial_ftdi_divisor (baudrate);
+			status = dc_usbserial_vendor_out (device, FTDI_SET_BAUDRATE,
+				divisor & 0xFFFF, dc_usbserial_ftdi_index (device, divisor >> 16));
+			if (status != DC_STATUS_SUCCESS)
+				return status;
+
+			device->lineprop = databits | (nparity << 8) | (nstopbits << 11);
+			status = dc_usbserial_vendor_out (device, FTDI_SET_DATA,
+				device->lineprop, dc_usbserial_ftdi_index (device, 0));
+			if (status != DC_STATUS_SUCCESS)
+				return status;
+
+			unsigned int value = 0, flow = 0;
+			switch (flowcontrol) {
+			case DC_FLOWCONTROL_HARDWARE:
+				flow = 0x01;
+				break;
+			case DC_FLOWCONTROL_SOFTWARE:
+				flow = 0x04;
+				value = 0x11 | (0x13 << 8);
+				break;
+			default:
+				flow = 0;
+				break;
+			}
+			status = dc_usbserial_vendor_out (device, FTDI_SET_FLOW_CTRL,
+				value, (flow << 8) | device->port);
+		}
+		break;
+	case DC_USBSERIAL_CP210X:
+		{
+			unsigned char data[4];
+			array_uint32_le_set (data, baudrate);
+			status = dc_usbserial_control (device,
+				LIBUSB_ENDPOINT_OUT | LIBUSB_REQUEST_TYPE_VENDOR | LIBUSB_RECIPIENT_INTERFACE,
+				CP210X_SET_BAUDRATE, 0, device->interface, data, sizeof (data));
+			if (status != DC_STATUS_SUCCESS)
+				return status;
+
+			status = dc_usbserial_vendor_out (device, CP210X_SET_LINE_CTL,
+				nstopbits | (nparity << 4) | (databits << 8), device->interface);
+		}
+		break;
+	default:
+		{
+			unsigned char data[7];
+			array_uint32_le_set (data, baudrate);
+			data[4] = nstopbits;
+			data[5] = nparity;
+			data[6] = databits;
+			status = dc_usbserial_class_out (device, CDC_SET_LINE_CODING, 0, data, sizeof (data));
+		}
+		break;
+	}
+
+	if (status != DC_STATUS_SUCCESS) {
+		ERROR (abstract->context, "Failed to set the line settings.");
+		return status;
+	}
+
+	return DC_STATUS_SUCCESS;
+}
+
+static dc_status_t
+dc_usbserial_poll (dc_iostream_t *abstract, int timeout)
+{
+	dc_usbserial_t *device = (dc_usbserial_t *) abstract;
+
+	return dc_usbserial_wait (device, 1, timeout);
+}
+
+static dc_status_t
+dc_usbserial_read (dc_iostream_t *abstract, void *data, size_t size, size_t *actual)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	dc_usbserial_t *device = (dc_usbserial_t *) abstract;
+	unsigned char *buffer = (unsigned char *) data;
+	size_t nbytes = 0;
+
+	while (nbytes < size) {
+		// Wait for the data, in chunks of at most the ring size.
+		size_t remaining = size - nbytes;
+		status = dc_usbserial_wait (device, remaining, device->timeout);
+		if (status != DC_STATUS_SUCCESS && status != DC_STATUS_TIMEOUT)
+			break;
+
+		size_t n = device->count < remaining ? device->count : remaining;
+		while (n) {
+			size_t length = RINGSIZE - device->head;
+			if (length > n)
+				length = n;
+
+			memcpy (buffer + nbytes, device->ring + device->head, length);
+			device->head = (device->head + length) % RINGSIZE;
+			device->count -= length;
+			nbytes += length;
+			n -= length;
+		}
+
+		if (status == DC_STATUS_TIMEOUT) {
+			if (nbytes == size)
+				status = DC_STATUS_SUCCESS;
+			break;
+		}
+	}
+
+	// Reuse the space that was freed.
+	if (status == DC_STATUS_SUCCESS)
+		status = dc_usbserial_submit (device);
+
+	if (actual)
+		*actual = nbytes;
+
+	return status;
+}
+
+static dc_status_t
+dc_usbserial_write (dc_iostream_t *abstract, const void *data, size_t size, size_t *actual)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	dc_usbserial_t *device = (dc_usbserial_t *) abstract;
+	int nbytes = 0;
+
+	int rc = libusb_bulk_transfer (device->handle, device->endpoint_out, (void *) data, size, &nbytes, 0);
+	if (rc != LIBUSB_SUCCESS || nbytes < 0) {
+		ERROR (abstract->context, "Usb write bulk transfer failed (%s).",
+			libusb_error_name (rc));
+		status = syserror (rc);
+		if (nbytes < 0)
+			nbytes = 0;
+	}
+
+	if (actual)
+		*actual = nbytes;
+
+	return status;
+}
+
+static dc_status_t
+dc_usbserial_set_latency (dc_usbserial_t *device, unsigned int value)
+{
+	if (device->chip != DC_USBSERIAL_FTDI)
+		return DC_STATUS_SUCCESS;
+
+	// The latency timer has a limited range.
+	if (value < 1)
+		value = 1;
+	if (value > 255)
+		value = 255;
+
+	return dc_usbserial_vendor_out (device, FTDI_SET_LATENCY, value,
+		dc_usbserial_ftdi_index (device, 0));
+}
+
+static dc_status_t
+dc_usbserial_ioctl (dc_iostream_t *abstract, unsigned int request, void *data, size_t size)
+{
+	dc_usbserial_t *device = (dc_usbserial_t *) abstract;
+
+	switch (request) {
+	case DC_IOCTL_SERIAL_SET_LATENCY:
+		return dc_usbserial_set_latency (device, *(unsigned int *) data);
+	case DC_IOCTL_SET_LATENCY:
+		switch (*(unsigned int *) data) {
+		case DC_LATENCY_LOW:
+			return dc_usbserial_set_latency (device, 1);
+		case DC_LATENCY_DEFAULT:
+		case DC_LATENCY_THROUGHPUT:
+			return dc_usbserial_set_latency (device, FTDI_LATENCY);
+		default:
+			return DC_STATUS_INVALIDARGS;
+		}
+	default:
+		return DC_STATUS_UNSUPPORTED;
+	}
+}
+
+static dc_status_t
+dc_usbserial_purge (dc_iostream_t *abstract, dc_direction_t direction)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	dc_usbserial_t *device = (dc_usbserial_t *) abstract;
+
+	if (direction & DC_DIRECTION_INPUT) {
+		// Discard the data in the transfers and the ring.
+		dc_usbserial_stop (device);
+		device->head = 0;
+		device->count = 0;
+	}
+
+	switch (device->chip) {
+	case DC_USBSERIAL_FTDI:
+		if (direction & DC_DIRECTION_INPUT)
+			status = dc_usbserial_vendor_out (device, FTDI_RESET, FTDI_PURGE_RX,
+				dc_usbserial_ftdi_index (device, 0));
+		if (status == DC_STATUS_SUCCESS && (direction & DC_DIRECTION_OUTPUT))
+			status = dc_usbserial_vendor_out (device, FTDI_RESET, FTDI_PURGE_TX,
+				dc_usbserial_ftdi_index (device, 0));
+		break;
+	case DC_USBSERIAL_CP210X:
+		status = dc_usbserial_vendor_out (device, CP210X_PURGE,
+			((direction & DC_DIRECTION_INPUT) ? 0x0A : 0) |
+			((direction & DC_DIRECTION_OUTPUT) ? 0x05 : 0),
+			device->interface);
+		break;
+	case DC_USBSERIAL_PL2303:
+		if (direction & DC_DIRECTION_INPUT)
+			status = dc_usbserial_vendor_out (device, 0x09, 0, 0);
+		if (status == DC_STATUS_SUCCESS && (direction & DC_DIRECTION_OUTPUT))
+			status = dc_usbserial_vendor_out (device, 0x08, 0, 0);
+		break;
+	default:
+		break;
+	}
+
+	if (direction & DC_DIRECTION_INPUT) {
+		// Data that arrived during the purge is discarded as well.
+		device->head = 0;
+		device->count = 0;
+		dc_status_t rc = dc_usbserial_start (device);
+		if (status == DC_STATUS_SUCCESS)
+			status = rc;
+	}
+
+	return status;
+}
+
+static dc_status_t
+dc_usbserial_sleep (dc_iostream_t *abstract, unsigned int timeout)
+{
+	if (abstract->interrupt)
+		return dc_interrupt_sleep (abstract->interrupt, timeout);
+
+	if (dc_platform_sleep (timeout) != 0)
+		return DC_STATUS_IO;
+
+	return DC_STATUS_SUCCESS;
+}
+#endif
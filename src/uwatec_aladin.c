@@ -32,6 +32,7 @@
 #define ISINSTANCE(device) dc_device_isinstance((device), &uwatec_aladin_device_vtable)
 
 #define SZ_MEMORY 2048
+#define SZ_PACKET 256
 
 #define RB_PROFILE_BEGIN			0x000
 #define RB_PROFILE_END				0x600
@@ -57,16 +58,15 @@ static const dc_device_vtable_t uwatec_aladin_device_vtable = {
 	DC_FAMILY_UWATEC_ALADIN,
 	uwatec_aladin_device_set_fingerprint, /* set_fingerprint */
 	NULL, /* read */
+	NULL, /* read_range */
 	NULL, /* write */
 	uwatec_aladin_device_dump, /* dump */
 	uwatec_aladin_device_foreach, /* foreach */
+	NULL, /* foreach_header */
 	NULL, /* timesync */
 	NULL /* close */
 };
 
-static dc_status_t
-uwatec_aladin_extract_dives (dc_device_t *device, const unsigned char data[], unsigned int size, dc_dive_callback_t callback, void *userdata);
-
 dc_status_t
 uwatec_aladin_device_open (dc_device_t **out, dc_context_t *context, dc_iostream_t *iostream)
 {
@@ -192,23 +192,42 @@ uwatec_aladin_device_dump (dc_device_t *abstract, dc_buffer_t *buffer)
 	progress.current += 4;
 	device_event_emit (abstract, DC_EVENT_PROGRESS, &progress);
 
-	// Receive the remaining part of the package.
-	status = dc_iostream_read (device->iostream, answer + 4, sizeof (answer) - 4, NULL);
-	if (status != DC_STATUS_SUCCESS) {
-		ERROR (abstract->context, "Unexpected EOF in answer.");
-		return status;
-	}
+	// Reverse the bit order.
+	array_reverse_bits (answer, 4);
 
-	// Update and emit a progress event.
-	progress.current += sizeof (answer) - 4;
-	device_event_emit (abstract, DC_EVENT_PROGRESS, &progress);
+	// Receive the remaining part of the package. The bit order is
+	// reversed as the data arrives, such that the package is ready as
+	// soon as the last byte has been received.
+	unsigned int nbytes = 4;
+	while (nbytes < sizeof (answer)) {
+		if (device_is_cancelled (abstract))
+			return DC_STATUS_CANCELLED;
 
-	// Reverse the bit order.
-	array_reverse_bits (answer, sizeof (answer));
+		unsigned int len = sizeof (answer) - nbytes;
+		if (len > SZ_PACKET)
+			len = SZ_PACKET;
+
+		status = dc_iostream_read (device->iostream, answer + nbytes, len, NULL);
+		if (status != DC_STATUS_SUCCESS) {
+			ERROR (abstract->context, "Unexpected EOF in answer.");
+			return status;
+		}
+
+		// Reverse the bit order.
+		array_reverse_bits (answer + nbytes, len);
+
+		// Update and emit a progress event.
+		progress.current += len;
+		device_event_emit (abstract, DC_EVENT_PROGRESS, &progress);
+
+		nbytes += len;
+	}
 
 	// Verify the checksum of the package.
+	device_phase_t phase = device_phase_set (abstract, DEVICE_PHASE_CHECKSUM);
 	unsigned short crc = array_uint16_le (answer + SZ_MEMORY);
 	unsigned short ccrc = checksum_add_uint16 (answer, SZ_MEMORY, 0x0000);
+	device_phase_set (abstract, phase);
 	if (ccrc != crc) {
 		ERROR (abstract->context, "Unexpected answer checksum.");
 		return DC_STATUS_PROTOCOL;
@@ -233,7 +252,7 @@ uwatec_aladin_device_dump (dc_device_t *abstract, dc_buffer_t *buffer)
 static dc_status_t
 uwatec_aladin_device_foreach (dc_device_t *abstract, dc_dive_callback_t callback, void *userdata)
 {
-	dc_buffer_t *buffer = dc_buffer_new (SZ_MEMORY);
+	dc_buffer_t *buffer = dc_buffer_new_context (abstract->context, SZ_MEMORY);
 	if (buffer == NULL)
 		return DC_STATUS_NOMEMORY;
 
@@ -260,7 +279,7 @@ uwatec_aladin_device_foreach (dc_device_t *abstract, dc_dive_callback_t callback
 }
 
 
-static dc_status_t
+dc_status_t
 uwatec_aladin_extract_dives (dc_device_t *abstract, const unsigned char* data, unsigned int size, dc_dive_callback_t callback, void *userdata)
 {
 	uwatec_aladin_device_t *device = (uwatec_aladin_device_t*) abstract;
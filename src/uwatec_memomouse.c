@@ -53,16 +53,15 @@ static const dc_device_vtable_t uwatec_memomouse_device_vtable = {
 	DC_FAMILY_UWATEC_MEMOMOUSE,
 	uwatec_memomouse_device_set_fingerprint, /* set_fingerprint */
 	NULL, /* read */
+	NULL, /* read_range */
 	NULL, /* write */
 	uwatec_memomouse_device_dump, /* dump */
 	uwatec_memomouse_device_foreach, /* foreach */
+	NULL, /* foreach_header */
 	NULL, /* timesync */
 	NULL /* close */
 };
 
-static dc_status_t
-uwatec_memomouse_extract_dives (dc_device_t *device, const unsigned char data[], unsigned int size, dc_dive_callback_t callback, void *userdata);
-
 dc_status_t
 uwatec_memomouse_device_open (dc_device_t **out, dc_context_t *context, dc_iostream_t *iostream)
 {
@@ -290,8 +289,10 @@ uwatec_memomouse_read_packet_inner (uwatec_memomouse_device_t *device, dc_buffer
 	unsigned char *data = dc_buffer_get_data (buffer);
 
 	// Verify the checksum.
+	device_phase_t phase = device_phase_set (abstract, DEVICE_PHASE_CHECKSUM);
 	unsigned char crc = data[total - 1];
 	unsigned char ccrc = checksum_xor_uint8 (data, total - 1, 0x00);
+	device_phase_set (abstract, phase);
 	if (crc != ccrc) {
 		ERROR (abstract->context, "Unexpected answer checksum.");
 		return DC_STATUS_PROTOCOL;
@@ -446,7 +447,7 @@ uwatec_memomouse_device_dump (dc_device_t *abstract, dc_buffer_t *buffer)
 static dc_status_t
 uwatec_memomouse_device_foreach (dc_device_t *abstract, dc_dive_callback_t callback, void *userdata)
 {
-	dc_buffer_t *buffer = dc_buffer_new (0);
+	dc_buffer_t *buffer = dc_buffer_new_context (abstract->context, 0);
 	if (buffer == NULL)
 		return DC_STATUS_NOMEMORY;
 
@@ -465,7 +466,7 @@ uwatec_memomouse_device_foreach (dc_device_t *abstract, dc_dive_callback_t callb
 }
 
 
-static dc_status_t
+dc_status_t
 uwatec_memomouse_extract_dives (dc_device_t *abstract, const unsigned char data[], unsigned int size, dc_dive_callback_t callback, void *userdata)
 {
 	if (abstract && !ISINSTANCE (abstract))
@@ -51,7 +51,13 @@ static const dc_parser_vtable_t uwatec_memomouse_parser_vtable = {
 	NULL, /* set_density */
 	uwatec_memomouse_parser_get_datetime, /* datetime */
 	uwatec_memomouse_parser_get_field, /* fields */
+	NULL, /* summary */
 	uwatec_memomouse_parser_samples_foreach, /* samples_foreach */
+	NULL, /* samples_batch */
+	NULL, /* samples_fixed */
+	NULL, /* samples_append */
+	NULL, /* samples_range */
+	NULL, /* reset */
 	NULL /* destroy */
 };
 
@@ -28,6 +28,7 @@
 #include "checksum.h"
 #include "platform.h"
 #include "array.h"
+#include "packet.h"
 
 #define ISINSTANCE(device) dc_device_isinstance((device), &uwatec_smart_device_vtable)
 
@@ -68,22 +69,22 @@ struct uwatec_smart_device_t {
 static dc_status_t uwatec_smart_device_set_fingerprint (dc_device_t *device, const unsigned char data[], unsigned int size);
 static dc_status_t uwatec_smart_device_dump (dc_device_t *abstract, dc_buffer_t *buffer);
 static dc_status_t uwatec_smart_device_foreach (dc_device_t *abstract, dc_dive_callback_t callback, void *userdata);
+static dc_status_t uwatec_smart_device_close (dc_device_t *abstract);
 
 static const dc_device_vtable_t uwatec_smart_device_vtable = {
 	sizeof(uwatec_smart_device_t),
 	DC_FAMILY_UWATEC_SMART,
 	uwatec_smart_device_set_fingerprint, /* set_fingerprint */
 	NULL, /* read */
+	NULL, /* read_range */
 	NULL, /* write */
 	uwatec_smart_device_dump, /* dump */
 	uwatec_smart_device_foreach, /* foreach */
+	NULL, /* foreach_header */
 	NULL, /* timesync */
-	NULL /* close */
+	uwatec_smart_device_close /* close */
 };
 
-static dc_status_t
-uwatec_smart_extract_dives (dc_device_t *device, const unsigned char data[], unsigned int size, dc_dive_callback_t callback, void *userdata);
-
 static dc_status_t
 uwatec_smart_irda_send (uwatec_smart_device_t *device, unsigned char cmd, const unsigned char data[], size_t size)
 {
@@ -323,13 +324,31 @@ uwatec_smart_usbhid_receive (uwatec_smart_device_t *device, dc_event_progress_t
 
 	size_t nbytes = 0;
 	while (nbytes < size) {
+		// Once the first packet has been received, the packets are read
+		// straight into the destination buffer, on top of the last byte
+		// of the previous packet. That byte is restored afterwards, and
+		// the length byte of the packet ends up in its place. The small
+		// stack buffer is only needed when the remaining space is too
+		// small for a full packet.
+		unsigned char *p = buf;
+		unsigned char saved = 0;
+		if (nbytes && size - nbytes + 1 >= packetsize) {
+			p = data + nbytes - 1;
+			saved = *p;
+		}
+
 		size_t transferred = 0;
-		rc = dc_iostream_read (device->iostream, buf, packetsize, &transferred);
+		rc = dc_iostream_read (device->iostream, p, packetsize, &transferred);
 		if (rc != DC_STATUS_SUCCESS) {
 			ERROR (abstract->context, "Failed to receive the packet.");
 			return rc;
 		}
 
+		unsigned char header = p[0];
+		if (p != buf) {
+			p[0] = saved;
+		}
+
 		if (transferred < 1) {
 			ERROR (abstract->context, "Invalid packet length (" DC_PRINTF_SIZE ").", transferred);
 			return DC_STATUS_PROTOCOL;
@@ -375,13 +394,13 @@ uwatec_smart_usbhid_receive (uwatec_smart_device_t *device, dc_event_progress_t
 		 */
 		unsigned int len = transferred - 1;
 		if (transport == DC_TRANSPORT_USBHID) {
-			if (len > buf[0])
-				len = buf[0];
+			if (len > header)
+				len = header;
 		}
 
-		HEXDUMP (abstract->context, DC_LOGLEVEL_DEBUG, "rcv", buf + 1, len);
+		HEXDUMP (abstract->context, DC_LOGLEVEL_DEBUG, "rcv", p + 1, len);
 
-		if (len > size) {
+		if (len > size - nbytes) {
 			ERROR (abstract->context, "Insufficient buffer space available.");
 			return DC_STATUS_PROTOCOL;
 		}
@@ -392,7 +411,9 @@ uwatec_smart_usbhid_receive (uwatec_smart_device_t *device, dc_event_progress_t
 			device_event_emit (abstract, DC_EVENT_PROGRESS, progress);
 		}
 
-		memcpy(data + nbytes, buf + 1, len);
+		if (p == buf) {
+			memcpy(data + nbytes, buf + 1, len);
+		}
 		nbytes += len;
 	}
 
@@ -508,6 +529,12 @@ uwatec_smart_device_open (dc_device_t **out, dc_context_t *context, dc_iostream_
 	case DC_TRANSPORT_SERIAL:
 		device->send = uwatec_smart_serial_send;
 		device->receive = uwatec_smart_serial_receive;
+		// Buffer the many small reads of the serial protocol.
+		status = dc_packet_open (&device->iostream, context, iostream, DC_PACKET_AUTO, 0);
+		if (status != DC_STATUS_SUCCESS) {
+			ERROR (context, "Failed to create the packet stream.");
+			goto error_free;
+		}
 		break;
 	case DC_TRANSPORT_USBHID:
 	case DC_TRANSPORT_BLE:
@@ -524,19 +551,43 @@ uwatec_smart_device_open (dc_device_t **out, dc_context_t *context, dc_iostream_
 	status = uwatec_smart_handshake (device);
 	if (status != DC_STATUS_SUCCESS) {
 		ERROR (context, "Failed to handshake with the device.");
-		goto error_free;
+		goto error_free_iostream;
 	}
 
 	*out = (dc_device_t*) device;
 
 	return DC_STATUS_SUCCESS;
 
+error_free_iostream:
+	if (device->iostream != iostream) {
+		dc_iostream_close (device->iostream);
+	}
 error_free:
 	dc_device_deallocate ((dc_device_t *) device);
 	return status;
 }
 
 
+static dc_status_t
+uwatec_smart_device_close (dc_device_t *abstract)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	uwatec_smart_device_t *device = (uwatec_smart_device_t *) abstract;
+	dc_status_t rc = DC_STATUS_SUCCESS;
+
+	// Close the packet stream.
+	if (dc_iostream_get_transport (device->iostream) == DC_TRANSPORT_SERIAL) {
+		rc = dc_iostream_close (device->iostream);
+		if (rc != DC_STATUS_SUCCESS) {
+			ERROR (abstract->context, "Failed to close the packet stream.");
+			dc_status_set_error(&status, rc);
+		}
+	}
+
+	return status;
+}
+
+
 static dc_status_t
 uwatec_smart_device_set_fingerprint (dc_device_t *abstract, const unsigned char data[], unsigned int size)
 {
@@ -678,7 +729,7 @@ uwatec_smart_device_dump (dc_device_t *abstract, dc_buffer_t *buffer)
 static dc_status_t
 uwatec_smart_device_foreach (dc_device_t *abstract, dc_dive_callback_t callback, void *userdata)
 {
-	dc_buffer_t *buffer = dc_buffer_new (0);
+	dc_buffer_t *buffer = dc_buffer_new_context (abstract->context, 0);
 	if (buffer == NULL)
 		return DC_STATUS_NOMEMORY;
 
@@ -697,7 +748,7 @@ uwatec_smart_device_foreach (dc_device_t *abstract, dc_dive_callback_t callback,
 }
 
 
-static dc_status_t
+dc_status_t
 uwatec_smart_extract_dives (dc_device_t *abstract, const unsigned char data[], unsigned int size, dc_dive_callback_t callback, void *userdata)
 {
 	if (abstract && !ISINSTANCE (abstract))
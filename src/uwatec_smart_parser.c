@@ -28,6 +28,7 @@
 #include "context-private.h"
 #include "parser-private.h"
 #include "array.h"
+#include "field-cache.h"
 
 #define ISINSTANCE(parser) dc_parser_isinstance((parser), &uwatec_smart_parser_vtable)
 
@@ -144,6 +145,7 @@ struct uwatec_smart_parser_t {
 	dc_parser_t base;
 	unsigned int model;
 	const uwatec_smart_sample_info_t *samples;
+	const unsigned char *identify;
 	const uwatec_smart_header_info_t *header;
 	unsigned int headersize;
 	unsigned int nsamples;
@@ -154,6 +156,7 @@ struct uwatec_smart_parser_t {
 	unsigned int cached;
 	unsigned int ngasmixes;
 	uwatec_smart_gasmix_t gasmix[NGASMIXES];
+	dc_gasmix_map_t gasmap;
 	unsigned int ntanks;
 	uwatec_smart_tank_t tank[NGASMIXES];
 	dc_water_t watertype;
@@ -165,6 +168,7 @@ static dc_status_t uwatec_smart_parser_get_field (dc_parser_t *abstract, dc_fiel
 static dc_status_t uwatec_smart_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_t callback, void *userdata);
 
 static dc_status_t uwatec_smart_parse (uwatec_smart_parser_t *parser, dc_sample_callback_t callback, void *userdata);
+static dc_status_t uwatec_smart_parser_reset (dc_parser_t *abstract);
 
 static const dc_parser_vtable_t uwatec_smart_parser_vtable = {
 	sizeof(uwatec_smart_parser_t),
@@ -174,7 +178,13 @@ static const dc_parser_vtable_t uwatec_smart_parser_vtable = {
 	NULL, /* set_density */
 	uwatec_smart_parser_get_datetime, /* datetime */
 	uwatec_smart_parser_get_field, /* fields */
+	NULL, /* summary */
 	uwatec_smart_parser_samples_foreach, /* samples_foreach */
+	NULL, /* samples_batch */
+	NULL, /* samples_fixed */
+	NULL, /* samples_append */
+	NULL, /* samples_range */
+	uwatec_smart_parser_reset, /* reset */
 	NULL /* destroy */
 };
 
@@ -415,17 +425,62 @@ uwatec_smart_event_info_t uwatec_smart_trimix_events_2[] = {
 	{EV_GASMIX,           0xF0, 4},
 };
 
+/*
+ * Sample type of the first type byte for the Uwatec Smart. The type is the
+ * number of leading one bits, and continues in the next byte for 0xFF.
+ */
+static const
+unsigned char uwatec_smart_ids[256] = {
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01,
+	0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01,
+	0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01,
+	0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01,
+	0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02,
+	0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02,
+	0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03,
+	0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x05, 0x05, 0x05, 0x05, 0x06, 0x06, 0x07, 0xFF
+};
+
+/*
+ * Sample type of the type byte for the Uwatec Galileo.
+ */
+static const
+unsigned char uwatec_galileo_ids[256] = {
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01,
+	0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01,
+	0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02,
+	0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03,
+	0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04,
+	0x05, 0x05, 0x05, 0x05, 0x05, 0x05, 0x05, 0x05, 0x05, 0x05, 0x05, 0x05, 0x05, 0x05, 0x05, 0x05,
+	0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06,
+	0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16
+};
+
 static unsigned int
 uwatec_smart_find_gasmix (uwatec_smart_parser_t *parser, unsigned int id)
 {
-       unsigned int i = 0;
-       while (i < parser->ngasmixes) {
-               if (id == parser->gasmix[i].id)
-                       break;
-               i++;
-       }
+	// The gas mixes are identified by their id only.
+	unsigned int idx = dc_gasmix_map_find (&parser->gasmap, 0, 0, id);
+	if (idx == DC_GASMIX_UNKNOWN)
+		return parser->ngasmixes;
 
-       return i;
+	return idx;
 }
 
 static unsigned int
@@ -559,8 +614,10 @@ uwatec_smart_parser_cache (uwatec_smart_parser_t *parser)
 
 	// Cache the data for later use.
 	parser->ngasmixes = ngasmixes;
+	dc_gasmix_map_clear (&parser->gasmap);
 	for (unsigned int i = 0; i < ngasmixes; ++i) {
 		parser->gasmix[i] = gasmix[i];
+		dc_gasmix_map_insert (&parser->gasmap, 0, 0, gasmix[i].id, i);
 	}
 	parser->ntanks = ntanks;
 	for (unsigned int i = 0; i < ntanks; ++i) {
@@ -603,6 +660,7 @@ uwatec_smart_parser_create (dc_parser_t **out, dc_context_t *context, const unsi
 		parser->header = &uwatec_smart_pro_header;
 		parser->samples = uwatec_smart_pro_samples;
 		parser->nsamples = C_ARRAY_SIZE (uwatec_smart_pro_samples);
+		parser->identify = uwatec_smart_ids;
 		parser->events[0] = uwatec_smart_tec_events_0;
 		parser->nevents[0] = C_ARRAY_SIZE (uwatec_smart_tec_events_0);
 		break;
@@ -617,6 +675,7 @@ uwatec_smart_parser_create (dc_parser_t **out, dc_context_t *context, const unsi
 		parser->header = &uwatec_smart_galileo_header;
 		parser->samples = uwatec_smart_galileo_samples;
 		parser->nsamples = C_ARRAY_SIZE (uwatec_smart_galileo_samples);
+		parser->identify = uwatec_galileo_ids;
 		parser->events[0] = uwatec_smart_galileo_events_0;
 		parser->events[1] = uwatec_smart_galileo_events_1;
 		parser->events[2] = uwatec_smart_galileo_events_2;
@@ -637,6 +696,7 @@ uwatec_smart_parser_create (dc_parser_t **out, dc_context_t *context, const unsi
 		parser->header = &uwatec_smart_trimix_header;
 		parser->samples = uwatec_smart_galileo_samples;
 		parser->nsamples = C_ARRAY_SIZE (uwatec_smart_galileo_samples);
+		parser->identify = uwatec_galileo_ids;
 		parser->events[0] = uwatec_smart_galileo_events_0;
 		parser->events[1] = uwatec_smart_galileo_events_1;
 		parser->events[2] = uwatec_smart_trimix_events_2;
@@ -650,6 +710,7 @@ uwatec_smart_parser_create (dc_parser_t **out, dc_context_t *context, const unsi
 		parser->header = &uwatec_smart_aladin_tec_header;
 		parser->samples = uwatec_smart_aladin_samples;
 		parser->nsamples = C_ARRAY_SIZE (uwatec_smart_aladin_samples);
+		parser->identify = uwatec_smart_ids;
 		parser->events[0] = uwatec_smart_aladintec_events_0;
 		parser->events[1] = uwatec_smart_aladintec_events_1;
 		parser->nevents[0] = C_ARRAY_SIZE (uwatec_smart_aladintec_events_0);
@@ -660,6 +721,7 @@ uwatec_smart_parser_create (dc_parser_t **out, dc_context_t *context, const unsi
 		parser->header = &uwatec_smart_aladin_tec2g_header;
 		parser->samples = uwatec_smart_aladin_samples;
 		parser->nsamples = C_ARRAY_SIZE (uwatec_smart_aladin_samples);
+		parser->identify = uwatec_smart_ids;
 		parser->events[0] = uwatec_smart_aladintec2g_events_0;
 		parser->events[1] = uwatec_smart_aladintec2g_events_1;
 		parser->nevents[0] = C_ARRAY_SIZE (uwatec_smart_aladintec2g_events_0);
@@ -670,6 +732,7 @@ uwatec_smart_parser_create (dc_parser_t **out, dc_context_t *context, const unsi
 		parser->header = &uwatec_smart_com_header;
 		parser->samples = uwatec_smart_com_samples;
 		parser->nsamples = C_ARRAY_SIZE (uwatec_smart_com_samples);
+		parser->identify = uwatec_smart_ids;
 		parser->events[0] = uwatec_smart_tec_events_0;
 		parser->nevents[0] = C_ARRAY_SIZE (uwatec_smart_tec_events_0);
 		break;
@@ -679,6 +742,7 @@ uwatec_smart_parser_create (dc_parser_t **out, dc_context_t *context, const unsi
 		parser->header = &uwatec_smart_tec_header;
 		parser->samples = uwatec_smart_tec_samples;
 		parser->nsamples = C_ARRAY_SIZE (uwatec_smart_tec_samples);
+		parser->identify = uwatec_smart_ids;
 		parser->events[0] = uwatec_smart_tec_events_0;
 		parser->nevents[0] = C_ARRAY_SIZE (uwatec_smart_tec_events_0);
 		break;
@@ -687,8 +751,26 @@ uwatec_smart_parser_create (dc_parser_t **out, dc_context_t *context, const unsi
 		goto error_free;
 	}
 
+	uwatec_smart_parser_reset ((dc_parser_t *) parser);
+
+	*out = (dc_parser_t*) parser;
+
+	return DC_STATUS_SUCCESS;
+
+error_free:
+	dc_parser_deallocate ((dc_parser_t *) parser);
+	return status;
+}
+
+
+static dc_status_t
+uwatec_smart_parser_reset (dc_parser_t *abstract)
+{
+	uwatec_smart_parser_t *parser = (uwatec_smart_parser_t *) abstract;
+
 	parser->cached = 0;
 	parser->ngasmixes = 0;
+	dc_gasmix_map_clear (&parser->gasmap);
 	parser->ntanks = 0;
 	for (unsigned int i = 0; i < NGASMIXES; ++i) {
 		parser->gasmix[i].id = 0;
@@ -702,13 +784,7 @@ uwatec_smart_parser_create (dc_parser_t **out, dc_context_t *context, const unsi
 	parser->watertype = DC_WATER_FRESH;
 	parser->divemode = DC_DIVEMODE_OC;
 
-	*out = (dc_parser_t*) parser;
-
 	return DC_STATUS_SUCCESS;
-
-error_free:
-	dc_parser_deallocate ((dc_parser_t *) parser);
-	return status;
 }
 
 
@@ -855,26 +931,6 @@ uwatec_smart_identify (const unsigned char data[], unsigned int size)
 }
 
 
-static unsigned int
-uwatec_galileo_identify (unsigned char value)
-{
-	// Bits: 0ddd dddd
-	if ((value & 0x80) == 0)
-		return 0;
-
-	// Bits: 100d dddd
-	if ((value & 0xE0) == 0x80)
-		return 1;
-
-	// Bits: 1XXX dddd
-	if ((value & 0xF0) != 0xF0)
-		return (value & 0x70) >> 4;
-
-	// Bits: 1111 XXXX
-	return (value & 0x0F) + 7;
-}
-
-
 static dc_status_t
 uwatec_smart_parse (uwatec_smart_parser_t *parser, dc_sample_callback_t callback, void *userdata)
 {
@@ -884,6 +940,7 @@ uwatec_smart_parse (uwatec_smart_parser_t *parser, dc_sample_callback_t callback
 	unsigned int size = abstract->size;
 
 	const uwatec_smart_sample_info_t *table = parser->samples;
+	const unsigned char *identify = parser->identify;
 	unsigned int entries = parser->nsamples;
 
 	// Get the maximum number of alarm bytes.
@@ -927,20 +984,15 @@ uwatec_smart_parse (uwatec_smart_parser_t *parser, dc_sample_callback_t callback
 	while (offset < size) {
 		dc_sample_value_t sample = {0};
 
-		// Process the type bits in the bitstream.
-		unsigned int id = 0;
-		if (parser->model == GALILEO || parser->model == GALILEOTRIMIX ||
-			parser->model == ALADIN2G || parser->model == MERIDIAN ||
-			parser->model == CHROMIS || parser->model == MANTIS2 ||
-			parser->model == G2 || parser->model == ALADINSPORTMATRIX ||
-			parser->model == ALADINSQUARE || parser->model == G2HUD ||
-			parser->model == ALADINA1 || parser->model == ALADINA2 ||
-			parser->model == G2TEK || parser->model == G3 ||
-			parser->model == LUNA2AI || parser->model == LUNA2) {
-			// Uwatec Galileo
-			id = uwatec_galileo_identify (data[offset]);
-		} else {
-			// Uwatec Smart
+		// The remainder of the profile is not needed.
+		if (dc_parser_stopped (parser, callback))
+			return DC_STATUS_SUCCESS;
+
+		// Process the type bits in the bitstream. The type is nearly
+		// always contained in the first byte, and only the very long
+		// Uwatec Smart type codes need to look further.
+		unsigned int id = identify[data[offset]];
+		if (id == 0xFF) {
 			id = uwatec_smart_identify (data + offset, size - offset);
 		}
 		if (id >= entries) {
@@ -1116,6 +1168,7 @@ uwatec_smart_parse (uwatec_smart_parser_t *parser, dc_sample_callback_t callback
 						parser->gasmix[idx].oxygen = o2;
 						parser->gasmix[idx].helium = he;
 						parser->ngasmixes++;
+						dc_gasmix_map_insert (&parser->gasmap, 0, 0, mixid, idx);
 					}
 					mixidx = idx;
 				}
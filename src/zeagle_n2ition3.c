@@ -35,6 +35,7 @@
 
 #define SZ_MEMORY 0x8000
 #define SZ_PACKET 64
+#define SZ_PACKET_MAX 128
 
 #define RB_PROFILE_BEGIN  0x3FA0
 #define RB_PROFILE_END    0x7EC0
@@ -47,6 +48,8 @@ typedef struct zeagle_n2ition3_device_t {
 	dc_device_t base;
 	dc_iostream_t *iostream;
 	unsigned char fingerprint[16];
+	unsigned int packetsize;
+	unsigned int probed;
 } zeagle_n2ition3_device_t;
 
 static dc_status_t zeagle_n2ition3_device_set_fingerprint (dc_device_t *abstract, const unsigned char data[], unsigned int size);
@@ -59,9 +62,11 @@ static const dc_device_vtable_t zeagle_n2ition3_device_vtable = {
 	DC_FAMILY_ZEAGLE_N2ITION3,
 	zeagle_n2ition3_device_set_fingerprint, /* set_fingerprint */
 	zeagle_n2ition3_device_read, /* read */
+	NULL, /* read_range */
 	NULL, /* write */
 	zeagle_n2ition3_device_dump, /* dump */
 	zeagle_n2ition3_device_foreach, /* foreach */
+	NULL, /* foreach_header */
 	NULL, /* timesync */
 	NULL /* close */
 };
@@ -149,6 +154,8 @@ zeagle_n2ition3_device_open (dc_device_t **out, dc_context_t *context, dc_iostre
 	// Set the default values.
 	device->iostream = iostream;
 	memset (device->fingerprint, 0, sizeof (device->fingerprint));
+	device->packetsize = SZ_PACKET;
+	device->probed = 0;
 
 	// Set the serial communication protocol (4800 8N1).
 	status = dc_iostream_configure (device->iostream, 4800, 8, DC_PARITY_NONE, DC_STOPBITS_ONE, DC_FLOWCONTROL_NONE);
@@ -197,6 +204,28 @@ zeagle_n2ition3_device_set_fingerprint (dc_device_t *abstract, const unsigned ch
 }
 
 
+static dc_status_t
+zeagle_n2ition3_read_packet (zeagle_n2ition3_device_t *device, unsigned int address, unsigned char data[], unsigned int len)
+{
+	assert (len <= SZ_PACKET_MAX);
+
+	unsigned char answer[13 + SZ_PACKET_MAX + 6] = {0};
+	unsigned char command[13] = {0x02, 0x08, 0x00, 0x4D,
+			(address     ) & 0xFF, // low
+			(address >> 8) & 0xFF, // high
+			len, // count
+			0x00, 0x00, 0x00, 0x00, 0x00, 0x03};
+	command[11] = ~checksum_add_uint8 (command + 3, 8, 0x00) + 1;
+	dc_status_t rc = zeagle_n2ition3_packet (device, command, sizeof (command), answer, 13 + len + 6);
+	if (rc != DC_STATUS_SUCCESS)
+		return rc;
+
+	memcpy (data, answer + 17, len);
+
+	return DC_STATUS_SUCCESS;
+}
+
+
 static dc_status_t
 zeagle_n2ition3_device_read (dc_device_t *abstract, unsigned int address, unsigned char data[], unsigned int size)
 {
@@ -206,23 +235,22 @@ zeagle_n2ition3_device_read (dc_device_t *abstract, unsigned int address, unsign
 	while (nbytes < size) {
 		// Calculate the package size.
 		unsigned int len = size - nbytes;
-		if (len > SZ_PACKET)
-			len = SZ_PACKET;
+		if (len > device->packetsize)
+			len = device->packetsize;
 
 		// Read the package.
-		unsigned char answer[13 + SZ_PACKET + 6] = {0};
-		unsigned char command[13] = {0x02, 0x08, 0x00, 0x4D,
-				(address     ) & 0xFF, // low
-				(address >> 8) & 0xFF, // high
-				len, // count
-				0x00, 0x00, 0x00, 0x00, 0x00, 0x03};
-		command[11] = ~checksum_add_uint8 (command + 3, 8, 0x00) + 1;
-		dc_status_t rc = zeagle_n2ition3_packet (device, command, sizeof (command), answer, 13 + len + 6);
+		dc_status_t rc = zeagle_n2ition3_read_packet (device, address, data, len);
+		if (rc != DC_STATUS_SUCCESS && rc != DC_STATUS_CANCELLED && len > SZ_PACKET) {
+			// The larger packets are not reliable after all.
+			WARNING (abstract->context, "Falling back to the default packet size.");
+			device->packetsize = SZ_PACKET;
+			dc_iostream_sleep (device->iostream, 100);
+			dc_iostream_purge (device->iostream, DC_DIRECTION_INPUT);
+			continue;
+		}
 		if (rc != DC_STATUS_SUCCESS)
 			return rc;
 
-		memcpy (data, answer + 17, len);
-
 		nbytes += len;
 		address += len;
 		data += len;
@@ -232,17 +260,56 @@ zeagle_n2ition3_device_read (dc_device_t *abstract, unsigned int address, unsign
 }
 
 
+/*
+ * Probe whether the device supports larger packets, by comparing with
+ * a packet of the default size. A failed probe keeps the default size.
+ */
+static void
+zeagle_n2ition3_probe (zeagle_n2ition3_device_t *device)
+{
+	dc_device_t *abstract = (dc_device_t *) device;
+
+	if (device->probed)
+		return;
+
+	device->probed = 1;
+
+	unsigned char reference[SZ_PACKET] = {0};
+	if (zeagle_n2ition3_read_packet (device, RB_LOGBOOK_OFFSET, reference, sizeof (reference)) != DC_STATUS_SUCCESS)
+		return;
+
+	DEBUG (abstract->context, "Probing a packet size of %u bytes.", SZ_PACKET_MAX);
+
+	unsigned char data[SZ_PACKET_MAX] = {0};
+	dc_status_t rc = zeagle_n2ition3_read_packet (device, RB_LOGBOOK_OFFSET, data, sizeof (data));
+	if (rc == DC_STATUS_SUCCESS && memcmp (data, reference, sizeof (reference)) == 0) {
+		device->packetsize = SZ_PACKET_MAX;
+	} else if (rc != DC_STATUS_CANCELLED) {
+		// Discard the remainder of the answer.
+		dc_iostream_sleep (device->iostream, 100);
+		dc_iostream_purge (device->iostream, DC_DIRECTION_INPUT);
+	}
+
+	DEBUG (abstract->context, "Packet size: %u bytes.", device->packetsize);
+}
+
+
 static dc_status_t
 zeagle_n2ition3_device_dump (dc_device_t *abstract, dc_buffer_t *buffer)
 {
+	zeagle_n2ition3_device_t *device = (zeagle_n2ition3_device_t *) abstract;
+
 	// Allocate the required amount of memory.
 	if (!dc_buffer_resize (buffer, SZ_MEMORY)) {
 		ERROR (abstract->context, "Insufficient buffer space available.");
 		return DC_STATUS_NOMEMORY;
 	}
 
+	// Use larger packets if the device supports them.
+	zeagle_n2ition3_probe (device);
+
 	return device_dump_read (abstract, 0, dc_buffer_get_data (buffer),
-		dc_buffer_get_size (buffer), SZ_PACKET);
+		dc_buffer_get_size (buffer), device->packetsize);
 }
 
 
@@ -257,6 +324,9 @@ zeagle_n2ition3_device_foreach (dc_device_t *abstract, dc_dive_callback_t callba
 		(RB_PROFILE_END - RB_PROFILE_BEGIN);
 	device_event_emit (abstract, DC_EVENT_PROGRESS, &progress);
 
+	// Use larger packets if the device supports them.
+	zeagle_n2ition3_probe (device);
+
 	// Read the configuration data.
 	unsigned char config[(RB_LOGBOOK_END - RB_LOGBOOK_BEGIN) * 2 + 8] = {0};
 	dc_status_t rc = zeagle_n2ition3_device_read (abstract, RB_LOGBOOK_OFFSET, config, sizeof (config));
@@ -326,7 +396,7 @@ zeagle_n2ition3_device_foreach (dc_device_t *abstract, dc_dive_callback_t callba
 
 	// Create the ringbuffer stream.
 	dc_rbstream_t *rbstream = NULL;
-	rc = dc_rbstream_new (&rbstream, abstract, 1, SZ_PACKET, RB_PROFILE_BEGIN, RB_PROFILE_END, eop);
+	rc = dc_rbstream_new (&rbstream, abstract, 1, device->packetsize, RB_PROFILE_BEGIN, RB_PROFILE_END, eop);
 	if (rc != DC_STATUS_SUCCESS) {
 		ERROR (abstract->context, "Failed to create the ringbuffer stream.");
 		return rc;